@@ -0,0 +1,69 @@
+#!/usr/bin/python3
+#
+# This script demonstrates how Wayfire's IPC can be used to find the scenegraph nodes which are the most
+# expensive to render.
+#
+# Without arguments, it dumps the scenegraph together with the render statistics of each node.
+# With a number of seconds, it takes two snapshots that far apart and prints the nodes which took the most
+# time to render in between, along with their damage rate.
+
+import os
+import sys
+import time
+from wayfire_socket import *
+
+addr = os.getenv('WAYFIRE_SOCKET')
+sock = WayfireSocket(addr)
+
+def flatten(node, depth = 0, result = None):
+    if result is None:
+        result = {}
+    result[node["id"]] = (depth, node)
+    for child in node["children"]:
+        flatten(child, depth + 1, result)
+    return result
+
+def stat(node, key):
+    return node.get("stats", {}).get(key, 0)
+
+def dump(node, depth = 0):
+    line = "  " * depth + node["name"]
+    if "stats" in node:
+        line += " instructions={} pixels={} render-us={} damage={}".format(stat(node, "instructions"),
+            stat(node, "pixels"), stat(node, "render-us"), stat(node, "damage-events"))
+    if node.get("aux-buffer-bytes", 0) > 0:
+        line += " aux-buffer={}KiB".format(node["aux-buffer-bytes"] // 1024)
+    print(line)
+    for child in node["children"]:
+        dump(child, depth + 1)
+
+if len(sys.argv) < 2:
+    scene = sock.get_scene(enable=True)
+    dump(scene["root"])
+    sys.exit(0)
+
+interval = float(sys.argv[1])
+before = sock.get_scene(enable=True)
+time.sleep(interval)
+after = sock.get_scene()
+
+seconds = (after["time-us"] - before["time-us"]) / 1e6
+frames = after["frames"] - before["frames"]
+old_nodes = flatten(before["root"])
+rows = []
+for node_id, (_, node) in flatten(after["root"]).items():
+    old = old_nodes.get(node_id, (0, {}))[1]
+    # Node ids are addresses, make sure that it is still the same node
+    if old.get("name") != node["name"]:
+        old = {}
+    delta = {key: stat(node, key) - stat(old, key)
+             for key in ["instructions", "pixels", "render-us", "damage-events"]}
+    if delta["instructions"] or delta["damage-events"]:
+        rows.append((delta, node))
+
+rows.sort(key=lambda row: row[0]["render-us"], reverse=True)
+print("{} frames in {:.1f}s".format(frames, seconds))
+print("{:>10} {:>10} {:>12} {:>10}  {}".format("us/frame", "instr", "pixels", "damage/s", "node"))
+for delta, node in rows:
+    print("{:>10.1f} {:>10} {:>12} {:>10.1f}  {}".format(delta["render-us"] / max(frames, 1),
+        delta["instructions"], delta["pixels"], delta["damage-events"] / max(seconds, 1e-6), node["name"]))
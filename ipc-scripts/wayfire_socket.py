@@ -1,3 +1,4 @@
+import os
 import socket
 import json as js
 
@@ -47,13 +48,53 @@ class WayfireSocket:
         self.client.send(data)
         return self.read_message()
 
+    def send_json_with_fds(self, msg):
+        # Returns the response and the file descriptors received with it.
+        data = js.dumps(msg).encode('utf8')
+        header = len(data).to_bytes(4, byteorder="little")
+        self.client.send(header)
+        self.client.send(data)
+        header, fds, _, _ = socket.recv_fds(self.client, 4, 4)
+        if not header:
+            raise Exception("Failed to read anything from the socket!")
+        header += self.read_exact(4 - len(header))
+        rlen = int.from_bytes(header, byteorder="little")
+        response = js.loads(self.read_exact(rlen))
+        if "error" in response:
+            for fd in fds:
+                os.close(fd)
+            raise Exception(response["error"])
+        return response, fds
+
+    def capture_view(self, view_id: int):
+        # Returns the response with the format of the pixels, and a memfd with them.
+        message = get_msg_template("window-rules/capture-view")
+        message["data"]["id"] = view_id
+        response, fds = self.send_json_with_fds(message)
+        return response, fds[0]
+
+    def capture_output(self, output_id: int):
+        message = get_msg_template("window-rules/capture-output")
+        message["data"]["id"] = output_id
+        response, fds = self.send_json_with_fds(message)
+        return response, fds[0]
+
     def close(self):
       self.client.close()
 
-    def watch(self, events = None):
+    def watch(self, events = None, coalesce = False, max_rate = None):
         message = get_msg_template("window-rules/events/watch")
         if events:
             message["data"]["events"] = events
+        if coalesce:
+            message["data"]["coalesce"] = True
+        if max_rate:
+            message["data"]["max-rate"] = max_rate
+        return self.send_json(message)
+
+    def batch(self, calls):
+        message = get_msg_template("ipc/batch")
+        message["data"]["calls"] = [{"method": method, "data": data} for method, data in calls]
         return self.send_json(message)
 
     def query_output(self, output_id: int):
@@ -64,6 +105,18 @@ class WayfireSocket:
     def list_views(self):
         return self.send_json(get_msg_template("window-rules/list-views"))
 
+    def list_views_since(self, since: int = 0, fields = None):
+        message = get_msg_template("window-rules/list-views-since")
+        message["data"]["since"] = since
+        if fields:
+            message["data"]["fields"] = fields
+        return self.send_json(message)
+
+    def get_rule_stats(self, reset: bool = False):
+        message = get_msg_template("window-rules/rule-stats")
+        message["data"]["reset"] = reset
+        return self.send_json(message)
+
     def configure_view(self, view_id: int, x: int, y: int, w: int, h: int):
         message = get_msg_template("window-rules/configure-view")
         message["data"]["id"] = view_id
@@ -102,3 +155,102 @@ class WayfireSocket:
         message["data"]["id"] = id
         message["data"]["enabled"] = enabled
         return self.send_json(message)
+
+    def get_framebuffer_pool(self):
+        message = get_msg_template("render/framebuffer-pool")
+        return self.send_json(message)
+
+    def get_thread_pool_stats(self):
+        message = get_msg_template("wayfire/thread-pool")
+        return self.send_json(message)
+
+    def trim_memory(self):
+        message = get_msg_template("wayfire/trim-memory")
+        return self.send_json(message)
+
+    def get_gpu_memory(self, top = None):
+        message = get_msg_template("render/gpu-memory")
+        if top is not None:
+            message["data"]["top"] = top
+        return self.send_json(message)
+
+    def get_frame_stats(self, output_id = None):
+        message = get_msg_template("render/frame-stats")
+        if output_id is not None:
+            message["data"]["id"] = output_id
+        return self.send_json(message)
+
+    def set_tearing(self, output_id: int, allow: bool):
+        message = get_msg_template("render/set-tearing")
+        message["data"]["id"] = output_id
+        message["data"]["allow"] = allow
+        return self.send_json(message)
+
+    def get_input_latency(self, output_id = None):
+        message = get_msg_template("render/input-latency")
+        if output_id is not None:
+            message["data"]["id"] = output_id
+        return self.send_json(message)
+
+    def get_scanout_stats(self, output_id = None):
+        message = get_msg_template("render/scanout-stats")
+        if output_id is not None:
+            message["data"]["id"] = output_id
+        return self.send_json(message)
+
+    def get_cursor_state(self, output_id = None):
+        message = get_msg_template("render/cursor-state")
+        if output_id is not None:
+            message["data"]["id"] = output_id
+        return self.send_json(message)
+
+    def get_repaint_sources(self, output_id = None):
+        message = get_msg_template("render/repaint-sources")
+        if output_id is not None:
+            message["data"]["id"] = output_id
+        return self.send_json(message)
+
+    def trace_start(self, capacity = None):
+        message = get_msg_template("wayfire/trace-start")
+        if capacity is not None:
+            message["data"]["capacity"] = capacity
+        return self.send_json(message)
+
+    def trace_stop(self):
+        message = get_msg_template("wayfire/trace-stop")
+        return self.send_json(message)
+
+    def trace_dump(self, path: str):
+        message = get_msg_template("wayfire/trace-dump")
+        message["data"]["path"] = path
+        return self.send_json(message)
+
+    def get_plugin_stats(self, enable = None):
+        message = get_msg_template("wayfire/plugin-stats")
+        if enable is not None:
+            message["data"]["enable"] = enable
+        return self.send_json(message)
+
+    def get_signal_stats(self, enable = None):
+        message = get_msg_template("wayfire/signal-stats")
+        if enable is not None:
+            message["data"]["enable"] = enable
+        return self.send_json(message)
+
+    def get_scene(self, enable = None):
+        message = get_msg_template("wayfire/scene")
+        if enable is not None:
+            message["data"]["enable"] = enable
+        return self.send_json(message)
+
+    def get_transaction_stats(self):
+        message = get_msg_template("wayfire/transaction-stats")
+        return self.send_json(message)
+
+    def list_transactions(self):
+        message = get_msg_template("wayfire/list-transactions")
+        return self.send_json(message)
+
+    def get_tile_stats(self):
+        message = get_msg_template("simple-tile/get-stats")
+        return self.send_json(message)
@@ -3,6 +3,7 @@
 #include <wayfire/signal-definitions.hpp>
 #include <wayfire/render-manager.hpp>
 #include <wayfire/workspace-set.hpp>
+#include <algorithm>
 #include <type_traits>
 #include <wayfire/core.hpp>
 #include "animate.hpp"
@@ -48,6 +49,11 @@ static constexpr int SHOWN  = 1;
  * animation_t is which animation to use (i.e fire, zoom, etc). */
 struct animation_hook_base : public wf::custom_data_t
 {
+    /**
+     * Advance the animation by one frame and damage the view.
+     * @return Whether the animation is still running.
+     */
+    virtual bool step_animation() = 0;
     virtual void stop_hook(bool) = 0;
     virtual void reverse(wf_animation_type) = 0;
     virtual int get_direction() = 0;
@@ -60,6 +66,76 @@ struct animation_hook_base : public wf::custom_data_t
     animation_hook_base& operator =(animation_hook_base&&) = default;
 };
 
+/**
+ * Steps all animations running on an output from a single pre-render effect hook, instead of every
+ * animation registering a hook of its own.
+ */
+class animation_driver_t : public wf::custom_data_t
+{
+    wf::output_t *output = nullptr;
+    std::vector<animation_hook_base*> running;
+
+    wf::effect_hook_t on_frame = [=] ()
+    {
+        // Finished animations remove themselves from the list when stopped.
+        auto current = running;
+        std::vector<animation_hook_base*> finished;
+        for (auto hook : current)
+        {
+            if (is_running(hook) && !hook->step_animation())
+            {
+                finished.push_back(hook);
+            }
+        }
+
+        for (auto hook : finished)
+        {
+            if (is_running(hook))
+            {
+                hook->stop_hook(false);
+            }
+        }
+    };
+
+    bool is_running(animation_hook_base *hook) const
+    {
+        return std::find(running.begin(), running.end(), hook) != running.end();
+    }
+
+  public:
+    static animation_driver_t *get(wf::output_t *output)
+    {
+        auto driver = output->get_data_safe<animation_driver_t>();
+        driver->output = output;
+        return driver.get();
+    }
+
+    void add(animation_hook_base *hook)
+    {
+        if (running.empty())
+        {
+            output->render->add_effect(&on_frame, wf::OUTPUT_EFFECT_PRE);
+        }
+
+        running.push_back(hook);
+    }
+
+    void remove(animation_hook_base *hook)
+    {
+        auto it = std::find(running.begin(), running.end(), hook);
+        if (it == running.end())
+        {
+            return;
+        }
+
+        running.erase(it);
+        if (running.empty())
+        {
+            output->render->rem_effect(&on_frame);
+        }
+    }
+};
+
 template<class animation_t>
 struct animation_hook : public animation_hook_base
 {
@@ -73,27 +149,19 @@ struct animation_hook : public animation_hook_base
     std::unique_ptr<animation_base> animation;
     std::shared_ptr<wf::unmapped_view_snapshot_node> unmapped_contents;
 
-    void damage_whole_view()
-    {
-        view->damage();
-        if (unmapped_contents)
-        {
-            wf::scene::damage_node(unmapped_contents, unmapped_contents->get_bounding_box());
-        }
-    }
-
     /* Update animation right before each frame */
-    wf::effect_hook_t update_animation_hook = [=] ()
+    bool step_animation() override
     {
-        damage_whole_view();
+        // The transformed node contains the transformers and the unmapped contents, so the area covered
+        // before and after the step can be damaged at once.
+        auto node = view->get_transformed_node();
+        wf::region_t damage = node->get_bounding_box();
         bool result = animation->step();
-        damage_whole_view();
+        damage |= node->get_bounding_box();
+        wf::scene::damage_node(node, damage);
 
-        if (!result)
-        {
-            stop_hook(false);
-        }
-    };
+        return result;
+    }
 
     /**
      * Switch the output the view is being animated on, and update the lastly
@@ -103,13 +171,12 @@ struct animation_hook : public animation_hook_base
     {
         if (current_output)
         {
-            current_output->render->rem_effect(&update_animation_hook);
+            animation_driver_t::get(current_output)->remove(this);
         }
 
         if (new_output)
         {
-            new_output->render->add_effect(&update_animation_hook,
-                wf::OUTPUT_EFFECT_PRE);
+            animation_driver_t::get(new_output)->add(this);
         }
 
         current_output = new_output;
@@ -327,17 +394,37 @@ class wayfire_animation : public wf::plugin_interface_t, private wf::per_output_
 
         if (fire_enabled_for.matches(view))
         {
-            return {"fire", fire_duration};
+            return degrade_animation({"fire", fire_duration}, view);
         }
 
         if (animation_enabled_for.matches(view))
         {
-            return {anim_type, default_duration};
+            return degrade_animation({anim_type, default_duration}, view);
         }
 
         return {"none", wf::animation_description_t{0, {}, ""}};
     }
 
+    /**
+     * Replace fire with fade when the output cannot afford to render any particles anymore, see
+     * render_manager::get_effect_quality(). A running fire animation is still reversed instead.
+     */
+    view_animation_t degrade_animation(view_animation_t animation, wayfire_view view)
+    {
+        auto output = view->get_output();
+        if ((animation.animation_name != "fire") || !output || view->has_data(animate_custom_data_fire))
+        {
+            return animation;
+        }
+
+        if (output->render->get_effect_quality("fire") < 0.05)
+        {
+            return {"fade", fade_duration};
+        }
+
+        return animation;
+    }
+
     bool try_reverse(wayfire_view view, wf_animation_type type, std::string name,
         int visibility)
     {
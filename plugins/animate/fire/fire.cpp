@@ -9,7 +9,10 @@
 
 #include <memory>
 #include <wayfire/output.hpp>
+#include <wayfire/render-manager.hpp>
 #include <wayfire/core.hpp>
+#include <wayfire/nonstd/wlroots-full.hpp>
+#include <cmath>
 #include <glm/gtc/matrix_transform.hpp>
 
 static wf::option_wrapper_t<int> fire_particles{"animate/fire_particles"};
@@ -25,11 +28,53 @@ static float random(float s, float e)
     return (s * r + (1 - r) * e);
 }
 
-static int particle_count_for_width(int width)
+/**
+ * The share of the configured particles which are used, shared by all fire animations.
+ * It shrinks while frames take longer than the refresh period of the output, and grows back when they fit.
+ */
+static struct
+{
+    double scale = 1.0;
+    uint32_t last_frame = 0;
+} particle_budget;
+
+static void update_particle_budget(wf::output_t *output)
+{
+    const uint32_t now = wf::get_current_time();
+    if (now == particle_budget.last_frame)
+    {
+        // Another fire animation measured this frame already
+        return;
+    }
+
+    const int refresh_mhz   = output ? output->handle->refresh : 0;
+    const double frame_ms   = 1e6 / (refresh_mhz > 0 ? refresh_mhz : 60000);
+    const uint32_t interval = now - particle_budget.last_frame;
+    particle_budget.last_frame = now;
+
+    // Longer intervals mean that the animation just started.
+    if (interval > 10 * frame_ms)
+    {
+        return;
+    }
+
+    if (interval > 1.5 * frame_ms)
+    {
+        particle_budget.scale = std::max(0.25, particle_budget.scale * 0.9);
+    } else if (interval < 1.1 * frame_ms)
+    {
+        particle_budget.scale = std::min(1.0, particle_budget.scale * 1.05);
+    }
+}
+
+static int particle_count_for_size(wf::output_t *output, wf::dimensions_t size)
 {
     int particles = fire_particles;
+    const double quality = output ? output->render->get_effect_quality("fire") : 1.0;
 
-    return particles * std::min(width / 400.0, 3.5);
+    // Square views get the same count as with a width of the same size.
+    const double area_factor = std::sqrt(1.0 * size.width * size.height) / 400.0;
+    return particles * std::min(area_factor, 3.5) * particle_budget.scale * quality;
 }
 
 class fire_node_t : public wf::scene::floating_inner_node_t
@@ -265,9 +310,10 @@ bool FireAnimation::step()
         transformer->ps->spawn(transformer->ps->size() / 10);
     }
 
+    update_particle_budget(view->get_output());
     transformer->ps->update();
-    transformer->ps->resize(particle_count_for_width(
-        transformer->get_children_bounding_box().width));
+    transformer->ps->resize(particle_count_for_size(view->get_output(),
+        wf::dimensions(transformer->get_children_bounding_box())));
     return this->progression.running() || transformer->ps->statistic();
 }
 
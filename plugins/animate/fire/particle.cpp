@@ -1,50 +1,89 @@
 #include "particle.hpp"
 #include "shaders.hpp"
 #include <wayfire/core.hpp>
+#include <wayfire/util/log.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
 
-void Particle::update(float time)
+void particle_arrays_t::resize(size_t num)
 {
-    if (life <= 0) // ignore
+    for (auto array : {&life, &fade, &radius, &base_radius, &speed_x, &speed_y,
+        &g_x, &g_y, &start_x, &start_y, &r, &g, &b, &a})
     {
-        return;
+        array->resize(num, 0);
     }
 
-    const float slowdown = 0.8;
-
-    pos   += speed * 0.2f * slowdown;
-    speed += g * 0.3f * slowdown;
-
-    if (life != 0)
-    {
-        color.a /= life;
-    }
+    pos_x.resize(num, -10000);
+    pos_y.resize(num, -10000);
+}
 
-    life    -= fade * 0.3 * slowdown;
-    radius   = base_radius * std::pow(life, 0.5);
-    color.a *= life;
+void particle_arrays_t::set(size_t i, const Particle& p)
+{
+    life[i]    = p.life;
+    fade[i]    = p.fade;
+    radius[i]  = p.radius;
+    base_radius[i] = p.base_radius;
+    pos_x[i]   = p.pos.x;
+    pos_y[i]   = p.pos.y;
+    speed_x[i] = p.speed.x;
+    speed_y[i] = p.speed.y;
+    g_x[i]     = p.g.x;
+    g_y[i]     = p.g.y;
+    start_x[i] = p.start_pos.x;
+    start_y[i] = p.start_pos.y;
+    r[i] = p.color.r;
+    g[i] = p.color.g;
+    b[i] = p.color.b;
+    a[i] = p.color.a;
+}
 
-    if (start_pos.x < pos.x)
-    {
-        g.x = -1;
-    } else
-    {
-        g.x = 1;
-    }
+Particle particle_arrays_t::get(size_t i) const
+{
+    Particle p{};
+    p.life   = life[i];
+    p.fade   = fade[i];
+    p.radius = radius[i];
+    p.base_radius = base_radius[i];
+    p.pos   = {pos_x[i], pos_y[i]};
+    p.speed = {speed_x[i], speed_y[i]};
+    p.g     = {g_x[i], g_y[i]};
+    p.start_pos = {start_x[i], start_y[i]};
+    p.color     = {r[i], g[i], b[i], a[i]};
+    return p;
+}
 
-    if (life <= 0)
+void particle_arrays_t::update()
+{
+    /* Same as the update shader. The loop has no branches, so that it can be vectorized. */
+    const float slowdown = 0.8;
+    const size_t n = life.size();
+    for (size_t i = 0; i < n; i++)
     {
-        /* move outside */
-        pos = {-10000, -10000};
+        const bool alive = life[i] > 0;
+        const float new_life = life[i] - fade[i] * 0.3f * slowdown;
+        const bool dies = alive && (new_life <= 0);
+
+        const float x = pos_x[i] + speed_x[i] * 0.2f * slowdown;
+        const float y = pos_y[i] + speed_y[i] * 0.2f * slowdown;
+        speed_x[i] = alive ? speed_x[i] + g_x[i] * 0.3f * slowdown : speed_x[i];
+        speed_y[i] = alive ? speed_y[i] + g_y[i] * 0.3f * slowdown : speed_y[i];
+
+        a[i] = alive ? a[i] / life[i] * new_life : a[i];
+        radius[i] = alive ? base_radius[i] * std::sqrt(std::max(new_life, 0.0f)) : radius[i];
+        g_x[i]    = alive ? ((start_x[i] < x) ? -1.0f : 1.0f) : g_x[i];
+
+        /* move dead particles outside */
+        pos_x[i] = dies ? -10000.0f : (alive ? x : pos_x[i]);
+        pos_y[i] = dies ? -10000.0f : (alive ? y : pos_y[i]);
+        life[i]  = alive ? new_life : life[i];
     }
 }
 
 ParticleSystem::ParticleSystem(int particles)
 {
-    resize(particles);
-    last_update_msec = wf::get_current_time();
     create_program();
-
-    particles_alive.store(0);
+    resize(particles);
 }
 
 void ParticleSystem::set_initer(ParticleIniter init)
@@ -56,98 +95,268 @@ ParticleSystem::~ParticleSystem()
 {
     OpenGL::render_begin();
     program.free_resources();
+    GL_CALL(glDeleteProgram(update_program));
+    GL_CALL(glDeleteBuffers(2, buffers));
     OpenGL::render_end();
 }
 
+void ParticleSystem::pack(const Particle& p, float *data)
+{
+    const float values[floats_per_particle] = {
+        p.life, p.fade, p.radius, p.base_radius,
+        p.pos.x, p.pos.y, p.speed.x, p.speed.y,
+        p.g.x, p.g.y, p.start_pos.x, p.start_pos.y,
+        p.color.r, p.color.g, p.color.b, p.color.a,
+    };
+
+    std::copy(values, values + floats_per_particle, data);
+}
+
+uint32_t ParticleSystem::count_updates_to_death(const Particle& p)
+{
+    if (p.life <= 0)
+    {
+        return 0;
+    }
+
+    if (p.fade <= 0)
+    {
+        return std::numeric_limits<uint32_t>::max();
+    }
+
+    /* Same as the update shader */
+    const float slowdown = 0.8;
+    float life = p.life;
+    uint32_t updates = 0;
+    while (life > 0)
+    {
+        life -= p.fade * 0.3f * slowdown;
+        ++updates;
+    }
+
+    return updates;
+}
+
 int ParticleSystem::spawn(int num)
 {
-    std::atomic<int> spawned(0);
+    std::vector<int> slots;
+    while (((int)slots.size() < num) && !free_slots.empty())
+    {
+        slots.push_back(free_slots.back());
+        free_slots.pop_back();
+    }
+
+    if (slots.empty())
+    {
+        return 0;
+    }
+
+    /* Sorted, so that consecutive slots can be uploaded with a single call */
+    std::sort(slots.begin(), slots.end());
 
-#   pragma omp parallel for
-    for (size_t i = 0; i < ps.size(); i++)
+    std::vector<float> data;
+    int run_start = slots.front();
+    auto flush = [&] ()
     {
-        if ((ps[i].life <= 0) && (spawned < num))
+        GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, run_start * floats_per_particle * sizeof(float),
+            data.size() * sizeof(float), data.data()));
+        data.clear();
+    };
+
+    OpenGL::render_begin();
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, buffers[current]));
+    for (size_t j = 0; j < slots.size(); j++)
+    {
+        const int i = slots[j];
+        Particle p{};
+        pinit_func(p);
+
+        death_step[i] = current_step + count_updates_to_death(p);
+        if (death_step[i] > current_step)
+        {
+            dying.push({death_step[i], i});
+        } else
+        {
+            free_slots.push_back(i);
+        }
+
+        if (!update_program)
+        {
+            /* Uploaded with the next update */
+            cpu_state.set(i, p);
+            continue;
+        }
+
+        if ((j > 0) && (slots[j - 1] + 1 != i))
         {
-            pinit_func(ps[i]);
-            ++spawned;
-            ++particles_alive;
+            flush();
+            run_start = i;
         }
+
+        data.resize(data.size() + floats_per_particle);
+        pack(p, data.data() + data.size() - floats_per_particle);
+    }
+
+    if (!data.empty())
+    {
+        flush();
     }
 
-    return spawned;
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    OpenGL::render_end();
+
+    return slots.size();
+}
+
+void ParticleSystem::rebuild_free_slots()
+{
+    free_slots.clear();
+    dying = decltype(dying)();
+    for (size_t i = 0; i < death_step.size(); i++)
+    {
+        if (death_step[i] <= current_step)
+        {
+            free_slots.push_back(i);
+        } else
+        {
+            dying.push({death_step[i], i});
+        }
+    }
 }
 
 void ParticleSystem::resize(int num)
 {
-    if (num == (int)ps.size())
+    if (buffers[0] && (num == size()))
     {
         return;
     }
 
-#   pragma omp parallel for
-    for (size_t i = num; i < ps.size(); i++)
+    const int kept = std::min(num, size());
+
+    OpenGL::render_begin();
+    GLuint resized[2];
+    GL_CALL(glGenBuffers(2, resized));
+    for (auto buffer : resized)
     {
-        if (ps[i].life >= 0)
+        GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, buffer));
+        GL_CALL(glBufferData(GL_ARRAY_BUFFER, num * floats_per_particle * sizeof(float),
+            NULL, GL_DYNAMIC_COPY));
+    }
+
+    /* New slots start dead */
+    if (num > kept)
+    {
+        Particle dead{};
+        dead.pos    = {-10000, -10000};
+        dead.radius = dead.base_radius = 0;
+        dead.fade   = 0;
+
+        std::vector<float> data((num - kept) * floats_per_particle);
+        for (int i = 0; i < num - kept; i++)
         {
-            --particles_alive;
+            pack(dead, data.data() + i * floats_per_particle);
         }
+
+        GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, kept * floats_per_particle * sizeof(float),
+            data.size() * sizeof(float), data.data()));
     }
 
-    ps.resize(num);
+    if (kept > 0)
+    {
+        GL_CALL(glBindBuffer(GL_COPY_READ_BUFFER, buffers[current]));
+        GL_CALL(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0, 0,
+            kept * floats_per_particle * sizeof(float)));
+        GL_CALL(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+    }
+
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    GL_CALL(glDeleteBuffers(2, buffers));
+    OpenGL::render_end();
 
-    color.resize(color_per_particle * num);
-    dark_color.resize(color_per_particle * num);
-    radius.resize(radius_per_particle * num);
-    center.resize(center_per_particle * num);
+    /* The last buffer set up above holds the state */
+    buffers[0] = resized[0];
+    buffers[1] = resized[1];
+    current    = 1;
+    death_step.resize(num, 0);
+    cpu_state.resize(num);
+    rebuild_free_slots();
 }
 
 int ParticleSystem::size()
 {
-    return ps.size();
+    return death_step.size();
 }
 
-void ParticleSystem::update_worker(float time, int i)
+void ParticleSystem::update()
 {
-    if (ps[i].life <= 0)
+    if (dying.empty())
     {
+        ++current_step;
         return;
     }
 
-    ps[i].update(time);
+    if (update_program)
+    {
+        OpenGL::render_begin();
+        GL_CALL(glUseProgram(update_program));
+        GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, buffers[current]));
+        for (int i = 0; i < 4; i++)
+        {
+            GL_CALL(glEnableVertexAttribArray(i));
+            GL_CALL(glVertexAttribDivisor(i, 0));
+            GL_CALL(glVertexAttribPointer(i, 4, GL_FLOAT, GL_FALSE, floats_per_particle * sizeof(float),
+                (void*)(i * 4 * sizeof(float))));
+        }
+
+        GL_CALL(glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[1 - current]));
+        GL_CALL(glEnable(GL_RASTERIZER_DISCARD));
+        GL_CALL(glBeginTransformFeedback(GL_POINTS));
+        GL_CALL(glDrawArrays(GL_POINTS, 0, size()));
+        GL_CALL(glEndTransformFeedback());
+        GL_CALL(glDisable(GL_RASTERIZER_DISCARD));
+        GL_CALL(glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0));
 
-    if (ps[i].life <= 0)
+        for (int i = 0; i < 4; i++)
+        {
+            GL_CALL(glDisableVertexAttribArray(i));
+        }
+
+        GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+        GL_CALL(glUseProgram(0));
+        OpenGL::render_end();
+        current = 1 - current;
+    } else
     {
-        --particles_alive;
+        cpu_state.update();
+        upload_cpu_state();
     }
 
-    for (int j = 0; j < 4; j++) // maybe use memcpy?
+    ++current_step;
+    while (!dying.empty() && (dying.top().first <= current_step))
     {
-        color[4 * i + j] = ps[i].color[j];
-        dark_color[4 * i + j] = ps[i].color[j] * 0.5;
+        free_slots.push_back(dying.top().second);
+        dying.pop();
     }
-
-    center[2 * i]     = ps[i].pos[0];
-    center[2 * i + 1] = ps[i].pos[1];
-
-    radius[i] = ps[i].radius;
 }
 
-void ParticleSystem::update()
+void ParticleSystem::upload_cpu_state()
 {
-    // FIXME: don't hardcode 60FPS
-    float time = (wf::get_current_time() - last_update_msec) / 16.0;
-    last_update_msec = wf::get_current_time();
-
-#   pragma omp parallel for
-    for (size_t i = 0; i < ps.size(); i++)
+    std::vector<float> data(size() * floats_per_particle);
+    for (int i = 0; i < size(); i++)
     {
-        update_worker(time, i);
+        pack(cpu_state.get(i), data.data() + i * floats_per_particle);
     }
+
+    OpenGL::render_begin();
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, buffers[current]));
+    GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, 0, data.size() * sizeof(float), data.data()));
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    OpenGL::render_end();
 }
 
 int ParticleSystem::statistic()
 {
-    return particles_alive;
+    return size() - free_slots.size();
 }
 
 void ParticleSystem::create_program()
@@ -156,6 +365,37 @@ void ParticleSystem::create_program()
     OpenGL::render_begin();
     program.set_simple(OpenGL::compile_program(particle_vert_source,
         particle_frag_source));
+
+    /* The outputs have to be declared before linking, so the program is built by hand */
+    GLuint vertex_shader   = OpenGL::compile_shader(particle_update_vert_source, GL_VERTEX_SHADER);
+    GLuint fragment_shader = OpenGL::compile_shader(particle_update_frag_source, GL_FRAGMENT_SHADER);
+    if ((vertex_shader != (GLuint)-1) && (fragment_shader != (GLuint)-1))
+    {
+        static const char *outputs[] = {"out_life", "out_motion", "out_gravity", "out_color"};
+        update_program = GL_CALL(glCreateProgram());
+        GL_CALL(glAttachShader(update_program, vertex_shader));
+        GL_CALL(glAttachShader(update_program, fragment_shader));
+        GL_CALL(glTransformFeedbackVaryings(update_program, 4, outputs, GL_INTERLEAVED_ATTRIBS));
+        GL_CALL(glLinkProgram(update_program));
+
+        GLint status = GL_FALSE;
+        GL_CALL(glGetProgramiv(update_program, GL_LINK_STATUS, &status));
+        if (status == GL_FALSE)
+        {
+            LOGE("Failed to link the fire particle update program");
+            GL_CALL(glDeleteProgram(update_program));
+            update_program = 0;
+        }
+    }
+
+    for (auto shader : {vertex_shader, fragment_shader})
+    {
+        if (shader != (GLuint)-1)
+        {
+            GL_CALL(glDeleteShader(shader));
+        }
+    }
+
     OpenGL::render_end();
 }
 
@@ -172,31 +412,37 @@ void ParticleSystem::render(glm::mat4 matrix)
     program.attrib_pointer("position", 2, 0, vertex_data);
     program.attrib_divisor("position", 0);
 
-    program.attrib_pointer("radius", 1, 0, radius.data());
+    /* The per-particle attributes come straight from the simulation buffer */
+    const int stride = floats_per_particle * sizeof(float);
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, buffers[current]));
+    program.attrib_pointer("radius", 1, stride, (void*)(2 * sizeof(float)));
     program.attrib_divisor("radius", 1);
 
-    program.attrib_pointer("center", 2, 0, center.data());
+    program.attrib_pointer("center", 2, stride, (void*)(4 * sizeof(float)));
     program.attrib_divisor("center", 1);
 
+    program.attrib_pointer("color", 4, stride, (void*)(12 * sizeof(float)));
+    program.attrib_divisor("color", 1);
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+
     // matrix
     program.uniformMatrix4f("matrix", matrix);
 
     /* Darken the background */
-    program.attrib_pointer("color", 4, 0, dark_color.data());
-    program.attrib_divisor("color", 1);
+    program.uniform1f("color_scale", 0.5);
 
     GL_CALL(glEnable(GL_BLEND));
     GL_CALL(glBlendFunc(GL_ZERO, GL_ONE_MINUS_SRC_ALPHA));
     program.uniform1f("smoothing", 0.7);
 
     // TODO: optimize shaders for this case
-    GL_CALL(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, ps.size()));
+    GL_CALL(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, size()));
 
     // particle color
-    program.attrib_pointer("color", 4, 0, color.data());
+    program.uniform1f("color_scale", 1.0);
     GL_CALL(glBlendFunc(GL_SRC_ALPHA, GL_ONE));
     program.uniform1f("smoothing", 0.5);
-    GL_CALL(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, ps.size()));
+    GL_CALL(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, size()));
 
     GL_CALL(glDisable(GL_BLEND));
     GL_CALL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
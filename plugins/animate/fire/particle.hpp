@@ -3,7 +3,7 @@
 
 #include <wayfire/opengl.hpp>
 #include <functional>
-#include <atomic>
+#include <queue>
 #include <vector>
 
 struct Particle
@@ -17,16 +17,41 @@ struct Particle
     glm::vec2 start_pos;
 
     glm::vec4 color{1.0, 1.0, 1.0, 1.0};
+};
+
+/**
+ * The particle state in a structure-of-arrays layout, used when the particles are simulated on the CPU.
+ * Every field is a separate array so that the update loop can be vectorized by the compiler.
+ */
+struct particle_arrays_t
+{
+    std::vector<float> life, fade, radius, base_radius;
+    std::vector<float> pos_x, pos_y, speed_x, speed_y;
+    std::vector<float> g_x, g_y, start_x, start_y;
+    std::vector<float> r, g, b, a;
 
-    /* update the given particle
-     * time is the percentage of the frame which has elapsed
-     * must be thread-safe */
-    void update(float time);
+    void resize(size_t num);
+    void set(size_t i, const Particle& p);
+    Particle get(size_t i) const;
+
+    /* advance all particles by one step */
+    void update();
 };
 
 /* a function to initialize a particle */
 using ParticleIniter = std::function<void (Particle&)>;
 
+/**
+ * The particles live in GPU buffers. Each update runs the simulation in a vertex shader, whose results are
+ * captured with transform feedback into a second buffer, and the particles are rendered directly from the
+ * buffer holding the latest state. Only newly spawned particles are uploaded.
+ *
+ * Since the lifetime of a particle only depends on its initial life and fade, the CPU knows in advance the
+ * update in which each particle dies, and uses that to keep a list of free slots.
+ *
+ * If transform feedback is not available, the particles are simulated on the CPU instead, see
+ * particle_arrays_t, and the whole buffer is uploaded after each update.
+ */
 class ParticleSystem
 {
   public:
@@ -67,23 +92,34 @@ class ParticleSystem
     ParticleSystem() = delete;
 
     ParticleIniter pinit_func = [] (auto) {};
-    uint32_t last_update_msec;
 
-    std::atomic<int> particles_alive;
-    std::vector<Particle> ps;
-
-    static constexpr int color_per_particle = 4;
-    std::vector<float> color, dark_color;
-
-    static constexpr int radius_per_particle = 1;
-    std::vector<float> radius;
-
-    static constexpr int center_per_particle = 2;
-    std::vector<float> center;
+    /* the number of updates done so far */
+    uint32_t current_step = 0;
+    /* for each particle, the update after which it is dead (it is dead when <= current_step) */
+    std::vector<uint32_t> death_step;
+    /* dead particles, which can be spawned again */
+    std::vector<int> free_slots;
+    /* alive particles, ordered by the update in which they die */
+    std::priority_queue<std::pair<uint32_t, int>, std::vector<std::pair<uint32_t, int>>,
+        std::greater<>> dying;
+    void rebuild_free_slots();
+
+    /* the layout of a particle in the GPU buffers, see particle_update_vert_source */
+    static constexpr int floats_per_particle = 16;
+    static void pack(const Particle& p, float *data);
+    static uint32_t count_updates_to_death(const Particle& p);
+
+    /* the buffer with the current state and the buffer which receives the next one */
+    GLuint buffers[2] = {0, 0};
+    int current = 0;
 
     OpenGL::program_t program;
-    void update_worker(float time, int i);
+    GLuint update_program = 0;
     void create_program();
+
+    /* the CPU fallback, used when update_program could not be created */
+    particle_arrays_t cpu_state;
+    void upload_cpu_state();
 };
 
 
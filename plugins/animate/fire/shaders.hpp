@@ -11,6 +11,7 @@ attribute mediump vec2 center;
 attribute mediump vec4 color;
 
 uniform mat4 matrix;
+uniform mediump float color_scale;
 
 varying mediump vec2 uv;
 varying mediump vec4 out_color;
@@ -21,7 +22,7 @@ void main() {
     gl_Position = matrix * vec4(center.x + uv.x * 0.75, center.y + uv.y, 0.0, 1.0);
 
     R = radius;
-    out_color = color;
+    out_color = color * color_scale;
 }
 )";
 
@@ -50,4 +51,59 @@ void main()
 }
 )";
 
+/* Advances the particles by one step, the results are captured with transform
+ * feedback. A particle is laid out as four vec4s, matching the inputs. */
+static const char *particle_update_vert_source =
+    R"(
+#version 300 es
+
+layout(location = 0) in highp vec4 life;    // life, fade, radius, base radius
+layout(location = 1) in highp vec4 motion;  // position, speed
+layout(location = 2) in highp vec4 gravity; // gravity, start position
+layout(location = 3) in highp vec4 color;
+
+out highp vec4 out_life;
+out highp vec4 out_motion;
+out highp vec4 out_gravity;
+out highp vec4 out_color;
+
+void main()
+{
+    out_life    = life;
+    out_motion  = motion;
+    out_gravity = gravity;
+    out_color   = color;
+    if (life.x <= 0.0)
+    {
+        return;
+    }
+
+    const highp float slowdown = 0.8;
+    highp vec2 pos   = motion.xy + motion.zw * 0.2 * slowdown;
+    highp vec2 speed = motion.zw + gravity.xy * 0.3 * slowdown;
+
+    highp float alpha = color.a / life.x;
+    out_life.x  = life.x - life.y * 0.3 * slowdown;
+    out_life.z  = life.w * sqrt(max(out_life.x, 0.0));
+    out_color.a = alpha * out_life.x;
+
+    out_gravity.x = (gravity.z < pos.x) ? -1.0 : 1.0;
+    if (out_life.x <= 0.0)
+    {
+        /* move outside */
+        pos = vec2(-10000.0, -10000.0);
+    }
+
+    out_motion = vec4(pos, speed);
+}
+)";
+
+static const char *particle_update_frag_source =
+    R"(
+#version 300 es
+
+void main()
+{}
+)";
+
 #endif /* end of include guard: PARTICLE_ANIMATION_SHADER */
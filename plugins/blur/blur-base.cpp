@@ -7,6 +7,8 @@
 #include <wayfire/output.hpp>
 #include <wayfire/workspace-set.hpp>
 #include <wayfire/util/log.hpp>
+#include <algorithm>
+#include <cmath>
 
 static const char *blur_blend_vertex_shader =
     R"(
@@ -82,17 +84,33 @@ wf_blur_base::wf_blur_base(std::string name)
 wf_blur_base::~wf_blur_base()
 {
     OpenGL::render_begin();
-    fb[0].release();
-    fb[1].release();
+    fb[0].release_to_pool();
+    fb[1].release_to_pool();
     program[0].free_resources();
     program[1].free_resources();
     blend_program.free_resources();
     OpenGL::render_end();
 }
 
+int wf_blur_base::get_iterations()
+{
+    const int iterations = iterations_opt;
+    if (iterations <= 0)
+    {
+        return iterations;
+    }
+
+    return std::max(1, (int)std::round(iterations * quality));
+}
+
+void wf_blur_base::set_quality(double quality)
+{
+    this->quality = std::clamp(quality, 0.0, 1.0);
+}
+
 int wf_blur_base::calculate_blur_radius()
 {
-    return offset_opt * degrade_opt * std::max(1, (int)iterations_opt);
+    return offset_opt * degrade_opt * std::max(1, get_iterations());
 }
 
 void wf_blur_base::render_iteration(wf::region_t blur_region,
@@ -104,7 +122,7 @@ void wf_blur_base::render_iteration(wf::region_t blur_region,
     width  = std::max(width, 1);
     height = std::max(height, 1);
 
-    out.allocate(width, height);
+    out.allocate_from_pool(width, height);
     out.bind();
 
     GL_CALL(glBindTexture(GL_TEXTURE_2D, in.tex));
@@ -163,7 +181,7 @@ wlr_box wf_blur_base::copy_region(wf::framebuffer_t& result,
     int degraded_height = subbox.height / degrade_opt;
 
     OpenGL::render_begin(source);
-    result.allocate(degraded_width, degraded_height);
+    result.allocate_from_pool(degraded_width, degraded_height);
 
     GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER, source.fb));
     GL_CALL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, result.fb));
@@ -220,6 +238,29 @@ static wf::pointf_t get_center(wf::geometry_t g)
 
 void wf_blur_base::render(wf::texture_t src_tex, wlr_box src_box, const wf::region_t& damage,
     const wf::render_target_t& background_source_fb, const wf::render_target_t& target_fb)
+{
+    blend_background(fb[0].tex, prepared_geometry, src_tex, src_box, damage,
+        background_source_fb, target_fb);
+}
+
+void wf_blur_base::save_prepared_blur(blurred_background_t& background)
+{
+    // The old buffer of the background is reallocated on the next prepare_blur().
+    std::swap(background.fb, fb[0]);
+    background.geometry = prepared_geometry;
+}
+
+void wf_blur_base::render(const blurred_background_t& background, wf::texture_t src_tex, wlr_box src_box,
+    const wf::region_t& damage, const wf::render_target_t& background_source_fb,
+    const wf::render_target_t& target_fb)
+{
+    blend_background(background.fb.tex, background.geometry, src_tex, src_box, damage,
+        background_source_fb, target_fb);
+}
+
+void wf_blur_base::blend_background(GLuint bg_tex, wlr_box bg_geometry, wf::texture_t src_tex,
+    wlr_box src_box, const wf::region_t& damage, const wf::render_target_t& background_source_fb,
+    const wf::render_target_t& target_fb)
 {
     OpenGL::render_begin(target_fb);
     blend_program.use(src_tex.type);
@@ -253,8 +294,8 @@ void wf_blur_base::render(wf::texture_t src_tex, wlr_box src_box, const wf::regi
     // 3. Scale to match the view size
     // 4. Translate to match the view
     auto view_box    = background_source_fb.framebuffer_box_from_geometry_box(src_box); // Projected view
-    auto blurred_box = prepared_geometry;
-    // prepared_geometry is the projected damage bounding box
+    auto blurred_box = bg_geometry;
+    // bg_geometry is the projected damage bounding box
 
     glm::mat4 fb_fix   = target_fb.transform;
     const auto scale_x = 1.0 * view_box.width / blurred_box.width;
@@ -277,7 +318,7 @@ void wf_blur_base::render(wf::texture_t src_tex, wlr_box src_box, const wf::regi
 
     blend_program.set_active_texture(src_tex);
     GL_CALL(glActiveTexture(GL_TEXTURE0 + 1));
-    GL_CALL(glBindTexture(GL_TEXTURE_2D, fb[0].tex));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, bg_tex));
     /* Render it to target_fb */
     target_fb.bind();
 
@@ -315,6 +356,11 @@ std::unique_ptr<wf_blur_base> create_blur_from_name(std::string algorithm_name)
         return create_kawase_blur();
     }
 
+    if (algorithm_name == "dual_kawase")
+    {
+        return create_dual_kawase_blur();
+    }
+
     if (algorithm_name == "gaussian")
     {
         return create_gaussian_blur();
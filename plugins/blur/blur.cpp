@@ -5,6 +5,7 @@
 #include <wayfire/view.hpp>
 #include <wayfire/matcher.hpp>
 #include <wayfire/output.hpp>
+#include <wayfire/render-manager.hpp>
 #include <wayfire/view-transform.hpp>
 #include <wayfire/workspace-stream.hpp>
 #include <wayfire/workspace-set.hpp>
@@ -15,6 +16,7 @@
 #include "wayfire/core.hpp"
 #include "wayfire/debug.hpp"
 #include "wayfire/geometry.hpp"
+#include "wayfire/gpu-memory.hpp"
 #include "wayfire/opengl.hpp"
 #include "wayfire/region.hpp"
 #include "wayfire/scene-render.hpp"
@@ -23,6 +25,8 @@
 
 using blur_algorithm_provider =
     std::function<nonstd::observer_ptr<wf_blur_base>()>;
+/** Returns a reference which keeps the render pass hook of the plugin connected. */
+using blur_render_hook_provider = std::function<std::shared_ptr<void>()>;
 
 static int calculate_damage_padding(const wf::render_target_t& target, int blur_radius)
 {
@@ -45,9 +49,13 @@ class blur_node_t : public transformer_base_node_t
 {
   public:
     blur_algorithm_provider provider;
-    blur_node_t(blur_algorithm_provider provider) : transformer_base_node_t(false)
+    blur_render_hook_provider acquire_render_hook;
+    blur_node_t(blur_algorithm_provider provider, blur_render_hook_provider acquire_render_hook) :
+        transformer_base_node_t(false)
     {
         this->provider = provider;
+        this->acquire_render_hook = acquire_render_hook;
+        wf::get_core().connect(&on_trim);
     }
 
     ~blur_node_t()
@@ -55,7 +63,7 @@ class blur_node_t : public transformer_base_node_t
         OpenGL::render_begin();
         for (auto& buffer : saved_pixels)
         {
-            buffer.pixels.release();
+            buffer.pixels.release_to_pool();
         }
 
         OpenGL::render_end();
@@ -97,14 +105,221 @@ class blur_node_t : public transformer_base_node_t
     {
         buffer->taken = false;
     }
+
+    // The saved pixels are only needed while a frame is rendered, see wf::gpu_memory::trim().
+    wf::signal::connection_t<wf::gpu_memory::trim_signal> on_trim = [=] (wf::gpu_memory::trim_signal*)
+    {
+        OpenGL::render_begin();
+        for (auto it = saved_pixels.begin(); it != saved_pixels.end();)
+        {
+            if (it->taken)
+            {
+                ++it;
+                continue;
+            }
+
+            it->pixels.release_to_pool();
+            it = saved_pixels.erase(it);
+        }
+
+        OpenGL::render_end();
+    };
 };
 
 class blur_render_instance_t : public transformer_render_instance_t<blur_node_t>
 {
     blur_node_t::saved_pixels_t *saved_pixels = nullptr;
+    // The damage of render passes needs to be expanded only while blurred views are shown somewhere.
+    std::shared_ptr<void> render_hook;
+
+    /**
+     * Everything which determines how the background of the view is blurred, other than the contents below
+     * the view.
+     */
+    struct background_key_t
+    {
+        wf::geometry_t bbox;
+        wf::geometry_t target_geometry;
+        float scale;
+        wl_output_transform wl_transform;
+        std::optional<wf::geometry_t> subbuffer;
+        wf_blur_base *algorithm;
+        int radius;
+
+        bool operator ==(const background_key_t& other) const
+        {
+            return bbox == other.bbox && target_geometry == other.target_geometry && scale == other.scale &&
+                   wl_transform == other.wl_transform && subbuffer == other.subbuffer &&
+                   algorithm == other.algorithm && radius == other.radius;
+        }
+    };
+
+    // The blurred background from the last frame on which the background was blurred. It can be reused as
+    // long as nothing on the output was damaged, except for the view itself.
+    blurred_background_t cached_background;
+    // The part of the cached background which is valid, in the coordinate system of the render target.
+    wf::region_t cached_region;
+    std::optional<background_key_t> cached_key;
+    uint64_t cached_generation = 0;
+
+    // The state for the current frame, set in schedule_instructions().
+    bool use_cached_background = false;
+    background_key_t frame_key;
+    uint64_t frame_generation = 0;
+    // The damage within the view, without the padding for blurring.
+    wf::region_t frame_blur_region;
+
+    uint64_t get_damage_generation()
+    {
+        return _shown_on ? _shown_on->render->get_damage_generation() : 0;
+    }
+
+    // Merging of blur passes: if several blurred views need a new background in the same render pass, and
+    // nothing is rendered in the areas they blur between them, the lowest of them (the one which is rendered
+    // first) blurs the background of all of them at once, and the others reuse the result.
+    struct pending_blur_t
+    {
+        // The leader of a group of views which may still be merged with a view below
+        blur_render_instance_t *instance;
+        const std::vector<render_instruction_t> *instructions;
+    };
+
+    static std::vector<pending_blur_t>& get_pending_blurs()
+    {
+        static std::vector<pending_blur_t> pending;
+        return pending;
+    }
+
+    // The state for the current frame, for merging.
+    wf::render_target_t frame_target;
+    size_t frame_index = 0;
+    // The region repainted by this instance, including the padding, in framebuffer coordinates
+    wf::region_t frame_repaint;
+    // The region whose background is blurred, in the coordinates of frame_target
+    wf::region_t frame_translucent;
+    // The views whose background is blurred together with ours, if we are the leader of a group
+    std::vector<blur_render_instance_t*> merged;
+    // The background blurred by the leader of our group, if we are merged into another view
+    const blurred_background_t *shared_background = nullptr;
+
+    static bool same_target(const wf::render_target_t& a, const wf::render_target_t& b)
+    {
+        return a.fb == b.fb && a.geometry == b.geometry && a.scale == b.scale &&
+               a.wl_transform == b.wl_transform && a.subbuffer == b.subbuffer;
+    }
+
+    static int64_t extents_area(const wf::region_t& region)
+    {
+        auto box = region.get_extents();
+        return int64_t(box.x2 - box.x1) * (box.y2 - box.y1);
+    }
+
+    /**
+     * Check whether the background of a view scheduled earlier in the render pass (i.e. above us) is
+     * already complete when we render, so that we can blur it together with ours.
+     */
+    bool is_background_complete(blur_render_instance_t *other,
+        const std::vector<render_instruction_t>& instructions)
+    {
+        if (!(frame_repaint & other->frame_repaint).empty())
+        {
+            return false;
+        }
+
+        for (size_t i = other->frame_index + 1; i < instructions.size(); i++)
+        {
+            const auto& instruction = instructions[i];
+            if ((instruction.target.fb == frame_target.fb) &&
+                !(instruction.target.framebuffer_region_from_geometry_region(instruction.damage) &
+                  other->frame_repaint).empty())
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    void merge_pending_blurs(const std::vector<render_instruction_t>& instructions)
+    {
+        auto& pending = get_pending_blurs();
+        for (auto it = pending.begin(); it != pending.end();)
+        {
+            auto leader = it->instance;
+            if (it->instructions != &instructions)
+            {
+                // A different render pass, possibly one which we are nested in
+                ++it;
+                continue;
+            }
+
+            if ((leader->frame_index >= instructions.size()) ||
+                (instructions[leader->frame_index].instance != leader))
+            {
+                // Left over from an earlier render pass
+                it = pending.erase(it);
+                continue;
+            }
+
+            bool can_merge = same_target(leader->frame_target, frame_target) &&
+                (leader->self->provider().get() == self->provider().get());
+
+            std::vector<blur_render_instance_t*> group = leader->merged;
+            group.push_back(leader);
+            wf::region_t group_region = frame_translucent;
+            int64_t separate_area     = extents_area(frame_translucent);
+            for (auto member : group)
+            {
+                can_merge &= is_background_complete(member, instructions);
+                group_region  |= member->frame_translucent;
+                separate_area += extents_area(member->frame_translucent);
+            }
+
+            // Blurring one big box which is mostly empty is more expensive than blurring the views apart.
+            can_merge &= (2 * extents_area(group_region) <= 3 * separate_area);
+            if (!can_merge)
+            {
+                ++it;
+                continue;
+            }
+
+            leader->merged.clear();
+            merged.insert(merged.end(), group.begin(), group.end());
+            it = pending.erase(it);
+        }
+    }
 
   public:
-    using transformer_render_instance_t::transformer_render_instance_t;
+    blur_render_instance_t(blur_node_t *self, damage_callback push_damage, wf::output_t *shown_on) :
+        transformer_render_instance_t(self, [this, push_damage] (const wf::region_t& region)
+    {
+        // Damage from the view itself does not change what is below it, so it should not
+        // invalidate the cached background.
+        const uint64_t generation = get_damage_generation();
+        push_damage(region);
+        if (cached_generation == generation)
+        {
+            cached_generation = get_damage_generation();
+        }
+    }, shown_on)
+    {
+        if (self->acquire_render_hook)
+        {
+            render_hook = self->acquire_render_hook();
+        }
+    }
+
+    ~blur_render_instance_t()
+    {
+        auto& pending = get_pending_blurs();
+        pending.erase(std::remove_if(pending.begin(), pending.end(),
+            [this] (const pending_blur_t& p) { return p.instance == this; }), pending.end());
+
+        OpenGL::render_begin();
+        cached_background.fb.release_to_pool();
+        OpenGL::render_end();
+    }
+
     bool is_fully_opaque(wf::region_t damage)
     {
         if (self->get_children().size() == 1)
@@ -140,6 +355,9 @@ class blur_render_instance_t : public transformer_render_instance_t<blur_node_t>
     void schedule_instructions(std::vector<render_instruction_t>& instructions,
         const wf::render_target_t& target, wf::region_t& damage) override
     {
+        // Fewer iterations while the output is under load. The cached background is keyed by the radius,
+        // so it is blurred again when the quality changes.
+        self->provider()->set_quality(_shown_on ? _shown_on->render->get_effect_quality("blur") : 1.0);
         const int padding = calculate_damage_padding(target, self->provider()->calculate_blur_radius());
         auto bbox = self->get_bounding_box();
 
@@ -164,6 +382,47 @@ class blur_render_instance_t : public transformer_render_instance_t<blur_node_t>
             return;
         }
 
+        padded_region &= target.geometry;
+        frame_key = background_key_t{
+            .bbox = bbox,
+            .target_geometry = target.geometry,
+            .scale     = target.scale,
+            .wl_transform = target.wl_transform,
+            .subbuffer = target.subbuffer,
+            .algorithm = self->provider().get(),
+            .radius    = self->provider()->calculate_blur_radius(),
+        };
+        frame_generation  = get_damage_generation();
+        shared_background = nullptr;
+        merged.clear();
+
+        const bool background_unchanged = _shown_on && (cached_key == frame_key) &&
+            (cached_generation == frame_generation);
+        if (background_unchanged &&
+            (calculate_translucent_damage(target, padded_region) ^ cached_region).empty())
+        {
+            // Nothing below the view changed since the background was blurred, so we can reuse it and
+            // don't need any padding either.
+            use_cached_background = true;
+            instructions.push_back(render_instruction_t{
+                        .instance = this,
+                        .target   = target,
+                        .damage   = padded_region,
+                    });
+            return;
+        }
+
+        use_cached_background = false;
+        if (background_unchanged)
+        {
+            // The view was damaged in a different place than the part of the background which we have,
+            // for example a terminal over a static wallpaper. Blur the background behind the whole view
+            // once, so that the next frames can simply reuse it. The additional area is restored from the
+            // saved pixels, as is the padding.
+            padded_region = bbox & target.geometry;
+        }
+
+        frame_blur_region = padded_region;
         padded_region.expand_edges(padding);
         padded_region &= bbox;
 
@@ -184,7 +443,8 @@ class blur_render_instance_t : public transformer_render_instance_t<blur_node_t>
         damage |= padded_region;
 
         OpenGL::render_begin();
-        saved_pixels->pixels.allocate(target.viewport_width, target.viewport_height);
+        wf::gpu_memory::node_scope_t memory_scope{self.get()};
+        saved_pixels->pixels.allocate_from_pool(target.viewport_width, target.viewport_height);
         saved_pixels->pixels.bind();
         GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER, target.fb));
 
@@ -199,22 +459,63 @@ class blur_render_instance_t : public transformer_render_instance_t<blur_node_t>
         }
 
         OpenGL::render_end();
+
+        frame_target  = target;
+        frame_repaint = target.framebuffer_region_from_geometry_region(we_repaint);
+        frame_translucent = calculate_translucent_damage(target, we_repaint);
+        merge_pending_blurs(instructions);
+
         instructions.push_back(render_instruction_t{
                     .instance = this,
                     .target   = target,
                     .damage   = we_repaint,
                 });
+
+        // If the background did not change, we are only blurring the whole view to fill the cache, which
+        // would not happen if another view below blurs for us.
+        if (!background_unchanged)
+        {
+            frame_index = instructions.size() - 1;
+            get_pending_blurs().push_back({this, &instructions});
+        }
     }
 
     void render(const wf::render_target_t& target, const wf::region_t& damage) override
     {
         auto tex = get_texture(target.scale);
         auto bounding_box = self->get_bounding_box();
-        if (!damage.empty())
+        if (use_cached_background)
+        {
+            self->provider()->render(cached_background, tex, bounding_box, damage, target, target);
+            return;
+        }
+
+        if (shared_background)
+        {
+            self->provider()->render(*shared_background, tex, bounding_box, damage, target, target);
+            shared_background = nullptr;
+        } else if (!damage.empty())
         {
             auto translucent_damage = calculate_translucent_damage(target, damage);
+            for (auto view : merged)
+            {
+                translucent_damage |= view->frame_translucent;
+            }
+
             self->provider()->prepare_blur(target, translucent_damage);
-            self->provider()->render(tex, bounding_box, damage, target, target);
+            self->provider()->save_prepared_blur(cached_background);
+            self->provider()->render(cached_background, tex, bounding_box, damage, target, target);
+
+            // Only the part without padding is blurred correctly.
+            cached_region     = calculate_translucent_damage(target, frame_blur_region);
+            cached_key        = frame_key;
+            cached_generation = frame_generation;
+            for (auto view : merged)
+            {
+                view->shared_background = &cached_background;
+            }
+
+            merged.clear();
         }
 
         OpenGL::render_begin(target);
@@ -263,22 +564,39 @@ void blur_node_t::gen_render_instances(std::vector<render_instance_uptr>& instan
 
 class wayfire_blur : public wf::plugin_interface_t
 {
+    using render_pass_hook_t = wf::signal::connection_t<wf::scene::render_pass_begin_signal>;
+    std::weak_ptr<render_pass_hook_t> render_pass_hook;
+
     // Before doing a render pass, expand the damage by the blur radius.
     // This is needed, because when blurring, the pixels that changed
     // affect a larger area than the really damaged region, e.g. the region
     // that comes from client damage.
-    wf::signal::connection_t<wf::scene::render_pass_begin_signal>
-    on_render_pass_begin = [=] (wf::scene::render_pass_begin_signal *ev)
+    //
+    // The hook is shared by the render instances of the blurred views, so it is connected only as long as
+    // one of them is shown. Otherwise, render passes do not emit the signal at all.
+    std::shared_ptr<void> acquire_render_hook()
     {
-        if (!provider)
+        if (auto hook = render_pass_hook.lock())
         {
-            return;
+            return hook;
         }
 
-        const int padding = calculate_damage_padding(ev->target, provider()->calculate_blur_radius());
-        ev->damage.expand_edges(padding);
-        ev->damage &= ev->target.geometry;
-    };
+        auto hook = std::make_shared<render_pass_hook_t>([=] (wf::scene::render_pass_begin_signal *ev)
+        {
+            if (!provider)
+            {
+                return;
+            }
+
+            const int padding = calculate_damage_padding(ev->target, provider()->calculate_blur_radius());
+            ev->damage.expand_edges(padding);
+            ev->damage &= ev->target.geometry;
+        });
+
+        wf::get_core().connect(hook.get());
+        render_pass_hook = hook;
+        return hook;
+    }
 
   public:
     blur_algorithm_provider provider;
@@ -310,7 +628,10 @@ class wayfire_blur : public wf::plugin_interface_t
             return blur_algorithm.get();
         };
 
-        auto node = std::make_shared<wf::scene::blur_node_t>(provider);
+        auto node = std::make_shared<wf::scene::blur_node_t>(provider, [=] ()
+        {
+            return acquire_render_hook();
+        });
         tmanager->add_transformer(node, wf::TRANSFORMER_BLUR);
     }
 
@@ -331,7 +652,6 @@ class wayfire_blur : public wf::plugin_interface_t
   public:
     void init() override
     {
-        wf::get_core().connect(&on_render_pass_begin);
         blur_method_changed = [=] ()
         {
             blur_algorithm = create_blur_from_name(method_opt);
@@ -379,6 +699,10 @@ class wayfire_blur : public wf::plugin_interface_t
     {
         remove_transformers();
         wf::get_core().bindings->rem_binding(&button_toggle);
+        if (auto hook = render_pass_hook.lock())
+        {
+            hook->disconnect();
+        }
 
         /* Call blur algorithm destructor */
         blur_algorithm = nullptr;
@@ -88,6 +88,17 @@
  * `````````````````````````````````````````````````````````````````
  */
 
+/**
+ * A blurred background which was prepared by wf_blur_base::prepare_blur() and saved for later reuse, see
+ * wf_blur_base::save_prepared_blur().
+ */
+struct blurred_background_t
+{
+    wf::framebuffer_t fb;
+    /* The blurred area, in framebuffer coordinates of the render target it was prepared from */
+    wlr_box geometry;
+};
+
 class wf_blur_base
 {
   protected:
@@ -111,6 +122,12 @@ class wf_blur_base
     wf::option_wrapper_t<int> degrade_opt, iterations_opt;
     wf::config::option_base_t::updated_callback_t options_changed;
 
+    /* the share of the configured iterations to use, see set_quality() */
+    double quality = 1.0;
+
+    /* the number of iterations to run, at least 1 unless blur is disabled with 0 iterations */
+    int get_iterations();
+
     /* renders the in texture to the out framebuffer.
      * assumes a properly bound and initialized GL program */
     void render_iteration(wf::region_t blur_region,
@@ -127,12 +144,25 @@ class wf_blur_base
      * returns the index of the fb where the result is stored (0 or 1) */
     virtual int blur_fb0(const wf::region_t& blur_region, int width, int height) = 0;
 
+    /* render src_tex blended with the blurred background in bg_tex, which covers bg_geometry */
+    void blend_background(GLuint bg_tex, wlr_box bg_geometry, wf::texture_t src_tex, wlr_box src_box,
+        const wf::region_t& damage, const wf::render_target_t& background_source_fb,
+        const wf::render_target_t& target_fb);
+
   public:
     wf_blur_base(std::string name);
     virtual ~wf_blur_base();
 
     virtual int calculate_blur_radius();
 
+    /**
+     * Scale down the configured number of iterations while the output is under load, see
+     * render_manager::get_effect_quality(). This also changes the blur radius.
+     *
+     * @param quality Between 0 and 1, where 1 means the configured iterations.
+     */
+    void set_quality(double quality);
+
     /**
      * Calculate the blurred background region.
      *
@@ -152,10 +182,26 @@ class wf_blur_base
      */
     void render(wf::texture_t src_tex, wlr_box src_box, const wf::region_t& damage,
         const wf::render_target_t& background_source_fb, const wf::render_target_t& target_fb);
+
+    /**
+     * Move the background prepared by the last call of @prepare_blur to @background, so that it can be
+     * used in later frames, as long as the contents below stay the same. The prepared background is no
+     * longer available for @render afterwards.
+     */
+    void save_prepared_blur(blurred_background_t& background);
+
+    /**
+     * Same as @render, but blends the view with a background saved by @save_prepared_blur instead of the
+     * one from the last @prepare_blur.
+     */
+    void render(const blurred_background_t& background, wf::texture_t src_tex, wlr_box src_box,
+        const wf::region_t& damage, const wf::render_target_t& background_source_fb,
+        const wf::render_target_t& target_fb);
 };
 
 std::unique_ptr<wf_blur_base> create_box_blur();
 std::unique_ptr<wf_blur_base> create_bokeh_blur();
 std::unique_ptr<wf_blur_base> create_kawase_blur();
+std::unique_ptr<wf_blur_base> create_dual_kawase_blur();
 std::unique_ptr<wf_blur_base> create_gaussian_blur();
 std::unique_ptr<wf_blur_base> create_blur_from_name(std::string algorithm_name);
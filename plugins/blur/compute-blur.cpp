@@ -0,0 +1,141 @@
+#include "compute-blur.hpp"
+#include <config.h>
+#include <wayfire/util/log.hpp>
+
+#ifdef USE_GLES32
+    #include <GLES3/gl32.h>
+#endif
+
+/** @return Smallest integer >= x which is divisible by mod */
+static int round_up(int x, int mod)
+{
+    return mod * int((x + mod - 1) / mod);
+}
+
+bool compute_blur_t::is_supported()
+{
+#ifdef USE_GLES32
+    GLint major = 0, minor = 0;
+    GL_CALL(glGetIntegerv(GL_MAJOR_VERSION, &major));
+    GL_CALL(glGetIntegerv(GL_MINOR_VERSION, &minor));
+    return (major > 3) || ((major == 3) && (minor >= 1));
+#else
+    return false;
+#endif
+}
+
+compute_blur_t::~compute_blur_t()
+{
+    OpenGL::render_begin();
+    for (auto& [_, buffer] : scratch)
+    {
+        GL_CALL(glDeleteFramebuffers(1, &buffer.fb));
+        GL_CALL(glDeleteTextures(1, &buffer.tex));
+    }
+
+    for (auto program : programs)
+    {
+        GL_CALL(glDeleteProgram(program));
+    }
+
+    OpenGL::render_end();
+}
+
+GLuint compute_blur_t::compile(const char *source)
+{
+#ifdef USE_GLES32
+    if (!is_supported())
+    {
+        return 0;
+    }
+
+    GLuint shader = OpenGL::compile_shader(source, GL_COMPUTE_SHADER);
+    if (shader == (GLuint)-1)
+    {
+        return 0;
+    }
+
+    GLuint program = GL_CALL(glCreateProgram());
+    GL_CALL(glAttachShader(program, shader));
+    GL_CALL(glLinkProgram(program));
+    GL_CALL(glDeleteShader(shader));
+
+    GLint status = GL_FALSE;
+    GL_CALL(glGetProgramiv(program, GL_LINK_STATUS, &status));
+    if (status == GL_FALSE)
+    {
+        LOGE("Failed to link blur compute shader");
+        GL_CALL(glDeleteProgram(program));
+        return 0;
+    }
+
+    programs.push_back(program);
+    return program;
+#else
+    return 0;
+#endif
+}
+
+GLuint compute_blur_t::get_texture(int index, int width, int height)
+{
+    auto& buffer = scratch[index];
+    if ((buffer.width >= width) && (buffer.height >= height))
+    {
+        return buffer.tex;
+    }
+
+#ifdef USE_GLES32
+    // Immutable textures cannot be resized, so the old one is replaced.
+    GL_CALL(glDeleteFramebuffers(1, &buffer.fb));
+    GL_CALL(glDeleteTextures(1, &buffer.tex));
+
+    buffer.width  = round_up(std::max(width, buffer.width), 128);
+    buffer.height = round_up(std::max(height, buffer.height), 128);
+
+    GL_CALL(glGenTextures(1, &buffer.tex));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, buffer.tex));
+    GL_CALL(glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, buffer.width, buffer.height));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+
+    GL_CALL(glGenFramebuffers(1, &buffer.fb));
+    GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, buffer.fb));
+    GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, buffer.tex, 0));
+#endif
+
+    return buffer.tex;
+}
+
+wf::dimensions_t compute_blur_t::get_texture_size(int index)
+{
+    auto& buffer = scratch[index];
+    return {buffer.width, buffer.height};
+}
+
+void compute_blur_t::dispatch(GLuint program, GLuint input, int output, int groups_x, int groups_y)
+{
+#ifdef USE_GLES32
+    GL_CALL(glUseProgram(program));
+    GL_CALL(glActiveTexture(GL_TEXTURE0));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, input));
+    GL_CALL(glBindImageTexture(0, scratch[output].tex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8));
+    GL_CALL(glDispatchCompute(groups_x, groups_y, 1));
+
+    // The next pass samples the output, or it is copied to a framebuffer.
+    GL_CALL(glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT));
+    GL_CALL(glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+    GL_CALL(glUseProgram(0));
+#endif
+}
+
+void compute_blur_t::copy_to_framebuffer(int index, wf::framebuffer_t& out, int width, int height)
+{
+    GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER, scratch[index].fb));
+    GL_CALL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, out.fb));
+    GL_CALL(glBlitFramebuffer(0, 0, width, height, 0, 0, width, height,
+        GL_COLOR_BUFFER_BIT, GL_NEAREST));
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <wayfire/opengl.hpp>
+#include <map>
+
+/**
+ * Helper for running blur passes as compute shaders, which are available with GLES 3.1 and newer.
+ *
+ * A compute pass reads its input with a sampler and writes its output through an image unit. Image units
+ * need immutable textures, which the framebuffers of wf_blur_base are not, so the passes ping-pong between
+ * scratch textures owned by this class, and the result is copied back to a framebuffer at the end.
+ *
+ * Scratch textures only grow, so that they are not reallocated on every frame when the size of the blurred
+ * region changes. Shaders have to clamp their sampling to the size of the valid area themselves.
+ */
+class compute_blur_t
+{
+  public:
+    /** @return Whether the current GL context supports compute shaders. */
+    static bool is_supported();
+
+    compute_blur_t() = default;
+    ~compute_blur_t();
+
+    compute_blur_t(const compute_blur_t&) = delete;
+    compute_blur_t& operator =(const compute_blur_t&) = delete;
+
+    /**
+     * Compile a compute program. Must be called with the GL context current.
+     *
+     * @return The program, or 0 if compute shaders are not supported or the shader failed to compile.
+     */
+    GLuint compile(const char *source);
+
+    /** Get the scratch texture with the given index, which is at least @width x @height big. */
+    GLuint get_texture(int index, int width, int height);
+
+    /** Get the size of the scratch texture with the given index. */
+    wf::dimensions_t get_texture_size(int index);
+
+    /**
+     * Run a compute pass, reading from texture unit 0 and writing to image unit 0.
+     *
+     * @param input The texture to bind to texture unit 0.
+     * @param output The index of the scratch texture to bind to image unit 0.
+     */
+    void dispatch(GLuint program, GLuint input, int output, int groups_x, int groups_y);
+
+    /** Copy the top-left @width x @height pixels of a scratch texture to @out. */
+    void copy_to_framebuffer(int index, wf::framebuffer_t& out, int width, int height);
+
+  private:
+    struct scratch_t
+    {
+        GLuint tex = 0;
+        GLuint fb  = 0;
+        int width  = 0;
+        int height = 0;
+    };
+
+    std::map<int, scratch_t> scratch;
+    std::vector<GLuint> programs;
+};
@@ -0,0 +1,177 @@
+#include "blur.hpp"
+
+static const char *dual_kawase_vertex_shader =
+    R"(
+#version 100
+attribute mediump vec2 position;
+
+varying mediump vec2 uv;
+
+void main() {
+    gl_Position = vec4(position.xy, 0.0, 1.0);
+    uv = (position.xy + vec2(1.0, 1.0)) / 2.0;
+})";
+
+static const char *dual_kawase_fragment_shader_down =
+    R"(
+#version 100
+precision mediump float;
+
+uniform float offset;
+uniform vec2 halfpixel;
+uniform sampler2D bg_texture;
+
+varying mediump vec2 uv;
+
+void main()
+{
+    vec4 sum = texture2D(bg_texture, uv) * 4.0;
+    sum += texture2D(bg_texture, uv - halfpixel.xy * offset);
+    sum += texture2D(bg_texture, uv + halfpixel.xy * offset);
+    sum += texture2D(bg_texture, uv + vec2(halfpixel.x, -halfpixel.y) * offset);
+    sum += texture2D(bg_texture, uv - vec2(halfpixel.x, -halfpixel.y) * offset);
+    gl_FragColor = sum / 8.0;
+})";
+
+static const char *dual_kawase_fragment_shader_up =
+    R"(
+#version 100
+precision mediump float;
+
+uniform float offset;
+uniform vec2 halfpixel;
+uniform sampler2D bg_texture;
+
+varying mediump vec2 uv;
+
+void main()
+{
+    vec4 sum = texture2D(bg_texture, uv + vec2(-halfpixel.x * 2.0, 0.0) * offset);
+    sum += texture2D(bg_texture, uv + vec2(-halfpixel.x, halfpixel.y) * offset) * 2.0;
+    sum += texture2D(bg_texture, uv + vec2(0.0, halfpixel.y * 2.0) * offset);
+    sum += texture2D(bg_texture, uv + vec2(halfpixel.x, halfpixel.y) * offset) * 2.0;
+    sum += texture2D(bg_texture, uv + vec2(halfpixel.x * 2.0, 0.0) * offset);
+    sum += texture2D(bg_texture, uv + vec2(halfpixel.x, -halfpixel.y) * offset) * 2.0;
+    sum += texture2D(bg_texture, uv + vec2(0.0, -halfpixel.y * 2.0) * offset);
+    sum += texture2D(bg_texture, uv + vec2(-halfpixel.x, -halfpixel.y) * offset) * 2.0;
+    gl_FragColor = sum / 12.0;
+})";
+
+/**
+ * The dual filter variant of kawase blur.
+ *
+ * Each downsampling pass renders into a framebuffer of half the size of the previous one, and the upsampling
+ * passes walk the same chain back to full size. Unlike the kawase method, every level of the chain has its
+ * own framebuffer, which keeps its size from frame to frame, so no textures are reallocated between passes.
+ * Since most passes run on a fraction of the pixels, wide blur radii are cheap even on large outputs.
+ */
+class wf_dual_kawase_blur : public wf_blur_base
+{
+    /* The levels of the chain, mips[i] has 1/2^(i+1) of the size of fb[0] */
+    std::vector<wf::framebuffer_t> mips;
+
+    wf::framebuffer_t& get_level(int level)
+    {
+        return (level == 0) ? fb[0] : mips[level - 1];
+    }
+
+  public:
+    wf_dual_kawase_blur() : wf_blur_base("dual_kawase")
+    {
+        OpenGL::render_begin();
+        program[0].set_simple(OpenGL::compile_program(dual_kawase_vertex_shader,
+            dual_kawase_fragment_shader_down));
+        program[1].set_simple(OpenGL::compile_program(dual_kawase_vertex_shader,
+            dual_kawase_fragment_shader_up));
+        OpenGL::render_end();
+    }
+
+    ~wf_dual_kawase_blur()
+    {
+        OpenGL::render_begin();
+        for (auto& buffer : mips)
+        {
+            buffer.release_to_pool();
+        }
+
+        OpenGL::render_end();
+    }
+
+    int blur_fb0(const wf::region_t& blur_region, int width, int height) override
+    {
+        const int iterations = get_iterations();
+        const float offset   = offset_opt;
+        if (iterations <= 0)
+        {
+            return 0;
+        }
+
+        if ((int)mips.size() < iterations)
+        {
+            mips.resize(iterations);
+        }
+
+        /* Upload data to shader */
+        static const float vertexData[] = {
+            -1.0f, -1.0f,
+            1.0f, -1.0f,
+            1.0f, 1.0f,
+            -1.0f, 1.0f
+        };
+
+        OpenGL::render_begin();
+        /* Disable blending, because we may have transparent background, which
+         * we want to render on uncleared framebuffer */
+        GL_CALL(glDisable(GL_BLEND));
+
+        /* Downsample: level i -> level i + 1 */
+        program[0].use(wf::TEXTURE_TYPE_RGBA);
+        program[0].attrib_pointer("position", 2, 0, vertexData);
+        program[0].uniform1f("offset", offset);
+        for (int i = 0; i < iterations; i++)
+        {
+            const int sample_width  = std::max(1, width / (1 << (i + 1)));
+            const int sample_height = std::max(1, height / (1 << (i + 1)));
+            auto region = blur_region * (1.0 / (1 << (i + 1)));
+
+            program[0].uniform2f("halfpixel", 0.5f / sample_width, 0.5f / sample_height);
+            render_iteration(region, get_level(i), get_level(i + 1), sample_width, sample_height);
+        }
+
+        program[0].deactivate();
+
+        /* Upsample: level i + 1 -> level i */
+        program[1].use(wf::TEXTURE_TYPE_RGBA);
+        program[1].attrib_pointer("position", 2, 0, vertexData);
+        program[1].uniform1f("offset", offset);
+        for (int i = iterations - 1; i >= 0; i--)
+        {
+            const int sample_width  = std::max(1, width / (1 << i));
+            const int sample_height = std::max(1, height / (1 << i));
+            auto region = blur_region * (1.0 / (1 << i));
+
+            program[1].uniform2f("halfpixel", 0.5f / sample_width, 0.5f / sample_height);
+            render_iteration(region, get_level(i + 1), get_level(i), sample_width, sample_height);
+        }
+
+        /* Reset gl state */
+        GL_CALL(glEnable(GL_BLEND));
+        GL_CALL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
+
+        program[1].deactivate();
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+        OpenGL::render_end();
+
+        return 0;
+    }
+
+    int calculate_blur_radius() override
+    {
+        return pow(2, get_iterations() + 1) * offset_opt * degrade_opt;
+    }
+};
+
+std::unique_ptr<wf_blur_base> create_dual_kawase_blur()
+{
+    return std::make_unique<wf_dual_kawase_blur>();
+}
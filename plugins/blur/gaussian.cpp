@@ -1,4 +1,5 @@
 #include "blur.hpp"
+#include "compute-blur.hpp"
 
 static const char *gaussian_vertex_shader =
     R"(
@@ -67,8 +68,139 @@ void main()
     gl_FragColor = bp;
 })";
 
+/* The same kernel as the fragment shaders, as a compute shader which loads
+ * a tile of a row (or column) together with the samples around it into
+ * shared memory once, instead of sampling each texel five times. */
+static const char *gaussian_compute_shader =
+    R"(
+#version 310 es
+precision mediump float;
+
+#define TILE 128
+#define APRON 32
+
+layout(local_size_x = TILE, local_size_y = 1) in;
+layout(rgba8, binding = 0) writeonly uniform mediump image2D out_image;
+uniform mediump sampler2D bg_texture;
+
+uniform float offset;
+uniform ivec2 size;
+/* (1, 0) for the horizontal pass, (0, 1) for the vertical one */
+uniform ivec2 direction;
+
+shared vec4 line[TILE + 2 * APRON];
+
+vec4 sample_line(float x)
+{
+    int i = int(floor(x));
+    return mix(line[i], line[i + 1], x - float(i));
+}
+
+void main()
+{
+    int length = direction.x * size.x + direction.y * size.y;
+    int start  = int(gl_WorkGroupID.x) * TILE - APRON;
+    int across = int(gl_WorkGroupID.y);
+    int local  = int(gl_LocalInvocationID.x);
+
+    for (int i = local; i < TILE + 2 * APRON; i += TILE)
+    {
+        int p = clamp(start + i, 0, length - 1);
+        line[i] = texelFetch(bg_texture, direction * p + (ivec2(1) - direction) * across, 0);
+    }
+
+    barrier();
+
+    int p = start + APRON + local;
+    if (p >= length)
+    {
+        return;
+    }
+
+    float c = float(local + APRON);
+    vec4 bp = line[local + APRON] * 0.204164;
+    bp += sample_line(c + 1.5 * offset) * 0.304005;
+    bp += sample_line(c - 1.5 * offset) * 0.304005;
+    bp += sample_line(c + 3.5 * offset) * 0.093913;
+    bp += sample_line(c - 3.5 * offset) * 0.093913;
+    imageStore(out_image, direction * p + (ivec2(1) - direction) * across, bp);
+})";
+
+/* Must match the defines in the compute shader */
+static constexpr int GAUSSIAN_TILE  = 128;
+static constexpr int GAUSSIAN_APRON = 32;
+
 class wf_gaussian_blur : public wf_blur_base
 {
+    wf::option_wrapper_t<bool> compute_opt{"blur/compute_shaders"};
+    std::unique_ptr<compute_blur_t> compute;
+    GLuint compute_program = 0;
+    bool compute_initialized = false;
+
+    /**
+     * Blur fb[0] with compute shaders.
+     *
+     * @return false if compute shaders cannot be used, in which case nothing is done.
+     */
+    bool blur_compute(int width, int height)
+    {
+        const int iterations = get_iterations();
+        const float offset   = offset_opt;
+        // The farthest sample must stay within the samples loaded to shared memory.
+        if (!compute_opt || (3.5 * offset + 1 >= GAUSSIAN_APRON))
+        {
+            return false;
+        }
+
+        if (!compute_initialized)
+        {
+            compute_initialized = true;
+            if (compute_blur_t::is_supported())
+            {
+                compute = std::make_unique<compute_blur_t>();
+                compute_program = compute->compile(gaussian_compute_shader);
+            }
+        }
+
+        if (!compute_program)
+        {
+            return false;
+        }
+
+        compute->get_texture(0, width, height);
+        compute->get_texture(1, width, height);
+
+        GL_CALL(glUseProgram(compute_program));
+        GL_CALL(glUniform1i(glGetUniformLocation(compute_program, "bg_texture"), 0));
+        GL_CALL(glUniform1f(glGetUniformLocation(compute_program, "offset"), offset));
+        GL_CALL(glUniform2i(glGetUniformLocation(compute_program, "size"), width, height));
+        const GLint direction = glGetUniformLocation(compute_program, "direction");
+
+        GLuint input = fb[0].tex;
+        for (int i = 0; i < iterations; i++)
+        {
+            /* Blur horizontally, into scratch texture 0 */
+            GL_CALL(glUseProgram(compute_program));
+            GL_CALL(glUniform2i(direction, 1, 0));
+            compute->dispatch(compute_program, input, 0,
+                (width + GAUSSIAN_TILE - 1) / GAUSSIAN_TILE, height);
+
+            /* Blur vertically, into scratch texture 1 */
+            GL_CALL(glUseProgram(compute_program));
+            GL_CALL(glUniform2i(direction, 0, 1));
+            compute->dispatch(compute_program, compute->get_texture(0, width, height), 1,
+                (height + GAUSSIAN_TILE - 1) / GAUSSIAN_TILE, width);
+            input = compute->get_texture(1, width, height);
+        }
+
+        if (iterations > 0)
+        {
+            compute->copy_to_framebuffer(1, fb[0], width, height);
+        }
+
+        return true;
+    }
+
   public:
     wf_gaussian_blur() : wf_blur_base("gaussian")
     {
@@ -104,9 +236,15 @@ class wf_gaussian_blur : public wf_blur_base
 
     int blur_fb0(const wf::region_t& blur_region, int width, int height) override
     {
-        int i, iterations = iterations_opt;
+        int i, iterations = get_iterations();
 
         OpenGL::render_begin();
+        if (blur_compute(width, height))
+        {
+            OpenGL::render_end();
+            return 0;
+        }
+
         GL_CALL(glDisable(GL_BLEND));
         /* Enable our shader and pass some data to it. The shader
          * does gaussian blur on the background texture in two passes,
@@ -1,4 +1,5 @@
 #include "blur.hpp"
+#include "compute-blur.hpp"
 
 static const char *kawase_vertex_shader =
     R"(
@@ -57,8 +58,172 @@ void main()
     gl_FragColor = sum / 12.0;
 })";
 
+/* The compute variants of the shaders above. Scratch textures may be bigger than the area which is
+ * blurred, so sampling is clamped to the valid part of the input. */
+static const char *kawase_compute_shader_header =
+    R"(
+#version 310 es
+precision mediump float;
+
+layout(local_size_x = 8, local_size_y = 8) in;
+layout(rgba8, binding = 0) writeonly uniform mediump image2D out_image;
+uniform mediump sampler2D bg_texture;
+
+uniform float offset;
+uniform vec2 halfpixel;
+uniform ivec2 out_size;
+/* The valid part of the input, relative to its texture size */
+uniform vec2 in_scale;
+/* Half a texel of the valid part of the input */
+uniform vec2 in_half;
+
+vec4 sample_input(vec2 uv)
+{
+    return texture(bg_texture, clamp(uv, in_half, vec2(1.0) - in_half) * in_scale);
+}
+)";
+
+static const char *kawase_compute_shader_down =
+    R"(
+void main()
+{
+    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+    if (pos.x >= out_size.x || pos.y >= out_size.y)
+    {
+        return;
+    }
+
+    vec2 uv  = (vec2(pos) + 0.5) / vec2(out_size);
+    vec4 sum = sample_input(uv) * 4.0;
+    sum += sample_input(uv - halfpixel.xy * offset);
+    sum += sample_input(uv + halfpixel.xy * offset);
+    sum += sample_input(uv + vec2(halfpixel.x, -halfpixel.y) * offset);
+    sum += sample_input(uv - vec2(halfpixel.x, -halfpixel.y) * offset);
+    imageStore(out_image, pos, sum / 8.0);
+})";
+
+static const char *kawase_compute_shader_up =
+    R"(
+void main()
+{
+    ivec2 pos = ivec2(gl_GlobalInvocationID.xy);
+    if (pos.x >= out_size.x || pos.y >= out_size.y)
+    {
+        return;
+    }
+
+    vec2 uv  = (vec2(pos) + 0.5) / vec2(out_size);
+    vec4 sum = sample_input(uv + vec2(-halfpixel.x * 2.0, 0.0) * offset);
+    sum += sample_input(uv + vec2(-halfpixel.x, halfpixel.y) * offset) * 2.0;
+    sum += sample_input(uv + vec2(0.0, halfpixel.y * 2.0) * offset);
+    sum += sample_input(uv + vec2(halfpixel.x, halfpixel.y) * offset) * 2.0;
+    sum += sample_input(uv + vec2(halfpixel.x * 2.0, 0.0) * offset);
+    sum += sample_input(uv + vec2(halfpixel.x, -halfpixel.y) * offset) * 2.0;
+    sum += sample_input(uv + vec2(0.0, -halfpixel.y * 2.0) * offset);
+    sum += sample_input(uv + vec2(-halfpixel.x, -halfpixel.y) * offset) * 2.0;
+    imageStore(out_image, pos, sum / 12.0);
+})";
+
 class wf_kawase_blur : public wf_blur_base
 {
+    wf::option_wrapper_t<bool> compute_opt{"blur/compute_shaders"};
+    std::unique_ptr<compute_blur_t> compute;
+    GLuint compute_program[2] = {0, 0};
+    bool compute_initialized = false;
+
+    /**
+     * Run a single compute pass from @input, which has a valid area of @in_width x @in_height out of
+     * @in_size, to the scratch texture @output.
+     */
+    void compute_pass(GLuint program, GLuint input, wf::dimensions_t in_size, int in_width, int in_height,
+        int output, int out_width, int out_height)
+    {
+        const float offset = offset_opt;
+        GL_CALL(glUseProgram(program));
+        GL_CALL(glUniform1i(glGetUniformLocation(program, "bg_texture"), 0));
+        GL_CALL(glUniform1f(glGetUniformLocation(program, "offset"), offset));
+        GL_CALL(glUniform2f(glGetUniformLocation(program, "halfpixel"),
+            0.5f / out_width, 0.5f / out_height));
+        GL_CALL(glUniform2i(glGetUniformLocation(program, "out_size"), out_width, out_height));
+        GL_CALL(glUniform2f(glGetUniformLocation(program, "in_scale"),
+            (float)in_width / in_size.width, (float)in_height / in_size.height));
+        GL_CALL(glUniform2f(glGetUniformLocation(program, "in_half"),
+            0.5f / in_width, 0.5f / in_height));
+        compute->dispatch(program, input, output, (out_width + 7) / 8, (out_height + 7) / 8);
+    }
+
+    /**
+     * Blur fb[0] with compute shaders. The passes ping-pong between two full-size scratch textures.
+     *
+     * @return false if compute shaders cannot be used, in which case nothing is done.
+     */
+    bool blur_compute(int width, int height)
+    {
+        if (!compute_opt)
+        {
+            return false;
+        }
+
+        if (!compute_initialized)
+        {
+            compute_initialized = true;
+            if (compute_blur_t::is_supported())
+            {
+                compute = std::make_unique<compute_blur_t>();
+                std::string header = kawase_compute_shader_header;
+                compute_program[0] = compute->compile((header + kawase_compute_shader_down).c_str());
+                compute_program[1] = compute->compile((header + kawase_compute_shader_up).c_str());
+            }
+        }
+
+        if (!compute_program[0] || !compute_program[1])
+        {
+            return false;
+        }
+
+        const int iterations = get_iterations();
+        if (iterations <= 0)
+        {
+            return true;
+        }
+
+        compute->get_texture(0, width, height);
+        compute->get_texture(1, width, height);
+
+        GLuint input = fb[0].tex;
+        wf::dimensions_t in_size = {width, height};
+        int in_width  = width;
+        int in_height = height;
+        int pass = 0;
+
+        auto run = [&] (GLuint program, int level)
+        {
+            const int out_width  = std::max(1, width / (1 << level));
+            const int out_height = std::max(1, height / (1 << level));
+            const int output     = pass % 2;
+            compute_pass(program, input, in_size, in_width, in_height, output, out_width, out_height);
+
+            input     = compute->get_texture(output, width, height);
+            in_size   = compute->get_texture_size(output);
+            in_width  = out_width;
+            in_height = out_height;
+            pass++;
+        };
+
+        for (int i = 0; i < iterations; i++)
+        {
+            run(compute_program[0], i);
+        }
+
+        for (int i = iterations - 1; i >= 0; i--)
+        {
+            run(compute_program[1], i);
+        }
+
+        compute->copy_to_framebuffer((pass - 1) % 2, fb[0], width, height);
+        return true;
+    }
+
   public:
     wf_kawase_blur() : wf_blur_base("kawase")
     {
@@ -72,10 +237,18 @@ class wf_kawase_blur : public wf_blur_base
 
     int blur_fb0(const wf::region_t& blur_region, int width, int height) override
     {
-        int iterations = iterations_opt;
+        int iterations = get_iterations();
         float offset = offset_opt;
         int sampleWidth, sampleHeight;
 
+        OpenGL::render_begin();
+        const bool done = blur_compute(width, height);
+        OpenGL::render_end();
+        if (done)
+        {
+            return 0;
+        }
+
         /* Upload data to shader */
         static const float vertexData[] = {
             -1.0f, -1.0f,
@@ -139,7 +312,7 @@ class wf_kawase_blur : public wf_blur_base
 
     int calculate_blur_radius() override
     {
-        return pow(2, iterations_opt + 1) * offset_opt * degrade_opt;
+        return pow(2, get_iterations() + 1) * offset_opt * degrade_opt;
     }
 };
 
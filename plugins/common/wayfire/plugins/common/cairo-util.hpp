@@ -38,6 +38,8 @@ static void cairo_surface_upload_to_texture(
     GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED));
     GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
         buffer.width, buffer.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, src));
+    wf::gpu_memory::set(buffer.tex, wf::gpu_memory::TYPE_TEXTURE, int64_t(buffer.width) * buffer.height * 4,
+        (const void*)&cairo_surface_upload_to_texture);
 }
 
 namespace wf
@@ -74,6 +76,8 @@ struct cairo_text_t
          * resulting surface might be bigger than necessary and the
          * text is centered in it */
         bool exact_size = false;
+        /* pango description of the font */
+        std::string font = "sans-serif bold";
 
         params()
         {}
@@ -100,6 +104,125 @@ struct cairo_text_t
      *   that dimension.
      */
     wf::dimensions_t render_text(const std::string& text, const params& par)
+    {
+        auto ret = draw_text(text, par);
+        OpenGL::render_begin();
+        cairo_surface_upload_to_texture(surface, tex);
+        OpenGL::render_end();
+
+        return ret;
+    }
+
+    /**
+     * Render the given text to a new cairo image surface. Unlike render_text(), this does not need a GL
+     * context, so it can be used from other threads.
+     *
+     * @param required_size Set to the return value of render_text().
+     * @return The surface, which the caller has to destroy.
+     */
+    static cairo_surface_t *rasterize(const std::string& text, const params& par,
+        wf::dimensions_t& required_size)
+    {
+        cairo_text_t ct;
+        required_size = ct.draw_text(text, par);
+        return cairo_surface_reference(ct.surface);
+    }
+
+    /**
+     * Standalone function version to render text to an OpenGL texture
+     */
+    static wf::dimensions_t cairo_render_text_to_texture(const std::string& text,
+        const wf::cairo_text_t::params& par, wf::simple_texture_t& tex)
+    {
+        wf::cairo_text_t ct;
+        /* note: we "borrow" the texture from what was supplied (if any) */
+        ct.tex.tex = tex.tex;
+        auto ret = ct.render_text(text, par);
+        if (tex.tex == (GLuint) - 1)
+        {
+            tex.tex = ct.tex.tex;
+        }
+
+        tex.width  = ct.tex.width;
+        tex.height = ct.tex.height;
+        ct.tex.tex = -1;
+        return ret;
+    }
+
+    cairo_text_t() = default;
+
+    ~cairo_text_t()
+    {
+        cairo_free();
+    }
+
+    cairo_text_t(const cairo_text_t &) = delete;
+    cairo_text_t& operator =(const cairo_text_t&) = delete;
+
+    cairo_text_t(cairo_text_t && o) noexcept : tex(std::move(o.tex)), cr(o.cr),
+        surface(o.surface), surface_size(o.surface_size)
+    {
+        o.cr = nullptr;
+        o.surface = nullptr;
+    }
+
+    cairo_text_t& operator =(cairo_text_t&& o) noexcept
+    {
+        if (&o == this)
+        {
+            return *this;
+        }
+
+        cairo_free();
+
+        tex = std::move(o.tex);
+        cr  = o.cr;
+        surface = o.surface;
+        surface_size = o.surface_size;
+
+        o.cr = nullptr;
+        o.surface = nullptr;
+
+        return *this;
+    }
+
+    /**
+     * Calculate the height of text rendered with a given font size.
+     *
+     * @param font_size  Desired font size.
+     * @param bg_rect    Whether a background rectangle should be taken into account.
+     *
+     * @returns Required height of the surface.
+     */
+    static unsigned int measure_height(int font_size, bool bg_rect = true)
+    {
+        cairo_text_t dummy;
+        dummy.surface_size.width  = 1;
+        dummy.surface_size.height = 1;
+        dummy.cairo_create_surface();
+
+        cairo_font_extents_t font_extents;
+        /* TODO: font properties could be made parameters! */
+        cairo_select_font_face(dummy.cr, "sans-serif", CAIRO_FONT_SLANT_NORMAL,
+            CAIRO_FONT_WEIGHT_BOLD);
+        cairo_set_font_size(dummy.cr, font_size);
+        cairo_font_extents(dummy.cr, &font_extents);
+
+        double ypad = bg_rect ? 0.2 * (font_extents.ascent +
+            font_extents.descent) : 0.0;
+        unsigned int h = (unsigned int)std::ceil(font_extents.ascent +
+            font_extents.descent + 2 * ypad);
+        return h;
+    }
+
+    wf::dimensions_t get_size() const
+    {
+        return surface_size;
+    }
+
+  protected:
+    /** Render the given text on our cairo surface, see render_text(). */
+    wf::dimensions_t draw_text(const std::string& text, const params& par)
     {
         if (!cr)
         {
@@ -110,8 +233,7 @@ struct cairo_text_t
         PangoFontDescription *font_desc;
         PangoLayout *layout;
         PangoRectangle extents;
-        /* TODO: font properties could be made parameters! */
-        font_desc = pango_font_description_from_string("sans-serif bold");
+        font_desc = pango_font_description_from_string(par.font.c_str());
         pango_font_description_set_absolute_size(font_desc,
             par.font_size * par.output_scale * PANGO_SCALE);
         layout = pango_cairo_create_layout(cr);
@@ -201,106 +323,9 @@ struct cairo_text_t
         g_object_unref(layout);
 
         cairo_surface_flush(surface);
-        OpenGL::render_begin();
-        cairo_surface_upload_to_texture(surface, tex);
-        OpenGL::render_end();
-
         return ret;
     }
 
-    /**
-     * Standalone function version to render text to an OpenGL texture
-     */
-    static wf::dimensions_t cairo_render_text_to_texture(const std::string& text,
-        const wf::cairo_text_t::params& par, wf::simple_texture_t& tex)
-    {
-        wf::cairo_text_t ct;
-        /* note: we "borrow" the texture from what was supplied (if any) */
-        ct.tex.tex = tex.tex;
-        auto ret = ct.render_text(text, par);
-        if (tex.tex == (GLuint) - 1)
-        {
-            tex.tex = ct.tex.tex;
-        }
-
-        tex.width  = ct.tex.width;
-        tex.height = ct.tex.height;
-        ct.tex.tex = -1;
-        return ret;
-    }
-
-    cairo_text_t() = default;
-
-    ~cairo_text_t()
-    {
-        cairo_free();
-    }
-
-    cairo_text_t(const cairo_text_t &) = delete;
-    cairo_text_t& operator =(const cairo_text_t&) = delete;
-
-    cairo_text_t(cairo_text_t && o) noexcept : tex(std::move(o.tex)), cr(o.cr),
-        surface(o.surface), surface_size(o.surface_size)
-    {
-        o.cr = nullptr;
-        o.surface = nullptr;
-    }
-
-    cairo_text_t& operator =(cairo_text_t&& o) noexcept
-    {
-        if (&o == this)
-        {
-            return *this;
-        }
-
-        cairo_free();
-
-        tex = std::move(o.tex);
-        cr  = o.cr;
-        surface = o.surface;
-        surface_size = o.surface_size;
-
-        o.cr = nullptr;
-        o.surface = nullptr;
-
-        return *this;
-    }
-
-    /**
-     * Calculate the height of text rendered with a given font size.
-     *
-     * @param font_size  Desired font size.
-     * @param bg_rect    Whether a background rectangle should be taken into account.
-     *
-     * @returns Required height of the surface.
-     */
-    static unsigned int measure_height(int font_size, bool bg_rect = true)
-    {
-        cairo_text_t dummy;
-        dummy.surface_size.width  = 1;
-        dummy.surface_size.height = 1;
-        dummy.cairo_create_surface();
-
-        cairo_font_extents_t font_extents;
-        /* TODO: font properties could be made parameters! */
-        cairo_select_font_face(dummy.cr, "sans-serif", CAIRO_FONT_SLANT_NORMAL,
-            CAIRO_FONT_WEIGHT_BOLD);
-        cairo_set_font_size(dummy.cr, font_size);
-        cairo_font_extents(dummy.cr, &font_extents);
-
-        double ypad = bg_rect ? 0.2 * (font_extents.ascent +
-            font_extents.descent) : 0.0;
-        unsigned int h = (unsigned int)std::ceil(font_extents.ascent +
-            font_extents.descent + 2 * ypad);
-        return h;
-    }
-
-    wf::dimensions_t get_size() const
-    {
-        return surface_size;
-    }
-
-  protected:
     /* cairo context and surface for the text */
     cairo_t *cr = nullptr;
     cairo_surface_t *surface = nullptr;
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <wayfire/gpu-memory.hpp>
+#include <wayfire/img.hpp>
+#include <wayfire/opengl.hpp>
+#include <wayfire/signal-provider.hpp>
+#include <wayfire/plugins/common/shared-core-data.hpp>
+#include <functional>
+#include <memory>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+
+namespace wf
+{
+/**
+ * on: cached_image_texture_t
+ * when: Emitted on the main thread when loading the image has finished, successfully or not.
+ */
+struct cached_image_ready_signal
+{};
+
+/**
+ * A texture loaded from an image file, see image_texture_cache_t.
+ */
+struct cached_image_texture_t : public wf::signal::provider_t
+{
+    /** The texture, or -1 if the image is still loading or could not be loaded. */
+    GLuint tex = -1;
+    /** Whether loading the image has finished. */
+    bool ready = false;
+    /**
+     * The load was dropped because the plugin which started it was unloaded. The entry is then ready without
+     * a texture, and the next get() for its key starts a new load.
+     */
+    bool cancelled = false;
+
+    cached_image_texture_t() = default;
+    cached_image_texture_t(const cached_image_texture_t&) = delete;
+    cached_image_texture_t& operator =(const cached_image_texture_t&) = delete;
+
+    ~cached_image_texture_t()
+    {
+        if (tex != (GLuint)-1)
+        {
+            OpenGL::render_begin();
+            wf::gpu_memory::set(tex, wf::gpu_memory::TYPE_TEXTURE, 0, nullptr);
+            GL_CALL(glDeleteTextures(1, &tex));
+            OpenGL::render_end();
+        }
+    }
+};
+
+/**
+ * A cache of textures loaded from image files, shared between all plugins and outputs (use it via
+ * wf::shared_data::ref_ptr_t<wf::image_texture_cache_t>).
+ *
+ * Per-output plugins, like the cube backgrounds, would otherwise decode and upload the same image once per
+ * output. Entries are identified by a key describing everything that affects the texture, usually the file
+ * name, the size limit and how it is uploaded. An entry lives as long as a user holds it, and a new entry
+ * is decoded on a worker thread, see image_io::decode_file_async().
+ *
+ * The decoding job runs code of the plugin which requested the entry, so it is dropped when that plugin is
+ * unloaded, even if other plugins wait for the same entry, see cached_image_texture_t::cancelled.
+ */
+class image_texture_cache_t
+{
+  public:
+    /**
+     * Upload the decoded image to @tex, a new texture name, and set up its parameters.
+     * Called on the main thread inside OpenGL::render_begin().
+     *
+     * @return The memory used by the texture on the GPU, or -1 if the image cannot be used.
+     */
+    using upload_t = std::function<int64_t(const image_io::decoded_image_t& image, GLuint tex)>;
+
+    /**
+     * Get the entry for the given key, loading @path if it is not cached yet. Until the entry is ready,
+     * users should show a placeholder and repaint when cached_image_ready_signal is emitted.
+     *
+     * @param owner An address in the code of the calling plugin, see thread_pool_t::schedule().
+     * @param prepare Called on the worker thread with the decoded image, for example to downscale it.
+     */
+    std::shared_ptr<cached_image_texture_t> get(const std::string& key, const std::string& path,
+        const void *owner, upload_t upload, std::function<void(image_io::decoded_image_t&)> prepare = {})
+    {
+        auto it = entries.find(key);
+        if (it != entries.end())
+        {
+            auto entry = it->second.lock();
+            if (entry && !entry->cancelled)
+            {
+                return entry;
+            }
+        }
+
+        auto entry = std::make_shared<cached_image_texture_t>();
+        entries[key] = entry;
+        prune();
+
+        std::weak_ptr<cached_image_texture_t> weak = entry;
+        auto cancel_guard = std::make_shared<load_guard_t>(weak);
+        image_io::decode_file_async(path, [weak, upload, cancel_guard] (auto image)
+        {
+            cancel_guard->done = true;
+            auto entry = weak.lock();
+            if (!entry)
+            {
+                return;
+            }
+
+            OpenGL::render_begin();
+            GL_CALL(glGenTextures(1, &entry->tex));
+            const int64_t size = image ? upload(*image, entry->tex) : -1;
+            if (size < 0)
+            {
+                GL_CALL(glDeleteTextures(1, &entry->tex));
+                entry->tex = -1;
+            } else
+            {
+                wf::gpu_memory::set(entry->tex, wf::gpu_memory::TYPE_TEXTURE, size,
+                    &typeid(image_texture_cache_t));
+            }
+
+            OpenGL::render_end();
+            entry->ready = true;
+            cached_image_ready_signal data;
+            entry->emit(&data);
+        }, entry, std::move(prepare), owner);
+
+        return entry;
+    }
+
+  private:
+    std::unordered_map<std::string, std::weak_ptr<cached_image_texture_t>> entries;
+
+    /**
+     * Held by the callback of a load. If the callback is destroyed without running, because the job was
+     * cancelled, the users of the entry are told that it will not load.
+     */
+    struct load_guard_t
+    {
+        std::weak_ptr<cached_image_texture_t> entry;
+        bool done = false;
+
+        load_guard_t(std::weak_ptr<cached_image_texture_t> entry) : entry(std::move(entry))
+        {}
+
+        ~load_guard_t()
+        {
+            auto cancelled_entry = entry.lock();
+            if (done || !cancelled_entry)
+            {
+                return;
+            }
+
+            cancelled_entry->cancelled = true;
+            cancelled_entry->ready     = true;
+            cached_image_ready_signal data;
+            cancelled_entry->emit(&data);
+        }
+    };
+
+    /** Remove the keys of entries which are not used anymore. */
+    void prune()
+    {
+        for (auto it = entries.begin(); it != entries.end();)
+        {
+            it = it->second.expired() ? entries.erase(it) : std::next(it);
+        }
+    }
+};
+}
@@ -583,15 +583,23 @@ class core_drag_t : public signal::provider_t
         for (auto& v : all_views)
         {
             move_wobbly(v.view, to.x, to.y);
-            if (!view_held_in_place)
-            {
-                v.view->get_transformed_node()->begin_transform_update();
-                v.transformer->grab_position = to;
-                v.view->get_transformed_node()->end_transform_update();
-            }
+        }
+
+        if (!view_held_in_place)
+        {
+            pending_grab_position = to;
         }
 
         update_current_output(to);
+        if (current_output)
+        {
+            // The views are moved right before the next frame, so that a burst of motion events results in
+            // a single update of the scenegraph.
+            current_output->render->schedule_redraw();
+        } else
+        {
+            apply_grab_position();
+        }
 
         drag_motion_signal data;
         data.current_position = to;
@@ -612,6 +620,8 @@ class core_drag_t : public signal::provider_t
             return;
         }
 
+        apply_grab_position();
+
         // Store data for the drag done signal
         drag_done_signal data;
         data.grab_position = all_views.front().transformer->grab_position;
@@ -705,6 +715,26 @@ class core_drag_t : public signal::provider_t
 
     std::shared_ptr<dragged_view_node_t> render_node;
 
+    // The latest grab position which has not been applied to the transformers yet
+    std::optional<wf::point_t> pending_grab_position;
+
+    void apply_grab_position()
+    {
+        if (!pending_grab_position)
+        {
+            return;
+        }
+
+        for (auto& v : all_views)
+        {
+            v.view->get_transformed_node()->begin_transform_update();
+            v.transformer->grab_position = *pending_grab_position;
+            v.view->get_transformed_node()->end_transform_update();
+        }
+
+        pending_grab_position.reset();
+    }
+
     void update_current_output(wf::point_t grab)
     {
         wf::pointf_t origin = {1.0 * grab.x, 1.0 * grab.y};
@@ -734,6 +764,7 @@ class core_drag_t : public signal::provider_t
 
     wf::effect_hook_t on_pre_frame = [=] ()
     {
+        apply_grab_position();
         for (auto& v : this->all_views)
         {
             if (v.transformer->scale_factor.running())
@@ -0,0 +1,340 @@
+#pragma once
+
+#include <wayfire/opengl.hpp>
+#include <wayfire/region.hpp>
+#include <wayfire/scene-render.hpp>
+#include <wayfire/view-transform.hpp>
+#include <wayfire/plugins/common/shared-core-data.hpp>
+#include <algorithm>
+
+namespace wf
+{
+namespace scene
+{
+/** The parameters of a shadow_node_t, in logical pixels. */
+struct shadow_params_t
+{
+    /* How far the shadow fades out, three standard deviations of the gaussian */
+    int radius = 24;
+    /* Displacement of the shadow relative to the children */
+    wf::point_t offset = {0, 0};
+    /* How much bigger than the children the box casting the shadow is */
+    int spread = 0;
+    /* The radius of the rounded corners of the children */
+    int corner_radius = 0;
+    /* The color of the shadow directly below the edges, not premultiplied */
+    wf::color_t color = {0.0, 0.0, 0.0, 0.5};
+};
+
+namespace detail
+{
+static const char *shadow_vertex_shader =
+    R"(
+#version 100
+attribute highp vec2 position;
+uniform highp mat4 MVP;
+
+varying highp vec2 point;
+
+void main() {
+    gl_Position = MVP * vec4(position.xy, 0.0, 1.0);
+    point = position.xy;
+})";
+
+/*
+ * The shadow of a rounded box blurred with a gaussian: the blur is separable along the x axis, where the
+ * integral is an erf() of the distance to the edges of the box on the current row, and the integral along
+ * the y axis is approximated with a few samples. erf() itself is approximated with a polynomial.
+ */
+static const char *shadow_fragment_shader =
+    R"(
+#version 100
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+precision highp float;
+#else
+precision mediump float;
+#endif
+
+uniform vec2 shadow_center;
+uniform vec2 shadow_half_size;
+uniform vec2 window_center;
+uniform vec2 window_half_size;
+uniform float sigma;
+uniform float corner;
+uniform vec4 color;
+
+varying vec2 point;
+
+vec2 erf_approx(vec2 x)
+{
+    vec2 s = sign(x), a = abs(x);
+    x = 1.0 + (0.278393 + (0.230389 + 0.078108 * (a * a)) * a) * a;
+    x *= x;
+    return s - s / (x * x);
+}
+
+float gaussian(float x)
+{
+    return exp(-(x * x) / (2.0 * sigma * sigma)) / (2.50662827 * sigma);
+}
+
+/* The integral of the blurred box along the row at height y, relative to the center of the box */
+float shadow_row(float x, float y)
+{
+    float delta  = min(shadow_half_size.y - corner - abs(y), 0.0);
+    float curved = shadow_half_size.x - corner + sqrt(max(0.0, corner * corner - delta * delta));
+    vec2 integral = 0.5 + 0.5 * erf_approx((x + vec2(-curved, curved)) * (0.70710678 / sigma));
+    return integral.y - integral.x;
+}
+
+float rounded_box(vec2 p, vec2 b, float r)
+{
+    vec2 q = abs(p) - b + vec2(r);
+    return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - r;
+}
+
+void main()
+{
+    // The shadow is not drawn below the children, so that it does not shine through translucent parts.
+    float outside = clamp(rounded_box(point - window_center, window_half_size, corner) + 0.5, 0.0, 1.0);
+
+    vec2 p = point - shadow_center;
+    float low  = p.y - shadow_half_size.y;
+    float high = p.y + shadow_half_size.y;
+    float start = clamp(-3.0 * sigma, low, high);
+    float end   = clamp(3.0 * sigma, low, high);
+
+    float step = (end - start) / 4.0;
+    float y = start + step * 0.5;
+    float value = 0.0;
+    for (int i = 0; i < 4; i++)
+    {
+        value += shadow_row(p.x, p.y - y) * gaussian(y) * step;
+        y += step;
+    }
+
+    gl_FragColor = vec4(color.rgb * color.a, color.a) * (value * outside);
+})";
+
+/** The shadow program, shared by all shadow nodes. */
+struct shadow_program_t
+{
+    OpenGL::program_t program;
+    bool compiled = false;
+
+    ~shadow_program_t()
+    {
+        if (compiled)
+        {
+            OpenGL::render_begin();
+            program.free_resources();
+            OpenGL::render_end();
+        }
+    }
+};
+}
+
+/**
+ * A transformer which draws a soft drop shadow below its children, for example a view.
+ *
+ * The shadow is computed analytically in a single pass of a fragment shader over the area around the
+ * children, so its cost does not depend on the radius, unlike blurring an image of the children. The
+ * children themselves are rendered directly, without an auxiliary buffer. Parts of the shadow which are
+ * covered by the children are not drawn, using the opaque region of the child if it implements
+ * opaque_region_node_t, and the rounded box of the children otherwise.
+ */
+class shadow_node_t : public transformer_base_node_t, public opaque_region_node_t
+{
+  public:
+    shadow_node_t(shadow_params_t params = {}) : transformer_base_node_t(false)
+    {
+        this->params = params;
+    }
+
+    /** Change the shadow and damage the old and the new shadow. */
+    void set_params(shadow_params_t params)
+    {
+        wf::region_t damage = get_bounding_box();
+        this->params = params;
+        damage |= get_bounding_box();
+        wf::scene::damage_node(shared_from_this(), damage);
+    }
+
+    const shadow_params_t& get_params() const
+    {
+        return params;
+    }
+
+    /** @return The box which casts the shadow, which is the box of the children grown by the spread. */
+    wf::geometry_t get_shadow_box()
+    {
+        auto box = get_children_bounding_box();
+        const int spread = params.spread;
+        return {box.x + params.offset.x - spread, box.y + params.offset.y - spread,
+            box.width + 2 * spread, box.height + 2 * spread};
+    }
+
+    wf::geometry_t get_bounding_box() override
+    {
+        auto shadow      = get_shadow_box();
+        const int radius = std::max(0, params.radius);
+        auto children    = get_children_bounding_box();
+
+        shadow.x      -= radius;
+        shadow.y      -= radius;
+        shadow.width  += 2 * radius;
+        shadow.height += 2 * radius;
+        const int x1 = std::min(shadow.x, children.x);
+        const int y1 = std::min(shadow.y, children.y);
+        const int x2 = std::max(shadow.x + shadow.width, children.x + children.width);
+        const int y2 = std::max(shadow.y + shadow.height, children.y + children.height);
+        return {x1, y1, x2 - x1, y2 - y1};
+    }
+
+    wf::region_t get_opaque_region() const override
+    {
+        if (get_children().size() == 1)
+        {
+            if (auto opaque = dynamic_cast<opaque_region_node_t*>(get_children().front().get()))
+            {
+                return opaque->get_opaque_region();
+            }
+        }
+
+        return {};
+    }
+
+    /** @return The region of the shadow which is covered by the children. */
+    wf::region_t get_covered_region()
+    {
+        auto box = get_children_bounding_box();
+        const int inset = std::min({params.corner_radius, box.width / 2, box.height / 2});
+        wf::region_t covered = get_opaque_region();
+        covered |= wf::geometry_t{box.x + inset, box.y, box.width - 2 * inset, box.height};
+        covered |= wf::geometry_t{box.x, box.y + inset, box.width, box.height - 2 * inset};
+        return covered;
+    }
+
+    std::string stringify() const override
+    {
+        return "shadow " + stringify_flags();
+    }
+
+    void gen_render_instances(std::vector<render_instance_uptr>& instances,
+        damage_callback push_damage, wf::output_t *shown_on) override;
+
+    shared_data::ref_ptr_t<detail::shadow_program_t> program;
+
+  private:
+    shadow_params_t params;
+};
+
+class shadow_render_instance_t : public transformer_render_instance_t<shadow_node_t>
+{
+  public:
+    using transformer_render_instance_t::transformer_render_instance_t;
+
+    void transform_damage_region(wf::region_t& damage) override
+    {
+        // When the children change their size, the shadow moves as well.
+        auto box = self->get_bounding_box();
+        if (box != last_bounding_box)
+        {
+            damage |= last_bounding_box;
+            damage |= box;
+            last_bounding_box = box;
+        }
+    }
+
+    void schedule_instructions(std::vector<render_instruction_t>& instructions,
+        const wf::render_target_t& target, wf::region_t& damage) override
+    {
+        // The children are drawn as they are, the shadow below them.
+        for (auto& ch : children)
+        {
+            ch->schedule_instructions(instructions, target, damage);
+        }
+
+        last_bounding_box = self->get_bounding_box();
+        wf::region_t our_damage = clip_instruction_damage(damage, last_bounding_box);
+        our_damage ^= self->get_covered_region();
+        if (!our_damage.empty())
+        {
+            instructions.push_back(render_instruction_t{
+                .instance = this,
+                .target   = target,
+                .damage   = std::move(our_damage),
+            });
+        }
+    }
+
+    void render(const wf::render_target_t& target, const wf::region_t& damage) override
+    {
+        const auto& params = self->get_params();
+        if ((params.radius <= 0) || (params.color.a <= 0))
+        {
+            return;
+        }
+
+        auto& program = self->program->program;
+        OpenGL::render_begin(target);
+        if (!self->program->compiled)
+        {
+            program.set_simple(OpenGL::compile_program(detail::shadow_vertex_shader,
+                detail::shadow_fragment_shader));
+            self->program->compiled = true;
+        }
+
+        auto bbox   = self->get_bounding_box();
+        auto shadow = self->get_shadow_box();
+        auto window = self->get_children_bounding_box();
+        const float x1 = bbox.x;
+        const float y1 = bbox.y;
+        const float x2 = bbox.x + bbox.width;
+        const float y2 = bbox.y + bbox.height;
+        const GLfloat vertex_data[] = {
+            x1, y2,
+            x2, y2,
+            x2, y1,
+            x1, y1,
+        };
+
+        const float corner = std::clamp(params.corner_radius, 0,
+            std::min(window.width, window.height) / 2);
+        program.use(wf::TEXTURE_TYPE_RGBA);
+        program.attrib_pointer("position", 2, 0, vertex_data);
+        program.uniformMatrix4f("MVP", target.get_orthographic_projection());
+        program.uniform2f("shadow_center", shadow.x + shadow.width / 2.0f, shadow.y + shadow.height / 2.0f);
+        program.uniform2f("shadow_half_size", shadow.width / 2.0f, shadow.height / 2.0f);
+        program.uniform2f("window_center", window.x + window.width / 2.0f, window.y + window.height / 2.0f);
+        program.uniform2f("window_half_size", window.width / 2.0f, window.height / 2.0f);
+        program.uniform1f("sigma", params.radius / 3.0f);
+        program.uniform1f("corner", corner);
+        program.uniform4f("color", {params.color.r, params.color.g, params.color.b, params.color.a});
+
+        for (auto& box : damage)
+        {
+            target.logic_scissor(wlr_box_from_pixman_box(box));
+            GL_CALL(glDrawArrays(GL_TRIANGLE_FAN, 0, 4));
+        }
+
+        program.deactivate();
+        OpenGL::render_end();
+    }
+
+    direct_scanout try_scanout(wf::output_t *output) override
+    {
+        return try_scanout_from_list(children, output);
+    }
+
+  private:
+    wf::geometry_t last_bounding_box = {0, 0, 0, 0};
+};
+
+inline void shadow_node_t::gen_render_instances(std::vector<render_instance_uptr>& instances,
+    damage_callback push_damage, wf::output_t *shown_on)
+{
+    instances.push_back(std::make_unique<shadow_render_instance_t>(this, push_damage, shown_on));
+}
+}
+}
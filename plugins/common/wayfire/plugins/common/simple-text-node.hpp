@@ -2,6 +2,8 @@
 #include "wayfire/output.hpp"
 #include "wayfire/scene.hpp"
 #include <wayfire/plugins/common/cairo-util.hpp>
+#include <wayfire/plugins/common/shared-core-data.hpp>
+#include <wayfire/plugins/common/text-texture-cache.hpp>
 
 class simple_text_node_t : public wf::scene::node_t
 {
@@ -12,21 +14,40 @@ class simple_text_node_t : public wf::scene::node_t
 
         void render(const wf::render_target_t& target, const wf::region_t& region)
         {
+            if (!self->text)
+            {
+                return;
+            }
+
             OpenGL::render_begin(target);
 
             auto g = self->get_bounding_box();
-            for (auto box : region)
-            {
-                target.logic_scissor(wlr_box_from_pixman_box(box));
-                OpenGL::render_texture(self->cr_text.tex.tex, target, g, glm::vec4(1.0f),
-                    OpenGL::TEXTURE_TRANSFORM_INVERT_Y);
-            }
+            batch.add(self->text->tex.tex, g, region, target.get_orthographic_projection(),
+                glm::vec4(1.0f), OpenGL::TEXTURE_TRANSFORM_INVERT_Y);
+            batch.flush();
 
             OpenGL::render_end();
         }
+
+      private:
+        OpenGL::texture_batch_t batch;
     };
 
-    wf::cairo_text_t cr_text;
+    wf::shared_data::ref_ptr_t<wf::text_texture_cache_t> cache;
+    /* The texture which is shown, and the one which replaces it as soon as it has been rasterized */
+    std::shared_ptr<wf::cached_text_texture_t> text, pending;
+    wf::signal::connection_t<wf::cached_text_ready_signal> on_pending_ready = [=] (auto)
+    {
+        show_pending();
+    };
+
+    void show_pending()
+    {
+        on_pending_ready.disconnect();
+        wf::scene::damage_node(this->shared_from_this(), get_bounding_box());
+        text = std::move(pending);
+        wf::scene::damage_node(this->shared_from_this(), get_bounding_box());
+    }
 
   public:
     simple_text_node_t() : node_t(false)
@@ -40,7 +61,13 @@ class simple_text_node_t : public wf::scene::node_t
 
     wf::geometry_t get_bounding_box() override
     {
-        return wf::construct_box(position, size.value_or(cr_text.get_size()));
+        wf::dimensions_t text_size = {0, 0};
+        if (text)
+        {
+            text_size = {text->tex.width, text->tex.height};
+        }
+
+        return wf::construct_box(position, size.value_or(text_size));
     }
 
     void set_position(wf::point_t position)
@@ -58,15 +85,35 @@ class simple_text_node_t : public wf::scene::node_t
         this->params = params;
     }
 
+    /**
+     * Rasterize text asynchronously. Until it is ready, the previous text is shown.
+     * This is off by default, so that the text is always shown from the first frame.
+     *
+     * @param owner An address in the code of the plugin owning this node, see thread_pool_t::schedule().
+     */
+    void set_async(bool async, const void *owner)
+    {
+        this->async = async;
+        this->owner = owner;
+    }
+
     void set_text(std::string text)
     {
-        wf::scene::damage_node(this->shared_from_this(), get_bounding_box());
-        cr_text.render_text(text, params);
-        wf::scene::damage_node(this->shared_from_this(), get_bounding_box());
+        on_pending_ready.disconnect();
+        pending = cache->get(text, params, owner, !async);
+        if (pending->ready)
+        {
+            show_pending();
+        } else
+        {
+            pending->connect(&on_pending_ready);
+        }
     }
 
   private:
     wf::cairo_text_t::params params;
     std::optional<wf::dimensions_t> size;
     wf::point_t position;
+    bool async = false;
+    const void *owner = nullptr;
 };
@@ -1,5 +1,6 @@
 #pragma once
 #include <wayfire/opengl.hpp>
+#include <wayfire/gpu-memory.hpp>
 
 namespace wf
 {
@@ -20,6 +21,7 @@ struct simple_texture_t
             return;
         }
 
+        wf::gpu_memory::set(tex, wf::gpu_memory::TYPE_TEXTURE, 0, nullptr);
         OpenGL::render_begin();
         GL_CALL(glDeleteTextures(1, &tex));
         OpenGL::render_end();
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <wayfire/core.hpp>
+#include <wayfire/gpu-memory.hpp>
+#include <wayfire/signal-provider.hpp>
+#include <wayfire/plugins/common/cairo-util.hpp>
+#include <wayfire/plugins/common/shared-core-data.hpp>
+#include <wayfire/plugins/common/simple-texture.hpp>
+#include <wayfire/thread-pool.hpp>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace wf
+{
+/**
+ * on: cached_text_texture_t
+ * when: Emitted on the main thread when the texture has been rasterized and uploaded.
+ */
+struct cached_text_ready_signal
+{};
+
+/**
+ * A texture with rendered text, see text_texture_cache_t.
+ */
+struct cached_text_texture_t : public wf::signal::provider_t
+{
+    /** The texture, valid only when @ready is set. */
+    wf::simple_texture_t tex;
+    /** The size needed to render the whole text, see cairo_text_t::render_text(). */
+    wf::dimensions_t required_size = {0, 0};
+    bool ready = false;
+    /**
+     * Set if the plugin which requested the entry was unloaded before it was rasterized. The entry never
+     * becomes ready then, and the next request for the same key rasterizes it again.
+     */
+    bool cancelled = false;
+};
+
+/**
+ * A cache of textures with rendered text, shared between all plugins (use it via
+ * wf::shared_data::ref_ptr_t<wf::text_texture_cache_t>).
+ *
+ * Rasterizing text with pango and cairo is slow, so plugins which show many labels at once (for example
+ * titles in scale) would otherwise spend a lot of time before their first frame. Entries are identified by
+ * a key describing everything that affects the result, so the same text is rasterized only once, and new
+ * entries are rasterized on wf::get_core().thread_pool. Until a texture is ready, users should show a
+ * placeholder, usually the texture they showed before, and repaint when cached_text_ready_signal is emitted.
+ *
+ * The rasterizing job runs code of the plugin which requested the entry, so it is tagged with that plugin
+ * and dropped when the plugin is unloaded, see cached_text_texture_t::cancelled.
+ */
+class text_texture_cache_t
+{
+  public:
+    /**
+     * Rasterize the text to a new cairo image surface and set the size needed for the whole text.
+     *
+     * Called on a worker thread for asynchronous entries, so it may use only its own captures.
+     */
+    using rasterizer_t = std::function<cairo_surface_t*(wf::dimensions_t& required_size)>;
+
+    /** The maximal number of entries kept in the cache when they are not used anymore. */
+    static constexpr size_t MAX_UNUSED_ENTRIES = 256;
+
+    text_texture_cache_t()
+    {
+        wf::get_core().connect(&on_trim);
+    }
+
+    text_texture_cache_t(const text_texture_cache_t&) = delete;
+    text_texture_cache_t& operator =(const text_texture_cache_t&) = delete;
+
+    /**
+     * Get the entry for the given key, rasterizing it with @rasterize if it is not cached yet.
+     *
+     * @param owner An address in the code of the calling plugin, see thread_pool_t::schedule().
+     * @param sync Rasterize new entries right away on the calling thread instead of a worker thread, so
+     *   that the returned entry is always ready.
+     */
+    std::shared_ptr<cached_text_texture_t> get(const std::string& key, rasterizer_t rasterize,
+        const void *owner, bool sync = false)
+    {
+        auto it = entries.find(key);
+        if ((it != entries.end()) && !it->second.entry->cancelled)
+        {
+            lru.splice(lru.begin(), lru, it->second.lru);
+            auto entry = it->second.entry;
+            if (sync && !entry->ready)
+            {
+                // Still queued on the thread pool, do not wait for it.
+                wf::dimensions_t size;
+                upload(*entry, rasterize(size), size);
+                cached_text_ready_signal data;
+                entry->emit(&data);
+            }
+
+            return entry;
+        }
+
+        if (it != entries.end())
+        {
+            lru.erase(it->second.lru);
+            entries.erase(it);
+        }
+
+        auto entry = std::make_shared<cached_text_texture_t>();
+        lru.push_front(key);
+        entries[key] = {entry, lru.begin()};
+        evict_unused();
+
+        if (sync)
+        {
+            wf::dimensions_t size;
+            upload(*entry, rasterize(size), size);
+            return entry;
+        }
+
+        auto cancel_guard = std::make_shared<rasterize_guard_t>(entry);
+        wf::get_core().thread_pool->schedule_with_result([rasterize = std::move(rasterize)] ()
+        {
+            rasterized_t result;
+            result.surface.reset(rasterize(result.size));
+            return result;
+        }, [cancel_guard] (rasterized_t result)
+        {
+            cancel_guard->done = true;
+            auto entry = cancel_guard->entry.lock();
+            if (!entry || entry->ready)
+            {
+                return;
+            }
+
+            upload(*entry, result.surface.release(), result.size);
+            cached_text_ready_signal data;
+            entry->emit(&data);
+        }, owner);
+
+        return entry;
+    }
+
+    /** Build a key for text rendered with cairo_text_t::render_text() with the given parameters. */
+    static std::string make_key(const std::string& text, const wf::cairo_text_t::params& par)
+    {
+        auto color = [] (const wf::color_t& c)
+        {
+            return std::to_string(c.r) + "," + std::to_string(c.g) + "," + std::to_string(c.b) + "," +
+                   std::to_string(c.a);
+        };
+
+        return par.font + "|" + std::to_string(par.font_size) + "|" + std::to_string(par.output_scale) +
+               "|" + color(par.bg_color) + "|" + color(par.text_color) + "|" +
+               std::to_string(par.max_size.width) + "x" + std::to_string(par.max_size.height) + "|" +
+               std::to_string(par.bg_rect) + std::to_string(par.rounded_rect) +
+               std::to_string(par.exact_size) + "|" + text;
+    }
+
+    /** Get the entry for text rendered with cairo_text_t::render_text() with the given parameters. */
+    std::shared_ptr<cached_text_texture_t> get(const std::string& text, const wf::cairo_text_t::params& par,
+        const void *owner, bool sync = false)
+    {
+        return get(make_key(text, par), [=] (wf::dimensions_t& size)
+        {
+            return wf::cairo_text_t::rasterize(text, par, size);
+        }, owner, sync);
+    }
+
+  private:
+    struct entry_t
+    {
+        std::shared_ptr<cached_text_texture_t> entry;
+        std::list<std::string>::iterator lru;
+    };
+
+    /** The result of a rasterizing job, the surface is destroyed if the job is dropped before upload. */
+    struct rasterized_t
+    {
+        std::unique_ptr<cairo_surface_t, decltype(&cairo_surface_destroy)> surface{nullptr,
+            &cairo_surface_destroy};
+        wf::dimensions_t size = {0, 0};
+    };
+
+    /**
+     * Held by the callback of a rasterizing job. If the callback is destroyed without running, because the
+     * job was cancelled, the entry is marked as cancelled.
+     */
+    struct rasterize_guard_t
+    {
+        std::weak_ptr<cached_text_texture_t> entry;
+        bool done = false;
+
+        rasterize_guard_t(std::weak_ptr<cached_text_texture_t> entry) : entry(std::move(entry))
+        {}
+
+        ~rasterize_guard_t()
+        {
+            auto cancelled_entry = entry.lock();
+            if (!done && cancelled_entry && !cancelled_entry->ready)
+            {
+                cancelled_entry->cancelled = true;
+            }
+        }
+    };
+
+    std::unordered_map<std::string, entry_t> entries;
+    // Keys of all entries, most recently used first
+    std::list<std::string> lru;
+
+    // Texts which are not shown anymore can be rasterized again, see wf::gpu_memory::trim().
+    wf::signal::connection_t<wf::gpu_memory::trim_signal> on_trim = [=] (wf::gpu_memory::trim_signal*)
+    {
+        evict_unused(0);
+    };
+
+    static void upload(cached_text_texture_t& entry, cairo_surface_t *surface, wf::dimensions_t size)
+    {
+        OpenGL::render_begin();
+        cairo_surface_upload_to_texture(surface, entry.tex);
+        OpenGL::render_end();
+        cairo_surface_destroy(surface);
+        entry.required_size = size;
+        entry.ready = true;
+    }
+
+    /** Drop the least recently used entries which nobody holds anymore, keeping at most @keep of them. */
+    void evict_unused(size_t keep = MAX_UNUSED_ENTRIES)
+    {
+        size_t unused = 0;
+        for (auto it = lru.begin(); it != lru.end();)
+        {
+            auto entry = entries.find(*it);
+            if ((entry->second.entry.use_count() > 1) || (++unused <= keep))
+            {
+                ++it;
+                continue;
+            }
+
+            entries.erase(entry);
+            it = lru.erase(it);
+        }
+    }
+};
+}
@@ -4,17 +4,21 @@
 #include "wayfire/workspace-set.hpp" // IWYU pragma: keep
 #include <glm/gtc/matrix_transform.hpp>
 #include <memory>
+#include <set>
 #include "wayfire/core.hpp"
 #include "wayfire/geometry.hpp"
+#include "wayfire/gpu-memory.hpp"
 #include "wayfire/opengl.hpp"
 #include "wayfire/region.hpp"
 #include "wayfire/scene-input.hpp"
 #include "wayfire/scene-operations.hpp"
 #include "wayfire/scene-render.hpp"
 #include "wayfire/scene.hpp"
+#include "wayfire/signal-definitions.hpp"
 #include "wayfire/signal-provider.hpp"
 #include "wayfire/workspace-stream.hpp"
 #include "wayfire/output.hpp"
+#include "wayfire/util.hpp"
 
 namespace wf
 {
@@ -43,11 +47,14 @@ class workspace_wall_t : public wf::signal::provider_t
     workspace_wall_t(wf::output_t *_output) : output(_output)
     {
         this->viewport = get_wall_rectangle();
+        wf::get_core().connect(&on_trim);
     }
 
     ~workspace_wall_t()
     {
         stop_output_renderer(false);
+        release_idle_node.disconnect();
+        idle_node.reset();
     }
 
     /**
@@ -108,11 +115,24 @@ class workspace_wall_t : public wf::signal::provider_t
     /**
      * Register a render hook and paint the whole output as a desktop wall
      * with the set parameters.
+     *
+     * If the wall was shown recently, the workspace buffers from that time are reused, and only the parts
+     * of the workspaces which changed in the meantime are repainted.
      */
     void start_output_renderer()
     {
         wf::dassert(render_node == nullptr, "Starting workspace-wall twice?");
-        render_node = std::make_shared<workspace_wall_node_t>(this);
+        release_idle_node.disconnect();
+        if (idle_node && idle_node->matches_output())
+        {
+            render_node = std::move(idle_node);
+            render_node->stop_idle_tracking();
+        } else
+        {
+            idle_node.reset();
+            render_node = std::make_shared<workspace_wall_node_t>(this);
+        }
+
         scene::add_front(wf::get_core().scene(), render_node);
     }
 
@@ -130,7 +150,15 @@ class workspace_wall_t : public wf::signal::provider_t
         }
 
         scene::remove_child(render_node);
+
+        // Keep the workspace buffers for a while, so that showing the wall again is cheap.
+        idle_node = std::move(render_node);
         render_node = nullptr;
+        idle_node->start_idle_tracking();
+        release_idle_node.set_timeout(IDLE_BUFFER_TIMEOUT_MS, [=] ()
+        {
+            idle_node.reset();
+        });
 
         if (reset_viewport)
         {
@@ -138,6 +166,19 @@ class workspace_wall_t : public wf::signal::provider_t
         }
     }
 
+    /**
+     * Render the whole workspace on the next frame, instead of only its part which is visible in the
+     * viewport at that time.
+     *
+     * This is useful when the viewport is about to move over the workspace, for example in a workspace
+     * switch animation: without it, each frame renders the newly uncovered strip of the workspace. After
+     * the first frame, the workspace buffer is updated only where the workspace is damaged.
+     */
+    void prerender_workspace(const wf::point_t& ws)
+    {
+        prerender.insert({ws.x, ws.y});
+    }
+
     /**
      * Calculate the geometry of a particular workspace, as described in
      * set_viewport().
@@ -177,10 +218,19 @@ class workspace_wall_t : public wf::signal::provider_t
      */
     void set_ws_dim(const wf::point_t& ws, float value)
     {
+        const bool changed = (get_color_for_workspace(ws) != value);
         render_colors[{ws.x, ws.y}] = value;
-        if (render_node)
+        if (render_node && changed && (viewport.width > 0) && (viewport.height > 0))
         {
-            scene::damage_node(render_node, render_node->get_bounding_box());
+            // Only the workspace itself is repainted, so that fading workspaces (for example while a view
+            // is dragged in Expo) do not cause a repaint of the whole output on each frame.
+            auto box = scale_box(viewport, render_node->get_bounding_box(), get_workspace_rectangle(ws));
+            // The workspace is drawn with subpixel precision, include the partially covered pixels too.
+            box.x     -= 1;
+            box.y     -= 1;
+            box.width += 2;
+            box.height += 2;
+            scene::damage_node(render_node, box);
         }
     }
 
@@ -192,6 +242,8 @@ class workspace_wall_t : public wf::signal::provider_t
     wf::geometry_t viewport = {0, 0, 0, 0};
 
     std::map<std::pair<int, int>, float> render_colors;
+    // Workspaces to render in full on the next frame, see prerender_workspace()
+    std::set<std::pair<int, int>> prerender;
 
     float get_color_for_workspace(wf::point_t ws)
     {
@@ -235,6 +287,13 @@ class workspace_wall_t : public wf::signal::provider_t
             std::shared_ptr<workspace_wall_node_t> self;
             per_workspace_map_t<std::vector<scene::render_instance_uptr>> instances;
 
+            // The frame on which each workspace's buffer was last updated, for throttling
+            per_workspace_map_t<uint64_t> last_update;
+            uint64_t frame_count = 0;
+            // Damage of throttled workspaces, pushed again after the frame so that they are updated later
+            wf::region_t throttled_damage;
+            wf::wl_idle_call idle_push_throttled;
+
             scene::damage_callback push_damage;
             wf::signal::connection_t<scene::node_damage_signal> on_wall_damage =
                 [=] (scene::node_damage_signal *ev)
@@ -301,6 +360,36 @@ class workspace_wall_t : public wf::signal::provider_t
                 return sum;
             }
 
+            /** The scale at which the workspace is shown on the output */
+            float get_projected_scale(int i, int j)
+            {
+                auto bbox = self->workspaces[i][j]->get_bounding_box();
+                return std::max(
+                    1.0 * bbox.width / self->wall->viewport.width,
+                    1.0 * bbox.height / self->wall->viewport.height);
+            }
+
+            /**
+             * Check whether updating the buffer of a workspace should be skipped on this frame.
+             *
+             * Workspaces which are shown much smaller than their actual size (for example in Expo with a
+             * large grid) are updated at a lower rate, because on a small thumbnail the difference is hardly
+             * visible. As the workspace grows, e.g. during the zoom-in animation, full rate is restored.
+             */
+            bool should_throttle(int i, int j)
+            {
+                auto it = last_update[i].find(j);
+                if (it == last_update[i].end())
+                {
+                    // Never rendered yet
+                    return false;
+                }
+
+                const float scale = get_projected_scale(i, j);
+                const uint64_t interval = (scale < 0.125) ? 4 : ((scale < 0.25) ? 2 : 1);
+                return frame_count - it->second < interval;
+            }
+
             bool consider_rescale_workspace_buffer(int i, int j, wf::region_t& visible_damage)
             {
                 // In general, when rendering the auxilliary buffers for each workspace, we can render the
@@ -314,9 +403,7 @@ class workspace_wall_t : public wf::signal::provider_t
                 // Nonetheless, we need to make sure to rescale when this makes sense, and to avoid visual
                 // artifacts.
                 auto bbox = self->workspaces[i][j]->get_bounding_box();
-                const float render_scale = std::max(
-                    1.0 * bbox.width / self->wall->viewport.width,
-                    1.0 * bbox.height / self->wall->viewport.height);
+                const float render_scale  = get_projected_scale(i, j);
                 const float current_scale = self->aux_buffer_current_scale[i][j];
 
                 // Avoid keeping a low resolution if we are going up in the scale (for example, expo exit
@@ -352,33 +439,59 @@ class workspace_wall_t : public wf::signal::provider_t
                 std::vector<scene::render_instruction_t>& instructions,
                 const wf::render_target_t& target, wf::region_t& damage) override
             {
-                // Update workspaces in a render pass
+                // Update the workspaces, all of them in one batch of render passes
+                frame_count++;
+                std::vector<scene::render_pass_params_t> passes;
+                std::vector<wf::point_t> updated;
                 for (int i = 0; i < (int)self->workspaces.size(); i++)
                 {
                     for (int j = 0; j < (int)self->workspaces[i].size(); j++)
                     {
-                        const auto ws_bbox     = self->wall->get_workspace_rectangle({i, j});
-                        const auto visible_box =
+                        const auto ws_bbox = self->wall->get_workspace_rectangle({i, j});
+                        const bool prerender = self->wall->prerender.count({i, j});
+                        const auto visible_box = prerender ? ws_bbox - wf::origin(ws_bbox) :
                             geometry_intersection(self->wall->viewport, ws_bbox) - wf::origin(ws_bbox);
                         wf::region_t visible_damage = self->aux_buffer_damage[i][j] & visible_box;
-                        if (consider_rescale_workspace_buffer(i, j, visible_damage))
+                        // A rescaled buffer has to be repainted right away, otherwise it would be shown
+                        // with the wrong scale.
+                        const bool rescaled = consider_rescale_workspace_buffer(i, j, visible_damage);
+                        if (rescaled)
                         {
                             visible_damage |= visible_box;
                         }
 
+                        if (!visible_damage.empty() && !rescaled && !prerender && should_throttle(i, j))
+                        {
+                            // Keep the old contents for now, the damage stays in aux_buffer_damage.
+                            throttled_damage |= scale_box(self->wall->viewport,
+                                self->get_bounding_box(), get_workspace_rect({i, j}));
+                            continue;
+                        }
+
                         if (!visible_damage.empty())
                         {
+                            last_update[i][j] = frame_count;
                             scene::render_pass_params_t params;
                             params.instances = &instances[i][j];
                             params.damage    = std::move(visible_damage);
                             params.reference_output = self->wall->output;
                             params.target = self->aux_buffers[i][j];
-                            scene::run_render_pass(params, scene::RPASS_EMIT_SIGNALS);
-                            self->aux_buffer_damage[i][j] ^= visible_damage;
+                            passes.push_back(std::move(params));
+                            updated.push_back({i, j});
                         }
                     }
                 }
 
+                scene::run_render_passes(passes, scene::RPASS_EMIT_SIGNALS);
+                for (size_t k = 0; k < passes.size(); k++)
+                {
+                    auto [i, j] = updated[k];
+                    self->aux_buffer_damage[i][j] ^= passes[k].damage;
+                    self->aux_buffer_mipmapped[i][j] = false;
+                }
+
+                self->wall->prerender.clear();
+
                 // Render the wall
                 instructions.push_back(scene::render_instruction_t{
                         .instance = this,
@@ -387,6 +500,15 @@ class workspace_wall_t : public wf::signal::provider_t
                     });
 
                 damage ^= self->get_bounding_box();
+
+                if (!throttled_damage.empty())
+                {
+                    idle_push_throttled.run_once([=] ()
+                    {
+                        push_damage(throttled_damage);
+                        throttled_damage.clear();
+                    });
+                }
             }
 
             static gl_geometry scale_fbox(wf::geometry_t A, wf::geometry_t B, wf::geometry_t box)
@@ -403,9 +525,46 @@ class workspace_wall_t : public wf::signal::provider_t
                 };
             }
 
+            /**
+             * Check whether a workspace should be drawn from the mipmaps of its buffer, generating them if
+             * necessary.
+             *
+             * Mipmaps avoid aliasing when a buffer is shown much smaller than the scale it was rendered at,
+             * for example during the zoom animation of Expo before the buffer is rescaled. Generating them
+             * costs a pass over the whole buffer, so they are generated only in that case, and again only
+             * after the buffer has changed.
+             */
+            bool prepare_mipmaps(int i, int j)
+            {
+                if (!(self->wall->viewport & self->wall->get_workspace_rectangle({i, j})) ||
+                    (get_projected_scale(i, j) > 0.75 * self->aux_buffer_current_scale[i][j]))
+                {
+                    return false;
+                }
+
+                if (!self->aux_buffer_mipmapped[i][j])
+                {
+                    GL_CALL(glBindTexture(GL_TEXTURE_2D, self->aux_buffers[i][j].tex));
+                    GL_CALL(glGenerateMipmap(GL_TEXTURE_2D));
+                    GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+                    self->aux_buffer_mipmapped[i][j] = true;
+                }
+
+                return true;
+            }
+
             void render(const wf::render_target_t& target, const wf::region_t& region) override
             {
                 OpenGL::render_begin(target);
+                per_workspace_map_t<bool> use_mipmaps;
+                for (int i = 0; i < (int)self->workspaces.size(); i++)
+                {
+                    for (int j = 0; j < (int)self->workspaces[i].size(); j++)
+                    {
+                        use_mipmaps[i][j] = prepare_mipmaps(i, j);
+                    }
+                }
+
                 for (auto& box : region)
                 {
                     target.logic_scissor(wlr_box_from_pixman_box(box));
@@ -422,10 +581,12 @@ class workspace_wall_t : public wf::signal::provider_t
 
                             float dim = self->wall->get_color_for_workspace({i, j});
                             const glm::vec4 color = glm::vec4(dim, dim, dim, 1.0);
+                            wf::texture_t texture{buffer.tex};
+                            texture.mipmapped = use_mipmaps[i][j];
 
                             if (!buffer.subbuffer.has_value())
                             {
-                                OpenGL::render_transformed_texture({buffer.tex},
+                                OpenGL::render_transformed_texture(texture,
                                     render_geometry, {}, target.get_orthographic_projection(), color);
                             } else
                             {
@@ -437,7 +598,7 @@ class workspace_wall_t : public wf::signal::provider_t
                                     1.0f,
                                 };
 
-                                OpenGL::render_transformed_texture({buffer.tex},
+                                OpenGL::render_transformed_texture(texture,
                                     render_geometry, tex_geometry,
                                     target.get_orthographic_projection(),
                                     color, OpenGL::TEXTURE_USE_TEX_GEOMETRY);
@@ -489,23 +650,86 @@ class workspace_wall_t : public wf::signal::provider_t
                     auto size =
                         aux_buffers[i][j].framebuffer_box_from_geometry_box(aux_buffers[i][j].geometry);
                     OpenGL::render_begin();
-                    aux_buffers[i][j].allocate(size.width, size.height);
+                    aux_buffers[i][j].allocate_from_pool(size.width, size.height);
                     OpenGL::render_end();
 
                     aux_buffer_damage[i][j] |= aux_buffers[i][j].geometry;
                     aux_buffer_current_scale[i][j] = 1.0;
+                    aux_buffer_mipmapped[i][j] = false;
+                }
+            }
+
+            on_workspace_changed = [=] (wf::workspace_changed_signal*)
+            {
+                // Views change their position relative to the workspaces, which is not always reported as
+                // damage of the right workspace.
+                damage_all_buffers();
+            };
+            on_root_update = [=] (scene::root_node_update_signal*)
+            {
+                // Views may have been added or removed, and our idle instances know only the old ones.
+                damage_all_buffers();
+                start_idle_tracking();
+            };
+        }
+
+        /**
+         * Start accumulating the damage of the workspaces while the wall is not shown.
+         *
+         * The render instances which are used to render the workspaces are destroyed when the wall is
+         * removed from the scenegraph, so separate instances are kept just for tracking damage.
+         */
+        void start_idle_tracking()
+        {
+            idle_instances.clear();
+            for (int i = 0; i < (int)workspaces.size(); i++)
+            {
+                for (int j = 0; j < (int)workspaces[i].size(); j++)
+                {
+                    workspaces[i][j]->gen_render_instances(idle_instances[i][j],
+                        [=] (const wf::region_t& damage) { aux_buffer_damage[i][j] |= damage; },
+                        wall->output);
                 }
             }
+
+            if (!on_workspace_changed.is_connected())
+            {
+                wall->output->connect(&on_workspace_changed);
+                wf::get_core().scene()->connect(&on_root_update);
+            }
+        }
+
+        /** Stop accumulating damage outside of the render instances, see start_idle_tracking(). */
+        void stop_idle_tracking()
+        {
+            on_workspace_changed.disconnect();
+            on_root_update.disconnect();
+            idle_instances.clear();
+        }
+
+        /** Check whether the workspace buffers still match the output and its workspace grid. */
+        bool matches_output()
+        {
+            auto [w, h] = wall->output->wset()->get_workspace_grid_size();
+            if (((int)workspaces.size() != w) || workspaces.empty() || ((int)workspaces[0].size() != h))
+            {
+                return false;
+            }
+
+            auto& buffer = aux_buffers[0][0];
+            return (buffer.geometry == workspaces[0][0]->get_bounding_box()) &&
+                   (buffer.scale == wall->output->handle->scale);
         }
 
         ~workspace_wall_node_t()
         {
+            stop_idle_tracking();
             OpenGL::render_begin();
             for (auto& [_, buffers] : aux_buffers)
             {
                 for (auto& [_, buffer] : buffers)
                 {
-                    buffer.release();
+                    buffer.release_to_pool();
                 }
             }
 
@@ -545,7 +769,37 @@ class workspace_wall_t : public wf::signal::provider_t
         per_workspace_map_t<wf::region_t> aux_buffer_damage;
         // Current rendering scale for the workspace
         per_workspace_map_t<float> aux_buffer_current_scale;
+        // Whether the mipmaps of the buffers are up to date
+        per_workspace_map_t<bool> aux_buffer_mipmapped;
+
+        // Render instances which only track damage while the wall is not shown
+        per_workspace_map_t<std::vector<scene::render_instance_uptr>> idle_instances;
+        wf::signal::connection_t<wf::workspace_changed_signal> on_workspace_changed;
+        wf::signal::connection_t<scene::root_node_update_signal> on_root_update;
+
+        void damage_all_buffers()
+        {
+            for (int i = 0; i < (int)workspaces.size(); i++)
+            {
+                for (int j = 0; j < (int)workspaces[i].size(); j++)
+                {
+                    aux_buffer_damage[i][j] |= aux_buffers[i][j].geometry;
+                }
+            }
+        }
     };
+
     std::shared_ptr<workspace_wall_node_t> render_node;
+
+    // The node of the last time the wall was shown, kept for a while to reuse its buffers
+    static constexpr uint32_t IDLE_BUFFER_TIMEOUT_MS = 30000;
+    std::shared_ptr<workspace_wall_node_t> idle_node;
+    wf::wl_timer<false> release_idle_node;
+    // The idle node is not worth keeping when memory is trimmed, see wf::gpu_memory::trim().
+    wf::signal::connection_t<wf::gpu_memory::trim_signal> on_trim = [=] (wf::gpu_memory::trim_signal*)
+    {
+        release_idle_node.disconnect();
+        idle_node.reset();
+    };
 };
 }
@@ -16,6 +16,11 @@ struct cube_control_signal
     double ease; // for cube deformation; range 0.0-1.0
     bool last_frame; // ends cube animation if true
     bool carried_out; // false if cube is disabled
+    // Draw the workspaces from their textures of the previous frames, without re-rendering them when they
+    // are damaged
+    bool cached_workspaces = false;
+    // The sender schedules the frames itself, so the cube repaints only when it is controlled again
+    bool external_frames = false;
 };
 
 #endif /* end of include guard: CUBE_CONTROL_SIGNAL */
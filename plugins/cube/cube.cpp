@@ -71,7 +71,10 @@ class wayfire_cube : public wf::per_output_plugin_instance_t, public wf::pointer
                     auto push_damage_child = [=] (const wf::region_t& damage)
                     {
                         ws_damage[i] |= damage;
-                        push_damage(self->get_bounding_box());
+                        if (!self->cube->cached_workspaces)
+                        {
+                            push_damage(self->get_bounding_box());
+                        }
                     };
 
                     self->workspaces[i]->gen_render_instances(ws_instances[i],
@@ -110,6 +113,7 @@ class wayfire_cube : public wf::per_output_plugin_instance_t, public wf::pointer
             void render(const wf::render_target_t& target,
                 const wf::region_t& region, const std::any& tag) override
             {
+                std::vector<wf::scene::render_pass_params_t> passes;
                 for (int i = 0; i < (int)ws_instances.size(); i++)
                 {
                     framebuffers[i].geometry = self->workspaces[i]->get_bounding_box();
@@ -120,20 +124,34 @@ class wayfire_cube : public wf::per_output_plugin_instance_t, public wf::pointer
 
                     auto size = framebuffers[i].framebuffer_box_from_geometry_box(framebuffers[i].geometry);
                     OpenGL::render_begin();
-                    framebuffers[i].allocate(size.width, size.height);
+                    const bool reallocated = framebuffers[i].allocate(size.width, size.height);
+                    if (reallocated)
+                    {
+                        ws_damage[i] |= framebuffers[i].geometry;
+                    }
+
                     OpenGL::render_end();
 
+                    // The texture still holds the workspace from the last frame, so the cube face can be
+                    // drawn from it directly if nothing on the workspace changed in the meantime. With cached
+                    // workspaces, the damage is kept until the workspaces are rendered normally again.
+                    if (ws_damage[i].empty() || (self->cube->cached_workspaces && !reallocated))
+                    {
+                        continue;
+                    }
+
                     wf::scene::render_pass_params_t params;
                     params.instances = &ws_instances[i];
                     params.damage    = ws_damage[i];
                     params.reference_output = self->cube->output;
                     params.target = framebuffers[i];
-                    wf::scene::run_render_pass(params, wf::scene::RPASS_CLEAR_BACKGROUND |
-                        wf::scene::RPASS_EMIT_SIGNALS);
-
+                    passes.push_back(std::move(params));
                     ws_damage[i].clear();
                 }
 
+                wf::scene::run_render_passes(passes, wf::scene::RPASS_CLEAR_BACKGROUND |
+                    wf::scene::RPASS_EMIT_SIGNALS);
+
                 self->cube->render(target.translated(-wf::origin(self->get_bounding_box())), framebuffers);
             }
 
@@ -332,17 +350,22 @@ class wayfire_cube : public wf::per_output_plugin_instance_t, public wf::pointer
         animation.projection = glm::perspective(45.0f, 1.f, 0.1f, 100.f);
     }
 
+    /* See cube_control_signal::cached_workspaces */
+    bool cached_workspaces = false;
+
     wf::signal::connection_t<cube_control_signal> on_cube_control = [=] (cube_control_signal *d)
     {
-        rotate_and_zoom_cube(d->angle, d->zoom, d->ease, d->last_frame);
+        rotate_and_zoom_cube(d->angle, d->zoom, d->ease, d->last_frame, d->cached_workspaces,
+            d->external_frames);
         d->carried_out = true;
     };
 
     void rotate_and_zoom_cube(double angle, double zoom, double ease,
-        bool last_frame)
+        bool last_frame, bool cached, bool external_frames)
     {
         if (last_frame)
         {
+            cached_workspaces = false;
             deactivate();
 
             return;
@@ -353,6 +376,14 @@ class wayfire_cube : public wf::per_output_plugin_instance_t, public wf::pointer
             return;
         }
 
+        if (cached_workspaces && !cached)
+        {
+            // Show what changed on the workspaces while they were cached.
+            wf::scene::damage_node(render_node, render_node->get_bounding_box());
+        }
+
+        cached_workspaces = cached;
+
         float offset_z = identity_z_offset + Z_OFFSET_NEAR;
 
         animation.cube_animation.rotation.set(angle, angle);
@@ -362,6 +393,13 @@ class wayfire_cube : public wf::per_output_plugin_instance_t, public wf::pointer
         animation.cube_animation.offset_y.set(0, 0);
         animation.cube_animation.offset_z.set(offset_z, offset_z);
 
+        if (external_frames)
+        {
+            update_view_matrix();
+            wf::scene::damage_node(render_node, render_node->get_bounding_box());
+            return;
+        }
+
         animation.cube_animation.start();
         update_view_matrix();
         output->render->schedule_redraw();
@@ -4,11 +4,29 @@
 #include <config.h>
 #include <wayfire/core.hpp>
 #include <wayfire/img.hpp>
+#include <algorithm>
 
 #include "cubemap-shaders.tpp"
 
 wf_cube_background_cubemap::wf_cube_background_cubemap()
 {
+    on_texture_ready = [=] (wf::cached_image_ready_signal*)
+    {
+        if (loading->cancelled)
+        {
+            // Another plugin started the load and was unloaded, start it again on the next frame.
+            loading.reset();
+            last_background_image.clear();
+            return;
+        }
+
+        texture = std::move(loading);
+        if (texture->tex == (GLuint)-1)
+        {
+            LOGE("Failed to load cubemap background image from \"%s\".", last_background_image.c_str());
+        }
+    };
+
     create_program();
     reload_texture();
 }
@@ -17,7 +35,6 @@ wf_cube_background_cubemap::~wf_cube_background_cubemap()
 {
     OpenGL::render_begin();
     program.free_resources();
-    GL_CALL(glDeleteTextures(1, &tex));
     GL_CALL(glDeleteBuffers(1, &vbo_cube_vertices));
     GL_CALL(glDeleteBuffers(1, &ibo_cube_indices));
     OpenGL::render_end();
@@ -28,42 +45,55 @@ void wf_cube_background_cubemap::create_program()
     OpenGL::render_begin();
     program.set_simple(
         OpenGL::compile_program(cubemap_vertex, cubemap_fragment));
+    GL_CALL(glGenBuffers(1, &vbo_cube_vertices));
+    GL_CALL(glGenBuffers(1, &ibo_cube_indices));
     OpenGL::render_end();
 }
 
 void wf_cube_background_cubemap::reload_texture()
 {
-    if (!last_background_image.compare(background_image))
+    if (!last_background_image.compare(background_image) && (last_max_size == max_size))
     {
         return;
     }
 
+    // Decoding big images takes long, keep showing the old texture until the new one is ready.
     last_background_image = background_image;
+    last_max_size = max_size;
 
+    GLint limit;
     OpenGL::render_begin();
-    if (tex == (uint32_t)-1)
+    GL_CALL(glGetIntegerv(GL_MAX_CUBE_MAP_TEXTURE_SIZE, &limit));
+    OpenGL::render_end();
+    if (last_max_size > 0)
     {
-        GL_CALL(glGenTextures(1, &tex));
-        GL_CALL(glGenBuffers(1, &vbo_cube_vertices));
-        GL_CALL(glGenBuffers(1, &ibo_cube_indices));
+        limit = std::min(limit, last_max_size);
     }
 
-    GL_CALL(glBindTexture(GL_TEXTURE_CUBE_MAP, tex));
-    if (!image_io::load_from_file(last_background_image, GL_TEXTURE_CUBE_MAP))
+    auto downscale = [=] (image_io::decoded_image_t& image)
     {
-        LOGE("Failed to load cubemap background image from \"%s\".",
-            last_background_image.c_str());
-
-        GL_CALL(glDeleteTextures(1, &tex));
-        GL_CALL(glDeleteBuffers(1, &vbo_cube_vertices));
-        GL_CALL(glDeleteBuffers(1, &ibo_cube_indices));
-        tex = -1;
-    }
+        // Keep the layout of the faces, see load_data_as_cubemap()
+        const int face = image.width / 4;
+        if ((face > limit) && (face == image.height / 3))
+        {
+            image_io::downscale_image(image, 4 * limit, 3 * limit);
+        }
+    };
 
-    if (tex != (uint32_t)-1)
+    auto upload = [] (const image_io::decoded_image_t& image, GLuint tex) -> int64_t
     {
+        GL_CALL(glBindTexture(GL_TEXTURE_CUBE_MAP, tex));
+        if (!image_io::upload_image(image, GL_TEXTURE_CUBE_MAP))
+        {
+            GL_CALL(glBindTexture(GL_TEXTURE_CUBE_MAP, 0));
+            return -1;
+        }
+
+        // The background is mostly drawn much smaller than the image, mipmaps avoid aliasing and
+        // sampling the full resolution faces.
+        GL_CALL(glGenerateMipmap(GL_TEXTURE_CUBE_MAP));
         GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
-            GL_LINEAR));
+            GL_LINEAR_MIPMAP_LINEAR));
         GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER,
             GL_LINEAR));
         GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S,
@@ -72,10 +102,24 @@ void wf_cube_background_cubemap::reload_texture()
             GL_CLAMP_TO_EDGE));
         GL_CALL(glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R,
             GL_CLAMP_TO_EDGE));
-    }
+        GL_CALL(glBindTexture(GL_TEXTURE_CUBE_MAP, 0));
 
-    GL_CALL(glBindTexture(GL_TEXTURE_CUBE_MAP, 0));
-    OpenGL::render_end();
+        // Six faces, and a third more for the mipmaps
+        const int64_t face = image.width / 4;
+        return face * face * 4 * 6 * 4 / 3;
+    };
+
+    // The texture is shared with the cubes on the other outputs.
+    on_texture_ready.disconnect();
+    loading = image_cache->get("cube/cubemap " + std::to_string(limit) + " " + last_background_image,
+        last_background_image, &typeid(*this), upload, downscale);
+    if (loading->ready)
+    {
+        texture = std::move(loading);
+    } else
+    {
+        loading->connect(&on_texture_ready);
+    }
 }
 
 void wf_cube_background_cubemap::render_frame(const wf::render_target_t& fb,
@@ -84,9 +128,18 @@ void wf_cube_background_cubemap::render_frame(const wf::render_target_t& fb,
     reload_texture();
 
     OpenGL::render_begin(fb);
+    const GLuint tex = texture ? texture->tex : (GLuint)-1;
     if (tex == (uint32_t)-1)
     {
-        GL_CALL(glClearColor(TEX_ERROR_FLAG_COLOR));
+        if (!texture)
+        {
+            // Still loading the first image
+            GL_CALL(glClearColor(0.0, 0.0, 0.0, 1.0));
+        } else
+        {
+            GL_CALL(glClearColor(TEX_ERROR_FLAG_COLOR));
+        }
+
         GL_CALL(glClear(GL_COLOR_BUFFER_BIT));
         OpenGL::render_end();
 
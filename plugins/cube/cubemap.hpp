@@ -2,6 +2,8 @@
 #define WF_CUBE_CUBEMAP_HPP
 
 #include "cube-background.hpp"
+#include <wayfire/plugins/common/image-texture-cache.hpp>
+#include <memory>
 
 class wf_cube_background_cubemap : public wf_cube_background_base
 {
@@ -17,12 +19,18 @@ class wf_cube_background_cubemap : public wf_cube_background_base
     void create_program();
 
     OpenGL::program_t program;
-    GLuint tex = -1;
-    GLuint vbo_cube_vertices;
-    GLuint ibo_cube_indices;
+    wf::shared_data::ref_ptr_t<wf::image_texture_cache_t> image_cache;
+    // The texture which is shown, and the one which replaces it once it is loaded
+    std::shared_ptr<wf::cached_image_texture_t> texture;
+    std::shared_ptr<wf::cached_image_texture_t> loading;
+    wf::signal::connection_t<wf::cached_image_ready_signal> on_texture_ready;
+    GLuint vbo_cube_vertices = 0;
+    GLuint ibo_cube_indices  = 0;
 
     std::string last_background_image;
+    int last_max_size = -1;
     wf::option_wrapper_t<std::string> background_image{"cube/cubemap_image"};
+    wf::option_wrapper_t<int> max_size{"cube/background_max_size"};
 };
 
 #endif /* end of include guard: WF_CUBE_CUBEMAP_HPP */
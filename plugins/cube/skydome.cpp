@@ -7,6 +7,7 @@
 
 
 #include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
 #include "shaders.tpp"
 
 #define SKYDOME_GRID_WIDTH 128
@@ -15,6 +16,23 @@
 wf_cube_background_skydome::wf_cube_background_skydome(wf::output_t *output)
 {
     this->output = output;
+    on_texture_ready = [=] (wf::cached_image_ready_signal*)
+    {
+        if (loading->cancelled)
+        {
+            // Another plugin started the load and was unloaded, start it again on the next frame.
+            loading.reset();
+            last_background_image.clear();
+            return;
+        }
+
+        texture = std::move(loading);
+        if (texture->tex == (GLuint)-1)
+        {
+            LOGE("Failed to load skydome image from \"%s\".", last_background_image.c_str());
+        }
+    };
+
     load_program();
     reload_texture();
 }
@@ -23,11 +41,6 @@ wf_cube_background_skydome::~wf_cube_background_skydome()
 {
     OpenGL::render_begin();
     program.free_resources();
-    if (tex != (GLuint) - 1)
-    {
-        GL_CALL(glDeleteTextures(1, &tex));
-    }
-
     OpenGL::render_end();
 }
 
@@ -40,38 +53,62 @@ void wf_cube_background_skydome::load_program()
 
 void wf_cube_background_skydome::reload_texture()
 {
-    if (!last_background_image.compare(background_image))
+    if (!last_background_image.compare(background_image) && (last_max_size == max_size))
     {
         return;
     }
 
+    // Decoding big images takes long, keep showing the old texture until the new one is ready.
     last_background_image = background_image;
-    OpenGL::render_begin();
+    last_max_size = max_size;
 
-    if (tex == (uint32_t)-1)
+    GLint limit;
+    OpenGL::render_begin();
+    GL_CALL(glGetIntegerv(GL_MAX_TEXTURE_SIZE, &limit));
+    OpenGL::render_end();
+    if (last_max_size > 0)
     {
-        GL_CALL(glGenTextures(1, &tex));
+        limit = std::min(limit, last_max_size);
     }
 
-    GL_CALL(glBindTexture(GL_TEXTURE_2D, tex));
+    auto downscale = [=] (image_io::decoded_image_t& image)
+    {
+        const double scale = std::min(1.0, (double)limit / std::max(image.width, image.height));
+        image_io::downscale_image(image, int(image.width * scale), int(image.height * scale));
+    };
 
-    if (image_io::load_from_file(last_background_image, GL_TEXTURE_2D))
+    auto upload = [] (const image_io::decoded_image_t& image, GLuint tex) -> int64_t
     {
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, tex));
+        if (!image_io::upload_image(image, GL_TEXTURE_2D))
+        {
+            GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+            return -1;
+        }
+
+        // The skydome is mostly drawn much smaller than the image, mipmaps avoid aliasing and
+        // sampling the full resolution texture.
+        GL_CALL(glGenerateMipmap(GL_TEXTURE_2D));
         GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
-        GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+        GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR));
         GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
         GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+        // The mipmaps add a third
+        return int64_t(image.width) * image.height * 4 * 4 / 3;
+    };
+
+    // The texture is shared with the cubes on the other outputs.
+    on_texture_ready.disconnect();
+    loading = image_cache->get("cube/skydome " + std::to_string(limit) + " " + last_background_image,
+        last_background_image, &typeid(*this), upload, downscale);
+    if (loading->ready)
+    {
+        texture = std::move(loading);
     } else
     {
-        LOGE("Failed to load skydome image from \"%s\".",
-            last_background_image.c_str());
-        GL_CALL(glDeleteTextures(1, &tex));
-        tex = -1;
+        loading->connect(&on_texture_ready);
     }
-
-    GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
-
-    OpenGL::render_end();
 }
 
 void wf_cube_background_skydome::fill_vertices()
@@ -135,9 +172,18 @@ void wf_cube_background_skydome::render_frame(const wf::render_target_t& fb,
     fill_vertices();
     reload_texture();
 
+    const GLuint tex = texture ? texture->tex : (GLuint)-1;
     if (tex == (uint32_t)-1)
     {
-        GL_CALL(glClearColor(TEX_ERROR_FLAG_COLOR));
+        if (!texture)
+        {
+            // Still loading the first image
+            GL_CALL(glClearColor(0.0, 0.0, 0.0, 1.0));
+        } else
+        {
+            GL_CALL(glClearColor(TEX_ERROR_FLAG_COLOR));
+        }
+
         GL_CALL(glClear(GL_COLOR_BUFFER_BIT));
 
         return;
@@ -3,6 +3,8 @@
 
 #include "cube-background.hpp"
 #include "wayfire/output.hpp"
+#include <wayfire/plugins/common/image-texture-cache.hpp>
+#include <memory>
 #include <vector>
 
 class wf_cube_background_skydome : public wf_cube_background_base
@@ -22,16 +24,22 @@ class wf_cube_background_skydome : public wf_cube_background_base
     void reload_texture();
 
     OpenGL::program_t program;
-    GLuint tex = -1;
+    wf::shared_data::ref_ptr_t<wf::image_texture_cache_t> image_cache;
+    // The texture which is shown, and the one which replaces it once it is loaded
+    std::shared_ptr<wf::cached_image_texture_t> texture;
+    std::shared_ptr<wf::cached_image_texture_t> loading;
+    wf::signal::connection_t<wf::cached_image_ready_signal> on_texture_ready;
 
     std::vector<GLfloat> vertices;
     std::vector<GLfloat> coords;
     std::vector<GLuint> indices;
 
     std::string last_background_image;
+    int last_max_size = -1;
     int last_mirror = -1;
     wf::option_wrapper_t<std::string> background_image{"cube/skydome_texture"};
     wf::option_wrapper_t<bool> mirror_opt{"cube/skydome_mirror"};
+    wf::option_wrapper_t<int> max_size{"cube/background_max_size"};
 };
 
 #endif /* end of include guard: WF_CUBE_BACKGROUND_SKYDOME */
@@ -1,7 +1,10 @@
 #include "deco-button.hpp"
 #include "deco-theme.hpp"
 #include <wayfire/opengl.hpp>
+#include <wayfire/gpu-memory.hpp>
 #include <wayfire/plugins/common/cairo-util.hpp>
+#include <algorithm>
+#include <cmath>
 
 #define HOVERED  1.0
 #define NORMAL   0.0
@@ -11,6 +14,98 @@ namespace wf
 {
 namespace decor
 {
+/* The number of button types, and of hover shades in the range [-1, 1] */
+static constexpr int BUTTON_TYPES = 3;
+static constexpr int HOVER_SHADES = 2 * button_atlas_t::HOVER_STEPS + 1;
+/* Transparent pixels around each icon, so that linear filtering does not pick up its neighbours */
+static constexpr int ICON_PADDING = 1;
+
+button_atlas_t::~button_atlas_t()
+{
+    if (tex)
+    {
+        wf::gpu_memory::set(tex, wf::gpu_memory::TYPE_TEXTURE, 0, nullptr);
+        OpenGL::render_begin();
+        GL_CALL(glDeleteTextures(1, &tex));
+        OpenGL::render_end();
+    }
+}
+
+void button_atlas_t::reset(int size)
+{
+    if (tex)
+    {
+        wf::gpu_memory::set(tex, wf::gpu_memory::TYPE_TEXTURE, 0, nullptr);
+        GL_CALL(glDeleteTextures(1, &tex));
+    }
+
+    const int cells     = BUTTON_TYPES * HOVER_SHADES;
+    const int cell_size = size + 2 * ICON_PADDING;
+    icon_size    = size;
+    columns      = std::ceil(std::sqrt(cells));
+    texture_size = columns * cell_size;
+    rasterized.assign(cells, false);
+
+    std::vector<uint8_t> transparent(4 * texture_size * texture_size, 0);
+    GL_CALL(glGenTextures(1, &tex));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, tex));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_BLUE));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED));
+    GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, texture_size, texture_size, 0,
+        GL_RGBA, GL_UNSIGNED_BYTE, transparent.data()));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+    wf::gpu_memory::set(tex, wf::gpu_memory::TYPE_TEXTURE, int64_t(texture_size) * texture_size * 4,
+        __builtin_return_address(0));
+}
+
+button_atlas_t::icon_t button_atlas_t::get_icon(button_type_t type, double hover_progress, int size)
+{
+    size = std::max(size, 1);
+    if (!tex || (size != icon_size))
+    {
+        reset(size);
+    }
+
+    const int type_index = (type == BUTTON_CLOSE) ? 0 : ((type == BUTTON_TOGGLE_MAXIMIZE) ? 1 : 2);
+    const int shade      = std::clamp((int)std::round(hover_progress * HOVER_STEPS),
+        -HOVER_STEPS, HOVER_STEPS);
+    const int cell       = type_index * HOVER_SHADES + shade + HOVER_STEPS;
+
+    const int cell_size = size + 2 * ICON_PADDING;
+    const int x = (cell % columns) * cell_size + ICON_PADDING;
+    const int y = (cell / columns) * cell_size + ICON_PADDING;
+    if (!rasterized[cell])
+    {
+        const decoration_theme_t::button_state_t state = {
+            .width  = 1.0 * size,
+            .height = 1.0 * size,
+            .border = 1.0,
+            .hover_progress = 1.0 * shade / HOVER_STEPS,
+        };
+
+        auto surface = decoration_theme_t::get_button_surface(type, state);
+        cairo_surface_flush(surface);
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, tex));
+        GL_CALL(glPixelStorei(GL_UNPACK_ROW_LENGTH, cairo_image_surface_get_stride(surface) / 4));
+        GL_CALL(glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, size, size, GL_RGBA, GL_UNSIGNED_BYTE,
+            cairo_image_surface_get_data(surface)));
+        GL_CALL(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+        cairo_surface_destroy(surface);
+        rasterized[cell] = true;
+    }
+
+    // The first row of the cairo surface is at the top of the icon, which texture_batch_t maps to texg.y2.
+    icon_t icon{tex, {}};
+    icon.texg.x1 = 1.0f * x / texture_size;
+    icon.texg.x2 = 1.0f * (x + size) / texture_size;
+    icon.texg.y1 = 1.0f * (y + size) / texture_size;
+    icon.texg.y2 = 1.0f * y / texture_size;
+    return icon;
+}
+
 button_t::button_t(const decoration_theme_t& t, std::function<void()> damage) :
     theme(t), damage_callback(damage)
 {}
@@ -19,7 +114,6 @@ void button_t::set_button_type(button_type_t type)
 {
     this->type = type;
     this->hover.animate(0, 0);
-    update_texture();
     add_idle_damage();
 }
 
@@ -63,22 +157,8 @@ void button_t::set_pressed(bool is_pressed)
     add_idle_damage();
 }
 
-void button_t::render(const wf::render_target_t& fb, wf::geometry_t geometry,
-    wf::geometry_t scissor)
-{
-    OpenGL::render_begin(fb);
-    fb.logic_scissor(scissor);
-    OpenGL::render_texture(button_texture.tex, fb, geometry, {1, 1, 1, 1},
-        OpenGL::TEXTURE_TRANSFORM_INVERT_Y);
-    OpenGL::render_end();
-
-    if (this->hover.running())
-    {
-        add_idle_damage();
-    }
-}
-
-void button_t::update_texture()
+void button_t::render(OpenGL::texture_batch_t& batch, const wf::render_target_t& fb,
+    wf::geometry_t geometry, const wf::region_t& damage)
 {
     /**
      * We render at 100% resolution
@@ -86,18 +166,18 @@ void button_t::update_texture()
      * to 70% of the titlebar height. Thus we will have
      * a very crisp image
      */
-    decoration_theme_t::button_state_t state = {
-        .width  = 1.0 * theme.get_title_height(),
-        .height = 1.0 * theme.get_title_height(),
-        .border = 1.0,
-        .hover_progress = hover,
+    auto icon = atlas->get_icon(type, hover, theme.get_title_height());
+    gl_geometry g = {
+        1.0f * geometry.x, 1.0f * geometry.y,
+        1.0f * (geometry.x + geometry.width), 1.0f * (geometry.y + geometry.height),
     };
+    batch.add(icon.texture, g, icon.texg, damage, fb.get_orthographic_projection(),
+        glm::vec4(1.0f), OpenGL::TEXTURE_USE_TEX_GEOMETRY);
 
-    auto surface = theme.get_button_surface(type, state);
-    OpenGL::render_begin();
-    cairo_surface_upload_to_texture(surface, this->button_texture);
-    OpenGL::render_end();
-    cairo_surface_destroy(surface);
+    if (this->hover.running())
+    {
+        add_idle_damage();
+    }
 }
 
 void button_t::add_idle_damage()
@@ -105,7 +185,6 @@ void button_t::add_idle_damage()
     this->idle_damage.run_once([=] ()
     {
         this->damage_callback();
-        update_texture();
     });
 }
 }
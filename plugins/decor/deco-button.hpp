@@ -5,7 +5,8 @@
 #include <wayfire/opengl.hpp>
 #include <wayfire/render-manager.hpp>
 #include <wayfire/util/duration.hpp>
-#include <wayfire/plugins/common/simple-texture.hpp>
+#include <wayfire/plugins/common/shared-core-data.hpp>
+#include <vector>
 
 #include <cairo.h>
 #include <pango/pango.h>
@@ -24,6 +25,53 @@ enum button_type_t
     BUTTON_MINIMIZE        = 1 << 2,
 };
 
+/**
+ * A texture atlas with the icons of all buttons in all hover shades, shared by all decorations (use it via
+ * wf::shared_data::ref_ptr_t<wf::decor::button_atlas_t>).
+ *
+ * Since all icons live in a single texture, the buttons of a decoration are drawn with a single draw call
+ * through OpenGL::texture_batch_t. Icons are rasterized the first time they are needed, and the whole
+ * atlas is rebuilt when the button size changes.
+ */
+class button_atlas_t
+{
+  public:
+    /** The number of distinct hover shades between the normal and the hovered state */
+    static constexpr int HOVER_STEPS = 32;
+
+    struct icon_t
+    {
+        wf::texture_t texture;
+        /** The area of the icon in the texture, for OpenGL::TEXTURE_USE_TEX_GEOMETRY */
+        gl_geometry texg;
+    };
+
+    button_atlas_t() = default;
+    ~button_atlas_t();
+    button_atlas_t(const button_atlas_t&) = delete;
+    button_atlas_t& operator =(const button_atlas_t&) = delete;
+
+    /**
+     * Get the icon for the given button, rasterizing it if necessary.
+     * Must be called between OpenGL::render_begin() and OpenGL::render_end().
+     *
+     * @param type The button type.
+     * @param hover_progress The hover progress, see decoration_theme_t::button_state_t.
+     * @param size The width and height of the icon.
+     */
+    icon_t get_icon(button_type_t type, double hover_progress, int size);
+
+  private:
+    GLuint tex = 0;
+    int icon_size    = 0;
+    int columns      = 0;
+    int texture_size = 0;
+    /* Whether the icon in the given cell has already been rasterized */
+    std::vector<bool> rasterized;
+
+    void reset(int size);
+};
+
 class button_t
 {
   public:
@@ -64,22 +112,26 @@ class button_t
     void set_pressed(bool is_pressed);
 
     /**
-     * Render the button on the given framebuffer at the given coordinates.
-     * Precondition: set_button_type() has been called, otherwise result is no-op
+     * Add the button to a batch which renders to the given framebuffer.
+     * Precondition: set_button_type() has been called.
+     * Must be called between OpenGL::render_begin() and OpenGL::render_end().
      *
+     * @param batch The batch to add the button to
      * @param buffer The target framebuffer
      * @param geometry The geometry of the button, in logical coordinates
-     * @param scissor The scissor rectangle to render.
+     * @param damage The region to render, in logical coordinates
      */
-    void render(const wf::render_target_t& buffer, wf::geometry_t geometry,
-        wf::geometry_t scissor);
+    void render(OpenGL::texture_batch_t& batch, const wf::render_target_t& buffer,
+        wf::geometry_t geometry, const wf::region_t& damage);
 
   private:
     const decoration_theme_t& theme;
 
     /* Whether the button needs repaint */
     button_type_t type;
-    wf::simple_texture_t button_texture;
+
+    /* The icons of all buttons, so that the hover animation does not rasterize the button on every frame */
+    wf::shared_data::ref_ptr_t<button_atlas_t> atlas;
 
     /* Whether the button is currently being hovered */
     bool is_hovered = false;
@@ -92,11 +144,6 @@ class button_t
     wf::wl_idle_call idle_damage;
     /** Damage button the next time the main loop goes idle */
     void add_idle_damage();
-
-    /**
-     * Redraw the button surface and store it as a texture
-     */
-    void update_texture();
 };
 }
 }
@@ -24,6 +24,8 @@
 #include <wayfire/window-manager.hpp>
 
 #include <wayfire/plugins/common/cairo-util.hpp>
+#include <wayfire/plugins/common/shared-core-data.hpp>
+#include <wayfire/plugins/common/text-texture-cache.hpp>
 
 #include <cairo.h>
 
@@ -40,27 +42,51 @@ class simple_decoration_node_t : public wf::scene::node_t, public wf::pointer_in
         }
     };
 
-    void update_title(int width, int height, double scale)
+    void update_title(int height, double scale)
     {
         if (auto view = _view.lock())
         {
-            int target_width  = width * scale;
+            // The title is rasterized as wide as the text, so that resizing the view does not need a new
+            // texture. Only the part which fits in the titlebar is shown.
             int target_height = height * scale;
-            if ((title_texture.tex.width != target_width) || (title_texture.tex.height != target_height) ||
+            if ((title_texture.current_height != target_height) ||
                 (title_texture.current_text != view->get_title()))
             {
-                auto surface = theme.render_text(view->get_title(), target_width, target_height);
-                cairo_surface_upload_to_texture(surface, title_texture.tex);
-                cairo_surface_destroy(surface);
-                title_texture.current_text = view->get_title();
+                // The old title is shown until the new one has been rasterized.
+                const std::string text = view->get_title();
+                const std::string font = theme.get_font();
+                const std::string key  = "decoration|" + font + "|" + std::to_string(target_height) + "|" +
+                    text;
+
+                title_texture.on_ready.disconnect();
+                title_texture.pending = title_texture.cache->get(key, [=] (wf::dimensions_t& size)
+                {
+                    auto surface = wf::decor::decoration_theme_t::render_title(text, font, target_height);
+                    size = {cairo_image_surface_get_width(surface), cairo_image_surface_get_height(surface)};
+                    return surface;
+                }, &typeid(*this));
+
+                title_texture.current_text   = text;
+                title_texture.current_height = target_height;
+                if (title_texture.pending->ready)
+                {
+                    title_texture.shown = std::move(title_texture.pending);
+                } else
+                {
+                    title_texture.pending->connect(&title_texture.on_ready);
+                }
             }
         }
     }
 
     struct
     {
-        wf::simple_texture_t tex;
+        wf::shared_data::ref_ptr_t<wf::text_texture_cache_t> cache;
+        // The texture which is shown, and the one which replaces it as soon as it has been rasterized
+        std::shared_ptr<wf::cached_text_texture_t> shown, pending;
+        wf::signal::connection_t<wf::cached_text_ready_signal> on_ready;
         std::string current_text = "";
+        int current_height = 0;
     } title_texture;
 
   public:
@@ -80,6 +106,15 @@ class simple_decoration_node_t : public wf::scene::node_t, public wf::pointer_in
     {
         this->_view = view->weak_from_this();
         view->connect(&title_set);
+        title_texture.on_ready = [=] (wf::cached_text_ready_signal*)
+        {
+            title_texture.on_ready.disconnect();
+            title_texture.shown = std::move(title_texture.pending);
+            if (auto view = _view.lock())
+            {
+                view->damage();
+            }
+        };
         if (view->parent)
         {
             theme.set_buttons(wf::decor::button_type_t(wf::decor::BUTTON_TOGGLE_MAXIMIZE |
@@ -99,12 +134,24 @@ class simple_decoration_node_t : public wf::scene::node_t, public wf::pointer_in
         return {-current_thickness, -current_titlebar};
     }
 
-    void render_title(const wf::render_target_t& fb,
-        wf::geometry_t geometry)
+    void render_title(OpenGL::texture_batch_t& batch, const wf::render_target_t& fb,
+        wf::geometry_t geometry, const wf::region_t& damage)
     {
-        update_title(geometry.width, geometry.height, fb.scale);
-        OpenGL::render_texture(title_texture.tex.tex, fb, geometry,
-            glm::vec4(1.0f), OpenGL::TEXTURE_TRANSFORM_INVERT_Y);
+        update_title(geometry.height, fb.scale);
+        if (!title_texture.shown || (title_texture.shown->tex.width <= 0))
+        {
+            return;
+        }
+
+        const auto& tex = title_texture.shown->tex;
+        // Crop the title to the titlebar, the texture is never stretched.
+        const float visible = std::min(1.0f, geometry.width * fb.scale / tex.width);
+        gl_geometry g = {
+            1.0f * geometry.x, 1.0f * geometry.y,
+            geometry.x + visible * tex.width / fb.scale, 1.0f * (geometry.y + geometry.height),
+        };
+        batch.add(tex.tex, g, {0.0f, 0.0f, visible, 1.0f}, damage, fb.get_orthographic_projection(),
+            glm::vec4(1.0f), OpenGL::TEXTURE_TRANSFORM_INVERT_Y | OpenGL::TEXTURE_USE_TEX_GEOMETRY);
     }
 
     void render_scissor_box(const wf::render_target_t& fb, wf::point_t origin,
@@ -120,23 +167,30 @@ class simple_decoration_node_t : public wf::scene::node_t, public wf::pointer_in
         }
 
         theme.render_background(fb, geometry, scissor, activated);
+    }
 
-        /* Draw title & buttons */
+    /**
+     * Draw the title & buttons in the whole damaged region. The buttons share the texture of the button
+     * atlas, so all of them are drawn with a single draw call.
+     */
+    void render_elements(OpenGL::texture_batch_t& batch, const wf::render_target_t& fb,
+        wf::point_t origin, const wf::region_t& damage)
+    {
+        OpenGL::render_begin(fb);
         auto renderables = layout.get_renderable_areas();
         for (auto item : renderables)
         {
             if (item->get_type() == wf::decor::DECORATION_AREA_TITLE)
             {
-                OpenGL::render_begin(fb);
-                fb.logic_scissor(scissor);
-                render_title(fb, item->get_geometry() + origin);
-                OpenGL::render_end();
+                render_title(batch, fb, item->get_geometry() + origin, damage);
             } else // button
             {
-                item->as_button().render(fb,
-                    item->get_geometry() + origin, scissor);
+                item->as_button().render(batch, fb, item->get_geometry() + origin, damage);
             }
         }
+
+        batch.flush();
+        OpenGL::render_end();
     }
 
     std::optional<wf::scene::input_node_t> find_node_at(const wf::pointf_t& at) override
@@ -185,7 +239,7 @@ class simple_decoration_node_t : public wf::scene::node_t, public wf::pointer_in
         void schedule_instructions(std::vector<wf::scene::render_instruction_t>& instructions,
             const wf::render_target_t& target, wf::region_t& damage) override
         {
-            auto our_region = self->cached_region + self->get_offset();
+            auto our_region = self->get_render_region() + self->get_offset();
             wf::region_t our_damage = damage & our_region;
             if (!our_damage.empty())
             {
@@ -204,7 +258,24 @@ class simple_decoration_node_t : public wf::scene::node_t, public wf::pointer_in
             {
                 self->render_scissor_box(target, self->get_offset(), wlr_box_from_pixman_box(box));
             }
+
+            self->render_elements(batch, target, self->get_offset(), region);
         }
+
+        wf::scene::direct_scanout try_scanout(wf::output_t *output) override
+        {
+            // Fullscreen views have neither frame nor shadow, so the view itself may be scanned out.
+            return self->get_render_region().empty() ?
+                   wf::scene::direct_scanout::SKIP : wf::scene::direct_scanout::OCCLUSION;
+        }
+
+        wf::scene::node_t *get_node() const override
+        {
+            return self.get();
+        }
+
+      private:
+        OpenGL::texture_batch_t batch;
     };
 
     void gen_render_instances(std::vector<wf::scene::render_instance_uptr>& instances,
@@ -213,9 +284,25 @@ class simple_decoration_node_t : public wf::scene::node_t, public wf::pointer_in
         instances.push_back(std::make_unique<decoration_render_instance_t>(this, push_damage));
     }
 
+    /** @return The frame including its shadow, relative to the top-left corner of the frame. */
+    wf::geometry_t get_shadow_box()
+    {
+        // Fullscreen views have neither frame nor shadow.
+        const int shadow = cached_region.empty() ? 0 : theme.get_shadow_radius();
+        return {-shadow, -shadow, size.width + 2 * shadow, size.height + 2 * shadow};
+    }
+
+    /** @return The region to render, relative to the top-left corner of the frame. */
+    wf::region_t get_render_region()
+    {
+        wf::region_t region = cached_region;
+        region |= wf::region_t{get_shadow_box()} ^ wlr_box{0, 0, size.width, size.height};
+        return region;
+    }
+
     wf::geometry_t get_bounding_box() override
     {
-        return wf::construct_box(get_offset(), size);
+        return get_shadow_box() + get_offset();
     }
 
     /* wf::compositor_surface_t implementation */
@@ -362,14 +449,64 @@ wf::simple_decorator_t::simple_decorator_t(wayfire_toplevel_view view)
         {
             deco->resize(wf::dimensions(this->view->get_geometry()));
         }
+
+        update_shadow();
     };
+
+    shadow_view = view->weak_from_this();
+    soft_shadow.set_callback([=] { update_shadow(); });
+    shadow_radius.set_callback([=] { update_shadow(); });
+    shadow_color.set_callback([=] { update_shadow(); });
+    corner_radius.set_callback([=] { update_shadow(); });
+    update_shadow();
 }
 
 wf::simple_decorator_t::~simple_decorator_t()
 {
+    auto shadowed = shadow_view.lock();
+    if (shadow && shadowed)
+    {
+        shadowed->get_transformed_node()->rem_transformer(shadow);
+    }
+
     wf::scene::remove_child(deco);
 }
 
+void wf::simple_decorator_t::update_shadow()
+{
+    auto shadowed = shadow_view.lock();
+    if (!shadowed)
+    {
+        return;
+    }
+
+    // Fullscreen views have neither frame nor shadow.
+    if (!soft_shadow || (shadow_radius <= 0) || shadowed->toplevel()->current().fullscreen)
+    {
+        if (shadow)
+        {
+            shadowed->get_transformed_node()->rem_transformer(shadow);
+            shadow = nullptr;
+        }
+
+        return;
+    }
+
+    wf::scene::shadow_params_t params;
+    params.radius = shadow_radius;
+    params.color  = shadow_color;
+    params.corner_radius = corner_radius;
+    if (shadow)
+    {
+        shadow->set_params(params);
+        return;
+    }
+
+    // Below all other transformers, so that the shadow is transformed along with the view.
+    shadow = std::make_shared<wf::scene::shadow_node_t>(params);
+    shadowed->get_transformed_node()->add_transformer(shadow, 0, "decoration-shadow");
+}
+
 wf::decoration_margins_t wf::simple_decorator_t::get_margins(const wf::toplevel_state_t& state)
 {
     if (state.fullscreen)
@@ -5,6 +5,8 @@
 #include "wayfire/toplevel.hpp"
 #include <wayfire/signal-definitions.hpp>
 #include <wayfire/toplevel-view.hpp>
+#include <wayfire/option-wrapper.hpp>
+#include <wayfire/plugins/common/shadow-node.hpp>
 
 class simple_decoration_node_t;
 namespace wf
@@ -21,6 +23,18 @@ class simple_decorator_t : public wf::custom_data_t
     wf::signal::connection_t<wf::view_geometry_changed_signal> on_view_geometry_changed;
     wf::signal::connection_t<wf::view_fullscreen_signal> on_view_fullscreen;
 
+    // The shadow below the view and its decoration, if decoration/soft_shadow is set. The toplevel, and
+    // with it the decorator, may outlive the view.
+    std::shared_ptr<wf::scene::shadow_node_t> shadow;
+    std::weak_ptr<wf::toplevel_view_interface_t> shadow_view;
+    wf::option_wrapper_t<bool> soft_shadow{"decoration/soft_shadow"};
+    wf::option_wrapper_t<int> shadow_radius{"decoration/shadow_radius"};
+    wf::option_wrapper_t<wf::color_t> shadow_color{"decoration/shadow_color"};
+    wf::option_wrapper_t<int> corner_radius{"decoration/corner_radius"};
+
+    /** Add, update or remove the soft shadow according to the options and the state of the view. */
+    void update_shadow();
+
   public:
     simple_decorator_t(wayfire_toplevel_view view);
     ~simple_decorator_t();
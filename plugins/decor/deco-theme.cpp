@@ -2,12 +2,77 @@
 #include <wayfire/core.hpp>
 #include <wayfire/opengl.hpp>
 #include <config.h>
+#include <algorithm>
 #include <map>
 
+static const char *frame_vertex_shader =
+    R"(
+#version 100
+attribute highp vec2 position;
+uniform highp mat4 MVP;
+uniform highp vec2 center;
+
+varying highp vec2 local;
+
+void main() {
+    gl_Position = MVP * vec4(position.xy, 0.0, 1.0);
+    local = position.xy - center;
+})";
+
+static const char *frame_fragment_shader =
+    R"(
+#version 100
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+precision highp float;
+#else
+precision mediump float;
+#endif
+
+uniform vec2 half_size;
+uniform float radius_top;
+uniform float radius_bottom;
+uniform float shadow_radius;
+uniform vec4 color;
+uniform vec4 shadow_color;
+
+varying vec2 local;
+
+/* Signed distance from the edge of a rounded box centered at the origin */
+float rounded_box(vec2 p, vec2 b, float r)
+{
+    vec2 q = abs(p) - b + vec2(r);
+    return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - r;
+}
+
+void main()
+{
+    float dist = rounded_box(local, half_size, local.y < 0.0 ? radius_top : radius_bottom);
+    float coverage = clamp(0.5 - dist, 0.0, 1.0);
+
+    float shadow = 0.0;
+    if (shadow_radius > 0.0)
+    {
+        shadow = 1.0 - smoothstep(0.0, shadow_radius, dist);
+        shadow *= shadow;
+    }
+
+    gl_FragColor = color * coverage + shadow_color * (shadow * (1.0 - coverage));
+})";
+
 namespace wf
 {
 namespace decor
 {
+frame_program_t::~frame_program_t()
+{
+    if (compiled)
+    {
+        OpenGL::render_begin();
+        program.free_resources();
+        OpenGL::render_end();
+    }
+}
+
 /** Create a new theme with the default parameters */
 decoration_theme_t::decoration_theme_t()
 {}
@@ -24,6 +89,12 @@ int decoration_theme_t::get_border_size() const
     return border_size;
 }
 
+int decoration_theme_t::get_shadow_radius() const
+{
+    // The soft shadow is drawn below the whole view instead, see simple_decorator_t.
+    return soft_shadow ? 0 : std::max(0, (int)shadow_radius);
+}
+
 /** @return The available border for resizing */
 void decoration_theme_t::set_buttons(button_type_t flags)
 {
@@ -41,10 +112,46 @@ void decoration_theme_t::set_buttons(button_type_t flags)
 void decoration_theme_t::render_background(const wf::render_target_t& fb,
     wf::geometry_t rectangle, const wf::geometry_t& scissor, bool active) const
 {
-    wf::color_t color = active ? active_color : inactive_color;
+    wf::color_t color  = active ? active_color : inactive_color;
+    wf::color_t shadow = shadow_color;
     OpenGL::render_begin(fb);
+    if (!frame_program->compiled)
+    {
+        frame_program->program.set_simple(
+            OpenGL::compile_program(frame_vertex_shader, frame_fragment_shader));
+        frame_program->compiled = true;
+    }
+
+    // The whole area which the frame and its shadow may cover
+    const int padding = get_shadow_radius();
+    const float x1    = rectangle.x - padding;
+    const float y1    = rectangle.y - padding;
+    const float x2    = rectangle.x + rectangle.width + padding;
+    const float y2    = rectangle.y + rectangle.height + padding;
+    const GLfloat vertex_data[] = {
+        x1, y2,
+        x2, y2,
+        x2, y1,
+        x1, y1,
+    };
+
+    const float radius = std::clamp((int)corner_radius, 0, std::min(rectangle.width, rectangle.height) / 2);
+    auto& program = frame_program->program;
+    program.use(wf::TEXTURE_TYPE_RGBA);
+    program.attrib_pointer("position", 2, 0, vertex_data);
+    program.uniformMatrix4f("MVP", fb.get_orthographic_projection());
+    program.uniform2f("center", rectangle.x + rectangle.width / 2.0f, rectangle.y + rectangle.height / 2.0f);
+    program.uniform2f("half_size", rectangle.width / 2.0f, rectangle.height / 2.0f);
+    program.uniform1f("radius_top", radius);
+    // Below the titlebar, the corners can be rounded only as far as the border reaches.
+    program.uniform1f("radius_bottom", std::min(radius, 1.0f * get_border_size()));
+    program.uniform1f("shadow_radius", padding);
+    program.uniform4f("color", {color.r, color.g, color.b, color.a});
+    program.uniform4f("shadow_color", {shadow.r, shadow.g, shadow.b, shadow.a});
+
     fb.logic_scissor(scissor);
-    OpenGL::render_rectangle(rectangle, color, fb.get_orthographic_projection());
+    GL_CALL(glDrawArrays(GL_TRIANGLE_FAN, 0, 4));
+    program.deactivate();
     OpenGL::render_end();
 }
 
@@ -54,6 +161,17 @@ void decoration_theme_t::render_background(const wf::render_target_t& fb,
  */
 cairo_surface_t*decoration_theme_t::render_text(std::string text,
     int width, int height) const
+{
+    return render_text(text, get_font(), width, height);
+}
+
+std::string decoration_theme_t::get_font() const
+{
+    return font;
+}
+
+cairo_surface_t*decoration_theme_t::render_text(std::string text, std::string font_name,
+    int width, int height)
 {
     const auto format = CAIRO_FORMAT_ARGB32;
     auto surface = cairo_image_surface_create(format, width, height);
@@ -72,7 +190,7 @@ cairo_surface_t*decoration_theme_t::render_text(std::string text,
     PangoLayout *layout;
 
     // render text
-    font_desc = pango_font_description_from_string(((std::string)font).c_str());
+    font_desc = pango_font_description_from_string(font_name.c_str());
     pango_font_description_set_absolute_size(font_desc, font_size * PANGO_SCALE);
 
     layout = pango_cairo_create_layout(cr);
@@ -87,8 +205,36 @@ cairo_surface_t*decoration_theme_t::render_text(std::string text,
     return surface;
 }
 
+cairo_surface_t*decoration_theme_t::render_title(std::string text, std::string font_name, int height)
+{
+    if (height <= 0)
+    {
+        return cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+    }
+
+    // Measure the text with the same layout as render_text().
+    auto measure_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+    auto cr = cairo_create(measure_surface);
+    const float font_size = height * 0.8;
+    auto font_desc = pango_font_description_from_string(font_name.c_str());
+    pango_font_description_set_absolute_size(font_desc, font_size * PANGO_SCALE);
+
+    auto layout = pango_cairo_create_layout(cr);
+    pango_layout_set_font_description(layout, font_desc);
+    pango_layout_set_text(layout, text.c_str(), text.size());
+
+    int width;
+    pango_layout_get_pixel_size(layout, &width, nullptr);
+    pango_font_description_free(font_desc);
+    g_object_unref(layout);
+    cairo_destroy(cr);
+    cairo_surface_destroy(measure_surface);
+
+    return render_text(text, font_name, std::max(width, 1), height);
+}
+
 cairo_surface_t*decoration_theme_t::get_button_surface(button_type_t button,
-    const button_state_t& state) const
+    const button_state_t& state)
 {
     cairo_surface_t *button_surface = cairo_image_surface_create(
         CAIRO_FORMAT_ARGB32, state.width, state.height);
@@ -6,6 +6,18 @@ namespace wf
 {
 namespace decor
 {
+/**
+ * The GL program which draws the frames of decorations, shared by all decorations (use it via
+ * wf::shared_data::ref_ptr_t<wf::decor::frame_program_t>).
+ */
+struct frame_program_t
+{
+    OpenGL::program_t program;
+    bool compiled = false;
+
+    ~frame_program_t();
+};
+
 /**
  * A  class which manages the outlook of decorations.
  * It is responsible for determining the background colors, sizes, etc.
@@ -20,15 +32,18 @@ class decoration_theme_t
     int get_title_height() const;
     /** @return The available border for resizing */
     int get_border_size() const;
+    /** @return How far the shadow drawn with the frame extends outside of the decoration */
+    int get_shadow_radius() const;
     /** Set the flags for buttons */
     void set_buttons(button_type_t flags);
     button_type_t button_flags;
 
     /**
-     * Fill the given rectangle with the background color(s).
+     * Draw the frame of a decoration with the background color(s), with rounded corners and a shadow.
+     * The frame is computed in a fragment shader, so nothing has to be rasterized when it is resized.
      *
      * @param fb The target framebuffer, must have been bound already.
-     * @param rectangle The rectangle to redraw.
+     * @param rectangle The geometry of the whole decoration. The shadow is drawn outside of it.
      * @param scissor The GL scissor rectangle to use.
      * @param active Whether to use active or inactive colors
      */
@@ -41,6 +56,22 @@ class decoration_theme_t
      */
     cairo_surface_t *render_text(std::string text, int width, int height) const;
 
+    /**
+     * Same as render_text(), but with the given font instead of the theme's font.
+     * Does not use any state of the theme, so it can be called from other threads.
+     */
+    static cairo_surface_t *render_text(std::string text, std::string font_name, int width, int height);
+
+    /**
+     * Same as render_text(), but the surface is as wide as needed for the whole text, so it does not depend
+     * on the width of the titlebar and does not need to be rasterized again when the view is resized.
+     * Does not use any state of the theme, so it can be called from other threads.
+     */
+    static cairo_surface_t *render_title(std::string text, std::string font_name, int height);
+
+    /** @return The font used for titles. */
+    std::string get_font() const;
+
     struct button_state_t
     {
         /** Button width */
@@ -61,8 +92,8 @@ class decoration_theme_t
      * @param button The button type.
      * @param state The button state.
      */
-    cairo_surface_t *get_button_surface(button_type_t button,
-        const button_state_t& state) const;
+    static cairo_surface_t *get_button_surface(button_type_t button,
+        const button_state_t& state);
 
   private:
     wf::option_wrapper_t<std::string> font{"decoration/font"};
@@ -70,6 +101,12 @@ class decoration_theme_t
     wf::option_wrapper_t<int> border_size{"decoration/border_size"};
     wf::option_wrapper_t<wf::color_t> active_color{"decoration/active_color"};
     wf::option_wrapper_t<wf::color_t> inactive_color{"decoration/inactive_color"};
+    wf::option_wrapper_t<int> corner_radius{"decoration/corner_radius"};
+    wf::option_wrapper_t<int> shadow_radius{"decoration/shadow_radius"};
+    wf::option_wrapper_t<wf::color_t> shadow_color{"decoration/shadow_color"};
+    wf::option_wrapper_t<bool> soft_shadow{"decoration/soft_shadow"};
+
+    mutable wf::shared_data::ref_ptr_t<frame_program_t> frame_program;
 };
 }
 }
@@ -111,9 +111,11 @@ class wayfire_demo_ipc : public wf::plugin_interface_t
         nlohmann::json event;
         event["event"] = "view-mapped";
         event["view"]  = view_to_json(ev->view);
+
+        auto message = wf::ipc::serialize_message(event);
         for (auto& client : clients)
         {
-            client->send_json(event);
+            client->send_serialized(message);
         }
     };
 
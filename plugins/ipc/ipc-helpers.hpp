@@ -15,41 +15,17 @@ namespace ipc
 {
 inline wayfire_view find_view_by_id(uint32_t id)
 {
-    for (auto view : wf::get_core().get_all_views())
-    {
-        if (view->get_id() == id)
-        {
-            return view;
-        }
-    }
-
-    return nullptr;
+    return wf::tracking_allocator_t<wf::view_interface_t>::get().find_by_id(id);
 }
 
 inline wf::output_t *find_output_by_id(int32_t id)
 {
-    for (auto wo : wf::get_core().output_layout->get_outputs())
-    {
-        if ((int)wo->get_id() == id)
-        {
-            return wo;
-        }
-    }
-
-    return nullptr;
+    return (id < 0) ? nullptr : wf::get_core().output_layout->find_output_by_id(id);
 }
 
 inline wf::workspace_set_t *find_workspace_set_by_index(int32_t index)
 {
-    for (auto wset : wf::workspace_set_t::get_all())
-    {
-        if ((int)wset->get_index() == index)
-        {
-            return wset.get();
-        }
-    }
-
-    return nullptr;
+    return (index < 0) ? nullptr : wf::tracking_allocator_t<wf::workspace_set_t>::get().find_by_id(index);
 }
 
 inline nlohmann::json geometry_to_json(wf::geometry_t g)
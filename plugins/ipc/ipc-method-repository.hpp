@@ -3,12 +3,96 @@
 #include <nlohmann/json.hpp>
 #include <functional>
 #include <map>
+#include <memory>
+#include <string>
+#include <unistd.h>
 #include "wayfire/signal-provider.hpp"
+#include <wayfire/trace.hpp>
 
 namespace wf
 {
 namespace ipc
 {
+/**
+ * The encodings a client can negotiate with the ipc/set-encoding method. JSON is the default, the binary
+ * encodings are cheaper to produce and parse for big responses. Messages always start with a 32-bit
+ * length header in host byte order.
+ */
+enum class encoding_t
+{
+    JSON    = 0,
+    CBOR    = 1,
+    MSGPACK = 2,
+};
+
+/** A message framed for the IPC socket, including the length header. */
+using frame_t = std::shared_ptr<const std::string>;
+
+/** Encode and frame a message for the IPC socket. */
+inline frame_t encode_message(const nlohmann::json& json, encoding_t encoding)
+{
+    std::string payload;
+    switch (encoding)
+    {
+      case encoding_t::CBOR:
+        nlohmann::json::to_cbor(json, payload);
+        break;
+
+      case encoding_t::MSGPACK:
+        nlohmann::json::to_msgpack(json, payload);
+        break;
+
+      case encoding_t::JSON:
+        payload = json.dump(-1, ' ', false, nlohmann::detail::error_handler_t::ignore);
+        break;
+    }
+
+    uint32_t len = payload.length();
+    auto frame   = std::make_shared<std::string>((const char*)&len, sizeof(len));
+    frame->append(payload);
+    return frame;
+}
+
+/**
+ * A message which is encoded at most once per encoding, no matter how many clients it is sent to. The
+ * frames are immutable, so that the same buffer can be queued for many clients.
+ */
+class message_t
+{
+  public:
+    explicit message_t(nlohmann::json json) : json(std::move(json))
+    {}
+
+    const nlohmann::json& get_json() const
+    {
+        return json;
+    }
+
+    /** Get the message encoded and framed for the socket. */
+    const frame_t& get_frame(encoding_t encoding) const
+    {
+        auto& frame = frames[(int)encoding];
+        if (!frame)
+        {
+            frame = encode_message(json, encoding);
+        }
+
+        return frame;
+    }
+
+  private:
+    nlohmann::json json;
+    mutable frame_t frames[3];
+};
+
+using serialized_message_t = std::shared_ptr<const message_t>;
+
+/** Wrap a message so that it is serialized only once, see client_interface_t::send_serialized(). */
+inline serialized_message_t serialize_message(nlohmann::json json)
+{
+    return std::make_shared<const message_t>(std::move(json));
+}
+
 /**
  * A client_interface_t represents a client which has connected to the IPC socket.
  * It can be used by plugins to send back data to a specific client.
@@ -17,6 +101,28 @@ class client_interface_t
 {
   public:
     virtual void send_json(nlohmann::json json) = 0;
+
+    /**
+     * Send a message serialized with serialize_message(). Plugins which send the same event to many
+     * clients should serialize it once and use this instead of send_json().
+     */
+    virtual void send_serialized(serialized_message_t message)
+    {
+        send_json(message->get_json());
+    }
+
+    /**
+     * Pass a file descriptor to the client with SCM_RIGHTS, together with the response to the IPC method
+     * which is currently being called. Takes ownership of the fd.
+     *
+     * @return Whether the fd will be passed. Otherwise, it has been closed.
+     */
+    virtual bool send_fd(int fd)
+    {
+        close(fd);
+        return false;
+    }
+
     virtual ~client_interface_t() = default;
 };
 
@@ -86,6 +192,7 @@ class method_repository_t : public wf::signal::provider_t
     {
         if (this->methods.count(method))
         {
+            WF_TRACE_SCOPE(wf::trace::recording ? wf::trace::intern("ipc " + method) : nullptr);
             return this->methods[method](std::move(data), client);
         }
 
@@ -4,12 +4,16 @@
 #include <wayfire/util/log.hpp>
 #include <wayfire/core.hpp>
 #include <wayfire/plugin.hpp>
+#include <wayfire/txn/transaction-manager.hpp>
 
 #include <fcntl.h>
 #include <sys/socket.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 
+// Indexed by wf::ipc::encoding_t
+static const std::string encoding_names[] = {"json", "cbor", "msgpack"};
+
 /**
  * Handle WL_EVENT_READABLE on the socket.
  * Indicates a new connection.
@@ -26,6 +30,63 @@ wf::ipc::server_t::server_t()
     {
         do_accept_new_client();
     };
+
+    client_stats = [=] (nlohmann::json)
+    {
+        auto response       = wf::ipc::json_ok();
+        response["clients"] = nlohmann::json::array();
+        for (auto& client : clients)
+        {
+            response["clients"].push_back(client->get_stats());
+        }
+
+        return response;
+    };
+
+    set_encoding = [=] (nlohmann::json data, client_interface_t *client)
+    {
+        WFJSON_EXPECT_FIELD(data, "encoding", string);
+        const std::string name = data["encoding"];
+        auto it                = std::find(std::begin(encoding_names), std::end(encoding_names), name);
+        if (it == std::end(encoding_names))
+        {
+            return wf::ipc::json_error("Unknown encoding " + name);
+        }
+
+        auto cl = std::find_if(clients.begin(), clients.end(),
+            [&] (const auto& cl) { return cl.get() == client; });
+        if (cl == clients.end())
+        {
+            return wf::ipc::json_error("ipc/set-encoding can only be called through the IPC socket");
+        }
+
+        (*cl)->next_encoding = (encoding_t)(it - std::begin(encoding_names));
+        return wf::ipc::json_ok();
+    };
+
+    batch = [=] (nlohmann::json data, client_interface_t *client)
+    {
+        WFJSON_EXPECT_FIELD(data, "calls", array);
+        for (auto& call : data["calls"])
+        {
+            if (!call.is_object() || !call.contains("method") || !call["method"].is_string())
+            {
+                return wf::ipc::json_error("Each call must be an object with a method");
+            }
+        }
+
+        // All transactions started by the calls (e.g. configuring many views) are applied together.
+        auto response       = wf::ipc::json_ok();
+        response["results"] = nlohmann::json::array();
+        wf::txn::transaction_group_t group{*wf::get_core().tx_manager};
+        for (auto& call : data["calls"])
+        {
+            response["results"].push_back(method_repository->call_method(call["method"],
+                call.value("data", nlohmann::json::object()), client));
+        }
+
+        return response;
+    };
 }
 
 void wf::ipc::server_t::init(std::string socket_path)
@@ -40,10 +101,16 @@ void wf::ipc::server_t::init(std::string socket_path)
     listen(fd, 3);
     source = wl_event_loop_add_fd(wl_display_get_event_loop(wf::get_core().display),
         fd, WL_EVENT_READABLE, wl_loop_handle_ipc_fd_connection, &accept_new_client);
+    method_repository->register_method("ipc/client-stats", client_stats);
+    method_repository->register_method("ipc/set-encoding", set_encoding);
+    method_repository->register_method("ipc/batch", batch);
 }
 
 wf::ipc::server_t::~server_t()
 {
+    method_repository->unregister_method("ipc/client-stats");
+    method_repository->unregister_method("ipc/set-encoding");
+    method_repository->unregister_method("ipc/batch");
     if (fd != -1)
     {
         close(fd);
@@ -130,10 +197,41 @@ void wf::ipc::server_t::client_disappeared(client_t *client)
     clients.erase(it, clients.end());
 }
 
+void wf::ipc::server_t::schedule_disconnect(client_t *client)
+{
+    client->disconnecting = true;
+    idle_disconnect.run_once([=] ()
+    {
+        std::vector<client_t*> to_remove;
+        for (auto& cl : clients)
+        {
+            if (cl->disconnecting)
+            {
+                to_remove.push_back(cl.get());
+            }
+        }
+
+        for (auto cl : to_remove)
+        {
+            client_disappeared(cl);
+        }
+    });
+}
+
 void wf::ipc::server_t::handle_incoming_message(
     client_t *client, nlohmann::json message)
 {
-    client->send_json(method_repository->call_method(message["method"], message["data"], client));
+    // Clients wait for the response, so it is never dropped.
+    auto response = method_repository->call_method(message["method"], message["data"], client);
+    client->queue_message(encode_message(response, client->encoding), false, std::move(client->response_fds));
+    client->response_fds.clear();
+
+    // The response to ipc/set-encoding is still in the old encoding.
+    if (client->next_encoding)
+    {
+        client->encoding = *client->next_encoding;
+        client->next_encoding.reset();
+    }
 }
 
 /* --------------------------- Per-client code ------------------------------*/
@@ -204,6 +302,20 @@ void wf::ipc::client_t::handle_fd_incoming(uint32_t event_mask)
         return;
     }
 
+    if (event_mask & WL_EVENT_WRITABLE)
+    {
+        if (!flush_output())
+        {
+            ipc->client_disappeared(this);
+            return;
+        }
+    }
+
+    if (!(event_mask & WL_EVENT_READABLE) || disconnecting)
+    {
+        return;
+    }
+
     int available = 0;
     if (ioctl(this->fd, FIONREAD, &available) != 0)
     {
@@ -250,10 +362,11 @@ void wf::ipc::client_t::handle_fd_incoming(uint32_t event_mask)
         // Finally, received the message, make sure we have a terminating NULL byte
         buffer[current_buffer_valid] = '\0';
         char *str    = buffer.data() + HEADER_LEN;
-        auto message = nlohmann::json::parse(str, nullptr, false);
+        auto message = decode_message(str, len);
         if (message.is_discarded())
         {
-            LOGE("Client's message could not be parsed: ", str);
+            LOGE("Client's message could not be parsed: ",
+                (encoding == encoding_t::JSON) ? str : "binary message");
             ipc->client_disappeared(this);
             return;
         }
@@ -271,36 +384,212 @@ void wf::ipc::client_t::handle_fd_incoming(uint32_t event_mask)
     }
 }
 
+nlohmann::json wf::ipc::client_t::decode_message(const char *data, uint32_t len)
+{
+    switch (encoding)
+    {
+      case encoding_t::CBOR:
+        return nlohmann::json::from_cbor(data, data + len, true, false);
+
+      case encoding_t::MSGPACK:
+        return nlohmann::json::from_msgpack(data, data + len, true, false);
+
+      case encoding_t::JSON:
+        break;
+    }
+
+    return nlohmann::json::parse(data, nullptr, false);
+}
+
 wf::ipc::client_t::~client_t()
 {
+    for (auto& queued : output)
+    {
+        for (int fd : queued.fds)
+        {
+            close(fd);
+        }
+    }
+
+    for (int fd : response_fds)
+    {
+        close(fd);
+    }
+
     wl_event_source_remove(source);
     shutdown(fd, SHUT_RDWR);
     close(this->fd);
 }
 
-static bool write_exact(int fd, char *buf, int n)
+void wf::ipc::client_t::send_json(nlohmann::json json)
+{
+    queue_message(encode_message(json, encoding), true);
+}
+
+void wf::ipc::client_t::send_serialized(serialized_message_t message)
+{
+    queue_message(message->get_frame(encoding), true);
+}
+
+bool wf::ipc::client_t::send_fd(int fd)
+{
+    response_fds.push_back(fd);
+    return true;
+}
+
+void wf::ipc::client_t::queue_message(frame_t message, bool droppable, std::vector<int> fds)
 {
-    while (n > 0)
+    if (disconnecting)
+    {
+        for (int fd : fds)
+        {
+            close(fd);
+        }
+
+        return;
+    }
+
+    const size_t max_queued = (size_t)std::max(0, (int)ipc->max_queued_kib) * 1024;
+    if (droppable && (max_queued > 0) && (queued_bytes + message->size() > max_queued))
     {
-        int w = write(fd, buf, n);
-        if (w <= 0)
+        if (std::string(ipc->overflow_action) == "disconnect")
         {
+            LOGW("IPC client ", this, " does not read its events, disconnecting it");
+            ipc->schedule_disconnect(this);
+            return;
+        }
+
+        if (!overflowing)
+        {
+            LOGW("IPC client ", this, " does not read its events, dropping them");
+            overflowing = true;
+        }
+
+        ++dropped_events;
+        return;
+    }
+
+    queued_bytes += message->size();
+    output.push_back({std::move(message), std::move(fds)});
+    if (!flush_output())
+    {
+        ipc->schedule_disconnect(this);
+    }
+}
+
+bool wf::ipc::client_t::flush_output()
+{
+    static constexpr size_t MAX_IOVECS = 64;
+    while (!output.empty())
+    {
+        iovec iov[MAX_IOVECS];
+        size_t count = 0;
+        for (auto it = output.begin(); (it != output.end()) && (count < MAX_IOVECS); ++it, ++count)
+        {
+            // File descriptors are sent with the first byte of their message.
+            if ((count > 0) && !it->fds.empty())
+            {
+                break;
+            }
+
+            const size_t skip = (count == 0) ? output_offset : 0;
+            iov[count].iov_base = (void*)(it->frame->data() + skip);
+            iov[count].iov_len  = it->frame->size() - skip;
+        }
+
+        msghdr msg     = {};
+        msg.msg_iov    = iov;
+        msg.msg_iovlen = count;
+
+        auto& fds = output.front().fds;
+        std::vector<char> control;
+        if (!fds.empty())
+        {
+            control.resize(CMSG_SPACE(sizeof(int) * fds.size()));
+            msg.msg_control    = control.data();
+            msg.msg_controllen = control.size();
+
+            cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type  = SCM_RIGHTS;
+            cmsg->cmsg_len   = CMSG_LEN(sizeof(int) * fds.size());
+            memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+        }
+
+        // MSG_NOSIGNAL: a client which went away must not kill the compositor with SIGPIPE.
+        ssize_t w = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (w < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+            {
+                break;
+            }
+
+            LOGI("Write: error ", strerror(errno));
             return false;
         }
 
-        n -= w;
+        // The client has its own copies of the file descriptors now.
+        for (int fd : fds)
+        {
+            close(fd);
+        }
+
+        fds.clear();
+        queued_bytes -= w;
+        while (w > 0)
+        {
+            const size_t left = output.front().frame->size() - output_offset;
+            if ((size_t)w < left)
+            {
+                output_offset += w;
+                break;
+            }
+
+            w -= left;
+            output.pop_front();
+            output_offset = 0;
+        }
+    }
+
+    if (output.empty())
+    {
+        overflowing = false;
     }
 
+    update_event_mask();
     return true;
 }
 
-void wf::ipc::client_t::send_json(nlohmann::json json)
+void wf::ipc::client_t::update_event_mask()
+{
+    const bool pending = get_queued_bytes() > 0;
+    if (pending != waiting_writable)
+    {
+        waiting_writable = pending;
+        wl_event_source_fd_update(source, WL_EVENT_READABLE | (pending ? WL_EVENT_WRITABLE : 0));
+    }
+}
+
+size_t wf::ipc::client_t::get_queued_bytes() const
 {
-    std::string buffer = json.dump(-1, ' ', false, nlohmann::detail::error_handler_t::ignore);
-    uint32_t len = buffer.length();
+    return queued_bytes;
+}
 
-    write_exact(fd, (char*)&len, 4);
-    write_exact(fd, buffer.data(), len);
+nlohmann::json wf::ipc::client_t::get_stats() const
+{
+    nlohmann::json stats;
+    stats["fd"]               = fd;
+    stats["queued-bytes"]     = get_queued_bytes();
+    stats["max-queued-bytes"] = (size_t)std::max(0, (int)ipc->max_queued_kib) * 1024;
+    stats["dropped-events"]   = dropped_events;
+    stats["encoding"]         = encoding_names[(int)encoding];
+    return stats;
 }
 
 namespace wf
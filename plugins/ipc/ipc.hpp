@@ -1,8 +1,12 @@
 #pragma once
 
 #include <nlohmann/json.hpp>
+#include <deque>
+#include <optional>
 #include <sys/un.h>
 #include <wayfire/object.hpp>
+#include <wayfire/option-wrapper.hpp>
+#include <wayfire/util.hpp>
 #include <wayland-server.h>
 #include <wayfire/plugins/common/shared-core-data.hpp>
 #include "ipc-method-repository.hpp"
@@ -20,13 +24,68 @@ class client_t : public client_interface_t
   public:
     client_t(server_t *server, int client_fd);
     ~client_t();
+
+    /**
+     * Queue an event for the client. Events are dropped, or the client is disconnected, when the client
+     * does not read them and its queue exceeds ipc/max_queued_kib.
+     */
     void send_json(nlohmann::json json) override;
 
+    /** Queue an event serialized once for all its recipients, with the same limits as send_json(). */
+    void send_serialized(serialized_message_t message) override;
+
+    /** Pass the fd with the response to the request which is being handled. */
+    bool send_fd(int fd) override;
+
+    /**
+     * Queue a message for the client and write as much of the queue as the socket accepts without
+     * blocking. The rest is written when the socket becomes writable again.
+     *
+     * @param droppable Whether the message may be dropped when the queue is full.
+     * @param fds File descriptors to pass with the message, which are closed once they have been sent.
+     */
+    void queue_message(frame_t message, bool droppable, std::vector<int> fds = {});
+
+    /** @return The number of bytes waiting to be written to the socket. */
+    size_t get_queued_bytes() const;
+
+    /** Statistics of the client, as returned by the ipc/client-stats method. */
+    nlohmann::json get_stats() const;
+
   private:
+    friend class server_t;
     int fd;
     wl_event_source *source;
     server_t *ipc;
 
+    struct queued_frame_t
+    {
+        frame_t frame;
+        std::vector<int> fds;
+    };
+
+    /* Messages not written yet, the first one starting at output_offset */
+    std::deque<queued_frame_t> output;
+    /* Passed to send_fd() by the method which is being called */
+    std::vector<int> response_fds;
+    size_t output_offset  = 0;
+    size_t queued_bytes   = 0;
+    bool waiting_writable = false;
+
+    /* Whether events are being dropped since the queue last became full */
+    bool overflowing        = false;
+    uint64_t dropped_events = 0;
+    bool disconnecting      = false;
+
+    encoding_t encoding = encoding_t::JSON;
+    /* Set by ipc/set-encoding, applied after its response has been queued */
+    std::optional<encoding_t> next_encoding;
+    nlohmann::json decode_message(const char *data, uint32_t len);
+
+    /** Write the queue until the socket would block. @return false on errors. */
+    bool flush_output();
+    void update_event_mask();
+
     int current_buffer_valid = 0;
     std::vector<char> buffer;
     int read_up_to(int n, int *available);
@@ -55,6 +114,19 @@ class server_t
 
     void client_disappeared(client_t *client);
 
+    /**
+     * Disconnect a client on the next idle. Used when the client misbehaves while a plugin is sending it
+     * an event, because the plugin may still use the client afterwards.
+     */
+    void schedule_disconnect(client_t *client);
+    wf::wl_idle_call idle_disconnect;
+
+    wf::option_wrapper_t<int> max_queued_kib{"ipc/max_queued_kib"};
+    wf::option_wrapper_t<std::string> overflow_action{"ipc/overflow_action"};
+    ipc::method_callback client_stats;
+    ipc::method_callback_full set_encoding;
+    ipc::method_callback_full batch;
+
     int fd = -1;
 
     /**
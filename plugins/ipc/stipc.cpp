@@ -10,6 +10,12 @@
 #include <wayfire/txn/transaction-manager.hpp>
 #include "src/view/view-impl.hpp"
 #include <variant>
+#include <wayfire/opengl.hpp>
+#include <wayfire/render-manager.hpp>
+#include <wayfire/signal-definitions.hpp>
+#include <wayfire/config-backend.hpp>
+#include <map>
+#include <malloc.h>
 
 #define WAYFIRE_PLUGIN
 #include <wayfire/debug.hpp>
@@ -278,6 +284,97 @@ class headless_input_backend_t
     headless_input_backend_t& operator =(headless_input_backend_t&&) = delete;
 };
 
+/**
+ * A headless backend dedicated to the outputs created with stipc/create_headless_output. Unlike nested
+ * Wayland outputs, they render at a synthetic refresh rate which does not depend on a host compositor, and
+ * their presentation events carry timestamps on a regular vblank grid, like those of real hardware, so that
+ * frame scheduling can be benchmarked deterministically.
+ */
+class headless_output_backend_t
+{
+    struct emulated_output_t
+    {
+        // The last emulated vblank, in nanoseconds of the monotonic clock
+        int64_t last_vblank = -1;
+        timespec when;
+        wf::wl_listener_wrapper on_present;
+        wf::wl_listener_wrapper on_destroy;
+    };
+
+    wlr_backend *backend;
+    wf::wl_listener_wrapper on_new_output;
+    std::map<wlr_output*, std::unique_ptr<emulated_output_t>> outputs;
+
+    void emulate_present(emulated_output_t& state, wlr_output *handle, wlr_output_event_present *ev)
+    {
+        if (!ev->presented || (handle->refresh <= 0))
+        {
+            return;
+        }
+
+        // The headless backend presents frames without a timestamp. Report the latest vblank of the grid
+        // which is not in the future, but at least one refresh period after the previous one.
+        const int64_t period = 1'000'000'000'000ll / handle->refresh;
+        const int64_t now    = wf::get_current_time_usec() * 1000;
+        if (state.last_vblank < 0)
+        {
+            state.last_vblank = now;
+        } else
+        {
+            state.last_vblank += period * std::max<int64_t>(1, (now - state.last_vblank) / period);
+        }
+
+        state.when.tv_sec  = state.last_vblank / 1'000'000'000;
+        state.when.tv_nsec = state.last_vblank % 1'000'000'000;
+        ev->when    = &state.when;
+        ev->refresh = period;
+        ev->flags  |= WLR_OUTPUT_PRESENT_VSYNC;
+    }
+
+  public:
+    headless_output_backend_t()
+    {
+        backend = wlr_headless_backend_create(wf::get_core().display);
+        on_new_output.set_callback([=] (void *data)
+        {
+            auto handle = (wlr_output*)data;
+            auto state  = std::make_unique<emulated_output_t>();
+            state->on_present.set_callback([this, handle, state = state.get()] (void *data)
+            {
+                emulate_present(*state, handle, (wlr_output_event_present*)data);
+            });
+            state->on_destroy.set_callback([this, handle] (void*) { outputs.erase(handle); });
+            state->on_present.connect(&handle->events.present);
+            state->on_destroy.connect(&handle->events.destroy);
+            outputs[handle] = std::move(state);
+        });
+
+        // Connected before the multi backend forwards new outputs to the core, so that the emulated
+        // presentation listener runs before the ones of the output's render manager.
+        on_new_output.connect(&backend->events.new_output);
+        wlr_multi_backend_add(wf::get_core().backend, backend);
+        wlr_backend_start(backend);
+    }
+
+    /** Create an output and configure its mode. Returns the name of the new output. */
+    std::string create_output(int width, int height, int refresh_mhz)
+    {
+        auto handle = wlr_headless_add_output(backend, width, height);
+
+        // The core applies the configured mode once the output is added, so the synthetic refresh rate is
+        // given as part of it.
+        auto section = wf::get_core().config_backend->get_output_section(handle);
+        section->get_option("mode")->set_value_str(
+            std::to_string(width) + "x" + std::to_string(height) + "@" + std::to_string(refresh_mhz));
+        return handle->name;
+    }
+
+    headless_output_backend_t(const headless_output_backend_t&) = delete;
+    headless_output_backend_t(headless_output_backend_t&&) = delete;
+    headless_output_backend_t& operator =(const headless_output_backend_t&) = delete;
+    headless_output_backend_t& operator =(headless_output_backend_t&&) = delete;
+};
+
 class stipc_plugin_t : public wf::plugin_interface_t
 {
     wf::shared_data::ref_ptr_t<wf::ipc::method_repository_t> method_repository;
@@ -288,6 +385,8 @@ class stipc_plugin_t : public wf::plugin_interface_t
         input = std::make_unique<headless_input_backend_t>();
         method_repository->register_method("stipc/create_wayland_output", create_wayland_output);
         method_repository->register_method("stipc/destroy_wayland_output", destroy_wayland_output);
+        method_repository->register_method("stipc/create_headless_output", create_headless_output);
+        method_repository->register_method("stipc/destroy_headless_output", destroy_wayland_output);
         method_repository->register_method("stipc/feed_key", feed_key);
         method_repository->register_method("stipc/feed_button", feed_button);
         method_repository->register_method("stipc/move_cursor", move_cursor);
@@ -305,6 +404,8 @@ class stipc_plugin_t : public wf::plugin_interface_t
         method_repository->register_method("stipc/delay_next_tx", delay_next_tx);
         method_repository->register_method("stipc/get_xwayland_pid", get_xwayland_pid);
         method_repository->register_method("stipc/get_xwayland_display", get_xwayland_display);
+        method_repository->register_method("stipc/bench_frames", bench_frames);
+        method_repository->register_method("stipc/bench_results", bench_results);
     }
 
     bool is_unloadable() override
@@ -378,6 +479,42 @@ class stipc_plugin_t : public wf::plugin_interface_t
         return wf::ipc::json_ok();
     };
 
+    ipc::method_callback create_headless_output = [=] (nlohmann::json data)
+    {
+        WFJSON_OPTIONAL_FIELD(data, "width", number_integer);
+        WFJSON_OPTIONAL_FIELD(data, "height", number_integer);
+        WFJSON_OPTIONAL_FIELD(data, "refresh", number_integer);
+        WFJSON_OPTIONAL_FIELD(data, "count", number_integer);
+
+        const int width   = data.value("width", 1280);
+        const int height  = data.value("height", 720);
+        const int refresh = data.value("refresh", 60000);
+        const int count   = data.value("count", 1);
+        if ((width <= 0) || (height <= 0) || (refresh <= 0))
+        {
+            return wf::ipc::json_error("The size and refresh rate (in mHz) must be positive");
+        }
+
+        if ((count <= 0) || (count > 64))
+        {
+            return wf::ipc::json_error("The number of outputs must be between 1 and 64");
+        }
+
+        if (!headless_outputs)
+        {
+            headless_outputs = std::make_unique<headless_output_backend_t>();
+        }
+
+        auto response = wf::ipc::json_ok();
+        response["outputs"] = nlohmann::json::array();
+        for (int i = 0; i < count; i++)
+        {
+            response["outputs"].push_back(headless_outputs->create_output(width, height, refresh));
+        }
+
+        return response;
+    };
+
     ipc::method_callback destroy_wayland_output = [] (nlohmann::json data)
     {
         WFJSON_EXPECT_FIELD(data, "output", string);
@@ -641,7 +778,173 @@ class stipc_plugin_t : public wf::plugin_interface_t
         return response;
     };
 
+    /**
+     * A benchmark which renders a number of frames on an output, started with stipc/bench_frames.
+     * The results can be queried with stipc/bench_results once all frames have been rendered.
+     */
+    struct bench_t
+    {
+        wf::output_t *output = nullptr;
+        bool full_damage     = true;
+        int frames_left = 0;
+
+        int64_t frame_start = -1;
+        std::vector<int64_t> frame_times;
+        int64_t wall_start = 0;
+        uint64_t draw_calls_start = 0;
+        int64_t heap_start = 0;
+
+        nlohmann::json result;
+    };
+
+    bench_t bench;
+
+    static int64_t get_heap_usage()
+    {
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+        return mallinfo2().uordblks;
+#else
+        return 0;
+#endif
+    }
+
+    wf::effect_hook_t bench_pre_hook = [=] ()
+    {
+        if (bench.full_damage)
+        {
+            bench.output->render->damage_whole();
+        }
+
+        bench.frame_start = wf::get_current_time_usec();
+    };
+
+    wf::effect_hook_t bench_post_hook = [=] ()
+    {
+        // Frames which were directly scanned out do not reach the post hook, they are simply not counted.
+        if (bench.frame_start < 0)
+        {
+            return;
+        }
+
+        bench.frame_times.push_back(wf::get_current_time_usec() - bench.frame_start);
+        bench.frame_start = -1;
+        if (--bench.frames_left <= 0)
+        {
+            finish_bench();
+        }
+    };
+
+    wf::signal::connection_t<wf::output_pre_remove_signal> on_bench_output_removed =
+        [=] (wf::output_pre_remove_signal *ev)
+    {
+        if (ev->output == bench.output)
+        {
+            finish_bench();
+            bench.result = wf::ipc::json_error("Output was removed during the benchmark");
+        }
+    };
+
+    void finish_bench()
+    {
+        const int64_t wall_time = wf::get_current_time_usec() - bench.wall_start;
+        const int frames = bench.frame_times.size();
+
+        bench.output->render->rem_effect(&bench_pre_hook);
+        bench.output->render->rem_effect(&bench_post_hook);
+        bench.output->render->set_redraw_always(false);
+        on_bench_output_removed.disconnect();
+        bench.output = nullptr;
+
+        auto& times = bench.frame_times;
+        std::sort(times.begin(), times.end());
+        auto percentile = [&] (int p) -> int64_t
+        {
+            return times.empty() ? 0 : times[std::min<size_t>(times.size() - 1, times.size() * p / 100)];
+        };
+
+        int64_t sum = 0;
+        for (auto t : times)
+        {
+            sum += t;
+        }
+
+        bench.result = wf::ipc::json_ok();
+        bench.result["frames"]     = frames;
+        bench.result["wall-time"]  = wall_time;
+        bench.result["frame-time"] = {
+            {"avg", frames ? sum / frames : 0},
+            {"p50", percentile(50)},
+            {"p90", percentile(90)},
+            {"p99", percentile(99)},
+            {"max", times.empty() ? 0 : times.back()},
+        };
+
+        const uint64_t draw_calls = OpenGL::get_draw_call_count() - bench.draw_calls_start;
+        bench.result["draw-calls"] = draw_calls;
+        bench.result["draw-calls-per-frame"] = frames ? (double)draw_calls / frames : 0.0;
+        bench.result["heap-growth"] = get_heap_usage() - bench.heap_start;
+    }
+
+    ipc::method_callback bench_frames = [=] (nlohmann::json data)
+    {
+        WFJSON_EXPECT_FIELD(data, "output", string);
+        WFJSON_EXPECT_FIELD(data, "frames", number_integer);
+        WFJSON_OPTIONAL_FIELD(data, "full_damage", boolean);
+
+        if (bench.output)
+        {
+            return wf::ipc::json_error("A benchmark is already running");
+        }
+
+        auto output = wf::get_core().output_layout->find_output(data["output"]);
+        if (!output)
+        {
+            return wf::ipc::json_error("Could not find output: \"" + (std::string)data["output"] + "\"");
+        }
+
+        if (data["frames"] <= 0)
+        {
+            return wf::ipc::json_error("The number of frames must be positive");
+        }
+
+        bench = {};
+        bench.output      = output;
+        bench.frames_left = data["frames"];
+        bench.full_damage = data.value("full_damage", true);
+        bench.frame_times.reserve(bench.frames_left);
+        bench.wall_start = wf::get_current_time_usec();
+        bench.draw_calls_start = OpenGL::get_draw_call_count();
+        bench.heap_start = get_heap_usage();
+
+        output->render->add_effect(&bench_pre_hook, OUTPUT_EFFECT_PRE);
+        output->render->add_effect(&bench_post_hook, OUTPUT_EFFECT_POST);
+        output->render->set_redraw_always(true);
+        wf::get_core().output_layout->connect(&on_bench_output_removed);
+        return wf::ipc::json_ok();
+    };
+
+    ipc::method_callback bench_results = [=] (nlohmann::json)
+    {
+        if (bench.output)
+        {
+            auto response = wf::ipc::json_ok();
+            response["running"] = true;
+            response["frames-left"] = bench.frames_left;
+            return response;
+        }
+
+        if (bench.result.is_null())
+        {
+            return wf::ipc::json_error("No benchmark has been run");
+        }
+
+        auto response = bench.result;
+        response["running"] = false;
+        return response;
+    };
+
     std::unique_ptr<headless_input_backend_t> input;
+    std::unique_ptr<headless_output_backend_t> headless_outputs;
 };
 }
 
@@ -3,10 +3,12 @@
 #include <wayfire/output-layout.hpp>
 #include "wayfire/view.hpp"
 #include <memory>
+#include <utility>
 #include <wayfire/plugin.hpp>
 #include <wayfire/nonstd/wlroots-full.hpp>
 #include <wayfire/toplevel-view.hpp>
 #include <wayfire/window-manager.hpp>
+#include <wayfire/util.hpp>
 #include "gtk-shell.hpp"
 #include "config.h"
 
@@ -63,9 +65,62 @@ class wayfire_foreign_toplevel
     }
 
   private:
+    /*
+     * Changes of the title, app-id and state are not sent right away, but collected and sent together at
+     * most once per UPDATE_INTERVAL_MS, so that clients which change their title very often do not flood
+     * the taskbars with events (and repaints). wlroots sends a single done event for all of them.
+     */
+    static constexpr int UPDATE_INTERVAL_MS = 16;
+    enum update_flags
+    {
+        UPDATE_TITLE  = (1 << 0),
+        UPDATE_APP_ID = (1 << 1),
+        UPDATE_STATE  = (1 << 2),
+    };
+
+    uint32_t pending_updates = 0;
+    wf::wl_timer<false> update_timer;
+
+    // The last values sent to the clients. wlroots itself ignores unchanged states, but not strings.
+    std::string sent_title;
+    std::string sent_app_id;
+
+    void schedule_update(uint32_t flags)
+    {
+        pending_updates |= flags;
+        if (!update_timer.is_connected())
+        {
+            update_timer.set_timeout(UPDATE_INTERVAL_MS, [=] () { send_pending_updates(); });
+        }
+    }
+
+    void send_pending_updates()
+    {
+        const uint32_t updates = std::exchange(pending_updates, 0);
+        if (updates & UPDATE_TITLE)
+        {
+            toplevel_send_title();
+        }
+
+        if (updates & UPDATE_APP_ID)
+        {
+            toplevel_send_app_id();
+        }
+
+        if (updates & UPDATE_STATE)
+        {
+            toplevel_send_state();
+        }
+    }
+
     void toplevel_send_title()
     {
-        wlr_foreign_toplevel_handle_v1_set_title(handle, view->get_title().c_str());
+        auto title = view->get_title();
+        if (title != sent_title)
+        {
+            sent_title = title;
+            wlr_foreign_toplevel_handle_v1_set_title(handle, title.c_str());
+        }
     }
 
     void toplevel_send_app_id()
@@ -99,7 +154,11 @@ class wayfire_foreign_toplevel
             app_id = default_app_id;
         }
 
-        wlr_foreign_toplevel_handle_v1_set_app_id(handle, app_id.c_str());
+        if (app_id != sent_app_id)
+        {
+            sent_app_id = app_id;
+            wlr_foreign_toplevel_handle_v1_set_app_id(handle, app_id.c_str());
+        }
     }
 
     void toplevel_send_state()
@@ -136,12 +195,12 @@ class wayfire_foreign_toplevel
 
     wf::signal::connection_t<wf::view_title_changed_signal> on_title_changed = [=] (auto)
     {
-        toplevel_send_title();
+        schedule_update(UPDATE_TITLE);
     };
 
     wf::signal::connection_t<wf::view_app_id_changed_signal> on_app_id_changed = [=] (auto)
     {
-        toplevel_send_app_id();
+        schedule_update(UPDATE_APP_ID);
     };
 
     wf::signal::connection_t<wf::view_set_output_signal> on_set_output = [=] (wf::view_set_output_signal *ev)
@@ -152,27 +211,27 @@ class wayfire_foreign_toplevel
 
     wf::signal::connection_t<wf::view_minimized_signal> on_minimized = [=] (auto)
     {
-        toplevel_send_state();
+        schedule_update(UPDATE_STATE);
     };
 
     wf::signal::connection_t<wf::view_fullscreen_signal> on_fullscreen = [=] (auto)
     {
-        toplevel_send_state();
+        schedule_update(UPDATE_STATE);
     };
 
     wf::signal::connection_t<wf::view_tiled_signal> on_tiled = [=] (auto)
     {
-        toplevel_send_state();
+        schedule_update(UPDATE_STATE);
     };
 
     wf::signal::connection_t<wf::view_activated_state_signal> on_activated = [=] (auto)
     {
-        toplevel_send_state();
+        schedule_update(UPDATE_STATE);
     };
 
     wf::signal::connection_t<wf::view_parent_changed_signal> on_parent_changed = [=] (auto)
     {
-        toplevel_send_state();
+        schedule_update(UPDATE_STATE);
     };
 
     wf::wl_listener_wrapper toplevel_handle_v1_maximize_request;
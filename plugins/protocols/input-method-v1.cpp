@@ -1,6 +1,8 @@
 #include <fcntl.h>
 #include <unistd.h>
+#include <optional>
 #include <set>
+#include <string>
 #include <wayfire/plugin.hpp>
 #include <wayfire/core.hpp>
 #include <wayfire/unstable/wlr-text-input-v3-popup.hpp>
@@ -42,14 +44,34 @@ class wayfire_input_method_v1_context
     {
         auto ti_v3 = dynamic_cast<wayfire_im_v1_text_input_v3*>(text_input);
         wf::dassert(ti_v3, "handle_text_input_v3_commit called without text_input_v3");
-        auto text_input_v3 = ti_v3->text_input_v3;
-        zwp_input_method_context_v1_send_content_type(context,
-            text_input_v3->current.content_type.hint, text_input_v3->current.content_type.purpose);
-        zwp_input_method_context_v1_send_surrounding_text(context,
-            text_input_v3->current.surrounding.text ?: "",
-            text_input_v3->current.surrounding.cursor,
-            text_input_v3->current.surrounding.anchor);
-        zwp_input_method_context_v1_send_commit_state(context, ctx_serial++);
+        const auto& current = ti_v3->text_input_v3->current;
+
+        // Forward only what changed, and commit only if anything did.
+        bool changed = false;
+        if (!sent_content_type ||
+            (*sent_content_type != std::make_pair(current.content_type.hint, current.content_type.purpose)))
+        {
+            zwp_input_method_context_v1_send_content_type(context,
+                current.content_type.hint, current.content_type.purpose);
+            sent_content_type = {current.content_type.hint, current.content_type.purpose};
+            changed = true;
+        }
+
+        std::string text = current.surrounding.text ?: "";
+        if (!sent_surrounding || (sent_surrounding->text != text) ||
+            (sent_surrounding->cursor != current.surrounding.cursor) ||
+            (sent_surrounding->anchor != current.surrounding.anchor))
+        {
+            zwp_input_method_context_v1_send_surrounding_text(context, text.c_str(),
+                current.surrounding.cursor, current.surrounding.anchor);
+            sent_surrounding = {std::move(text), current.surrounding.cursor, current.surrounding.anchor};
+            changed = true;
+        }
+
+        if (changed)
+        {
+            zwp_input_method_context_v1_send_commit_state(context, ctx_serial++);
+        }
     }
 
     void deactivate(bool im_killed = false)
@@ -224,6 +246,17 @@ class wayfire_input_method_v1_context
     uint32_t ctx_serial  = 0;
     uint32_t vkbd_serial = 0;
 
+    // The state of the text-input-v3 last sent to the input method
+    struct surrounding_t
+    {
+        std::string text;
+        uint32_t cursor;
+        uint32_t anchor;
+    };
+
+    std::optional<std::pair<uint32_t, uint32_t>> sent_content_type;
+    std::optional<surrounding_t> sent_surrounding;
+
     wl_resource *current_im = NULL;
     wl_resource *context    = NULL;
 
@@ -533,8 +566,6 @@ class wayfire_input_method_v1 : public wf::plugin_interface_t, public wf::text_i
                 handle_text_input_v3_created(static_cast<wlr_text_input_v3*>(data));
             });
         }
-
-        wf::get_core().connect(&on_keyboard_focus_changed);
     }
 
     void fini() override
@@ -564,12 +595,16 @@ class wayfire_input_method_v1 : public wf::plugin_interface_t, public wf::text_i
         return false;
     }
 
+    /* Connected only while an input method is bound */
     wf::signal::connection_t<wf::keyboard_focus_changed_signal> on_keyboard_focus_changed =
         [=] (wf::keyboard_focus_changed_signal *ev)
     {
         auto view = wf::node_to_view(ev->new_focus);
-        auto surf = view ? view->get_wlr_surface() : nullptr;
+        set_focus(view ? view->get_wlr_surface() : nullptr);
+    };
 
+    void set_focus(wlr_surface *surf)
+    {
         if (last_focus_surface != surf)
         {
             reset_current_im_context();
@@ -579,7 +614,7 @@ class wayfire_input_method_v1 : public wf::plugin_interface_t, public wf::text_i
                 text_input->set_focus_surface(last_focus_surface);
             });
         }
-    };
+    }
 
     // Handlers for text-input-v1
 
@@ -804,6 +839,11 @@ class wayfire_input_method_v1 : public wf::plugin_interface_t, public wf::text_i
         wl_resource_set_implementation(resource, NULL, this, handle_destroy_im);
         current_im = resource;
 
+        // Text inputs are entered only while there is an input method, catch up with the current focus.
+        wf::get_core().connect(&on_keyboard_focus_changed);
+        auto view = wf::node_to_view(wf::get_core().seat->get_active_node());
+        set_focus(view ? view->get_wlr_surface() : nullptr);
+
         for (auto& [_, im] : im_text_inputs_v3)
         {
             if (im->is_enabled())
@@ -824,8 +864,11 @@ class wayfire_input_method_v1 : public wf::plugin_interface_t, public wf::text_i
         auto data = wl_resource_get_user_data(resource);
         if (data)
         {
-            ((wayfire_input_method_v1*)data)->reset_current_im_context(true);
-            ((wayfire_input_method_v1*)data)->current_im = nullptr;
+            auto self = (wayfire_input_method_v1*)data;
+            self->reset_current_im_context(true);
+            self->current_im = nullptr;
+            self->on_keyboard_focus_changed.disconnect();
+            self->set_focus(nullptr);
         }
     }
 
@@ -461,6 +461,9 @@ class wf_session_lock_plugin : public wf::plugin_interface_t
         switch (state)
         {
           case UNLOCKED:
+            set_unlocked_content_hidden(false);
+            break;
+
           case LOCKING:
             break;
 
@@ -469,6 +472,7 @@ class wf_session_lock_plugin : public wf::plugin_interface_t
             // If a previous lock is in zombie state, delete it, so it stops listening for output
             // changes, removes lock_crashed_nodes, etc.
             prev_lock.reset();
+            set_unlocked_content_hidden(true);
             break;
 
           case DESTROYED:
@@ -487,9 +491,30 @@ class wf_session_lock_plugin : public wf::plugin_interface_t
         }
     }
 
+    /**
+     * While the session is locked, only the lock layer is shown. Disabling the other layers removes their
+     * render instances, so the surfaces below the lock screen are neither repainted nor sent frame
+     * callbacks, and the compositor does not wait for their buffers.
+     */
+    void set_unlocked_content_hidden(bool hidden)
+    {
+        if (hidden == unlocked_content_hidden)
+        {
+            return;
+        }
+
+        unlocked_content_hidden = hidden;
+        auto& layers = wf::get_core().scene()->layers;
+        for (size_t layer = 0; layer < (size_t)wf::scene::layer::LOCK; layer++)
+        {
+            wf::scene::set_node_enabled(layers[layer], !hidden);
+        }
+    }
+
     void fini() override
     {
         // TODO: unlock everything?
+        set_unlocked_content_hidden(false);
     }
 
     bool is_unloadable() override
@@ -503,6 +528,7 @@ class wf_session_lock_plugin : public wf::plugin_interface_t
     wf::wl_listener_wrapper destroy;
 
     std::shared_ptr<wayfire_session_lock> cur_lock, prev_lock;
+    bool unlocked_content_hidden = false;
 };
 
 DECLARE_WAYFIRE_PLUGIN(wf_session_lock_plugin);
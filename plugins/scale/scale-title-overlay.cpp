@@ -14,6 +14,7 @@
 #include <wayfire/util/log.hpp>
 #include <wayfire/plugins/common/cairo-util.hpp>
 #include <wayfire/plugins/common/simple-texture.hpp>
+#include <wayfire/plugins/common/text-texture-cache.hpp>
 #include <wayfire/scene.hpp>
 #include <wayfire/scene-render.hpp>
 
@@ -30,17 +31,36 @@ static wayfire_toplevel_view find_toplevel_parent(wayfire_toplevel_view view)
     return view;
 }
 
+/**
+ * on: view_title_texture_t
+ * when: Emitted when the texture of the title has been replaced.
+ */
+struct title_texture_updated_signal
+{};
+
 /**
  * Class storing an overlay with a view's title, only stored for parent views.
  */
-struct view_title_texture_t : public wf::custom_data_t
+struct view_title_texture_t : public wf::custom_data_t, public wf::signal::provider_t
 {
     wayfire_toplevel_view view;
-    wf::cairo_text_t overlay;
+    wf::shared_data::ref_ptr_t<wf::text_texture_cache_t> cache;
+    /* The texture which is shown, and the one which replaces it as soon as it has been rasterized */
+    std::shared_ptr<wf::cached_text_texture_t> overlay, pending;
     wf::cairo_text_t::params par;
     bool overflow = false;
     wayfire_toplevel_view dialog; /* the texture should be rendered on top of this dialog */
 
+    /**
+     * The texture which is shown. Its tex is -1 until the title has been rasterized for the first time,
+     * the overlay is not shown until then.
+     */
+    wf::simple_texture_t& texture()
+    {
+        static wf::simple_texture_t none;
+        return overlay ? overlay->tex : none;
+    }
+
     /**
      * Render the overlay text in our texture, cropping it to the size by
      * the given box.
@@ -53,14 +73,37 @@ struct view_title_texture_t : public wf::custom_data_t
 
     void update_overlay_texture()
     {
-        auto res = overlay.render_text(view->get_title(), par);
-        overflow = res.width > overlay.tex.width;
+        on_pending_ready.disconnect();
+        pending = cache->get(view->get_title(), par, &typeid(*this));
+        if (pending->ready)
+        {
+            apply_pending();
+        } else
+        {
+            pending->connect(&on_pending_ready);
+        }
+    }
+
+    void apply_pending()
+    {
+        on_pending_ready.disconnect();
+        overlay  = std::move(pending);
+        overflow = overlay->required_size.width > overlay->tex.width;
+
+        title_texture_updated_signal data;
+        this->emit(&data);
     }
 
+    wf::signal::connection_t<wf::cached_text_ready_signal> on_pending_ready =
+        [=] (wf::cached_text_ready_signal *ev)
+    {
+        apply_pending();
+    };
+
     wf::signal::connection_t<wf::view_title_changed_signal> view_changed_title =
         [=] (wf::view_title_changed_signal *ev)
     {
-        if (overlay.tex.tex != (GLuint) - 1)
+        if (overlay || pending)
         {
             update_overlay_texture();
         }
@@ -104,6 +147,11 @@ class title_overlay_node_t : public node_t
      * Set in the pre-render hook and used in the render function. */
     bool overlay_shown = false;
     wf::wl_idle_call idle_update_title;
+    wf::signal::connection_t<title_texture_updated_signal> on_texture_updated =
+        [=] (title_texture_updated_signal*)
+    {
+        idle_update_title.run_once();
+    };
 
   private:
     /**
@@ -214,18 +262,18 @@ class title_overlay_node_t : public node_t
          * animated and maybe redraw less frequently
          */
         auto& tex = get_overlay_texture(find_toplevel_parent(view));
-        if ((tex.overlay.tex.tex == (GLuint) - 1) ||
+        if ((tex.texture().tex == (GLuint) - 1) ||
             (output_scale != tex.par.output_scale) ||
-            (tex.overlay.tex.width > box.width * output_scale) ||
+            (tex.texture().width > box.width * output_scale) ||
             (tex.overflow &&
-             (tex.overlay.tex.width < std::floor(box.width * output_scale))))
+             (tex.texture().width < std::floor(box.width * output_scale))))
         {
             tex.par.output_scale = output_scale;
             tex.update_overlay_texture({box.width, box.height});
         }
 
-        geometry.width  = tex.overlay.tex.width / output_scale;
-        geometry.height = tex.overlay.tex.height / output_scale;
+        geometry.width  = tex.texture().width / output_scale;
+        geometry.height = tex.texture().height / output_scale;
 
         auto bbox = get_scaled_bbox(view);
         geometry.x = bbox.x + bbox.width / 2 - geometry.width / 2;
@@ -256,10 +304,10 @@ class title_overlay_node_t : public node_t
         auto parent = find_toplevel_parent(view);
         auto& title = get_overlay_texture(parent);
 
-        if (title.overlay.tex.tex != (GLuint) - 1)
+        if (title.texture().tex != (GLuint) - 1)
         {
             text_height = (unsigned int)std::ceil(
-                title.overlay.tex.height / title.par.output_scale);
+                title.texture().height / title.par.output_scale);
         } else
         {
             text_height =
@@ -268,6 +316,7 @@ class title_overlay_node_t : public node_t
 
         idle_update_title.set_callback([=] () { update_title(); });
         idle_update_title.run_once();
+        title.connect(&on_texture_updated);
     }
 
     ~title_overlay_node_t()
@@ -341,7 +390,7 @@ class title_overlay_render_instance_t : public render_instance_t
         auto tr     = self->view->get_transformed_node()
             ->get_transformer<wf::scene::view_2d_transformer_t>("scale");
 
-        GLuint tex = title.overlay.tex.tex;
+        GLuint tex = title.texture().tex;
 
         if (tex == (GLuint) - 1)
         {
@@ -3,6 +3,8 @@
  */
 #include <map>
 #include <memory>
+#include <tuple>
+#include <unordered_set>
 #include <wayfire/workarea.hpp>
 #include <wayfire/seat.hpp>
 #include <wayfire/per-output-plugin.hpp>
@@ -103,6 +105,8 @@ class wayfire_scale : public wf::per_output_plugin_instance_t,
     /* helper class for optionally showing title overlays */
     scale_show_title_t show_title;
     std::vector<int> current_row_sizes;
+    /* The rows of the last layout, used to keep the slots of views stable when views come and go */
+    std::vector<std::vector<wayfire_toplevel_view>> current_rows;
     wf::point_t initial_workspace;
     bool hook_set;
     /* View that was active before scale began. */
@@ -120,6 +124,8 @@ class wayfire_scale : public wf::per_output_plugin_instance_t,
     wf::option_wrapper_t<bool> allow_scale_zoom{"scale/allow_zoom"};
     wf::option_wrapper_t<bool> include_minimized{"scale/include_minimized"};
     wf::option_wrapper_t<bool> close_on_new_view{"scale/close_on_new_view"};
+    wf::option_wrapper_t<double> lod_threshold{"scale/lod_threshold"};
+    wf::option_wrapper_t<int> lod_update_interval{"scale/lod_update_interval"};
 
     /* maximum scale -- 1.0 means we will not "zoom in" on a view */
     const double max_scale_factor = 1.0;
@@ -209,6 +215,12 @@ class wayfire_scale : public wf::per_output_plugin_instance_t,
         }
 
         auto tr = std::make_shared<wf::scene::view_2d_transformer_t>(view);
+        // Under load, use thumbnails for views shown at up to their full size too, see
+        // render_manager::get_effect_quality().
+        const double quality   = output->render->get_effect_quality("scale");
+        const double threshold = lod_threshold;
+        tr->lod_threshold = (threshold > 0) ? threshold + (1.0 - threshold) * (1.0 - quality) : 0.0;
+        tr->lod_update_interval = lod_update_interval;
         scale_data[view].transformer = tr;
         view->get_transformed_node()->add_transformer(tr, wf::TRANSFORMER_2D,
             "scale");
@@ -837,52 +849,171 @@ class wayfire_scale : public wf::per_output_plugin_instance_t,
             target_alpha);
     }
 
-    static bool view_compare_x(const wayfire_toplevel_view& a, const wayfire_toplevel_view& b)
+    /* Sort keys for views: first by position and size in one direction, then in the other direction.
+     * The view pointer is a persistent identifier, so that views with exactly the same geometry always
+     * appear in the same order. */
+    static auto view_key_x(const wayfire_toplevel_view& view)
     {
-        auto vg_a = a->get_geometry();
-        std::vector<int> a_coords = {vg_a.x, vg_a.width, vg_a.y, vg_a.height};
-        auto vg_b = b->get_geometry();
-        std::vector<int> b_coords = {vg_b.x, vg_b.width, vg_b.y, vg_b.height};
-        return a_coords < b_coords;
+        auto vg = view->get_geometry();
+        return std::make_tuple(vg.x, vg.width, vg.y, vg.height, view.get());
     }
 
-    static bool view_compare_y(const wayfire_toplevel_view& a, const wayfire_toplevel_view& b)
+    static auto view_key_y(const wayfire_toplevel_view& view)
     {
-        auto vg_a = a->get_geometry();
-        std::vector<int> a_coords = {vg_a.y, vg_a.height, vg_a.x, vg_a.width};
-        auto vg_b = b->get_geometry();
-        std::vector<int> b_coords = {vg_b.y, vg_b.height, vg_b.x, vg_b.width};
-        return a_coords < b_coords;
+        auto vg = view->get_geometry();
+        return std::make_tuple(vg.y, vg.height, vg.x, vg.width, view.get());
     }
 
-    std::vector<std::vector<wayfire_toplevel_view>> view_sort(
-        std::vector<wayfire_toplevel_view>& views)
+    /* Sort views by the given key, computing the key of each view only once. */
+    template<class Key>
+    static void sort_views(std::vector<wayfire_toplevel_view>::iterator begin,
+        std::vector<wayfire_toplevel_view>::iterator end, Key key)
     {
-        std::vector<std::vector<wayfire_toplevel_view>> view_grid;
-        // First ensure a consistent sorting of all views using a persistent
-        // identifier before sorting by geometry.
-        // This is so that if two views have exactly the same geometry,
-        // they will always appear in the same order in the output list.
-        std::sort(views.begin(), views.end(), [] (auto a, auto b)
+        std::vector<std::pair<decltype(key(*begin)), wayfire_toplevel_view>> keyed;
+        keyed.reserve(end - begin);
+        for (auto it = begin; it != end; ++it)
         {
-            return a.get() < b.get();
+            keyed.emplace_back(key(*it), *it);
+        }
+
+        std::sort(keyed.begin(), keyed.end(), [] (const auto& a, const auto& b)
+        {
+            return a.first < b.first;
         });
-        std::stable_sort(views.begin(), views.end(), view_compare_y);
+        for (auto& [_, view] : keyed)
+        {
+            *begin++ = view;
+        }
+    }
 
-        int rows = sqrt(views.size() + 1);
-        int views_per_row = (int)std::ceil((double)views.size() / rows);
-        size_t n = views.size();
+    /* The maximal number of views in a row of a grid with @count views */
+    static size_t get_views_per_row(size_t count)
+    {
+        int rows = sqrt(count + 1);
+        return std::ceil((double)count / rows);
+    }
+
+    /* Split views which are in reading order into rows of a grid, sorting each row by x. */
+    static std::vector<std::vector<wayfire_toplevel_view>> split_rows(
+        std::vector<wayfire_toplevel_view>& views)
+    {
+        std::vector<std::vector<wayfire_toplevel_view>> view_grid;
+        const size_t views_per_row = get_views_per_row(views.size());
+        const size_t n = views.size();
         for (size_t i = 0; i < n; i += views_per_row)
         {
             size_t j = std::min(i + views_per_row, n);
             view_grid.emplace_back(views.begin() + i, views.begin() + j);
-            std::stable_sort(view_grid.back().begin(), view_grid.back().end(),
-                view_compare_x);
+            sort_views(view_grid.back().begin(), view_grid.back().end(), view_key_x);
         }
 
         return view_grid;
     }
 
+    std::vector<std::vector<wayfire_toplevel_view>> view_sort(
+        std::vector<wayfire_toplevel_view>& views)
+    {
+        sort_views(views.begin(), views.end(), view_key_y);
+        return split_rows(views);
+    }
+
+    /**
+     * Update the rows of the last layout for a new list of views.
+     *
+     * Views which are still present keep their row and their order, and new views are inserted into the row
+     * and column they would have in a sorted grid. The rows are split again only if they no longer have the
+     * shape of a grid for the new number of views, so that a view coming or going rearranges only its row
+     * in most cases. If most views are new, the grid is built from scratch.
+     */
+    std::vector<std::vector<wayfire_toplevel_view>> view_update_sort(
+        std::vector<wayfire_toplevel_view>& views)
+    {
+        std::unordered_set<wf::toplevel_view_interface_t*> present;
+        for (auto& view : views)
+        {
+            present.insert(view.get());
+        }
+
+        std::vector<std::vector<wayfire_toplevel_view>> rows;
+        std::unordered_set<wf::toplevel_view_interface_t*> placed;
+        for (auto& row : current_rows)
+        {
+            rows.emplace_back();
+            for (auto& view : row)
+            {
+                if (present.count(view.get()) && placed.insert(view.get()).second)
+                {
+                    rows.back().push_back(view);
+                }
+            }
+
+            if (rows.back().empty())
+            {
+                rows.pop_back();
+            }
+        }
+
+        std::vector<wayfire_toplevel_view> added;
+        for (auto& view : views)
+        {
+            if (!placed.count(view.get()))
+            {
+                added.push_back(view);
+            }
+        }
+
+        if (added.size() > placed.size())
+        {
+            return view_sort(views);
+        }
+
+        sort_views(added.begin(), added.end(), view_key_y);
+        for (auto& view : added)
+        {
+            auto key = view_key_y(view);
+            auto row = std::upper_bound(rows.begin(), rows.end(), key, [] (const auto& k, const auto& r)
+            {
+                return k < view_key_y(r.front());
+            });
+
+            if (row == rows.begin())
+            {
+                rows.emplace(rows.begin());
+                row = rows.begin();
+            } else
+            {
+                --row;
+            }
+
+            auto x_key = view_key_x(view);
+            auto col   = std::upper_bound(row->begin(), row->end(), x_key, [] (const auto& k, const auto& v)
+            {
+                return k < view_key_x(v);
+            });
+            row->insert(col, view);
+        }
+
+        const size_t views_per_row = get_views_per_row(views.size());
+        bool is_grid = (rows.size() == (views.size() + views_per_row - 1) / views_per_row);
+        for (auto& row : rows)
+        {
+            is_grid &= !row.empty() && (row.size() <= views_per_row);
+        }
+
+        if (is_grid)
+        {
+            return rows;
+        }
+
+        std::vector<wayfire_toplevel_view> reading_order;
+        for (auto& row : rows)
+        {
+            reading_order.insert(reading_order.end(), row.begin(), row.end());
+        }
+
+        return split_rows(reading_order);
+    }
+
     /* Filter the views to be arranged by layout_slots() */
     void filter_views(scale_view_list& view_list)
     {
@@ -958,8 +1089,9 @@ class wayfire_scale : public wf::per_output_plugin_instance_t,
         workarea.width -= outer_margin * 2;
         workarea.height -= outer_margin * 2;
 
-        auto sorted_rows = view_sort(views);
+        auto sorted_rows = current_rows.empty() ? view_sort(views) : view_update_sort(views);
         size_t cnt_rows  = sorted_rows.size();
+        current_rows = sorted_rows;
 
         const double scaled_height = std::max((double)
             (workarea.height - (cnt_rows + 1) * spacing) / cnt_rows, 1.0);
@@ -1388,6 +1520,7 @@ class wayfire_scale : public wf::per_output_plugin_instance_t,
 
         active = true;
 
+        current_rows.clear();
         layout_slots(get_views());
 
         output->connect(&on_view_mapped);
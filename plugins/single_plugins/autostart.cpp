@@ -1,21 +1,161 @@
 #include <wayfire/plugin.hpp>
 #include <wayfire/core.hpp>
+#include <wayfire/util.hpp>
+#include <wayfire/view.hpp>
 #include <wayfire/util/log.hpp>
 #include <wayfire/option-wrapper.hpp>
+#include <wayfire/signal-definitions.hpp>
 #include <config.h>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * An entry of the autostart list.
+ *
+ * The command of an entry may start with options in square brackets, for example
+ * `[after=panel,portal ready=mapped] my-program --arg`:
+ *
+ * - after=<names>: a comma-separated list of entries which have to be ready before this entry is started.
+ * - ready=<condition>: when the entry counts as ready, one of
+ *   - spawn: right after it has been started (the default),
+ *   - exit: when the started process exits, for example for setup scripts,
+ *   - mapped: when the started process or one of its children maps a view,
+ *   - dbus:<name>: when the given name appears on the session bus (waits with `gdbus wait`),
+ *   - delay:<ms>: after the given time.
+ *
+ * Entries which do not wait for other entries are all started right away.
+ */
+struct autostart_entry_t
+{
+    std::string name;
+    std::string command;
+    std::vector<std::string> after;
+    std::string ready = "spawn";
+
+    bool started  = false;
+    bool is_ready = false;
+    pid_t pid     = -1;
+    int64_t spawn_time = 0;
+
+    // Sources which may make the entry ready
+    wl_event_source *exit_source = nullptr;
+    std::function<void()> on_exit;
+    wf::wl_timer<false> delay;
+    wf::wl_timer<false> timeout;
+
+    ~autostart_entry_t()
+    {
+        stop_waiting();
+    }
+
+    void stop_waiting()
+    {
+        if (exit_source)
+        {
+            close(wl_event_source_get_fd(exit_source));
+            wl_event_source_remove(exit_source);
+            exit_source = nullptr;
+        }
+
+        delay.disconnect();
+        timeout.disconnect();
+    }
+};
+
+/** Split the options in square brackets at the start of an autostart command from the command itself. */
+static void parse_autostart_entry(autostart_entry_t& entry, const std::string& command)
+{
+    entry.command = command;
+    auto start = command.find_first_not_of(" \t");
+    if ((start == std::string::npos) || (command[start] != '['))
+    {
+        return;
+    }
+
+    auto end = command.find(']', start);
+    if (end == std::string::npos)
+    {
+        LOGE("Autostart entry ", entry.name, ": missing ] after the entry options");
+        return;
+    }
+
+    entry.command = command.substr(end + 1);
+    std::istringstream options{command.substr(start + 1, end - start - 1)};
+    std::string option;
+    while (options >> option)
+    {
+        auto eq = option.find('=');
+        auto key   = option.substr(0, eq);
+        auto value = (eq == std::string::npos) ? "" : option.substr(eq + 1);
+        if (key == "after")
+        {
+            std::istringstream names{value};
+            std::string name;
+            while (std::getline(names, name, ','))
+            {
+                if (!name.empty())
+                {
+                    entry.after.push_back(name);
+                }
+            }
+        } else if ((key == "ready") && ((value == "spawn") || (value == "exit") || (value == "mapped") ||
+                                        (value.rfind("dbus:", 0) == 0) || (value.rfind("delay:", 0) == 0)))
+        {
+            entry.ready = value;
+        } else
+        {
+            LOGE("Autostart entry ", entry.name, ": ignoring unknown option ", option);
+        }
+    }
+}
+
+/** @return Whether @pid is @ancestor or one of its descendants. */
+static bool is_descendant_of(pid_t pid, pid_t ancestor)
+{
+    // The parent pid is the fourth field of /proc/<pid>/stat, after the command in parentheses.
+    for (int depth = 0; (pid > 1) && (depth < 16); depth++)
+    {
+        if (pid == ancestor)
+        {
+            return true;
+        }
+
+        std::ifstream stat{"/proc/" + std::to_string(pid) + "/stat"};
+        std::string contents((std::istreambuf_iterator<char>(stat)), std::istreambuf_iterator<char>());
+        auto paren = contents.rfind(')');
+        if (paren == std::string::npos)
+        {
+            return false;
+        }
+
+        std::istringstream fields{contents.substr(paren + 1)};
+        std::string state;
+        fields >> state >> pid;
+    }
+
+    return false;
+}
 
 class wayfire_autostart : public wf::plugin_interface_t
 {
     wf::option_wrapper_t<bool> autostart_wf_shell{"autostart/autostart_wf_shell"};
+    wf::option_wrapper_t<int> ready_timeout{"autostart/ready_timeout"};
     wf::option_wrapper_t<wf::config::compound_list_t<std::string>>
     autostart_entries{"autostart/autostart"};
 
+    std::vector<std::unique_ptr<autostart_entry_t>> entries;
+
   public:
     void init() override
     {
         /* Run only once, at startup */
-        auto section = wf::get_core().config.get_section("autostart");
-
         bool panel_manually_started = false;
         bool background_manually_started = false;
 
@@ -23,38 +163,219 @@ class wayfire_autostart : public wf::plugin_interface_t
         {
             // Because we accept any option names, we should ignore regular
             // options
-            if (name == "autostart_wf_shell")
+            if ((name == "autostart_wf_shell") || (name == "ready_timeout"))
             {
                 continue;
             }
 
-            wf::get_core().run(command);
-            if (command.find("wf-panel") != std::string::npos)
+            auto entry = std::make_unique<autostart_entry_t>();
+            entry->name = name;
+            parse_autostart_entry(*entry, command);
+            if (entry->command.find("wf-panel") != std::string::npos)
             {
                 panel_manually_started = true;
             }
 
-            if (command.find("wf-background") != std::string::npos)
+            if (entry->command.find("wf-background") != std::string::npos)
             {
                 background_manually_started = true;
             }
+
+            entries.push_back(std::move(entry));
         }
 
         if (autostart_wf_shell && !panel_manually_started)
         {
-            wf::get_core().run("wf-panel");
+            add_entry("wf-panel", "wf-panel");
         }
 
         if (autostart_wf_shell && !background_manually_started)
         {
-            wf::get_core().run("wf-background");
+            add_entry("wf-background", "wf-background");
         }
+
+        check_dependencies();
+        wf::get_core().connect(&on_view_mapped);
+        start_entries();
     }
 
     bool is_unloadable() override
     {
         return false;
     }
+
+  private:
+    void add_entry(std::string name, std::string command)
+    {
+        auto entry = std::make_unique<autostart_entry_t>();
+        entry->name    = name;
+        entry->command = command;
+        entries.push_back(std::move(entry));
+    }
+
+    autostart_entry_t *find_entry(const std::string& name)
+    {
+        auto it = std::find_if(entries.begin(), entries.end(), [&] (auto& e) { return e->name == name; });
+        return (it == entries.end()) ? nullptr : it->get();
+    }
+
+    /** Drop dependencies on unknown entries, and the dependencies of entries which could never start. */
+    void check_dependencies()
+    {
+        for (auto& entry : entries)
+        {
+            auto& after = entry->after;
+            after.erase(std::remove_if(after.begin(), after.end(), [&] (const std::string& name)
+            {
+                if (!find_entry(name) || (name == entry->name))
+                {
+                    LOGE("Autostart entry ", entry->name, ": ignoring invalid dependency ", name);
+                    return true;
+                }
+
+                return false;
+            }), after.end());
+        }
+
+        // Entries which remain after repeatedly removing those whose dependencies can be resolved are part
+        // of a cycle (or depend on one).
+        std::vector<std::string> resolved;
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (auto& entry : entries)
+            {
+                if ((std::find(resolved.begin(), resolved.end(), entry->name) == resolved.end()) &&
+                    std::all_of(entry->after.begin(), entry->after.end(), [&] (const std::string& name)
+                {
+                    return std::find(resolved.begin(), resolved.end(), name) != resolved.end();
+                }))
+                {
+                    resolved.push_back(entry->name);
+                    changed = true;
+                }
+            }
+        }
+
+        for (auto& entry : entries)
+        {
+            if (std::find(resolved.begin(), resolved.end(), entry->name) == resolved.end())
+            {
+                LOGE("Autostart entry ", entry->name, " has cyclic dependencies, ignoring them");
+                entry->after.clear();
+            }
+        }
+    }
+
+    /** Start all entries whose dependencies are ready. */
+    void start_entries()
+    {
+        for (auto& entry : entries)
+        {
+            if (!entry->started && std::all_of(entry->after.begin(), entry->after.end(),
+                [&] (const std::string& name) { return find_entry(name)->is_ready; }))
+            {
+                start(*entry);
+            }
+        }
+    }
+
+    void start(autostart_entry_t& entry)
+    {
+        entry.started    = true;
+        entry.spawn_time = wf::get_current_time();
+        entry.pid = wf::get_core().run(entry.command);
+        LOGD("Autostart entry ", entry.name, " started with pid ", entry.pid);
+
+        if (entry.ready == "spawn")
+        {
+            set_ready(entry);
+            return;
+        }
+
+        if (ready_timeout > 0)
+        {
+            entry.timeout.set_timeout(ready_timeout, [this, &entry] ()
+            {
+                LOGW("Autostart entry ", entry.name, " did not become ready after ",
+                    (int)ready_timeout, " ms");
+                set_ready(entry);
+            });
+        }
+
+        if (entry.ready == "exit")
+        {
+            watch_exit(entry, entry.pid);
+        } else if (entry.ready.rfind("dbus:", 0) == 0)
+        {
+            watch_exit(entry, wf::get_core().run("gdbus wait --session '" + entry.ready.substr(5) + "'"));
+        } else if (entry.ready.rfind("delay:", 0) == 0)
+        {
+            int delay = std::max(0, std::atoi(entry.ready.c_str() + 6));
+            entry.delay.set_timeout(delay, [this, &entry] () { set_ready(entry); });
+        }
+    }
+
+    /** Make the entry ready when the process exits. */
+    void watch_exit(autostart_entry_t& entry, pid_t pid)
+    {
+        // The process is reaped by core, see compositor_core_t::run(), so a pidfd is used instead of
+        // waitpid(). Core watches the process with its own pidfd, so this one has to be opened before going
+        // back to the event loop: afterwards, the process may be reaped and its PID reused. The pidfd stays
+        // readable after the process is reaped, so the order of the two watchers does not matter.
+        int fd = -1;
+#ifdef SYS_pidfd_open
+        fd = (pid > 0) ? syscall(SYS_pidfd_open, pid, 0) : -1;
+#endif
+        if (fd < 0)
+        {
+            // Either the process is already gone, or pidfds are not supported.
+            set_ready(entry);
+            return;
+        }
+
+        entry.on_exit     = [this, &entry] () { set_ready(entry); };
+        entry.exit_source = wl_event_loop_add_fd(wf::get_core().ev_loop, fd, WL_EVENT_READABLE,
+            [] (int fd, uint32_t mask, void *data)
+        {
+            static_cast<autostart_entry_t*>(data)->on_exit();
+            return 0;
+        }, &entry);
+    }
+
+    void set_ready(autostart_entry_t& entry)
+    {
+        if (entry.is_ready)
+        {
+            return;
+        }
+
+        entry.stop_waiting();
+        entry.is_ready = true;
+        LOGI("Autostart entry ", entry.name, " ready after ",
+            wf::get_current_time() - entry.spawn_time, " ms");
+        start_entries();
+    }
+
+    wf::signal::connection_t<wf::view_mapped_signal> on_view_mapped = [=] (wf::view_mapped_signal *ev)
+    {
+        if (!ev->view->get_client())
+        {
+            return;
+        }
+
+        pid_t pid;
+        wl_client_get_credentials(ev->view->get_client(), &pid, 0, 0);
+        for (auto& entry : entries)
+        {
+            if (entry->started && !entry->is_ready && (entry->ready == "mapped") &&
+                is_descendant_of(pid, entry->pid))
+            {
+                set_ready(*entry);
+            }
+        }
+    };
 };
 
 DECLARE_WAYFIRE_PLUGIN(wayfire_autostart);
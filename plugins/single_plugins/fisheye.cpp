@@ -23,10 +23,13 @@
  */
 
 #include <wayfire/per-output-plugin.hpp>
+#include <wayfire/core.hpp>
 #include <wayfire/output.hpp>
 #include <wayfire/opengl.hpp>
 #include <wayfire/util/duration.hpp>
 #include <wayfire/render-manager.hpp>
+#include <wayfire/signal-definitions.hpp>
+#include <cmath>
 
 static const char *vertex_shader =
     R"(
@@ -129,8 +132,7 @@ class wayfire_fisheye : public wf::per_output_plugin_instance_t
         });
 
         OpenGL::render_begin();
-        program.set_simple(
-            OpenGL::compile_program(vertex_shader, fragment_shader));
+        program.compile_simple(vertex_shader, fragment_shader);
         OpenGL::render_end();
     }
 
@@ -152,23 +154,119 @@ class wayfire_fisheye : public wf::per_output_plugin_instance_t
             if (!hook_set)
             {
                 hook_set = true;
-                output->render->add_post(&render_hook);
-                output->render->set_redraw_always();
+                output->render->add_post(&render_hook, damage_map);
+                output->render->add_effect(&pre_hook, wf::OUTPUT_EFFECT_PRE);
+                wf::get_core().connect(&on_motion);
+                wf::get_core().connect(&on_absolute_motion);
             }
         }
 
+        output->render->schedule_redraw();
         return true;
     };
 
-    wf::post_hook_t render_hook = [=] (const wf::framebuffer_t& source,
-                                       const wf::framebuffer_t& dest)
+    /** The parameters of the lens, in framebuffer coordinates. */
+    struct lens_t
+    {
+        wf::pointf_t center;
+        float radius;
+        float zoom;
+
+        bool operator ==(const lens_t& other) const
+        {
+            return (center.x == other.center.x) && (center.y == other.center.y) &&
+                   (radius == other.radius) && (zoom == other.zoom);
+        }
+
+        /** @return The bounding box of the circle around the center, grown by @margin. */
+        wf::geometry_t get_box(float margin) const
+        {
+            const float r = radius + margin + 1;
+            const int x1  = std::floor(center.x - r), y1 = std::floor(center.y - r);
+            const int x2  = std::ceil(center.x + r), y2 = std::ceil(center.y + r);
+            return {x1, y1, x2 - x1, y2 - y1};
+        }
+
+        /** @return The part of the framebuffer which is distorted. */
+        wf::geometry_t get_distorted_box() const
+        {
+            return get_box(0);
+        }
+
+        /** @return The part of the framebuffer which the distorted part samples from. */
+        wf::geometry_t get_sampled_box() const
+        {
+            return get_box(std::abs((zoom - 1) * zoom));
+        }
+    };
+
+    lens_t last_lens = {{0, 0}, 0, 0};
+
+    lens_t get_lens()
     {
         auto oc     = output->get_cursor_position();
         wlr_box box = {(int)oc.x, (int)oc.y, 1, 1};
         box = output->render->get_target_framebuffer().
             framebuffer_box_from_geometry_box(box);
-        oc.x = box.x;
-        oc.y = box.y;
+        return {{(double)box.x, (double)box.y}, (float)(double)radius, (float)(double)progression};
+    }
+
+    /**
+     * Outside of the lens, the hook copies its source. Inside, it repaints the whole lens when the lens
+     * moved or changed, or when anything it samples from was damaged.
+     */
+    wf::post_hook_damage_t damage_map = [=] (const wf::region_t& damage)
+    {
+        auto lens = get_lens();
+        wf::region_t result = damage;
+        if (!(lens == last_lens))
+        {
+            result |= last_lens.get_distorted_box();
+            result |= lens.get_distorted_box();
+        } else if (!(damage & lens.get_sampled_box()).empty())
+        {
+            result |= lens.get_distorted_box();
+        }
+
+        last_lens = lens;
+        return result;
+    };
+
+    wf::effect_hook_t pre_hook = [=] ()
+    {
+        if (progression.running())
+        {
+            output->render->schedule_redraw();
+        }
+    };
+
+    void on_cursor_moved()
+    {
+        if (!(get_lens() == last_lens))
+        {
+            output->render->schedule_redraw();
+        }
+    }
+
+    wf::signal::connection_t<wf::post_input_event_signal<wlr_pointer_motion_event>> on_motion =
+        [=] (auto)
+    {
+        on_cursor_moved();
+    };
+
+    wf::signal::connection_t<wf::post_input_event_signal<wlr_pointer_motion_absolute_event>>
+    on_absolute_motion = [=] (auto)
+    {
+        on_cursor_moved();
+    };
+
+    wf::post_hook_t render_hook = [=] (const wf::framebuffer_t& source,
+                                       const wf::framebuffer_t& dest)
+    {
+        auto lens = get_lens();
+        const wf::region_t damage = output->render->get_post_hook_damage();
+        const wf::region_t distorted = damage & lens.get_distorted_box();
+        const wf::region_t copied    = damage ^ lens.get_distorted_box();
 
         static const float vertexData[] = {
             -1.0f, -1.0f,
@@ -178,18 +276,34 @@ class wayfire_fisheye : public wf::per_output_plugin_instance_t
         };
 
         OpenGL::render_begin(dest);
+
+        // Everything outside of the lens is copied unchanged.
+        auto w = dest.viewport_width;
+        auto h = dest.viewport_height;
+        GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER, source.fb));
+        for (auto& box : copied)
+        {
+            dest.scissor(wlr_box_from_pixman_box(box));
+            GL_CALL(glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST));
+        }
+
         program.use(wf::TEXTURE_TYPE_RGBA);
         GL_CALL(glBindTexture(GL_TEXTURE_2D, source.tex));
         GL_CALL(glActiveTexture(GL_TEXTURE0));
 
-        program.uniform2f("u_mouse", oc.x, oc.y);
+        program.uniform2f("u_mouse", lens.center.x, lens.center.y);
         program.uniform2f("u_resolution", dest.viewport_width, dest.viewport_height);
-        program.uniform1f("u_radius", radius);
-        program.uniform1f("u_zoom", progression);
+        program.uniform1f("u_radius", lens.radius);
+        program.uniform1f("u_zoom", lens.zoom);
 
         program.attrib_pointer("position", 2, 0, vertexData);
 
-        GL_CALL(glDrawArrays(GL_TRIANGLE_FAN, 0, 4));
+        for (auto& box : distorted)
+        {
+            dest.scissor(wlr_box_from_pixman_box(box));
+            GL_CALL(glDrawArrays(GL_TRIANGLE_FAN, 0, 4));
+        }
+
         GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
 
         program.deactivate();
@@ -204,8 +318,11 @@ class wayfire_fisheye : public wf::per_output_plugin_instance_t
     void finalize()
     {
         output->render->rem_post(&render_hook);
-        output->render->set_redraw_always(false);
-        hook_set = false;
+        output->render->rem_effect(&pre_hook);
+        on_motion.disconnect();
+        on_absolute_motion.disconnect();
+        last_lens = {{0, 0}, 0, 0};
+        hook_set  = false;
     }
 
     void fini() override
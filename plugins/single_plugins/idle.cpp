@@ -9,6 +9,7 @@
 #include "wayfire/seat.hpp"
 #include "../cube/cube-control-signal.hpp"
 
+#include <algorithm>
 #include <cmath>
 #include <optional>
 #include <wayfire/util/duration.hpp>
@@ -115,6 +116,8 @@ class wayfire_idle_plugin : public wf::per_output_plugin_instance_t
     wf::option_wrapper_t<int> screensaver_timeout{"idle/screensaver_timeout"};
     wf::option_wrapper_t<double> cube_rotate_speed{"idle/cube_rotate_speed"};
     wf::option_wrapper_t<double> cube_max_zoom{"idle/cube_max_zoom"};
+    wf::option_wrapper_t<bool> screensaver_cache_workspaces{"idle/screensaver_cache_workspaces"};
+    wf::option_wrapper_t<int> screensaver_max_fps{"idle/screensaver_max_fps"};
     wf::option_wrapper_t<bool> disable_on_fullscreen{"idle/disable_on_fullscreen"};
     wf::option_wrapper_t<bool> disable_initially{"idle/disable_initially"};
 
@@ -126,6 +129,8 @@ class wayfire_idle_plugin : public wf::per_output_plugin_instance_t
     bool output_inhibited = false;
     uint32_t last_time;
     wf::wl_timer<false> timeout_screensaver;
+    /* Schedules the frames of the screensaver if its frame rate is limited */
+    wf::wl_timer<true> screensaver_frame_timer;
     wf::signal::connection_t<wf::seat_activity_signal> on_seat_activity;
     wf::shared_data::ref_ptr_t<wayfire_idle> global_idle;
 
@@ -268,6 +273,7 @@ class wayfire_idle_plugin : public wf::per_output_plugin_instance_t
             return;
         }
 
+        screensaver_frame_timer.disconnect();
         if (hook_set)
         {
             output->render->rem_effect(&screensaver_frame);
@@ -275,6 +281,7 @@ class wayfire_idle_plugin : public wf::per_output_plugin_instance_t
         }
 
         output->render->add_inhibit(true);
+        output->render->set_blanked(true);
         output->render->damage_whole();
         state = CUBE_SCREENSAVER_DISABLED;
         output_inhibited = true;
@@ -287,6 +294,7 @@ class wayfire_idle_plugin : public wf::per_output_plugin_instance_t
             return;
         }
 
+        output->render->set_blanked(false);
         output->render->add_inhibit(false);
         output->render->damage_whole();
         output_inhibited = false;
@@ -302,6 +310,7 @@ class wayfire_idle_plugin : public wf::per_output_plugin_instance_t
         data.carried_out = false;
 
         output->emit(&data);
+        screensaver_frame_timer.disconnect();
         if (hook_set)
         {
             output->render->rem_effect(&screensaver_frame);
@@ -349,6 +358,11 @@ class wayfire_idle_plugin : public wf::per_output_plugin_instance_t
         data.ease  = screensaver_animation.ease;
         data.last_frame  = false;
         data.carried_out = false;
+        // The workspaces are shown as they were when the screensaver started, and the animation back
+        // to the desktop runs at the full frame rate, so that it is smooth.
+        data.cached_workspaces = screensaver_cache_workspaces && (state == CUBE_SCREENSAVER_RUNNING);
+        data.external_frames   = screensaver_frame_timer.is_connected() &&
+            (state == CUBE_SCREENSAVER_RUNNING);
 
         output->emit(&data);
         if (!data.carried_out)
@@ -390,6 +404,14 @@ class wayfire_idle_plugin : public wf::per_output_plugin_instance_t
         }
 
         state = CUBE_SCREENSAVER_RUNNING;
+        if (screensaver_max_fps > 0)
+        {
+            screensaver_frame_timer.set_timeout(std::max(1000 / screensaver_max_fps, 1), [=] ()
+            {
+                output->render->schedule_redraw();
+                return true;
+            });
+        }
 
         rotation = 0.0;
         screensaver_animation.zoom.set(CUBE_ZOOM_BASE, cube_max_zoom);
@@ -408,6 +430,7 @@ class wayfire_idle_plugin : public wf::per_output_plugin_instance_t
         }
 
         state = CUBE_SCREENSAVER_STOPPING;
+        screensaver_frame_timer.disconnect();
 
         double end = rotation > M_PI ? M_PI * 2 : 0.0;
         screensaver_animation.rot.set(rotation, end);
@@ -421,7 +444,9 @@ class wayfire_idle_plugin : public wf::per_output_plugin_instance_t
         wf::get_core().disconnect(&on_seat_activity);
         wf::get_core().disconnect(&inhibit_changed);
         timeout_screensaver.disconnect();
+        screensaver_frame_timer.disconnect();
         output->rem_binding(&toggle);
+        uninhibit_output();
     }
 };
 
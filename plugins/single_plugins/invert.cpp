@@ -45,6 +45,8 @@ void main()
 class wayfire_invert_screen : public wf::per_output_plugin_instance_t
 {
     wf::post_hook_t hook;
+    // Without preserve_hue, inverting is a plain color transform.
+    wf::color_transform_t transform;
     wf::activator_callback toggle_cb;
     wf::option_wrapper_t<bool> preserve_hue{"invert/preserve_hue"};
 
@@ -74,27 +76,50 @@ class wayfire_invert_screen : public wf::per_output_plugin_instance_t
                 return false;
             }
 
+            active ? deactivate() : activate();
+            return true;
+        };
+
+        preserve_hue.set_callback([=] ()
+        {
             if (active)
             {
-                output->render->rem_post(&hook);
-            } else
-            {
-                output->render->add_post(&hook);
+                deactivate();
+                activate();
             }
+        });
 
-            active = !active;
-
-            return true;
-        };
+        transform.matrix = glm::mat4(-1.0);
+        transform.matrix[3] = glm::vec4(1.0);
 
         OpenGL::render_begin();
-        program.set_simple(
-            OpenGL::compile_program(vertex_shader, fragment_shader));
+        program.compile_simple(vertex_shader, fragment_shader);
         OpenGL::render_end();
 
         output->add_activator(toggle_key, &toggle_cb);
     }
 
+    void activate()
+    {
+        if (preserve_hue)
+        {
+            // Every pixel depends only on the same pixel of the source.
+            output->render->add_post(&hook, [] (const wf::region_t& damage) { return damage; });
+        } else
+        {
+            output->render->add_color_transform(&transform);
+        }
+
+        active = true;
+    }
+
+    void deactivate()
+    {
+        output->render->rem_post(&hook);
+        output->render->rem_color_transform(&transform);
+        active = false;
+    }
+
     void render(const wf::framebuffer_t& source,
         const wf::framebuffer_t& destination)
     {
@@ -123,7 +148,12 @@ class wayfire_invert_screen : public wf::per_output_plugin_instance_t
         program.uniform1i("preserve_hue", preserve_hue);
 
         GL_CALL(glDisable(GL_BLEND));
-        GL_CALL(glDrawArrays(GL_TRIANGLE_FAN, 0, 4));
+        for (auto& box : output->render->get_post_hook_damage())
+        {
+            destination.scissor(wlr_box_from_pixman_box(box));
+            GL_CALL(glDrawArrays(GL_TRIANGLE_FAN, 0, 4));
+        }
+
         GL_CALL(glEnable(GL_BLEND));
         GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
 
@@ -135,7 +165,7 @@ class wayfire_invert_screen : public wf::per_output_plugin_instance_t
     {
         if (active)
         {
-            output->render->rem_post(&hook);
+            deactivate();
         }
 
         OpenGL::render_begin();
@@ -1,4 +1,6 @@
 #include <wayfire/plugin.hpp>
+#include <wayfire/opengl.hpp>
+#include <wayfire/scene-render.hpp>
 #include <wayfire/per-output-plugin.hpp>
 #include <wayfire/view.hpp>
 #include <wayfire/output.hpp>
@@ -6,10 +8,21 @@
 #include <wayfire/seat.hpp>
 #include <wayfire/input-device.hpp>
 #include <set>
+#include <map>
+#include <algorithm>
+#include <deque>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <chrono>
+#include <fstream>
+#include <optional>
 
 #include "plugins/ipc/ipc-helpers.hpp"
 #include "plugins/ipc/ipc-method-repository.hpp"
 #include "wayfire/core.hpp"
+#include "wayfire/render-manager.hpp"
 #include "wayfire/plugins/common/util.hpp"
 #include "wayfire/unstable/wlr-surface-node.hpp"
 #include "wayfire/plugins/common/shared-core-data.hpp"
@@ -17,10 +30,17 @@
 #include "wayfire/signal-provider.hpp"
 #include "wayfire/view-helpers.hpp"
 #include "wayfire/window-manager.hpp"
+#include "wayfire/thread-pool.hpp"
 #include "wayfire/workarea.hpp"
 #include "config.h"
+#include "../wm-actions/wm-actions-signals.hpp"
 #include <wayfire/debug.hpp>
 #include <wayfire/nonstd/wlroots-full.hpp>
+#include <wayfire/trace.hpp>
+#include <wayfire/plugin-stats.hpp>
+#include <wayfire/gpu-memory.hpp>
+#include <wayfire/view-transform.hpp>
+#include <wayfire/txn/transaction-manager.hpp>
 
 
 static std::string role_to_string(enum wf::view_role_t role)
@@ -127,6 +147,298 @@ static wf::geometry_t get_view_base_geometry(wayfire_view view)
     return sroot->get_bounding_box();
 }
 
+/**
+ * Assigns a sequence number to every change of the view list, so that clients can ask for the views which
+ * changed since the last time they asked (window-rules/list-views-since) instead of diffing full lists.
+ *
+ * Views are marked as modified on the signals which change the state reported by view_to_json(). Views
+ * which appear or disappear without a signal (e.g. unmapped views being destroyed) are found by comparing
+ * the ids with the current view list when a client asks.
+ */
+class view_change_tracker_t
+{
+  public:
+    /** The number of removed views which are remembered, older removals make clients start over. */
+    static constexpr size_t MAX_REMOVED_VIEWS = 1024;
+
+    view_change_tracker_t()
+    {
+        wf::get_core().connect(&on_mapped);
+        wf::get_core().connect(&on_unmapped);
+        wf::get_core().connect(&on_geometry_changed);
+        wf::get_core().connect(&on_tiled);
+        wf::get_core().connect(&on_fullscreen);
+        wf::get_core().connect(&on_set_output);
+        wf::get_core().connect(&on_moved_to_wset);
+        wf::get_core().connect(&on_title_changed);
+        wf::get_core().connect(&on_app_id_changed);
+        wf::get_core().connect(&on_focus_changed);
+    }
+
+    void track_output(wf::output_t *output)
+    {
+        // These are not emitted on core.
+        output->connect(&on_minimized);
+        output->connect(&on_sticky);
+        output->connect(&on_workspace_changed);
+    }
+
+    struct changes_t
+    {
+        uint64_t sequence;
+        // The client has to drop its state and use @changed as the full list of views.
+        bool reset;
+        std::vector<wayfire_view> changed;
+        std::vector<uint32_t> removed;
+    };
+
+    /** Get the views which were added, modified or removed after the given sequence number. */
+    changes_t get_changes_since(uint64_t since)
+    {
+        sync_views();
+        changes_t changes;
+        changes.sequence = sequence;
+        changes.reset    = (since < removed_horizon);
+        for (auto& view : wf::get_core().get_all_views())
+        {
+            if (changes.reset || (modified[view->get_id()] > since))
+            {
+                changes.changed.push_back(view);
+            }
+        }
+
+        for (auto& [id, seq] : removed)
+        {
+            if (!changes.reset && (seq > since))
+            {
+                changes.removed.push_back(id);
+            }
+        }
+
+        return changes;
+    }
+
+  private:
+    uint64_t sequence = 0;
+    // The sequence number of the last change of each view
+    std::unordered_map<uint32_t, uint64_t> modified;
+    // The sequence number of the removal of views, oldest first
+    std::deque<std::pair<uint32_t, uint64_t>> removed;
+    // Removals up to this sequence number have been forgotten
+    uint64_t removed_horizon = 0;
+    // The id of the focused view, which may be destroyed before the focus changes again
+    std::optional<uint32_t> last_focus;
+
+    void mark(wayfire_view view)
+    {
+        if (view)
+        {
+            modified[view->get_id()] = ++sequence;
+        }
+    }
+
+    void sync_views()
+    {
+        std::unordered_map<uint32_t, uint64_t> current;
+        for (auto& view : wf::get_core().get_all_views())
+        {
+            auto it = modified.find(view->get_id());
+            current[view->get_id()] = (it != modified.end()) ? it->second : ++sequence;
+        }
+
+        for (auto& [id, _] : modified)
+        {
+            if (!current.count(id))
+            {
+                removed.push_back({id, ++sequence});
+            }
+        }
+
+        while (removed.size() > MAX_REMOVED_VIEWS)
+        {
+            removed_horizon = removed.front().second;
+            removed.pop_front();
+        }
+
+        modified = std::move(current);
+    }
+
+    wf::signal::connection_t<wf::view_mapped_signal> on_mapped = [=] (wf::view_mapped_signal *ev)
+    {
+        mark(ev->view);
+    };
+
+    wf::signal::connection_t<wf::view_unmapped_signal> on_unmapped = [=] (wf::view_unmapped_signal *ev)
+    {
+        mark(ev->view);
+    };
+
+    wf::signal::connection_t<wf::view_geometry_changed_signal> on_geometry_changed =
+        [=] (wf::view_geometry_changed_signal *ev) { mark(ev->view); };
+    wf::signal::connection_t<wf::view_tiled_signal> on_tiled =
+        [=] (wf::view_tiled_signal *ev) { mark(ev->view); };
+    wf::signal::connection_t<wf::view_fullscreen_signal> on_fullscreen =
+        [=] (wf::view_fullscreen_signal *ev) { mark(ev->view); };
+    wf::signal::connection_t<wf::view_set_output_signal> on_set_output =
+        [=] (wf::view_set_output_signal *ev) { mark(ev->view); };
+    wf::signal::connection_t<wf::view_moved_to_wset_signal> on_moved_to_wset =
+        [=] (wf::view_moved_to_wset_signal *ev) { mark(ev->view); };
+    wf::signal::connection_t<wf::view_title_changed_signal> on_title_changed =
+        [=] (wf::view_title_changed_signal *ev) { mark(ev->view); };
+    wf::signal::connection_t<wf::view_app_id_changed_signal> on_app_id_changed =
+        [=] (wf::view_app_id_changed_signal *ev) { mark(ev->view); };
+    wf::signal::connection_t<wf::view_minimized_signal> on_minimized =
+        [=] (wf::view_minimized_signal *ev) { mark(ev->view); };
+    wf::signal::connection_t<wf::view_set_sticky_signal> on_sticky =
+        [=] (wf::view_set_sticky_signal *ev) { mark(ev->view); };
+    wf::signal::connection_t<wf::view_change_workspace_signal> on_workspace_changed =
+        [=] (wf::view_change_workspace_signal *ev) { mark(ev->view); };
+
+    wf::signal::connection_t<wf::keyboard_focus_changed_signal> on_focus_changed =
+        [=] (wf::keyboard_focus_changed_signal *ev)
+    {
+        // The focus timestamp and the activated state of both views change.
+        if (last_focus && modified.count(*last_focus))
+        {
+            modified[*last_focus] = ++sequence;
+        }
+
+        auto view = wf::node_to_view(ev->new_focus);
+        mark(view);
+        last_focus = view ? std::optional<uint32_t>{view->get_id()} : std::nullopt;
+    };
+};
+
+/**
+ * The serialized form of each view, as returned by view_to_json(). The fields are grouped by the signals
+ * which change them, and only the groups which were marked as dirty since the last call are formatted again.
+ * Fields which may change without a signal (bounding box, layer, size hints, ...) are not cached, and
+ * neither is the pending state of toplevels (geometry, tiled edges and fullscreen), because the signals are
+ * emitted only when it is applied. The base geometry is cached only for toplevels.
+ */
+class view_json_cache_t
+{
+  public:
+    enum field_group_t : uint32_t
+    {
+        // id, pid and role
+        FIELDS_IDENTITY = (1 << 0),
+        FIELDS_TITLE    = (1 << 1),
+        FIELDS_APP_ID   = (1 << 2),
+        // base-geometry of toplevels
+        FIELDS_GEOMETRY = (1 << 3),
+        // output-id and output-name
+        FIELDS_OUTPUT   = (1 << 4),
+        FIELDS_WSET     = (1 << 5),
+        // minimized and sticky
+        FIELDS_STATE    = (1 << 6),
+        FIELDS_ALL      = (1 << 7) - 1,
+    };
+
+    struct entry_t
+    {
+        uint32_t dirty = FIELDS_ALL;
+        nlohmann::json json;
+    };
+
+    view_json_cache_t()
+    {
+        wf::get_core().connect(&on_mapped);
+        wf::get_core().connect(&on_unmapped);
+        wf::get_core().connect(&on_geometry_changed);
+        wf::get_core().connect(&on_tiled);
+        wf::get_core().connect(&on_fullscreen);
+        wf::get_core().connect(&on_set_output);
+        wf::get_core().connect(&on_moved_to_wset);
+        wf::get_core().connect(&on_title_changed);
+        wf::get_core().connect(&on_app_id_changed);
+    }
+
+    void track_output(wf::output_t *output)
+    {
+        // These are not emitted on core.
+        output->connect(&on_minimized);
+        output->connect(&on_sticky);
+        output->connect(&on_workspace_changed);
+    }
+
+    /** Get the entry of @view. The caller formats the dirty groups and clears the dirty flags. */
+    entry_t& get(wayfire_view view)
+    {
+        if (entries.size() >= prune_threshold)
+        {
+            prune();
+        }
+
+        return entries[view->get_id()];
+    }
+
+  private:
+    std::unordered_map<uint32_t, entry_t> entries;
+    size_t prune_threshold = MIN_PRUNE_THRESHOLD;
+    static constexpr size_t MIN_PRUNE_THRESHOLD = 64;
+
+    /** Drop the entries of destroyed views. */
+    void prune()
+    {
+        auto& views = wf::tracking_allocator_t<wf::view_interface_t>::get();
+        for (auto it = entries.begin(); it != entries.end();)
+        {
+            it = views.find_by_id(it->first) ? std::next(it) : entries.erase(it);
+        }
+
+        prune_threshold = std::max(MIN_PRUNE_THRESHOLD, 2 * entries.size());
+    }
+
+    void mark(wayfire_view view, uint32_t groups)
+    {
+        if (!view)
+        {
+            return;
+        }
+
+        auto it = entries.find(view->get_id());
+        if (it != entries.end())
+        {
+            it->second.dirty |= groups;
+        }
+    }
+
+    wf::signal::connection_t<wf::view_mapped_signal> on_mapped = [=] (wf::view_mapped_signal *ev)
+    {
+        mark(ev->view, FIELDS_ALL);
+    };
+
+    wf::signal::connection_t<wf::view_unmapped_signal> on_unmapped = [=] (wf::view_unmapped_signal *ev)
+    {
+        mark(ev->view, FIELDS_ALL);
+    };
+
+    wf::signal::connection_t<wf::view_geometry_changed_signal> on_geometry_changed =
+        [=] (wf::view_geometry_changed_signal *ev) { mark(ev->view, FIELDS_GEOMETRY); };
+    wf::signal::connection_t<wf::view_tiled_signal> on_tiled =
+        [=] (wf::view_tiled_signal *ev) { mark(ev->view, FIELDS_GEOMETRY); };
+    wf::signal::connection_t<wf::view_fullscreen_signal> on_fullscreen =
+        [=] (wf::view_fullscreen_signal *ev) { mark(ev->view, FIELDS_GEOMETRY); };
+    wf::signal::connection_t<wf::view_set_output_signal> on_set_output =
+        [=] (wf::view_set_output_signal *ev) { mark(ev->view, FIELDS_OUTPUT | FIELDS_GEOMETRY); };
+    wf::signal::connection_t<wf::view_moved_to_wset_signal> on_moved_to_wset =
+        [=] (wf::view_moved_to_wset_signal *ev)
+    {
+        mark(ev->view, FIELDS_WSET | FIELDS_OUTPUT | FIELDS_GEOMETRY);
+    };
+    wf::signal::connection_t<wf::view_title_changed_signal> on_title_changed =
+        [=] (wf::view_title_changed_signal *ev) { mark(ev->view, FIELDS_TITLE); };
+    wf::signal::connection_t<wf::view_app_id_changed_signal> on_app_id_changed =
+        [=] (wf::view_app_id_changed_signal *ev) { mark(ev->view, FIELDS_APP_ID); };
+    wf::signal::connection_t<wf::view_minimized_signal> on_minimized =
+        [=] (wf::view_minimized_signal *ev) { mark(ev->view, FIELDS_STATE); };
+    wf::signal::connection_t<wf::view_set_sticky_signal> on_sticky =
+        [=] (wf::view_set_sticky_signal *ev) { mark(ev->view, FIELDS_STATE); };
+    wf::signal::connection_t<wf::view_change_workspace_signal> on_workspace_changed =
+        [=] (wf::view_change_workspace_signal *ev) { mark(ev->view, FIELDS_GEOMETRY); };
+};
+
 class ipc_rules_t : public wf::plugin_interface_t, public wf::per_output_tracker_mixin_t<>
 {
   public:
@@ -137,6 +449,7 @@ class ipc_rules_t : public wf::plugin_interface_t, public wf::per_output_tracker
         method_repository->register_method("input/configure-device", configure_input_device);
         method_repository->register_method("window-rules/events/watch", on_client_watch);
         method_repository->register_method("window-rules/list-views", list_views);
+        method_repository->register_method("window-rules/list-views-since", list_views_since);
         method_repository->register_method("window-rules/list-outputs", list_outputs);
         method_repository->register_method("window-rules/list-wsets", list_wsets);
         method_repository->register_method("window-rules/view-info", get_view_info);
@@ -147,6 +460,26 @@ class ipc_rules_t : public wf::plugin_interface_t, public wf::per_output_tracker
         method_repository->register_method("window-rules/get-focused-view", get_focused_view);
         method_repository->register_method("window-rules/get-focused-output", get_focused_output);
         method_repository->register_method("window-rules/close-view", close_view);
+        method_repository->register_method("window-rules/capture-view", capture_view);
+        method_repository->register_method("window-rules/capture-output", capture_output);
+        method_repository->register_method("render/frame-stats", get_frame_stats);
+        method_repository->register_method("render/framebuffer-pool", get_framebuffer_pool);
+        method_repository->register_method("render/gpu-memory", get_gpu_memory);
+        method_repository->register_method("render/set-tearing", set_tearing);
+        method_repository->register_method("render/input-latency", get_input_latency);
+        method_repository->register_method("render/scanout-stats", get_scanout_stats);
+        method_repository->register_method("render/cursor-state", get_cursor_state);
+        method_repository->register_method("render/repaint-sources", get_repaint_sources);
+        method_repository->register_method("wayfire/trace-start", trace_start);
+        method_repository->register_method("wayfire/trace-stop", trace_stop);
+        method_repository->register_method("wayfire/trace-dump", trace_dump);
+        method_repository->register_method("wayfire/plugin-stats", get_plugin_stats);
+        method_repository->register_method("wayfire/signal-stats", get_signal_stats);
+        method_repository->register_method("wayfire/scene", get_scene);
+        method_repository->register_method("wayfire/transaction-stats", get_transaction_stats);
+        method_repository->register_method("wayfire/list-transactions", list_transactions);
+        method_repository->register_method("wayfire/thread-pool", get_thread_pool_stats);
+        method_repository->register_method("wayfire/trim-memory", trim_memory);
         method_repository->connect(&on_client_disconnected);
         init_output_tracking();
     }
@@ -158,6 +491,7 @@ class ipc_rules_t : public wf::plugin_interface_t, public wf::per_output_tracker
         method_repository->unregister_method("input/configure-device");
         method_repository->unregister_method("window-rules/events/watch");
         method_repository->unregister_method("window-rules/list-views");
+        method_repository->unregister_method("window-rules/list-views-since");
         method_repository->unregister_method("window-rules/list-outputs");
         method_repository->unregister_method("window-rules/list-wsets");
         method_repository->unregister_method("window-rules/view-info");
@@ -168,11 +502,33 @@ class ipc_rules_t : public wf::plugin_interface_t, public wf::per_output_tracker
         method_repository->unregister_method("window-rules/get-focused-view");
         method_repository->unregister_method("window-rules/get-focused-output");
         method_repository->unregister_method("window-rules/close-view");
+        method_repository->unregister_method("window-rules/capture-view");
+        method_repository->unregister_method("window-rules/capture-output");
+        method_repository->unregister_method("render/frame-stats");
+        method_repository->unregister_method("render/framebuffer-pool");
+        method_repository->unregister_method("render/gpu-memory");
+        method_repository->unregister_method("render/set-tearing");
+        method_repository->unregister_method("render/input-latency");
+        method_repository->unregister_method("render/scanout-stats");
+        method_repository->unregister_method("render/cursor-state");
+        method_repository->unregister_method("render/repaint-sources");
+        method_repository->unregister_method("wayfire/trace-start");
+        method_repository->unregister_method("wayfire/trace-stop");
+        method_repository->unregister_method("wayfire/trace-dump");
+        method_repository->unregister_method("wayfire/plugin-stats");
+        method_repository->unregister_method("wayfire/signal-stats");
+        method_repository->unregister_method("wayfire/scene");
+        method_repository->unregister_method("wayfire/transaction-stats");
+        method_repository->unregister_method("wayfire/list-transactions");
+        method_repository->unregister_method("wayfire/thread-pool");
+        method_repository->unregister_method("wayfire/trim-memory");
         fini_output_tracking();
     }
 
     void handle_new_output(wf::output_t *output) override
     {
+        view_changes.track_output(output);
+        view_cache.track_output(output);
         for (auto& [_, event] : signal_map)
         {
             if (event.connected_count)
@@ -270,6 +626,7 @@ class ipc_rules_t : public wf::plugin_interface_t, public wf::per_output_tracker
         {"view-workspace-changed", get_generic_output_registration_cb(&_view_workspace)},
         {"output-wset-changed", get_generic_output_registration_cb(&on_wset_changed)},
         {"wset-workspace-changed", get_generic_output_registration_cb(&on_wset_workspace_changed)},
+        {"output-showdesktop-changed", get_generic_output_registration_cb(&on_showdesktop_changed)},
     };
 
     wf::ipc::method_callback get_wayfire_configuration_info = [=] (nlohmann::json)
@@ -299,6 +656,164 @@ class ipc_rules_t : public wf::plugin_interface_t, public wf::per_output_tracker
         return response;
     };
 
+    wf::ipc::method_callback list_views_since = [=] (nlohmann::json data)
+    {
+        WFJSON_OPTIONAL_FIELD(data, "since", number_unsigned);
+        WFJSON_OPTIONAL_FIELD(data, "fields", array);
+        std::set<std::string> fields;
+        if (data.contains("fields"))
+        {
+            for (auto& field : data["fields"])
+            {
+                if (!field.is_string())
+                {
+                    return wf::ipc::json_error("Field list contains non-string entries!");
+                }
+
+                fields.insert((std::string)field);
+            }
+        }
+
+        auto changes  = view_changes.get_changes_since(data.value("since", (uint64_t)0));
+        auto response = wf::ipc::json_ok();
+        response["sequence"] = changes.sequence;
+        response["reset"]    = changes.reset;
+        response["views"]    = nlohmann::json::array();
+        response["removed"]  = changes.removed;
+        for (auto& view : changes.changed)
+        {
+            nlohmann::json v = view_to_json(view);
+            if (!fields.empty())
+            {
+                // The id is always needed to match the views with the earlier results.
+                nlohmann::json subset;
+                subset["id"] = v["id"];
+                for (auto& field : fields)
+                {
+                    if (v.contains(field))
+                    {
+                        subset[field] = std::move(v[field]);
+                    }
+                }
+
+                v = std::move(subset);
+            }
+
+            response["views"].push_back(std::move(v));
+        }
+
+        return response;
+    };
+
+    /**
+     * Render the node into a sealed memfd which is passed to the client together with the response.
+     *
+     * The pixels are read back from the GPU once, directly into the shared memory, and are not encoded, so
+     * this is much cheaper than saving a screenshot to a file.
+     */
+    static nlohmann::json capture_to_memfd(wf::scene::node_ptr root, wf::geometry_t box,
+        wf::output_t *output, wf::ipc::client_interface_t *client)
+    {
+        if (!client)
+        {
+            return wf::ipc::json_error("captures can only be requested through the IPC socket");
+        }
+
+        const float scale = output->handle->scale;
+        wf::render_target_t target;
+        OpenGL::render_begin();
+        target.allocate(box.width * scale, box.height * scale);
+        OpenGL::render_end();
+        target.geometry = box;
+        target.scale    = scale;
+
+        std::vector<wf::scene::render_instance_uptr> instances;
+        root->gen_render_instances(instances, [] (auto) {}, output);
+
+        wf::scene::render_pass_params_t params;
+        params.background_color = {0, 0, 0, 0};
+        params.damage    = box;
+        params.target    = target;
+        params.instances = &instances;
+        wf::scene::run_render_pass(params, wf::scene::RPASS_CLEAR_BACKGROUND);
+
+        const int width     = target.viewport_width;
+        const int height    = target.viewport_height;
+        const size_t stride = width * 4;
+        const size_t size   = stride * height;
+
+        int fd       = memfd_create("wayfire-capture", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        void *pixels = MAP_FAILED;
+        if ((fd >= 0) && (ftruncate(fd, size) == 0))
+        {
+            pixels = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+
+        OpenGL::render_begin();
+        if (pixels != MAP_FAILED)
+        {
+            GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER, target.fb));
+            GL_CALL(glPixelStorei(GL_PACK_ALIGNMENT, 4));
+            GL_CALL(glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels));
+        }
+
+        target.release();
+        OpenGL::render_end();
+
+        if (pixels == MAP_FAILED)
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+
+            return wf::ipc::json_error("failed to allocate the capture buffer");
+        }
+
+        munmap(pixels, size);
+        // The client may map the buffer without fear that it changes size or contents.
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+        if (!client->send_fd(fd))
+        {
+            return wf::ipc::json_error("the client cannot receive file descriptors");
+        }
+
+        auto response = wf::ipc::json_ok();
+        response["format"] = "ABGR8888";
+        response["width"]  = width;
+        response["height"] = height;
+        response["stride"] = stride;
+        response["size"]   = size;
+        return response;
+    }
+
+    wf::ipc::method_callback_full capture_view =
+        [=] (nlohmann::json data, wf::ipc::client_interface_t *client)
+    {
+        WFJSON_EXPECT_FIELD(data, "id", number_integer);
+        auto view = wf::ipc::find_view_by_id(data["id"]);
+        if (!view || !view->get_output())
+        {
+            return wf::ipc::json_error("no such view");
+        }
+
+        auto root = view->get_surface_root_node();
+        return capture_to_memfd(root, root->get_bounding_box(), view->get_output(), client);
+    };
+
+    wf::ipc::method_callback_full capture_output =
+        [=] (nlohmann::json data, wf::ipc::client_interface_t *client)
+    {
+        WFJSON_EXPECT_FIELD(data, "id", number_integer);
+        auto output = wf::ipc::find_output_by_id(data["id"]);
+        if (!output)
+        {
+            return wf::ipc::json_error("no such output");
+        }
+
+        return capture_to_memfd(wf::get_core().scene(), output->get_layout_geometry(), output, client);
+    };
+
     wf::ipc::method_callback get_view_info = [=] (nlohmann::json data)
     {
         WFJSON_EXPECT_FIELD(data, "id", number_integer);
@@ -513,61 +1028,758 @@ class ipc_rules_t : public wf::plugin_interface_t, public wf::per_output_tracker
         return response;
     };
 
-  private:
-    wf::shared_data::ref_ptr_t<wf::ipc::method_repository_t> method_repository;
+    nlohmann::json phase_stats_to_json(const wf::frame_phase_stats_t& phase)
+    {
+        nlohmann::json p;
+        p["samples"]   = phase.samples;
+        p["min"]       = phase.min;
+        p["max"]       = phase.max;
+        p["avg"]       = phase.avg;
+        p["p50"]       = phase.p50;
+        p["p90"]       = phase.p90;
+        p["p99"]       = phase.p99;
+        p["histogram"] = phase.histogram;
+        return p;
+    }
 
-    // Track a list of clients which have requested watch
-    std::map<wf::ipc::client_interface_t*, std::set<std::string>> clients;
+    nlohmann::json frame_stats_to_json(wf::output_t *o)
+    {
+        static const char *phase_names[wf::FRAME_PHASE_COUNT] = {
+            "damage", "schedule", "clear", "render", "postprocess", "swap", "total"
+        };
 
-    wf::ipc::method_callback_full on_client_watch =
-        [=] (nlohmann::json data, wf::ipc::client_interface_t *client)
+        auto stats = o->render->get_frame_stats();
+        nlohmann::json response;
+        response["id"]   = o->get_id();
+        response["name"] = o->to_string();
+        response["rendered-frames"] = stats.rendered_frames;
+        response["scanout-frames"]  = stats.scanout_frames;
+        response["idle-frames"]     = stats.idle_frames;
+        for (int i = 0; i < wf::FRAME_PHASE_COUNT; i++)
+        {
+            response["phases"][phase_names[i]] = phase_stats_to_json(stats.phases[i]);
+        }
+
+        return response;
+    }
+
+    nlohmann::json input_latency_to_json(wf::output_t *o)
     {
-        static constexpr const char *EVENTS = "events";
-        WFJSON_OPTIONAL_FIELD(data, EVENTS, array);
-        std::set<std::string> subscribed_to;
-        if (data.contains(EVENTS))
+        auto stats = o->render->get_input_latency_stats();
+        nlohmann::json response;
+        response["id"]   = o->get_id();
+        response["name"] = o->to_string();
+        response["input-to-commit"]   = phase_stats_to_json(stats.input_to_commit);
+        response["commit-to-present"] = phase_stats_to_json(stats.commit_to_present);
+        response["input-to-present"]  = phase_stats_to_json(stats.input_to_present);
+        return response;
+    }
+
+    nlohmann::json scanout_stats_to_json(wf::output_t *o)
+    {
+        static const char *blocker_names[wf::SCANOUT_BLOCKER_COUNT] = {
+            "none", "disabled", "commit-pending", "inhibited", "effect-hook", "post-processing", "gamma",
+            "output-layers", "backend", "no-surface", "occluded", "surface-geometry", "surface-transform",
+            "surface-opacity", "buffer-rejected"
+        };
+
+        auto stats = o->render->get_scanout_stats();
+        nlohmann::json response;
+        response["id"]   = o->get_id();
+        response["name"] = o->to_string();
+        response["scanout-frames"]    = stats.scanout_frames;
+        response["composited-frames"] = o->render->get_frame_stats().rendered_frames;
+        response["last-blocker"] = blocker_names[stats.last_blocker];
+        response["blockers"]     = nlohmann::json::object();
+        for (int i = wf::SCANOUT_BLOCKER_NONE + 1; i < wf::SCANOUT_BLOCKER_COUNT; i++)
         {
-            for (auto& sub : data[EVENTS])
+            if (stats.blocked_frames[i])
             {
-                if (!sub.is_string())
-                {
-                    return wf::ipc::json_error("Event list contains non-string entries!");
-                }
-
-                if (signal_map.count(sub))
-                {
-                    subscribed_to.insert((std::string)sub);
-                }
+                response["blockers"][blocker_names[i]] = stats.blocked_frames[i];
             }
-        } else
+        }
+
+        response["effect-hook-owners"] = stats.effect_hook_owners;
+        response["post-hook-owners"]   = stats.post_hook_owners;
+        response["inhibit-owners"]     = stats.inhibit_owners;
+        return response;
+    }
+
+    wf::ipc::method_callback get_scanout_stats = [=] (nlohmann::json data)
+    {
+        WFJSON_OPTIONAL_FIELD(data, "id", number_integer);
+        auto response = wf::ipc::json_ok();
+        response["outputs"] = nlohmann::json::array();
+        if (data.contains("id"))
         {
-            for (auto& [ev_name, _] : signal_map)
+            auto wo = wf::ipc::find_output_by_id(data["id"]);
+            if (!wo)
             {
-                subscribed_to.insert(ev_name);
+                return wf::ipc::json_error("output not found");
             }
+
+            response["outputs"].push_back(scanout_stats_to_json(wo));
+            return response;
         }
 
-        for (auto& ev_name : subscribed_to)
+        for (auto& output : wf::get_core().output_layout->get_outputs())
         {
-            signal_map[ev_name].increase_count();
+            response["outputs"].push_back(scanout_stats_to_json(output));
         }
 
-        clients[client] = subscribed_to;
-        return wf::ipc::json_ok();
+        return response;
     };
 
-    wf::signal::connection_t<wf::ipc::client_disconnected_signal> on_client_disconnected =
-        [=] (wf::ipc::client_disconnected_signal *ev)
+    wf::ipc::method_callback get_input_latency = [=] (nlohmann::json data)
     {
-        for (auto& ev_name : clients[ev->client])
+        WFJSON_OPTIONAL_FIELD(data, "id", number_integer);
+        auto response = wf::ipc::json_ok();
+        response["outputs"] = nlohmann::json::array();
+        if (data.contains("id"))
         {
-            signal_map[ev_name].decrease_count();
+            auto wo = wf::ipc::find_output_by_id(data["id"]);
+            if (!wo)
+            {
+                return wf::ipc::json_error("output not found");
+            }
+
+            response["outputs"].push_back(input_latency_to_json(wo));
+            return response;
         }
 
-        clients.erase(ev->client);
+        for (auto& output : wf::get_core().output_layout->get_outputs())
+        {
+            response["outputs"].push_back(input_latency_to_json(output));
+        }
+
+        return response;
     };
 
-    void send_view_to_subscribes(wayfire_view view, std::string event_name)
+    nlohmann::json cursor_state_to_json(wf::output_t *o)
+    {
+        // The cursor planes are managed by wlroots, which also renders the cursor image transformed and
+        // scaled for the output. Software cursors are used only when that is not possible.
+        auto handle = o->handle;
+        bool software = false;
+        wlr_output_cursor *cursor;
+        wl_list_for_each(cursor, &handle->cursors, link)
+        {
+            software |= cursor->enabled && cursor->visible && (cursor != handle->hardware_cursor);
+        }
+
+        nlohmann::json response;
+        response["id"]   = o->get_id();
+        response["name"] = o->to_string();
+        response["software-cursor"]       = software;
+        response["software-cursor-locks"] = handle->software_cursor_locks;
+        if (handle->software_cursor_locks > 0)
+        {
+            response["reason"] = "locked, the output is mirrored or captured with its cursor";
+        } else if (software)
+        {
+            response["reason"] = "no cursor plane, or the plane rejected the cursor image";
+        }
+
+        return response;
+    }
+
+    wf::ipc::method_callback get_cursor_state = [=] (nlohmann::json data)
+    {
+        WFJSON_OPTIONAL_FIELD(data, "id", number_integer);
+        auto response = wf::ipc::json_ok();
+        response["outputs"] = nlohmann::json::array();
+        if (data.contains("id"))
+        {
+            auto wo = wf::ipc::find_output_by_id(data["id"]);
+            if (!wo)
+            {
+                return wf::ipc::json_error("output not found");
+            }
+
+            response["outputs"].push_back(cursor_state_to_json(wo));
+            return response;
+        }
+
+        for (auto& output : wf::get_core().output_layout->get_outputs())
+        {
+            response["outputs"].push_back(cursor_state_to_json(output));
+        }
+
+        return response;
+    };
+
+    nlohmann::json repaint_sources_to_json(wf::output_t *o)
+    {
+        nlohmann::json response;
+        response["id"]   = o->get_id();
+        response["name"] = o->to_string();
+        response["idle-frames"] = o->render->get_frame_stats().idle_frames;
+        response["sources"]     = nlohmann::json::array();
+        for (auto& source : o->render->get_repaint_sources())
+        {
+            nlohmann::json s;
+            s["owner"] = source.owner;
+            s["redraw-always"] = source.redraw_always;
+            s["redraw-always-usec"]  = source.redraw_always_usec;
+            s["requests"] = source.requests;
+            s["requests-per-second"] = source.requests_per_second;
+            response["sources"].push_back(s);
+        }
+
+        return response;
+    }
+
+    wf::ipc::method_callback get_repaint_sources = [=] (nlohmann::json data)
+    {
+        WFJSON_OPTIONAL_FIELD(data, "id", number_integer);
+        auto response = wf::ipc::json_ok();
+        response["outputs"] = nlohmann::json::array();
+        if (data.contains("id"))
+        {
+            auto wo = wf::ipc::find_output_by_id(data["id"]);
+            if (!wo)
+            {
+                return wf::ipc::json_error("output not found");
+            }
+
+            response["outputs"].push_back(repaint_sources_to_json(wo));
+            return response;
+        }
+
+        for (auto& output : wf::get_core().output_layout->get_outputs())
+        {
+            response["outputs"].push_back(repaint_sources_to_json(output));
+        }
+
+        return response;
+    };
+
+    wf::ipc::method_callback get_frame_stats = [=] (nlohmann::json data)
+    {
+        WFJSON_OPTIONAL_FIELD(data, "id", number_integer);
+        auto response = wf::ipc::json_ok();
+        response["outputs"] = nlohmann::json::array();
+        if (data.contains("id"))
+        {
+            auto wo = wf::ipc::find_output_by_id(data["id"]);
+            if (!wo)
+            {
+                return wf::ipc::json_error("output not found");
+            }
+
+            response["outputs"].push_back(frame_stats_to_json(wo));
+            return response;
+        }
+
+        for (auto& output : wf::get_core().output_layout->get_outputs())
+        {
+            response["outputs"].push_back(frame_stats_to_json(output));
+        }
+
+        return response;
+    };
+
+    wf::ipc::method_callback get_framebuffer_pool = [=] (nlohmann::json data)
+    {
+        auto stats    = OpenGL::get_framebuffer_pool_stats();
+        auto response = wf::ipc::json_ok();
+        response["used-buffers"]   = stats.used_buffers;
+        response["used-bytes"]     = stats.used_bytes;
+        response["free-buffers"]   = stats.free_buffers;
+        response["free-bytes"]     = stats.free_bytes;
+        response["max-free-bytes"] = stats.max_free_bytes;
+        response["hits"]      = stats.hits;
+        response["misses"]    = stats.misses;
+        response["evictions"] = stats.evictions;
+        response["soft-cap-evictions"] = stats.soft_cap_evictions;
+        response["depth-buffers"] = stats.depth_buffers;
+        response["depth-bytes"]   = stats.depth_bytes;
+        return response;
+    };
+
+    wf::ipc::method_callback get_thread_pool_stats = [=] (nlohmann::json data)
+    {
+        auto stats    = wf::get_core().thread_pool->get_stats();
+        auto response = wf::ipc::json_ok();
+        response["threads"]    = stats.threads;
+        response["queued"]     = stats.queued;
+        response["running"]    = stats.running;
+        response["finished"]   = stats.finished;
+        response["max-queued"] = stats.max_queued;
+        response["completed"]  = stats.completed;
+        response["cancelled"]  = stats.cancelled;
+        return response;
+    };
+
+    /** The resident memory of the process in bytes, or -1 if it cannot be read. */
+    static int64_t get_resident_bytes()
+    {
+        std::ifstream statm{"/proc/self/statm"};
+        int64_t size, resident;
+        if (!(statm >> size >> resident))
+        {
+            return -1;
+        }
+
+        return resident * sysconf(_SC_PAGESIZE);
+    }
+
+    wf::ipc::method_callback trim_memory = [=] (nlohmann::json data)
+    {
+        const int64_t resident_before = get_resident_bytes();
+        const int64_t gpu_freed = wf::gpu_memory::trim();
+        const int64_t resident_after = get_resident_bytes();
+
+        auto response = wf::ipc::json_ok();
+        response["gpu-bytes-freed"] = gpu_freed;
+        response["resident-bytes"]  = resident_after;
+        response["resident-bytes-freed"] =
+            ((resident_before < 0) || (resident_after < 0)) ? 0 : (resident_before - resident_after);
+        return response;
+    };
+
+    /** The view which contains the node, if any. */
+    static wayfire_view find_node_view(wf::scene::node_t *node)
+    {
+        for (; node; node = node->parent())
+        {
+            if (auto view = wf::node_to_view(node))
+            {
+                return view;
+            }
+        }
+
+        return nullptr;
+    }
+
+    wf::ipc::method_callback get_gpu_memory = [=] (nlohmann::json data)
+    {
+        WFJSON_OPTIONAL_FIELD(data, "top", number_integer);
+        const int top = data.value("top", 10);
+        if (top < 0)
+        {
+            return wf::ipc::json_error("top must not be negative");
+        }
+
+        auto response = wf::ipc::json_ok();
+        response["total-bytes"]    = wf::gpu_memory::get_total();
+        response["soft-cap-bytes"] = wf::gpu_memory::get_soft_cap();
+        for (int i = 0; i < wf::gpu_memory::TYPE_COUNT; i++)
+        {
+            auto type = (wf::gpu_memory::type_t)i;
+            response["types"][wf::gpu_memory::type_name(type)] = wf::gpu_memory::get_total(type);
+        }
+
+        struct usage_t
+        {
+            nlohmann::json info;
+            int64_t bytes = 0;
+            std::map<std::string, int64_t> types;
+        };
+
+        std::map<std::string, usage_t> owners;
+        std::map<uint32_t, usage_t> views;
+        std::vector<std::pair<int64_t, nlohmann::json>> entries;
+        for (auto& allocation : wf::gpu_memory::get_allocations())
+        {
+            const char *type = wf::gpu_memory::type_name(allocation.type);
+            auto& owner = owners[allocation.owner];
+            owner.info["owner"] = allocation.owner;
+            owner.bytes += allocation.bytes;
+            owner.types[type] += allocation.bytes;
+
+            nlohmann::json entry;
+            entry["type"]  = type;
+            entry["bytes"] = allocation.bytes;
+            entry["owner"] = allocation.owner;
+            if (auto node = allocation.node.lock())
+            {
+                entry["node"] = node->stringify();
+                if (auto view = find_node_view(node.get()))
+                {
+                    entry["view-id"] = view->get_id();
+                    auto& usage = views[view->get_id()];
+                    usage.info["id"]     = view->get_id();
+                    usage.info["app-id"] = view->get_app_id();
+                    usage.bytes += allocation.bytes;
+                    usage.types[type] += allocation.bytes;
+                }
+            }
+
+            entries.emplace_back(allocation.bytes, std::move(entry));
+        }
+
+        auto usage_to_json = [] (auto& usages)
+        {
+            std::vector<usage_t*> sorted;
+            for (auto& [key, usage] : usages)
+            {
+                sorted.push_back(&usage);
+            }
+
+            std::sort(sorted.begin(), sorted.end(), [] (usage_t *a, usage_t *b)
+            {
+                return a->bytes > b->bytes;
+            });
+
+            nlohmann::json result = nlohmann::json::array();
+            for (auto usage : sorted)
+            {
+                usage->info["bytes"] = usage->bytes;
+                usage->info["types"] = usage->types;
+                result.push_back(usage->info);
+            }
+
+            return result;
+        };
+
+        response["owners"] = usage_to_json(owners);
+        response["views"]  = usage_to_json(views);
+
+        const size_t count = std::min(entries.size(), (size_t)top);
+        std::partial_sort(entries.begin(), entries.begin() + count, entries.end(),
+            [] (const auto& a, const auto& b) { return a.first > b.first; });
+        response["top"] = nlohmann::json::array();
+        for (size_t i = 0; i < count; i++)
+        {
+            response["top"].push_back(std::move(entries[i].second));
+        }
+
+        return response;
+    };
+
+    wf::ipc::method_callback set_tearing = [=] (nlohmann::json data)
+    {
+        WFJSON_EXPECT_FIELD(data, "id", number_integer);
+        WFJSON_EXPECT_FIELD(data, "allow", boolean);
+        auto wo = wf::ipc::find_output_by_id(data["id"]);
+        if (!wo)
+        {
+            return wf::ipc::json_error("output not found");
+        }
+
+        wo->render->set_tearing_allowed(data["allow"]);
+        return wf::ipc::json_ok();
+    };
+
+    wf::ipc::method_callback trace_start = [=] (nlohmann::json data)
+    {
+        WFJSON_OPTIONAL_FIELD(data, "capacity", number_integer);
+        const int capacity = data.value("capacity", 100000);
+        if (capacity <= 0)
+        {
+            return wf::ipc::json_error("capacity must be positive");
+        }
+
+        wf::trace::start(capacity);
+        return wf::ipc::json_ok();
+    };
+
+    wf::ipc::method_callback trace_stop = [=] (nlohmann::json data)
+    {
+        wf::trace::stop();
+        return wf::ipc::json_ok();
+    };
+
+    wf::ipc::method_callback trace_dump = [=] (nlohmann::json data)
+    {
+        WFJSON_EXPECT_FIELD(data, "path", string);
+        const int written = wf::trace::dump(data["path"]);
+        if (written < 0)
+        {
+            return wf::ipc::json_error("failed to write the trace file");
+        }
+
+        auto response = wf::ipc::json_ok();
+        response["events"] = written;
+        return response;
+    };
+
+    wf::ipc::method_callback get_plugin_stats = [=] (nlohmann::json data)
+    {
+        WFJSON_OPTIONAL_FIELD(data, "enable", boolean);
+        if (data.contains("enable"))
+        {
+            wf::plugin_stats::enable(data["enable"]);
+        }
+
+        static const char *cost_names[] = {"effect-hooks", "post-hooks", "signals", "render"};
+        const uint64_t frames = wf::plugin_stats::get_frame_count();
+
+        auto response = wf::ipc::json_ok();
+        response["enabled"] = wf::plugin_stats::enabled;
+        response["frames"]  = frames;
+        response["plugins"] = nlohmann::json::array();
+        for (auto& plugin : wf::plugin_stats::get_stats())
+        {
+            nlohmann::json entry;
+            entry["name"] = plugin.name;
+            int64_t total = 0;
+            for (int i = 0; i < wf::plugin_stats::COST_TYPE_COUNT; i++)
+            {
+                entry[cost_names[i]]["calls"]    = plugin.costs[i].calls;
+                entry[cost_names[i]]["total-us"] = plugin.costs[i].total_usec;
+                total += plugin.costs[i].total_usec;
+            }
+
+            entry["total-us"]      = total;
+            entry["avg-frame-us"]  = frames ? (double)total / frames : 0.0;
+            entry["last-frame-us"] = plugin.last_frame_usec;
+            entry["max-frame-us"]  = plugin.max_frame_usec;
+            response["plugins"].push_back(entry);
+        }
+
+        return response;
+    };
+
+    wf::ipc::method_callback get_signal_stats = [=] (nlohmann::json data)
+    {
+        WFJSON_OPTIONAL_FIELD(data, "enable", boolean);
+        if (data.contains("enable"))
+        {
+            wf::plugin_stats::enable(data["enable"]);
+        }
+
+        auto response = wf::ipc::json_ok();
+        response["enabled"] = wf::plugin_stats::enabled;
+        response["signals"] = nlohmann::json::array();
+        for (auto& signal : wf::plugin_stats::get_signal_stats())
+        {
+            nlohmann::json entry;
+            entry["name"]          = signal.name;
+            entry["emissions"]     = signal.emissions;
+            entry["avg-listeners"] = signal.emissions ? (double)signal.listeners / signal.emissions : 0.0;
+            entry["max-listeners"] = signal.max_listeners;
+            entry["dispatch-us"]   = signal.dispatch_usec;
+            entry["handlers"]      = nlohmann::json::array();
+            for (auto& [plugin, cost] : signal.handlers)
+            {
+                nlohmann::json handler;
+                handler["plugin"]   = plugin;
+                handler["calls"]    = cost.calls;
+                handler["total-us"] = cost.total_usec;
+                entry["handlers"].push_back(handler);
+            }
+
+            response["signals"].push_back(entry);
+        }
+
+        return response;
+    };
+
+    static nlohmann::json node_stats_to_json(const wf::scene::node_render_stats_t& stats)
+    {
+        nlohmann::json result;
+        result["instructions"]  = stats.instructions;
+        result["pixels"]        = stats.pixels;
+        result["render-us"]     = stats.render_usec;
+        result["damage-events"] = stats.damage_events;
+        result["damage-pixels"] = stats.damage_pixels;
+        return result;
+    }
+
+    static nlohmann::json scene_node_to_json(wf::scene::node_t *node)
+    {
+        nlohmann::json result;
+        result["id"]       = (uint64_t)(uintptr_t)node;
+        result["name"]     = node->stringify();
+        result["enabled"]  = node->is_enabled();
+        result["geometry"] = wf::ipc::geometry_to_json(node->get_bounding_box());
+        if (auto stats = wf::scene::get_node_render_stats(node))
+        {
+            result["stats"] = node_stats_to_json(*stats);
+        }
+
+        if (auto transformer = dynamic_cast<wf::scene::transformer_base_node_t*>(node))
+        {
+            auto& buffer = transformer->inner_content;
+            result["aux-buffer-bytes"] = (buffer.fb == (uint32_t)-1) ? 0 :
+                (uint64_t)buffer.viewport_width * buffer.viewport_height * 4;
+        }
+
+        result["children"] = nlohmann::json::array();
+        for (auto& child : node->get_children())
+        {
+            result["children"].push_back(scene_node_to_json(child.get()));
+        }
+
+        return result;
+    }
+
+    wf::ipc::method_callback get_scene = [=] (nlohmann::json data)
+    {
+        WFJSON_OPTIONAL_FIELD(data, "enable", boolean);
+        if (data.contains("enable"))
+        {
+            wf::plugin_stats::enable(data["enable"]);
+        }
+
+        auto response = wf::ipc::json_ok();
+        response["enabled"] = wf::plugin_stats::enabled;
+        response["frames"]  = wf::plugin_stats::get_frame_count();
+        response["time-us"] = wf::get_current_time_usec();
+        response["unattributed"] = node_stats_to_json(*wf::scene::get_node_render_stats(nullptr));
+        response["root"] = scene_node_to_json(wf::get_core().scene().get());
+        return response;
+    };
+
+    wf::ipc::method_callback get_transaction_stats = [=] (nlohmann::json data)
+    {
+        auto stats    = wf::get_core().tx_manager->get_stats();
+        auto response = wf::ipc::json_ok();
+        response["scheduled"]         = stats.scheduled;
+        response["merged"]            = stats.merged;
+        response["committed"]         = stats.committed;
+        response["applied"]           = stats.applied;
+        response["timed-out"]         = stats.timed_out;
+        response["conflicts"]         = stats.conflicts;
+        response["pending-now"]       = stats.pending_now;
+        response["committed-now"]     = stats.committed_now;
+        response["max-pending"]       = stats.max_pending;
+        response["max-committed"]     = stats.max_committed;
+        response["avg-latency-us"]    = stats.applied ? stats.total_latency_usec / (int64_t)stats.applied : 0;
+        response["max-latency-us"]    = stats.max_latency_usec;
+        response["latency-histogram"] = stats.latency_histogram;
+        response["timeouts-by-type"]  = stats.timeouts_by_type;
+
+        response["clients"] = nlohmann::json::array();
+        for (auto& client : wf::get_core().tx_manager->get_client_ack_stats())
+        {
+            nlohmann::json entry;
+            entry["app-id"]           = client.app_id;
+            entry["acks"]             = client.acks;
+            entry["timeouts"]         = client.timeouts;
+            entry["splits"]           = client.splits;
+            entry["avg-ack-us"]       = client.avg_ack_usec;
+            entry["ack-deviation-us"] = client.ack_deviation_usec;
+            entry["max-ack-us"]       = client.max_ack_usec;
+            entry["expected-ack-us"]  = client.expected_ack_usec;
+            response["clients"].push_back(entry);
+        }
+
+        return response;
+    };
+
+    wf::ipc::method_callback list_transactions = [=] (nlohmann::json data)
+    {
+        auto response = wf::ipc::json_ok();
+        response["transactions"] = nlohmann::json::array();
+        for (auto& tx : wf::get_core().tx_manager->get_inflight_transactions())
+        {
+            nlohmann::json entry;
+            entry["id"]        = (uintptr_t)tx.tx;
+            entry["committed"] = tx.committed;
+            entry["blocked"]   = tx.blocked;
+            entry["age-us"]    = tx.age_usec;
+            entry["objects"]   = nlohmann::json::array();
+            for (auto& obj : tx.objects)
+            {
+                nlohmann::json object;
+                object["name"]  = obj.name;
+                object["type"]  = obj.type;
+                object["ready"] = obj.ready;
+                entry["objects"].push_back(object);
+            }
+
+            response["transactions"].push_back(entry);
+        }
+
+        return response;
+    };
+
+  private:
+    wf::shared_data::ref_ptr_t<wf::ipc::method_repository_t> method_repository;
+    view_change_tracker_t view_changes;
+    // Connects to the view signals before the event handlers, so that events see the new state.
+    view_json_cache_t view_cache;
+
+    /**
+     * A client which has requested watch.
+     *
+     * Coalesced events (view-geometry-changed) for the same view are sent at most once per interval: the
+     * first one right away, and the following ones merged into a single event sent when the interval is
+     * over, so that the client always gets the final state at the end of a burst.
+     */
+    struct subscription_t
+    {
+        // The events the client wants, all if empty
+        std::set<std::string> events;
+        // Send at most one coalesced event per frame of the view's output
+        bool coalesce = false;
+        // Send at most this many coalesced events per second for each view, 0 for no limit
+        double max_rate = 0;
+
+        struct throttled_t
+        {
+            std::chrono::steady_clock::time_point last_sent;
+            std::chrono::steady_clock::time_point due;
+            // The merged event which is sent at @due, null if there is none
+            nlohmann::json pending;
+        };
+
+        // Throttled views, by view id
+        std::map<uint32_t, throttled_t> throttled;
+    };
+
+    std::map<wf::ipc::client_interface_t*, subscription_t> clients;
+    wf::wl_timer<false> throttle_timer;
+
+    wf::ipc::method_callback_full on_client_watch =
+        [=] (nlohmann::json data, wf::ipc::client_interface_t *client)
+    {
+        static constexpr const char *EVENTS = "events";
+        WFJSON_OPTIONAL_FIELD(data, EVENTS, array);
+        std::set<std::string> subscribed_to;
+        if (data.contains(EVENTS))
+        {
+            for (auto& sub : data[EVENTS])
+            {
+                if (!sub.is_string())
+                {
+                    return wf::ipc::json_error("Event list contains non-string entries!");
+                }
+
+                if (signal_map.count(sub))
+                {
+                    subscribed_to.insert((std::string)sub);
+                }
+            }
+        } else
+        {
+            for (auto& [ev_name, _] : signal_map)
+            {
+                subscribed_to.insert(ev_name);
+            }
+        }
+
+        WFJSON_OPTIONAL_FIELD(data, "coalesce", boolean);
+        WFJSON_OPTIONAL_FIELD(data, "max-rate", number);
+        subscription_t subscription;
+        subscription.events   = subscribed_to;
+        subscription.coalesce = data.value("coalesce", false);
+        subscription.max_rate = std::max(0.0, data.value("max-rate", 0.0));
+
+        for (auto& ev_name : subscribed_to)
+        {
+            signal_map[ev_name].increase_count();
+        }
+
+        clients[client] = std::move(subscription);
+        return wf::ipc::json_ok();
+    };
+
+    wf::signal::connection_t<wf::ipc::client_disconnected_signal> on_client_disconnected =
+        [=] (wf::ipc::client_disconnected_signal *ev)
+    {
+        for (auto& ev_name : clients[ev->client].events)
+        {
+            signal_map[ev_name].decrease_count();
+        }
+
+        clients.erase(ev->client);
+    };
+
+    void send_view_to_subscribes(wayfire_view view, std::string event_name)
     {
         nlohmann::json event;
         event["event"] = event_name;
@@ -577,15 +1789,169 @@ class ipc_rules_t : public wf::plugin_interface_t, public wf::per_output_tracker
 
     void send_event_to_subscribes(const nlohmann::json& data, const std::string& event_name)
     {
-        for (auto& [client, events] : clients)
+        const int64_t view_id = get_event_view_id(data);
+
+        // Serialized only once, and only if somebody is interested.
+        wf::ipc::serialized_message_t message;
+        for (auto& [client, sub] : clients)
         {
-            if (events.empty() || events.count(event_name))
+            if (sub.events.empty() || sub.events.count(event_name))
             {
-                client->send_json(data);
+                if (!message)
+                {
+                    message = wf::ipc::serialize_message(data);
+                }
+
+                // Keep the order of the events for the view.
+                flush_throttled(client, sub, view_id);
+                client->send_serialized(message);
             }
         }
     }
 
+    static int64_t get_event_view_id(const nlohmann::json& data)
+    {
+        auto view = data.find("view");
+        if ((view != data.end()) && view->is_object() && view->contains("id"))
+        {
+            return (*view)["id"].get<int64_t>();
+        }
+
+        return -1;
+    }
+
+    void flush_throttled(wf::ipc::client_interface_t *client, subscription_t& sub, int64_t view_id)
+    {
+        auto it = (view_id >= 0) ? sub.throttled.find(view_id) : sub.throttled.end();
+        if ((it != sub.throttled.end()) && !it->second.pending.is_null())
+        {
+            client->send_json(std::move(it->second.pending));
+            sub.throttled.erase(it);
+        }
+    }
+
+    /** @return The minimal time between two coalesced events for the view, zero to send all of them. */
+    static std::chrono::microseconds get_throttle_interval(const subscription_t& sub, wayfire_view view)
+    {
+        std::chrono::microseconds interval{0};
+        if (sub.coalesce)
+        {
+            // wlr_output::refresh is in mHz, 0 if unknown.
+            auto output = view->get_output();
+            const int refresh = (output && (output->handle->refresh > 0)) ? output->handle->refresh : 60000;
+            interval = std::chrono::microseconds(1'000'000'000ll / refresh);
+        }
+
+        if (sub.max_rate > 0)
+        {
+            interval = std::max(interval, std::chrono::microseconds((int64_t)(1'000'000 / sub.max_rate)));
+        }
+
+        return interval;
+    }
+
+    /**
+     * Send an event about the view's state which later events of the same kind replace, coalescing and
+     * rate-limiting it for the clients which asked for it.
+     *
+     * @param merge Update the new event with the fields of an older pending one which it replaces.
+     */
+    void send_coalesced_event_to_subscribes(nlohmann::json data, const std::string& event_name,
+        wayfire_view view, std::function<void(nlohmann::json& data, const nlohmann::json& old)> merge)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        wf::ipc::serialized_message_t message;
+        for (auto& [client, sub] : clients)
+        {
+            if (!sub.events.empty() && !sub.events.count(event_name))
+            {
+                continue;
+            }
+
+            const auto interval = get_throttle_interval(sub, view);
+            if (interval.count() > 0)
+            {
+                auto& throttled = sub.throttled[view->get_id()];
+                if (!throttled.pending.is_null())
+                {
+                    auto merged = data;
+                    merge(merged, throttled.pending);
+                    throttled.pending = std::move(merged);
+                    continue;
+                }
+
+                if (now < throttled.last_sent + interval)
+                {
+                    throttled.pending = data;
+                    throttled.due     = throttled.last_sent + interval;
+                    schedule_throttle_timer();
+                    continue;
+                }
+
+                throttled.last_sent = now;
+            }
+
+            if (!message)
+            {
+                message = wf::ipc::serialize_message(data);
+            }
+
+            client->send_serialized(message);
+        }
+    }
+
+    void schedule_throttle_timer()
+    {
+        std::optional<std::chrono::steady_clock::time_point> next;
+        for (auto& [_, sub] : clients)
+        {
+            for (auto& [_, throttled] : sub.throttled)
+            {
+                if (!throttled.pending.is_null() && (!next || (throttled.due < *next)))
+                {
+                    next = throttled.due;
+                }
+            }
+        }
+
+        throttle_timer.disconnect();
+        if (next)
+        {
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+                *next - std::chrono::steady_clock::now()) + std::chrono::milliseconds(1);
+            throttle_timer.set_timeout(std::max<int64_t>(wait.count(), 1), [=] () { send_due_events(); });
+        }
+    }
+
+    /** Send the pending coalesced events whose interval is over, and forget views which are idle. */
+    void send_due_events()
+    {
+        static constexpr auto IDLE_TIMEOUT = std::chrono::seconds(1);
+        const auto now = std::chrono::steady_clock::now();
+        for (auto& [client, sub] : clients)
+        {
+            for (auto it = sub.throttled.begin(); it != sub.throttled.end();)
+            {
+                auto& throttled = it->second;
+                if (!throttled.pending.is_null() && (throttled.due <= now))
+                {
+                    client->send_json(std::move(throttled.pending));
+                    throttled.pending   = nullptr;
+                    throttled.last_sent = now;
+                    ++it;
+                } else if (throttled.pending.is_null() && (now > throttled.last_sent + IDLE_TIMEOUT))
+                {
+                    it = sub.throttled.erase(it);
+                } else
+                {
+                    ++it;
+                }
+            }
+        }
+
+        schedule_throttle_timer();
+    }
+
     wf::signal::connection_t<wf::view_mapped_signal> on_view_mapped = [=] (wf::view_mapped_signal *ev)
     {
         send_view_to_subscribes(ev->view, "view-mapped");
@@ -613,7 +1979,12 @@ class ipc_rules_t : public wf::plugin_interface_t, public wf::per_output_tracker
         data["event"] = "view-geometry-changed";
         data["old-geometry"] = wf::ipc::geometry_to_json(ev->old_geometry);
         data["view"] = view_to_json(ev->view);
-        send_event_to_subscribes(data, data["event"]);
+        send_coalesced_event_to_subscribes(std::move(data), "view-geometry-changed", ev->view,
+            [] (nlohmann::json& data, const nlohmann::json& old)
+        {
+            // The client has not seen the geometry in between.
+            data["old-geometry"] = old["old-geometry"];
+        });
     };
 
     wf::signal::connection_t<wf::view_moved_to_wset_signal> on_view_moved_to_wset =
@@ -732,6 +2103,17 @@ class ipc_rules_t : public wf::plugin_interface_t, public wf::per_output_tracker
         send_event_to_subscribes(data, data["event"]);
     };
 
+    wf::signal::connection_t<wf::wm_actions_showdesktop_changed_signal> on_showdesktop_changed =
+        [=] (wf::wm_actions_showdesktop_changed_signal *ev)
+    {
+        nlohmann::json data;
+        data["event"]  = "output-showdesktop-changed";
+        data["output"] = (int)ev->output->get_id();
+        data["active"] = ev->active;
+        data["output-data"] = output_to_json(ev->output);
+        send_event_to_subscribes(data, data["event"]);
+    };
+
     std::string get_view_type(wayfire_view view)
     {
         if (view->role == wf::VIEW_ROLE_TOPLEVEL)
@@ -775,31 +2157,67 @@ class ipc_rules_t : public wf::plugin_interface_t, public wf::per_output_tracker
             return nullptr;
         }
 
-        auto output = view->get_output();
-        nlohmann::json description;
-        description["id"]     = view->get_id();
-        description["pid"]    = get_view_pid(view);
-        description["title"]  = view->get_title();
-        description["app-id"] = view->get_app_id();
-        description["base-geometry"] = wf::ipc::geometry_to_json(get_view_base_geometry(view));
+        using cache_t = view_json_cache_t;
+        auto& entry   = view_cache.get(view);
+        auto& description = entry.json;
+        auto output   = view->get_output();
         auto toplevel = wf::toplevel_cast(view);
-        description["parent"]   = toplevel && toplevel->parent ? (int)toplevel->parent->get_id() : -1;
-        description["geometry"] =
-            wf::ipc::geometry_to_json(toplevel ? toplevel->get_pending_geometry() : view->get_bounding_box());
-        description["bbox"] = wf::ipc::geometry_to_json(view->get_bounding_box());
-        description["output-id"]   = view->get_output() ? view->get_output()->get_id() : -1;
-        description["output-name"] = output ? output->to_string() : "null";
-        description["last-focus-timestamp"] = wf::get_focus_timestamp(view);
-        description["role"]   = role_to_string(view->role);
-        description["mapped"] = view->is_mapped();
-        description["layer"]  = layer_to_string(get_view_layer(view));
+
+        if (entry.dirty & cache_t::FIELDS_IDENTITY)
+        {
+            description["id"]   = view->get_id();
+            description["pid"]  = get_view_pid(view);
+            description["role"] = role_to_string(view->role);
+        }
+
+        if (entry.dirty & cache_t::FIELDS_TITLE)
+        {
+            description["title"] = view->get_title();
+        }
+
+        if (entry.dirty & cache_t::FIELDS_APP_ID)
+        {
+            description["app-id"] = view->get_app_id();
+        }
+
+        // view_geometry_changed_signal is emitted only for toplevels.
+        if ((entry.dirty & cache_t::FIELDS_GEOMETRY) || !toplevel)
+        {
+            description["base-geometry"] = wf::ipc::geometry_to_json(get_view_base_geometry(view));
+        }
+
+        if (entry.dirty & cache_t::FIELDS_OUTPUT)
+        {
+            description["output-id"]   = output ? output->get_id() : -1;
+            description["output-name"] = output ? output->to_string() : "null";
+        }
+
+        if (entry.dirty & cache_t::FIELDS_WSET)
+        {
+            description["wset-index"] =
+                toplevel && toplevel->get_wset() ? toplevel->get_wset()->get_index() : -1;
+        }
+
+        if (entry.dirty & cache_t::FIELDS_STATE)
+        {
+            description["minimized"] = toplevel ? toplevel->minimized : false;
+            description["sticky"]    = toplevel ? toplevel->sticky : false;
+        }
+
+        entry.dirty = 0;
+
+        // Not cached, these may change without a signal on core.
+        description["geometry"] = wf::ipc::geometry_to_json(
+            toplevel ? toplevel->get_pending_geometry() : view->get_bounding_box());
         description["tiled-edges"] = toplevel ? toplevel->pending_tiled_edges() : 0;
         description["fullscreen"]  = toplevel ? toplevel->pending_fullscreen() : false;
-        description["minimized"]   = toplevel ? toplevel->minimized : false;
-        description["activated"]   = toplevel ? toplevel->activated : false;
-        description["sticky"]     = toplevel ? toplevel->sticky : false;
-        description["wset-index"] = toplevel && toplevel->get_wset() ? toplevel->get_wset()->get_index() : -1;
-        description["min-size"]   = wf::ipc::dimensions_to_json(
+        description["parent"] = toplevel && toplevel->parent ? (int)toplevel->parent->get_id() : -1;
+        description["bbox"]   = wf::ipc::geometry_to_json(view->get_bounding_box());
+        description["last-focus-timestamp"] = wf::get_focus_timestamp(view);
+        description["mapped"]    = view->is_mapped();
+        description["layer"]     = layer_to_string(get_view_layer(view));
+        description["activated"] = toplevel ? toplevel->activated : false;
+        description["min-size"]  = wf::ipc::dimensions_to_json(
             toplevel ? toplevel->toplevel()->get_min_size() : wf::dimensions_t{0, 0});
         description["max-size"] = wf::ipc::dimensions_to_json(
             toplevel ? toplevel->toplevel()->get_max_size() : wf::dimensions_t{0, 0});
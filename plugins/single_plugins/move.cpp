@@ -25,6 +25,8 @@
 #include <wayfire/plugins/common/shared-core-data.hpp>
 #include <wayfire/plugins/common/move-drag-interface.hpp>
 #include <wayfire/plugins/grid.hpp>
+#include <array>
+#include <optional>
 
 class wayfire_move : public wf::per_output_plugin_instance_t,
     public wf::pointer_interaction_t, public wf::touch_interaction_t
@@ -47,6 +49,21 @@ class wayfire_move : public wf::per_output_plugin_instance_t,
         wf::grid::slot_t slot_id = wf::grid::SLOT_NONE;
     } slot;
 
+    /**
+     * The workarea and the geometry of all grid slots, computed once and reused for every motion event
+     * until the workarea or the output changes.
+     */
+    struct
+    {
+        bool valid = false;
+        wf::geometry_t output_geometry;
+        wf::geometry_t workarea;
+        std::array<wf::geometry_t, 10> slots;
+    } slot_cache;
+
+    /* The output-local input position for which the current slot was calculated */
+    std::optional<wf::point_t> last_slot_input;
+
 
     wf::wl_timer<false> workspace_switch_timer;
 
@@ -73,6 +90,7 @@ class wayfire_move : public wf::per_output_plugin_instance_t,
         } else
         {
             update_slot(wf::grid::SLOT_NONE);
+            last_slot_input = {};
         }
     };
 
@@ -108,6 +126,7 @@ class wayfire_move : public wf::per_output_plugin_instance_t,
 
                 /* Update slot, will hide the preview as well */
                 update_slot(wf::grid::SLOT_NONE);
+                last_slot_input = {};
             }
 
             wf::get_core().default_wm->set_view_grabbed(ev->main_view, false);
@@ -186,6 +205,8 @@ class wayfire_move : public wf::per_output_plugin_instance_t,
         };
 
         output->connect(&move_request);
+        output->connect(&on_workarea_changed);
+        output->connect(&on_output_config_changed);
 
         drag_helper->connect(&on_drag_output_focus);
         drag_helper->connect(&on_drag_snap_off);
@@ -288,7 +309,8 @@ class wayfire_move : public wf::per_output_plugin_instance_t,
         }
 
         this->input_grab->grab_input(wf::scene::layer::OVERLAY);
-        slot.slot_id = wf::grid::SLOT_NONE;
+        slot.slot_id    = wf::grid::SLOT_NONE;
+        last_slot_input = {};
         return true;
     }
 
@@ -336,7 +358,8 @@ class wayfire_move : public wf::per_output_plugin_instance_t,
         drag_helper->set_pending_drag(grab_position);
         drag_helper->start_drag(view, opts);
         drag_helper->handle_motion(get_global_input_coords());
-        slot.slot_id = wf::grid::SLOT_NONE;
+        slot.slot_id    = wf::grid::SLOT_NONE;
+        last_slot_input = {};
         return true;
     }
 
@@ -356,12 +379,46 @@ class wayfire_move : public wf::per_output_plugin_instance_t,
         drag_helper->handle_input_released();
     }
 
+    wf::signal::connection_t<wf::workarea_changed_signal> on_workarea_changed = [=] (auto)
+    {
+        invalidate_slot_cache();
+    };
+
+    wf::signal::connection_t<wf::output_configuration_changed_signal> on_output_config_changed = [=] (auto)
+    {
+        invalidate_slot_cache();
+    };
+
+    void invalidate_slot_cache()
+    {
+        slot_cache.valid = false;
+        last_slot_input  = {};
+    }
+
+    void ensure_slot_cache()
+    {
+        if (slot_cache.valid)
+        {
+            return;
+        }
+
+        slot_cache.output_geometry = output->get_relative_geometry();
+        slot_cache.workarea = output->workarea->get_workarea();
+        for (int i = 0; i < (int)slot_cache.slots.size(); i++)
+        {
+            slot_cache.slots[i] = wf::grid::get_slot_dimensions(output, i);
+        }
+
+        slot_cache.valid = true;
+    }
+
     /* Calculate the slot to which the view would be snapped if the input
      * is released at output-local coordinates (x, y) */
     wf::grid::slot_t calc_slot(wf::point_t point)
     {
-        auto g = output->workarea->get_workarea();
-        if (!(output->get_relative_geometry() & point))
+        ensure_slot_cache();
+        const auto& g = slot_cache.workarea;
+        if (!(slot_cache.output_geometry & point))
         {
             return wf::grid::SLOT_NONE;
         }
@@ -371,12 +428,12 @@ class wayfire_move : public wf::per_output_plugin_instance_t,
         bool is_left   = point.x - g.x <= threshold;
         bool is_right  = g.x + g.width - point.x <= threshold;
         bool is_top    = point.y - g.y < threshold;
-        bool is_bottom = g.x + g.height - point.y < threshold;
+        bool is_bottom = g.y + g.height - point.y < threshold;
 
         bool is_far_left   = point.x - g.x <= quarter_snap_threshold;
         bool is_far_right  = g.x + g.width - point.x <= quarter_snap_threshold;
         bool is_far_top    = point.y - g.y < quarter_snap_threshold;
-        bool is_far_bottom = g.x + g.height - point.y < quarter_snap_threshold;
+        bool is_far_bottom = g.y + g.height - point.y < quarter_snap_threshold;
 
         wf::grid::slot_t slot = wf::grid::SLOT_NONE;
         if ((is_left && is_far_top) || (is_far_left && is_top))
@@ -488,7 +545,8 @@ class wayfire_move : public wf::per_output_plugin_instance_t,
         /* Show a preview overlay */
         if (new_slot_id)
         {
-            wf::geometry_t slot_geometry = wf::grid::get_slot_dimensions(output, new_slot_id);
+            ensure_slot_cache();
+            wf::geometry_t slot_geometry = slot_cache.slots[new_slot_id];
             /* Unknown slot geometry, can't show a preview */
             if ((slot_geometry.width <= 0) || (slot_geometry.height <= 0))
             {
@@ -556,9 +614,17 @@ class wayfire_move : public wf::per_output_plugin_instance_t,
     void handle_input_motion()
     {
         drag_helper->handle_motion(get_global_input_coords());
-        if (is_snap_enabled())
+        if (!is_snap_enabled())
+        {
+            return;
+        }
+
+        // The slot depends only on the input position, so there is nothing to do if it did not change.
+        auto input = get_input_coords();
+        if (last_slot_input != input)
         {
-            update_slot(calc_slot(get_input_coords()));
+            last_slot_input = input;
+            update_slot(calc_slot(input));
         }
     }
 
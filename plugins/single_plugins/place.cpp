@@ -6,6 +6,155 @@
 #include <wayfire/workarea.hpp>
 #include <wayfire/window-manager.hpp>
 #include <wayfire/signal-definitions.hpp>
+#include <wayfire/workspace-set.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Find the position of a window with the given size inside the workarea where it overlaps the least with
+ * the other windows, measured as the sum of the areas of all intersections.
+ *
+ * The candidate positions are those where the window touches an edge of the workarea or of another window,
+ * and the center of the workarea. The overlap at each candidate is looked up in a summed-area table of the
+ * occupancy over a grid compressed to the edges of the windows and the candidates, so the cost is quadratic
+ * instead of cubic in the number of windows. Ties are broken by the distance to the center.
+ */
+static wf::point_t find_least_overlap_position(wf::dimensions_t size, wf::geometry_t workarea,
+    const std::vector<wf::geometry_t>& windows)
+{
+    const wf::point_t center = {
+        workarea.x + (workarea.width - size.width) / 2,
+        workarea.y + (workarea.height - size.height) / 2,
+    };
+
+    if ((size.width > workarea.width) || (size.height > workarea.height))
+    {
+        return center;
+    }
+
+    std::vector<wf::geometry_t> boxes;
+    for (auto& window : windows)
+    {
+        auto box = wf::geometry_intersection(window, workarea);
+        if ((box.width > 0) && (box.height > 0))
+        {
+            boxes.push_back(box);
+        }
+    }
+
+    auto sort_unique = [] (std::vector<int>& v)
+    {
+        std::sort(v.begin(), v.end());
+        v.erase(std::unique(v.begin(), v.end()), v.end());
+    };
+
+    // Candidate positions on each axis, followed by all grid lines of the compressed grid.
+    auto candidates = [&] (int start, int length, int window_size, int center, auto get_start, auto get_size)
+    {
+        std::vector<int> result = {start, start + length - window_size, center};
+        for (auto& box : boxes)
+        {
+            result.push_back(get_start(box) + get_size(box));
+            result.push_back(get_start(box) - window_size);
+        }
+
+        result.erase(std::remove_if(result.begin(), result.end(), [&] (int c)
+        {
+            return (c < start) || (c > start + length - window_size);
+        }), result.end());
+        sort_unique(result);
+        return result;
+    };
+
+    auto cand_x = candidates(workarea.x, workarea.width, size.width, center.x,
+        [] (auto& b) { return b.x; }, [] (auto& b) { return b.width; });
+    auto cand_y = candidates(workarea.y, workarea.height, size.height, center.y,
+        [] (auto& b) { return b.y; }, [] (auto& b) { return b.height; });
+
+    std::vector<int> xs, ys;
+    for (int c : cand_x)
+    {
+        xs.push_back(c);
+        xs.push_back(c + size.width);
+    }
+
+    for (int c : cand_y)
+    {
+        ys.push_back(c);
+        ys.push_back(c + size.height);
+    }
+
+    for (auto& box : boxes)
+    {
+        xs.push_back(box.x);
+        xs.push_back(box.x + box.width);
+        ys.push_back(box.y);
+        ys.push_back(box.y + box.height);
+    }
+
+    sort_unique(xs);
+    sort_unique(ys);
+
+    auto index = [] (const std::vector<int>& v, int c)
+    {
+        return (size_t)(std::lower_bound(v.begin(), v.end(), c) - v.begin());
+    };
+
+    // Number of windows covering each cell, accumulated from the corners of the windows.
+    const size_t nx = xs.size();
+    const size_t ny = ys.size();
+    std::vector<int> count(nx * ny, 0);
+    for (auto& box : boxes)
+    {
+        const size_t x1 = index(xs, box.x), x2 = index(xs, box.x + box.width);
+        const size_t y1 = index(ys, box.y), y2 = index(ys, box.y + box.height);
+        count[y1 * nx + x1]++;
+        count[y1 * nx + x2]--;
+        count[y2 * nx + x1]--;
+        count[y2 * nx + x2]++;
+    }
+
+    // sat[j][i] is the overlap in all cells left of xs[i] and above ys[j].
+    std::vector<int64_t> sat(nx * ny, 0);
+    for (size_t j = 0; j + 1 < ny; j++)
+    {
+        int64_t row = 0;
+        for (size_t i = 0; i + 1 < nx; i++)
+        {
+            auto& c = count[j * nx + i];
+            c += (i > 0 ? count[j * nx + i - 1] : 0) + (j > 0 ? count[(j - 1) * nx + i] : 0) -
+                ((i > 0) && (j > 0) ? count[(j - 1) * nx + i - 1] : 0);
+            row += (int64_t)c * (xs[i + 1] - xs[i]) * (ys[j + 1] - ys[j]);
+            sat[(j + 1) * nx + i + 1] = sat[j * nx + i + 1] + row;
+        }
+    }
+
+    wf::point_t best = center;
+    int64_t best_overlap  = -1;
+    int64_t best_distance = 0;
+    for (int y : cand_y)
+    {
+        const size_t y1 = index(ys, y), y2 = index(ys, y + size.height);
+        for (int x : cand_x)
+        {
+            const size_t x1 = index(xs, x), x2 = index(xs, x + size.width);
+            const int64_t overlap = sat[y2 * nx + x2] - sat[y1 * nx + x2] - sat[y2 * nx + x1] +
+                sat[y1 * nx + x1];
+            const int64_t dx = x - center.x, dy = y - center.y;
+            const int64_t distance = dx * dx + dy * dy;
+            if ((best_overlap < 0) || (overlap < best_overlap) ||
+                ((overlap == best_overlap) && (distance < best_distance)))
+            {
+                best = {x, y};
+                best_overlap  = overlap;
+                best_distance = distance;
+            }
+        }
+    }
+
+    return best;
+}
 
 class wayfire_place_window : public wf::per_output_plugin_instance_t
 {
@@ -32,6 +181,9 @@ class wayfire_place_window : public wf::per_output_plugin_instance_t
         } else if (mode == "random")
         {
             random(toplevel, workarea);
+        } else if (mode == "smart")
+        {
+            smart(toplevel, workarea);
         } else
         {
             center(toplevel, workarea);
@@ -110,6 +262,23 @@ class wayfire_place_window : public wf::per_output_plugin_instance_t
         view->move(pos_x, pos_y);
     }
 
+    void smart(wayfire_toplevel_view & view, wf::geometry_t workarea)
+    {
+        std::vector<wf::geometry_t> windows;
+        for (auto& other : output->wset()->get_views(wf::WSET_MAPPED_ONLY | wf::WSET_EXCLUDE_MINIMIZED |
+            wf::WSET_CURRENT_WORKSPACE))
+        {
+            if ((other != view) && (other->role == wf::VIEW_ROLE_TOPLEVEL))
+            {
+                windows.push_back(other->get_pending_geometry());
+            }
+        }
+
+        wf::geometry_t window = view->get_pending_geometry();
+        auto pos = find_least_overlap_position(wf::dimensions(window), workarea, windows);
+        view->move(pos.x, pos.y);
+    }
+
     void center(wayfire_toplevel_view & view, wf::geometry_t workarea)
     {
         wf::geometry_t window = view->get_pending_geometry();
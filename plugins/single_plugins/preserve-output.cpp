@@ -6,6 +6,8 @@
 #include <wayfire/seat.hpp>
 #include <wayfire/output-layout.hpp>
 #include <wayfire/nonstd/wlroots-full.hpp>
+#include <wayfire/scene.hpp>
+#include <wayfire/txn/transaction-manager.hpp>
 #include <chrono>
 
 namespace wf
@@ -55,6 +57,10 @@ class preserve_output_t : public wf::plugin_interface_t
         LOGD("Saving workspace set ", data.workspace_set->get_index(), " from output ", output->to_string(),
             " with identifier ", ident);
 
+        // Moving many views at once, see try_restore_output().
+        wf::scene::update_batch_t batch;
+        wf::txn::transaction_group_t group{*wf::get_core().tx_manager};
+
         // Set a dummy workspace set with no views at all.
         output->set_workspace_set(wf::workspace_set_t::create());
 
@@ -82,7 +88,15 @@ class preserve_output_t : public wf::plugin_interface_t
         }
 
         LOGD("Restoring workspace set ", data.workspace_set->get_index(), " to output ", output->to_string());
-        output->set_workspace_set(data.workspace_set);
+        {
+            // Attaching the workspace set moves all of its views to the new output and adapts their
+            // geometry to it. Apply all of that as one transaction and one scenegraph update, instead of
+            // one of each per view.
+            wf::scene::update_batch_t batch;
+            wf::txn::transaction_group_t group{*wf::get_core().tx_manager};
+            output->set_workspace_set(data.workspace_set);
+        }
+
         if (data.was_focused && !focused_output_expired(data))
         {
             wf::get_core().seat->focus_output(output);
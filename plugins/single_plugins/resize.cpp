@@ -12,6 +12,9 @@
 #include <linux/input.h>
 #include <wayfire/signal-definitions.hpp>
 #include <wayfire/plugins/wobbly/wobbly-signal.hpp>
+#include <wayfire/plugins/common/preview-indication.hpp>
+#include <wayfire/plugins/common/util.hpp>
+#include <wayfire/view-transform.hpp>
 #include <wayfire/nonstd/wlroots-full.hpp>
 #include <wlr/util/edges.h>
 
@@ -64,6 +67,31 @@ class wayfire_resize : public wf::per_output_plugin_instance_t, public wf::point
     wf::option_wrapper_t<wf::buttonbinding_t> button{"resize/activate"};
     wf::option_wrapper_t<wf::buttonbinding_t> button_preserve_aspect{
         "resize/activate_preserve_aspect"};
+    /**
+     * How the new size is sent to the client while resizing:
+     * - live: on every motion.
+     * - throttled: at most @throttle_rate times per second.
+     * - scale: only when the resize ends, the view is scaled to the new size in the meantime.
+     * - outline: only when the resize ends, an outline shows the new geometry in the meantime.
+     */
+    wf::option_wrapper_t<std::string> resize_mode{"resize/mode"};
+    wf::option_wrapper_t<int> throttle_rate{"resize/throttle_rate"};
+
+    // The geometry which has not been sent to the client yet.
+    std::optional<wf::geometry_t> unsent_geometry;
+    wf::wl_timer<true> throttle_timer;
+    std::shared_ptr<wf::preview_indication_t> outline;
+
+    // The scale preview stays until the client has resized, or a timeout if it does not.
+    static constexpr const char *preview_transformer_name = "resize-preview";
+    std::weak_ptr<wf::view_interface_t> scaled_view;
+    wf::wl_timer<false> scale_preview_timeout;
+    wf::signal::connection_t<wf::view_geometry_changed_signal> on_scaled_view_resized =
+        [=] (wf::view_geometry_changed_signal*)
+    {
+        remove_scale_preview();
+    };
+
     std::unique_ptr<wf::input_grab_t> input_grab;
     wf::plugin_activation_data_t grab_interface = {
         .name = "resize",
@@ -220,6 +248,7 @@ class wayfire_resize : public wf::per_output_plugin_instance_t, public wf::point
         input_grab->set_wants_raw_input(true);
         input_grab->grab_input(wf::scene::layer::OVERLAY);
 
+        remove_scale_preview();
         grab_start = get_input_coords();
         grabbed_geometry = view->get_geometry();
         if (view->pending_tiled_edges())
@@ -259,6 +288,27 @@ class wayfire_resize : public wf::per_output_plugin_instance_t, public wf::point
         input_grab->ungrab_input();
         output->deactivate_plugin(&grab_interface);
 
+        throttle_timer.disconnect();
+        if (outline)
+        {
+            outline->set_target_geometry(outline->get_target_geometry(), 0, true);
+            outline = nullptr;
+        }
+
+        if (view && unsent_geometry)
+        {
+            send_geometry(*unsent_geometry);
+            if (!scaled_view.expired())
+            {
+                view->connect(&on_scaled_view_resized);
+                scale_preview_timeout.set_timeout(500, [=] () { remove_scale_preview(); });
+            }
+        } else
+        {
+            remove_scale_preview();
+        }
+
+        unsent_geometry.reset();
         if (view)
         {
             end_wobbly(view);
@@ -349,11 +399,82 @@ class wayfire_resize : public wf::per_output_plugin_instance_t, public wf::point
             desired.height = std::max(desired.height, 1);
         }
 
+        const std::string mode = resize_mode;
+        if (mode == "outline")
+        {
+            if (!outline)
+            {
+                outline = std::make_shared<wf::preview_indication_t>(view->get_geometry(), output, "resize");
+            }
+
+            outline->set_target_geometry(desired, 1);
+            unsent_geometry = desired;
+        } else if (mode == "scale")
+        {
+            show_scale_preview(desired);
+            unsent_geometry = desired;
+        } else if ((mode == "throttled") && throttle_timer.is_connected())
+        {
+            unsent_geometry = desired;
+        } else
+        {
+            send_geometry(desired);
+            if (mode == "throttled")
+            {
+                throttle_timer.set_timeout(1000 / std::max(1, (int)throttle_rate), [=] ()
+                {
+                    if (!unsent_geometry)
+                    {
+                        return false;
+                    }
+
+                    send_geometry(*unsent_geometry);
+                    unsent_geometry.reset();
+                    return true;
+                });
+            }
+        }
+    }
+
+    void send_geometry(wf::geometry_t desired)
+    {
         view->toplevel()->pending().gravity  = calculate_gravity();
         view->toplevel()->pending().geometry = desired;
         wf::get_core().tx_manager->schedule_object(view->toplevel());
     }
 
+    /** Scale the view so that its current contents cover @box. */
+    void show_scale_preview(wf::geometry_t box)
+    {
+        auto current = view->get_geometry();
+        if ((current.width <= 0) || (current.height <= 0))
+        {
+            return;
+        }
+
+        auto tr = wf::ensure_named_transformer<wf::scene::view_2d_transformer_t>(
+            view, wf::TRANSFORMER_2D, preview_transformer_name, view);
+        scaled_view = view->weak_from_this();
+        view->get_transformed_node()->begin_transform_update();
+        tr->scale_x = 1.0 * box.width / current.width;
+        tr->scale_y = 1.0 * box.height / current.height;
+        tr->translation_x = box.x - (current.x + current.width / 2.0 * (1 - tr->scale_x));
+        tr->translation_y = box.y - (current.y + current.height / 2.0 * (1 - tr->scale_y));
+        view->get_transformed_node()->end_transform_update();
+    }
+
+    void remove_scale_preview()
+    {
+        on_scaled_view_resized.disconnect();
+        scale_preview_timeout.disconnect();
+        if (auto view = scaled_view.lock())
+        {
+            view->get_transformed_node()->rem_transformer(preview_transformer_name);
+        }
+
+        scaled_view.reset();
+    }
+
     void fini() override
     {
         if (input_grab->is_grabbed())
@@ -361,6 +482,8 @@ class wayfire_resize : public wf::per_output_plugin_instance_t, public wf::point
             input_pressed(WLR_BUTTON_RELEASED);
         }
 
+        remove_scale_preview();
+
         output->rem_binding(&activate_binding);
         output->rem_binding(&activate_binding_preserve_aspect);
     }
@@ -27,6 +27,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <algorithm>
+#include <map>
 #include <set>
 
 constexpr const char *switcher_transformer = "switcher-3d";
@@ -103,6 +104,8 @@ class WayfireSwitcher : public wf::per_output_plugin_instance_t, public wf::keyb
     wf::option_wrapper_t<wf::animation_description_t> speed{"switcher/speed"};
     wf::option_wrapper_t<int> view_thumbnail_rotation{
         "switcher/view_thumbnail_rotation"};
+    wf::option_wrapper_t<double> lod_threshold{"switcher/lod_threshold"};
+    wf::option_wrapper_t<int> lod_update_interval{"switcher/lod_update_interval"};
 
     duration_t duration{speed};
     duration_t background_dim_duration{speed};
@@ -231,7 +234,10 @@ class WayfireSwitcher : public wf::per_output_plugin_instance_t, public wf::keyb
     wf::effect_hook_t pre_hook = [=] ()
     {
         dim_background(background_dim);
-        wf::scene::damage_node(render_node, render_node->get_bounding_box());
+        if (duration.running() || background_dim_duration.running())
+        {
+            damage_switcher();
+        }
 
         if (!duration.running())
         {
@@ -313,6 +319,7 @@ class WayfireSwitcher : public wf::per_output_plugin_instance_t, public wf::keyb
             next_view(dir);
         }
 
+        damage_switcher();
         return true;
     }
 
@@ -322,6 +329,7 @@ class WayfireSwitcher : public wf::per_output_plugin_instance_t, public wf::keyb
         cleanup_expired();
         dearrange();
         input_grab->ungrab_input();
+        damage_switcher();
     }
 
     /* Sets up basic hooks needed while switcher works and/or displays animations.
@@ -337,6 +345,7 @@ class WayfireSwitcher : public wf::per_output_plugin_instance_t, public wf::keyb
 
         render_node = std::make_shared<switcher_render_node_t>(this);
         wf::scene::add_front(wf::get_core().scene(), render_node);
+        wf::get_core().scene()->connect(&on_root_update);
         return true;
     }
 
@@ -346,6 +355,8 @@ class WayfireSwitcher : public wf::per_output_plugin_instance_t, public wf::keyb
         output->deactivate_plugin(&grab_interface);
 
         output->render->rem_effect(&pre_hook);
+        on_root_update.disconnect();
+        view_instances.clear();
         wf::scene::remove_child(render_node);
         render_node = nullptr;
 
@@ -654,9 +665,10 @@ class WayfireSwitcher : public wf::per_output_plugin_instance_t, public wf::keyb
                     "switcher-minimized-showed");
             }
 
-            view->get_transformed_node()->add_transformer(
-                std::make_shared<wf::scene::view_3d_transformer_t>(view),
-                wf::TRANSFORMER_3D, switcher_transformer);
+            auto tr = std::make_shared<wf::scene::view_3d_transformer_t>(view);
+            tr->lod_threshold = lod_threshold;
+            tr->lod_update_interval = lod_update_interval;
+            view->get_transformed_node()->add_transformer(tr, wf::TRANSFORMER_3D, switcher_transformer);
         }
 
         SwitcherView sw{duration};
@@ -666,13 +678,47 @@ class WayfireSwitcher : public wf::per_output_plugin_instance_t, public wf::keyb
         return sw;
     }
 
-    void render_view_scene(wayfire_view view, const wf::render_target_t& buffer)
+    /**
+     * The render instances of the views shown by the switcher. They are kept between frames, so that the
+     * transformers keep their buffers and thumbnails, and a view is repainted only after it is damaged.
+     */
+    std::map<wayfire_view, std::vector<wf::scene::render_instance_uptr>> view_instances;
+
+    wf::signal::connection_t<wf::scene::root_node_update_signal> on_root_update =
+        [=] (wf::scene::root_node_update_signal *ev)
+    {
+        if (ev->flags & (wf::scene::update_flag::CHILDREN_LIST | wf::scene::update_flag::ENABLED))
+        {
+            view_instances.clear();
+        }
+    };
+
+    /* A view might be shown in more than one place, so we simply damage the whole output */
+    void damage_switcher()
+    {
+        if (render_node)
+        {
+            wf::scene::damage_node(render_node, render_node->get_bounding_box());
+        }
+    }
+
+    std::vector<wf::scene::render_instance_uptr>& get_view_instances(wayfire_view view)
     {
-        std::vector<wf::scene::render_instance_uptr> instances;
-        view->get_transformed_node()->gen_render_instances(instances, [] (auto) {});
+        auto it = view_instances.find(view);
+        if (it == view_instances.end())
+        {
+            it = view_instances.emplace(view, std::vector<wf::scene::render_instance_uptr>{}).first;
+            view->get_transformed_node()->gen_render_instances(it->second,
+                [=] (const wf::region_t&) { damage_switcher(); });
+        }
+
+        return it->second;
+    }
 
+    void render_view_scene(wayfire_view view, const wf::render_target_t& buffer)
+    {
         wf::scene::render_pass_params_t params;
-        params.instances = &instances;
+        params.instances = &get_view_instances(view);
         params.damage    = view->get_transformed_node()->get_bounding_box();
         params.reference_output = this->output;
         params.target = buffer;
@@ -1,5 +1,8 @@
 #include <wayfire/util.hpp>
+#include <wayfire/geometry.hpp>
 #include <cmath>
+#include <cstdint>
+#include <deque>
 
 static inline double vswipe_process_delta(const double delta,
     const double accumulated_dx,
@@ -76,3 +79,63 @@ static inline int vswipe_finish_target(const double accumulated_dx,
 
     return target_dx;
 }
+
+/**
+ * Extrapolates the swiped distance to the time when the next frame is shown, using the velocity of the recent
+ * swipe updates, so that the workspaces follow the fingers without lagging one frame or more behind them.
+ */
+class vswipe_predictor_t
+{
+  public:
+    /** Only updates which are this recent are used to compute the velocity. */
+    static constexpr int64_t VELOCITY_WINDOW_US = 50'000;
+    /** The maximal extrapolation, to limit overshooting when the fingers stop. */
+    static constexpr int64_t MAX_LEAD_US = 25'000;
+
+    void reset()
+    {
+        samples.clear();
+    }
+
+    void add_sample(int64_t time_us, wf::pointf_t position)
+    {
+        samples.push_back({time_us, position});
+        while ((samples.size() > 2) && (time_us - samples.front().time_us > VELOCITY_WINDOW_US))
+        {
+            samples.pop_front();
+        }
+    }
+
+    /** @return The predicted position at the given time. */
+    wf::pointf_t predict(int64_t time_us) const
+    {
+        if (samples.empty())
+        {
+            return {0, 0};
+        }
+
+        const auto& first = samples.front();
+        const auto& last  = samples.back();
+        const double span = last.time_us - first.time_us;
+        // No recent updates means that the fingers rest, so there is nothing to extrapolate.
+        if ((span <= 0) || (time_us - last.time_us > VELOCITY_WINDOW_US))
+        {
+            return last.position;
+        }
+
+        const double lead = wf::clamp<int64_t>(time_us - last.time_us, 0, MAX_LEAD_US);
+        return {
+            last.position.x + (last.position.x - first.position.x) / span * lead,
+            last.position.y + (last.position.y - first.position.y) / span * lead,
+        };
+    }
+
+  private:
+    struct sample_t
+    {
+        int64_t time_us;
+        wf::pointf_t position;
+    };
+
+    std::deque<sample_t> samples;
+};
@@ -70,6 +70,9 @@ class vswipe : public wf::per_output_plugin_instance_t
         wf::pointf_t delta_prev;
         wf::pointf_t delta_last;
 
+        // The swiped distance shown in the last frame
+        wf::pointf_t delta_shown;
+
         int vx = 0;
         int vy = 0;
         int vw = 0;
@@ -81,11 +84,13 @@ class vswipe : public wf::per_output_plugin_instance_t
     wf::option_wrapper_t<bool> enable_vertical{"vswipe/enable_vertical"};
     wf::option_wrapper_t<bool> enable_free_movement{"vswipe/enable_free_movement"};
     wf::option_wrapper_t<bool> smooth_transition{"vswipe/enable_smooth_transition"};
+    wf::option_wrapper_t<bool> enable_prediction{"vswipe/enable_prediction"};
 
     wf::option_wrapper_t<wf::color_t> background_color{"vswipe/background"};
     wf::option_wrapper_t<wf::animation_description_t> animation_duration{"vswipe/duration"};
 
     vswipe_smoothing_t smooth_delta{animation_duration};
+    vswipe_predictor_t predictor;
     wf::option_wrapper_t<int> fingers{"vswipe/fingers"};
     wf::option_wrapper_t<double> gap{"vswipe/gap"};
     wf::option_wrapper_t<double> threshold{"vswipe/threshold"};
@@ -143,7 +148,17 @@ class vswipe : public wf::per_output_plugin_instance_t
         {current_workspace.x + dx, current_workspace.y + dy};
         auto g1 = wall->get_workspace_rectangle(current_workspace);
         auto g2 = wall->get_workspace_rectangle(next_ws);
-        wall->set_viewport(interpolate(g1, g2, -smooth_delta.dx, -smooth_delta.dy));
+
+        state.delta_shown = {smooth_delta.dx, smooth_delta.dy};
+        if (state.swiping && enable_prediction)
+        {
+            // The frame is shown about one refresh cycle from now.
+            const int refresh = output->handle->refresh > 0 ? output->handle->refresh : 60000;
+            const int64_t present_time = wf::get_current_time_usec() + 1'000'000'000ll / refresh;
+            state.delta_shown = predictor.predict(present_time);
+        }
+
+        wall->set_viewport(interpolate(g1, g2, -state.delta_shown.x, -state.delta_shown.y));
     };
 
     template<class wlr_event> using event = wf::input_event_signal<wlr_event>;
@@ -178,9 +193,11 @@ class vswipe : public wf::per_output_plugin_instance_t
         smooth_delta.dx.set(0, 0);
         smooth_delta.dy.set(0, 0);
 
-        state.delta_last = {0, 0};
-        state.delta_prev = {0, 0};
-        state.delta_sum  = {0, 0};
+        state.delta_last  = {0, 0};
+        state.delta_prev  = {0, 0};
+        state.delta_sum   = {0, 0};
+        state.delta_shown = {0, 0};
+        predictor.reset();
 
         // We switch the actual workspace before the finishing animation,
         // so the rendering of the animation cannot dynamically query current
@@ -297,8 +314,9 @@ class vswipe : public wf::per_output_plugin_instance_t
             current_delta_processed = vswipe_process_delta(delta / speed_factor, total_delta,
                 ws, ws_max, cap, enable_free_movement);
 
+            // With prediction, the shown distance is computed from the latest updates instead.
             double new_delta_end   = total_delta.end + current_delta_processed;
-            double new_delta_start = smooth_transition ? total_delta : new_delta_end;
+            double new_delta_start = (smooth_transition && !enable_prediction) ? total_delta : new_delta_end;
             total_delta.set(new_delta_start, new_delta_end);
         };
 
@@ -313,6 +331,7 @@ class vswipe : public wf::per_output_plugin_instance_t
         }
 
         state.delta_last = {ev->event->dx, ev->event->dy};
+        predictor.add_sample(wf::get_current_time_usec(), {smooth_delta.dx.end, smooth_delta.dy.end});
         smooth_delta.start();
     };
 
@@ -349,6 +368,13 @@ class vswipe : public wf::per_output_plugin_instance_t
             target_workspace.y -= target_delta.y;
         }
 
+        if (enable_prediction)
+        {
+            // Continue from the shown position, which may be ahead of the last update.
+            smooth_delta.dx.set(state.delta_shown.x, state.delta_shown.x);
+            smooth_delta.dy.set(state.delta_shown.y, state.delta_shown.y);
+        }
+
         smooth_delta.dx.restart_with_end(target_delta.x);
         smooth_delta.dy.restart_with_end(target_delta.y);
         smooth_delta.start();
@@ -11,6 +11,8 @@
 #include <wayfire/plugins/common/util.hpp>
 #include <wayfire/window-manager.hpp>
 #include <linux/input.h>
+#include <algorithm>
+#include <cmath>
 
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -27,6 +29,68 @@ static double vlen(double x1, double y1) // length of vector centered at the ori
     return std::sqrt(x1 * x1 + y1 * y1);
 }
 
+/**
+ * Build a region which covers the convex quad with the given corners (in order) out of horizontal strips.
+ * For a rotated view, this is much smaller than the bounding box of the quad.
+ */
+static wf::region_t quad_region(const wf::pointf_t (&quad)[4])
+{
+    double y1 = quad[0].y, y2 = quad[0].y;
+    for (auto& p : quad)
+    {
+        y1 = std::min(y1, p.y);
+        y2 = std::max(y2, p.y);
+    }
+
+    const int strips = std::clamp(int((y2 - y1) / 32), 1, 64);
+    const double step = (y2 - y1) / strips;
+
+    wf::region_builder_t builder;
+    builder.reserve(strips);
+    for (int i = 0; i < strips; i++)
+    {
+        const double top = y1 + i * step;
+        const double bottom = (i == strips - 1) ? y2 : top + step;
+
+        // The horizontal extent of a convex polygon in a strip is reached on the parts of its edges which
+        // lie in the strip.
+        double x1 = INFINITY, x2 = -INFINITY;
+        for (int j = 0; j < 4; j++)
+        {
+            auto a = quad[j], b = quad[(j + 1) % 4];
+            if (a.y > b.y)
+            {
+                std::swap(a, b);
+            }
+
+            if ((b.y < top) || (a.y > bottom))
+            {
+                continue;
+            }
+
+            auto x_at = [&] (double y)
+            {
+                return (b.y - a.y < 1e-6) ? a.x : a.x + (b.x - a.x) * (y - a.y) / (b.y - a.y);
+            };
+
+            const double xa = x_at(std::max(a.y, top));
+            const double xb = x_at(std::min(b.y, bottom));
+            x1 = std::min({x1, xa, xb});
+            x2 = std::max({x2, xa, xb});
+        }
+
+        if (x1 <= x2)
+        {
+            // Leave a pixel of margin for the filtering at the edges.
+            const int bx1 = (int)std::floor(x1) - 1, by1 = (int)std::floor(top) - 1;
+            builder.add(wf::geometry_t{bx1, by1, (int)std::ceil(x2) + 1 - bx1,
+                (int)std::ceil(bottom) + 1 - by1});
+        }
+    }
+
+    return builder.build();
+}
+
 enum class mode
 {
     NONE,
@@ -111,12 +175,55 @@ class wf_wrot : public wf::per_output_plugin_instance_t, public wf::pointer_inte
         }
     };
 
+    /**
+     * The part of the output covered by the view, if @tr is its outermost transformer, otherwise the bounding
+     * box of the view.
+     */
+    wf::region_t get_covered_region(wf::scene::transformer_base_node_t *tr)
+    {
+        auto tmgr = current_view->get_transformed_node();
+        if (tr->parent() != tmgr.get())
+        {
+            return tmgr->get_bounding_box();
+        }
+
+        auto box = tr->get_children_bounding_box();
+        wf::pointf_t quad[4] = {
+            tr->to_global(wf::pointf_t{1.0 * box.x, 1.0 * box.y}),
+            tr->to_global(wf::pointf_t{1.0 * box.x + box.width, 1.0 * box.y}),
+            tr->to_global(wf::pointf_t{1.0 * box.x + box.width, 1.0 * box.y + box.height}),
+            tr->to_global(wf::pointf_t{1.0 * box.x, 1.0 * box.y + box.height}),
+        };
+
+        for (auto& p : quad)
+        {
+            if (!std::isfinite(p.x) || !std::isfinite(p.y))
+            {
+                return tmgr->get_bounding_box();
+            }
+        }
+
+        return quad_region(quad) & tmgr->get_bounding_box();
+    }
+
+    /**
+     * Damage the parts of the output covered by the view before (@before, see get_covered_region()) and
+     * after a change of the transformer @tr. Rotating does not change the contents of the view, so its
+     * cached texture stays valid, and only the screen around it needs to be repainted.
+     */
+    void end_rotation_update(wf::scene::transformer_base_node_t *tr, const wf::region_t& before)
+    {
+        auto tmgr = current_view->get_transformed_node();
+        wf::scene::damage_node(tmgr, before | get_covered_region(tr));
+        wf::scene::update(tmgr, wf::scene::update_flag::GEOMETRY);
+    }
+
     void motion_2d(int x, int y)
     {
         auto tr = wf::ensure_named_transformer<wf::scene::view_2d_transformer_t>(
             current_view, wf::TRANSFORMER_2D, transformer_2d, current_view);
 
-        current_view->get_transformed_node()->begin_transform_update();
+        auto before = get_covered_region(tr.get());
         auto g = current_view->get_geometry();
 
         double cx = g.x + g.width / 2.0;
@@ -127,7 +234,6 @@ class wf_wrot : public wf::per_output_plugin_instance_t, public wf::pointer_inte
 
         if (vlen(x2, y2) <= reset_radius)
         {
-            current_view->get_transformed_node()->end_transform_update();
             current_view->get_transformed_node()->rem_transformer(transformer_2d);
             return;
         }
@@ -136,7 +242,7 @@ class wf_wrot : public wf::per_output_plugin_instance_t, public wf::pointer_inte
         tr->angle -= std::asin(cross(x1, y1, x2, y2) / vlen(x1, y1) / vlen(x2,
             y2));
 
-        current_view->get_transformed_node()->end_transform_update();
+        end_rotation_update(tr.get(), before);
         last_position = {1.0 * x, 1.0 * y};
     }
 
@@ -150,14 +256,14 @@ class wf_wrot : public wf::per_output_plugin_instance_t, public wf::pointer_inte
         auto tr = wf::ensure_named_transformer<wf::scene::view_3d_transformer_t>(
             current_view, wf::TRANSFORMER_3D, transformer_3d, current_view);
 
-        current_view->get_transformed_node()->begin_transform_update();
+        auto before  = get_covered_region(tr.get());
         float dx     = x - last_position.x;
         float dy     = y - last_position.y;
         float ascale = glm::radians(sensitivity / 60.0f);
         float dir    = invert ? -1.f : 1.f;
         tr->rotation = glm::rotate<float>(tr->rotation, vlen(dx, dy) * ascale,
             {dir *dy, dir * dx, 0});
-        current_view->get_transformed_node()->end_transform_update();
+        end_rotation_update(tr.get(), before);
         last_position = {(double)x, (double)y};
     }
 
@@ -250,10 +356,10 @@ class wf_wrot : public wf::per_output_plugin_instance_t, public wf::pointer_inte
                 if (std::abs(dot) < 0.05)
                 {
                     /* rotate 2.5 degrees around an axis perpendicular to x */
-                    current_view->get_transformed_node()->begin_transform_update();
+                    auto before = get_covered_region(tr.get());
                     tr->rotation = glm::rotate<float>(tr->rotation, glm::radians(
                         dot < 0 ? -2.5f : 2.5f), {x.y, -x.x, 0});
-                    current_view->get_transformed_node()->end_transform_update();
+                    end_rotation_update(tr.get(), before);
                 }
             }
         }
@@ -165,6 +165,7 @@ class wayfire_wsets_plugin_t : public wf::plugin_interface_t
         if (!overlay->node)
         {
             overlay->node = std::make_shared<simple_text_node_t>();
+            overlay->node->set_async(true, &typeid(*this));
         }
 
         overlay->node->set_text("Workspace set " + std::to_string(wo->wset()->get_index()));
@@ -1,8 +1,13 @@
 #include <wayfire/per-output-plugin.hpp>
+#include <wayfire/core.hpp>
 #include <wayfire/output.hpp>
 #include <wayfire/opengl.hpp>
 #include <wayfire/render-manager.hpp>
 #include <wayfire/util/duration.hpp>
+#include <wayfire/signal-definitions.hpp>
+#include <algorithm>
+#include <cmath>
+#include <optional>
 
 class wayfire_zoom_screen : public wf::per_output_plugin_instance_t
 {
@@ -12,12 +17,23 @@ class wayfire_zoom_screen : public wf::per_output_plugin_instance_t
         NEAREST = 1,
     };
 
+    enum class render_method_t
+    {
+        // Render the whole output and magnify a part of it in a post hook
+        POSTPROCESS   = 0,
+        // Render only the magnified part of the output, see render_manager::set_render_region()
+        RENDER_REGION = 1,
+    };
+
     wf::option_wrapper_t<wf::keybinding_t> modifier{"zoom/modifier"};
     wf::option_wrapper_t<double> speed{"zoom/speed"};
     wf::option_wrapper_t<wf::animation_description_t> smoothing_duration{"zoom/smoothing_duration"};
     wf::option_wrapper_t<int> interpolation_method{"zoom/interpolation_method"};
+    wf::option_wrapper_t<int> render_method{"zoom/render_method"};
     wf::animation::simple_animation_t progression{smoothing_duration};
     bool hook_set = false;
+    // Whether the zoom is rendered with a render region, decided when the zoom starts
+    bool region_mode = false;
 
     wf::plugin_activation_data_t grab_interface = {
         .name = "zoom",
@@ -43,10 +59,21 @@ class wayfire_zoom_screen : public wf::per_output_plugin_instance_t
 
             if (!hook_set)
             {
-                hook_set = true;
-                output->render->add_post(&render_hook);
-                output->render->set_redraw_always();
+                hook_set    = true;
+                region_mode = (render_method == (int)render_method_t::RENDER_REGION);
+                if (region_mode)
+                {
+                    output->render->add_effect(&pre_hook, wf::OUTPUT_EFFECT_PRE);
+                    wf::get_core().connect(&on_motion);
+                    wf::get_core().connect(&on_absolute_motion);
+                } else
+                {
+                    output->render->add_post(&render_hook, damage_map);
+                    output->render->set_redraw_always();
+                }
             }
+
+            output->render->schedule_redraw();
         }
     }
 
@@ -67,11 +94,74 @@ class wayfire_zoom_screen : public wf::per_output_plugin_instance_t
         return true;
     };
 
-    wf::post_hook_t render_hook = [=] (const wf::framebuffer_t& source,
-                                       const wf::framebuffer_t& destination)
+    /** @return The part of the output which is magnified to the whole output, in output-local coordinates. */
+    wf::geometry_t get_render_region()
+    {
+        auto og = output->get_relative_geometry();
+        auto oc = output->get_cursor_position();
+        double x, y;
+        wlr_box_closest_point(&og, oc.x, oc.y, &x, &y);
+
+        // Rounding the height up makes sure the region covers the whole output after magnifying it.
+        const double zoom = progression;
+        const int width   = std::max(1, (int)std::round(og.width / zoom));
+        const int height  = std::min(og.height, (int)std::ceil(1.0 * width * og.height / og.width));
+
+        // The point below the cursor stays in place.
+        const int rx = std::clamp((int)std::round(x * (1 - 1 / zoom)), 0, og.width - width);
+        const int ry = std::clamp((int)std::round(y * (1 - 1 / zoom)), 0, og.height - height);
+        return {rx, ry, width, height};
+    }
+
+    void update_render_region()
+    {
+        if (!progression.running() && (progression - 1 <= 0.01))
+        {
+            unset_hook();
+            return;
+        }
+
+        output->render->set_render_region(get_render_region());
+    }
+
+    wf::effect_hook_t pre_hook = [=] ()
+    {
+        if (progression.running())
+        {
+            output->render->schedule_redraw();
+        }
+
+        update_render_region();
+    };
+
+    wf::signal::connection_t<wf::post_input_event_signal<wlr_pointer_motion_event>> on_motion =
+        [=] (auto)
+    {
+        update_render_region();
+    };
+
+    wf::signal::connection_t<wf::post_input_event_signal<wlr_pointer_motion_absolute_event>>
+    on_absolute_motion = [=] (auto)
+    {
+        update_render_region();
+    };
+
+    /** The part of the source which is magnified to the whole destination, in GL coordinates. */
+    struct zoom_rect_t
+    {
+        float x1, y1;
+        GLint tw, th;
+
+        bool operator ==(const zoom_rect_t& other) const
+        {
+            return (x1 == other.x1) && (y1 == other.y1) && (tw == other.tw) && (th == other.th);
+        }
+    };
+
+    std::optional<zoom_rect_t> last_rect;
+
+    zoom_rect_t get_zoom_rect(int w, int h)
     {
-        auto w = destination.viewport_width;
-        auto h = destination.viewport_height;
         auto oc = output->get_cursor_position();
         double x, y;
         wlr_box b = output->get_relative_geometry();
@@ -92,8 +182,47 @@ class wayfire_zoom_screen : public wf::per_output_plugin_instance_t
         // aspect ratio constant while panning around.
         const GLint tw = w / progression, th = h / progression;
 
-        const float x1 = x * scale;
-        const float y1 = y * scale;
+        return {(float)(x * scale), (float)(y * scale), tw, th};
+    }
+
+    /**
+     * Damage in the source is magnified to the destination. The rectangle follows the cursor and the zoom
+     * level, and whenever it changes, everything has to be repainted.
+     */
+    wf::post_hook_damage_t damage_map = [=] (const wf::region_t& damage)
+    {
+        const int w = output->handle->width;
+        const int h = output->handle->height;
+        auto rect   = get_zoom_rect(w, h);
+        if (last_rect != rect)
+        {
+            last_rect = rect;
+            return wf::region_t{wf::geometry_t{0, 0, w, h}};
+        }
+
+        // Damage is in top-down coordinates, the rectangle in GL coordinates.
+        const double sx = 1.0 * w / rect.tw, sy = 1.0 * h / rect.th;
+        const double top = h - rect.y1 - rect.th;
+        wf::region_t result;
+        for (auto& box : damage)
+        {
+            // One more pixel on each side for the interpolation.
+            const int x1 = std::floor((box.x1 - rect.x1) * sx) - 1;
+            const int y1 = std::floor((box.y1 - top) * sy) - 1;
+            const int x2 = std::ceil((box.x2 - rect.x1) * sx) + 1;
+            const int y2 = std::ceil((box.y2 - top) * sy) + 1;
+            result |= wf::geometry_t{x1, y1, x2 - x1, y2 - y1};
+        }
+
+        return result;
+    };
+
+    wf::post_hook_t render_hook = [=] (const wf::framebuffer_t& source,
+                                       const wf::framebuffer_t& destination)
+    {
+        auto w = destination.viewport_width;
+        auto h = destination.viewport_height;
+        auto [x1, y1, tw, th] = get_zoom_rect(w, h);
 
         const GLenum interpolation =
             (interpolation_method ==
@@ -102,8 +231,14 @@ class wayfire_zoom_screen : public wf::per_output_plugin_instance_t
         OpenGL::render_begin(source);
         GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER, source.fb));
         GL_CALL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, destination.fb));
-        GL_CALL(glBlitFramebuffer(x1, y1, x1 + tw, y1 + th, 0, 0, w, h,
-            GL_COLOR_BUFFER_BIT, interpolation));
+        for (auto& box : output->render->get_post_hook_damage())
+        {
+            // The blit is clipped by the scissor box.
+            destination.scissor(wlr_box_from_pixman_box(box));
+            GL_CALL(glBlitFramebuffer(x1, y1, x1 + tw, y1 + th, 0, 0, w, h,
+                GL_COLOR_BUFFER_BIT, interpolation));
+        }
+
         OpenGL::render_end();
 
         if (!progression.running() && (progression - 1 <= 0.01))
@@ -114,16 +249,27 @@ class wayfire_zoom_screen : public wf::per_output_plugin_instance_t
 
     void unset_hook()
     {
-        output->render->set_redraw_always(false);
-        output->render->rem_post(&render_hook);
-        hook_set = false;
+        if (region_mode)
+        {
+            output->render->rem_effect(&pre_hook);
+            output->render->set_render_region({});
+            on_motion.disconnect();
+            on_absolute_motion.disconnect();
+        } else
+        {
+            output->render->set_redraw_always(false);
+            output->render->rem_post(&render_hook);
+        }
+
+        hook_set  = false;
+        last_rect = {};
     }
 
     void fini() override
     {
         if (hook_set)
         {
-            output->render->rem_post(&render_hook);
+            unset_hook();
         }
 
         output->rem_binding(&axis);
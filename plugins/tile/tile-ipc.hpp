@@ -272,6 +272,8 @@ inline nlohmann::json handle_ipc_set_layout(nlohmann::json params)
 
     auto& tile_ws = tile_workspace_set_data_t::get(ws->shared_from_this());
 
+    // All changes below end up in one transaction.
+    autocommit_transaction_t layout_tx;
     tile::json_builder_data_t data;
     data.gaps = tile_ws.get_gaps();
     auto workarea = tile_ws.roots[x][y]->geometry;
@@ -342,5 +344,13 @@ inline nlohmann::json handle_ipc_set_layout(nlohmann::json params)
 
     return wf::ipc::json_ok();
 }
+
+inline nlohmann::json handle_ipc_get_stats(const nlohmann::json& params)
+{
+    auto response = wf::ipc::json_ok();
+    response["transactions"] = tile_transaction_stats.transactions;
+    response["configures"]   = tile_transaction_stats.configures;
+    return response;
+}
 }
 }
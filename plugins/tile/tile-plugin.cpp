@@ -204,6 +204,7 @@ class tile_output_plugin_t : public wf::pointer_interaction_t, public wf::custom
         auto existing_node = wf::tile::view_node_t::get_node(view);
         if (existing_node)
         {
+            autocommit_transaction_t tx;
             detach_view(view);
             attach_view(view, vp);
         }
@@ -406,6 +407,7 @@ class tile_plugin_t : public wf::plugin_interface_t, wf::per_output_tracker_mixi
         wf::get_core().connect(&on_focus_changed);
         ipc_repo->register_method("simple-tile/get-layout", ipc_get_layout);
         ipc_repo->register_method("simple-tile/set-layout", ipc_set_layout);
+        ipc_repo->register_method("simple-tile/get-stats", ipc_get_stats);
         preview_manager = std::make_unique<tile::drag_manager_t>();
     }
 
@@ -425,6 +427,7 @@ class tile_plugin_t : public wf::plugin_interface_t, wf::per_output_tracker_mixi
 
         ipc_repo->unregister_method("simple-tile/get-layout");
         ipc_repo->unregister_method("simple-tile/set-layout");
+        ipc_repo->unregister_method("simple-tile/get-stats");
     }
 
     void stop_controller(std::shared_ptr<wf::workspace_set_t> wset)
@@ -496,6 +499,11 @@ class tile_plugin_t : public wf::plugin_interface_t, wf::per_output_tracker_mixi
     {
         return tile::handle_ipc_set_layout(params);
     };
+
+    ipc::method_callback ipc_get_stats = [=] (const nlohmann::json& params)
+    {
+        return tile::handle_ipc_get_stats(params);
+    };
 };
 
 std::unique_ptr<tile::tree_node_t>& tile::get_root(wf::workspace_set_t *set, wf::point_t workspace)
@@ -8,20 +8,57 @@
 #include <wayfire/workarea.hpp>
 #include <wayfire/window-manager.hpp>
 
+/** Counters of the transactions the tile plugin has scheduled, reported via simple-tile/get-stats. */
+struct tile_transaction_stats_t
+{
+    uint64_t transactions = 0;
+    // The number of toplevels in all transactions, each of which usually results in a configure.
+    uint64_t configures = 0;
+};
+
+inline tile_transaction_stats_t tile_transaction_stats;
+
+/**
+ * A transaction which is scheduled when it goes out of scope.
+ *
+ * Autocommit transactions nest: while one exists, all newly created ones share its transaction, and only the
+ * outermost one schedules it. Wrapping a whole user action (e.g. attaching a view) in one therefore results
+ * in a single transaction, and in a single configure for each view, however many times it is resized along
+ * the way.
+ */
 struct autocommit_transaction_t
 {
+  private:
+    wf::txn::transaction_uptr own_tx;
+    static inline autocommit_transaction_t *outermost = nullptr;
+
   public:
-    wf::txn::transaction_uptr tx;
-    autocommit_transaction_t()
+    wf::txn::transaction_uptr& tx;
+    autocommit_transaction_t() : tx(outermost ? outermost->own_tx : own_tx)
     {
-        tx = wf::txn::transaction_t::create();
+        if (!outermost)
+        {
+            own_tx    = wf::txn::transaction_t::create();
+            outermost = this;
+        }
     }
 
+    autocommit_transaction_t(const autocommit_transaction_t&) = delete;
+    autocommit_transaction_t& operator =(const autocommit_transaction_t&) = delete;
+
     ~autocommit_transaction_t()
     {
-        if (!tx->get_objects().empty())
+        if (outermost != this)
+        {
+            return;
+        }
+
+        outermost = nullptr;
+        if (!own_tx->get_objects().empty())
         {
-            wf::get_core().tx_manager->schedule_transaction(std::move(tx));
+            tile_transaction_stats.transactions++;
+            tile_transaction_stats.configures += own_tx->get_objects().size();
+            wf::get_core().tx_manager->schedule_transaction(std::move(own_tx));
         }
     }
 };
@@ -127,6 +164,7 @@ class tile_workspace_set_data_t : public wf::custom_data_t
         wf::geometry_t output_geometry =
             wset.lock()->get_last_output_geometry().value_or(tile::default_output_resolution);
 
+        autocommit_transaction_t tx;
         auto wsize = wset.lock()->get_workspace_grid_size();
         for (int i = 0; i < wsize.width; i++)
         {
@@ -136,8 +174,6 @@ class tile_workspace_set_data_t : public wf::custom_data_t
                 auto vp_geometry = workarea;
                 vp_geometry.x += i * output_geometry.width;
                 vp_geometry.y += j * output_geometry.height;
-
-                autocommit_transaction_t tx;
                 roots[i][j]->set_geometry(vp_geometry, tx.tx);
             }
         }
@@ -248,11 +284,9 @@ class tile_workspace_set_data_t : public wf::custom_data_t
     {
         auto vp = _vp.value_or(wset.lock()->get_current_workspace());
         auto view_node = setup_view_tiling(view, vp);
-        {
-            autocommit_transaction_t tx;
-            roots[vp.x][vp.y]->as_split_node()->add_child(std::move(view_node), tx.tx);
-        }
 
+        autocommit_transaction_t tx;
+        roots[vp.x][vp.y]->as_split_node()->add_child(std::move(view_node), tx.tx);
         consider_exit_fullscreen(view);
     }
 
@@ -260,24 +294,23 @@ class tile_workspace_set_data_t : public wf::custom_data_t
     void detach_views(std::vector<nonstd::observer_ptr<tile::view_node_t>> views,
         bool reinsert = true)
     {
+        wf::scene::update_batch_t update_batch;
+        autocommit_transaction_t tx;
+        for (auto& v : views)
         {
-            autocommit_transaction_t tx;
-            for (auto& v : views)
-            {
-                auto view = v->view;
-                view->set_allowed_actions(VIEW_ALLOW_ALL);
-                // After this, `v` is freed.
-                v->parent->remove_child(v, tx.tx);
+            auto view = v->view;
+            view->set_allowed_actions(VIEW_ALLOW_ALL);
+            // After this, `v` is freed.
+            v->parent->remove_child(v, tx.tx);
 
-                if (view->pending_fullscreen() && view->is_mapped())
-                {
-                    wf::get_core().default_wm->fullscreen_request(view, nullptr, false);
-                }
+            if (view->pending_fullscreen() && view->is_mapped())
+            {
+                wf::get_core().default_wm->fullscreen_request(view, nullptr, false);
+            }
 
-                if (reinsert)
-                {
-                    wf::scene::readd_front(view->get_output()->wset()->get_node(), view->get_root_node());
-                }
+            if (reinsert)
+            {
+                wf::scene::readd_front(view->get_output()->wset()->get_node(), view->get_root_node());
             }
         }
 
@@ -294,6 +327,7 @@ class tile_workspace_set_data_t : public wf::custom_data_t
     {
         if (tile::view_node_t::get_node(view) && !view->pending_fullscreen())
         {
+            autocommit_transaction_t tx;
             auto vp = this->wset.lock()->get_current_workspace();
             for_each_view(roots[vp.x][vp.y], [&] (wayfire_toplevel_view view)
             {
@@ -308,7 +342,9 @@ class tile_workspace_set_data_t : public wf::custom_data_t
     void set_view_fullscreen(wayfire_toplevel_view view, bool fullscreen)
     {
         /* Set fullscreen, and trigger resizing of the views (which will commit the view) */
+        autocommit_transaction_t tx;
         view->toplevel()->pending().fullscreen = fullscreen;
+        tx.tx->add_object(view->toplevel());
         update_root_size();
     }
 };
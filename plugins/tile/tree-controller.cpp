@@ -149,7 +149,20 @@ resize_view_controller_t::resize_view_controller_t(wf::workspace_set_t *wset, wa
 }
 
 resize_view_controller_t::~resize_view_controller_t()
-{}
+{
+    flush_preview();
+}
+
+void resize_view_controller_t::flush_preview()
+{
+    preview_timer.disconnect();
+    if (preview_tx && !preview_tx->get_objects().empty())
+    {
+        wf::get_core().tx_manager->schedule_transaction(std::move(preview_tx));
+    }
+
+    preview_tx.reset();
+}
 
 uint32_t resize_view_controller_t::calculate_resizing_edges(wf::point_t grab)
 {
@@ -317,8 +330,46 @@ void resize_view_controller_t::input_motion()
         vertical_pair.second->set_geometry(g2, tx);
     }
 
-    wf::get_core().tx_manager->schedule_transaction(std::move(tx));
     this->last_point = input;
+    if (preview_interval <= 0)
+    {
+        wf::get_core().tx_manager->schedule_transaction(std::move(tx));
+        return;
+    }
+
+    // Show the views scaled to their new size until the transaction goes out.
+    if (!preview_tx)
+    {
+        preview_tx = wf::txn::transaction_t::create();
+    }
+
+    for (auto& object : tx->get_objects())
+    {
+        preview_tx->add_object(object);
+    }
+
+    for (auto& pair : {horizontal_pair, vertical_pair})
+    {
+        for (auto& node : {pair.first, pair.second})
+        {
+            if (node)
+            {
+                for_each_view(node, [] (wayfire_toplevel_view view)
+                {
+                    tile_adjust_transformer_signal ev;
+                    view->emit(&ev);
+                });
+            }
+        }
+    }
+
+    if (!preview_timer.is_connected())
+    {
+        preview_timer.set_timeout(preview_interval, [=] ()
+        {
+            flush_preview();
+        });
+    }
 }
 
 wf::point_t get_global_input_coordinates(wf::output_t *output)
@@ -4,6 +4,8 @@
 #include "tree.hpp"
 #include "wayfire/plugins/common/shared-core-data.hpp"
 #include <wayfire/option-wrapper.hpp>
+#include <wayfire/util.hpp>
+#include <wayfire/txn/transaction.hpp>
 #include <wayfire/plugins/common/move-drag-interface.hpp>
 
 /* Contains functions which are related to manipulating the tiling tree */
@@ -145,6 +147,18 @@ class resize_view_controller_t : public tile_controller_t
      */
     void adjust_geometry(int32_t& x1, int32_t& len1,
         int32_t& x2, int32_t& len2, int32_t delta);
+
+    /**
+     * With simple-tile/resize_preview_interval, the views are only scaled to their new size while resizing,
+     * and the transaction which actually resizes them is sent at most once per interval, or when the resize
+     * ends. In the meantime, the toplevels with a new pending state are collected in @preview_tx.
+     */
+    wf::option_wrapper_t<int> preview_interval{"simple-tile/resize_preview_interval"};
+    wf::txn::transaction_uptr preview_tx;
+    wf::wl_timer<false> preview_timer;
+
+    /** Send the transaction collected while previewing, if any. */
+    void flush_preview();
 };
 
 /**
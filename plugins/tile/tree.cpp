@@ -448,10 +448,16 @@ void view_node_t::set_geometry(wf::geometry_t geometry, wf::txn::transaction_upt
     }
 
     wf::get_core().default_wm->update_last_windowed_geometry(view);
-    view->toplevel()->pending().tiled_edges = TILED_EDGES_ALL;
-    tx->add_object(view->toplevel());
+    auto& pending = view->toplevel()->pending();
+    auto target   = calculate_target_geometry();
+    if ((pending.tiled_edges == TILED_EDGES_ALL) && (pending.geometry == target))
+    {
+        // Nothing changes, for example for siblings of a view which is resized, do not configure the view.
+        return;
+    }
 
-    auto target = calculate_target_geometry();
+    pending.tiled_edges = TILED_EDGES_ALL;
+    tx->add_object(view->toplevel());
     if (this->needs_crossfade() && (target != view->get_geometry()))
     {
         view->get_transformed_node()->rem_transformer(scale_transformer_name);
@@ -459,8 +465,7 @@ void view_node_t::set_geometry(wf::geometry_t geometry, wf::txn::transaction_upt
         ->adjust_target_geometry(target, -1, tx);
     } else
     {
-        view->toplevel()->pending().geometry = target;
-        tx->add_object(view->toplevel());
+        pending.geometry = target;
     }
 }
 
@@ -142,6 +142,10 @@ class workspace_switch_t
         animation.dx.set(animation.dx + cws.x - workspace.x, 0);
         animation.dy.set(animation.dy + cws.y - workspace.y, 0);
         animation.start();
+        if (prerender_workspaces)
+        {
+            wall->prerender_workspace(workspace);
+        }
 
         std::vector<wayfire_toplevel_view> fixed_views;
         if (overlay_view)
@@ -240,6 +244,7 @@ class workspace_switch_t
   protected:
     option_wrapper_t<int> gap{"vswitch/gap"};
     option_wrapper_t<color_t> background_color{"vswitch/background"};
+    option_wrapper_t<bool> prerender_workspaces{"vswitch/prerender_workspaces"};
     workspace_animation_t animation;
 
     output_t *output;
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <wayfire/view-access-interface.hpp>
+#include <algorithm>
+#include <cctype>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace wf
+{
+/**
+ * A view access interface which remembers the properties it has looked up, so that a property which is
+ * tested by many rules is computed only once per view and signal.
+ *
+ * The cache has to be invalidated whenever the view may have changed, for example after a rule has
+ * executed an action on it.
+ */
+class cached_view_access_interface_t : public view_access_interface_t
+{
+  public:
+    variant_t get(const std::string & identifier, bool & error) override
+    {
+        auto it = cache.find(identifier);
+        if (it != cache.end())
+        {
+            error = false;
+            return it->second;
+        }
+
+        auto value = view_access_interface_t::get(identifier, error);
+        if (!error)
+        {
+            cache.emplace(identifier, value);
+        }
+
+        return value;
+    }
+
+    void set_view(wayfire_view view)
+    {
+        view_access_interface_t::set_view(view);
+        invalidate();
+    }
+
+    void invalidate()
+    {
+        cache.clear();
+    }
+
+  private:
+    std::unordered_map<std::string, variant_t> cache;
+};
+
+namespace detail
+{
+/** Split a rule into quoted literals (kept with their quotes), words and the symbols ()&|!. */
+inline std::vector<std::string> tokenize_rule(const std::string& rule)
+{
+    std::vector<std::string> tokens;
+    size_t i = 0;
+    while (i < rule.size())
+    {
+        const char c = rule[i];
+        if (std::isspace((unsigned char)c))
+        {
+            ++i;
+        } else if ((c == '"') || (c == '\''))
+        {
+            std::string literal(1, c);
+            for (++i; (i < rule.size()) && (rule[i] != c); ++i)
+            {
+                if ((rule[i] == '\\') && (i + 1 < rule.size()))
+                {
+                    ++i;
+                }
+
+                literal += rule[i];
+            }
+
+            tokens.push_back(literal + c);
+            ++i;
+        } else if (std::string("()&|!").find(c) != std::string::npos)
+        {
+            tokens.emplace_back(1, c);
+            ++i;
+        } else
+        {
+            size_t end = i;
+            while ((end < rule.size()) && !std::isspace((unsigned char)rule[end]) &&
+                   (std::string("()&|!\"'").find(rule[end]) == std::string::npos))
+            {
+                ++end;
+            }
+
+            tokens.push_back(rule.substr(i, end - i));
+            i = end;
+        }
+    }
+
+    return tokens;
+}
+}
+
+/** @return The signal on which the rule is evaluated, the word after its leading "on". */
+inline std::optional<std::string> get_rule_signal(const std::string& rule)
+{
+    auto tokens = detail::tokenize_rule(rule);
+    if ((tokens.size() < 2) || (tokens[0] != "on"))
+    {
+        return {};
+    }
+
+    return tokens[1];
+}
+
+/**
+ * Find the app_id a view must have for the condition of a rule to be true.
+ *
+ * Only the simple and by far most common form is recognized, where the condition is a conjunction with an
+ * `app_id is "literal"` term at the top level. Everything else (disjunctions, negations, regexes, rules
+ * without a condition) yields no app_id, and such rules have to be tested on every view.
+ */
+inline std::optional<std::string> get_required_app_id(const std::string& rule)
+{
+    auto tokens = detail::tokenize_rule(rule);
+    auto start  = std::find(tokens.begin(), tokens.end(), "if");
+    if (start == tokens.end())
+    {
+        return {};
+    }
+
+    // The condition ends at the first "then" outside of parentheses.
+    std::vector<std::string> condition;
+    int depth = 0;
+    for (auto it = start + 1; it != tokens.end(); ++it)
+    {
+        if ((*it == "then") && (depth == 0))
+        {
+            break;
+        }
+
+        depth += (*it == "(") - (*it == ")");
+        condition.push_back(*it);
+    }
+
+    depth = 0;
+    std::optional<std::string> app_id;
+    for (size_t i = 0; i < condition.size(); i++)
+    {
+        const auto& token = condition[i];
+        depth += (token == "(") - (token == ")");
+        if (depth != 0)
+        {
+            continue;
+        }
+
+        if ((token == "|") || (token == "or") || (token == "!") || (token == "not"))
+        {
+            return {};
+        }
+
+        const bool term_start = (i == 0) || (condition[i - 1] == "&") || (condition[i - 1] == "and");
+        const bool term_end   = (i + 3 == condition.size()) ||
+            ((i + 3 < condition.size()) && ((condition[i + 3] == "&") || (condition[i + 3] == "and")));
+        if (term_start && term_end && (token == "app_id") && (i + 2 < condition.size()) &&
+            (condition[i + 1] == "is") && (condition[i + 2].size() >= 2) &&
+            ((condition[i + 2][0] == '"') || (condition[i + 2][0] == '\'')))
+        {
+            app_id = condition[i + 2].substr(1, condition[i + 2].size() - 2);
+        }
+    }
+
+    return app_id;
+}
+}
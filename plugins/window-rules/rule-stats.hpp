@@ -0,0 +1,103 @@
+#pragma once
+
+#include <wayfire/plugins/common/shared-core-data.hpp>
+#include "plugins/ipc/ipc-method-repository.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace wf
+{
+/**
+ * Statistics about the evaluation of window rules, shared by the window-rules instances of all outputs
+ * (use it via wf::shared_data::ref_ptr_t<wf::window_rules_stats_t>).
+ *
+ * The statistics are available via the window-rules/rule-stats IPC method, which lists the rules ordered by
+ * the total time spent evaluating them, so that expensive rules (for example with complicated regexes)
+ * can be found easily.
+ */
+class window_rules_stats_t
+{
+  public:
+    struct rule_stats_t
+    {
+        /** How often the rule was evaluated. */
+        uint64_t evaluations = 0;
+        /** How often the rule executed an action. */
+        uint64_t hits = 0;
+        std::chrono::nanoseconds total_time{0};
+        std::chrono::nanoseconds max_time{0};
+    };
+
+    window_rules_stats_t()
+    {
+        ipc_repo->register_method("window-rules/rule-stats", get_stats);
+    }
+
+    ~window_rules_stats_t()
+    {
+        ipc_repo->unregister_method("window-rules/rule-stats");
+    }
+
+    void record(const std::string& rule, std::chrono::nanoseconds time, bool hit)
+    {
+        auto& stats = rules[rule];
+        stats.evaluations++;
+        stats.hits       += hit;
+        stats.total_time += time;
+        stats.max_time    = std::max(stats.max_time, time);
+    }
+
+    /** Forget about the rules which are not in the given list anymore. */
+    void prune(const std::vector<std::string>& current)
+    {
+        std::set<std::string> keep(current.begin(), current.end());
+        for (auto it = rules.begin(); it != rules.end();)
+        {
+            it = keep.count(it->first) ? std::next(it) : rules.erase(it);
+        }
+    }
+
+  private:
+    std::map<std::string, rule_stats_t> rules;
+    wf::shared_data::ref_ptr_t<wf::ipc::method_repository_t> ipc_repo;
+
+    wf::ipc::method_callback get_stats = [=] (const nlohmann::json& data)
+    {
+        WFJSON_OPTIONAL_FIELD(data, "reset", boolean);
+
+        std::vector<std::pair<std::string, rule_stats_t>> sorted(rules.begin(), rules.end());
+        std::sort(sorted.begin(), sorted.end(), [] (const auto& a, const auto& b)
+        {
+            return a.second.total_time > b.second.total_time;
+        });
+
+        auto response = wf::ipc::json_ok();
+        response["rules"] = nlohmann::json::array();
+        for (auto& [rule, stats] : sorted)
+        {
+            nlohmann::json entry;
+            entry["rule"] = rule;
+            entry["evaluations"]   = stats.evaluations;
+            entry["hits"]          = stats.hits;
+            entry["total-time-us"] = stats.total_time.count() / 1000.0;
+            entry["max-time-us"]   = stats.max_time.count() / 1000.0;
+            response["rules"].push_back(entry);
+        }
+
+        if (data.value("reset", false))
+        {
+            for (auto& [_, stats] : rules)
+            {
+                stats = {};
+            }
+        }
+
+        return response;
+    };
+};
+}
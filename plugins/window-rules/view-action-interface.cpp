@@ -25,6 +25,7 @@ view_action_interface_t::~view_action_interface_t()
 bool view_action_interface_t::execute(const std::string & name,
     const std::vector<variant_t> & args)
 {
+    ++_executed;
     const auto& execute_set_alpha = [&]
     {
         auto alpha = _validate_alpha(args);
@@ -3,6 +3,7 @@
 
 #include "wayfire/action/action_interface.hpp"
 #include "wayfire/view.hpp"
+#include <cstdint>
 #include <string>
 #include <tuple>
 #include <vector>
@@ -19,6 +20,12 @@ class view_action_interface_t : public action_interface_t
 
     void set_view(wayfire_view view);
 
+    /** @return How many actions have been executed so far, used to detect changes to the view. */
+    uint64_t get_executed_count() const
+    {
+        return _executed;
+    }
+
   private:
     void _maximize();
     void _unmaximize();
@@ -56,6 +63,7 @@ class view_action_interface_t : public action_interface_t
 
     wayfire_toplevel_view _view;
     wayfire_view _nontoplevel;
+    uint64_t _executed = 0;
 };
 } // End namespace wf.
 
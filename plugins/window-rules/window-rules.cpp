@@ -1,4 +1,6 @@
+#include <chrono>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include <wayfire/per-output-plugin.hpp>
@@ -16,6 +18,8 @@
 #include <wayfire/toplevel-view.hpp>
 
 #include "lambda-rules-registration.hpp"
+#include "rule-index.hpp"
+#include "rule-stats.hpp"
 #include "view-action-interface.hpp"
 #include "wayfire/signal-provider.hpp"
 
@@ -27,6 +31,8 @@ class wayfire_window_rules_t : public wf::per_output_plugin_instance_t
     void apply(const std::string & signal, wayfire_view view);
 
   private:
+    struct indexed_rules_t;
+    void apply_rules(const std::string & signal, wayfire_view view, const indexed_rules_t& rules);
     void setup_rules_from_config();
     wf::lexer_t _lexer;
 
@@ -58,12 +64,28 @@ class wayfire_window_rules_t : public wf::per_output_plugin_instance_t
     // Auto-reload on changes to config file
     wf::signal::connection_t<wf::reload_config_signal> _reload_config = [=] (wf::reload_config_signal *ev)
     {
-        setup_rules_from_config();
+        if (ev->may_have_changed("window-rules"))
+        {
+            setup_rules_from_config();
+        }
     };
 
     std::vector<std::shared_ptr<wf::rule_t>> _rules;
+    std::vector<std::string> _rule_texts;
+
+    /** Indices of the rules evaluated on one signal. */
+    struct indexed_rules_t
+    {
+        // Rules which can match only views with a certain app_id
+        std::unordered_map<std::string, std::vector<size_t>> by_app_id;
+        // All other rules
+        std::vector<size_t> generic;
+    };
 
-    wf::view_access_interface_t _access_interface;
+    std::unordered_map<std::string, indexed_rules_t> _rules_by_signal;
+    wf::shared_data::ref_ptr_t<wf::window_rules_stats_t> _stats;
+
+    wf::cached_view_access_interface_t _access_interface;
     wf::view_action_interface_t _action_interface;
 
     nonstd::observer_ptr<wf::lambda_rules_registrations_t> _lambda_registrations;
@@ -111,15 +133,10 @@ void wayfire_window_rules_t::apply(const std::string & signal, wayfire_view view
         return;
     }
 
-    for (const auto & rule : _rules)
+    auto indexed = _rules_by_signal.find(signal);
+    if (indexed != _rules_by_signal.end())
     {
-        _access_interface.set_view(view);
-        _action_interface.set_view(view);
-        auto error = rule->apply(signal, _access_interface, _action_interface);
-        if (error)
-        {
-            LOGE("Window-rules: Error while executing rule on ", signal, " signal.");
-        }
+        apply_rules(signal, view, indexed->second);
     }
 
     auto bounds = _lambda_registrations->rules();
@@ -177,9 +194,61 @@ void wayfire_window_rules_t::apply(const std::string & signal, wayfire_view view
     }
 }
 
+void wayfire_window_rules_t::apply_rules(const std::string & signal, wayfire_view view,
+    const indexed_rules_t& rules)
+{
+    _access_interface.set_view(view);
+    _action_interface.set_view(view);
+
+    // Only the rules for the app_id of the view and the generic ones can match. They are merged by their
+    // index, so that they run in the order of the config file.
+    static const std::vector<size_t> no_rules;
+    bool error = false;
+    auto app_id    = _access_interface.get("app_id", error);
+    auto by_app_id = error ? rules.by_app_id.end() : rules.by_app_id.find(wf::get_string(app_id));
+    const auto& specific = (by_app_id != rules.by_app_id.end()) ? by_app_id->second : no_rules;
+
+    size_t next_specific = 0, next_generic = 0;
+    while ((next_specific < specific.size()) || (next_generic < rules.generic.size()))
+    {
+        size_t index;
+        if ((next_generic == rules.generic.size()) ||
+            ((next_specific < specific.size()) && (specific[next_specific] < rules.generic[next_generic])))
+        {
+            index = specific[next_specific++];
+        } else
+        {
+            index = rules.generic[next_generic++];
+        }
+
+        const uint64_t executed = _action_interface.get_executed_count();
+        auto start = std::chrono::steady_clock::now();
+        if (_rules[index]->apply(signal, _access_interface, _action_interface))
+        {
+            LOGE("Window-rules: Error while executing rule on ", signal, " signal.");
+        }
+
+        const bool hit = (_action_interface.get_executed_count() != executed);
+        _stats->record(_rule_texts[index], std::chrono::steady_clock::now() - start, hit);
+
+        // The view may have changed, so cached properties cannot be trusted anymore.
+        if (hit)
+        {
+            _access_interface.invalidate();
+        }
+    }
+}
+
 void wayfire_window_rules_t::setup_rules_from_config()
 {
     _rules.clear();
+    _rule_texts.clear();
+    _rules_by_signal.clear();
+
+    // The signals on which rules are evaluated, see apply().
+    static const std::vector<std::string> signals = {
+        "created", "maximized", "unmaximized", "minimized", "fullscreened"
+    };
 
     wf::option_wrapper_t<wf::config::compound_list_t<std::string>> rule_list_option{"window-rules/rules"};
     auto rule_list = rule_list_option.value();
@@ -189,11 +258,30 @@ void wayfire_window_rules_t::setup_rules_from_config()
         LOGD("Registering ", rule_str);
         _lexer.reset(rule_str);
         auto rule = wf::rule_parser_t().parse(_lexer);
-        if (rule != nullptr)
+        if (rule == nullptr)
         {
-            _rules.push_back(rule);
+            continue;
         }
+
+        auto signal = wf::get_rule_signal(rule_str);
+        auto app_id = wf::get_required_app_id(rule_str);
+        for (const auto& candidate : signals)
+        {
+            if (signal && (*signal != candidate))
+            {
+                continue;
+            }
+
+            auto& indexed = _rules_by_signal[candidate];
+            auto& list    = app_id ? indexed.by_app_id[*app_id] : indexed.generic;
+            list.push_back(_rules.size());
+        }
+
+        _rules.push_back(rule);
+        _rule_texts.push_back(rule_str);
     }
+
+    _stats->prune(_rule_texts);
 }
 
 DECLARE_WAYFIRE_PLUGIN(wf::per_output_plugin_t<wayfire_window_rules_t>);
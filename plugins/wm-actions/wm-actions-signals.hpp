@@ -28,4 +28,16 @@ struct wm_actions_above_changed_signal
 {
     wayfire_view view;
 };
+
+/**
+ * on: output
+ * when: Emitted once when show-desktop is toggled on the output, instead of a state change of each view.
+ */
+struct wm_actions_showdesktop_changed_signal
+{
+    wf::output_t *output;
+
+    /** Whether the views of the output are now hidden. */
+    bool active;
+};
 }
@@ -33,6 +33,8 @@ class wayfire_wm_actions_output_t : public wf::per_output_plugin_instance_t
 {
     wf::scene::floating_inner_ptr always_above;
     bool showdesktop_active = false;
+    /** The nodes disabled while show-desktop is active */
+    std::vector<wf::scene::node_ptr> showdesktop_hidden;
 
     wf::option_wrapper_t<wf::activatorbinding_t> minimize{
         "wm-actions/minimize"};
@@ -54,6 +56,23 @@ class wayfire_wm_actions_output_t : public wf::per_output_plugin_instance_t
 
   public:
 
+    /**
+     * Move the view to the front of @parent. The scenegraph updates are batched, so that the render
+     * instances of the output are regenerated once, and nothing happens if the view is already there.
+     */
+    void move_to_front(wf::scene::floating_inner_ptr parent, wayfire_view view)
+    {
+        auto root = view->get_root_node();
+        if (root->parent() == parent.get())
+        {
+            wf::scene::raise_to_front(root);
+            return;
+        }
+
+        wf::scene::update_batch_t batch;
+        wf::scene::readd_front(parent, root);
+    }
+
     bool set_keep_above_state(wayfire_view view, bool above)
     {
         if (!view || !output->can_activate_plugin(&grab_interface))
@@ -63,12 +82,12 @@ class wayfire_wm_actions_output_t : public wf::per_output_plugin_instance_t
 
         if (above)
         {
-            wf::scene::readd_front(always_above, view->get_root_node());
+            move_to_front(always_above, view);
             view->store_data(std::make_unique<wf::custom_data_t>(),
                 "wm-actions-above");
         } else
         {
-            wf::scene::readd_front(output->wset()->get_node(), view->get_root_node());
+            move_to_front(output->wset()->get_node(), view);
             if (view->has_data("wm-actions-above"))
             {
                 view->erase_data("wm-actions-above");
@@ -131,7 +150,7 @@ class wayfire_wm_actions_output_t : public wf::per_output_plugin_instance_t
 
         if (view->has_data("wm-actions-above"))
         {
-            wf::scene::readd_front(always_above, view->get_root_node());
+            move_to_front(always_above, view);
         }
     };
 
@@ -149,7 +168,7 @@ class wayfire_wm_actions_output_t : public wf::per_output_plugin_instance_t
 
         if (ev->view->has_data("wm-actions-above") && !ev->view->minimized)
         {
-            wf::scene::readd_front(always_above, ev->view->get_root_node());
+            move_to_front(always_above, ev->view);
         }
     };
 
@@ -184,6 +203,12 @@ class wayfire_wm_actions_output_t : public wf::per_output_plugin_instance_t
         disable_showdesktop();
     };
 
+    wf::signal::connection_t<wf::workspace_set_changed_signal> wset_changed =
+        [=] (wf::workspace_set_changed_signal *ev)
+    {
+        disable_showdesktop();
+    };
+
     wf::signal::connection_t<wf::view_minimized_signal> view_minimized = [=] (wf::view_minimized_signal *ev)
     {
         if ((ev->view->role != wf::VIEW_ROLE_TOPLEVEL) || !ev->view->is_mapped())
@@ -265,33 +290,49 @@ class wayfire_wm_actions_output_t : public wf::per_output_plugin_instance_t
         });
     };
 
+    /**
+     * Show the desktop by disabling the subtrees of the workspace set and the always-on-top views, instead
+     * of minimizing each view. The views keep their state, so no per-view signals are emitted, and the
+     * render instances of the output are regenerated once.
+     */
     bool on_toggle_showdesktop()
     {
-        showdesktop_active = !showdesktop_active;
-
         if (showdesktop_active)
         {
-            for (auto& view : output->wset()->get_views())
-            {
-                if (!view->minimized)
-                {
-                    wf::get_core().default_wm->minimize_request(view, true);
-                    view->store_data(std::make_unique<wf::custom_data_t>(), "wm-actions-showdesktop");
-                }
-            }
-
-            output->connect(&view_set_output);
-            output->connect(&workspace_changed);
-            output->connect(&view_minimized);
-            output->connect(&on_view_mapped);
+            disable_showdesktop();
             return true;
         }
 
-        disable_showdesktop();
+        showdesktop_active = true;
+        showdesktop_hidden = {output->wset()->get_node(), always_above};
+        set_showdesktop_nodes_enabled(false);
 
+        output->connect(&view_set_output);
+        output->connect(&workspace_changed);
+        output->connect(&wset_changed);
+        output->connect(&view_minimized);
+        output->connect(&on_view_mapped);
         return true;
     }
 
+    void set_showdesktop_nodes_enabled(bool enabled)
+    {
+        {
+            wf::scene::update_batch_t batch;
+            for (auto& node : showdesktop_hidden)
+            {
+                wf::scene::set_node_enabled(node, enabled);
+            }
+
+            wf::scene::update(wf::get_core().scene(), wf::scene::update_flag::REFOCUS);
+        }
+
+        wf::wm_actions_showdesktop_changed_signal data;
+        data.output = output;
+        data.active = showdesktop_active;
+        output->emit(&data);
+    }
+
     void do_send_to_back(wayfire_view view)
     {
         auto view_root = view->get_root_node();
@@ -341,19 +382,17 @@ class wayfire_wm_actions_output_t : public wf::per_output_plugin_instance_t
     {
         view_set_output.disconnect();
         workspace_changed.disconnect();
+        wset_changed.disconnect();
         view_minimized.disconnect();
-
-        auto views = output->wset()->get_views(wf::WSET_SORT_STACKING);
-        for (auto& view : wf::reverse(views))
+        on_view_mapped.disconnect();
+        if (!showdesktop_active)
         {
-            if (view->has_data("wm-actions-showdesktop"))
-            {
-                view->erase_data("wm-actions-showdesktop");
-                wf::get_core().default_wm->minimize_request(view, false);
-            }
+            return;
         }
 
         showdesktop_active = false;
+        set_showdesktop_nodes_enabled(true);
+        showdesktop_hidden.clear();
     }
 
   public:
@@ -374,6 +413,7 @@ class wayfire_wm_actions_output_t : public wf::per_output_plugin_instance_t
 
     void fini() override
     {
+        disable_showdesktop();
         for (auto view : output->wset()->get_views())
         {
             if (view->has_data("wm-actions-above"))
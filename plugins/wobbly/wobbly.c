@@ -370,38 +370,12 @@ static int modelStep(Model *model, float friction, float k, float time)
     return wobbly;
 }
 
-static void bezierPatchEvaluate (Model *model, float u, float v,
-        float *patchX, float *patchY)
+static void bezierCoefficients(float t, float *coeffs)
 {
-    float coeffsU[4], coeffsV[4];
-    float x, y;
-    int   i, j;
-
-    coeffsU[0] = (1 - u) * (1 - u) * (1 - u);
-    coeffsU[1] = 3 * u * (1 - u) * (1 - u);
-    coeffsU[2] = 3 * u * u * (1 - u);
-    coeffsU[3] = u * u * u;
-
-    coeffsV[0] = (1 - v) * (1 - v) * (1 - v);
-    coeffsV[1] = 3 * v * (1 - v) * (1 - v);
-    coeffsV[2] = 3 * v * v * (1 - v);
-    coeffsV[3] = v * v * v;
-
-    x = y = 0.0f;
-
-    for (i = 0; i < 4; i++)
-    {
-        for (j = 0; j < 4; j++)
-        {
-            x += coeffsU[i] * coeffsV[j] *
-                model->objects[j * GRID_WIDTH + i].position.x;
-            y += coeffsU[i] * coeffsV[j] *
-                model->objects[j * GRID_HEIGHT + i].position.y;
-        }
-    }
-
-    *patchX = x;
-    *patchY = y;
+    coeffs[0] = (1 - t) * (1 - t) * (1 - t);
+    coeffs[1] = 3 * t * (1 - t) * (1 - t);
+    coeffs[2] = 3 * t * t * (1 - t);
+    coeffs[3] = t * t * t;
 }
 
 static int wobblyEnsureModel(struct wobbly_surface *surface)
@@ -552,42 +526,61 @@ void wobbly_add_geometry(struct wobbly_surface *surface)
 {
     WobblyWindow *ww = surface->ww;
 
-    float    width, height;
-    float    deformedX, deformedY;
-    int      x, y, iw, ih;
-    float    cell_w, cell_h;
+    float    coeffsU[4], coeffsV[4];
+    Point    column[4];
+    int      x, y, i, j, iw, ih;
     GLfloat  *v, *uv;
 
     if (ww->wobbly)
     {
-        width  = surface->width;
-        height = surface->height;
-
-        cell_w = width / surface->x_cells;
-        cell_h = height / surface->y_cells;
-
         iw = surface->x_cells + 1;
         ih = surface->y_cells + 1;
 
-        v = realloc(surface->v, sizeof(GLfloat) * 2 * iw * ih);
-        uv = realloc(surface->uv, sizeof(GLfloat) * 2 * iw * ih);
+        /* The texture coordinates only change with the grid */
+        if (surface->vertex_count != iw * ih)
+        {
+            surface->v = realloc(surface->v, sizeof(GLfloat) * 2 * iw * ih);
+            surface->uv = realloc(surface->uv, sizeof(GLfloat) * 2 * iw * ih);
+            surface->vertex_count = iw * ih;
 
-        surface->v = v;
-        surface->uv = uv;
+            uv = surface->uv;
+            for (y = 0; y < ih; y++)
+            {
+                for (x = 0; x < iw; x++)
+                {
+                    *uv++ = (float) x / surface->x_cells;
+                    *uv++ = 1.0 - (float) y / surface->y_cells;
+                }
+            }
+        }
 
+        /*
+         * The bezier patch is separable, so for each row the control points
+         * of every column are blended first, and the row is evaluated
+         * from the four resulting points.
+         */
+        v = surface->v;
         for (y = 0; y < ih; y++)
         {
-            for (x = 0; x < iw; x++)
+            bezierCoefficients((float) y / surface->y_cells, coeffsV);
+            for (i = 0; i < 4; i++)
             {
-                bezierPatchEvaluate(ww->model,
-                        (x * cell_w) / width, (y * cell_h) / height,
-                        &deformedX, &deformedY);
+                column[i].x = column[i].y = 0.0f;
+                for (j = 0; j < 4; j++)
+                {
+                    column[i].x += coeffsV[j] * ww->model->objects[j * GRID_WIDTH + i].position.x;
+                    column[i].y += coeffsV[j] * ww->model->objects[j * GRID_WIDTH + i].position.y;
+                }
+            }
 
-                *v++ = deformedX;
-                *v++ = deformedY;
+            for (x = 0; x < iw; x++)
+            {
+                bezierCoefficients((float) x / surface->x_cells, coeffsU);
 
-                *uv++ = (x * cell_w) / width;
-                *uv++ = 1.0 - ((y * cell_h) / height);
+                *v++ = coeffsU[0] * column[0].x + coeffsU[1] * column[1].x +
+                    coeffsU[2] * column[2].x + coeffsU[3] * column[3].x;
+                *v++ = coeffsU[0] * column[0].y + coeffsU[1] * column[1].y +
+                    coeffsU[2] * column[2].y + coeffsU[3] * column[3].y;
             }
         }
     }
@@ -756,6 +749,7 @@ void wobbly_fini(struct wobbly_surface *surface)
         free(ww->model->objects);
         free(ww->model);
         free(surface->v);
+        free(surface->uv);
     }
 
     free (ww);
@@ -863,3 +857,32 @@ struct wobbly_rect wobbly_boundingbox(struct wobbly_surface *surface)
 
     return result;
 }
+
+float wobbly_deformation(struct wobbly_surface *surface)
+{
+    WobblyWindow *ww = surface->ww;
+    float deformation = 0.0f;
+    float restX, restY;
+    int   gridX, gridY;
+    Object *o;
+
+    if (!ww->model)
+        return 0.0f;
+
+    for (gridY = 0; gridY < GRID_HEIGHT; gridY++)
+    {
+        for (gridX = 0; gridX < GRID_WIDTH; gridX++)
+        {
+            o = &ww->model->objects[gridY * GRID_WIDTH + gridX];
+            restX = ww->model->topLeft.x + gridX *
+                (ww->model->bottomRight.x - ww->model->topLeft.x) / (GRID_WIDTH - 1);
+            restY = ww->model->topLeft.y + gridY *
+                (ww->model->bottomRight.y - ww->model->topLeft.y) / (GRID_HEIGHT - 1);
+
+            deformation = fmaxf(deformation, fabsf(o->position.x - restX));
+            deformation = fmaxf(deformation, fabsf(o->position.y - restY));
+        }
+    }
+
+    return deformation;
+}
@@ -1,6 +1,8 @@
 #include "wayfire/debug.hpp"
 #include "wayfire/opengl.hpp"
 #include "wayfire/region.hpp"
+#include <algorithm>
+#include <cmath>
 #include <memory>
 #include <wayfire/plugin.hpp>
 #include <wayfire/signal-definitions.hpp>
@@ -51,62 +53,78 @@ void main()
 }
 
 /**
- * Enumerate the needed triangles for rendering the model
+ * The vertices of the model and the triangles connecting them.
+ *
+ * The model keeps its vertices as a grid, which is drawn directly with an index list. The indices only
+ * depend on the grid size, so they are generated once.
  */
-void prepare_geometry(wobbly_surface *model, wf::geometry_t src_box,
-    std::vector<float>& vert, std::vector<float>& uv)
+struct model_geometry_t
 {
-    float x = src_box.x, y = src_box.y, w = src_box.width, h = src_box.height;
-    std::vector<int> idx;
+    std::vector<GLuint> indices;
+    int x_cells = 0, y_cells = 0;
 
-    int per_row = model->x_cells + 1;
+    /* Used until the model has computed its own vertices */
+    std::vector<float> flat_vert, flat_uv;
 
-    for (int j = 0; j < model->y_cells; j++)
+    void update_indices(wobbly_surface *model)
     {
-        for (int i = 0; i < model->x_cells; i++)
+        if ((x_cells == model->x_cells) && (y_cells == model->y_cells))
         {
-            idx.push_back(i * per_row + j);
-            idx.push_back((i + 1) * per_row + j + 1);
-            idx.push_back(i * per_row + j + 1);
-
-            idx.push_back(i * per_row + j);
-            idx.push_back((i + 1) * per_row + j);
-            idx.push_back((i + 1) * per_row + j + 1);
+            return;
         }
-    }
-
-    if (!model->v || !model->uv)
-    {
-        for (auto id : idx)
-        {
-            float tile_w = w / model->x_cells;
-            float tile_h = h / model->y_cells;
 
-            int i = id / per_row;
-            int j = id % per_row;
+        x_cells = model->x_cells;
+        y_cells = model->y_cells;
 
-            vert.push_back(i * tile_w + x);
-            vert.push_back(j * tile_h + y);
+        const int per_row = x_cells + 1;
+        indices.clear();
+        for (int j = 0; j < y_cells; j++)
+        {
+            for (int i = 0; i < x_cells; i++)
+            {
+                indices.push_back(j * per_row + i);
+                indices.push_back((j + 1) * per_row + i + 1);
+                indices.push_back((j + 1) * per_row + i);
 
-            uv.push_back(1.0f * i / model->x_cells);
-            uv.push_back(1.0f - 1.0f * j / model->y_cells);
+                indices.push_back(j * per_row + i);
+                indices.push_back(j * per_row + i + 1);
+                indices.push_back((j + 1) * per_row + i + 1);
+            }
         }
-    } else
+    }
+
+    /**
+     * Get the vertex positions and texture coordinates of the model.
+     * @param src_box The geometry of the view, used if the model has no vertices yet.
+     */
+    std::pair<const float*, const float*> get_vertices(wobbly_surface *model, wf::geometry_t src_box)
     {
-        for (auto i : idx)
+        update_indices(model);
+        if (model->v && model->uv)
         {
-            vert.push_back(model->v[2 * i]);
-            vert.push_back(model->v[2 * i + 1]);
+            return {model->v, model->uv};
+        }
 
-            uv.push_back(model->uv[2 * i]);
-            uv.push_back(model->uv[2 * i + 1]);
+        flat_vert.clear();
+        flat_uv.clear();
+        for (int j = 0; j <= y_cells; j++)
+        {
+            for (int i = 0; i <= x_cells; i++)
+            {
+                flat_vert.push_back(src_box.x + 1.0f * i * src_box.width / x_cells);
+                flat_vert.push_back(src_box.y + 1.0f * j * src_box.height / y_cells);
+                flat_uv.push_back(1.0f * i / x_cells);
+                flat_uv.push_back(1.0f - 1.0f * j / y_cells);
+            }
         }
+
+        return {flat_vert.data(), flat_uv.data()};
     }
-}
+};
 
 /* Requires bound opengl context */
-void render_triangles(OpenGL::program_t *program, wf::texture_t tex, glm::mat4 mat, float *pos, float *uv,
-    int cnt)
+void render_triangles(OpenGL::program_t *program, wf::texture_t tex, glm::mat4 mat, const float *pos,
+    const float *uv, const std::vector<GLuint>& indices)
 {
     program->use(tex.type);
     program->set_active_texture(tex);
@@ -118,7 +136,7 @@ void render_triangles(OpenGL::program_t *program, wf::texture_t tex, glm::mat4 m
     GL_CALL(glEnable(GL_BLEND));
     GL_CALL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
 
-    GL_CALL(glDrawArrays(GL_TRIANGLES, 0, 3 * cnt));
+    GL_CALL(glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, indices.data()));
     GL_CALL(glDisable(GL_BLEND));
 
     program->deactivate();
@@ -582,6 +600,23 @@ class wobbly_transformer_node_t : public wf::scene::transformer_base_node_t
 
     std::unique_ptr<wobbly_surface> model;
 
+    /**
+     * @return Whether the model is an undeformed rectangle covering the view, so that the view can be
+     *   rendered directly instead of through the mesh.
+     */
+    bool matches_view()
+    {
+        if (!at_rest)
+        {
+            return false;
+        }
+
+        auto box = wobbly_boundingbox(model.get());
+        auto g   = get_children_bounding_box();
+        return (std::abs(box.tlx - g.x) < 0.5) && (std::abs(box.tly - g.y) < 0.5) &&
+               (std::abs(box.brx - (g.x + g.width)) < 0.5) && (std::abs(box.bry - (g.y + g.height)) < 0.5);
+    }
+
     void destroy_self()
     {
         view->get_transformed_node()->rem_transformer("wobbly");
@@ -592,6 +627,44 @@ class wobbly_transformer_node_t : public wf::scene::transformer_base_node_t
   private:
     wayfire_toplevel_view view;
 
+    /* Below this deformation in pixels the model is drawn as a single quad */
+    static constexpr float REST_DEFORMATION = 0.5;
+    /* The deformation in pixels from which the grid uses the full resolution */
+    static constexpr float FULL_DEFORMATION = 8.0;
+    /* The smallest size of a grid cell on screen, in pixels */
+    static constexpr int MIN_CELL_SIZE = 16;
+    bool at_rest = false;
+
+    /**
+     * Adapt the grid to the size of the view and how much the model is deformed. The grid resolution
+     * option is the maximal number of cells on each axis.
+     */
+    void update_mesh_density()
+    {
+        const float deformation = wobbly_deformation(model.get());
+        at_rest = deformation < REST_DEFORMATION;
+
+        // Under load, the output may ask for a coarser mesh, see render_manager::get_effect_quality().
+        auto output          = view->get_output();
+        const double quality = output ? output->render->get_effect_quality("wobbly") : 1.0;
+        const int resolution = std::max(1, (int)std::round(wobbly_settings::resolution * quality));
+        const float density  = std::min(1.0f, deformation / FULL_DEFORMATION);
+        auto cells_for = [&] (int size)
+        {
+            if (at_rest)
+            {
+                return 1;
+            }
+
+            const int max_cells = std::clamp(size / MIN_CELL_SIZE, 1, resolution);
+            return std::clamp((int)std::ceil(max_cells * density), 1, max_cells);
+        };
+
+        auto box = wobbly_boundingbox(model.get());
+        model->x_cells = cells_for(box.brx - box.tlx);
+        model->y_cells = cells_for(box.bry - box.tly);
+    }
+
     wf::signal::connection_t<wf::view_unmapped_signal> on_view_unmap = [=] (wf::view_unmapped_signal*)
     {
         destroy_self();
@@ -641,7 +714,7 @@ class wobbly_transformer_node_t : public wf::scene::transformer_base_node_t
     };
 
     std::unique_ptr<wf::iwobbly_state_t> state;
-    uint32_t last_frame;
+    int64_t last_frame;
     bool force_tile = false;
 
     void init_model()
@@ -662,6 +735,7 @@ class wobbly_transformer_node_t : public wf::scene::transformer_base_node_t
 
         model->v  = NULL;
         model->uv = NULL;
+        model->vertex_count = 0;
         wobbly_init(model.get());
     }
 
@@ -676,8 +750,10 @@ class wobbly_transformer_node_t : public wf::scene::transformer_base_node_t
         state->handle_frame();
         view->connect(&on_view_geometry_changed);
 
-        /* Update all the wobbly model */
-        auto now = wf::get_current_time();
+        /* Update all the wobbly model, as it will be when the frame is shown */
+        auto output = view->get_output();
+        int64_t now = output ? output->render->get_predicted_presentation_time() / 1000 :
+            wf::get_current_time();
 
         if (now > last_frame)
         {
@@ -685,6 +761,7 @@ class wobbly_transformer_node_t : public wf::scene::transformer_base_node_t
             wobbly_prepare_paint(model.get(), now - last_frame);
             /* Update wobbly geometry */
             last_frame = now;
+            update_mesh_density();
             wobbly_add_geometry(model.get());
             wobbly_done_paint(model.get());
             view->get_transformed_node()->end_transform_update();
@@ -847,6 +924,7 @@ class wobbly_render_instance_t :
 {
     wf::output_t *wo = nullptr;
     wf::effect_hook_t pre_hook;
+    wobbly_graphics::model_geometry_t geometry;
 
   public:
     wobbly_render_instance_t(wobbly_transformer_node_t *self, wf::scene::damage_callback push_damage,
@@ -873,22 +951,35 @@ class wobbly_render_instance_t :
         damage |= self->get_bounding_box();
     }
 
+    void schedule_instructions(std::vector<wf::scene::render_instruction_t>& instructions,
+        const wf::render_target_t& target, wf::region_t& damage) override
+    {
+        if (self->matches_view())
+        {
+            // Nothing is deformed, so the view is drawn as it is, without the mesh and its buffer.
+            for (auto& ch : children)
+            {
+                ch->schedule_instructions(instructions, target, damage);
+            }
+
+            return;
+        }
+
+        transformer_render_instance_t::schedule_instructions(instructions, target, damage);
+    }
+
     void render(const wf::render_target_t& target_fb,
         const wf::region_t& damage) override
     {
-        std::vector<float> vert, uv;
         auto subbox = self->get_children_bounding_box();
-
-        wobbly_graphics::prepare_geometry(self->model.get(), subbox, vert, uv);
+        auto [vert, uv] = geometry.get_vertices(self->model.get(), subbox);
         auto tex = get_texture(target_fb.scale);
         OpenGL::render_begin(target_fb);
         for (auto& box : damage)
         {
             target_fb.logic_scissor(wlr_box_from_pixman_box(box));
             wobbly_graphics::render_triangles(self->wobbly_program, tex,
-                target_fb.get_orthographic_projection(),
-                vert.data(), uv.data(),
-                self->model->x_cells * self->model->y_cells * 2);
+                target_fb.get_orthographic_projection(), vert, uv, geometry.indices);
         }
 
         OpenGL::render_end();
@@ -52,6 +52,10 @@ void wobbly_done_paint(struct wobbly_surface *surface);
 void wobbly_add_geometry(struct wobbly_surface *surface);
 struct wobbly_rect wobbly_boundingbox(struct wobbly_surface *surface);
 
+/* The largest distance (in pixels) of a control point from where it would be
+ * if the model was an undeformed rectangle filling its bounding box. */
+float wobbly_deformation(struct wobbly_surface *surface);
+
 void wobbly_force_geometry(struct wobbly_surface *surface,
     int x, int y, int w, int h);
 void wobbly_unenforce_geometry(struct wobbly_surface *surface);
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <list>
+#include <memory>
+#include <optional>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+    #include <coroutine>
+    #define WF_HAS_COROUTINES 1
+#endif
+
+namespace wf
+{
+class output_t;
+namespace txn
+{
+class transaction_t;
+}
+
+namespace async
+{
+/**
+ * Multi-step flows over the Wayland event loop, like "wait for a transaction, animate, wait for the frame".
+ *
+ * Each wait belongs to a scope, usually a member of the plugin or of the object which runs the flow. When the
+ * scope is destroyed or cancelled, its pending waits are dropped and their callbacks never run, so that a flow
+ * cannot outlive the object it works on.
+ *
+ * The waits take a callback:
+ *
+ *   scope.transaction_applied(*tx, [=] (bool) { start_animation(); });
+ *   wf::get_core().tx_manager->schedule_transaction(std::move(tx));
+ *
+ * Plugins built with C++20 can instead co_await them in a coroutine returning wf::async::task_t. A coroutine
+ * which waits on a cancelled scope is destroyed at the wait, along with its local variables:
+ *
+ *   wf::async::task_t run_flow()
+ *   {
+ *       bool timed_out = co_await scope.transaction_applied(*tx);
+ *       start_animation();
+ *       co_await scope.sleep(300);
+ *       co_await scope.next_frame(output);
+ *   }
+ */
+class scope_t
+{
+  public:
+    scope_t();
+    /** Cancels all pending waits */
+    ~scope_t();
+
+    /** Drop all pending waits, their callbacks are not called. */
+    void cancel();
+    /** The number of pending waits */
+    size_t pending() const;
+
+    // @on_cancel is called instead of @callback if the wait is dropped, see cancel().
+
+    /** Call @callback the next time the event loop is idle. */
+    void idle(std::function<void()> callback, std::function<void()> on_cancel = {});
+    /** Call @callback after @timeout_ms milliseconds. */
+    void sleep(uint32_t timeout_ms, std::function<void()> callback, std::function<void()> on_cancel = {});
+    /** Call @callback when the next frame of @output has been presented. A redraw is scheduled. */
+    void next_frame(wf::output_t *output, std::function<void()> callback,
+        std::function<void()> on_cancel = {});
+    /**
+     * Call @callback with whether it timed out once @tx is applied. Has to be called before @tx is scheduled,
+     * because the transaction manager may apply and free it immediately.
+     */
+    void transaction_applied(txn::transaction_t& tx, std::function<void(bool)> callback,
+        std::function<void()> on_cancel = {});
+
+    scope_t(const scope_t&) = delete;
+    scope_t(scope_t&&) = delete;
+    scope_t& operator =(const scope_t&) = delete;
+    scope_t& operator =(scope_t&&) = delete;
+
+#ifdef WF_HAS_COROUTINES
+    template<class Result>
+    struct awaitable_t;
+
+    awaitable_t<void> idle();
+    awaitable_t<void> sleep(uint32_t timeout_ms);
+    awaitable_t<void> next_frame(wf::output_t *output);
+    awaitable_t<bool> transaction_applied(txn::transaction_t& tx);
+#endif
+
+  private:
+    struct wait_t;
+    std::list<std::unique_ptr<wait_t>> waits;
+
+    wait_t& add_wait(std::function<void()> on_cancel);
+    /** Remove @wait and call its cancel callback. */
+    void drop(wait_t *wait);
+    /** Remove @wait and call @callback. Must be the last use of the event source of the wait. */
+    void fire(wait_t *wait, std::function<void()> callback);
+};
+
+#ifdef WF_HAS_COROUTINES
+/** A coroutine which starts immediately and is not awaited by anyone. */
+struct task_t
+{
+    struct promise_type
+    {
+        task_t get_return_object()
+        {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void()
+        {}
+
+        void unhandled_exception()
+        {
+            std::terminate();
+        }
+    };
+};
+
+template<class Result>
+struct scope_t::awaitable_t
+{
+    // Starts the wait with the function which resumes the coroutine and with the function which destroys it
+    std::function<void(std::function<void(Result)>, std::function<void()>)> start;
+    std::optional<Result> result;
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        start([this, handle] (Result value)
+        {
+            result = value;
+            handle.resume();
+        }, [handle] { handle.destroy(); });
+    }
+
+    Result await_resume()
+    {
+        return *result;
+    }
+};
+
+template<>
+struct scope_t::awaitable_t<void>
+{
+    std::function<void(std::function<void()>, std::function<void()>)> start;
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        start([handle] { handle.resume(); }, [handle] { handle.destroy(); });
+    }
+
+    void await_resume()
+    {}
+};
+
+inline scope_t::awaitable_t<void> scope_t::idle()
+{
+    return {[this] (auto resume, auto destroy)
+        {
+            idle(std::move(resume), std::move(destroy));
+        }
+    };
+}
+
+inline scope_t::awaitable_t<void> scope_t::sleep(uint32_t timeout_ms)
+{
+    return {[this, timeout_ms] (auto resume, auto destroy)
+        {
+            sleep(timeout_ms, std::move(resume), std::move(destroy));
+        }
+    };
+}
+
+inline scope_t::awaitable_t<void> scope_t::next_frame(wf::output_t *output)
+{
+    return {[this, output] (auto resume, auto destroy)
+        {
+            next_frame(output, std::move(resume), std::move(destroy));
+        }
+    };
+}
+
+inline scope_t::awaitable_t<bool> scope_t::transaction_applied(txn::transaction_t& tx)
+{
+    return {[this, &tx] (auto resume, auto destroy)
+        {
+            transaction_applied(tx, std::move(resume), std::move(destroy));
+        }
+    };
+}
+#endif
+}
+}
@@ -72,6 +72,12 @@ class bindings_repository_t
     /** Handle a gesture from the user. */
     void handle_gesture(const wf::touchgesture_t& gesture);
 
+    /**
+     * Check whether any binding can be triggered by a touchscreen gesture of the given type. Gestures of
+     * other types do not need to be recognized at all.
+     */
+    bool has_gesture_bindings(wf::touch_gesture_type_t type);
+
     /**
      * Trigger all extension bindings which match the given tag.
      *
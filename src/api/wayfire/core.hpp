@@ -52,6 +52,7 @@ class output_layout_t;
 class input_device_t;
 class bindings_repository_t;
 class seat_t;
+class thread_pool_t;
 
 /** Describes the state of the compositor */
 enum class compositor_state_t
@@ -112,6 +113,7 @@ class compositor_core_t : public wf::object_base_t, public signal::provider_t
     std::unique_ptr<wf::seat_t> seat;
     std::unique_ptr<wf::txn::transaction_manager_t> tx_manager;
     std::unique_ptr<wf::window_manager_t> default_wm;
+    std::unique_ptr<wf::thread_pool_t> thread_pool;
 
     /**
      * Various protocols supported by wlroots
@@ -141,6 +143,7 @@ class compositor_core_t : public wf::object_base_t, public signal::provider_t
         wlr_primary_selection_v1_device_manager *primary_selection_v1;
         wlr_viewporter *viewporter;
         wlr_drm_lease_v1_manager *drm_v1;
+        wlr_tearing_control_manager_v1 *tearing_control;
 
         wlr_xdg_foreign_registry *foreign_registry;
         wlr_xdg_foreign_v1 *foreign_v1;
@@ -277,6 +280,10 @@ class compositor_core_t : public wf::object_base_t, public signal::provider_t
      * This also sets some environment variables for the new process, including
      * correct WAYLAND_DISPLAY and DISPLAY.
      *
+     * The process is reaped by core when it exits, so callers must not waitpid() it. To be notified when it
+     * exits, open a pidfd for it before returning to the event loop, where core may reap it and its PID may
+     * be reused by another process.
+     *
      * @return The PID of the started client, or -1 on failure.
      */
     virtual pid_t run(std::string command) = 0;
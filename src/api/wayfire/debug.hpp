@@ -65,6 +65,8 @@ enum class logging_category : size_t
     IM      = 10,
     // Rendering-related events
     RENDER  = 11,
+    // Input latency tracing
+    LATENCY = 12,
     TOTAL,
 };
 
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace wf
+{
+namespace scene
+{
+class node_t;
+}
+
+/**
+ * Accounting of the GPU memory used by Wayfire and its plugins.
+ *
+ * Each allocation is identified by a key, usually the GL texture name, and tagged with its type, the plugin
+ * which made it and, when known, the scenegraph node it belongs to. Sizes are estimated from the buffer
+ * dimensions with 4 bytes per pixel, the actual usage depends on the driver.
+ *
+ * The accounting only happens when buffers are (re)allocated or freed, so it is always on.
+ */
+namespace gpu_memory
+{
+enum type_t
+{
+    /** Auxiliary framebuffers, see framebuffer_t::allocate() */
+    TYPE_FRAMEBUFFER = 0,
+    /** Idle framebuffers kept for reuse in the shared framebuffer pool */
+    TYPE_POOL        = 1,
+    /** Depth buffers, see OpenGL::attach_depth_buffer() */
+    TYPE_DEPTH       = 2,
+    /** Textures uploaded by plugins, for example from cairo surfaces */
+    TYPE_TEXTURE     = 3,
+    /** Textures imported from client buffers */
+    TYPE_CLIENT      = 4,
+    TYPE_COUNT       = 5,
+};
+
+/** A short name of the type, for example "framebuffer". */
+const char *type_name(type_t type);
+
+struct allocation_t
+{
+    uintptr_t key;
+    type_t type;
+    int64_t bytes;
+    /** The plugin which made the allocation, or "core" */
+    std::string owner;
+    /** The node the allocation belongs to, if any */
+    std::weak_ptr<scene::node_t> node;
+};
+
+/**
+ * Record that the allocation with the given key now uses @bytes bytes of the given type, or forget it if
+ * @bytes is 0.
+ *
+ * @param owner A code address in the plugin which made the allocation, for example its return address, see
+ *   plugin_stats::get_owner_name(). With nullptr, the allocation is attributed to the current node_scope_t,
+ *   or to core.
+ * @param node The node the allocation belongs to. With nullptr, the node of the current node_scope_t is used.
+ */
+void set(uintptr_t key, type_t type, int64_t bytes, const void *owner, scene::node_t *node = nullptr);
+
+/** The total number of bytes of the given type. */
+int64_t get_total(type_t type);
+
+/** The total number of bytes of all types. */
+int64_t get_total();
+
+/** Get all current allocations. */
+std::vector<allocation_t> get_allocations();
+
+/**
+ * The soft limit of the total GPU memory in bytes, or 0 if there is none.
+ *
+ * Above the limit, idle buffers in the framebuffer pool are freed, see workarounds/gpu_memory_soft_cap.
+ */
+int64_t get_soft_cap();
+
+/**
+ * on: core
+ * when: Emitted by trim(). Core and plugins should free the idle buffers and caches which they can recreate
+ *   when needed, for example buffers kept to show an effect again quickly.
+ */
+struct trim_signal
+{};
+
+/**
+ * Reduce the memory footprint, for example in long running sessions or after a memory-heavy effect: emit
+ * trim_signal, free all idle buffers in the framebuffer pool and return the unused heap memory to the system,
+ * see malloc_trim(3). The next frames may be slower while buffers are allocated again.
+ *
+ * Called periodically with workarounds/memory_trim_interval, and with the wayfire/trim-memory IPC method.
+ *
+ * @return The number of bytes of GPU memory which were freed.
+ */
+int64_t trim();
+
+namespace detail
+{
+extern scene::node_t *current_node;
+}
+
+/**
+ * Attributes the allocations made until the end of the object's lifetime to the given node, and to the
+ * plugin which implements the node, for example in transformers which allocate buffers for a view.
+ */
+class node_scope_t
+{
+  public:
+    node_scope_t(scene::node_t *node) : previous(detail::current_node)
+    {
+        detail::current_node = node;
+    }
+
+    ~node_scope_t()
+    {
+        detail::current_node = previous;
+    }
+
+    node_scope_t(const node_scope_t&) = delete;
+    node_scope_t& operator =(const node_scope_t&) = delete;
+
+  private:
+    scene::node_t *previous;
+};
+}
+}
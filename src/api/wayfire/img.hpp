@@ -2,10 +2,55 @@
 #define IMG_HPP_
 
 #include <wayfire/opengl.hpp>
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace image_io
 {
+/** The pixels of a decoded image, 8 bits per channel, RGB or RGBA, top row first. */
+struct decoded_image_t
+{
+    int width    = 0;
+    int height   = 0;
+    int channels = 0;
+    std::vector<uint8_t> pixels;
+};
+
+/* Decode the image from the given file. Does not use GL, so it may be called from any thread. */
+bool decode_file(std::string name, decoded_image_t& image);
+
+/* Upload a decoded image to the given GL texture target, like load_from_file().
+ * Bind the texture before you call this function */
+bool upload_image(const decoded_image_t& image, GLuint target);
+
+/* Downscale the image to the given size by averaging the pixels which map to each new pixel. Images which
+ * are not bigger than the given size are not changed. Does not use GL, so it may be called from any thread.
+ *
+ * A pixel boundary in the new image which is at the same relative position as a pixel boundary in the old
+ * one gets no contributions from across it, so the faces of a cubemap image scaled to a multiple of its
+ * layout stay separate. */
+void downscale_image(decoded_image_t& image, int width, int height);
+
+/* Called on the main thread with the decoded image, or nullptr if decoding failed. */
+using decode_callback_t = std::function<void (std::shared_ptr<decoded_image_t> image)>;
+
+/* Decode the image on a worker thread, so that big images do not block the compositor, and call
+ * @callback on the main thread when it is done. The image can then be uploaded with upload_image().
+ *
+ * If @lifetime is set, the callback is skipped when it has expired in the meantime, which is how
+ * plugins cancel loads when they are destroyed or start loading another image.
+ *
+ * If @prepare is set, it is called with the decoded image on the worker thread, for example to downscale
+ * it.
+ *
+ * Plugins must pass an @owner, see thread_pool_t::schedule(), so that the job and its callbacks are dropped
+ * when they are unloaded. */
+void decode_file_async(std::string name, decode_callback_t callback,
+    std::shared_ptr<void> lifetime = nullptr, std::function<void(decoded_image_t&)> prepare = {},
+    const void *owner = nullptr);
+
 /* Load the image from the given file, binding it to the given GL texture target
  * Bind the texture before you call this function
  * Guaranteed: doesn't change any GL state except pixel packing */
@@ -17,6 +62,15 @@ void write_to_file(std::string name, uint8_t *pixels, int w, int h,
 
 void write_to_file(std::string name, wf::framebuffer_t buffer);
 
+/* Same as write_to_file(), but the image is encoded on a worker thread. @done is then called on the main
+ * thread, if set. Plugins which set @done must pass an @owner, like for decode_file_async(). */
+void write_to_file_async(std::string name, std::vector<uint8_t> pixels, int w, int h,
+    std::string type, bool invert = false, std::function<void()> done = {}, const void *owner = nullptr);
+
+/* Read the framebuffer back and save it as a png file, encoding it on a worker thread. */
+void write_to_file_async(std::string name, wf::framebuffer_t buffer, std::function<void()> done = {},
+    const void *owner = nullptr);
+
 /* Initializes all backends, called at startup */
 void init();
 }
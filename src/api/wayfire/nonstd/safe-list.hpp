@@ -9,6 +9,7 @@
 #include <type_traits>
 #include <vector>
 #include <assert.h>
+#include <cstdlib>
 #include <wayfire/util.hpp>
 
 #include "reverse.hpp"
@@ -35,32 +36,35 @@ class safe_list_t
 
     T& back()
     {
-        auto it = list.rbegin();
-        assert((it != list.rend()) && "back() on an empty list!");
-
-        while (!((*it).has_value()))
+        for (size_t i = count; i > 0; i--)
         {
-            ++it;
-            assert((it != list.rend()) && "back() on an empty list!");
+            if (at(i - 1))
+            {
+                return *at(i - 1);
+            }
         }
 
-        return **it;
+        assert(false && "back() on an empty list!");
+        std::abort();
     }
 
     size_t size() const
     {
-        if (!is_dirty)
-        {
-            return list.size();
-        }
-
-        return std::count_if(list.begin(), list.end(), [] (const auto& elem) { return elem.has_value(); });
+        return count - tombstones;
     }
 
     /* Push back by copying */
     void push_back(T value)
     {
-        list.push_back({std::move(value)});
+        if (count < INLINE_CAPACITY)
+        {
+            inline_values[count] = std::move(value);
+        } else
+        {
+            overflow.push_back({std::move(value)});
+        }
+
+        ++count;
     }
 
     /* Call func for each non-erased element of the list */
@@ -70,12 +74,12 @@ class safe_list_t
 
         // Important: make sure we do not iterate over additional values in the list which are added
         // afterwards.
-        size_t size = list.size();
+        size_t size = count;
         for (size_t i = 0; i < size; i++)
         {
-            if (list[i])
+            if (at(i))
             {
-                func(*list[i]);
+                func(*at(i));
             }
         }
 
@@ -86,11 +90,11 @@ class safe_list_t
     void for_each_reverse(std::function<void(T&)> func)
     {
         _start_iter();
-        for (size_t i = list.size(); i > 0; i--)
+        for (size_t i = count; i > 0; i--)
         {
-            if (list[i - 1])
+            if (at(i - 1))
             {
-                func(*list[i - 1]);
+                func(*at(i - 1));
             }
         }
 
@@ -115,15 +119,15 @@ class safe_list_t
     {
         _start_iter();
 
-        const size_t size = list.size();
+        const size_t size = count;
         for (size_t i = 0; i < size; i++)
         {
-            if (list[i] && predicate(*list[i]))
+            if (at(i) && predicate(*at(i)))
             {
                 /* First reset the element in the list, and then free resources */
-                auto value = std::move(list[i]);
-                list[i].reset();
-                is_dirty = true;
+                auto value = std::move(at(i));
+                at(i).reset();
+                ++tombstones;
 
                 // Call destructor
                 value.reset();
@@ -131,35 +135,66 @@ class safe_list_t
         }
 
         _stop_iter();
-        _try_cleanup();
     }
 
   private:
     /**
-     * A vector containing the values of the list.
+     * The values of the list.
      * To make sure we can iterate over the list and erase any elements from it during iteration, the 'erase'
-     * operation simply resets the optional value in the list.
+     * operation simply resets the optional value in the list, leaving a tombstone.
      *
-     * After all iterations are done, the list is 'cleaned up', that is, empty elements are removed from it.
+     * Most lists have only a few elements, so the first INLINE_CAPACITY values are stored inline, and only
+     * the rest are allocated in the overflow vector.
      */
-    std::vector<std::optional<T>> list;
+    static constexpr size_t INLINE_CAPACITY = 4;
+    std::optional<T> inline_values[INLINE_CAPACITY];
+    std::vector<std::optional<T>> overflow;
+
+    /* The number of values in the list, including tombstones */
+    size_t count      = 0;
+    size_t tombstones = 0;
 
     int iteration_counter = 0;
-    bool is_dirty = false;
 
-    /* Remove all invalidated elements in the list */
+    std::optional<T>& at(size_t i)
+    {
+        return (i < INLINE_CAPACITY) ? inline_values[i] : overflow[i - INLINE_CAPACITY];
+    }
+
+    /**
+     * Remove tombstones from the list once there is no active iteration.
+     *
+     * Compacting moves all values after the first tombstone, so it is done only when at least a quarter of
+     * the list are tombstones. That way, the cost is amortized over the removals, even for lists with many
+     * elements which are removed one by one.
+     */
     void _try_cleanup()
     {
-        if ((iteration_counter > 0) || !is_dirty)
+        if ((iteration_counter > 0) || (tombstones == 0) || (tombstones * 4 < count))
         {
-            // There is an active iteration.
             return;
         }
 
-        auto it = std::remove_if(list.begin(), list.end(),
-            [&] (const std::optional<T>& elem) { return !elem.has_value(); });
-        list.erase(it, list.end());
-        is_dirty = false;
+        size_t next = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!at(i))
+            {
+                continue;
+            }
+
+            if (i != next)
+            {
+                at(next) = std::move(at(i));
+                at(i).reset();
+            }
+
+            ++next;
+        }
+
+        overflow.resize(next > INLINE_CAPACITY ? next - INLINE_CAPACITY : 0);
+        count      = next;
+        tombstones = 0;
     }
 
     void _start_iter()
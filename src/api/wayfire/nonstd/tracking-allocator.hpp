@@ -1,6 +1,10 @@
 #pragma once
+#include <cstdint>
 #include <memory>
 #include <functional>
+#include <new>
+#include <unordered_map>
+#include <vector>
 #include <wayfire/dassert.hpp>
 #include <wayfire/nonstd/observer_ptr.h>
 #include <wayfire/signal-provider.hpp>
@@ -17,6 +21,102 @@ struct destruct_signal
     T *object;
 };
 
+/**
+ * The id by which the tracking allocator indexes its objects, see tracking_allocator_t::find_by_id().
+ * Objects with a get_id() method are indexed by it, other types can specialize this struct.
+ */
+template<class T, class = void>
+struct tracking_id_t
+{
+    static constexpr bool indexed = false;
+};
+
+template<class T>
+struct tracking_id_t<T, std::void_t<decltype(std::declval<const T&>().get_id())>>
+{
+    static constexpr bool indexed = true;
+    static uint64_t get(const T& object)
+    {
+        return object.get_id();
+    }
+};
+
+namespace detail
+{
+/**
+ * A pool of memory for objects of a single type.
+ *
+ * Memory is taken from slabs with room for several objects, and the memory of freed objects is kept in a
+ * free list for the next allocation. Slabs are never returned to the system.
+ */
+template<class T>
+class object_pool_t
+{
+  public:
+    static object_pool_t<T>& get()
+    {
+        static object_pool_t<T> pool;
+        return pool;
+    }
+
+    void *allocate()
+    {
+        if (!free_list)
+        {
+            add_slab();
+        }
+
+        slot_t *slot = free_list;
+        free_list = slot->next;
+        ++in_use;
+        return slot->storage;
+    }
+
+    void release(void *memory)
+    {
+        slot_t *slot = reinterpret_cast<slot_t*>(memory);
+        slot->next = free_list;
+        free_list  = slot;
+        --in_use;
+    }
+
+    ~object_pool_t()
+    {
+        if (in_use > 0)
+        {
+            // Objects which outlive the pool (during shutdown) still need their memory.
+            for (auto& slab : slabs)
+            {
+                slab.release();
+            }
+        }
+    }
+
+  private:
+    static constexpr size_t OBJECTS_PER_SLAB = 16;
+
+    union slot_t
+    {
+        slot_t *next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    std::vector<std::unique_ptr<slot_t[]>> slabs;
+    slot_t *free_list = nullptr;
+    size_t in_use     = 0;
+
+    void add_slab()
+    {
+        slabs.emplace_back(new slot_t[OBJECTS_PER_SLAB]);
+        for (size_t i = 0; i < OBJECTS_PER_SLAB; i++)
+        {
+            slabs.back()[i].next = free_list;
+            free_list = &slabs.back()[i];
+        }
+    }
+};
+}
+
 /**
  * The tracking allocator is a factory singleton for allocating objects of a certain type.
  * The objects are allocated via shared pointers, and the tracking allocator keeps a list of all allocated
@@ -43,18 +143,85 @@ class tracking_allocator_t
             new ConcreteObjectType(std::forward<Args>(args)...),
             std::bind(&tracking_allocator_t<ObjectType>::deallocate_object, this, std::placeholders::_1));
 
-        allocated_objects.push_back(ptr.get());
+        track_object(ptr.get());
+        return ptr;
+    }
+
+    /**
+     * Like allocate(), but the memory of the object is taken from a pool for the concrete type, see
+     * detail::object_pool_t. Useful for types which are allocated and freed often, like views of popups and
+     * tooltips, because it avoids a trip through the general-purpose allocator and keeps the objects of the
+     * same type close together.
+     */
+    template<class ConcreteObjectType, class... Args>
+    std::shared_ptr<ConcreteObjectType> allocate_pooled(Args... args)
+    {
+        static_assert(std::is_base_of_v<ObjectType, ConcreteObjectType>);
+        auto& pool   = detail::object_pool_t<ConcreteObjectType>::get();
+        void *memory = pool.allocate();
+
+        ConcreteObjectType *object;
+        try {
+            object = new (memory) ConcreteObjectType(std::forward<Args>(args)...);
+        } catch (...)
+        {
+            pool.release(memory);
+            throw;
+        }
+
+        auto ptr = std::shared_ptr<ConcreteObjectType>(object, [this, &pool] (ConcreteObjectType *obj)
+        {
+            untrack_object(obj);
+            obj->~ConcreteObjectType();
+            pool.release(obj);
+        });
+
+        track_object(ptr.get());
         return ptr;
     }
 
+    /**
+     * Get all objects which are currently allocated, in the order of their allocation.
+     *
+     * The list is not copied, so it must not be held while objects may be allocated or freed.
+     */
     const std::vector<nonstd::observer_ptr<ObjectType>>& get_all()
     {
         return allocated_objects;
     }
 
+    /**
+     * Find an allocated object by its id in constant time, see tracking_id_t.
+     *
+     * @return The object, or nullptr if no object with the given id is allocated.
+     */
+    ObjectType *find_by_id(uint64_t id)
+    {
+        static_assert(tracking_id_t<ObjectType>::indexed, "The object type does not have an id");
+        auto it = objects_by_id.find(id);
+        return (it == objects_by_id.end()) ? nullptr : it->second;
+    }
+
   private:
     std::vector<nonstd::observer_ptr<ObjectType>> allocated_objects;
+    std::unordered_map<uint64_t, ObjectType*> objects_by_id;
+
+    void track_object(ObjectType *obj)
+    {
+        allocated_objects.push_back(obj);
+        if constexpr (tracking_id_t<ObjectType>::indexed)
+        {
+            objects_by_id[tracking_id_t<ObjectType>::get(*obj)] = obj;
+        }
+    }
+
     void deallocate_object(ObjectType *obj)
+    {
+        untrack_object(obj);
+        delete obj;
+    }
+
+    void untrack_object(ObjectType *obj)
     {
         if constexpr (std::is_base_of_v<wf::signal::provider_t, ObjectType>)
         {
@@ -67,7 +234,15 @@ class tracking_allocator_t
             nonstd::observer_ptr<ObjectType>{obj});
         wf::dassert(it != allocated_objects.end(), "Object is not allocated?");
         allocated_objects.erase(it);
-        delete obj;
+
+        if constexpr (tracking_id_t<ObjectType>::indexed)
+        {
+            auto by_id = objects_by_id.find(tracking_id_t<ObjectType>::get(*obj));
+            if ((by_id != objects_by_id.end()) && (by_id->second == obj))
+            {
+                objects_by_id.erase(by_id);
+            }
+        }
     }
 };
 }
@@ -94,6 +94,7 @@ extern "C"
 
 // Output management
 #include <wlr/types/wlr_output_layout.h>
+#include <wlr/types/wlr_output_layer.h>
 #include <wlr/types/wlr_output_management_v1.h>
 
 #if __has_include(<wlr-output-power-management-unstable-v1-protocol.h>)
@@ -138,6 +139,7 @@ extern "C"
 #include <wlr/types/wlr_fractional_scale_v1.h>
 #include <wlr/types/wlr_single_pixel_buffer_v1.h>
 #include <wlr/types/wlr_session_lock_v1.h>
+#include <wlr/types/wlr_tearing_control_v1.h>
 
 // Activation plugin
 #include <wlr/types/wlr_xdg_activation_v1.h>
@@ -9,6 +9,22 @@
 
 namespace wf
 {
+namespace detail
+{
+/**
+ * Get a small integer which identifies the custom data stored under the name typeid(type).name(). Types are
+ * compared by name, so the same type gets the same slot in core and in all plugins.
+ */
+size_t allocate_object_data_slot(const std::type_info& type);
+
+template<class T>
+size_t object_data_slot()
+{
+    static const size_t slot = allocate_object_data_slot(typeid(T));
+    return slot;
+}
+}
+
 /**
  * Subclasses of custom_data_t can be stored inside an object_base_t
  */
@@ -36,6 +52,12 @@ class object_base_t
     /** Get the ID of the object. Each object has a unique ID */
     uint32_t get_id() const;
 
+    /*
+     * Custom data can be accessed either by type or by an explicit name. The data of a type T is the same as
+     * the data stored under the name typeid(T).name(), but accessing it by type avoids building and hashing
+     * the name, so it is cheap enough to be used in per-frame code.
+     */
+
     /**
      * Retrieve custom data stored with the given name. If no such data exists,
      * then it is created with the default constructor.
@@ -44,8 +66,7 @@ class object_base_t
      * If your type doesn't have one, use store_data + get_data
      */
     template<class T>
-    nonstd::observer_ptr<T> get_data_safe(
-        std::string name = typeid(T).name())
+    nonstd::observer_ptr<T> get_data_safe(std::string name)
     {
         auto data = get_data<T>(name);
         if (data)
@@ -59,15 +80,37 @@ class object_base_t
         }
     }
 
+    /** Retrieve the custom data of type T, creating it with the default constructor if it does not exist. */
+    template<class T>
+    nonstd::observer_ptr<T> get_data_safe()
+    {
+        auto data = get_data<T>();
+        if (data)
+        {
+            return data;
+        } else
+        {
+            store_data<T>(std::make_unique<T>());
+
+            return get_data<T>();
+        }
+    }
+
     /* Retrieve custom data stored with the given name. If no such
      * data exists, NULL is returned */
     template<class T>
-    nonstd::observer_ptr<T> get_data(
-        std::string name = typeid(T).name())
+    nonstd::observer_ptr<T> get_data(std::string name)
     {
         return nonstd::make_observer(dynamic_cast<T*>(_fetch_data(name)));
     }
 
+    /** Retrieve the custom data of type T, or NULL if it does not exist */
+    template<class T>
+    nonstd::observer_ptr<T> get_data()
+    {
+        return nonstd::make_observer(dynamic_cast<T*>(_fetch_data(detail::object_data_slot<T>())));
+    }
+
     /* Assigns the given data to the given name */
     template<class T>
     void store_data(std::unique_ptr<T> stored_data,
@@ -76,11 +119,11 @@ class object_base_t
         _store_data(std::move(stored_data), name);
     }
 
-    /* Returns true if there is saved data under the given name */
+    /* Returns true if there is saved data for the type T */
     template<class T>
     bool has_data()
     {
-        return has_data(typeid(T).name());
+        return _fetch_data(detail::object_data_slot<T>()) != nullptr;
     }
 
     /** @return true if there is saved data with the given name */
@@ -126,7 +169,9 @@ class object_base_t
 
   private:
     /** Just get the data under the given name, or nullptr, if it does not exist */
-    custom_data_t *_fetch_data(std::string name);
+    custom_data_t *_fetch_data(const std::string& name);
+    /** Get the data stored under the name of the type with the given slot, or nullptr */
+    custom_data_t *_fetch_data(size_t slot);
     /** Get the data under the given name, and release the pointer, deleting
      * the entry in the map */
     custom_data_t *_fetch_erase(std::string name);
@@ -9,6 +9,7 @@
 #include <wayfire/nonstd/wlroots.hpp>
 
 #include <wayfire/geometry.hpp>
+#include <vector>
 
 #define GLM_FORCE_RADIANS
 #include <glm/mat4x4.hpp>
@@ -51,6 +52,14 @@ struct framebuffer_t
      * Return true if texture was created/invalidated */
     bool allocate(int width, int height);
 
+    /* Same as allocate(), but when the size changes, a texture and framebuffer
+     * of the requested size are taken from the shared framebuffer pool if
+     * possible, and the old ones are returned to it. Framebuffers without their
+     * own texture (e.g. the output framebuffer) are allocated as usual.
+     *
+     * Framebuffers allocated this way should be freed with release_to_pool(). */
+    bool allocate_from_pool(int width, int height);
+
     /* Make the framebuffer current, and adjust viewport to its size */
     void bind() const;
 
@@ -63,6 +72,10 @@ struct framebuffer_t
      * allocate() */
     void release();
 
+    /* Return the texture and framebuffer to the shared framebuffer pool, so
+     * that they can be reused, and reset the framebuffer. */
+    void release_to_pool();
+
     /* Reset the framebuffer, WITHOUT freeing resources.
      * There is no need to call reset() after release() */
     void reset();
@@ -169,6 +182,8 @@ struct texture_t
     bool invert_y = false;
     /** Has viewport? */
     bool has_viewport = false;
+    /** Sample from the texture's mipmaps when it is minified. The mipmaps must have been generated. */
+    bool mipmapped = false;
 
     /**
      * Part of the texture which is used for rendering.
@@ -203,6 +218,58 @@ void render_begin(int32_t viewport_width, int32_t viewport_height, uint32_t fb);
  * render_end() must be called for each render_begin() */
 void render_end();
 
+/**
+ * Get the number of draw calls (glDraw*) made with GL_CALL since startup.
+ * Useful for benchmarks and debugging.
+ */
+uint64_t get_draw_call_count();
+
+/**
+ * Statistics of the shared framebuffer pool, see framebuffer_t::allocate_from_pool().
+ */
+struct framebuffer_pool_stats_t
+{
+    /* Framebuffers taken from the pool which have not been returned yet */
+    int used_buffers    = 0;
+    int64_t used_bytes  = 0;
+    /* Idle framebuffers kept for reuse */
+    int free_buffers    = 0;
+    int64_t free_bytes  = 0;
+    /* Idle framebuffers are freed, least recently used first, above this limit */
+    int64_t max_free_bytes = 0;
+
+    uint64_t hits = 0;
+    uint64_t misses    = 0;
+    uint64_t evictions = 0;
+    /* Evictions because the GPU memory was above workarounds/gpu_memory_soft_cap */
+    uint64_t soft_cap_evictions = 0;
+
+    /* Depth buffers, attached or kept for reuse, see attach_depth_buffer() */
+    int depth_buffers   = 0;
+    int64_t depth_bytes = 0;
+};
+
+framebuffer_pool_stats_t get_framebuffer_pool_stats();
+
+/**
+ * Free all idle framebuffers in the pool and the depth buffers which are not attached anymore, regardless of
+ * the pool size. Used by wf::gpu_memory::trim(), must be called inside render_begin().
+ */
+void release_idle_framebuffers();
+
+/**
+ * Attach a depth buffer with the given size to the framebuffer, if it does not have one already.
+ *
+ * Depth buffers are shared by all framebuffers with the same size, for example the buffers of an output's
+ * swapchain, so their contents are only valid until another framebuffer of the same size is rendered to.
+ * Users should clear the depth buffer at the start of each render pass. Depth buffers which are not
+ * attached anymore are kept for reuse, within the limit of the framebuffer pool.
+ */
+void attach_depth_buffer(GLuint fb, int width, int height);
+
+/** Detach the depth buffer attached with attach_depth_buffer(), if any. */
+void detach_depth_buffer(GLuint fb);
+
 /* Clear the currently bound framebuffer with the given color */
 void clear(wf::color_t color, uint32_t mask = GL_COLOR_BUFFER_BIT);
 
@@ -297,6 +364,58 @@ void draw_cached();
  */
 void clear_cached();
 
+/**
+ * A batch of textured quads rendered with the built-in shaders.
+ *
+ * Rendering a quad with RENDER_FLAG_CACHED still issues one draw call and one
+ * scissor change per damaged rectangle. Instead, texture_batch_t clips each quad
+ * against the damage on the CPU and collects the resulting triangles in a single
+ * vertex buffer. Consecutive quads which use the same texture, transform and color
+ * are then drawn with a single glDrawArrays() call. Adding a quad with a different
+ * state flushes the pending quads first, so the order of rendering is preserved.
+ *
+ * Clipping happens before @transform is applied, so the damage has to be in the
+ * same coordinate system as the quad geometry. In practice, this means that the
+ * transform should be render_target_t::get_orthographic_projection() or a
+ * similar matrix which only maps that coordinate system to the framebuffer.
+ *
+ * All functions should be called between render_begin() and render_end(), and
+ * flush() has to be called before render_end(). The vertex buffers keep their
+ * capacity across flushes, so a batch is best kept alive between frames.
+ */
+class texture_batch_t
+{
+  public:
+    /**
+     * Add a textured quad, clipped to @damage, to the batch.
+     *
+     * The parameters have the same meaning as in render_transformed_texture().
+     * RENDER_FLAG_CACHED is ignored.
+     */
+    void add(const wf::texture_t& texture, const gl_geometry& g,
+        const gl_geometry& texg, const wf::region_t& damage,
+        const glm::mat4& transform, const glm::vec4& color = glm::vec4(1.f),
+        uint32_t bits = 0);
+
+    /**
+     * Add a textured quad, clipped to @damage, to the batch.
+     * In this variant, the TEX_GEOMETRY flag is ignored.
+     */
+    void add(const wf::texture_t& texture, const wf::geometry_t& geometry,
+        const wf::region_t& damage, const glm::mat4& transform,
+        const glm::vec4& color = glm::vec4(1.f), uint32_t bits = 0);
+
+    /** Draw all pending quads and clear the batch. */
+    void flush();
+
+  private:
+    wf::texture_t texture;
+    glm::mat4 transform;
+    glm::vec4 color;
+    std::vector<GLfloat> vertices;
+    std::vector<GLfloat> uv_coords;
+};
+
 /* Compiles the given shader source */
 GLuint compile_shader(std::string source, GLuint type);
 
@@ -349,9 +468,23 @@ class program_t
      *
      * The following identifiers should not be defined in the user source:
      *   _wayfire_texture, _wayfire_uv_scale, _wayfire_y_base, get_pixel
+     *
+     * Variants of a shader can be specialized with @defines, each either `NAME` or `NAME VALUE`, which are
+     * added as `#define` lines after the version declaration of both shaders.
+     *
+     * The programs are shared: if a program with the same sources and defines was already compiled, for
+     * example by the same plugin on another output, it is reused instead of being compiled again. It is
+     * deleted when no program_t uses it anymore.
      */
     void compile(const std::string& vertex_source,
-        const std::string& fragment_source);
+        const std::string& fragment_source, const std::vector<std::string>& defines = {});
+
+    /**
+     * Compile a program without the texture builtins, which supports only the given type. Like the programs
+     * from compile(), it is shared with other program_t which use the same sources and defines.
+     */
+    void compile_simple(const std::string& vertex_source, const std::string& fragment_source,
+        wf::texture_type_t type = wf::TEXTURE_TYPE_RGBA, const std::vector<std::string>& defines = {});
 
     /**
      * Create a simple program
@@ -413,6 +546,11 @@ class program_t
     /**
      * Deactivate the vertex attributes activated by attrib_pointer and
      * attrib_divisor, and reset the active OpenGL program.
+     *
+     * While an output frame is being rendered, the program stays bound so that
+     * consecutive draws with the same program do not need to bind it again.
+     * Code using its own programs has to bind them with glUseProgram (through
+     * GL_CALL) as usual.
      */
     void deactivate();
 
@@ -3,6 +3,8 @@
 #include <wayfire/config/option.hpp>
 #include <wayfire/config/option-wrapper.hpp>
 #include <wayfire/core.hpp>
+#include <cstdint>
+#include <optional>
 
 namespace wf
 {
@@ -13,10 +15,20 @@ namespace detail
 void option_wrapper_debug_message(const std::string& option_name, const std::runtime_error& err);
 [[noreturn]]
 void option_wrapper_debug_message(const std::string& option_name, const std::logic_error& err);
+
+/**
+ * Incremented whenever an option which is loaded in an option_wrapper_t changes. The cached values of all
+ * wrappers are refreshed when it differs from the generation they were read at.
+ */
+extern uint64_t option_generation;
 }
 
 /**
  * A simple wrapper around a config option.
+ *
+ * The value of the option is cached, so that reading it in hot paths (per frame, per input event) is a
+ * plain load instead of a lookup through the option and a copy of its value. The cache is invalidated
+ * when any wrapped option changes, before the callbacks of the wrappers run.
  */
 template<class Type>
 class option_wrapper_t : public base_option_wrapper_t<Type>
@@ -47,10 +59,52 @@ class option_wrapper_t : public base_option_wrapper_t<Type>
     option_wrapper_t() : wf::base_option_wrapper_t<Type>()
     {}
 
+    ~option_wrapper_t()
+    {
+        if (cache_source)
+        {
+            cache_source->rem_updated_handler(&on_cache_invalidated);
+        }
+    }
+
+    operator Type() const
+    {
+        return value();
+    }
+
+    Type value() const
+    {
+        if (!cached_value || (cached_generation != detail::option_generation))
+        {
+            cached_value = base_option_wrapper_t<Type>::value();
+            cached_generation = detail::option_generation;
+        }
+
+        return *cached_value;
+    }
+
   protected:
     std::shared_ptr<config::option_base_t> load_raw_option(const std::string& name)
     {
-        return wf::get_core().config.get_option(name);
+        auto option = wf::get_core().config.get_option(name);
+        if (option)
+        {
+            // Added before the base wrapper adds its own handler, so that the callback reads the new value.
+            cache_source = option;
+            cache_source->add_updated_handler(&on_cache_invalidated);
+        }
+
+        return option;
     }
+
+  private:
+    mutable std::optional<Type> cached_value;
+    mutable uint64_t cached_generation = 0;
+    std::shared_ptr<config::option_base_t> cache_source;
+
+    config::option_base_t::updated_callback_t on_cache_invalidated = [] ()
+    {
+        ++detail::option_generation;
+    };
 };
 }
@@ -117,6 +117,12 @@ class output_layout_t : public wf::signal::provider_t
     wf::output_t *find_output(wlr_output *output);
     wf::output_t *find_output(std::string name);
 
+    /**
+     * @return the active output with the given id (see wf::object_base_t::get_id()), or null if there is
+     * no such output. Unlike find_output(), this does not iterate over the outputs.
+     */
+    wf::output_t *find_output_by_id(uint32_t id);
+
     /**
      * @return the current output configuration. This contains ALL outputs,
      * not just the ones in the actual layout (so disabled ones are included
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+namespace wf
+{
+/**
+ * Accounting of the CPU time spent in code of each plugin.
+ *
+ * Effect hooks, post hooks, signal handlers and render instances are attributed to the plugin whose shared
+ * object contains the type of the callback (or of the render instance). Anything which does not come from a
+ * dynamically loaded plugin is attributed to "core".
+ *
+ * Nested calls are accounted for separately, so for example the time spent in a plugin's signal handler is
+ * not counted towards the core code which emitted the signal.
+ *
+ * Signal emissions are counted as well, per signal type, together with the number of listeners and the time
+ * spent in the handlers of each plugin.
+ *
+ * Accounting is off by default, in which case it costs a single branch per call. It can be enabled via IPC.
+ */
+namespace plugin_stats
+{
+enum cost_type_t
+{
+    COST_EFFECT_HOOK = 0,
+    COST_POST_HOOK   = 1,
+    COST_SIGNAL      = 2,
+    COST_RENDER      = 3,
+    COST_TYPE_COUNT  = 4,
+};
+
+/** Whether plugin costs are accounted at the moment. Use enable() to change. */
+extern bool enabled;
+
+/** Start or stop the accounting. Starting it again resets all statistics. */
+void enable(bool enable);
+
+struct cost_t
+{
+    uint64_t calls = 0;
+    int64_t total_usec = 0;
+};
+
+struct plugin_cost_t
+{
+    std::string name;
+    cost_t costs[COST_TYPE_COUNT];
+    /** The time spent in the plugin during the last completed frame */
+    int64_t last_frame_usec = 0;
+    /** The highest time spent in the plugin during a single frame */
+    int64_t max_frame_usec = 0;
+};
+
+/** Get the statistics of all plugins which have been called since the accounting was enabled. */
+std::vector<plugin_cost_t> get_stats();
+
+struct signal_cost_t
+{
+    /** The demangled name of the signal type */
+    std::string name;
+    uint64_t emissions = 0;
+    /** The total number of listeners over all emissions */
+    uint64_t listeners     = 0;
+    uint64_t max_listeners = 0;
+    /** The total time spent in emit(), including the dispatch itself */
+    int64_t dispatch_usec = 0;
+    /** The time spent in the handlers, by plugin */
+    std::map<std::string, cost_t> handlers;
+};
+
+/** Get the statistics of all signal types which have been emitted since the accounting was enabled. */
+std::vector<signal_cost_t> get_signal_stats();
+
+/** The number of frames which have been completed since the accounting was enabled. */
+uint64_t get_frame_count();
+
+/** Mark the end of a frame on any output, for the per-frame statistics. */
+void end_frame();
+
+/**
+ * Register a loaded plugin, so that the code in its shared object is attributed to it.
+ *
+ * @param symbol The address of any symbol in the plugin's shared object.
+ */
+void add_plugin(const void *symbol, const std::string& name);
+
+/** Stop attributing code to a plugin before its shared object is unloaded. */
+void remove_plugin(const void *symbol);
+
+/**
+ * @return The name of the plugin whose shared object contains the given code address, for example a return
+ *   address, or "core". Works even when the accounting is disabled.
+ */
+const std::string& get_owner_name(const void *address);
+
+namespace detail
+{
+struct scope_data_t
+{
+    const std::type_info *key;
+    const std::type_info *signal;
+    cost_type_t type;
+    int64_t start;
+    int64_t children;
+    scope_data_t *parent;
+};
+
+void begin(scope_data_t& data);
+void end(scope_data_t& data);
+void note_emit(const std::type_info& signal, size_t listeners, int64_t start);
+int64_t now();
+}
+
+/**
+ * Accounts the time until the end of the object's lifetime to the plugin which owns the given type.
+ *
+ * @param signal The type of the signal, for signal handlers.
+ */
+class scope_t
+{
+  public:
+    scope_t(const std::type_info& key, cost_type_t type, const std::type_info *signal = nullptr)
+    {
+        if (enabled)
+        {
+            data.key    = &key;
+            data.signal = signal;
+            data.type   = type;
+            detail::begin(data);
+        }
+    }
+
+    ~scope_t()
+    {
+        if (data.key)
+        {
+            detail::end(data);
+        }
+    }
+
+    scope_t(const scope_t&) = delete;
+    scope_t& operator =(const scope_t&) = delete;
+
+  private:
+    detail::scope_data_t data{nullptr, nullptr, COST_EFFECT_HOOK, 0, 0, nullptr};
+};
+
+/**
+ * Counts an emission of a signal with the given number of listeners, and the time until the end of the
+ * object's lifetime as its dispatch time.
+ */
+class emit_scope_t
+{
+  public:
+    emit_scope_t(const std::type_info& signal, size_t listeners)
+    {
+        if (enabled)
+        {
+            this->signal    = &signal;
+            this->listeners = listeners;
+            this->start     = detail::now();
+        }
+    }
+
+    ~emit_scope_t()
+    {
+        if (signal)
+        {
+            detail::note_emit(*signal, listeners, start);
+        }
+    }
+
+    emit_scope_t(const emit_scope_t&) = delete;
+    emit_scope_t& operator =(const emit_scope_t&) = delete;
+
+  private:
+    const std::type_info *signal = nullptr;
+    size_t listeners = 0;
+    int64_t start    = 0;
+};
+}
+}
@@ -105,7 +105,7 @@ class plugin_interface_t
 using wayfire_plugin_load_func = wf::plugin_interface_t * (*)();
 
 /** The version of Wayfire's API/ABI */
-constexpr uint32_t WAYFIRE_API_ABI_VERSION = 2024'04'04;
+constexpr uint32_t WAYFIRE_API_ABI_VERSION = 2026'10'14;
 
 /**
  * Each plugin must also provide a function which returns the Wayfire API/ABI
@@ -2,6 +2,7 @@
 
 #include <pixman.h>
 #include "wayfire/geometry.hpp"
+#include <vector>
 
 /* ---------------------- pixman utility functions -------------------------- */
 namespace wf
@@ -24,35 +25,64 @@ struct region_t
     void clear();
 
     void expand_edges(int amount);
+
+    /**
+     * Replace the region with a coarser superset of it, trading a bit of
+     * overdraw for fewer rectangles.
+     *
+     * Pairs of rectangles are merged into their bounding box, cheapest pair
+     * first, where the cost is the number of pixels which are added to the
+     * region. Merging stops when the region has at most @max_rects rectangles
+     * and the next merge would add at least @max_overdraw pixels.
+     *
+     * @param max_rects The maximal number of rectangles, or 0 for no limit.
+     * @param max_overdraw Merges adding fewer pixels than this are always done.
+     */
+    void simplify(int max_rects, int64_t max_overdraw = 0);
     pixman_box32_t get_extents() const;
     bool contains_point(const point_t& point) const;
     bool contains_pointf(const pointf_t& point) const;
 
+    /*
+     * The binary operators below have two variants: the one for temporaries
+     * (for example in `a * scale & box`) works in place and reuses the storage
+     * of the temporary, instead of allocating a new region.
+     */
+
     /* Translate the region */
-    region_t operator +(const point_t& vector) const;
+    region_t operator +(const point_t& vector) const &;
+    region_t operator +(const point_t& vector) &&;
     region_t& operator +=(const point_t& vector);
 
-    region_t operator -(const point_t& vector) const;
+    region_t operator -(const point_t& vector) const &;
+    region_t operator -(const point_t& vector) &&;
     region_t& operator -=(const point_t& vector);
 
-    region_t operator *(float scale) const;
+    region_t operator *(float scale) const &;
+    region_t operator *(float scale) &&;
     region_t& operator *=(float scale);
 
     /* Region intersection */
-    region_t operator &(const wlr_box& box) const;
-    region_t operator &(const region_t& other) const;
+    region_t operator &(const wlr_box& box) const &;
+    region_t operator &(const wlr_box& box) &&;
+    region_t operator &(const region_t& other) const &;
+    region_t operator &(const region_t& other) &&;
     region_t& operator &=(const wlr_box& box);
     region_t& operator &=(const region_t& other);
 
     /* Region union */
-    region_t operator |(const wlr_box& other) const;
-    region_t operator |(const region_t& other) const;
+    region_t operator |(const wlr_box& other) const &;
+    region_t operator |(const wlr_box& other) &&;
+    region_t operator |(const region_t& other) const &;
+    region_t operator |(const region_t& other) &&;
     region_t& operator |=(const wlr_box& other);
     region_t& operator |=(const region_t& other);
 
     /* Subtract the box/region from the current region */
-    region_t operator ^(const wlr_box& box) const;
-    region_t operator ^(const region_t& other) const;
+    region_t operator ^(const wlr_box& box) const &;
+    region_t operator ^(const wlr_box& box) &&;
+    region_t operator ^(const region_t& other) const &;
+    region_t operator ^(const region_t& other) &&;
     region_t& operator ^=(const wlr_box& box);
     region_t& operator ^=(const region_t& other);
 
@@ -68,6 +98,25 @@ struct region_t
      * won't let us pass a const pixman_region32_t* */
     pixman_region32_t *unconst() const;
 };
+
+/**
+ * Collects boxes and builds a region out of all of them at once. This is much cheaper than adding the boxes
+ * to a region one by one, since each union has to rebuild the whole region.
+ */
+class region_builder_t
+{
+  public:
+    void reserve(size_t count);
+    /* Boxes without area are ignored */
+    void add(const wlr_box& box);
+    void add(const pixman_box32_t& box);
+
+    /* Build the region of all boxes added so far, and start over. */
+    region_t build();
+
+  private:
+    std::vector<pixman_box32_t> boxes;
+};
 }
 
 wlr_box wlr_box_from_pixman_box(const pixman_box32_t& box);
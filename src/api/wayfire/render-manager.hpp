@@ -3,6 +3,10 @@
 #include <wayfire/output.hpp>
 #include <wayfire/object.hpp>
 #include <wayfire/region.hpp>
+#include <glm/mat4x4.hpp>
+#include <optional>
+#include <string>
+#include <vector>
 
 namespace wf
 {
@@ -45,12 +49,205 @@ enum output_effect_type_t
 using post_hook_t = std::function<void (const wf::framebuffer_t& source,
     const wf::framebuffer_t& destination)>;
 
+/**
+ * Describes how a post hook moves the pixels of its source buffer, so that only the parts of its
+ * destination which change have to be repainted, see render_manager::add_post().
+ *
+ * @param source_damage The parts of the source buffer which changed since the last frame, in framebuffer
+ *   coordinates (as used by framebuffer_t::scissor()).
+ * @return The parts of the destination buffer the hook has to repaint, in the same coordinates. Returning
+ *   the whole buffer is always correct, and it is required when the mapping itself changed since the last
+ *   frame. Color filters simply return @source_damage.
+ */
+using post_hook_damage_t = std::function<wf::region_t(const wf::region_t& source_damage)>;
+
+/**
+ * A color transform applied to the whole output image, see render_manager::add_color_transform().
+ *
+ * Each pixel is transformed as `rgb = (matrix * vec4(rgb, 1.0)).rgb`, so the fourth column of the matrix is
+ * an offset which is added to the color. The alpha channel is not changed.
+ */
+struct color_transform_t
+{
+    glm::mat4 matrix = glm::mat4(1.0);
+};
+
+/**
+ * The phases of the repaint cycle of an output which are measured by the render manager.
+ */
+enum frame_phase_t
+{
+    /* Acquiring the next buffer from the swapchain and accumulating damage */
+    FRAME_PHASE_DAMAGE      = 0,
+    /* Gathering render instructions from the render instances (schedule_instructions) */
+    FRAME_PHASE_SCHEDULE    = 1,
+    /* Clearing the background of the damaged areas */
+    FRAME_PHASE_CLEAR       = 2,
+    /* Executing the render instructions */
+    FRAME_PHASE_RENDER      = 3,
+    /* Running the postprocessing effects */
+    FRAME_PHASE_POSTPROCESS = 4,
+    /* Submitting the render pass and committing the output state */
+    FRAME_PHASE_SWAP        = 5,
+    /* The whole repaint, including the effect hooks */
+    FRAME_PHASE_TOTAL       = 6,
+    /* Invalid phase, used internally */
+    FRAME_PHASE_COUNT       = 7,
+};
+
+/**
+ * Statistics about the duration of a single phase of the repaint cycle, computed over the last rendered
+ * frames of an output. All durations are in microseconds.
+ */
+struct frame_phase_stats_t
+{
+    /* The number of frames the statistics are based on */
+    int samples = 0;
+
+    int64_t min = 0;
+    int64_t max = 0;
+    int64_t avg = 0;
+    int64_t p50 = 0;
+    int64_t p90 = 0;
+    int64_t p99 = 0;
+
+    /**
+     * A histogram of the durations: histogram[i] is the number of frames for which the phase took between
+     * 2^i and 2^(i+1) microseconds. Durations below one microsecond are counted in histogram[0].
+     */
+    std::vector<int> histogram;
+};
+
+/**
+ * Frame timing statistics of an output, see render_manager::get_frame_stats().
+ */
+struct frame_stats_t
+{
+    /* Number of frames which were rendered since the output was created */
+    uint64_t rendered_frames = 0;
+    /* Number of frames which were directly scanned out since the output was created */
+    uint64_t scanout_frames  = 0;
+    /* Number of repaints which did no GL work and committed nothing, because nothing visible changed */
+    uint64_t idle_frames = 0;
+    /* Statistics for each phase of the repaint cycle, indexed by frame_phase_t */
+    frame_phase_stats_t phases[FRAME_PHASE_COUNT];
+};
+
+/**
+ * The reasons why a repaint of an output was composited instead of directly scanning out a client buffer, see
+ * render_manager::get_scanout_stats(). The render manager checks its own blockers first, so each attempt is
+ * counted under the first blocker which was found.
+ */
+enum scanout_blocker_t
+{
+    /* The frame was scanned out */
+    SCANOUT_BLOCKER_NONE              = 0,
+    /* Disabled with WAYFIRE_DISABLE_DIRECT_SCANOUT */
+    SCANOUT_BLOCKER_DISABLED          = 1,
+    /* The previous frame has not been presented yet */
+    SCANOUT_BLOCKER_COMMIT_PENDING    = 2,
+    /* A plugin inhibits the output, see render_manager::add_inhibit() */
+    SCANOUT_BLOCKER_INHIBITED         = 3,
+    /* Overlay or post effect hooks are present, see render_manager::add_effect() */
+    SCANOUT_BLOCKER_EFFECT_HOOK       = 4,
+    /* Post-processing is needed: post hooks, color transforms, a render scale or render region */
+    SCANOUT_BLOCKER_POST_PROCESSING   = 5,
+    /* A new gamma LUT has to be applied with a rendered frame */
+    SCANOUT_BLOCKER_GAMMA             = 6,
+    /* Some contents are presented on output layers */
+    SCANOUT_BLOCKER_OUTPUT_LAYERS     = 7,
+    /* Refused by wlroots, for example because of a software cursor */
+    SCANOUT_BLOCKER_BACKEND           = 8,
+    /* There is no surface which could be scanned out */
+    SCANOUT_BLOCKER_NO_SURFACE        = 9,
+    /* Something which is not a client surface covers the output, for example decorations */
+    SCANOUT_BLOCKER_OCCLUDED          = 10,
+    /* The topmost surface does not cover exactly the output, for example a subsurface or a window which is
+     * not fullscreen */
+    SCANOUT_BLOCKER_SURFACE_GEOMETRY  = 11,
+    /* The scale or transform of the surface is different from the output's */
+    SCANOUT_BLOCKER_SURFACE_TRANSFORM = 12,
+    /* The surface is not fully opaque */
+    SCANOUT_BLOCKER_SURFACE_OPACITY   = 13,
+    /* The output did not accept the buffer, usually because of its format or modifier */
+    SCANOUT_BLOCKER_BUFFER_REJECTED   = 14,
+    SCANOUT_BLOCKER_COUNT             = 15,
+};
+
+/**
+ * Direct scanout statistics of an output since it was created, see render_manager::get_scanout_stats().
+ */
+struct scanout_stats_t
+{
+    /* Number of repaints which were directly scanned out */
+    uint64_t scanout_frames = 0;
+    /* Number of repaints which could not be scanned out, indexed by scanout_blocker_t */
+    uint64_t blocked_frames[SCANOUT_BLOCKER_COUNT] = {};
+    /* The reason of the last repaint */
+    scanout_blocker_t last_blocker = SCANOUT_BLOCKER_NONE;
+    /* The plugins (or "core") which currently have overlay or post effect hooks */
+    std::vector<std::string> effect_hook_owners;
+    /* The plugins (or "core") which currently have post hooks */
+    std::vector<std::string> post_hook_owners;
+    /* The plugins (or "core") which currently inhibit the output */
+    std::vector<std::string> inhibit_owners;
+};
+
+/**
+ * A source of repaints of an output, see render_manager::get_repaint_sources().
+ *
+ * Requests made through the render manager are attributed to the plugin which contains the calling code, or
+ * to "core". Damage which comes from the scenegraph, for example from clients, is attributed to "scene".
+ */
+struct repaint_source_t
+{
+    std::string owner;
+    /* The number of set_redraw_always(true) calls which have not been undone yet */
+    int redraw_always = 0;
+    /* For how long redraw_always has been held, in microseconds */
+    int64_t redraw_always_usec = 0;
+    /* The number of damage and schedule_redraw() requests since the output was created */
+    uint64_t requests = 0;
+    /* The number of requests per second, measured over the last second */
+    double requests_per_second = 0;
+};
+
+/**
+ * Input latency statistics of an output, see render_manager::get_input_latency_stats(). All durations are in
+ * microseconds, the histograms use the same buckets as frame_phase_stats_t.
+ */
+struct input_latency_stats_t
+{
+    /* From receiving an input event to the next commit of the surface which the event was sent to */
+    frame_phase_stats_t input_to_commit;
+    /* From that commit to the presentation of the first frame on the output which contains it */
+    frame_phase_stats_t commit_to_present;
+    /* From receiving the input event to the presentation */
+    frame_phase_stats_t input_to_present;
+};
+
 /**
  * The frame-done signal is emitted on an output when the frame has been completed (regardless of whether new
  * content was painted or not).
  */
 struct frame_done_signal
-{};
+{
+    /**
+     * The time in milliseconds until the repaint of the current frame starts, or 0 if the output has already
+     * been repainted.
+     */
+    int repaint_delay = 0;
+};
+
+/**
+ * on: output, core
+ * when: The output stops or starts showing its contents, see render_manager::is_content_shown().
+ */
+struct output_content_shown_signal
+{
+    wf::output_t *output;
+    bool shown;
+};
 
 /** Render manager
  *
@@ -71,7 +268,9 @@ class render_manager
      * possible, for ex. when displaying some kind of animation.
      *
      * auto_redraw() provides the plugins to temporarily request redrawing
-     * of the output regardless of damage.
+     * of the output regardless of damage. Effect hooks then run every refresh
+     * cycle, but a frame is rendered only if something visible was damaged,
+     * or if overlay or post effects are active.
      *
      * @param always - Whether to always redraw, regardless of damage. Call
      *        set_redraw_always(false) once for each set_redraw_always(true).
@@ -80,7 +279,8 @@ class render_manager
 
     /**
      * Schedule a frame for the output. Note that if there is no damage for
-     * the next frame, nothing will be redrawn
+     * the next frame, nothing will be redrawn, unless overlay or post effects
+     * are active
      */
     void schedule_redraw();
 
@@ -90,6 +290,23 @@ class render_manager
      */
     void add_inhibit(bool add);
 
+    /**
+     * Mark the output as blanked, for example by a screensaver which also
+     * inhibits it. Unlike inhibited outputs in general, which may be waiting
+     * for a client to draw, blanked outputs do not need new frames from
+     * their clients.
+     */
+    void set_blanked(bool blanked);
+
+    /**
+     * @return Whether the output shows its contents, that is, it is neither
+     *   turned off (for example with DPMS) nor blanked. Clients which are
+     *   visible only on outputs which do not show their contents are
+     *   throttled: their surfaces leave those outputs, and they get no frame
+     *   callbacks and cause no repaints until the contents are shown again.
+     */
+    bool is_content_shown() const;
+
     /**
      * Add a new effect hook.
      * @param hook The hook callback
@@ -109,6 +326,19 @@ class render_manager
      */
     void add_post(post_hook_t *hook);
 
+    /**
+     * Add a new post hook which repaints only the damaged parts of its destination.
+     *
+     * The source and destination buffers of post hooks keep their contents between frames, so a hook whose
+     * pixels depend only on a known part of the source needs to repaint only the region computed by
+     * @damage, which it can query with get_post_hook_damage() while it runs. The hook is still called every
+     * frame, even if its damage is empty.
+     *
+     * @param hook The hook callback
+     * @param damage How the hook maps damage from its source to its destination.
+     */
+    void add_post(post_hook_t *hook, post_hook_damage_t damage);
+
     /**
      * Remove a post hook. No-op if hook isn't active.
      *
@@ -116,6 +346,43 @@ class render_manager
      */
     void rem_post(post_hook_t *hook);
 
+    /**
+     * Add a color transform to the output image.
+     *
+     * All color transforms on an output are composed into a single matrix, in the order in which they were
+     * added, and applied by the render manager in one pass after all post hooks. This is much cheaper than
+     * a post hook for each color filter, and repaints only the damaged parts of the output.
+     *
+     * When there are no other post hooks and the composed matrix acts on each channel separately (for
+     * example inverting, dimming or tinting), it is applied with the gamma LUT of the output instead, so
+     * direct scanout stays possible. In this case the transform is not visible in screenshots.
+     *
+     * The matrix of the transform may be changed while it is added. Afterwards, the whole output has to be
+     * damaged, for example with damage_whole().
+     *
+     * @param transform The transform, which must stay alive until it is removed.
+     */
+    void add_color_transform(color_transform_t *transform);
+
+    /**
+     * Remove a color transform. No-op if the transform isn't active.
+     */
+    void rem_color_transform(color_transform_t *transform);
+
+    /**
+     * Render only a part of the output, magnified to fill the whole output.
+     *
+     * The scene is rendered directly at the magnified resolution, so in contrast to magnifying the output
+     * with a post hook, nothing outside of the region is rendered, and damage is still tracked. Direct
+     * scanout and output layers are disabled while a region is set. Input is not affected.
+     *
+     * The region should have the aspect ratio of the output, otherwise the image is stretched vertically.
+     * Changing the region damages the whole output.
+     *
+     * @param region The region in output-local coordinates, or std::nullopt to render the whole output.
+     */
+    void set_render_region(std::optional<wf::geometry_t> region);
+
     /**
      * @return The damaged region on the current output for the current
      * frame that is used when swapping buffers. This function should
@@ -124,6 +391,14 @@ class render_manager
      */
     wf::region_t get_swap_damage();
 
+    /**
+     * @return The region of its destination the currently running post hook has to repaint, in framebuffer
+     * coordinates. This is the whole buffer for post hooks added without a damage mapping, and in all
+     * cases until each hook in the chain has a damage mapping. This function should only be called from
+     * post hooks.
+     */
+    wf::region_t get_post_hook_damage();
+
     /**
      * @return The damaged region on the current output for the current
      * frame. Note that a larger region might actually be repainted due to
@@ -160,6 +435,36 @@ class render_manager
      */
     void damage(const wf::region_t& region, bool repaint = true);
 
+    /**
+     * @return A counter which is incremented each time the output is damaged. Render instances can use it
+     *   to check whether anything on the output could have changed since an earlier frame, for example to
+     *   reuse the results of an expensive effect.
+     */
+    uint64_t get_damage_generation() const;
+
+    /**
+     * @return The predicted time at which the frame being painted will be presented, in microseconds and
+     *   on the same clock as wf::get_current_time_usec(). Outside of a repaint, the prediction is for a
+     *   frame started now.
+     *
+     * The prediction is the first refresh cycle after the frame starts, based on the timestamp and refresh
+     * period reported with the last presented frame. Animations should sample their progress at this time,
+     * so that they advance evenly on screen even if repaints start at slightly different times.
+     */
+    int64_t get_predicted_presentation_time() const;
+
+    /**
+     * @return How much of its usual work the given effect may do on this output, between 0 (the cheapest
+     *   fallback) and 1 (full quality).
+     *
+     * When frames do not fit in the refresh period anymore, the effects listed in
+     * workarounds/effect_degradation_order are degraded one after another, and restored once there is
+     * enough headroom again. Effects which are not in the list always get 1. Plugins should check the
+     * quality when they start an animation or schedule their rendering, and scale down their work
+     * accordingly, for example by using fewer blur iterations.
+     */
+    double get_effect_quality(const std::string& effect) const;
+
     /**
      * @return A box in output-local coordinates containing the given
      * workspace of the output (returned value depends on current workspace).
@@ -178,6 +483,51 @@ class render_manager
      */
     void set_require_depth_buffer(bool require);
 
+    /**
+     * Get timing statistics about the last frames rendered on the output.
+     * Frames which were directly scanned out are not included in the per-phase statistics.
+     */
+    frame_stats_t get_frame_stats();
+
+    /**
+     * Get the plugins which keep the output repainting, either by holding set_redraw_always() or by
+     * damaging it. Repaints without visible damage do no GL work, see frame_stats_t::idle_frames.
+     */
+    std::vector<repaint_source_t> get_repaint_sources();
+
+    /**
+     * Get statistics about the latency of the last keyboard and pointer events which caused a client to
+     * commit a surface visible on the output.
+     */
+    input_latency_stats_t get_input_latency_stats();
+
+    /**
+     * Get statistics about which repaints were directly scanned out, and what prevented the others.
+     */
+    scanout_stats_t get_scanout_stats();
+
+    /**
+     * Report why direct scanout is not possible. Called by render instances from try_scanout() before they
+     * return direct_scanout::OCCLUSION, only the first reported blocker of a repaint is kept.
+     */
+    void report_scanout_blocker(scanout_blocker_t blocker);
+
+    /**
+     * Allow or forbid tearing page flips on the output. If allowed, directly scanned out fullscreen surfaces
+     * whose clients ask for tearing via the tearing-control protocol are presented with async page flips.
+     *
+     * Initially, and whenever the output option allow_tearing changes, the value of the option is used.
+     */
+    void set_tearing_allowed(bool allowed);
+    bool is_tearing_allowed();
+
+    /**
+     * Add the changes of the output state which the next commit should carry to @state, for example enabling
+     * adaptive sync for a fullscreen view. Called by render instances which commit the output themselves in
+     * try_scanout(), so that directly scanned out frames get the same state as rendered frames.
+     */
+    void plan_scanout_state(wlr_output_state& state);
+
   private:
     class impl;
     std::unique_ptr<impl> pimpl;
@@ -8,6 +8,7 @@
 #include <wayfire/geometry.hpp>
 #include <wayfire/opengl.hpp>
 #include <wayfire/signal-provider.hpp>
+#include <wayfire/plugin-stats.hpp>
 
 namespace wf
 {
@@ -16,8 +17,10 @@ namespace scene
 {
 class node_t;
 using node_ptr = std::shared_ptr<node_t>;
+using node_weak_ptr = std::weak_ptr<node_t>;
 
 class render_instance_t;
+class render_pass_arena_t;
 
 /**
  * Describes the result of trying to do direct scanout of a render instance on
@@ -41,6 +44,36 @@ enum class direct_scanout
     SUCCESS,
 };
 
+/**
+ * The contents of a render instance which may be presented on an output layer,
+ * i.e. a hardware plane which the display controller blends on top of the
+ * composited output buffer.
+ */
+struct output_layer_candidate_t
+{
+    /** The render instance which is no longer rendered if the layer is used. */
+    render_instance_t *instance = NULL;
+    /** The buffer to present. */
+    wlr_buffer *buffer = NULL;
+    /** The part of the buffer to present, in buffer coordinates. */
+    wlr_fbox src_box;
+    /** Where to present the buffer, in output-local framebuffer coordinates. */
+    wlr_box dst_box;
+};
+
+/**
+ * The state passed to render_instance_t::try_output_layers().
+ */
+struct output_layers_plan_t
+{
+    /** The maximal number of candidates to collect. */
+    size_t max_layers = 0;
+    /** The offset from the current coordinate system to output-local coordinates. */
+    wf::point_t offset = {0, 0};
+    /** The candidates collected so far, topmost first. */
+    std::vector<output_layer_candidate_t> candidates;
+};
+
 /**
  * A single rendering call in a render pass.
  */
@@ -50,6 +83,14 @@ struct render_instruction_t
     wf::render_target_t target;
     wf::region_t damage;
     std::any data = {};
+    // Set by parents which apply effects to their children without rendering them to an auxiliary buffer
+    // first, see render_instance_t::supports_direct_render().
+    //
+    // A multiplier for the opacity of the instance.
+    float alpha = 1.0f;
+    // A transform from the coordinate system of the instance to the logical coordinates of @target. If set,
+    // @damage is in the coordinates of @target as well.
+    std::optional<glm::mat4> transform;
 };
 
 /**
@@ -89,6 +130,11 @@ class render_instance_t
      * @param fb The target framebuffer to render the node and its children.
      *   Note that some nodes may cause their children to be rendered to
      *   auxiliary buffers.
+     *
+     * schedule_instructions() is always called on the main thread, during the render pass of the output or
+     * auxiliary buffer, so implementations may use the scenegraph, GL and the state of their plugin. Some
+     * of them rely on this, for example to update auxiliary buffers with nested render passes (the
+     * workspace wall, the cube) or to keep per-frame state shared between instances (blur).
      */
     virtual void schedule_instructions(
         std::vector<render_instruction_t>& instructions,
@@ -121,6 +167,37 @@ class render_instance_t
         render(target, region);
     }
 
+    /**
+     * Whether the instance, and all instances it schedules instructions for, can be rendered with an
+     * opacity multiplier or an additional transform, see render_with_alpha() and render_transformed().
+     *
+     * Scheduling the instructions of such instances must not have side effects, so that parents can
+     * drop the instructions again if they decide to render the children to an auxiliary buffer after all.
+     */
+    virtual bool supports_direct_render()
+    {
+        return false;
+    }
+
+    /**
+     * Same as render(), but the opacity of the rendered contents is multiplied by @alpha.
+     * Only called for instances whose supports_direct_render() returns true.
+     */
+    virtual void render_with_alpha(const wf::render_target_t& target,
+        const wf::region_t& region, float alpha)
+    {
+        render(target, region);
+    }
+
+    /**
+     * Same as render_with_alpha(), but the contents are mapped by @transform from the coordinate system of
+     * the instance to the logical coordinates of @target, in which @region is given as well.
+     * Only called for instances whose supports_direct_render() returns true.
+     */
+    virtual void render_transformed(const wf::render_target_t& target,
+        const wf::region_t& region, const glm::mat4& transform, float alpha)
+    {}
+
     /**
      * Notify the render instance that it has been presented on an output.
      * Note that a render instance may get multiple presentation_feedback calls
@@ -146,6 +223,25 @@ class render_instance_t
         return direct_scanout::OCCLUSION;
     }
 
+    /**
+     * Attempt to present the render instance on an output layer.
+     *
+     * Output layers are stacked above the output's primary buffer, so only the
+     * topmost contents of an output can be moved to them. Render instances are
+     * visited from top to bottom, like in try_scanout(). An instance without
+     * visible contents returns SKIP. An instance which can be presented on a
+     * layer adds itself to @plan and returns SUCCESS, so that instances below it
+     * are visited as well. Any other instance returns OCCLUSION, which ends the
+     * search.
+     *
+     * Instances which have been added to the plan are excluded from the render
+     * pass if the output accepts the layer, see render_pass_params_t.
+     */
+    virtual direct_scanout try_output_layers(wf::output_t *output, output_layers_plan_t& plan)
+    {
+        return direct_scanout::OCCLUSION;
+    }
+
     /**
      * Compute the render instance's visible region on the given output.
      *
@@ -154,6 +250,16 @@ class render_instance_t
      */
     virtual void compute_visibility(wf::output_t *output, wf::region_t& visible)
     {}
+
+    /**
+     * The node this render instance was generated for, if the instance reports it. It is used to attribute
+     * render statistics to nodes, see get_node_render_stats(), and to skip disabled and empty nodes in
+     * try_scanout_from_list().
+     */
+    virtual node_t *get_node() const
+    {
+        return nullptr;
+    }
 };
 
 using render_instance_uptr = std::unique_ptr<render_instance_t>;
@@ -169,12 +275,50 @@ struct node_damage_signal
     wf::region_t region;
 };
 
+/**
+ * Render statistics of a single node, collected while the wf::plugin_stats accounting is enabled.
+ *
+ * Render instructions are attributed to the node returned by render_instance_t::get_node(). The time spent
+ * in render() includes nested render passes, for example when a transformer renders its children.
+ */
+struct node_render_stats_t
+{
+    /** The number of render instructions executed for the node */
+    uint64_t instructions = 0;
+    /** The total area of the damage of those instructions, in the coordinates of their render targets */
+    uint64_t pixels = 0;
+    /** The total time spent in render() */
+    int64_t render_usec = 0;
+    /** The number of damage_node() calls on the node, and the total area of the damage */
+    uint64_t damage_events = 0;
+    uint64_t damage_pixels = 0;
+};
+
+/**
+ * Get the statistics of a node since the accounting was enabled, or nullptr if nothing was recorded for
+ * it. The statistics of render instances which do not report their node are returned for a nullptr node.
+ */
+const node_render_stats_t *get_node_render_stats(node_t *node);
+
+/** Forget the statistics of all nodes. */
+void reset_node_render_stats();
+
+namespace detail
+{
+void note_node_damage(node_t *node, const wf::region_t& damage);
+}
+
 /**
  * A helper function to emit the damage signal on a node.
  */
 template<class NodePtr>
 inline void damage_node(NodePtr node, wf::region_t damage)
 {
+    if (wf::plugin_stats::enabled)
+    {
+        detail::note_node_damage(&*node, damage);
+    }
+
     node_damage_signal data;
     data.region = damage;
     node->emit(&data);
@@ -223,6 +367,16 @@ enum render_pass_flags
     RPASS_CLEAR_BACKGROUND = (1 << 1),
 };
 
+/**
+ * The time (in microseconds) spent in the individual steps of a render pass.
+ */
+struct render_pass_timings_t
+{
+    int64_t schedule_instructions = 0;
+    int64_t clear_background = 0;
+    int64_t render_instructions = 0;
+};
+
 /**
  * A struct containing the information necessary to execute a render pass.
  */
@@ -248,8 +402,70 @@ struct render_pass_params_t
      * feedback.
      */
     output_t *reference_output = nullptr;
+
+    /**
+     * If set, the time spent in the different steps of the render pass is stored here.
+     */
+    render_pass_timings_t *timings = nullptr;
+
+    /**
+     * An optional buffer used for storing the render instructions during the render pass.
+     *
+     * Callers which execute render passes repeatedly (e.g. every frame) should keep a buffer around, so that
+     * its capacity is reused between frames and the instruction list does not have to be reallocated every
+     * time. The buffer is left empty after the render pass. It must not be shared with render passes which
+     * run nested inside the current one.
+     */
+    std::vector<render_instruction_t> *instruction_buffer = nullptr;
+
+    /**
+     * An optional arena for the damage regions of the render instructions, see render_pass_arena_t.
+     * Render passes nested inside the current one use the same arena.
+     */
+    render_pass_arena_t *arena = nullptr;
+
+    /**
+     * Render instances whose contents are presented on output layers. Instructions
+     * from these instances are not executed.
+     */
+    const std::vector<render_instance_t*> *offloaded_instances = nullptr;
 };
 
+/**
+ * Storage for the damage regions of render instructions, kept by callers which run render passes every
+ * frame (see render_pass_params_t::arena).
+ *
+ * At the end of a render pass, the damage regions of its instructions are given back to the arena, and
+ * handed out again by clip_instruction_damage() in the next pass. This way, the memory pixman allocates for
+ * the rectangles of a region is reused, instead of being allocated and freed for every instruction in every
+ * frame.
+ */
+class render_pass_arena_t
+{
+  public:
+    /** Get a region whose storage may already be allocated. Its contents are unspecified. */
+    wf::region_t take_region();
+    /** Give the storage of @region back to the arena. */
+    void return_region(wf::region_t&& region);
+
+    /**
+     * Free the regions which were not needed since the last reset, so that the arena does not keep the
+     * memory of a single expensive frame forever. Should be called after each frame.
+     */
+    void reset();
+
+  private:
+    std::vector<wf::region_t> regions;
+    size_t in_use = 0;
+    size_t peak_in_use = 0;
+};
+
+/**
+ * Compute the intersection of @damage and @box, typically the damage of a new render instruction.
+ * Inside a render pass with an arena, the storage of the result is taken from the arena.
+ */
+wf::region_t clip_instruction_damage(const wf::region_t& damage, const wf::geometry_t& box);
+
 /**
  * A helper function to execute a render pass.
  *
@@ -270,16 +486,44 @@ struct render_pass_params_t
 wf::region_t run_render_pass(
     const render_pass_params_t& params, uint32_t flags);
 
+/**
+ * Execute several render passes at once, for example one for each workspace of a workspace wall.
+ *
+ * First, render-pass-begin is emitted and the render instructions are generated for each pass, then the
+ * instructions of all passes are executed in one sweep, each pass followed by its render-pass-end.
+ * Compared to calling run_render_pass() for each target, the GL work of the passes is not interleaved with
+ * scheduling, and all passes share the arena of the first one which has one.
+ *
+ * The passes must not share an instruction buffer.
+ *
+ * @return The damage which was rendered by each pass, see run_render_pass().
+ */
+std::vector<wf::region_t> run_render_passes(
+    const std::vector<render_pass_params_t>& passes, uint32_t flags);
+
 /**
  * A helper function for direct scanout implementations.
  * It tries to forward the direct scanout request to the first render instance
  * in the given list, and returns the first non-SKIP result, or SKIP, if no
  * instance interacts with direct scanout.
+ *
+ * Instances whose node (see render_instance_t::get_node()) is disabled or has an empty bounding box draw
+ * nothing, so they are skipped.
  */
 direct_scanout try_scanout_from_list(
     const std::vector<render_instance_uptr>& instances,
     wf::output_t *scanout);
 
+/**
+ * A helper function for try_output_layers implementations.
+ * It visits the render instances in the given list until one of them returns
+ * OCCLUSION. The result is OCCLUSION in that case, otherwise SUCCESS, if at
+ * least one instance was added to the plan, or SKIP.
+ */
+direct_scanout try_output_layers_from_list(
+    const std::vector<render_instance_uptr>& instances,
+    wf::output_t *output, output_layers_plan_t& plan);
+
 /**
  * A helper function for compute_visibility implementations. It applies an offset to the damage and reverts it
  * afterwards. It also calls compute_visibility for the children instances.
@@ -309,10 +553,15 @@ class simple_render_instance_t : public render_instance_t
         instructions.push_back(render_instruction_t{
                     .instance = this,
                     .target   = target,
-                    .damage   = damage & self->get_bounding_box(),
+                    .damage   = clip_instruction_damage(damage, self->get_bounding_box()),
                 });
     }
 
+    node_t *get_node() const override
+    {
+        return self.get();
+    }
+
   protected:
     std::shared_ptr<Node> self;
     wf::signal::connection_t<scene::node_damage_signal> on_self_damage = [=] (scene::node_damage_signal *ev)
@@ -331,8 +580,45 @@ class simple_render_instance_t : public render_instance_t
  * are updated, these nodes update only their internal list of children and not the entire scenegraph.
  */
 struct node_regen_instances_signal
-{};
+{
+    /**
+     * The child of the node whose subtree changed, or nullptr if unknown. In the latter case, the instances
+     * of all children have to be regenerated.
+     *
+     * If it is the node itself, only the list of children of the node changed: the instances of the
+     * remaining children are kept, and instances are generated only for the added children.
+     */
+    node_t *changed_child = nullptr;
+
+    /**
+     * Set by the render instances which handled the signal. If the node itself changed and none of its
+     * render instances updated their children, the parent regenerates the instances of the whole node.
+     */
+    bool handled = false;
+};
 
 uint32_t optimize_nested_render_instances(wf::scene::node_ptr node, uint32_t flags);
+
+/**
+ * Which child of a node generated which of the render instances in a list of children instances.
+ * Each entry contains the child and the number of consecutive instances it generated.
+ */
+using children_instances_origin_t = std::vector<std::pair<node_weak_ptr, size_t>>;
+
+/**
+ * Regenerate the render instances of the enabled children of @node, for render instances which keep a list
+ * of their children's instances.
+ *
+ * Instances of children other than @changed_child which are still present in @node are moved over from the
+ * old list, so that only the changed subtree needs to be regenerated and the damage connections of the
+ * unchanged children stay intact. If @changed_child is nullptr, all instances are regenerated, and if it is
+ * @node, only the instances of the children which were added to @node are generated.
+ *
+ * @param instances The list of children instances, replaced with the new list.
+ * @param origin The origin of the instances in @instances, as filled in by the previous call.
+ */
+void regen_children_instances(node_t *node, node_t *changed_child,
+    std::vector<render_instance_uptr>& instances, children_instances_origin_t& origin,
+    damage_callback push_damage, wf::output_t *shown_on);
 }
 }
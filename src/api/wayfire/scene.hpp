@@ -419,6 +419,7 @@ class output_node_t : public floating_inner_node_t
 {
   public:
     output_node_t(wf::output_t *output);
+    ~output_node_t();
     std::string stringify() const override;
 
     wf::pointf_t to_local(const wf::pointf_t& point) override;
@@ -435,6 +436,15 @@ class output_node_t : public floating_inner_node_t
 
     wf::geometry_t get_bounding_box() override;
     std::optional<input_node_t> find_node_at(const wf::pointf_t& at) override;
+    uint32_t optimize_update(uint32_t update_flags) override;
+
+    /**
+     * find_node_at() keeps the bounding boxes of the views below this node in an index, so that views which
+     * are not under the queried point can be skipped without walking their subtrees. The index is dropped
+     * whenever an update with INPUT_STATE passes through this node. Since transformers may change the
+     * bounding box of a view without an update, the index should also be invalidated before each frame.
+     */
+    void invalidate_input_index();
 
     /**
      * Get the output this node is responsible for.
@@ -454,6 +464,9 @@ class output_node_t : public floating_inner_node_t
 
   private:
     wf::output_t *output;
+
+    struct input_index_t;
+    std::unique_ptr<input_index_t> input_index;
 };
 
 /**
@@ -523,5 +536,46 @@ void set_node_enabled(wf::scene::node_ptr node, bool enabled);
  * @param flags A bit mask consisting of flags defined in the @update_flag enum.
  */
 void update(node_ptr changed_node, uint32_t flags);
+
+/**
+ * Get a counter which changes each time wf::scene::update() is called with update_flag::CHILDREN_LIST,
+ * including the updates delayed by an update_batch_t.
+ *
+ * It can be used to cache information which depends on the structure of the scenegraph, for example the
+ * stacking order of nodes.
+ */
+uint64_t get_children_list_generation();
+
+/**
+ * A scoped guard which coalesces scenegraph updates.
+ *
+ * While at least one update batch exists, wf::scene::update() still updates
+ * the nodes on the way to the root (so render instances etc. stay in sync),
+ * but the root_node_update_signal is not emitted for each update. Instead, the
+ * flags of all updates are combined and the signal is emitted once, when the
+ * last batch is destroyed. Pending updates are also flushed when the event loop
+ * goes idle and before an output is repainted.
+ *
+ * This is useful when many nodes are changed at once, for example when
+ * restacking or moving many views, so that the listeners of the root update
+ * (input refocus, render instances of the outputs, etc.) run only once.
+ */
+class update_batch_t
+{
+  public:
+    update_batch_t();
+    ~update_batch_t();
+
+    update_batch_t(const update_batch_t&) = delete;
+    update_batch_t(update_batch_t&&) = delete;
+    update_batch_t& operator =(const update_batch_t&) = delete;
+    update_batch_t& operator =(update_batch_t&&) = delete;
+};
+
+/**
+ * Emit the root_node_update_signal for updates delayed by an update_batch_t,
+ * if there are any.
+ */
+void flush_pending_updates();
 }
 } // namespace wf
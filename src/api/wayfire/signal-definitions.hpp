@@ -3,6 +3,7 @@
 
 #include "wayfire/view.hpp"
 #include "wayfire/output.hpp"
+#include <set>
 
 /**
  * Documentation of signals emitted from core components.
@@ -175,7 +176,33 @@ struct post_input_event_signal
  * when: When the config file is reloaded
  */
 struct reload_config_signal
-{};
+{
+    /**
+     * The names of the sections in which at least one option has changed. If the config backend does not
+     * know what changed, the set is empty and any section may have changed.
+     */
+    std::set<std::string> changed_sections;
+
+    /**
+     * Check whether options in the given section may have changed. A name ending with ':' matches all
+     * sections with that prefix, for example "output:" matches the sections of all outputs.
+     */
+    bool may_have_changed(const std::string& section) const
+    {
+        if (changed_sections.empty())
+        {
+            return true;
+        }
+
+        if (section.empty() || (section.back() != ':'))
+        {
+            return changed_sections.count(section);
+        }
+
+        auto it = changed_sections.lower_bound(section);
+        return (it != changed_sections.end()) && (it->rfind(section, 0) == 0);
+    }
+};
 
 /**
  * on: core
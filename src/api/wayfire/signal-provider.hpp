@@ -1,12 +1,13 @@
 #pragma once
 
+#include <algorithm>
 #include <functional>
 #include <memory>
 #include <unordered_set>
-#include <unordered_map>
+#include <vector>
 #include <wayfire/nonstd/safe-list.hpp>
+#include <wayfire/plugin-stats.hpp>
 #include <cassert>
-#include <typeindex>
 
 namespace wf
 {
@@ -104,6 +105,8 @@ class connection_t final : public connection_base_t
     {
         if (current_callback)
         {
+            wf::plugin_stats::scope_t cost{current_callback.target_type(), wf::plugin_stats::COST_SIGNAL,
+                &typeid(SignalType)};
             current_callback(data);
         }
     }
@@ -120,6 +123,47 @@ class connection_t final : public connection_base_t
     callback current_callback;
 };
 
+namespace detail
+{
+/**
+ * Get a small integer which identifies the given signal type. Types are compared by name, so the same type
+ * gets the same slot in core and in all plugins.
+ */
+size_t allocate_signal_slot(const std::type_info& type);
+
+template<class SignalType>
+size_t signal_slot()
+{
+    static const size_t slot = allocate_signal_slot(typeid(SignalType));
+    return slot;
+}
+
+/**
+ * The connections to a single signal type of a provider.
+ *
+ * Connections which are disconnected during an emission are only reset to nullptr, and the list is compacted
+ * once the outermost emission is done.
+ */
+struct connection_list_t
+{
+    std::vector<connection_base_t*> connections;
+    int emitting = 0;
+    bool dirty   = false;
+
+    void compact()
+    {
+        if ((emitting > 0) || !dirty)
+        {
+            return;
+        }
+
+        auto it = std::remove(connections.begin(), connections.end(), nullptr);
+        connections.erase(it, connections.end());
+        dirty = false;
+    }
+};
+}
+
 class provider_t
 {
   public:
@@ -137,7 +181,16 @@ class provider_t
     template<class SignalType>
     void connect(connection_t<SignalType> *callback)
     {
-        typed_connections[index<SignalType>()].push_back(callback);
+        const size_t slot = detail::signal_slot<SignalType>();
+        auto list = find_connections(slot);
+        if (!list)
+        {
+            slots.push_back(slot);
+            lists.push_back(std::make_unique<detail::connection_list_t>());
+            list = lists.back().get();
+        }
+
+        list->connections.push_back(callback);
         callback->connected_to.insert(this);
     }
 
@@ -145,23 +198,60 @@ class provider_t
     void disconnect(connection_base_t *callback)
     {
         callback->connected_to.erase(this);
-        for (auto& [id, connected] : typed_connections)
+        for (auto& list : lists)
         {
-            connected.remove_all(callback);
+            for (auto& connection : list->connections)
+            {
+                if (connection == callback)
+                {
+                    connection  = nullptr;
+                    list->dirty = true;
+                }
+            }
+
+            list->compact();
         }
     }
 
+    /**
+     * Check whether anything is connected to the given signal, so that emitters can skip preparing the
+     * signal data if it is expensive.
+     */
+    template<class SignalType>
+    bool has_connections()
+    {
+        auto list = find_connections(detail::signal_slot<SignalType>());
+        return list && std::any_of(list->connections.begin(), list->connections.end(),
+            [] (connection_base_t *connection) { return connection != nullptr; });
+    }
+
     /** Emit the given signal. */
     template<class SignalType>
     void emit(SignalType *data)
     {
-        auto& conns = typed_connections[std::type_index(typeid(SignalType))];
-        conns.for_each([&] (connection_base_t *tc)
+        auto list = find_connections(detail::signal_slot<SignalType>());
+        if (!list || list->connections.empty())
+        {
+            return;
+        }
+
+        wf::plugin_stats::emit_scope_t cost{typeid(SignalType), list->connections.size()};
+
+        // Important: connections which are added during the emission are not called. The list is stable,
+        // because lists are never freed before the provider itself.
+        const size_t count = list->connections.size();
+        ++list->emitting;
+        for (size_t i = 0; i < count; i++)
         {
-            auto real_type = dynamic_cast<connection_t<SignalType>*>(tc);
-            assert(real_type);
-            real_type->emit(data);
-        });
+            if (auto connection = list->connections[i])
+            {
+                // Only connection_t<SignalType> are connected to the slot of SignalType.
+                static_cast<connection_t<SignalType>*>(connection)->emit(data);
+            }
+        }
+
+        --list->emitting;
+        list->compact();
     }
 
     provider_t()
@@ -169,12 +259,15 @@ class provider_t
 
     ~provider_t()
     {
-        for (auto& [id, connected] : typed_connections)
+        for (auto& list : lists)
         {
-            connected.for_each([&] (connection_base_t *base)
+            for (auto& connection : list->connections)
             {
-                base->connected_to.erase(this);
-            });
+                if (connection)
+                {
+                    connection->connected_to.erase(this);
+                }
+            }
         }
     }
 
@@ -187,14 +280,26 @@ class provider_t
     provider_t& operator =(provider_t&& other) = delete;
 
   private:
-    template<class SignalType>
-    static inline std::type_index index()
+    detail::connection_list_t *find_connections(size_t slot)
     {
-        return std::type_index(typeid(SignalType));
+        for (size_t i = 0; i < slots.size(); i++)
+        {
+            if (slots[i] == slot)
+            {
+                return lists[i].get();
+            }
+        }
+
+        return nullptr;
     }
 
-    std::unordered_map<std::type_index, wf::safe_list_t<connection_base_t*>>
-    typed_connections;
+    /**
+     * The slots of the signal types which have (or had) connections, and the corresponding lists. Providers
+     * usually have connections to only a few signal types, so a linear search over the slots is faster
+     * than hashing the type.
+     */
+    std::vector<size_t> slots;
+    std::vector<std::unique_ptr<detail::connection_list_t>> lists;
 };
 }
 }
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+
+namespace wf
+{
+struct thread_pool_stats_t
+{
+    /** The number of worker threads, they are started with the first job */
+    size_t threads = 0;
+    /** The jobs waiting for a worker thread */
+    size_t queued  = 0;
+    /** The jobs which are currently running */
+    size_t running = 0;
+    /** The jobs which are done, but whose callback has not run on the main thread yet */
+    size_t finished   = 0;
+    size_t max_queued = 0;
+    uint64_t completed = 0;
+    /** The jobs which were dropped before they ran, or whose callback was skipped */
+    uint64_t cancelled = 0;
+};
+
+/**
+ * A pool of worker threads for work which would otherwise block the compositor, for example decoding images,
+ * rasterizing text or file I/O. The pool is available as wf::get_core().thread_pool.
+ *
+ * Jobs run on one of the worker threads, so they must not use GL, the scenegraph or any other compositor
+ * state. Their completion callbacks run on the main thread, from the Wayland event loop.
+ *
+ * Jobs may be tagged with an owner, an address in the code of the plugin which schedules them. When a
+ * plugin is unloaded, its queued jobs and pending callbacks are dropped, and the plugin manager waits until
+ * its running jobs are done, so that no code of the plugin runs after it is unloaded. Plugins should
+ * therefore tag all jobs whose callbacks are their own code, including jobs started through helpers like
+ * image_io::decode_file_async().
+ */
+class thread_pool_t
+{
+  public:
+    using job_callback_t = std::function<void ()>;
+
+    thread_pool_t();
+    ~thread_pool_t();
+
+    /**
+     * Run @work on a worker thread, then @done on the main thread.
+     *
+     * @param owner An address in the code of the plugin which the job belongs to, for example the type_info
+     *   of one of its classes with virtual methods. Jobs are grouped by the shared object which contains the
+     *   address, see cancel().
+     */
+    void schedule(job_callback_t work, job_callback_t done = {}, const void *owner = nullptr);
+
+    /**
+     * Run @work on a worker thread, then call @done on the main thread with its result.
+     */
+    template<class Work, class Done>
+    void schedule_with_result(Work work, Done done, const void *owner = nullptr)
+    {
+        auto result = std::make_shared<std::optional<decltype(work())>>();
+        schedule([result, work = std::move(work)] () { result->emplace(work()); },
+            [result, done = std::move(done)] () { done(std::move(**result)); }, owner);
+    }
+
+    /**
+     * Run @work on a worker thread. The result can be waited for with the returned future, which blocks the
+     * main thread however, so most callers should use schedule_with_result() instead.
+     */
+    template<class Work>
+    auto submit(Work work, const void *owner = nullptr)
+    {
+        auto task   = std::make_shared<std::packaged_task<decltype(work())()>>(std::move(work));
+        auto future = task->get_future();
+        schedule([task] () { (*task)(); }, {}, owner);
+        return future;
+    }
+
+    /**
+     * Drop the queued jobs and the pending callbacks of the shared object which contains @owner, and wait
+     * until its running jobs are done. Called by the plugin manager when a plugin is unloaded.
+     */
+    void cancel(const void *owner);
+
+    thread_pool_stats_t get_stats() const;
+
+    thread_pool_t(const thread_pool_t&) = delete;
+    thread_pool_t(thread_pool_t&&) = delete;
+    thread_pool_t& operator =(const thread_pool_t&) = delete;
+    thread_pool_t& operator =(thread_pool_t&&) = delete;
+
+  private:
+    struct impl;
+    std::unique_ptr<impl> priv;
+};
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+// WF_USE_CONFIG_H is set only when building Wayfire itself, external plugins
+// need to use <wayfire/config.h>
+#ifdef WF_USE_CONFIG_H
+    #include <config.h>
+#else
+    #include <wayfire/config.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace wf
+{
+/**
+ * Lightweight trace events for the hot paths of the compositor.
+ *
+ * Unlike the LOGC() categories, trace events are not formatted when they are recorded. Each scope marked
+ * with WF_TRACE_SCOPE() stores its name, start time and duration in a fixed-size ring buffer, and the buffer
+ * can be dumped on demand in the Chrome trace event JSON format, which can be opened in Perfetto or
+ * chrome://tracing.
+ *
+ * Recording is off by default, in which case a trace scope costs a single branch. It can be started with
+ * the WAYFIRE_TRACE_EVENTS environment variable (set to the capacity of the ring buffer) or via IPC. The
+ * buffer is dumped via IPC or when Wayfire receives SIGUSR2. The markers can be compiled out entirely with
+ * the trace_events build option.
+ */
+namespace trace
+{
+/** Whether trace events are recorded at the moment. Use start() and stop() to change. */
+extern bool recording;
+
+/**
+ * Start recording trace events, dropping any previously recorded events.
+ *
+ * @param capacity The number of events to keep, older events are overwritten.
+ */
+void start(size_t capacity);
+
+/** Stop recording trace events. The recorded events are kept until the next start(). */
+void stop();
+
+/**
+ * Write the recorded events to the given file in the Chrome trace event JSON format.
+ *
+ * @return The number of events written, or -1 if the file could not be written.
+ */
+int dump(const std::string& path);
+
+/**
+ * Get a name with static storage duration for a dynamic string, for use with trace scopes. The names are
+ * never freed, so this should be used only for a bounded set of names, like IPC method names.
+ */
+const char *intern(const std::string& name);
+
+/** Store a completed event. @name must have static storage duration. */
+void record(const char *name, int64_t start_usec, int64_t end_usec);
+
+/** Get the current time for trace events, in microseconds. */
+int64_t now();
+
+/**
+ * Records a trace event which spans the lifetime of the object.
+ */
+class scope_t
+{
+  public:
+    scope_t(const char *name)
+    {
+        if (recording)
+        {
+            this->name  = name;
+            this->start = now();
+        }
+    }
+
+    ~scope_t()
+    {
+        if (name)
+        {
+            record(name, start, now());
+        }
+    }
+
+    scope_t(const scope_t&) = delete;
+    scope_t& operator =(const scope_t&) = delete;
+
+  private:
+    const char *name = nullptr;
+    int64_t start    = 0;
+};
+}
+}
+
+#define WF_TRACE_CONCAT_IMPL(a, b) a ## b
+#define WF_TRACE_CONCAT(a, b) WF_TRACE_CONCAT_IMPL(a, b)
+
+#ifdef WF_ENABLE_TRACE_EVENTS
+/** Record a trace event for the rest of the enclosing scope. @name must have static storage duration. */
+    #define WF_TRACE_SCOPE(name) wf::trace::scope_t WF_TRACE_CONCAT(wf_trace_scope_, __LINE__){name}
+#else
+    #define WF_TRACE_SCOPE(name) ((void)0)
+#endif
@@ -3,11 +3,86 @@
 #include "wayfire/signal-provider.hpp"
 #include "wayfire/txn/transaction-object.hpp"
 #include <wayfire/txn/transaction.hpp>
+#include <map>
 
 namespace wf
 {
 namespace txn
 {
+struct client_ack_stats_t
+{
+    std::string app_id;
+    /** The number of times an object of the client became ready */
+    uint64_t acks = 0;
+    /** The number of times an object of the client was not ready when its transaction timed out */
+    uint64_t timeouts = 0;
+    /** The number of times the other objects of a transaction were applied without waiting for the client */
+    uint64_t splits = 0;
+    /** The smoothed time from commit until the object is ready, and its smoothed deviation */
+    int64_t avg_ack_usec       = 0;
+    int64_t ack_deviation_usec = 0;
+    int64_t max_ack_usec       = 0;
+    /** The time within which the client is expected to be ready, or -1 if not known yet */
+    int64_t expected_ack_usec = -1;
+};
+
+/**
+ * Statistics of the transactions which went through the transaction manager since startup.
+ */
+struct transaction_stats_t
+{
+    /** The number of transactions passed to schedule_transaction() */
+    uint64_t scheduled = 0;
+    /** The number of pending transactions which were merged into a newly scheduled transaction */
+    uint64_t merged    = 0;
+    uint64_t committed = 0;
+    uint64_t applied   = 0;
+    uint64_t timed_out = 0;
+    /** The number of transactions which had to wait for a committed transaction with the same objects */
+    uint64_t conflicts = 0;
+
+    /** The current and the highest number of pending and committed transactions */
+    size_t pending_now   = 0;
+    size_t committed_now = 0;
+    size_t max_pending   = 0;
+    size_t max_committed = 0;
+
+    /** The total and the highest time from scheduling a transaction until it was applied, in microseconds */
+    int64_t total_latency_usec = 0;
+    int64_t max_latency_usec   = 0;
+
+    /**
+     * A histogram of the time from scheduling until applying: latency_histogram[i] is the number of
+     * transactions which took between 2^i and 2^(i+1) microseconds.
+     */
+    std::vector<uint64_t> latency_histogram;
+
+    /** The number of objects which were not ready when their transaction timed out, by object type */
+    std::map<std::string, uint64_t> timeouts_by_type;
+};
+
+/**
+ * The state of a transaction which has been scheduled but not applied yet.
+ */
+struct transaction_info_t
+{
+    const transaction_t *tx;
+    bool committed;
+    /** Whether the transaction is waiting for a committed transaction with the same objects */
+    bool blocked;
+    /** The time since the transaction (or the oldest transaction merged into it) was scheduled */
+    int64_t age_usec;
+
+    struct object_t
+    {
+        std::string name;
+        std::string type;
+        bool ready;
+    };
+
+    std::vector<object_t> objects;
+};
+
 /*
  * The transaction manager keeps track of all committed and pending transactions and ensures that there is at
  * most one committed transaction for a given object.
@@ -40,6 +115,17 @@ class transaction_manager_t : public signal::provider_t
      */
     void schedule_object(transaction_object_sptr object);
 
+    /**
+     * Start a transaction group: until the matching end_group(), all transactions passed to
+     * schedule_transaction() are merged into a single transaction, so that a series of unrelated changes
+     * (for example a batch of IPC calls configuring many views) is applied atomically. Groups may be nested,
+     * only the outermost end_group() schedules the merged transaction.
+     */
+    void start_group();
+
+    /** End a transaction group started with start_group(). */
+    void end_group();
+
     /**
      * Check whether there is a pending transaction for the given object.
      */
@@ -50,10 +136,49 @@ class transaction_manager_t : public signal::provider_t
      */
     bool is_object_committed(transaction_object_sptr object) const;
 
+    /**
+     * Get the statistics of how quickly the clients have responded to transactions so far, by app-id.
+     */
+    std::vector<client_ack_stats_t> get_client_ack_stats() const;
+
+    /**
+     * Get the counters of the transaction pipeline.
+     */
+    transaction_stats_t get_stats() const;
+
+    /**
+     * Get the transactions which have not been applied yet, the committed ones first.
+     */
+    std::vector<transaction_info_t> get_inflight_transactions() const;
+
     struct impl;
     std::unique_ptr<impl> priv;
 };
 
+/**
+ * Merges all transactions scheduled during the lifetime of the object, see
+ * transaction_manager_t::start_group().
+ */
+class transaction_group_t
+{
+  public:
+    transaction_group_t(transaction_manager_t& manager) : manager(manager)
+    {
+        manager.start_group();
+    }
+
+    ~transaction_group_t()
+    {
+        manager.end_group();
+    }
+
+    transaction_group_t(const transaction_group_t&) = delete;
+    transaction_group_t& operator =(const transaction_group_t&) = delete;
+
+  private:
+    transaction_manager_t& manager;
+};
+
 /**
  * The new-transaction signal is emitted before a new transaction is added to the transaction manager (e.g.
  * at the beginning of schedule_transaction()). The transaction may be merged into another transaction before
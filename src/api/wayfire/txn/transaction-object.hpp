@@ -30,6 +30,15 @@ class transaction_object_t : public signal::provider_t
      */
     virtual std::string stringify() const;
 
+    /**
+     * Get the app-id of the client which the object belongs to, if any. Used to keep statistics about how
+     * quickly the clients respond to transactions.
+     */
+    virtual std::string get_app_id() const
+    {
+        return "";
+    }
+
     /**
      * Make the pending state committed.
      * This function is called when a transaction is committed.
@@ -44,21 +44,41 @@ class transaction_t : public signal::provider_t
      */
     const std::vector<transaction_object_sptr>& get_objects() const;
 
+    /**
+     * Get a list of the objects which have become ready since the transaction was committed.
+     */
+    const std::vector<transaction_object_sptr>& get_ready_objects() const;
+
     /**
      * Commit the transaction, that is, commit the pending state of all participating objects.
      * As soon as all objects are ready or the transaction times out, the state will be applied.
      */
     void commit();
 
+    /**
+     * Allow the transaction to apply the objects which are ready early, if the remaining objects belong to
+     * clients which have been much slower to respond in the past. The slow objects stay in the transaction
+     * until they are ready or the transaction times out. Note that this gives up the atomicity between the
+     * two groups of objects.
+     */
+    void set_adaptive_timeout(bool adaptive);
+
     virtual ~transaction_t() = default;
 
   private:
     std::vector<transaction_object_sptr> objects;
+    std::vector<transaction_object_sptr> ready_objects;
     int count_ready_objects = 0;
     uint64_t timeout;
     timer_setter_t timer_setter;
+    int64_t commit_time = 0;
+
+    bool adaptive_timeout = false;
+    wf::wl_timer<false> split_timer;
 
     void apply(bool did_timeout);
+    void plan_split();
+    void split_stragglers();
     wf::signal::connection_t<object_ready_signal> on_object_ready;
 };
 
@@ -74,5 +94,24 @@ struct transaction_applied_signal
     // Set to true if the transaction timed out and the desired object state may not have been achieved.
     bool timed_out;
 };
+
+/**
+ * A signal emitted on a transaction when the objects which were ready have been applied early, because the
+ * remaining objects were too slow. The transaction now contains only the remaining objects.
+ */
+struct transaction_split_signal
+{
+    transaction_t *self;
+};
+
+/**
+ * A signal emitted on a pending transaction when it is merged into a newly scheduled transaction with some of
+ * the same objects. The transaction is destroyed afterwards and @into is applied in its place.
+ */
+struct transaction_merged_signal
+{
+    transaction_t *self;
+    transaction_t *into;
+};
 }
 }
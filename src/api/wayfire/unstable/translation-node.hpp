@@ -44,12 +44,13 @@ class translation_node_instance_t : public render_instance_t
 {
   protected:
     std::vector<render_instance_uptr> children;
+    children_instances_origin_t children_origin;
     damage_callback push_damage;
     std::shared_ptr<translation_node_t> self;
     wf::signal::connection_t<wf::scene::node_damage_signal> on_node_damage;
     wf::signal::connection_t<wf::scene::node_regen_instances_signal> on_regen_instances;
     wf::output_t *shown_on;
-    void regen_instances();
+    void regen_instances(node_t *changed_child = nullptr);
 
   public:
     translation_node_instance_t(translation_node_t *self,
@@ -59,9 +60,13 @@ class translation_node_instance_t : public render_instance_t
     void schedule_instructions(std::vector<wf::scene::render_instruction_t>& instructions,
         const wf::render_target_t& target, wf::region_t& damage) override;
     void render(const wf::render_target_t& target, const wf::region_t& region) override;
+    bool supports_direct_render() override;
     void presentation_feedback(wf::output_t *output) override;
     wf::scene::direct_scanout try_scanout(wf::output_t *output) override;
+    wf::scene::direct_scanout try_output_layers(wf::output_t *output,
+        wf::scene::output_layers_plan_t& plan) override;
     void compute_visibility(wf::output_t *output, wf::region_t& visible) override;
+    wf::scene::node_t *get_node() const override;
 };
 }
 }
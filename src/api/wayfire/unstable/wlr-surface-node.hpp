@@ -1,6 +1,7 @@
 #pragma once
 
 #include "wayfire/geometry.hpp"
+#include "wayfire/render-manager.hpp"
 #include "wayfire/signal-definitions.hpp"
 #include "wayfire/util.hpp"
 #include "wayfire/view-transform.hpp"
@@ -53,6 +54,7 @@ class wlr_surface_node_t : public node_t, public zero_copy_texturable_node_t
      *   or it should wait until it is manually applied.
      */
     wlr_surface_node_t(wlr_surface *surface, bool autocommit);
+    ~wlr_surface_node_t();
 
     std::optional<input_node_t> find_node_at(const wf::pointf_t& at) override;
 
@@ -66,6 +68,12 @@ class wlr_surface_node_t : public node_t, public zero_copy_texturable_node_t
     std::optional<wf::texture_t> to_texture() const override;
 
     wlr_surface *get_surface() const;
+    /**
+     * Show the given state of the surface.
+     *
+     * If only the contents of the buffer change and the client's rendering to the new buffer has not
+     * finished yet, the old buffer is shown until it has.
+     */
     void apply_state(surface_state_t&& state);
     void send_frame_done(bool delay_until_vblank);
 
@@ -77,8 +85,15 @@ class wlr_surface_node_t : public node_t, public zero_copy_texturable_node_t
     std::map<wf::output_t*, int> visibility;
     std::map<wf::output_t*, int> pending_visibility_delta;
     wf::signal::connection_t<wf::output_removed_signal> on_output_remove;
+    /** The surface leaves outputs which stop showing their contents, and enters them again afterwards. */
+    wf::signal::connection_t<wf::output_content_shown_signal> on_output_content_shown;
 
     class wlr_surface_render_instance_t;
+    /**
+     * The number of render instances on which the surface may be visible. When there are none, commits
+     * neither damage the node nor schedule repaints.
+     */
+    int visible_instances = 0;
     void handle_enter(wf::output_t *output);
     void handle_leave(wf::output_t *output);
     void update_pending_outputs();
@@ -87,9 +102,29 @@ class wlr_surface_node_t : public node_t, public zero_copy_texturable_node_t
     wf::wl_listener_wrapper on_surface_destroyed;
     wf::wl_listener_wrapper on_surface_commit;
 
+    /**
+     * The time when frame callbacks were last released, or -1 if the client has committed a new buffer since.
+     * Used to estimate how long the client needs to produce a new frame.
+     */
+    int64_t frame_done_sent_at = -1;
+    /** The estimated time in microseconds the client needs to commit a new buffer after a frame callback. */
+    int64_t commit_latency = 0;
+
     const bool autocommit;
     surface_state_t current_state;
     void apply_current_surface_state();
+
+    /** A state whose buffer the client is still rendering to, and a fence signalled when it is done. */
+    surface_state_t waiting_state;
+    int buffer_fence = -1;
+    wl_event_source *buffer_ready_source = nullptr;
+    void cancel_buffer_wait();
+
+    /**
+     * The opaque region of the surface when the last state was applied. Visibility of the nodes below depends
+     * on it, so a change triggers a geometry update.
+     */
+    wf::region_t last_opaque_region;
 };
 }
 }
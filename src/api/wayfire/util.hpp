@@ -10,9 +10,15 @@ namespace wf
 /** Convert timespect to milliseconds. */
 int64_t timespec_to_msec(const timespec& ts);
 
+/** Convert timespect to microseconds. */
+int64_t timespec_to_usec(const timespec& ts);
+
 /** Returns current time in msec, using CLOCK_MONOTONIC as a base */
 int64_t get_current_time();
 
+/** Returns current time in usec, using CLOCK_MONOTONIC as a base */
+int64_t get_current_time_usec();
+
 /**
  * A wrapper around wl_listener compatible with C++11 std::functions
  */
@@ -52,6 +58,112 @@ struct wl_listener_wrapper
     wrapper _wrap;
 };
 
+namespace detail
+{
+template<class Handler>
+struct wl_member_handler;
+
+template<class Owner>
+struct wl_member_handler<void (Owner::*)()>
+{
+    using owner_t = Owner;
+    template<void (Owner::*Handler)()>
+    static void call(Owner *owner, void*)
+    {
+        (owner->*Handler)();
+    }
+};
+
+template<class Owner, class Data>
+struct wl_member_handler<void (Owner::*)(Data*)>
+{
+    using owner_t = Owner;
+    template<void (Owner::*Handler)(Data*)>
+    static void call(Owner *owner, void *data)
+    {
+        (owner->*Handler)(static_cast<Data*>(data));
+    }
+};
+}
+
+/**
+ * A wl_listener which calls the member function @Handler of its owner. Unlike wl_listener_wrapper, it does
+ * not store a std::function, so creating it does not allocate and the call is resolved at compile time.
+ * It is meant for objects which are created often and have many listeners, like popups and subsurfaces.
+ *
+ * The handler takes either no arguments or a pointer to the signal data, for example:
+ *
+ *   void handle_new_popup(wlr_xdg_popup *popup);
+ *   wf::wl_member_listener_t<&my_view_t::handle_new_popup> on_new_popup{this};
+ *
+ * Because the handler is a template argument, the listener has to be declared after the handler in the class.
+ */
+template<auto Handler>
+class wl_member_listener_t
+{
+    using handler_t = detail::wl_member_handler<decltype(Handler)>;
+    using owner_t   = typename handler_t::owner_t;
+
+  public:
+    explicit wl_member_listener_t(owner_t *owner) : owner(owner)
+    {
+        listener.notify = &notify;
+        wl_list_init(&listener.link);
+    }
+
+    ~wl_member_listener_t()
+    {
+        disconnect();
+    }
+
+    wl_member_listener_t(const wl_member_listener_t &) = delete;
+    wl_member_listener_t(wl_member_listener_t &&) = delete;
+    wl_member_listener_t& operator =(const wl_member_listener_t&) = delete;
+    wl_member_listener_t& operator =(wl_member_listener_t&&) = delete;
+
+    /** Connect to a signal. No-op if already connected.
+     * @return true if connection was successful */
+    bool connect(wl_signal *signal)
+    {
+        if (is_connected())
+        {
+            return false;
+        }
+
+        wl_signal_add(signal, &listener);
+        return true;
+    }
+
+    /** Disconnect from the wl_signal. No-op if not connected */
+    void disconnect()
+    {
+        wl_list_remove(&listener.link);
+        wl_list_init(&listener.link);
+    }
+
+    /** @return true if connected to a wl_signal */
+    bool is_connected() const
+    {
+        return !wl_list_empty(&listener.link);
+    }
+
+    /** Call the handler directly, as if the signal was fired */
+    void emit(void *data)
+    {
+        handler_t::template call<Handler>(owner, data);
+    }
+
+  private:
+    wl_listener listener;
+    owner_t *owner;
+
+    static void notify(wl_listener *listener, void *data)
+    {
+        wl_member_listener_t *self = wl_container_of(listener, self, listener);
+        self->emit(data);
+    }
+};
+
 /**
  * A wrapper for adding idle callbacks to the event loop
  */
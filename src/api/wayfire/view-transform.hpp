@@ -2,10 +2,13 @@
 #define VIEW_TRANSFORM_HPP
 
 #include "wayfire/debug.hpp"
+#include "wayfire/gpu-memory.hpp"
 #include "wayfire/geometry.hpp"
 #include "wayfire/region.hpp"
 #include "wayfire/scene-render.hpp"
 #include "wayfire/scene.hpp"
+#include "wayfire/util.hpp"
+#include <cmath>
 #include <memory>
 #include <wayfire/opengl.hpp>
 
@@ -56,6 +59,15 @@ class transformer_base_node_t : public scene::floating_inner_node_t
         return optimize_nested_render_instances(shared_from_this(), flags);
     }
 
+    /**
+     * Whether the transformer currently shows its children exactly as they are, for example a 2D transformer
+     * after its animation has ended. Direct scanout is possible through such transformers.
+     */
+    virtual bool is_identity() const
+    {
+        return false;
+    }
+
     // A temporary buffer to render children to.
     wf::render_target_t inner_content;
 
@@ -64,15 +76,34 @@ class transformer_base_node_t : public scene::floating_inner_node_t
     // children's current content.
     wf::region_t cached_damage;
 
+    // Storage for the render instructions of the children, reused between frames.
+    std::vector<render_instruction_t> instruction_buffer;
+
+    // Level of detail for views which are shown much smaller than their actual size, for example by scale
+    // or the switcher. When the transformer shows its children at less than @lod_threshold of their size,
+    // they are rendered to @inner_content at roughly the displayed size and drawn from there, and the
+    // buffer is updated at most once every @lod_update_interval milliseconds.
+    //
+    // Both are disabled when set to 0.
+    float lod_threshold     = 0.0f;
+    int lod_update_interval = 0;
+    // The time @inner_content was last updated in LOD mode, in milliseconds.
+    int64_t lod_last_update = 0;
+
     wf::texture_t get_updated_contents(const wf::geometry_t& bbox, float scale,
         std::vector<scene::render_instance_uptr>& children)
     {
         int target_width  = scale * bbox.width;
         int target_height = scale * bbox.height;
 
+        // The contents are kept between frames, a buffer which was just allocated or which now shows another
+        // part of the children has to be repainted completely.
+        const bool moved = !(inner_content.geometry == bbox) || (inner_content.scale != scale);
+
         OpenGL::render_begin();
         inner_content.scale = scale;
-        if (inner_content.allocate(target_width, target_height))
+        wf::gpu_memory::node_scope_t memory_scope{this};
+        if (inner_content.allocate_from_pool(target_width, target_height) || moved)
         {
             cached_damage |= bbox;
         }
@@ -80,14 +111,19 @@ class transformer_base_node_t : public scene::floating_inner_node_t
         inner_content.geometry = bbox;
         OpenGL::render_end();
 
-        render_pass_params_t params;
-        params.instances = &children;
-        params.target    = inner_content;
-        params.damage    = cached_damage;
-        params.background_color = {0.0f, 0.0f, 0.0f, 0.0f};
-        scene::run_render_pass(params, RPASS_CLEAR_BACKGROUND);
+        // Only the damaged part is repainted, and nothing at all if the children did not change.
+        if (!cached_damage.empty())
+        {
+            render_pass_params_t params;
+            params.instances = &children;
+            params.target    = inner_content;
+            params.damage    = std::move(cached_damage);
+            params.background_color = {0.0f, 0.0f, 0.0f, 0.0f};
+            params.instruction_buffer = &instruction_buffer;
+            scene::run_render_pass(params, RPASS_CLEAR_BACKGROUND);
+            cached_damage.clear();
+        }
 
-        cached_damage.clear();
         return wf::texture_t{inner_content.tex};
     }
 
@@ -99,7 +135,7 @@ class transformer_base_node_t : public scene::floating_inner_node_t
             // the zero-copy path and we do not need an auxiliary
             // buffer to render to.
             OpenGL::render_begin();
-            inner_content.release();
+            inner_content.release_to_pool();
             OpenGL::render_end();
         }
     }
@@ -176,6 +212,45 @@ class transformer_render_instance_t : public render_instance_t
         return self->get_updated_contents(self->get_children_bounding_box(), scale, children);
     }
 
+    /**
+     * Same as get_texture(float), but if the children are displayed at less than the transformer's LOD
+     * threshold, the texture is a cached thumbnail of them at about the displayed size.
+     *
+     * @param displayed_scale How big the children are shown on the target, relative to their size.
+     */
+    wf::texture_t get_texture(float scale, float displayed_scale)
+    {
+        if ((self->lod_threshold <= 0.0f) || (displayed_scale >= self->lod_threshold))
+        {
+            return get_texture(scale);
+        }
+
+        // Round up to a power of two, so that the buffer is not reallocated on every frame of an animation.
+        const float lod_scale = scale * std::exp2(std::ceil(std::log2(std::max(displayed_scale, 1.0f / 64))));
+        const auto bbox = self->get_children_bounding_box();
+        const bool thumbnail_valid = (self->inner_content.fb != (uint32_t)-1) &&
+            (self->inner_content.scale == lod_scale) && (self->inner_content.geometry == bbox);
+
+        const int64_t now = wf::get_current_time();
+        const int64_t since_update = now - self->lod_last_update;
+        if (thumbnail_valid && (self->cached_damage.empty() || (since_update < self->lod_update_interval)))
+        {
+            if (!self->cached_damage.empty() && !lod_update_timer.is_connected())
+            {
+                // The damage stays in cached_damage, repaint once the interval is over.
+                lod_update_timer.set_timeout(self->lod_update_interval - since_update, [=] ()
+                {
+                    _push_damage(self->get_bounding_box());
+                });
+            }
+
+            return wf::texture_t{self->inner_content.tex};
+        }
+
+        self->lod_last_update = now;
+        return self->get_updated_contents(bbox, lod_scale, children);
+    }
+
     void presentation_feedback(wf::output_t *output) override
     {
         for (auto& ch : children)
@@ -190,9 +265,13 @@ class transformer_render_instance_t : public render_instance_t
     wf::output_t *_shown_on;
     damage_callback _push_damage;
 
-    wf::signal::connection_t<node_regen_instances_signal> on_regen_instances = [=] (auto)
+    children_instances_origin_t children_origin;
+    wf::wl_timer<false> lod_update_timer;
+    wf::signal::connection_t<node_regen_instances_signal> on_regen_instances =
+        [=] (node_regen_instances_signal *ev)
     {
-        regen_instances();
+        ev->handled = true;
+        regen_instances(ev->changed_child);
     };
 
   public:
@@ -212,7 +291,7 @@ class transformer_render_instance_t : public render_instance_t
         self->connect(&on_regen_instances);
     }
 
-    void regen_instances()
+    void regen_instances(node_t *changed_child = nullptr)
     {
         auto push_damage_child = [=] (wf::region_t region)
         {
@@ -221,10 +300,8 @@ class transformer_render_instance_t : public render_instance_t
             _push_damage(region);
         };
 
-        for (auto& ch : self->get_children())
-        {
-            ch->gen_render_instances(children, push_damage_child, _shown_on);
-        }
+        regen_children_instances(self.get(), changed_child, children, children_origin,
+            push_damage_child, _shown_on);
     }
 
     ~transformer_render_instance_t()
@@ -236,7 +313,7 @@ class transformer_render_instance_t : public render_instance_t
     {
         if (!damage.empty())
         {
-            auto our_damage = damage & self->get_bounding_box();
+            auto our_damage = clip_instruction_damage(damage, self->get_bounding_box());
             instructions.push_back(wf::scene::render_instruction_t{
                         .instance = this,
                         .target   = target,
@@ -253,6 +330,11 @@ class transformer_render_instance_t : public render_instance_t
 
     direct_scanout try_scanout(wf::output_t *output) override
     {
+        if (self->is_identity())
+        {
+            return try_scanout_from_list(children, output);
+        }
+
         // By default, disable direct scanout
         return direct_scanout::OCCLUSION;
     }
@@ -262,6 +344,11 @@ class transformer_render_instance_t : public render_instance_t
         return !children.empty();
     }
 
+    node_t *get_node() const override
+    {
+        return self.get();
+    }
+
     void compute_visibility(wf::output_t *output, wf::region_t& visible) override
     {
         if (!(visible & self->get_bounding_box()).empty())
@@ -392,6 +479,7 @@ class view_2d_transformer_t : public transformer_base_node_t
     wf::geometry_t get_bounding_box() override;
     void gen_render_instances(std::vector<render_instance_uptr>& instances,
         damage_callback push_damage, wf::output_t *shown_on) override;
+    bool is_identity() const override;
 
     wayfire_view view;
 };
@@ -410,6 +498,19 @@ class view_3d_transformer_t : public transformer_base_node_t
 
     glm::mat4 calculate_total_transform();
 
+  private:
+    // The last total transform and the inputs it was computed from. Pointer input maps every motion event
+    // through the transformer, while the matrices usually change only during animations.
+    struct
+    {
+        bool valid = false;
+        wf::geometry_t bbox;
+        glm::mat4 view_proj, translation, rotation, scaling;
+        glm::mat4 total{1.0};
+    } cached;
+
+    glm::mat4 calculate_total_transform(wf::geometry_t bbox);
+
   public:
     view_3d_transformer_t(wayfire_view view);
     wf::pointf_t to_local(const wf::pointf_t& point) override;
@@ -418,6 +519,7 @@ class view_3d_transformer_t : public transformer_base_node_t
     wf::geometry_t get_bounding_box() override;
     void gen_render_instances(std::vector<render_instance_uptr>& instances,
         damage_callback push_damage, wf::output_t *shown_on) override;
+    bool is_identity() const override;
 
     static const float fov; // PI / 8
     static glm::mat4 default_view_matrix();
@@ -191,7 +191,7 @@ class view_interface_t : public wf::signal::provider_t, public wf::object_base_t
     {
         static_assert(std::is_base_of_v<view_interface_t, ConcreteView>,
             "view_interface_t::create<T> can be used only when T is a view type!");
-        auto view = tracking_allocator_t<view_interface_t>::get().allocate<ConcreteView>(args...);
+        auto view = tracking_allocator_t<view_interface_t>::get().allocate_pooled<ConcreteView>(args...);
         view->base_initialization();
         return view;
     }
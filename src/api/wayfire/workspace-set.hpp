@@ -9,6 +9,7 @@
 #include <memory>
 #include <vector>
 #include <wayfire/nonstd/observer_ptr.h>
+#include <wayfire/nonstd/tracking-allocator.hpp>
 #include <wayfire/toplevel-view.hpp>
 
 namespace wf
@@ -148,6 +149,16 @@ class workspace_set_t : public wf::signal::provider_t, public wf::object_base_t,
     std::vector<wayfire_toplevel_view> get_views(uint32_t flags = 0,
         std::optional<wf::point_t> workspace = {});
 
+    /**
+     * Call @callback for each view which get_views() would return with the same arguments, in the same
+     * order, without copying the list of views.
+     *
+     * If the callback adds or removes views, or restacks them, the iteration continues at the same position
+     * in the updated list, so some views may be skipped or visited twice.
+     */
+    void for_each_view(uint32_t flags, std::function<void(wayfire_toplevel_view)> callback,
+        std::optional<wf::point_t> workspace = {});
+
     /**
      * Get the main workspace for a view.
      * The main workspace is the one which contains the view's center.
@@ -230,6 +241,17 @@ class workspace_set_t : public wf::signal::provider_t, public wf::object_base_t,
     void set_visible(bool visible);
 };
 
+/** Workspace sets are looked up by their index, not by their object id. */
+template<>
+struct tracking_id_t<workspace_set_t>
+{
+    static constexpr bool indexed = true;
+    static uint64_t get(const workspace_set_t& wset)
+    {
+        return wset.get_index();
+    }
+};
+
 // A helper function to emit view-pre-moved-to-wset
 void emit_view_pre_moved_to_wset_pre(wayfire_toplevel_view view,
     std::shared_ptr<workspace_set_t> old_wset, std::shared_ptr<workspace_set_t> new_wset);
@@ -0,0 +1,624 @@
+#include "config-cache.hpp"
+
+#include <wayfire/config/xml.hpp>
+#include <wayfire/config/types.hpp>
+#include <wayfire/config/option-types.hpp>
+#include <wayfire/util/log.hpp>
+#include <libxml/parser.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <type_traits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+/* Changing the layout of the cache requires a new magic value. */
+const char CACHE_MAGIC[8] = {'W', 'F', 'M', 'E', 'T', 'A', '0', '1'};
+
+enum cached_type_t : uint8_t
+{
+    CACHED_INT       = 1,
+    CACHED_DOUBLE    = 2,
+    CACHED_BOOL      = 3,
+    CACHED_STRING    = 4,
+    CACHED_COLOR     = 5,
+    CACHED_KEY       = 6,
+    CACHED_BUTTON    = 7,
+    CACHED_GESTURE   = 8,
+    CACHED_ACTIVATOR = 9,
+    CACHED_HOTSPOT   = 10,
+    CACHED_MODE      = 11,
+    CACHED_POSITION  = 12,
+    CACHED_ANIMATION = 13,
+};
+
+struct cached_option_t
+{
+    uint8_t type;
+    std::string name;
+    std::string default_value;
+    /* Empty if the option has no bounds */
+    std::string minimum;
+    std::string maximum;
+};
+
+struct cached_section_t
+{
+    std::string name;
+    std::vector<cached_option_t> options;
+};
+
+struct cached_file_t
+{
+    std::string path;
+    int64_t mtime_ns = 0;
+    int64_t size     = 0;
+    uint64_t hash    = 0;
+    std::vector<cached_section_t> sections;
+};
+
+uint64_t hash_contents(const std::string& contents)
+{
+    // FNV-1a
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (unsigned char c : contents)
+    {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+std::optional<std::string> read_file(const std::string& path)
+{
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream)
+    {
+        return {};
+    }
+
+    std::stringstream buffer;
+    buffer << stream.rdbuf();
+    return buffer.str();
+}
+
+template<class Type, class Option>
+std::string bound_to_string(const std::optional<Option>& bound)
+{
+    return bound ? wf::option_type::to_string<Type>(*bound) : "";
+}
+
+template<class Type>
+std::optional<cached_option_t> describe_typed(const std::shared_ptr<wf::config::option_base_t>& option,
+    cached_type_t type)
+{
+    auto typed = std::dynamic_pointer_cast<wf::config::option_t<Type>>(option);
+    if (!typed)
+    {
+        return {};
+    }
+
+    cached_option_t desc;
+    desc.type = type;
+    desc.name = option->get_name();
+    desc.default_value = option->get_default_value_str();
+    if constexpr (std::is_same_v<Type, int> || std::is_same_v<Type, double>)
+    {
+        desc.minimum = bound_to_string<Type>(typed->get_minimum());
+        desc.maximum = bound_to_string<Type>(typed->get_maximum());
+    }
+
+    return desc;
+}
+
+/** Describe the option for the cache, or nullopt if its type cannot be cached. */
+std::optional<cached_option_t> describe_option(const std::shared_ptr<wf::config::option_base_t>& option)
+{
+    using describe_t = std::optional<cached_option_t> (*)(
+        const std::shared_ptr<wf::config::option_base_t>&, cached_type_t);
+    static const std::pair<describe_t, cached_type_t> describers[] = {
+        {&describe_typed<int>, CACHED_INT},
+        {&describe_typed<double>, CACHED_DOUBLE},
+        {&describe_typed<bool>, CACHED_BOOL},
+        {&describe_typed<std::string>, CACHED_STRING},
+        {&describe_typed<wf::color_t>, CACHED_COLOR},
+        {&describe_typed<wf::keybinding_t>, CACHED_KEY},
+        {&describe_typed<wf::buttonbinding_t>, CACHED_BUTTON},
+        {&describe_typed<wf::touchgesture_t>, CACHED_GESTURE},
+        {&describe_typed<wf::activatorbinding_t>, CACHED_ACTIVATOR},
+        {&describe_typed<wf::hotspot_binding_t>, CACHED_HOTSPOT},
+        {&describe_typed<wf::output_config::mode_t>, CACHED_MODE},
+        {&describe_typed<wf::output_config::position_t>, CACHED_POSITION},
+        {&describe_typed<wf::animation_description_t>, CACHED_ANIMATION},
+    };
+
+    for (auto& [describe, type] : describers)
+    {
+        if (auto desc = describe(option, type))
+        {
+            return desc;
+        }
+    }
+
+    return {};
+}
+
+template<class Type>
+std::shared_ptr<wf::config::option_base_t> create_typed(const cached_option_t& desc)
+{
+    auto value = wf::option_type::from_string<Type>(desc.default_value);
+    if (!value)
+    {
+        return nullptr;
+    }
+
+    auto option = std::make_shared<wf::config::option_t<Type>>(desc.name, *value);
+    if constexpr (std::is_same_v<Type, int> || std::is_same_v<Type, double>)
+    {
+        auto parse_bound = [] (const std::string& str)
+        {
+            return str.empty() ? std::optional<Type>{} : wf::option_type::from_string<Type>(str);
+        };
+
+        option->set_bounds(parse_bound(desc.minimum), parse_bound(desc.maximum));
+    }
+
+    return option;
+}
+
+std::shared_ptr<wf::config::option_base_t> create_option(const cached_option_t& desc)
+{
+    switch (desc.type)
+    {
+      case CACHED_INT:
+        return create_typed<int>(desc);
+
+      case CACHED_DOUBLE:
+        return create_typed<double>(desc);
+
+      case CACHED_BOOL:
+        return create_typed<bool>(desc);
+
+      case CACHED_STRING:
+        return create_typed<std::string>(desc);
+
+      case CACHED_COLOR:
+        return create_typed<wf::color_t>(desc);
+
+      case CACHED_KEY:
+        return create_typed<wf::keybinding_t>(desc);
+
+      case CACHED_BUTTON:
+        return create_typed<wf::buttonbinding_t>(desc);
+
+      case CACHED_GESTURE:
+        return create_typed<wf::touchgesture_t>(desc);
+
+      case CACHED_ACTIVATOR:
+        return create_typed<wf::activatorbinding_t>(desc);
+
+      case CACHED_HOTSPOT:
+        return create_typed<wf::hotspot_binding_t>(desc);
+
+      case CACHED_MODE:
+        return create_typed<wf::output_config::mode_t>(desc);
+
+      case CACHED_POSITION:
+        return create_typed<wf::output_config::position_t>(desc);
+
+      case CACHED_ANIMATION:
+        return create_typed<wf::animation_description_t>(desc);
+
+      default:
+        return nullptr;
+    }
+}
+
+/** Create the sections of a cached file, or return false if the cache entry is invalid. */
+bool create_sections(const cached_file_t& file, std::vector<std::shared_ptr<wf::config::section_t>>& out)
+{
+    for (auto& desc : file.sections)
+    {
+        auto section = std::make_shared<wf::config::section_t>(desc.name);
+        for (auto& opt : desc.options)
+        {
+            auto option = create_option(opt);
+            if (!option)
+            {
+                return false;
+            }
+
+            section->register_new_option(option);
+        }
+
+        out.push_back(section);
+    }
+
+    return true;
+}
+
+/**
+ * Parse the XML file and describe its sections in @file. Returns false if the file cannot be parsed, and sets
+ * @cacheable to false if some of its options cannot be cached.
+ */
+bool parse_xml_file(cached_file_t& file, std::vector<std::shared_ptr<wf::config::section_t>>& out,
+    bool& cacheable)
+{
+    auto doc = xmlParseFile(file.path.c_str());
+    if (!doc)
+    {
+        LOGE("Failed to parse XML metadata file ", file.path);
+        return false;
+    }
+
+    auto root = xmlDocGetRootElement(doc);
+    if (!root)
+    {
+        LOGE("Empty XML metadata file ", file.path);
+        xmlFreeDoc(doc);
+        return false;
+    }
+
+    cacheable = true;
+    for (auto node = root->children; node; node = node->next)
+    {
+        const bool is_section = !xmlStrcmp(node->name, (const xmlChar*)"plugin") ||
+            !xmlStrcmp(node->name, (const xmlChar*)"object");
+        if ((node->type != XML_ELEMENT_NODE) || !is_section)
+        {
+            continue;
+        }
+
+        auto section = wf::config::xml::create_section_from_xml_node(node);
+        if (!section)
+        {
+            continue;
+        }
+
+        cached_section_t desc;
+        desc.name = section->get_name();
+        for (auto& option : section->get_registered_options())
+        {
+            auto opt = describe_option(option);
+            cacheable &= opt.has_value();
+            if (opt)
+            {
+                desc.options.push_back(std::move(*opt));
+            }
+        }
+
+        file.sections.push_back(std::move(desc));
+        out.push_back(section);
+    }
+
+    // The options created from XML refer to the nodes, so the document is never freed.
+    return true;
+}
+
+class cache_reader_t
+{
+  public:
+    cache_reader_t(const uint8_t *data, size_t size) : data(data), size(size)
+    {}
+
+    template<class T>
+    bool read(T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (size - offset < sizeof(T))
+        {
+            return false;
+        }
+
+        std::memcpy(&value, data + offset, sizeof(T));
+        offset += sizeof(T);
+        return true;
+    }
+
+    bool read(std::string& value)
+    {
+        uint32_t length;
+        if (!read(length) || (size - offset < length))
+        {
+            return false;
+        }
+
+        value.assign((const char*)data + offset, length);
+        offset += length;
+        return true;
+    }
+
+    template<class T>
+    bool read_array(std::vector<T>& values, bool (cache_reader_t::*read_one)(T&))
+    {
+        uint32_t count;
+        if (!read(count) || (count > size - offset))
+        {
+            return false;
+        }
+
+        values.resize(count);
+        for (auto& value : values)
+        {
+            if (!(this->*read_one)(value))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool read_option(cached_option_t& opt)
+    {
+        return read(opt.type) && read(opt.name) && read(opt.default_value) &&
+               read(opt.minimum) && read(opt.maximum);
+    }
+
+    bool read_section(cached_section_t& section)
+    {
+        return read(section.name) && read_array(section.options, &cache_reader_t::read_option);
+    }
+
+    bool read_file(cached_file_t& file)
+    {
+        return read(file.path) && read(file.mtime_ns) && read(file.size) && read(file.hash) &&
+               read_array(file.sections, &cache_reader_t::read_section);
+    }
+
+  private:
+    const uint8_t *data;
+    size_t size;
+    size_t offset = 0;
+};
+
+class cache_writer_t
+{
+  public:
+    std::string buffer;
+
+    template<class T>
+    void write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>);
+        buffer.append((const char*)&value, sizeof(T));
+    }
+
+    void write(const std::string& value)
+    {
+        write((uint32_t)value.size());
+        buffer.append(value);
+    }
+
+    void write_file(const cached_file_t& file)
+    {
+        write(file.path);
+        write(file.mtime_ns);
+        write(file.size);
+        write(file.hash);
+        write((uint32_t)file.sections.size());
+        for (auto& section : file.sections)
+        {
+            write(section.name);
+            write((uint32_t)section.options.size());
+            for (auto& opt : section.options)
+            {
+                write(opt.type);
+                write(opt.name);
+                write(opt.default_value);
+                write(opt.minimum);
+                write(opt.maximum);
+            }
+        }
+    }
+};
+
+std::map<std::string, cached_file_t> read_cache(const std::string& cache_file)
+{
+    std::map<std::string, cached_file_t> files;
+    int fd = open(cache_file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return files;
+    }
+
+    struct stat st;
+    if ((fstat(fd, &st) < 0) || (st.st_size < (off_t)sizeof(CACHE_MAGIC)))
+    {
+        close(fd);
+        return files;
+    }
+
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        return files;
+    }
+
+    cache_reader_t reader{(const uint8_t*)data, (size_t)st.st_size};
+    char magic[sizeof(CACHE_MAGIC)];
+    std::vector<cached_file_t> entries;
+    if (reader.read(magic) && !std::memcmp(magic, CACHE_MAGIC, sizeof(magic)) &&
+        reader.read_array(entries, &cache_reader_t::read_file))
+    {
+        for (auto& entry : entries)
+        {
+            auto path = entry.path;
+            files[path] = std::move(entry);
+        }
+    } else
+    {
+        LOGW("Ignoring invalid XML metadata cache ", cache_file);
+    }
+
+    munmap(data, st.st_size);
+    return files;
+}
+
+void write_cache(const std::string& cache_file, const std::vector<cached_file_t>& files)
+{
+    cache_writer_t writer;
+    writer.buffer.append(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    writer.write((uint32_t)files.size());
+    for (auto& file : files)
+    {
+        writer.write_file(file);
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(cache_file).parent_path(), ec);
+
+    // Write a new file and rename it, so that a concurrent start never reads a partial cache.
+    const std::string tmp = cache_file + ".tmp";
+    {
+        std::ofstream stream(tmp, std::ios::binary | std::ios::trunc);
+        stream.write(writer.buffer.data(), writer.buffer.size());
+        if (!stream)
+        {
+            LOGW("Failed to write the XML metadata cache ", tmp);
+            return;
+        }
+    }
+
+    if (rename(tmp.c_str(), cache_file.c_str()) < 0)
+    {
+        LOGW("Failed to write the XML metadata cache ", cache_file, ": ", strerror(errno));
+        unlink(tmp.c_str());
+    }
+}
+
+std::vector<std::string> list_xml_files(const std::string& dir)
+{
+    std::vector<std::string> files;
+    std::error_code ec;
+    for (auto it = std::filesystem::directory_iterator(dir, ec);
+         !ec && (it != std::filesystem::directory_iterator()); it.increment(ec))
+    {
+        if (it->path().extension() == ".xml")
+        {
+            files.push_back(it->path().string());
+        }
+    }
+
+    std::sort(files.begin(), files.end());
+    return files;
+}
+}
+
+void wf::load_xml_metadata_cached(config::config_manager_t& manager,
+    const std::vector<std::string>& xmldirs, const std::string& cache_file)
+{
+    auto cached = read_cache(cache_file);
+    std::vector<cached_file_t> files;
+    size_t from_cache = 0, parsed = 0;
+    bool cache_changed = false;
+
+    for (auto& dir : xmldirs)
+    {
+        for (auto& path : list_xml_files(dir))
+        {
+            struct stat st;
+            if (stat(path.c_str(), &st) < 0)
+            {
+                continue;
+            }
+
+            cached_file_t file;
+            file.path     = path;
+            file.mtime_ns = (int64_t)st.st_mtim.tv_sec * 1'000'000'000 + st.st_mtim.tv_nsec;
+            file.size     = st.st_size;
+
+            std::vector<std::shared_ptr<config::section_t>> sections;
+            auto it = cached.find(path);
+            bool reuse = false;
+            if ((it != cached.end()) && (it->second.mtime_ns == file.mtime_ns) &&
+                (it->second.size == file.size))
+            {
+                reuse = true;
+            } else if ((it != cached.end()) && (it->second.size == file.size))
+            {
+                // Touched, but possibly not changed.
+                auto contents = read_file(path);
+                reuse = contents && (hash_contents(*contents) == it->second.hash);
+                cache_changed |= reuse;
+            }
+
+            if (reuse)
+            {
+                file.hash     = it->second.hash;
+                file.sections = std::move(it->second.sections);
+                if (create_sections(file, sections))
+                {
+                    ++from_cache;
+                    for (auto& section : sections)
+                    {
+                        manager.merge_section(section);
+                    }
+
+                    files.push_back(std::move(file));
+                    continue;
+                }
+
+                file.sections.clear();
+                sections.clear();
+            }
+
+            bool cacheable = false;
+            auto contents  = read_file(path);
+            if (!contents || !parse_xml_file(file, sections, cacheable))
+            {
+                continue;
+            }
+
+            ++parsed;
+            for (auto& section : sections)
+            {
+                manager.merge_section(section);
+            }
+
+            if (cacheable)
+            {
+                file.hash = hash_contents(*contents);
+                files.push_back(std::move(file));
+                cache_changed = true;
+            }
+        }
+    }
+
+    // Files which were removed, changed or became uncacheable.
+    cache_changed |= (from_cache != cached.size());
+    if (cache_changed)
+    {
+        write_cache(cache_file, files);
+    }
+
+    LOGD("Loaded XML metadata: ", from_cache, " files from the cache, ", parsed, " files parsed");
+}
+
+std::string wf::get_xml_metadata_cache_file()
+{
+    std::string dir;
+    if (char *cache_home = getenv("XDG_CACHE_HOME"))
+    {
+        dir = cache_home;
+    } else if (char *home = getenv("HOME"))
+    {
+        dir = std::string(home) + "/.cache";
+    } else
+    {
+        dir = "/tmp";
+    }
+
+    return dir + "/wayfire/metadata-" + std::to_string(getuid()) + ".cache";
+}
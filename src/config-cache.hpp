@@ -0,0 +1,24 @@
+#pragma once
+
+#include <wayfire/config/config-manager.hpp>
+#include <string>
+#include <vector>
+
+namespace wf
+{
+/**
+ * Add the sections described by the XML metadata files in @xmldirs to @manager, like
+ * wf::config::build_configuration() does.
+ *
+ * Parsing the XML files of all plugins takes a noticeable part of the startup on slow machines, so the
+ * options are also compiled into the binary file @cache_file. It is memory-mapped on the next start, and the
+ * sections of the XML files which did not change since then (same mtime and size, or same contents) are
+ * created from it directly. Changed files, and files with options which cannot be cached (for example
+ * compound options), are parsed as usual. The cache is rewritten when it is out of date.
+ */
+void load_xml_metadata_cached(config::config_manager_t& manager,
+    const std::vector<std::string>& xmldirs, const std::string& cache_file);
+
+/** The default location of the cache file, in $XDG_CACHE_HOME or ~/.cache. */
+std::string get_xml_metadata_cache_file();
+}
@@ -0,0 +1,141 @@
+#include "wayfire/async.hpp"
+#include "wayfire/core.hpp"
+#include "wayfire/output.hpp"
+#include "wayfire/output-layout.hpp"
+#include "wayfire/render-manager.hpp"
+#include "wayfire/signal-definitions.hpp"
+#include "wayfire/txn/transaction.hpp"
+#include "wayfire/util.hpp"
+
+#include <algorithm>
+
+struct wf::async::scope_t::wait_t
+{
+    std::function<void()> on_cancel;
+
+    // The event source, depending on the kind of wait
+    wf::wl_idle_call idle;
+    wf::wl_timer<false> timer;
+    wf::wl_listener_wrapper on_present;
+    wf::signal::connection_t<wf::output_pre_remove_signal> on_output_removed;
+    wf::signal::connection_t<wf::txn::transaction_applied_signal> on_applied;
+    wf::signal::connection_t<wf::txn::transaction_merged_signal> on_merged;
+};
+
+wf::async::scope_t::scope_t() = default;
+
+wf::async::scope_t::~scope_t()
+{
+    cancel();
+}
+
+void wf::async::scope_t::cancel()
+{
+    // The cancel callbacks may destroy coroutines, which may start new waits or cancel this scope again.
+    auto dropped = std::move(waits);
+    waits.clear();
+    for (auto& wait : dropped)
+    {
+        if (wait->on_cancel)
+        {
+            wait->on_cancel();
+        }
+    }
+}
+
+size_t wf::async::scope_t::pending() const
+{
+    return waits.size();
+}
+
+wf::async::scope_t::wait_t& wf::async::scope_t::add_wait(std::function<void()> on_cancel)
+{
+    waits.push_back(std::make_unique<wait_t>());
+    waits.back()->on_cancel = std::move(on_cancel);
+    return *waits.back();
+}
+
+void wf::async::scope_t::fire(wait_t *wait, std::function<void()> callback)
+{
+    auto it = std::find_if(waits.begin(), waits.end(), [&] (auto& w) { return w.get() == wait; });
+    if (it == waits.end())
+    {
+        return;
+    }
+
+    // The wait is destroyed only after the callback, because we are still inside its event source.
+    auto self = std::move(*it);
+    waits.erase(it);
+    callback();
+}
+
+void wf::async::scope_t::drop(wait_t *wait)
+{
+    auto it = std::find_if(waits.begin(), waits.end(), [&] (auto& w) { return w.get() == wait; });
+    if (it == waits.end())
+    {
+        return;
+    }
+
+    auto self = std::move(*it);
+    waits.erase(it);
+    if (self->on_cancel)
+    {
+        self->on_cancel();
+    }
+}
+
+void wf::async::scope_t::idle(std::function<void()> callback, std::function<void()> on_cancel)
+{
+    auto& wait = add_wait(std::move(on_cancel));
+    wait.idle.run_once([this, w = &wait, callback] { fire(w, callback); });
+}
+
+void wf::async::scope_t::sleep(uint32_t timeout_ms, std::function<void()> callback,
+    std::function<void()> on_cancel)
+{
+    auto& wait = add_wait(std::move(on_cancel));
+    wait.timer.set_timeout(timeout_ms, [this, w = &wait, callback] { fire(w, callback); });
+}
+
+void wf::async::scope_t::next_frame(wf::output_t *output, std::function<void()> callback,
+    std::function<void()> on_cancel)
+{
+    auto& wait = add_wait(std::move(on_cancel));
+    wait.on_present.set_callback([this, w = &wait, callback] (void*) { fire(w, callback); });
+    wait.on_present.connect(&output->handle->events.present);
+
+    // The frame never comes if the output goes away.
+    wait.on_output_removed = [this, w = &wait, output] (wf::output_pre_remove_signal *ev)
+    {
+        if (ev->output == output)
+        {
+            drop(w);
+        }
+    };
+    wf::get_core().output_layout->connect(&wait.on_output_removed);
+    output->render->schedule_redraw();
+}
+
+void wf::async::scope_t::transaction_applied(txn::transaction_t& tx, std::function<void(bool)> callback,
+    std::function<void()> on_cancel)
+{
+    auto& wait = add_wait(std::move(on_cancel));
+    wait.on_applied = [this, w = &wait, callback] (txn::transaction_applied_signal *ev)
+    {
+        const bool timed_out = ev->timed_out;
+        fire(w, [=] { callback(timed_out); });
+    };
+
+    // A pending transaction may be replaced by a newer one with the same objects, which is then applied.
+    wait.on_merged = [w = &wait] (txn::transaction_merged_signal *ev)
+    {
+        w->on_applied.disconnect();
+        w->on_merged.disconnect();
+        ev->into->connect(&w->on_applied);
+        ev->into->connect(&w->on_merged);
+    };
+
+    tx.connect(&wait.on_applied);
+    tx.connect(&wait.on_merged);
+}
@@ -87,6 +87,12 @@ class compositor_core_impl_t : public compositor_core_t
 
   private:
     wf::option_wrapper_t<bool> discard_command_output;
+    wf::option_wrapper_t<int> memory_trim_interval;
+    wf::wl_timer<true> memory_trim_timer;
+    /** (Re)start the periodic wf::gpu_memory::trim(), see workarounds/memory_trim_interval. */
+    void schedule_memory_trim();
+    /** The fallback of run() for kernels without pidfds, which disowns the child with a double fork. */
+    pid_t run_double_fork(std::string command);
     static std::unique_ptr<compositor_core_impl_t> static_core;
 };
 
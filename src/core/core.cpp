@@ -11,13 +11,19 @@
 #include "wayfire/txn/transaction-manager.hpp"
 #include "wayfire/bindings-repository.hpp"
 #include "wayfire/util.hpp"
+#include "wayfire/trace.hpp"
 #include <memory>
+#include <csignal>
 
 #include "plugin-loader.hpp"
 #include "seat/tablet.hpp"
 #include "wayfire/touch/touch.hpp"
 #include "wayfire/view.hpp"
 #include <sys/wait.h>
+#include <sys/syscall.h>
+#include <spawn.h>
+#include <cstring>
+#include <map>
 #include <unistd.h>
 #include <fcntl.h>
 #include <float.h>
@@ -41,8 +47,12 @@
 #include "../view/view-impl.hpp"
 #include "main.hpp"
 #include <wayfire/window-manager.hpp>
+#include <wayfire/thread-pool.hpp>
+#include <wayfire/gpu-memory.hpp>
 
 #include "core-impl.hpp"
+#include "log-buffer.hpp"
+#include "startup-profile.hpp"
 
 struct wf_pointer_constraint
 {
@@ -75,11 +85,29 @@ struct wlr_idle_inhibitor_t : public wf::idle_inhibitor_t
     }
 };
 
+/** Dump the recorded trace events on SIGUSR2 */
+static int handle_trace_dump_signal(int signal, void *data)
+{
+    const char *runtime_dir = getenv("XDG_RUNTIME_DIR");
+    std::string path = std::string(runtime_dir ? runtime_dir : "/tmp") +
+        "/wayfire-trace-" + std::to_string(getpid()) + ".json";
+    wf::trace::dump(path);
+    return 0;
+}
+
 void wf::compositor_core_impl_t::init()
 {
+    if (const char *trace_events = getenv("WAYFIRE_TRACE_EVENTS"))
+    {
+        wf::trace::start(std::max(1, atoi(trace_events)));
+    }
+
+    wl_event_loop_add_signal(ev_loop, SIGUSR2, handle_trace_dump_signal, nullptr);
+
     this->scene_root = std::make_shared<scene::root_node_t>();
     this->tx_manager = std::make_unique<txn::transaction_manager_t>();
     this->default_wm = std::make_unique<wf::window_manager_t>();
+    this->thread_pool = std::make_unique<wf::thread_pool_t>();
 
     wlr_renderer_init_wl_display(renderer, display);
 
@@ -201,6 +229,7 @@ void wf::compositor_core_impl_t::init()
 
     protocols.presentation = wlr_presentation_create(display, backend);
     protocols.viewporter   = wlr_viewporter_create(display);
+    protocols.tearing_control = wlr_tearing_control_manager_v1_create(display, 1);
 
     protocols.foreign_registry = wlr_xdg_foreign_registry_create(display);
     protocols.foreign_v1 = wlr_xdg_foreign_v1_create(display,
@@ -213,13 +242,20 @@ void wf::compositor_core_impl_t::init()
 
     this->bindings = std::make_unique<bindings_repository_t>();
     image_io::init();
-    OpenGL::init();
+    {
+        wf::startup_profile::scope_t profile{"OpenGL::init"};
+        OpenGL::init();
+    }
+
     this->state = compositor_state_t::START_BACKEND;
 }
 
 void wf::compositor_core_impl_t::post_init()
 {
     discard_command_output.load_option("workarounds/discard_command_output");
+    memory_trim_interval.load_option("workarounds/memory_trim_interval");
+    memory_trim_interval.set_callback([=] { schedule_memory_trim(); });
+    schedule_memory_trim();
 
     core_backend_started_signal backend_started_ev;
     this->emit(&backend_started_ev);
@@ -243,6 +279,22 @@ void wf::compositor_core_impl_t::post_init()
     this->emit(&startup_ev);
 }
 
+void wf::compositor_core_impl_t::schedule_memory_trim()
+{
+    memory_trim_timer.disconnect();
+    if (memory_trim_interval <= 0)
+    {
+        return;
+    }
+
+    memory_trim_timer.set_timeout(memory_trim_interval * 1000, [=] ()
+    {
+        const int64_t freed = wf::gpu_memory::trim();
+        LOGD("Periodic memory trim freed ", freed, " bytes of GPU memory");
+        return true;
+    });
+}
+
 void wf::compositor_core_impl_t::shutdown()
 {
     // We might get multiple signals in some scenarios. Shutdown only on the first instance.
@@ -255,6 +307,7 @@ void wf::compositor_core_impl_t::shutdown()
 void wf::compositor_core_impl_t::fini()
 {
     this->state = compositor_state_t::SHUTDOWN;
+    memory_trim_timer.disconnect();
     core_shutdown_signal ev;
     this->emit(&ev);
 
@@ -274,7 +327,9 @@ void wf::compositor_core_impl_t::fini()
     priv_output_layout_fini(output_layout.get());
     output_layout.reset();
     tx_manager.reset();
+    thread_pool.reset();
     OpenGL::fini();
+    wf::log_buffer::set_event_loop(nullptr);
     wl_display_destroy(static_core->display);
 }
 
@@ -414,7 +469,139 @@ std::vector<wayfire_view> wf::compositor_core_t::get_all_views()
     return wf::tracking_allocator_t<view_interface_t>::get().get_all();
 }
 
+/** @return Whether the kernel supports pidfds, which are needed to reap children asynchronously. */
+static bool has_pidfd_support()
+{
+#ifdef SYS_pidfd_open
+    static const bool supported = [] ()
+    {
+        int fd = syscall(SYS_pidfd_open, getpid(), 0);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        close(fd);
+        return true;
+    }();
+    return supported;
+#else
+    return false;
+#endif
+}
+
+/** Reap the child process with the given pid when it exits, without blocking the event loop. */
+static void reap_child_on_exit(pid_t pid)
+{
+    struct reaper_t
+    {
+        pid_t pid;
+        wl_event_source *source;
+    };
+
+    int fd = -1;
+#ifdef SYS_pidfd_open
+    fd = syscall(SYS_pidfd_open, pid, 0);
+#endif
+    if (fd < 0)
+    {
+        // Should not happen, as the child cannot have been reaped yet.
+        LOGE("Failed to watch child process ", pid, ", it will become a zombie when it exits");
+        return;
+    }
+
+    auto reaper = new reaper_t{pid, nullptr};
+    reaper->source = wl_event_loop_add_fd(wf::get_core().ev_loop, fd, WL_EVENT_READABLE,
+        [] (int fd, uint32_t mask, void *data)
+    {
+        auto reaper = static_cast<reaper_t*>(data);
+        waitpid(reaper->pid, nullptr, WNOHANG);
+        wl_event_source_remove(reaper->source);
+        close(fd);
+        delete reaper;
+        return 0;
+    }, reaper);
+}
+
 pid_t wf::compositor_core_impl_t::run(std::string command)
+{
+    if (!has_pidfd_support())
+    {
+        return run_double_fork(command);
+    }
+
+    // posix_spawn() does not copy the page tables of the compositor like fork(), which takes a long time when
+    // it uses a lot of memory. The child is reaped asynchronously when it exits.
+    std::map<std::string, std::string> overrides = {
+        {"_JAVA_AWT_WM_NONREPARENTING", "1"},
+        {"WAYLAND_DISPLAY", wayland_display},
+    };
+#if WF_HAS_XWAYLAND
+    if (!xwayland_get_display().empty())
+    {
+        overrides["DISPLAY"] = xwayland_get_display();
+    }
+
+#endif
+
+    std::vector<std::string> env;
+    for (char **var = environ; *var; var++)
+    {
+        std::string entry = *var;
+        if (!overrides.count(entry.substr(0, entry.find('='))))
+        {
+            env.push_back(std::move(entry));
+        }
+    }
+
+    for (auto& [name, value] : overrides)
+    {
+        env.push_back(name + "=" + value);
+    }
+
+    std::vector<char*> envp;
+    for (auto& entry : env)
+    {
+        envp.push_back(entry.data());
+    }
+
+    envp.push_back(nullptr);
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (discard_command_output)
+    {
+        posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+        posix_spawn_file_actions_adddup2(&actions, 1, 2);
+    }
+
+    // Do not pass our signal mask and ignored signals (SIGPIPE) to the child.
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t mask, defaults;
+    sigemptyset(&mask);
+    sigemptyset(&defaults);
+    sigaddset(&defaults, SIGPIPE);
+    posix_spawnattr_setsigmask(&attr, &mask);
+    posix_spawnattr_setsigdefault(&attr, &defaults);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+
+    pid_t pid;
+    char *argv[] = {(char*)"/bin/sh", (char*)"-c", command.data(), nullptr};
+    int error = posix_spawn(&pid, "/bin/sh", &actions, &attr, argv, envp.data());
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    if (error)
+    {
+        LOGE("Failed to run command ", command, ": ", strerror(error));
+        return -1;
+    }
+
+    reap_child_on_exit(pid);
+    return pid;
+}
+
+pid_t wf::compositor_core_impl_t::run_double_fork(std::string command)
 {
     static constexpr size_t READ_END  = 0;
     static constexpr size_t WRITE_END = 1;
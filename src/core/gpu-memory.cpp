@@ -0,0 +1,137 @@
+#include <wayfire/gpu-memory.hpp>
+#include <wayfire/core.hpp>
+#include <wayfire/opengl.hpp>
+#include <wayfire/plugin-stats.hpp>
+#include <wayfire/scene.hpp>
+#include <wayfire/option-wrapper.hpp>
+#include <algorithm>
+#include <typeinfo>
+#include <unordered_map>
+#ifdef __GLIBC__
+    #include <malloc.h>
+#endif
+
+wf::scene::node_t *wf::gpu_memory::detail::current_node = nullptr;
+
+namespace
+{
+std::unordered_map<uintptr_t, wf::gpu_memory::allocation_t> allocations;
+int64_t totals[wf::gpu_memory::TYPE_COUNT] = {0};
+}
+
+const char *wf::gpu_memory::type_name(type_t type)
+{
+    switch (type)
+    {
+      case TYPE_FRAMEBUFFER:
+        return "framebuffer";
+
+      case TYPE_POOL:
+        return "pool";
+
+      case TYPE_DEPTH:
+        return "depth";
+
+      case TYPE_TEXTURE:
+        return "texture";
+
+      case TYPE_CLIENT:
+        return "client";
+
+      default:
+        return "unknown";
+    }
+}
+
+void wf::gpu_memory::set(uintptr_t key, type_t type, int64_t bytes, const void *owner, scene::node_t *node)
+{
+    auto it = allocations.find(key);
+    if (it != allocations.end())
+    {
+        totals[it->second.type] -= it->second.bytes;
+        if (bytes <= 0)
+        {
+            allocations.erase(it);
+            return;
+        }
+    } else if (bytes <= 0)
+    {
+        return;
+    }
+
+    node = node ?: detail::current_node;
+    auto& entry = allocations[key];
+    entry.key   = key;
+    entry.type  = type;
+    entry.bytes = bytes;
+    entry.owner = owner ? plugin_stats::get_owner_name(owner) : "core";
+    if (node)
+    {
+        // Buffers of nodes are often allocated by inline code in core headers, in that case the plugin
+        // which implements the node is the more useful owner.
+        if (entry.owner == "core")
+        {
+            entry.owner = plugin_stats::get_owner_name(&typeid(*node));
+        }
+
+        entry.node = node->weak_from_this();
+    } else
+    {
+        entry.node.reset();
+    }
+
+    totals[type] += bytes;
+}
+
+int64_t wf::gpu_memory::get_total(type_t type)
+{
+    return totals[type];
+}
+
+int64_t wf::gpu_memory::get_total()
+{
+    int64_t total = 0;
+    for (int i = 0; i < TYPE_COUNT; i++)
+    {
+        total += totals[i];
+    }
+
+    return total;
+}
+
+std::vector<wf::gpu_memory::allocation_t> wf::gpu_memory::get_allocations()
+{
+    std::vector<allocation_t> result;
+    result.reserve(allocations.size());
+    for (auto& [key, entry] : allocations)
+    {
+        result.push_back(entry);
+    }
+
+    return result;
+}
+
+int64_t wf::gpu_memory::get_soft_cap()
+{
+    static wf::option_wrapper_t<int> soft_cap{"workarounds/gpu_memory_soft_cap"};
+    return int64_t(std::max(0, (int)soft_cap)) * 1024 * 1024;
+}
+
+int64_t wf::gpu_memory::trim()
+{
+    const int64_t before = get_total();
+
+    // Buffers which the listeners release to the pool are freed below.
+    trim_signal data;
+    wf::get_core().emit(&data);
+
+    OpenGL::render_begin();
+    OpenGL::release_idle_framebuffers();
+    OpenGL::render_end();
+
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+
+    return before - get_total();
+}
@@ -1,4 +1,4 @@
-#include <GLES2/gl2.h>
+#include <GLES3/gl3.h>
 #include <wayfire/util/log.hpp>
 #include "wayfire/img.hpp"
 #include "wayfire/opengl.hpp"
@@ -17,12 +17,16 @@
 #include <cstdio>
 #include <unordered_map>
 #include <functional>
+#include <algorithm>
+#include <memory>
+#include <wayfire/core.hpp>
+#include <wayfire/thread-pool.hpp>
 
 #define TEXTURE_LOAD_ERROR 0
 
 namespace image_io
 {
-using Loader = std::function<bool (const char*, GLuint)>;
+using Loader = std::function<bool (const char*, decoded_image_t&)>;
 using Writer = std::function<void (const char*name, uint8_t*pixels, unsigned long,
     unsigned long, bool)>;
 namespace
@@ -121,9 +125,14 @@ bool load_data_as_cubemap(unsigned char *data, int width, int height, int channe
 #ifdef BUILD_WITH_IMAGEIO
 /* All backend functions are taken from the internet.
  * If you want to be credited, contact me */
-bool texture_from_png(const char *filename, GLuint target)
+bool decode_png(const char *filename, decoded_image_t& image)
 {
     FILE *fp = fopen(filename, "rb");
+    if (!fp)
+    {
+        LOGE("failed to read PNG file ", filename);
+        return false;
+    }
     int width, height;
     png_byte color_type;
     png_byte bit_depth;
@@ -195,36 +204,21 @@ bool texture_from_png(const char *filename, GLuint target)
 
     png_read_update_info(png, infos);
 
-    row_pointers = new png_bytep[height];
-    png_byte *data = new png_byte[height * png_get_rowbytes(png, infos)];
+    image.width    = width;
+    image.height   = height;
+    image.channels = png_get_channels(png, infos);
+    image.pixels.resize(height * png_get_rowbytes(png, infos));
 
+    row_pointers = new png_bytep[height];
     for (int i = 0; i < height; i++)
     {
-        row_pointers[i] = data + i * png_get_rowbytes(png, infos);
+        row_pointers[i] = image.pixels.data() + i * png_get_rowbytes(png, infos);
     }
 
     png_read_image(png, row_pointers);
 
-    if (target == GL_TEXTURE_CUBE_MAP)
-    {
-        if (!load_data_as_cubemap(data, width, height,
-            png_get_channels(png, infos)))
-        {
-            png_destroy_read_struct(&png, &infos, NULL);
-            delete[] row_pointers;
-            delete[] data;
-            fclose(fp);
-            return false;
-        }
-    } else if (target == GL_TEXTURE_2D)
-    {
-        GL_CALL(glTexImage2D(target, 0, GL_RGBA, width, height, 0,
-            GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)data));
-    }
-
     png_destroy_read_struct(&png, &infos, NULL);
     delete[] row_pointers;
-    delete[] data;
 
     fclose(fp);
 
@@ -295,11 +289,9 @@ void texture_to_png(const char *name, uint8_t *pixels, int w, int h, bool invert
     png_free(png, rows);
 }
 
-bool texture_from_jpeg(const char *FileName, GLuint target)
+bool decode_jpeg(const char *FileName, decoded_image_t& image)
 {
-    unsigned long data_size;
     unsigned char *rowptr[1];
-    unsigned char *jdata;
     struct jpeg_decompress_struct infot;
     struct jpeg_error_mgr err;
 
@@ -310,6 +302,7 @@ bool texture_from_jpeg(const char *FileName, GLuint target)
     if (!file)
     {
         LOGE("failed to read JPEG file ", FileName);
+        jpeg_destroy_decompress(&infot);
 
         return false;
     }
@@ -318,44 +311,26 @@ bool texture_from_jpeg(const char *FileName, GLuint target)
     jpeg_read_header(&infot, TRUE);
     jpeg_start_decompress(&infot);
 
-    data_size = infot.output_width * infot.output_height * 3;
-
-    jdata = new unsigned char [data_size];
+    image.width    = infot.output_width;
+    image.height   = infot.output_height;
+    image.channels = 3;
+    image.pixels.resize(infot.output_width * infot.output_height * 3);
     while (infot.output_scanline < infot.output_height)
     {
-        rowptr[0] = (unsigned char*)jdata + 3 * infot.output_width *
+        rowptr[0] = image.pixels.data() + 3 * infot.output_width *
             infot.output_scanline;
         jpeg_read_scanlines(&infot, rowptr, 1);
     }
 
     jpeg_finish_decompress(&infot);
-
-    GLint width  = infot.output_width;
-    GLint height = infot.output_height;
-
-    if (target == GL_TEXTURE_CUBE_MAP)
-    {
-        if (!load_data_as_cubemap(jdata, width, height, 3))
-        {
-            fclose(file);
-            delete[] jdata;
-            return false;
-        }
-    } else if (target == GL_TEXTURE_2D)
-    {
-        GL_CALL(glTexImage2D(target, 0, GL_RGB, width, height, 0,
-            GL_RGB, GL_UNSIGNED_BYTE, jdata));
-    }
-
+    jpeg_destroy_decompress(&infot);
     fclose(file);
-    delete[] jdata;
 
     return true;
 }
-
 #endif
 
-bool load_from_file(std::string name, GLuint target)
+bool decode_file(std::string name, decoded_image_t& image)
 {
     if (access(name.c_str(), F_OK) == -1)
     {
@@ -371,7 +346,7 @@ bool load_from_file(std::string name, GLuint target)
     if ((len < 4) || (name[len - 4] != '.'))
     {
         LOGE(
-            "load_from_file() called with file without extension or with invalid extension!");
+            "decode_file() called with file without extension or with invalid extension!");
 
         return false;
     }
@@ -385,15 +360,148 @@ bool load_from_file(std::string name, GLuint target)
     auto it = loaders.find(ext);
     if (it == loaders.end())
     {
-        LOGE("load_from_file() called with unsupported extension ", ext);
+        LOGE("decode_file() called with unsupported extension ", ext);
 
         return false;
     } else
     {
-        return it->second(name.c_str(), target);
+        return it->second(name.c_str(), image);
     }
 }
 
+bool upload_image(const decoded_image_t& image, GLuint target)
+{
+    if (image.pixels.empty())
+    {
+        return false;
+    }
+
+    // Stage the pixels in a pixel buffer object, so that the driver can copy them to the texture
+    // asynchronously instead of stalling on a client memory pointer.
+    GLuint pbo;
+    GL_CALL(glGenBuffers(1, &pbo));
+    GL_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo));
+    GL_CALL(glBufferData(GL_PIXEL_UNPACK_BUFFER, image.pixels.size(), nullptr, GL_STREAM_DRAW));
+    void *staging = GL_CALL(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, image.pixels.size(),
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    const unsigned char *data = image.pixels.data();
+    if (staging)
+    {
+        memcpy(staging, image.pixels.data(), image.pixels.size());
+        GL_CALL(glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER));
+        // Offsets into the PBO from now on
+        data = nullptr;
+    } else
+    {
+        GL_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+    }
+
+    bool result = true;
+    GL_CALL(glPixelStorei(GL_UNPACK_ALIGNMENT, 1));
+    if (target == GL_TEXTURE_CUBE_MAP)
+    {
+        result = load_data_as_cubemap((unsigned char*)data, image.width, image.height, image.channels);
+    } else if (target == GL_TEXTURE_2D)
+    {
+        const auto format = (image.channels == 4) ? GL_RGBA : GL_RGB;
+        GL_CALL(glTexImage2D(target, 0, format, image.width, image.height, 0,
+            format, GL_UNSIGNED_BYTE, (GLvoid*)data));
+    }
+
+    GL_CALL(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+    GL_CALL(glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0));
+    GL_CALL(glDeleteBuffers(1, &pbo));
+    return result;
+}
+
+void downscale_image(decoded_image_t& image, int width, int height)
+{
+    if ((width <= 0) || (height <= 0) || (width > image.width) || (height > image.height) ||
+        ((width == image.width) && (height == image.height)))
+    {
+        return;
+    }
+
+    const int channels = image.channels;
+    std::vector<uint8_t> pixels((size_t)width * height * channels);
+    std::vector<uint32_t> sum(channels);
+    for (int y = 0; y < height; y++)
+    {
+        const int y1 = (int64_t)y * image.height / height;
+        const int y2 = (int64_t)(y + 1) * image.height / height;
+        for (int x = 0; x < width; x++)
+        {
+            const int x1 = (int64_t)x * image.width / width;
+            const int x2 = (int64_t)(x + 1) * image.width / width;
+            std::fill(sum.begin(), sum.end(), 0);
+            for (int sy = y1; sy < y2; sy++)
+            {
+                const uint8_t *row = image.pixels.data() + ((size_t)sy * image.width + x1) * channels;
+                for (int i = 0; i < (x2 - x1) * channels; i++)
+                {
+                    sum[i % channels] += row[i];
+                }
+            }
+
+            const uint32_t count = (x2 - x1) * (y2 - y1);
+            uint8_t *out = pixels.data() + ((size_t)y * width + x) * channels;
+            for (int c = 0; c < channels; c++)
+            {
+                out[c] = (sum[c] + count / 2) / count;
+            }
+        }
+    }
+
+    image.width  = width;
+    image.height = height;
+    image.pixels = std::move(pixels);
+}
+
+bool load_from_file(std::string name, GLuint target)
+{
+    decoded_image_t image;
+    return decode_file(name, image) && upload_image(image, target);
+}
+
+namespace
+{
+/**
+ * Run @work on the core's thread pool, then @done on the main thread unless @lifetime was set and has expired
+ * in the meantime.
+ */
+void schedule_job(std::function<void()> work, std::function<void()> done, std::shared_ptr<void> lifetime,
+    const void *owner)
+{
+    std::weak_ptr<void> weak_lifetime = lifetime;
+    const bool has_lifetime = (bool)lifetime;
+    wf::get_core().thread_pool->schedule(std::move(work), [=, done = std::move(done)] ()
+    {
+        if (done && (!has_lifetime || !weak_lifetime.expired()))
+        {
+            done();
+        }
+    }, owner);
+}
+}
+
+void decode_file_async(std::string name, decode_callback_t callback, std::shared_ptr<void> lifetime,
+    std::function<void(decoded_image_t&)> prepare, const void *owner)
+{
+    auto image  = std::make_shared<decoded_image_t>();
+    auto result = std::make_shared<bool>(false);
+    schedule_job([=] ()
+    {
+        *result = decode_file(name, *image);
+        if (*result && prepare)
+        {
+            prepare(*image);
+        }
+    }, [=] ()
+    {
+        callback(*result ? image : nullptr);
+    }, std::move(lifetime), owner);
+}
+
 void write_to_file(std::string name, uint8_t *pixels, int w, int h, std::string type,
     bool invert)
 {
@@ -420,12 +528,36 @@ void write_to_file(std::string name, wf::framebuffer_t fb)
         fb.viewport_width, fb.viewport_height, "png", false);
 }
 
+void write_to_file_async(std::string name, std::vector<uint8_t> pixels, int w, int h,
+    std::string type, bool invert, std::function<void()> done, const void *owner)
+{
+    auto data = std::make_shared<std::vector<uint8_t>>(std::move(pixels));
+    schedule_job([=] ()
+    {
+        write_to_file(name, data->data(), w, h, type, invert);
+    }, done, nullptr, owner);
+}
+
+void write_to_file_async(std::string name, wf::framebuffer_t fb, std::function<void()> done,
+    const void *owner)
+{
+    // Only the read back happens on the main thread.
+    std::vector<uint8_t> buffer(fb.viewport_width * fb.viewport_height * 4);
+    OpenGL::render_begin();
+    GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER, fb.fb));
+    GL_CALL(glReadPixels(0, 0, fb.viewport_width, fb.viewport_height,
+        GL_RGBA, GL_UNSIGNED_BYTE, buffer.data()));
+    OpenGL::render_end();
+    write_to_file_async(name, std::move(buffer), fb.viewport_width, fb.viewport_height, "png", false,
+        std::move(done), owner);
+}
+
 void init()
 {
     LOGD("init ImageIO");
 #ifdef BUILD_WITH_IMAGEIO
-    loaders["png"] = Loader(texture_from_png);
-    loaders["jpg"] = Loader(texture_from_jpeg);
+    loaders["png"] = Loader(decode_png);
+    loaders["jpg"] = Loader(decode_jpeg);
     writers["png"] = Writer(texture_to_png);
 #endif
 }
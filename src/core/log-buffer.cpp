@@ -0,0 +1,164 @@
+#include "log-buffer.hpp"
+#include <wayland-server-core.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <streambuf>
+#include <vector>
+#include <unistd.h>
+
+namespace
+{
+class ring_streambuf_t : public std::streambuf
+{
+  public:
+    ring_streambuf_t(size_t capacity) : ring(std::max(capacity, size_t(1)))
+    {}
+
+    void set_event_loop(wl_event_loop *loop)
+    {
+        if (idle_source)
+        {
+            wl_event_source_remove(idle_source);
+            idle_source = nullptr;
+        }
+
+        this->loop = loop;
+        drain();
+    }
+
+    void drain()
+    {
+        while (pending > 0)
+        {
+            const size_t chunk = std::min(pending, ring.size() - first);
+            if (!write_all(ring.data() + first, chunk))
+            {
+                // Nothing we can do if stdout is gone, drop the output.
+                pending = 0;
+                break;
+            }
+
+            first    = (first + chunk) % ring.size();
+            pending -= chunk;
+        }
+
+        first = 0;
+    }
+
+  protected:
+    int overflow(int c) override
+    {
+        if (c != traits_type::eof())
+        {
+            const char ch = c;
+            xsputn(&ch, 1);
+        }
+
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char *data, std::streamsize count) override
+    {
+        const size_t size = count;
+        if (pending + size > ring.size())
+        {
+            drain();
+        }
+
+        if (size > ring.size())
+        {
+            write_all(data, size);
+            return count;
+        }
+
+        size_t last = (first + pending) % ring.size();
+        const size_t chunk = std::min(size, ring.size() - last);
+        std::copy(data, data + chunk, ring.data() + last);
+        std::copy(data + chunk, data + size, ring.data());
+        pending += size;
+        return count;
+    }
+
+    int sync() override
+    {
+        if (!loop)
+        {
+            drain();
+        } else if (!idle_source && pending)
+        {
+            idle_source = wl_event_loop_add_idle(loop, [] (void *data)
+            {
+                auto self = (ring_streambuf_t*)data;
+                self->idle_source = nullptr;
+                self->drain();
+            }, this);
+        }
+
+        return 0;
+    }
+
+  private:
+    std::vector<char> ring;
+    /** The position of the oldest byte which has not been written yet */
+    size_t first   = 0;
+    size_t pending = 0;
+
+    wl_event_loop *loop = nullptr;
+    wl_event_source *idle_source = nullptr;
+
+    static bool write_all(const char *data, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t written = write(STDOUT_FILENO, data, size);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                return false;
+            }
+
+            data += written;
+            size -= written;
+        }
+
+        return true;
+    }
+};
+
+// Never freed, because the log stream may be used until the very end of the program.
+ring_streambuf_t *buffer = nullptr;
+std::ostream *stream     = nullptr;
+}
+
+std::ostream& wf::log_buffer::enable(size_t capacity)
+{
+    if (!buffer)
+    {
+        buffer = new ring_streambuf_t(capacity);
+        stream = new std::ostream(buffer);
+        std::atexit(wf::log_buffer::flush);
+    }
+
+    return *stream;
+}
+
+void wf::log_buffer::set_event_loop(wl_event_loop *loop)
+{
+    if (buffer)
+    {
+        buffer->set_event_loop(loop);
+    }
+}
+
+void wf::log_buffer::flush()
+{
+    if (buffer)
+    {
+        buffer->drain();
+    }
+}
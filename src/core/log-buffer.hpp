@@ -0,0 +1,44 @@
+#pragma once
+
+#include <ostream>
+#include <cstddef>
+
+struct wl_event_loop;
+
+namespace wf
+{
+/**
+ * Deferred writing of the log output.
+ *
+ * By default, every log line is written to stdout (and flushed) as soon as it is formatted, which costs a
+ * write() on the hot path for each line. With the log buffer enabled, the lines are appended to a fixed-size
+ * in-memory ring instead, and the ring is drained to stdout from an idle callback, once the event loop has
+ * nothing else to do. If the ring fills up before the next idle callback, it is drained immediately, so no
+ * output is ever lost.
+ *
+ * All logging happens on the main thread, so the ring does not need any locking. The remaining output is
+ * written at exit(), crash handlers which bypass it need to call flush() themselves.
+ */
+namespace log_buffer
+{
+/**
+ * Start buffering log output.
+ *
+ * @param capacity The size of the ring in bytes.
+ * @return The stream which should be passed to wf::log::initialize_logging().
+ */
+std::ostream& enable(size_t capacity);
+
+/**
+ * Set the event loop in which the buffer is drained. Until an event loop is set, or after it is reset to
+ * nullptr, the buffer is drained on every flush of the stream.
+ */
+void set_event_loop(wl_event_loop *loop);
+
+/**
+ * Write out all buffered output immediately. This is safe to call in a crash handler, so that the lines
+ * logged right before a crash are not lost.
+ */
+void flush();
+}
+}
@@ -1,9 +1,25 @@
 #include "wayfire/object.hpp"
 #include "wayfire/nonstd/safe-list.hpp"
 #include <unordered_map>
+#include <vector>
 #include <set>
 
 #include <wayfire/signal-provider.hpp>
+#include <typeindex>
+
+size_t wf::signal::detail::allocate_signal_slot(const std::type_info& type)
+{
+    static std::unordered_map<std::type_index, size_t> slots;
+    auto it = slots.find(type);
+    if (it != slots.end())
+    {
+        return it->second;
+    }
+
+    const size_t slot = slots.size();
+    slots[type] = slot;
+    return slot;
+}
 
 void wf::signal::connection_base_t::disconnect()
 {
@@ -14,11 +30,48 @@ void wf::signal::connection_base_t::disconnect()
     }
 }
 
+namespace
+{
+/** The slot of each type name, and the type name of each slot */
+std::unordered_map<std::string, size_t> data_slots;
+std::vector<std::string> data_slot_names;
+}
+
+size_t wf::detail::allocate_object_data_slot(const std::type_info& type)
+{
+    auto it = data_slots.find(type.name());
+    if (it != data_slots.end())
+    {
+        return it->second;
+    }
+
+    data_slot_names.push_back(type.name());
+    return data_slots[type.name()] = data_slot_names.size() - 1;
+}
+
 class wf::object_base_t::obase_impl
 {
   public:
     std::unordered_map<std::string, std::unique_ptr<custom_data_t>> data;
     uint32_t object_id;
+
+    struct cached_slot_t
+    {
+        bool valid = false;
+        custom_data_t *data = nullptr;
+    };
+
+    /** The result of looking up the name of each slot in data, updated whenever the name is written */
+    std::vector<cached_slot_t> slot_cache;
+
+    void invalidate(const std::string& name)
+    {
+        auto it = data_slots.find(name);
+        if ((it != data_slots.end()) && (it->second < slot_cache.size()))
+        {
+            slot_cache[it->second].valid = false;
+        }
+    }
 };
 
 wf::object_base_t::object_base_t()
@@ -50,10 +103,11 @@ void wf::object_base_t::erase_data(std::string name)
 {
     auto data = std::move(obase_priv->data[name]);
     obase_priv->data.erase(name);
+    obase_priv->invalidate(name);
     data.reset();
 }
 
-wf::custom_data_t*wf::object_base_t::_fetch_data(std::string name)
+wf::custom_data_t*wf::object_base_t::_fetch_data(const std::string& name)
 {
     auto it = obase_priv->data.find(name);
     if (it == obase_priv->data.end())
@@ -64,6 +118,23 @@ wf::custom_data_t*wf::object_base_t::_fetch_data(std::string name)
     return it->second.get();
 }
 
+wf::custom_data_t*wf::object_base_t::_fetch_data(size_t slot)
+{
+    auto& cache = obase_priv->slot_cache;
+    if (slot >= cache.size())
+    {
+        cache.resize(slot + 1);
+    }
+
+    if (!cache[slot].valid)
+    {
+        cache[slot].data  = _fetch_data(data_slot_names[slot]);
+        cache[slot].valid = true;
+    }
+
+    return cache[slot].data;
+}
+
 wf::custom_data_t*wf::object_base_t::_fetch_erase(std::string name)
 {
     auto data = obase_priv->data[name].release();
@@ -75,10 +146,18 @@ wf::custom_data_t*wf::object_base_t::_fetch_erase(std::string name)
 void wf::object_base_t::_store_data(std::unique_ptr<wf::custom_data_t> data,
     std::string name)
 {
+    // Keep the old data alive until the cache has been updated, its destructor may access other data.
+    auto old_data = std::move(obase_priv->data[name]);
     obase_priv->data[name] = std::move(data);
+    obase_priv->invalidate(name);
 }
 
 void wf::object_base_t::_clear_data()
 {
+    // The destructors of the data may access other data, so make sure they do not find data which is being
+    // destroyed.
+    auto data = std::move(obase_priv->data);
     obase_priv->data.clear();
+    obase_priv->slot_cache.clear();
+    data.clear();
 }
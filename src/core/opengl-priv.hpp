@@ -14,6 +14,8 @@ void fini();
 void bind_output(wf::output_t *output, uint32_t fb);
 /** Indicate the output frame has been finished */
 void unbind_output(wf::output_t *output);
+/** Forget the tracked GL state, needed after rendering with wlroots during a frame */
+void invalidate_state();
 }
 
 #endif /* end of include guard: WF_OPENGL_PRIV_HPP */
@@ -1,5 +1,6 @@
 #include <wayfire/util/log.hpp>
 #include <map>
+#include <algorithm>
 #include "opengl-priv.hpp"
 #include "wayfire/geometry.hpp"
 #include "wayfire/output.hpp"
@@ -7,11 +8,18 @@
 #include "config.h"
 #include <wayfire/nonstd/wlroots-full.hpp>
 #include <set>
+#include <cstring>
+#include <optional>
+#include <filesystem>
+#include <fstream>
+#include <unistd.h>
 
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "shaders.tpp"
 #include "wayfire/region.hpp"
+#include "wayfire/option-wrapper.hpp"
+#include "wayfire/gpu-memory.hpp"
 
 const char *gl_error_string(const GLenum err)
 {
@@ -34,8 +42,167 @@ const char *gl_error_string(const GLenum err)
 }
 
 static bool disable_gl_call = false;
+static uint64_t draw_call_count = 0;
+
+namespace
+{
+/**
+ * Tracks the GL state which the rendering helpers in this file change for every draw: the bound program,
+ * the texture bound to unit 0, blending and the scissor test. Consecutive draws typically use the same
+ * values, so redundant calls can be skipped.
+ *
+ * Tracking is active only while an output frame is being rendered. Any state change made through GL_CALL
+ * outside of the tracker (for example by plugins with custom programs) invalidates the tracked state, as
+ * does rendering done by wlroots.
+ */
+class gl_state_tracker_t
+{
+  public:
+    /** Set while the tracker itself issues GL calls. */
+    bool internal_call = false;
+
+    void set_active(bool active)
+    {
+        this->active = active;
+        invalidate();
+    }
+
+    void invalidate()
+    {
+        program.reset();
+        texture_unit.reset();
+        texture.reset();
+        blend.reset();
+        scissor.reset();
+    }
+
+    /** Called for all GL calls made through GL_CALL which were not issued by the tracker. */
+    void note_external_call(const char *glfunc)
+    {
+        if (!active)
+        {
+            return;
+        }
+
+        if (!std::strncmp(glfunc, "glDelete", 8))
+        {
+            /* Deleting a bound object resets the binding, and its name may be reused right away */
+            invalidate();
+        } else if (!std::strncmp(glfunc, "glUseProgram", 12))
+        {
+            program.reset();
+        } else if (!std::strncmp(glfunc, "glBindTexture", 13) || !std::strncmp(glfunc, "glActiveTexture", 15))
+        {
+            texture_unit.reset();
+            texture.reset();
+        } else if (!std::strncmp(glfunc, "glEnable", 8) || !std::strncmp(glfunc, "glDisable", 9) ||
+                   !std::strncmp(glfunc, "glBlendFunc", 11))
+        {
+            blend.reset();
+            scissor.reset();
+        }
+    }
+
+    void use_program(GLuint id)
+    {
+        if (!active || (program != id))
+        {
+            issue([&] { GL_CALL(glUseProgram(id)); });
+            program = id;
+        }
+    }
+
+    /**
+     * Programs are left bound after a draw while tracking, so that the next draw with the same program
+     * does not have to bind it again.
+     */
+    void release_program()
+    {
+        if (!active)
+        {
+            issue([&] { GL_CALL(glUseProgram(0)); });
+        }
+    }
+
+    void bind_texture(GLenum target, GLuint id)
+    {
+        if (!active || (texture_unit != GL_TEXTURE0))
+        {
+            issue([&] { GL_CALL(glActiveTexture(GL_TEXTURE0)); });
+            texture_unit = GL_TEXTURE0;
+        }
+
+        if (!active || (texture != std::make_pair(target, id)))
+        {
+            issue([&] { GL_CALL(glBindTexture(target, id)); });
+            texture = std::make_pair(target, id);
+        }
+    }
+
+    /** Enable blending with premultiplied alpha, as used by all rendering helpers. */
+    void enable_blend()
+    {
+        if (!active || (blend != true))
+        {
+            issue([&]
+            {
+                GL_CALL(glEnable(GL_BLEND));
+                GL_CALL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
+            });
+            blend = true;
+        }
+    }
+
+    void set_scissor(bool enabled)
+    {
+        if (!active || (scissor != enabled))
+        {
+            issue([&]
+            {
+                if (enabled)
+                {
+                    GL_CALL(glEnable(GL_SCISSOR_TEST));
+                } else
+                {
+                    GL_CALL(glDisable(GL_SCISSOR_TEST));
+                }
+            });
+            scissor = enabled;
+        }
+    }
+
+  private:
+    bool active = false;
+    std::optional<GLuint> program;
+    std::optional<GLenum> texture_unit;
+    std::optional<std::pair<GLenum, GLuint>> texture;
+    std::optional<bool> blend;
+    std::optional<bool> scissor;
+
+    template<class F>
+    void issue(F&& calls)
+    {
+        internal_call = true;
+        calls();
+        internal_call = false;
+    }
+};
+
+gl_state_tracker_t gl_state;
+}
+
 void gl_call(const char *func, uint32_t line, const char *glfunc)
 {
+    if (std::strncmp(glfunc, "glDraw", 6) == 0)
+    {
+        ++draw_call_count;
+    }
+
+    if (!gl_state.internal_call)
+    {
+        gl_state.note_external_call(glfunc);
+    }
+
     GLenum err;
     if (disable_gl_call || ((err = glGetError()) == GL_NO_ERROR))
     {
@@ -78,12 +245,179 @@ GLuint compile_shader(std::string source, GLuint type)
     return shader;
 }
 
+namespace
+{
+/**
+ * An on-disk cache of linked programs, keyed by the shader sources and the GL driver.
+ *
+ * Programs are stored in $XDG_CACHE_HOME/wayfire/shaders, one file per program, containing the binary format
+ * followed by the binary returned by glGetProgramBinary. A missing, stale or rejected entry simply causes the
+ * program to be compiled again.
+ */
+class program_cache_t
+{
+  public:
+    bool enabled()
+    {
+        static wf::option_wrapper_t<bool> shader_cache{"workarounds/shader_cache"};
+        if (!shader_cache || getenv("WAYFIRE_DISABLE_SHADER_CACHE"))
+        {
+            return false;
+        }
+
+        if (num_formats < 0)
+        {
+            GL_CALL(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats));
+        }
+
+        return num_formats > 0;
+    }
+
+    std::filesystem::path get_path(const std::string& vertex_source, const std::string& frag_source)
+    {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        auto hash_string = [&] (const char *str)
+        {
+            /* Include the terminating zero, so that the boundaries between strings matter */
+            for (const char *c = str ?: ""; ; c++)
+            {
+                hash = (hash ^ (uint8_t)*c) * 0x100000001b3ull;
+                if (*c == '\0')
+                {
+                    break;
+                }
+            }
+        };
+
+        const char *vendor   = (const char*)GL_CALL(glGetString(GL_VENDOR));
+        const char *renderer = (const char*)GL_CALL(glGetString(GL_RENDERER));
+        const char *version  = (const char*)GL_CALL(glGetString(GL_VERSION));
+        hash_string(vendor);
+        hash_string(renderer);
+        hash_string(version);
+        hash_string(vertex_source.c_str());
+        hash_string(frag_source.c_str());
+
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)hash);
+        return get_directory() / name;
+    }
+
+    /** Create a program from the cached binary, or return 0 if there is no usable entry. */
+    GLuint load(const std::filesystem::path& path)
+    {
+        std::ifstream file{path, std::ios::binary};
+        GLenum format;
+        if (!file.read((char*)&format, sizeof(format)))
+        {
+            return 0;
+        }
+
+        std::vector<char> binary{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+        if (binary.empty())
+        {
+            return 0;
+        }
+
+        GLuint result_program = GL_CALL(glCreateProgram());
+        /* The driver may reject binaries from an older version with an error, which is not a problem. */
+        glProgramBinary(result_program, format, binary.data(), binary.size());
+        glGetError();
+        int s = GL_FALSE;
+        GL_CALL(glGetProgramiv(result_program, GL_LINK_STATUS, &s));
+
+        if (s == GL_FALSE)
+        {
+            LOGD("Discarding stale program binary ", path);
+            GL_CALL(glDeleteProgram(result_program));
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+            return 0;
+        }
+
+        return result_program;
+    }
+
+    void store(const std::filesystem::path& path, GLuint program)
+    {
+        int length = 0;
+        GL_CALL(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length));
+        if (length <= 0)
+        {
+            return;
+        }
+
+        std::vector<char> binary(length);
+        GLenum format;
+        GL_CALL(glGetProgramBinary(program, length, &length, &format, binary.data()));
+
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+        if (ec)
+        {
+            LOGW("Failed to create shader cache directory ", path.parent_path(), ": ", ec.message());
+            return;
+        }
+
+        /* Write to a temporary file first, so that concurrent instances never see partial entries. */
+        auto tmp_path = path;
+        tmp_path += "." + std::to_string(getpid()) + ".tmp";
+        {
+            std::ofstream file{tmp_path, std::ios::binary | std::ios::trunc};
+            file.write((const char*)&format, sizeof(format));
+            file.write(binary.data(), length);
+            if (!file)
+            {
+                file.close();
+                std::filesystem::remove(tmp_path, ec);
+                return;
+            }
+        }
+
+        std::filesystem::rename(tmp_path, path, ec);
+        if (ec)
+        {
+            std::filesystem::remove(tmp_path, ec);
+        }
+    }
+
+  private:
+    GLint num_formats = -1;
+
+    std::filesystem::path get_directory()
+    {
+        const char *cache_home = getenv("XDG_CACHE_HOME");
+        std::filesystem::path base = (cache_home && *cache_home) ? std::filesystem::path(cache_home) :
+            std::filesystem::path(getenv("HOME") ?: "/tmp") / ".cache";
+        return base / "wayfire" / "shaders";
+    }
+};
+
+program_cache_t program_cache;
+}
+
 /* Create a very simple gl program from the given shader sources */
 GLuint compile_program(std::string vertex_source, std::string frag_source)
 {
+    const bool use_cache = program_cache.enabled();
+    std::filesystem::path cache_path;
+    if (use_cache)
+    {
+        cache_path = program_cache.get_path(vertex_source, frag_source);
+        if (GLuint cached = program_cache.load(cache_path))
+        {
+            return cached;
+        }
+    }
+
     auto vertex_shader   = compile_shader(vertex_source, GL_VERTEX_SHADER);
     auto fragment_shader = compile_shader(frag_source, GL_FRAGMENT_SHADER);
     auto result_program  = GL_CALL(glCreateProgram());
+    if (use_cache)
+    {
+        GL_CALL(glProgramParameteri(result_program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+    }
+
     GL_CALL(glAttachShader(result_program, vertex_shader));
     GL_CALL(glAttachShader(result_program, fragment_shader));
     GL_CALL(glLinkProgram(result_program));
@@ -106,7 +440,17 @@ GLuint compile_program(std::string vertex_source, std::string frag_source)
     /* won't be really deleted until program is deleted as well */
     GL_CALL(glDeleteShader(vertex_shader));
     GL_CALL(glDeleteShader(fragment_shader));
-    return (s == GL_FALSE) ? 0 : result_program;
+    if (s == GL_FALSE)
+    {
+        return 0;
+    }
+
+    if (use_cache)
+    {
+        program_cache.store(cache_path, result_program);
+    }
+
+    return result_program;
 }
 
 void init()
@@ -122,11 +466,14 @@ void init()
     render_end();
 }
 
+void clear_framebuffer_pool();
+
 void fini()
 {
     render_begin();
     program.free_resources();
     color_program.free_resources();
+    clear_framebuffer_pool();
     render_end();
 }
 
@@ -136,37 +483,35 @@ wf::output_t *current_output = NULL;
 uint32_t current_output_fb   = 0;
 }
 
+uint64_t get_draw_call_count()
+{
+    return draw_call_count;
+}
+
 void bind_output(wf::output_t *output, uint32_t fb)
 {
     current_output    = output;
     current_output_fb = fb;
+    gl_state.set_active(true);
 }
 
 void unbind_output(wf::output_t *output)
 {
     current_output    = NULL;
     current_output_fb = 0;
+    gl_state.set_active(false);
+}
+
+void invalidate_state()
+{
+    gl_state.invalidate();
 }
 
 std::vector<GLfloat> vertexData;
 std::vector<GLfloat> coordData;
 
-void render_transformed_texture(wf::texture_t tex,
-    const gl_geometry& g, const gl_geometry& texg,
-    glm::mat4 model, glm::vec4 color, uint32_t bits)
+static gl_geometry get_final_texg(const gl_geometry& texg, uint32_t bits)
 {
-    // We don't expect any errors from us!
-    disable_gl_call = true;
-
-    program.use(tex.type);
-
-    vertexData = {
-        g.x1, g.y2,
-        g.x2, g.y2,
-        g.x2, g.y1,
-        g.x1, g.y1,
-    };
-
     gl_geometry final_texg = (bits & TEXTURE_USE_TEX_GEOMETRY) ?
         texg : gl_geometry{0.0f, 0.0f, 1.0f, 1.0f};
 
@@ -182,6 +527,26 @@ void render_transformed_texture(wf::texture_t tex,
         final_texg.x2 = 1.0 - final_texg.x2;
     }
 
+    return final_texg;
+}
+
+void render_transformed_texture(wf::texture_t tex,
+    const gl_geometry& g, const gl_geometry& texg,
+    glm::mat4 model, glm::vec4 color, uint32_t bits)
+{
+    // We don't expect any errors from us!
+    disable_gl_call = true;
+
+    program.use(tex.type);
+
+    vertexData = {
+        g.x1, g.y2,
+        g.x2, g.y2,
+        g.x2, g.y1,
+        g.x1, g.y1,
+    };
+
+    gl_geometry final_texg = get_final_texg(texg, bits);
     coordData = {
         final_texg.x1, final_texg.y1,
         final_texg.x2, final_texg.y1,
@@ -195,8 +560,7 @@ void render_transformed_texture(wf::texture_t tex,
     program.uniformMatrix4f("MVP", model);
     program.uniform4f("color", color);
 
-    GL_CALL(glEnable(GL_BLEND));
-    GL_CALL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
+    gl_state.enable_blend();
 
     if (bits & RENDER_FLAG_CACHED)
     {
@@ -240,6 +604,111 @@ void render_texture(wf::texture_t texture,
         framebuffer.get_orthographic_projection(), color, bits);
 }
 
+static bool same_geometry(const gl_geometry& a, const gl_geometry& b)
+{
+    return (a.x1 == b.x1) && (a.y1 == b.y1) && (a.x2 == b.x2) && (a.y2 == b.y2);
+}
+
+static bool same_texture(const wf::texture_t& a, const wf::texture_t& b)
+{
+    return (a.type == b.type) && (a.target == b.target) && (a.tex_id == b.tex_id) &&
+           (a.invert_y == b.invert_y) && (a.has_viewport == b.has_viewport) &&
+           (!a.has_viewport || same_geometry(a.viewport_box, b.viewport_box));
+}
+
+void texture_batch_t::add(const wf::texture_t& texture, const gl_geometry& g,
+    const gl_geometry& texg, const wf::region_t& damage,
+    const glm::mat4& transform, const glm::vec4& color, uint32_t bits)
+{
+    if ((g.x1 == g.x2) || (g.y1 == g.y2))
+    {
+        return;
+    }
+
+    if (!vertices.empty() && (!same_texture(texture, this->texture) ||
+                              (transform != this->transform) || (color != this->color)))
+    {
+        flush();
+    }
+
+    this->texture   = texture;
+    this->transform = transform;
+    this->color     = color;
+
+    // Texture coordinates are interpolated linearly across the quad. Note that
+    // the top edge (g.y1) is mapped to final_texg.y2, as in render_transformed_texture().
+    const gl_geometry final_texg = get_final_texg(texg, bits);
+    auto push_vertex = [&] (float x, float y)
+    {
+        vertices.push_back(x);
+        vertices.push_back(y);
+        uv_coords.push_back(final_texg.x1 +
+            (x - g.x1) / (g.x2 - g.x1) * (final_texg.x2 - final_texg.x1));
+        uv_coords.push_back(final_texg.y1 +
+            (y - g.y2) / (g.y1 - g.y2) * (final_texg.y2 - final_texg.y1));
+    };
+
+    const float min_x = std::min(g.x1, g.x2);
+    const float max_x = std::max(g.x1, g.x2);
+    const float min_y = std::min(g.y1, g.y2);
+    const float max_y = std::max(g.y1, g.y2);
+    for (const auto& box : damage)
+    {
+        const float x1 = std::max(min_x, (float)box.x1);
+        const float x2 = std::min(max_x, (float)box.x2);
+        const float y1 = std::max(min_y, (float)box.y1);
+        const float y2 = std::min(max_y, (float)box.y2);
+        if ((x1 >= x2) || (y1 >= y2))
+        {
+            continue;
+        }
+
+        push_vertex(x1, y2);
+        push_vertex(x2, y2);
+        push_vertex(x2, y1);
+
+        push_vertex(x2, y1);
+        push_vertex(x1, y1);
+        push_vertex(x1, y2);
+    }
+}
+
+void texture_batch_t::add(const wf::texture_t& texture,
+    const wf::geometry_t& geometry, const wf::region_t& damage,
+    const glm::mat4& transform, const glm::vec4& color, uint32_t bits)
+{
+    bits &= ~TEXTURE_USE_TEX_GEOMETRY;
+
+    gl_geometry gg;
+    gg.x1 = geometry.x;
+    gg.y1 = geometry.y;
+    gg.x2 = gg.x1 + geometry.width;
+    gg.y2 = gg.y1 + geometry.height;
+    add(texture, gg, {}, damage, transform, color, bits);
+}
+
+void texture_batch_t::flush()
+{
+    if (vertices.empty())
+    {
+        return;
+    }
+
+    program.use(texture.type);
+    program.set_active_texture(texture);
+    program.attrib_pointer("position", 2, 0, vertices.data());
+    program.attrib_pointer("uvPosition", 2, 0, uv_coords.data());
+    program.uniformMatrix4f("MVP", transform);
+    program.uniform4f("color", color);
+
+    gl_state.enable_blend();
+    GL_CALL(glDrawArrays(GL_TRIANGLES, 0, vertices.size() / 2));
+    program.deactivate();
+
+    vertices.clear();
+    uv_coords.clear();
+}
+
 void render_rectangle(wf::geometry_t geometry, wf::color_t color,
     glm::mat4 matrix)
 {
@@ -258,8 +727,7 @@ void render_rectangle(wf::geometry_t geometry, wf::color_t color,
     color_program.uniformMatrix4f("MVP", matrix);
     color_program.uniform4f("color", {color.r, color.g, color.b, color.a});
 
-    GL_CALL(glEnable(GL_BLEND));
-    GL_CALL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
+    gl_state.enable_blend();
     GL_CALL(glDrawArrays(GL_TRIANGLE_FAN, 0, 4));
 
     color_program.deactivate();
@@ -287,10 +755,10 @@ void render_begin()
     if (!egl_is_current(wf::get_core_impl().egl))
     {
         egl_make_current(wf::get_core_impl().egl);
+        gl_state.invalidate();
     }
 
-    GL_CALL(glEnable(GL_BLEND));
-    GL_CALL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
+    gl_state.enable_blend();
 }
 
 void render_begin(const wf::framebuffer_t& fb)
@@ -316,7 +784,7 @@ void clear(wf::color_t col, uint32_t mask)
 void render_end()
 {
     GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, current_output_fb));
-    GL_CALL(glDisable(GL_SCISSOR_TEST));
+    gl_state.set_scissor(false);
 }
 }
 
@@ -342,20 +810,26 @@ static std::string framebuffer_status_to_str(
     }
 }
 
-bool wf::framebuffer_t::allocate(int width, int height)
+namespace
+{
+/**
+ * Same as framebuffer_t::allocate(), the memory is attributed to the plugin which contains the @owner code
+ * address, see wf::gpu_memory::set().
+ */
+bool allocate_framebuffer(wf::framebuffer_t& buffer, int width, int height, const void *owner)
 {
     bool first_allocate = false;
-    if (fb == (uint32_t)-1)
+    if (buffer.fb == (uint32_t)-1)
     {
         first_allocate = true;
-        GL_CALL(glGenFramebuffers(1, &fb));
+        GL_CALL(glGenFramebuffers(1, &buffer.fb));
     }
 
-    if (tex == (uint32_t)-1)
+    if (buffer.tex == (uint32_t)-1)
     {
         first_allocate = true;
-        GL_CALL(glGenTextures(1, &tex));
-        GL_CALL(glBindTexture(GL_TEXTURE_2D, tex));
+        GL_CALL(glGenTextures(1, &buffer.tex));
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, buffer.tex));
         GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
         GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
         GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
@@ -365,24 +839,26 @@ bool wf::framebuffer_t::allocate(int width, int height)
     bool is_resize = false;
     /* Special case: fb = 0. This occurs in the default workspace streams, we don't
      * resize anything */
-    if (fb != OpenGL::current_output_fb)
+    if (buffer.fb != OpenGL::current_output_fb)
     {
-        if (first_allocate || (width != viewport_width) ||
-            (height != viewport_height))
+        if (first_allocate || (width != buffer.viewport_width) ||
+            (height != buffer.viewport_height))
         {
             is_resize = true;
-            GL_CALL(glBindTexture(GL_TEXTURE_2D, tex));
+            GL_CALL(glBindTexture(GL_TEXTURE_2D, buffer.tex));
             GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height,
                 0, GL_RGBA, GL_UNSIGNED_BYTE, 0));
+            wf::gpu_memory::set(buffer.tex, wf::gpu_memory::TYPE_FRAMEBUFFER,
+                int64_t(width) * height * 4, owner);
         }
     }
 
     if (first_allocate)
     {
-        GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, fb));
-        GL_CALL(glBindTexture(GL_TEXTURE_2D, tex));
+        GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, buffer.fb));
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, buffer.tex));
         GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-            GL_TEXTURE_2D, tex, 0));
+            GL_TEXTURE_2D, buffer.tex, 0));
 
         auto status = GL_CALL(glCheckFramebufferStatus(GL_FRAMEBUFFER));
         if (status != GL_FRAMEBUFFER_COMPLETE)
@@ -394,14 +870,409 @@ bool wf::framebuffer_t::allocate(int width, int height)
         }
     }
 
-    viewport_width  = width;
-    viewport_height = height;
+    buffer.viewport_width  = width;
+    buffer.viewport_height = height;
 
     GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
     GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, OpenGL::current_output_fb));
 
     return is_resize || first_allocate;
 }
+}
+
+bool wf::framebuffer_t::allocate(int width, int height)
+{
+    return allocate_framebuffer(*this, width, height, __builtin_return_address(0));
+}
+
+namespace
+{
+/**
+ * Depth buffers attached to framebuffers, see OpenGL::attach_depth_buffer().
+ *
+ * All framebuffers with the same size share one depth buffer, and buffers which are not attached anymore are
+ * kept for a while, so that switching resolutions or outputs does not allocate new ones every time.
+ */
+struct depth_buffer_pool_t
+{
+    struct entry_t
+    {
+        GLuint tex;
+        int width, height;
+        std::vector<GLuint> users;
+        uint64_t last_used;
+    };
+
+    std::vector<entry_t> buffers;
+    uint64_t use_counter = 0;
+
+    static int64_t get_size(int width, int height)
+    {
+        return int64_t(width) * height * 4;
+    }
+
+    entry_t *find_user(GLuint fb)
+    {
+        for (auto& entry : buffers)
+        {
+            if (std::find(entry.users.begin(), entry.users.end(), fb) != entry.users.end())
+            {
+                return &entry;
+            }
+        }
+
+        return nullptr;
+    }
+
+    void attach(GLuint fb, int width, int height, OpenGL::framebuffer_pool_stats_t& stats)
+    {
+        // The framebuffers of outputs are deleted by wlroots, and their names may be reused for new ones, so
+        // check that the depth buffer is still attached.
+        auto current = find_user(fb);
+        GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, fb));
+        if (current && (current->width == width) && (current->height == height))
+        {
+            GLint attached = 0;
+            GL_CALL(glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &attached));
+            if ((GLuint)attached == current->tex)
+            {
+                current->last_used = ++use_counter;
+                return;
+            }
+        }
+
+        forget(fb);
+        auto entry = std::find_if(buffers.begin(), buffers.end(), [&] (const entry_t& e)
+        {
+            return (e.width == width) && (e.height == height);
+        });
+
+        if (entry == buffers.end())
+        {
+            GLuint tex;
+            GL_CALL(glGenTextures(1, &tex));
+            GL_CALL(glBindTexture(GL_TEXTURE_2D, tex));
+            GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT,
+                width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL));
+            GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+            buffers.push_back({tex, width, height, {}, 0});
+            entry = buffers.end() - 1;
+            wf::gpu_memory::set(tex, wf::gpu_memory::TYPE_DEPTH, get_size(width, height), nullptr);
+
+            ++stats.depth_buffers;
+            stats.depth_bytes += get_size(width, height);
+        }
+
+        entry->users.push_back(fb);
+        entry->last_used = ++use_counter;
+        GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, fb));
+        GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, entry->tex, 0));
+        trim(stats);
+    }
+
+    /** Stop tracking the framebuffer, for example because it is deleted. */
+    void forget(GLuint fb)
+    {
+        if (auto entry = find_user(fb))
+        {
+            entry->users.erase(std::find(entry->users.begin(), entry->users.end(), fb));
+        }
+    }
+
+    /** Free the least recently used depth buffers which are not attached anymore. */
+    void trim(OpenGL::framebuffer_pool_stats_t& stats)
+    {
+        auto is_idle = [] (const entry_t& e) { return e.users.empty(); };
+        while (true)
+        {
+            int64_t idle_bytes = 0;
+            auto lru = buffers.end();
+            for (auto it = buffers.begin(); it != buffers.end(); ++it)
+            {
+                if (is_idle(*it))
+                {
+                    idle_bytes += get_size(it->width, it->height);
+                    lru = ((lru == buffers.end()) || (it->last_used < lru->last_used)) ? it : lru;
+                }
+            }
+
+            if ((lru == buffers.end()) || (idle_bytes <= stats.max_free_bytes))
+            {
+                return;
+            }
+
+            destroy(*lru, stats);
+            buffers.erase(lru);
+        }
+    }
+
+    /** Free all depth buffers which are not attached anymore. */
+    void release_idle(OpenGL::framebuffer_pool_stats_t& stats)
+    {
+        for (auto it = buffers.begin(); it != buffers.end();)
+        {
+            if (it->users.empty())
+            {
+                destroy(*it, stats);
+                it = buffers.erase(it);
+            } else
+            {
+                ++it;
+            }
+        }
+    }
+
+    void destroy(const entry_t& entry, OpenGL::framebuffer_pool_stats_t& stats)
+    {
+        wf::gpu_memory::set(entry.tex, wf::gpu_memory::TYPE_DEPTH, 0, nullptr);
+        GL_CALL(glDeleteTextures(1, &entry.tex));
+        --stats.depth_buffers;
+        stats.depth_bytes -= get_size(entry.width, entry.height);
+    }
+
+    void clear(OpenGL::framebuffer_pool_stats_t& stats)
+    {
+        for (auto& entry : buffers)
+        {
+            destroy(entry, stats);
+        }
+
+        buffers.clear();
+    }
+};
+
+depth_buffer_pool_t depth_buffer_pool;
+
+/**
+ * Idle framebuffers which can be reused by framebuffer_t::allocate_from_pool().
+ *
+ * Buffers are only reused for the exact same size: callers sample the whole
+ * texture, so handing out a bigger texture would break them.
+ */
+struct framebuffer_pool_t
+{
+    struct entry_t
+    {
+        GLuint fb, tex;
+        int width, height;
+        uint64_t last_used;
+    };
+
+    std::vector<entry_t> free;
+    OpenGL::framebuffer_pool_stats_t stats;
+    uint64_t use_counter = 0;
+
+    static int64_t get_size(int width, int height)
+    {
+        return int64_t(width) * height * 4;
+    }
+
+    /* Take a framebuffer with the given size from the pool, the most recently used one first */
+    bool take(wf::framebuffer_t& buffer, int width, int height, const void *owner)
+    {
+        auto best = free.end();
+        for (auto it = free.begin(); it != free.end(); ++it)
+        {
+            if ((it->width == width) && (it->height == height) &&
+                ((best == free.end()) || (it->last_used > best->last_used)))
+            {
+                best = it;
+            }
+        }
+
+        if (best == free.end())
+        {
+            ++stats.misses;
+            return false;
+        }
+
+        buffer.fb  = best->fb;
+        buffer.tex = best->tex;
+        buffer.viewport_width  = width;
+        buffer.viewport_height = height;
+        free.erase(best);
+        wf::gpu_memory::set(buffer.tex, wf::gpu_memory::TYPE_FRAMEBUFFER, get_size(width, height), owner);
+
+        ++stats.hits;
+        --stats.free_buffers;
+        stats.free_bytes -= get_size(width, height);
+        return true;
+    }
+
+    void put(const wf::framebuffer_t& buffer)
+    {
+        free.push_back({buffer.fb, buffer.tex, buffer.viewport_width, buffer.viewport_height, ++use_counter});
+        {
+            // Idle buffers do not belong to anyone
+            wf::gpu_memory::node_scope_t no_node{nullptr};
+            wf::gpu_memory::set(buffer.tex, wf::gpu_memory::TYPE_POOL,
+                get_size(buffer.viewport_width, buffer.viewport_height), nullptr);
+        }
+
+        ++stats.free_buffers;
+        stats.free_bytes += get_size(buffer.viewport_width, buffer.viewport_height);
+        trim();
+    }
+
+    /**
+     * Update the memory which idle buffers may use: the size of the pool, but less when the rest of the GPU
+     * memory is close to the soft cap.
+     *
+     * @return Whether the soft cap reduces the limit.
+     */
+    bool update_limit()
+    {
+        static wf::option_wrapper_t<int> pool_size{"workarounds/framebuffer_pool_size"};
+        stats.max_free_bytes = int64_t(std::max(0, (int)pool_size)) * 1024 * 1024;
+
+        const int64_t soft_cap = wf::gpu_memory::get_soft_cap();
+        if (soft_cap <= 0)
+        {
+            return false;
+        }
+
+        const int64_t idle  = wf::gpu_memory::get_total(wf::gpu_memory::TYPE_POOL);
+        const int64_t limit = std::max<int64_t>(0, soft_cap - (wf::gpu_memory::get_total() - idle));
+        if (limit >= stats.max_free_bytes)
+        {
+            return false;
+        }
+
+        stats.max_free_bytes = limit;
+        return true;
+    }
+
+    void trim()
+    {
+        const bool capped = update_limit();
+        while (stats.free_bytes > stats.max_free_bytes)
+        {
+            auto lru = std::min_element(free.begin(), free.end(), [] (const entry_t& a, const entry_t& b)
+            {
+                return a.last_used < b.last_used;
+            });
+
+            destroy(*lru);
+            free.erase(lru);
+            ++stats.evictions;
+            stats.soft_cap_evictions += capped;
+        }
+    }
+
+    void destroy(const entry_t& entry)
+    {
+        depth_buffer_pool.forget(entry.fb);
+        wf::gpu_memory::set(entry.tex, wf::gpu_memory::TYPE_POOL, 0, nullptr);
+        GL_CALL(glDeleteFramebuffers(1, &entry.fb));
+        GL_CALL(glDeleteTextures(1, &entry.tex));
+        --stats.free_buffers;
+        stats.free_bytes -= get_size(entry.width, entry.height);
+    }
+
+    void clear()
+    {
+        for (auto& entry : free)
+        {
+            destroy(entry);
+        }
+
+        free.clear();
+    }
+};
+
+framebuffer_pool_t framebuffer_pool;
+}
+
+OpenGL::framebuffer_pool_stats_t OpenGL::get_framebuffer_pool_stats()
+{
+    return framebuffer_pool.stats;
+}
+
+void OpenGL::clear_framebuffer_pool()
+{
+    framebuffer_pool.clear();
+    depth_buffer_pool.clear(framebuffer_pool.stats);
+}
+
+void OpenGL::release_idle_framebuffers()
+{
+    framebuffer_pool.clear();
+    depth_buffer_pool.release_idle(framebuffer_pool.stats);
+}
+
+void OpenGL::attach_depth_buffer(GLuint fb, int width, int height)
+{
+    framebuffer_pool.update_limit();
+    depth_buffer_pool.attach(fb, width, height, framebuffer_pool.stats);
+    GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, OpenGL::current_output_fb));
+}
+
+void OpenGL::detach_depth_buffer(GLuint fb)
+{
+    if (!depth_buffer_pool.find_user(fb))
+    {
+        return;
+    }
+
+    depth_buffer_pool.forget(fb);
+    GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, fb));
+    GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, 0, 0));
+    GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, OpenGL::current_output_fb));
+    depth_buffer_pool.trim(framebuffer_pool.stats);
+}
+
+bool wf::framebuffer_t::allocate_from_pool(int width, int height)
+{
+    const void *owner = __builtin_return_address(0);
+    const bool has_buffers = (fb != (uint32_t)-1) && (tex != (uint32_t)-1);
+    if ((tex == 0) || (fb == OpenGL::current_output_fb) ||
+        (has_buffers && (width == viewport_width) && (height == viewport_height)))
+    {
+        return allocate_framebuffer(*this, width, height, owner);
+    }
+
+    auto& stats = framebuffer_pool.stats;
+    wf::framebuffer_t pooled;
+    if (framebuffer_pool.take(pooled, width, height, owner))
+    {
+        release_to_pool();
+        *this = pooled;
+        ++stats.used_buffers;
+        stats.used_bytes += framebuffer_pool_t::get_size(width, height);
+        return true;
+    }
+
+    // No buffer of the right size, resize our own buffer (if we have one) in place.
+    if (has_buffers)
+    {
+        stats.used_bytes -= framebuffer_pool_t::get_size(viewport_width, viewport_height);
+    } else
+    {
+        ++stats.used_buffers;
+    }
+
+    stats.used_bytes += framebuffer_pool_t::get_size(width, height);
+    const bool result = allocate_framebuffer(*this, width, height, owner);
+    // New memory, the idle buffers may now be above the soft cap
+    framebuffer_pool.trim();
+    return result;
+}
+
+void wf::framebuffer_t::release_to_pool()
+{
+    if ((fb == (uint32_t)-1) || (tex == (uint32_t)-1) || (fb == 0) || (tex == 0))
+    {
+        release();
+        return;
+    }
+
+    auto& stats = framebuffer_pool.stats;
+    --stats.used_buffers;
+    stats.used_bytes -= framebuffer_pool_t::get_size(viewport_width, viewport_height);
+    framebuffer_pool.put(*this);
+    reset();
+}
 
 void wf::framebuffer_t::bind() const
 {
@@ -411,7 +1282,7 @@ void wf::framebuffer_t::bind() const
 
 void wf::framebuffer_t::scissor(wlr_box box) const
 {
-    GL_CALL(glEnable(GL_SCISSOR_TEST));
+    gl_state.set_scissor(true);
     GL_CALL(glScissor(box.x, viewport_height - box.y - box.height,
         box.width, box.height));
 }
@@ -420,11 +1291,13 @@ void wf::framebuffer_t::release()
 {
     if ((fb != uint32_t(-1)) && (fb != 0))
     {
+        depth_buffer_pool.forget(fb);
         GL_CALL(glDeleteFramebuffers(1, &fb));
     }
 
     if ((tex != uint32_t(-1)) && ((fb != 0) || (tex != 0)))
     {
+        wf::gpu_memory::set(tex, wf::gpu_memory::TYPE_FRAMEBUFFER, 0, nullptr);
         GL_CALL(glDeleteTextures(1, &tex));
     }
 
@@ -438,56 +1311,94 @@ void wf::framebuffer_t::reset()
     viewport_width = viewport_height = 0;
 }
 
-wlr_box wf::render_target_t::framebuffer_box_from_geometry_box(wlr_box box) const
+namespace
+{
+/**
+ * The parts of the geometry -> framebuffer projection which do not depend on the box being projected, so
+ * that they are computed once when projecting a whole region.
+ */
+struct box_projection_t
 {
-    /* Step 1: Make relative to the framebuffer */
-    box.x -= this->geometry.x;
-    box.y -= this->geometry.y;
+    wf::point_t origin;
+    double scale;
+    wl_output_transform transform;
+    int width;
+    int height;
+    std::optional<wf::geometry_t> subbuffer;
+    wf::geometry_t viewport;
+
+    box_projection_t(const wf::render_target_t& target)
+    {
+        origin    = {target.geometry.x, target.geometry.y};
+        scale     = target.scale;
+        transform = wlr_output_transform_invert((wl_output_transform)target.wl_transform);
+        width     = target.viewport_width;
+        height    = target.viewport_height;
+        if (target.wl_transform & 1)
+        {
+            std::swap(width, height);
+        }
 
-    /* Step 2: Apply scale to box */
-    wlr_box scaled = box * scale;
+        subbuffer = target.subbuffer;
+        viewport  = {0, 0, target.viewport_width, target.viewport_height};
+    }
 
-    /* Step 3: rotate */
-    int width = viewport_width, height = viewport_height;
-    if (wl_transform & 1)
+    wlr_box project(wlr_box box) const
     {
-        std::swap(width, height);
-    }
+        /* Step 1: Make relative to the framebuffer */
+        box.x -= origin.x;
+        box.y -= origin.y;
 
-    wlr_box result;
-    wl_output_transform transform =
-        wlr_output_transform_invert((wl_output_transform)wl_transform);
+        /* Step 2: Apply scale to box */
+        wlr_box scaled = box * scale;
 
-    wlr_box_transform(&result, &scaled, transform, width, height);
+        /* Step 3: rotate */
+        wlr_box result;
+        wlr_box_transform(&result, &scaled, transform, width, height);
 
-    if (subbuffer)
-    {
-        result = scale_box({0, 0, viewport_width, viewport_height},
-            subbuffer.value(), result);
+        if (subbuffer)
+        {
+            result = scale_box(viewport, subbuffer.value(), result);
+        }
+
+        return result;
     }
+};
+}
 
-    return result;
+wlr_box wf::render_target_t::framebuffer_box_from_geometry_box(wlr_box box) const
+{
+    return box_projection_t{*this}.project(box);
 }
 
 wf::region_t wf::render_target_t::framebuffer_region_from_geometry_region(const wf::region_t& region) const
 {
-    wf::region_t result;
+    box_projection_t projection{*this};
+    wf::region_builder_t builder;
+    builder.reserve(region.end() - region.begin());
     for (const auto& rect : region)
     {
-        result |= framebuffer_box_from_geometry_box(wlr_box_from_pixman_box(rect));
+        builder.add(projection.project(wlr_box_from_pixman_box(rect)));
     }
 
-    return result;
+    return builder.build();
 }
 
 glm::mat4 wf::render_target_t::get_orthographic_projection() const
 {
-    auto ortho = glm::ortho(1.0f * geometry.x,
-        1.0f * geometry.x + 1.0f * geometry.width,
-        1.0f * geometry.y + 1.0f * geometry.height,
-        1.0f * geometry.y);
-
-    return gl_to_framebuffer() * ortho;
+    // glm::ortho() only scales and translates x and y and flips z, so instead of a full matrix product we
+    // can combine the columns of gl_to_framebuffer() directly.
+    const float sx = 2.0f / geometry.width;
+    const float sy = -2.0f / geometry.height;
+    const float tx = -(2.0f * geometry.x + geometry.width) / geometry.width;
+    const float ty = (2.0f * geometry.y + geometry.height) / geometry.height;
+
+    glm::mat4 result = gl_to_framebuffer();
+    result[3] += result[0] * tx + result[1] * ty;
+    result[0] *= sx;
+    result[1] *= sy;
+    result[2] = -result[2];
+    return result;
 }
 
 glm::mat4 wf::render_target_t::gl_to_framebuffer() const
@@ -705,11 +1616,107 @@ std::map<wf::texture_type_t, texture_type_builtins> builtins = {
             builtin_ext_external_source}},
 };
 
+/** Add a `#define` line for each of @defines after the version declaration of @source. */
+static std::string add_defines(const std::string& source, const std::vector<std::string>& defines)
+{
+    if (defines.empty())
+    {
+        return source;
+    }
+
+    std::string lines;
+    for (const auto& define : defines)
+    {
+        lines += "#define " + define + "\n";
+    }
+
+    size_t pos = source.find("#version");
+    if (pos == std::string::npos)
+    {
+        return lines + source;
+    }
+
+    pos = source.find('\n', pos);
+    if (pos == std::string::npos)
+    {
+        return source + "\n" + lines;
+    }
+
+    return source.substr(0, pos + 1) + lines + source.substr(pos + 1);
+}
+
+namespace
+{
+/**
+ * The programs compiled by program_t::compile() and program_t::compile_simple(). Programs with the same
+ * sources are compiled only once and shared by all program_t which use them.
+ */
+class shared_programs_t
+{
+  public:
+    GLuint acquire(const std::string& vertex_source, const std::string& fragment_source)
+    {
+        std::string key = vertex_source;
+        key += '\0';
+        key += fragment_source;
+
+        auto it = programs.find(key);
+        if (it != programs.end())
+        {
+            it->second.refs++;
+            return it->second.id;
+        }
+
+        GLuint id = compile_program(vertex_source, fragment_source);
+        if (id)
+        {
+            programs[key] = {id, 1};
+            keys[id] = std::move(key);
+        }
+
+        return id;
+    }
+
+    /** @return Whether @id is a shared program. It is deleted if this was its last user. */
+    bool release(GLuint id)
+    {
+        auto it = keys.find(id);
+        if (it == keys.end())
+        {
+            return false;
+        }
+
+        auto entry = programs.find(it->second);
+        if (--entry->second.refs == 0)
+        {
+            GL_CALL(glDeleteProgram(id));
+            programs.erase(entry);
+            keys.erase(it);
+        }
+
+        return true;
+    }
+
+  private:
+    struct entry_t
+    {
+        GLuint id;
+        int refs;
+    };
+
+    std::unordered_map<std::string, entry_t> programs;
+    std::unordered_map<GLuint, std::string> keys;
+};
+
+shared_programs_t shared_programs;
+}
+
 void program_t::compile(const std::string& vertex_source,
-    const std::string& fragment_source)
+    const std::string& fragment_source, const std::vector<std::string>& defines)
 {
     free_resources();
 
+    const auto vertex = add_defines(vertex_source, defines);
     for (const auto& program_type : builtins)
     {
         auto fragment = replace_builtin_with(fragment_source,
@@ -717,19 +1724,36 @@ void program_t::compile(const std::string& vertex_source,
         fragment = replace_builtin_with(fragment,
             builtin_ext, program_type.second.builtin_ext);
         this->priv->id[program_type.first] =
-            compile_program(vertex_source, fragment);
+            shared_programs.acquire(vertex, add_defines(fragment, defines));
     }
 }
 
+void program_t::compile_simple(const std::string& vertex_source, const std::string& fragment_source,
+    wf::texture_type_t type, const std::vector<std::string>& defines)
+{
+    free_resources();
+    assert(type < wf::TEXTURE_TYPE_ALL);
+    this->priv->id[type] = shared_programs.acquire(add_defines(vertex_source, defines),
+        add_defines(fragment_source, defines));
+}
+
 void program_t::free_resources()
 {
     for (int i = 0; i < wf::TEXTURE_TYPE_ALL; i++)
     {
         if (this->priv->id[i])
         {
-            GL_CALL(glDeleteProgram(priv->id[i]));
+            if (!shared_programs.release(priv->id[i]))
+            {
+                GL_CALL(glDeleteProgram(priv->id[i]));
+            }
+
             this->priv->id[i] = 0;
         }
+
+        /* Locations are only valid for the program they were queried from */
+        this->priv->uniforms[i].clear();
+        this->priv->attribs[i].clear();
     }
 }
 
@@ -741,7 +1765,7 @@ void program_t::use(wf::texture_type_t type)
             std::to_string(type));
     }
 
-    GL_CALL(glUseProgram(priv->id[type]));
+    gl_state.use_program(priv->id[type]);
     priv->active_program_idx = type;
 }
 
@@ -805,9 +1829,9 @@ void program_t::attrib_divisor(const std::string& attrib, int divisor)
 
 void program_t::set_active_texture(const wf::texture_t& texture)
 {
-    GL_CALL(glActiveTexture(GL_TEXTURE0));
-    GL_CALL(glBindTexture(texture.target, texture.tex_id));
-    GL_CALL(glTexParameteri(texture.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    gl_state.bind_texture(texture.target, texture.tex_id);
+    GL_CALL(glTexParameteri(texture.target, GL_TEXTURE_MIN_FILTER,
+        texture.mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR));
 
     glm::vec2 base{0.0f, 0.0f};
     glm::vec2 scale{1.0f, 1.0f};
@@ -844,6 +1868,6 @@ void program_t::deactivate()
 
     priv->active_attrs_divisors.clear();
     priv->active_attrs.clear();
-    GL_CALL(glUseProgram(0));
+    gl_state.release_program();
 }
 }
@@ -6,12 +6,15 @@
 #include "wayfire/render-manager.hpp"
 #include "wayfire/signal-definitions.hpp"
 #include "wayfire/util.hpp"
+#include "wayfire/scene.hpp"
 
 #include "../output/output-impl.hpp"
 #include <xf86drmMode.h>
 #include <cstring>
 #include <climits>
+#include <unordered_map>
 #include <unordered_set>
+#include "startup-profile.hpp"
 #include <drm_fourcc.h>
 #include <wayfire/seat.hpp>
 
@@ -269,6 +272,7 @@ struct output_layout_output_t
     wf::option_wrapper_t<double> scale_opt;
     wf::option_wrapper_t<std::string> transform_opt;
     wf::option_wrapper_t<bool> vrr_opt;
+    wf::option_wrapper_t<std::string> adaptive_sync_opt;
     wf::option_wrapper_t<int> depth_opt;
 
     wf::option_wrapper_t<bool> use_ext_config{
@@ -283,6 +287,7 @@ struct output_layout_output_t
         scale_opt.load_option(name + "/scale");
         transform_opt.load_option(name + "/transform");
         vrr_opt.load_option(name + "/vrr");
+        adaptive_sync_opt.load_option(name + "/adaptive_sync");
         depth_opt.load_option(name + "/depth");
     }
 
@@ -484,7 +489,10 @@ struct output_layout_output_t
 
         state.scale     = scale_opt;
         state.transform = get_transform_from_string(transform_opt);
-        state.vrr   = vrr_opt;
+        // The fullscreen-only policy is applied by the render manager, depending on the output contents.
+        // The older vrr option is equivalent to adaptive_sync = on.
+        const std::string adaptive_sync = adaptive_sync_opt;
+        state.vrr   = (adaptive_sync == "on") || ((adaptive_sync != "fullscreen-only") && vrr_opt);
         state.depth = depth_opt;
         return state;
     }
@@ -688,11 +696,48 @@ struct output_layout_output_t
         wlr_output_commit(handle);
     }
 
+    /**
+     * Show the source buffer on the output directly, without rendering. This works only if the buffer has
+     * the size of the current mode, and the output can scan out its format and modifiers.
+     *
+     * @return Whether the buffer was committed.
+     */
+    bool try_direct_mirror(wlr_buffer *buffer)
+    {
+        if (direct_mirror_failed || (buffer->width != handle->width) || (buffer->height != handle->height))
+        {
+            return false;
+        }
+
+        wlr_output_attach_buffer(handle, buffer);
+        if (wlr_output_test(handle) && wlr_output_commit(handle))
+        {
+            return true;
+        }
+
+        /* Do not test again on every frame, the buffers of the source output
+         * come from the same swapchain and will fail in the same way. */
+        LOGD(handle->name, ": cannot scan out buffers of the mirrored output, falling back to rendering");
+        wlr_output_rollback(handle);
+        direct_mirror_failed = true;
+        return false;
+    }
+
     /* Load output contents and render them */
     wlr_buffer *source_back_buffer = NULL;
+    /** Whether the source output has new contents which were not shown on this output yet */
+    bool source_changed = false;
+    /** Whether direct scanout of the source buffers was already tried and failed */
+    bool direct_mirror_failed = false;
 
     void handle_frame()
     {
+        if (!source_changed)
+        {
+            /* Nothing new to show, keep the last frame on screen */
+            return;
+        }
+
         auto wo = get_core().output_layout->find_output(
             current_state.mirror_from);
         if (!wo)
@@ -709,6 +754,12 @@ struct output_layout_output_t
             return;
         }
 
+        source_changed = false;
+        if (try_direct_mirror(source_back_buffer))
+        {
+            return;
+        }
+
         auto texture = wlr_texture_from_buffer(get_core().renderer, source_back_buffer);
         if (!texture)
         {
@@ -765,6 +816,7 @@ struct output_layout_output_t
         wlr_output_lock_software_cursors(wo->handle, true);
         locked_cursors_on = wo->handle;
 
+        direct_mirror_failed = false;
         wlr_output_schedule_frame(handle);
         on_mirrored_frame.set_callback([=] (void *data)
         {
@@ -785,11 +837,23 @@ struct output_layout_output_t
                 wlr_buffer_lock(ev->state->buffer);
             }
 
+            /* A new buffer without damage has the same contents as the
+             * previous one, so there is nothing to update. */
+            if ((ev->state->committed & WLR_OUTPUT_STATE_DAMAGE) &&
+                !pixman_region32_not_empty(&ev->state->damage))
+            {
+                return;
+            }
+
             /* The mirrored output was repainted, schedule repaint
              * for us as well */
+            source_changed = true;
             wlr_output_schedule_frame(handle);
         });
         on_mirrored_frame.connect(&wo->handle->events.commit);
+        /* Frames are shown only when the source output repaints, so make sure
+         * that it does even if it is idle at the moment. */
+        wo->render->damage_whole();
 
         on_frame.set_callback([=] (void*) { handle_frame(); });
         on_frame.connect(&handle->events.frame);
@@ -809,6 +873,7 @@ struct output_layout_output_t
             source_back_buffer = NULL;
         }
 
+        source_changed = false;
         on_mirrored_frame.disconnect();
         on_frame.disconnect();
     }
@@ -847,6 +912,8 @@ struct output_layout_output_t
             return;
         }
 
+        wf::startup_profile::scope_t profile{std::string("output ") + handle->name + ": apply state"};
+
         uint32_t changed_fields = 0;
         if (this->current_state.source != state.source)
         {
@@ -936,6 +1003,35 @@ class output_layout_t::impl
     wl_idle_call idle_update_configuration;
     wl_timer<false> timer_remove_noop;
 
+    /**
+     * Hotplugged outputs and configuration changes are applied when the loop goes idle. A new output is
+     * only accepted in the hotplug handler, and the mode selection, modeset and the moving of workspace sets
+     * happen here, together for all outputs which appeared or changed in the meantime. This way, the outputs
+     * which are already running are not stalled by the hotplug handler, and a burst of hotplugs (for example
+     * a dock) results in a single modeset batch.
+     */
+    wl_idle_call idle_reconfigure;
+
+    void schedule_reconfigure()
+    {
+        idle_reconfigure.run_once([=] ()
+        {
+            wf::scene::update_batch_t batch;
+            reconfigure_from_config();
+        });
+    }
+
+    /** Apply a scheduled reconfiguration now, before something depends on the current configuration. */
+    void flush_reconfigure()
+    {
+        if (idle_reconfigure.is_connected())
+        {
+            idle_reconfigure.disconnect();
+            wf::scene::update_batch_t batch;
+            reconfigure_from_config();
+        }
+    }
+
     wlr_backend *noop_backend;
     /* Wayfire generally assumes that an enabled output is always available.
      * However, when switching connectors or something it might happen that
@@ -943,9 +1039,25 @@ class output_layout_t::impl
      * virtual output with the noop backend. */
     std::unique_ptr<output_layout_output_t> noop_output;
 
+    /** The outputs of get_outputs() by their id, for find_output_by_id(). */
+    std::unordered_map<uint32_t, wf::output_t*> outputs_by_id;
+
+    wf::signal::connection_t<output_added_signal> on_output_added = [=] (output_added_signal *ev)
+    {
+        outputs_by_id[ev->output->get_id()] = ev->output;
+    };
+
+    wf::signal::connection_t<output_removed_signal> on_output_removed = [=] (output_removed_signal *ev)
+    {
+        outputs_by_id.erase(ev->output->get_id());
+    };
+
     wf::signal::connection_t<wf::reload_config_signal> on_config_reload = [=] (wf::reload_config_signal *ev)
     {
-        reconfigure_from_config();
+        if (ev->may_have_changed("output:"))
+        {
+            schedule_reconfigure();
+        }
     };
 
     wf::signal::connection_t<core_backend_started_signal> on_backend_started =
@@ -955,7 +1067,9 @@ class output_layout_t::impl
         // output while core is running.
         //
         // Thus we need to make sure the noop output is available if nothing
-        // else is at startup.
+        // else is at startup. The outputs found by the backend are enabled first, so that the noop output
+        // is not created just to be removed again.
+        flush_reconfigure();
         if (get_outputs().empty())
         {
             ensure_noop_output();
@@ -1196,7 +1310,8 @@ class output_layout_t::impl
             remove_output(output);
         });
 
-        reconfigure_from_config();
+        // The output stays disabled until the configuration is applied.
+        schedule_reconfigure();
     }
 
     void remove_output(wlr_output *to_remove)
@@ -1416,6 +1531,107 @@ class output_layout_t::impl
         return ok;
     }
 
+    /**
+     * Build the state of each output whose mode or enabled state needs to change in the configuration, so
+     * that all modesets can be tested and committed together. When a docking station connects several
+     * outputs at once, committing them one after another results in a modeset (and flicker) for each of them.
+     *
+     * The remaining state (scale, transform, adaptive sync, render format) does not need a modeset and is
+     * applied per output afterwards, as before.
+     */
+    std::vector<wlr_backend_output_state> build_modeset_batch(const output_configuration_t& config)
+    {
+        std::vector<wlr_backend_output_state> batch;
+        for (auto& [handle, state] : config)
+        {
+            if (this->outputs[handle]->is_nested_compositor)
+            {
+                // Nested outputs are resized by the parent compositor, there is no modeset to batch.
+                continue;
+            }
+
+            wlr_backend_output_state output_state;
+            output_state.output = handle;
+            wlr_output_state_init(&output_state.base);
+
+            if (state.source & OUTPUT_IMAGE_SOURCE_NONE)
+            {
+                if (handle->enabled)
+                {
+                    wlr_output_state_set_enabled(&output_state.base, false);
+                }
+            } else
+            {
+                this->outputs[handle]->refresh_custom_modes();
+                if (auto mode = find_matching_mode(handle, state.mode))
+                {
+                    if (!handle->enabled || (handle->current_mode != mode))
+                    {
+                        wlr_output_state_set_enabled(&output_state.base, true);
+                        wlr_output_state_set_mode(&output_state.base, mode);
+                    }
+                } else if (!handle->enabled || (handle->width != state.mode.width) ||
+                           (handle->height != state.mode.height) || (handle->refresh != state.mode.refresh))
+                {
+                    wlr_output_state_set_enabled(&output_state.base, true);
+                    wlr_output_state_set_custom_mode(&output_state.base,
+                        state.mode.width, state.mode.height, state.mode.refresh);
+                }
+            }
+
+            if (output_state.base.committed)
+            {
+                batch.push_back(output_state);
+            } else
+            {
+                wlr_output_state_finish(&output_state.base);
+            }
+        }
+
+        return batch;
+    }
+
+    static void finish_modeset_batch(std::vector<wlr_backend_output_state>& batch)
+    {
+        for (auto& output_state : batch)
+        {
+            wlr_output_state_finish(&output_state.base);
+        }
+    }
+
+    /** Check whether the backend accepts the modesets of the configuration, all at once. */
+    bool test_modeset_batch(const output_configuration_t& config)
+    {
+        auto batch = build_modeset_batch(config);
+        const bool ok = batch.empty() || wlr_backend_test(get_core().backend, batch.data(), batch.size());
+        finish_modeset_batch(batch);
+        return ok;
+    }
+
+    /**
+     * Commit the modesets of the configuration in a single step, if the backend accepts them. Otherwise, the
+     * outputs are configured one by one in apply_configuration(), which still works on backends which cannot
+     * apply the whole configuration atomically.
+     */
+    void commit_modeset_batch(const output_configuration_t& config)
+    {
+        auto batch = build_modeset_batch(config);
+        if (batch.size() > 1)
+        {
+            wf::startup_profile::scope_t profile{"output modeset batch"};
+            if (wlr_backend_test(get_core().backend, batch.data(), batch.size()) &&
+                wlr_backend_commit(get_core().backend, batch.data(), batch.size()))
+            {
+                LOGD("Applied modesets of ", batch.size(), " outputs at once");
+            } else
+            {
+                LOGD("Backend rejected modesets of ", batch.size(), " outputs, applying them one by one");
+            }
+        }
+
+        finish_modeset_batch(batch);
+    }
+
     /** Apply the given configuration. Config MUST be a valid configuration */
     void apply_configuration(const output_configuration_t& config)
     {
@@ -1454,6 +1670,9 @@ class output_layout_t::impl
             ensure_noop_output();
         }
 
+        /* Do all modesets at once if possible, the steps below are then cheap commits without a modeset */
+        commit_modeset_batch(config);
+
         /* First: disable all outputs that need disabling */
         for (auto& entry : config)
         {
@@ -1654,6 +1873,12 @@ class output_layout_t::impl
         return nullptr;
     }
 
+    wf::output_t *find_output_by_id(uint32_t id)
+    {
+        auto it = outputs_by_id.find(id);
+        return (it == outputs_by_id.end()) ? nullptr : it->second;
+    }
+
     std::vector<wf::output_t*> get_outputs()
     {
         std::vector<wf::output_t*> result;
@@ -1720,8 +1945,14 @@ class output_layout_t::impl
     bool apply_configuration(const output_configuration_t& configuration,
         bool test_only)
     {
+        flush_reconfigure();
         bool ok = test_configuration(configuration);
-        if (ok && !test_only)
+        if (ok && test_only)
+        {
+            // Only a test commit can tell whether the hardware supports the configuration, for example
+            // whether there are enough CRTCs for all outputs.
+            ok = test_modeset_batch(configuration);
+        } else if (ok)
         {
             apply_configuration(configuration);
         }
@@ -1732,7 +1963,10 @@ class output_layout_t::impl
 
 /* Just pass to the PIMPL */
 output_layout_t::output_layout_t(wlr_backend *b) : pimpl(new impl(b))
-{}
+{
+    connect(&pimpl->on_output_added);
+    connect(&pimpl->on_output_removed);
+}
 output_layout_t::~output_layout_t() = default;
 
 wlr_output_layout*output_layout_t::get_handle()
@@ -1776,6 +2010,11 @@ wf::output_t*output_layout_t::find_output(std::string name)
     return pimpl->find_output(name);
 }
 
+wf::output_t*output_layout_t::find_output_by_id(uint32_t id)
+{
+    return pimpl->find_output_by_id(id);
+}
+
 output_configuration_t output_layout_t::get_current_configuration()
 {
     return pimpl->get_current_configuration();
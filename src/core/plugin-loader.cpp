@@ -3,16 +3,25 @@
 #include <memory>
 #include <filesystem>
 #include <dlfcn.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "plugin-loader.hpp"
 #include "../core/wm.hpp"
 #include "wayfire/plugin.hpp"
+#include "wayfire/plugin-stats.hpp"
 #include <wayfire/util/log.hpp>
+#include <wayfire/core.hpp>
+#include <wayfire/thread-pool.hpp>
+#include <wayfire/config/types.hpp>
+#include "seat/bindings-repository-impl.hpp"
+#include "startup-profile.hpp"
 
 wf::plugin_manager_t::plugin_manager_t()
 {
     this->plugins_opt.load_option("core/plugins");
     this->enable_so_unloading.load_option("workarounds/enable_so_unloading");
+    this->lazy_plugins_opt.load_option("core/lazy_plugins");
 
     reload_dynamic_plugins();
     load_static_plugins();
@@ -47,12 +56,24 @@ wf::plugin_manager_t::~plugin_manager_t()
     deinit_plugins(false);
 
     loaded_plugins.clear();
+    for (auto& [path, plugin] : lazy_plugins)
+    {
+        remove_placeholders(plugin);
+    }
+
+    lazy_plugins.clear();
 }
 
 void wf::plugin_manager_t::destroy_plugin(wf::loaded_plugin_t& p)
 {
     LOGD("Unloading plugin ", p.so_path);
     p.instance->fini();
+    // Jobs of the plugin must not run or call back into it once its code is unloaded.
+    if (p.so_handle)
+    {
+        wf::get_core().thread_pool->cancel(dlsym(p.so_handle, "newInstance"));
+    }
+
     p.instance.reset();
 
     /* dlopen()/dlclose() do reference counting, so we should close the plugin
@@ -72,6 +93,11 @@ void wf::plugin_manager_t::destroy_plugin(wf::loaded_plugin_t& p)
      * [3]:
      * https://wiki.musl-libc.org/functional-differences-from-glibc.html#Unloading-libraries
      * */
+    if (p.so_handle)
+    {
+        wf::plugin_stats::remove_plugin(dlsym(p.so_handle, "newInstance"));
+    }
+
     if (p.so_handle && enable_so_unloading)
     {
         dlclose(p.so_handle);
@@ -121,12 +147,25 @@ std::pair<void*, void*> wf::get_new_instance_handle(const std::string& path)
     return {handle, new_instance_func_ptr};
 }
 
+static std::string get_plugin_name(const std::string& path)
+{
+    // Plugins are typically named lib<name>.so
+    std::string name = std::filesystem::path(path).stem();
+    if (name.rfind("lib", 0) == 0)
+    {
+        name = name.substr(3);
+    }
+
+    return name;
+}
+
 std::optional<wf::loaded_plugin_t> wf::plugin_manager_t::load_plugin_from_file(std::string path)
 {
     auto [handle, new_instance_func_ptr] = wf::get_new_instance_handle(path);
     if (new_instance_func_ptr)
     {
         auto new_instance_func = union_cast<void*, wayfire_plugin_load_func>(new_instance_func_ptr);
+        wf::plugin_stats::add_plugin(new_instance_func_ptr, get_plugin_name(path));
 
         loaded_plugin_t lp;
         lp.instance  = std::unique_ptr<wf::plugin_interface_t>(new_instance_func());
@@ -178,6 +217,18 @@ void wf::plugin_manager_t::reload_dynamic_plugins()
     }
 
     /* erase plugins that have been removed from the config */
+    for (auto lazy = lazy_plugins.begin(); lazy != lazy_plugins.end();)
+    {
+        if (std::find(next_plugins.begin(), next_plugins.end(), lazy->first) == next_plugins.end())
+        {
+            remove_placeholders(lazy->second);
+            lazy = lazy_plugins.erase(lazy);
+        } else
+        {
+            ++lazy;
+        }
+    }
+
     auto it = loaded_plugins.begin();
     while (it != loaded_plugins.end())
     {
@@ -203,13 +254,29 @@ void wf::plugin_manager_t::reload_dynamic_plugins()
     /* load new plugins */
     std::vector<std::pair<std::string, wf::loaded_plugin_t>> pending_initialize;
 
+    // Let the kernel read the plugin files in the background while we are busy with dlopen() and init()
+    // of the first plugins, so that the later ones do not need to wait for the disk.
+    for (auto& plugin : next_plugins)
+    {
+        if (!loaded_plugins.count(plugin) && !lazy_plugins.count(plugin))
+        {
+            int fd = open(plugin.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd >= 0)
+            {
+                posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+                close(fd);
+            }
+        }
+    }
+
     for (auto plugin : next_plugins)
     {
-        if (loaded_plugins.count(plugin))
+        if (loaded_plugins.count(plugin) || lazy_plugins.count(plugin) || defer_plugin(plugin))
         {
             continue;
         }
 
+        wf::startup_profile::scope_t profile{"plugin " + get_plugin_name(plugin) + ": load"};
         std::optional<wf::loaded_plugin_t> ptr = load_plugin_from_file(plugin);
         if (ptr)
         {
@@ -224,11 +291,131 @@ void wf::plugin_manager_t::reload_dynamic_plugins()
 
     for (auto& [plugin, ptr] : pending_initialize)
     {
+        wf::startup_profile::scope_t profile{"plugin " + get_plugin_name(plugin) + ": init"};
         ptr.instance->init();
         loaded_plugins[plugin] = std::move(ptr);
     }
 }
 
+bool wf::plugin_manager_t::defer_plugin(const std::string& path)
+{
+    const std::string name = get_plugin_name(path);
+    std::stringstream stream((std::string)lazy_plugins_opt);
+    std::string lazy_name;
+    bool requested = false;
+    while (stream >> lazy_name)
+    {
+        requested |= (lazy_name == name);
+    }
+
+    auto section = wf::get_core().config.get_section(name);
+    if (!requested || !section)
+    {
+        return false;
+    }
+
+    std::vector<wf::option_sptr_t<wf::activatorbinding_t>> activators;
+    for (auto& opt : section->get_registered_options())
+    {
+        if (auto activator = std::dynamic_pointer_cast<wf::config::option_t<wf::activatorbinding_t>>(opt))
+        {
+            activators.push_back(activator);
+        } else if (std::dynamic_pointer_cast<wf::config::option_t<wf::keybinding_t>>(opt) ||
+                   std::dynamic_pointer_cast<wf::config::option_t<wf::buttonbinding_t>>(opt))
+        {
+            LOGW("Plugin ", name, " has key or button bindings and cannot be loaded lazily.");
+            return false;
+        }
+    }
+
+    if (activators.empty())
+    {
+        LOGW("Plugin ", name, " has no activator bindings and cannot be loaded lazily.");
+        return false;
+    }
+
+    LOGD("Deferring loading of plugin ", path, " until it is activated");
+    auto& lazy = lazy_plugins[path];
+    lazy.name = name;
+    for (auto& activator : activators)
+    {
+        auto callback = std::make_unique<wf::activator_callback>();
+        auto trigger  = callback.get();
+        *callback = [=] (const wf::activator_data_t& data)
+        {
+            load_deferred_plugin(path, trigger, data);
+            return true;
+        };
+
+        wf::get_core().bindings->add_activator(activator, callback.get());
+        lazy.callbacks.push_back(std::move(callback));
+    }
+
+    return true;
+}
+
+void wf::plugin_manager_t::load_deferred_plugin(const std::string& path, wf::activator_callback *trigger,
+    const wf::activator_data_t& data)
+{
+    auto it = lazy_plugins.find(path);
+    if (it == lazy_plugins.end())
+    {
+        return;
+    }
+
+    // Find the option which triggered the placeholder, to forward the activation to the plugin.
+    auto& activators = wf::get_core().bindings->priv->activators;
+    wf::option_sptr_t<wf::activatorbinding_t> option;
+    for (auto& binding : activators)
+    {
+        if (binding->callback == trigger)
+        {
+            option = binding->activated_by;
+        }
+    }
+
+    LOGD("Loading deferred plugin ", path);
+    remove_placeholders(it->second);
+    lazy_plugins.erase(it);
+
+    auto plugin = load_plugin_from_file(path);
+    if (!plugin)
+    {
+        return;
+    }
+
+    plugin->instance->init();
+    loaded_plugins[path] = std::move(*plugin);
+
+    // Bindings can be removed while we run the callbacks, so collect them first.
+    std::vector<wf::activator_callback*> callbacks;
+    for (auto& binding : activators)
+    {
+        if (option && (binding->activated_by == option))
+        {
+            callbacks.push_back(binding->callback);
+        }
+    }
+
+    for (auto& callback : callbacks)
+    {
+        (*callback)(data);
+    }
+}
+
+void wf::plugin_manager_t::remove_placeholders(lazy_plugin_t& plugin)
+{
+    for (auto& callback : plugin.callbacks)
+    {
+        wf::get_core().bindings->rem_binding(callback.get());
+        // The placeholder may be running right now, so free it only once it is done.
+        unused_placeholders.push_back(std::move(callback));
+    }
+
+    plugin.callbacks.clear();
+    idle_free_placeholders.run_once([=] () { unused_placeholders.clear(); });
+}
+
 template<class T>
 static wf::loaded_plugin_t create_plugin(std::string name)
 {
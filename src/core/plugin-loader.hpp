@@ -6,6 +6,7 @@
 #include "config.h"
 #include "wayfire/util.hpp"
 #include <wayfire/option-wrapper.hpp>
+#include <wayfire/bindings.hpp>
 
 namespace wf
 {
@@ -21,6 +22,18 @@ struct loaded_plugin_t
     std::string so_path;
 };
 
+/**
+ * A plugin which is loaded only once one of its activator bindings is triggered for the first time.
+ */
+struct lazy_plugin_t
+{
+    // The name of the plugin, which is also the name of its config section.
+    std::string name;
+
+    // Placeholder callbacks for the activator bindings of the plugin.
+    std::vector<std::unique_ptr<wf::activator_callback>> callbacks;
+};
+
 struct plugin_manager_t
 {
     plugin_manager_t();
@@ -32,10 +45,25 @@ struct plugin_manager_t
   private:
     wf::option_wrapper_t<std::string> plugins_opt;
     wf::option_wrapper_t<bool> enable_so_unloading;
+    wf::option_wrapper_t<std::string> lazy_plugins_opt;
     std::unordered_map<std::string, loaded_plugin_t> loaded_plugins;
+    std::unordered_map<std::string, lazy_plugin_t> lazy_plugins;
+    wf::wl_idle_call idle_free_placeholders;
+    std::vector<std::unique_ptr<wf::activator_callback>> unused_placeholders;
 
     void deinit_plugins(bool unloadable);
 
+    /**
+     * Register placeholder bindings for a plugin instead of loading it, if the user asked for the plugin to
+     * be loaded lazily and it can be triggered only via activator bindings.
+     *
+     * @return Whether the plugin was deferred.
+     */
+    bool defer_plugin(const std::string& path);
+    void load_deferred_plugin(const std::string& path, wf::activator_callback *trigger,
+        const wf::activator_data_t& data);
+    void remove_placeholders(lazy_plugin_t& plugin);
+
     std::optional<loaded_plugin_t> load_plugin_from_file(std::string path);
     void load_static_plugins();
     void destroy_plugin(loaded_plugin_t& plugin);
@@ -0,0 +1,224 @@
+#include <wayfire/plugin-stats.hpp>
+#include <wayfire/util.hpp>
+#include <wayfire/scene-render.hpp>
+#include <algorithm>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include <cstdlib>
+#include <map>
+#include <typeindex>
+#include <unordered_map>
+
+namespace
+{
+/** The name of each registered plugin, by the base address of its shared object */
+std::unordered_map<const void*, std::string> plugin_names;
+/** The statistics of each plugin, by name. Not a hash map, so that pointers stay valid. */
+std::map<std::string, wf::plugin_stats::plugin_cost_t> stats;
+/** Cached owner of each callback type */
+std::unordered_map<const std::type_info*, wf::plugin_stats::plugin_cost_t*> owners;
+/** Cached owner of each code address, see get_owner_name() */
+std::unordered_map<const void*, std::string> address_owners;
+/** The statistics of each signal type, by name, since type_info objects are not unique across objects */
+std::unordered_map<std::type_index, wf::plugin_stats::signal_cost_t> signal_stats;
+/** The time spent in each plugin during the current frame */
+std::unordered_map<wf::plugin_stats::plugin_cost_t*, int64_t> current_frame;
+
+wf::plugin_stats::detail::scope_data_t *current_scope = nullptr;
+uint64_t frame_count = 0;
+
+const void *get_object_base(const void *address)
+{
+    Dl_info info;
+    if (!dladdr(address, &info))
+    {
+        return nullptr;
+    }
+
+    return info.dli_fbase;
+}
+
+wf::plugin_stats::plugin_cost_t *find_owner(const std::type_info *key)
+{
+    auto it = owners.find(key);
+    if (it != owners.end())
+    {
+        return it->second;
+    }
+
+    std::string name = "core";
+    auto plugin = plugin_names.find(get_object_base(key));
+    if (plugin != plugin_names.end())
+    {
+        name = plugin->second;
+    }
+
+    auto& cost = stats[name];
+    cost.name = name;
+    return owners[key] = &cost;
+}
+
+wf::plugin_stats::signal_cost_t& find_signal(const std::type_info& signal)
+{
+    auto& cost = signal_stats[std::type_index(signal)];
+    if (cost.name.empty())
+    {
+        int status;
+        char *demangled = abi::__cxa_demangle(signal.name(), nullptr, nullptr, &status);
+        cost.name = (status == 0) ? demangled : signal.name();
+        free(demangled);
+    }
+
+    return cost;
+}
+}
+
+bool wf::plugin_stats::enabled = false;
+
+void wf::plugin_stats::enable(bool enable)
+{
+    if (enable && !enabled)
+    {
+        stats.clear();
+        signal_stats.clear();
+        owners.clear();
+        current_frame.clear();
+        frame_count = 0;
+        wf::scene::reset_node_render_stats();
+    }
+
+    enabled = enable;
+}
+
+std::vector<wf::plugin_stats::plugin_cost_t> wf::plugin_stats::get_stats()
+{
+    std::vector<plugin_cost_t> result;
+    for (auto& [name, cost] : stats)
+    {
+        result.push_back(cost);
+    }
+
+    return result;
+}
+
+std::vector<wf::plugin_stats::signal_cost_t> wf::plugin_stats::get_signal_stats()
+{
+    std::vector<signal_cost_t> result;
+    for (auto& [type, cost] : signal_stats)
+    {
+        result.push_back(cost);
+    }
+
+    std::sort(result.begin(), result.end(), [] (const signal_cost_t& a, const signal_cost_t& b)
+    {
+        return a.dispatch_usec > b.dispatch_usec;
+    });
+    return result;
+}
+
+uint64_t wf::plugin_stats::get_frame_count()
+{
+    return frame_count;
+}
+
+void wf::plugin_stats::end_frame()
+{
+    if (!enabled)
+    {
+        return;
+    }
+
+    for (auto& [name, cost] : stats)
+    {
+        auto it = current_frame.find(&cost);
+        cost.last_frame_usec = (it != current_frame.end()) ? it->second : 0;
+        cost.max_frame_usec  = std::max(cost.max_frame_usec, cost.last_frame_usec);
+    }
+
+    current_frame.clear();
+    frame_count++;
+}
+
+void wf::plugin_stats::add_plugin(const void *symbol, const std::string& name)
+{
+    if (auto base = get_object_base(symbol))
+    {
+        plugin_names[base] = name;
+        // Types may have been attributed to an object which was previously loaded at the same address.
+        owners.clear();
+        address_owners.clear();
+    }
+}
+
+void wf::plugin_stats::remove_plugin(const void *symbol)
+{
+    plugin_names.erase(get_object_base(symbol));
+    owners.clear();
+    address_owners.clear();
+}
+
+const std::string& wf::plugin_stats::get_owner_name(const void *address)
+{
+    auto it = address_owners.find(address);
+    if (it != address_owners.end())
+    {
+        return it->second;
+    }
+
+    auto plugin = plugin_names.find(get_object_base(address));
+    return address_owners[address] = (plugin != plugin_names.end()) ? plugin->second : "core";
+}
+
+int64_t wf::plugin_stats::detail::now()
+{
+    return wf::get_current_time_usec();
+}
+
+void wf::plugin_stats::detail::begin(scope_data_t& data)
+{
+    data.start    = now();
+    data.children = 0;
+    data.parent   = current_scope;
+    current_scope = &data;
+}
+
+void wf::plugin_stats::detail::end(scope_data_t& data)
+{
+    const int64_t elapsed = now() - data.start;
+    current_scope = data.parent;
+    if (data.parent)
+    {
+        data.parent->children += elapsed;
+    }
+
+    if (!enabled)
+    {
+        return;
+    }
+
+    auto owner = find_owner(data.key);
+    const int64_t self = elapsed - data.children;
+    owner->costs[data.type].calls++;
+    owner->costs[data.type].total_usec += self;
+    current_frame[owner] += self;
+    if (data.signal)
+    {
+        auto& handler = find_signal(*data.signal).handlers[owner->name];
+        handler.calls++;
+        handler.total_usec += self;
+    }
+}
+
+void wf::plugin_stats::detail::note_emit(const std::type_info& signal, size_t listeners, int64_t start)
+{
+    if (!enabled)
+    {
+        return;
+    }
+
+    auto& cost = find_signal(signal);
+    cost.emissions++;
+    cost.listeners    += listeners;
+    cost.max_listeners = std::max(cost.max_listeners, (uint64_t)listeners);
+    cost.dispatch_usec += now() - start;
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <wayfire/scene.hpp>
+#include <wayfire/util.hpp>
 
 
 namespace wf
@@ -7,6 +8,17 @@ namespace wf
 namespace scene
 {
 struct root_node_t::priv_t
-{};
+{
+    /** Number of live update_batch_t objects */
+    int batch_depth = 0;
+    /** Whether updates have reached the root while a batch was active */
+    bool has_pending = false;
+    /** The combined flags of the pending updates, without MASKED */
+    uint32_t pending_flags = 0;
+    /** Whether all pending updates were masked */
+    bool pending_masked = true;
+    /** Flushes the pending updates if a batch lives past the current event loop iteration */
+    wf::wl_idle_call idle_flush;
+};
 }
 }
@@ -1,9 +1,13 @@
+#include <cmath>
 #include <limits>
 #include <memory>
 #include <wayfire/scene.hpp>
 #include <wayfire/view.hpp>
 #include <wayfire/output.hpp>
+#include <wayfire/trace.hpp>
 #include <algorithm>
+#include <unordered_map>
+#include <utility>
 
 #include "scene-priv.hpp"
 #include "wayfire/geometry.hpp"
@@ -12,6 +16,7 @@
 #include "wayfire/scene-input.hpp"
 #include "wayfire/scene-render.hpp"
 #include "wayfire/signal-provider.hpp"
+#include "wayfire/option-wrapper.hpp"
 #include <wayfire/core.hpp>
 
 namespace wf
@@ -71,6 +76,21 @@ std::string node_t::stringify_flags() const
     return "(" + fl + ")";
 }
 
+namespace
+{
+/**
+ * The bounding boxes of views, in the coordinate system of their parent node, collected by the output node
+ * whose find_node_at() is currently running.
+ */
+const std::unordered_map<node_t*, wf::geometry_t> *active_input_index = nullptr;
+
+/**
+ * The child whose update is currently being passed to its parent's optimize_update(), used to tell nested
+ * render instances which of their children changed.
+ */
+node_t *updated_child = nullptr;
+}
+
 std::optional<input_node_t> node_t::find_node_at(const wf::pointf_t& at)
 {
     auto local = this->to_local(at);
@@ -81,6 +101,15 @@ std::optional<input_node_t> node_t::find_node_at(const wf::pointf_t& at)
             continue;
         }
 
+        if (active_input_index)
+        {
+            auto it = active_input_index->find(node.get());
+            if ((it != active_input_index->end()) && !(it->second & local))
+            {
+                continue;
+            }
+        }
+
         auto child_node = node->find_node_at(local);
         if (child_node.has_value())
         {
@@ -228,12 +257,23 @@ class default_render_instance_t : public render_instance_t
         wf::dassert(false, "Rendering an inner node?");
     }
 
+    bool supports_direct_render() override
+    {
+        // Nothing is rendered, the children are separate instances.
+        return true;
+    }
+
     direct_scanout try_scanout(wf::output_t *output) override
     {
         // Nodes without actual visual content do not prevent further nodes
         // from being scanned out.
         return direct_scanout::SKIP;
     }
+
+    direct_scanout try_output_layers(wf::output_t *output, output_layers_plan_t& plan) override
+    {
+        return direct_scanout::SKIP;
+    }
 };
 
 void node_t::gen_render_instances(std::vector<render_instance_uptr> & instances,
@@ -294,11 +334,40 @@ uint32_t node_t::optimize_update(uint32_t flags)
 }
 
 // ------------------------------ output_node_t --------------------------------
+struct output_node_t::input_index_t
+{
+    bool valid = false;
+    std::unordered_map<node_t*, wf::geometry_t> view_boxes;
+
+    void build(node_t *node)
+    {
+        for (auto& ch : node->get_children())
+        {
+            if (!ch->is_enabled())
+            {
+                continue;
+            }
+
+            if (dynamic_cast<wf::view_node_tag_t*>(ch.get()))
+            {
+                view_boxes[ch.get()] = ch->get_bounding_box();
+            } else
+            {
+                build(ch.get());
+            }
+        }
+    }
+};
+
 output_node_t::output_node_t(wf::output_t *output) : floating_inner_node_t(true)
 {
     this->output = output;
+    this->input_index = std::make_unique<input_index_t>();
 }
 
+output_node_t::~output_node_t()
+{}
+
 std::string output_node_t::stringify() const
 {
     return "output " + this->output->to_string() + " " + stringify_flags();
@@ -323,7 +392,41 @@ std::optional<input_node_t> output_node_t::find_node_at(const wf::pointf_t& at)
         return {};
     }
 
-    return node_t::find_node_at(at);
+    static wf::option_wrapper_t<bool> pointer_hit_index{"workarounds/pointer_hit_index"};
+    if (!pointer_hit_index || active_input_index)
+    {
+        return node_t::find_node_at(at);
+    }
+
+    if (!input_index->valid)
+    {
+        input_index->view_boxes.clear();
+        input_index->build(this);
+        input_index->valid = true;
+    }
+
+    active_input_index = &input_index->view_boxes;
+    auto result = node_t::find_node_at(at);
+    active_input_index = nullptr;
+    return result;
+}
+
+uint32_t output_node_t::optimize_update(uint32_t update_flags)
+{
+    if (update_flags & (update_flag::INPUT_STATE | update_flag::CHILDREN_LIST | update_flag::ENABLED))
+    {
+        invalidate_input_index();
+    }
+
+    // Changes below the output node are handled by its render instances, which regenerate only the
+    // instances of the changed child.
+    return optimize_nested_render_instances(shared_from_this(),
+        floating_inner_node_t::optimize_update(update_flags));
+}
+
+void output_node_t::invalidate_input_index()
+{
+    input_index->valid = false;
 }
 
 class output_render_instance_t : public default_render_instance_t
@@ -331,6 +434,19 @@ class output_render_instance_t : public default_render_instance_t
     wf::output_t *output;
     output_node_t *self;
     std::vector<render_instance_uptr> children;
+    children_instances_origin_t children_origin;
+
+    wf::signal::connection_t<node_regen_instances_signal> on_regen_instances;
+
+    /**
+     * With workarounds/static_layer_cache, the children in the background and bottom layers are rendered to
+     * @cache, in output-local coordinates, and only the damaged parts of the cache are repainted. Frames in
+     * which only the layers above change then just copy the cache.
+     */
+    bool use_cache = false;
+    wf::render_target_t cache;
+    wf::region_t cache_damage;
+    std::vector<render_instruction_t> cache_instruction_buffer;
 
   public:
     output_render_instance_t(output_node_t *self, damage_callback callback,
@@ -340,15 +456,43 @@ class output_render_instance_t : public default_render_instance_t
         this->self   = self;
         this->output = output;
 
+        static wf::option_wrapper_t<bool> static_layer_cache{"workarounds/static_layer_cache"};
+        auto& layers = wf::get_core().scene()->layers;
+        use_cache = static_layer_cache && (shown_on == output) &&
+            ((self->parent() == layers[(int)layer::BACKGROUND].get()) ||
+                (self->parent() == layers[(int)layer::BOTTOM].get()));
+
         // Children are stored as a sublist, because we need to translate every
         // time between global and output-local geometry.
-        for (auto& child : self->get_children())
+        damage_callback child_damage = transform_damage(callback);
+        if (use_cache)
         {
-            if (child->is_enabled())
+            child_damage = [=, push_damage = child_damage] (const wf::region_t& damage)
             {
-                child->gen_render_instances(children,
-                    transform_damage(callback), shown_on);
-            }
+                cache_damage |= damage;
+                push_damage(damage);
+            };
+        }
+
+        regen_children_instances(self, nullptr, children, children_origin, child_damage, shown_on);
+
+        on_regen_instances = [=] (node_regen_instances_signal *ev)
+        {
+            ev->handled = true;
+            regen_children_instances(self, ev->changed_child, children, children_origin,
+                child_damage, shown_on);
+            cache_damage |= wf::geometry_t{{0, 0}, wf::dimensions(output->get_layout_geometry())};
+        };
+        self->connect(&on_regen_instances);
+    }
+
+    ~output_render_instance_t()
+    {
+        if (cache.fb != (uint32_t)-1)
+        {
+            OpenGL::render_begin();
+            cache.release_to_pool();
+            OpenGL::render_end();
         }
     }
 
@@ -384,6 +528,21 @@ class output_render_instance_t : public default_render_instance_t
     void _schedule_instructions(std::vector<render_instruction_t>& instructions,
         const wf::render_target_t& target, wf::region_t& damage)
     {
+        if (use_cache)
+        {
+            wf::region_t our_damage = damage & output->get_layout_geometry();
+            if (!our_damage.empty())
+            {
+                instructions.push_back(render_instruction_t{
+                    .instance = this,
+                    .target   = target,
+                    .damage   = std::move(our_damage),
+                });
+            }
+
+            return;
+        }
+
         // In principle, we just have to schedule the children.
         // However, we need to adjust the target's geometry and the damage to
         // fit with the coordinate system of the output.
@@ -399,6 +558,55 @@ class output_render_instance_t : public default_render_instance_t
         damage += offset;
     }
 
+    void render(const wf::render_target_t& target, const wf::region_t& damage) override
+    {
+        wf::dassert(use_cache, "Rendering an output node without a cache?");
+        const auto geometry = output->get_layout_geometry();
+        const float scale   = output->handle->scale;
+
+        OpenGL::render_begin();
+        cache.scale = scale;
+        if (cache.allocate_from_pool(std::ceil(geometry.width * scale), std::ceil(geometry.height * scale)))
+        {
+            cache_damage |= wf::geometry_t{{0, 0}, wf::dimensions(geometry)};
+        }
+
+        cache.geometry = {0, 0, geometry.width, geometry.height};
+        OpenGL::render_end();
+
+        if (!cache_damage.empty())
+        {
+            render_pass_params_t params;
+            params.instances = &children;
+            params.target    = cache;
+            params.damage    = cache_damage;
+            params.background_color   = {0.0f, 0.0f, 0.0f, 0.0f};
+            params.instruction_buffer = &cache_instruction_buffer;
+            run_render_pass(params, RPASS_CLEAR_BACKGROUND);
+            cache_damage.clear();
+        }
+
+        OpenGL::render_begin(target);
+        for (auto& box : damage)
+        {
+            target.logic_scissor(wlr_box_from_pixman_box(box));
+            OpenGL::render_texture(wf::texture_t{cache.tex}, target, geometry);
+        }
+
+        OpenGL::render_end();
+    }
+
+    void presentation_feedback(wf::output_t *output) override
+    {
+        if (use_cache)
+        {
+            for (auto& ch : children)
+            {
+                ch->presentation_feedback(output);
+            }
+        }
+    }
+
     direct_scanout try_scanout(wf::output_t *scanout) override
     {
         if ((scanout != this->output) && this->self->limit_region)
@@ -420,6 +628,21 @@ class output_render_instance_t : public default_render_instance_t
         return direct_scanout::SKIP;
     }
 
+    direct_scanout try_output_layers(wf::output_t *scanout, output_layers_plan_t& plan) override
+    {
+        if ((scanout != this->output) && this->self->limit_region)
+        {
+            return direct_scanout::SKIP;
+        }
+
+        // Children are positioned relative to our output, convert to the coordinates of the scanout output.
+        auto offset = wf::origin(output->get_layout_geometry()) - wf::origin(scanout->get_layout_geometry());
+        plan.offset = plan.offset + offset;
+        auto result = try_output_layers_from_list(children, scanout, plan);
+        plan.offset = plan.offset - offset;
+        return result;
+    }
+
     void compute_visibility(wf::output_t *output, wf::region_t& visible) override
     {
         auto offset = wf::origin(output->get_layout_geometry());
@@ -456,6 +679,10 @@ root_node_t::root_node_t() : floating_inner_node_t(true)
     std::vector<node_ptr> children;
 
     this->priv = std::make_unique<root_node_t::priv_t>();
+    this->priv->idle_flush.set_callback([] ()
+    {
+        flush_pending_updates();
+    });
     for (int i = (int)layer::ALL_LAYERS - 1; i >= 0; i--)
     {
         layers[i] = std::make_shared<floating_inner_node_t>(true);
@@ -491,7 +718,14 @@ void set_node_enabled(wf::scene::node_ptr node, bool enabled)
     }
 }
 
-void update(node_ptr changed_node, uint32_t flags)
+static uint64_t children_list_generation = 0;
+
+uint64_t get_children_list_generation()
+{
+    return children_list_generation;
+}
+
+static void propagate_update(node_ptr changed_node, uint32_t flags)
 {
     if ((flags & update_flag::CHILDREN_LIST) ||
         (flags & update_flag::ENABLED) ||
@@ -506,8 +740,28 @@ void update(node_ptr changed_node, uint32_t flags)
         flags |= update_flag::MASKED;
     }
 
+    if (flags & update_flag::INPUT_STATE)
+    {
+        // Updates from the output node's children are seen in output_node_t::optimize_update()
+        if (auto output_node = dynamic_cast<output_node_t*>(changed_node.get()))
+        {
+            output_node->invalidate_input_index();
+        }
+    }
+
     if (changed_node == wf::get_core().scene())
     {
+        auto& priv = *wf::get_core().scene()->priv;
+        if (priv.batch_depth > 0)
+        {
+            priv.has_pending     = true;
+            priv.pending_flags  |= flags & ~update_flag::MASKED;
+            priv.pending_masked &= bool(flags & update_flag::MASKED);
+            priv.idle_flush.run_once();
+            return;
+        }
+
+        WF_TRACE_SCOPE("scene::update");
         root_node_update_signal data;
         data.flags = flags;
         wf::get_core().scene()->emit(&data);
@@ -516,16 +770,73 @@ void update(node_ptr changed_node, uint32_t flags)
 
     if (changed_node->parent())
     {
+        auto prev_updated_child = std::exchange(updated_child, changed_node.get());
         flags = changed_node->parent()->optimize_update(flags);
+        updated_child = prev_updated_child;
         if (!changed_node->parent()->is_enabled())
         {
             flags |= update_flag::MASKED;
         }
 
-        update(changed_node->parent()->shared_from_this(), flags);
+        propagate_update(changed_node->parent()->shared_from_this(), flags);
     }
 }
 
+void update(node_ptr changed_node, uint32_t flags)
+{
+    if (flags & update_flag::CHILDREN_LIST)
+    {
+        ++children_list_generation;
+    }
+
+    if ((flags & update_flag::CHILDREN_LIST) && !(flags & update_flag::ENABLED))
+    {
+        // Let the render instances of the node add and remove the instances of its children themselves, so
+        // that the instances of the other children survive, for example when a view is mapped. Otherwise,
+        // the parent would regenerate the instances of the whole node.
+        node_regen_instances_signal data;
+        data.changed_child = changed_node.get();
+        changed_node->emit(&data);
+        if (data.handled)
+        {
+            flags &= ~update_flag::CHILDREN_LIST;
+            flags |= update_flag::GEOMETRY;
+        }
+    }
+
+    propagate_update(changed_node, flags);
+}
+
+update_batch_t::update_batch_t()
+{
+    wf::get_core().scene()->priv->batch_depth++;
+}
+
+update_batch_t::~update_batch_t()
+{
+    if (--wf::get_core().scene()->priv->batch_depth == 0)
+    {
+        flush_pending_updates();
+    }
+}
+
+void flush_pending_updates()
+{
+    auto& priv = *wf::get_core().scene()->priv;
+    priv.idle_flush.disconnect();
+    if (!priv.has_pending)
+    {
+        return;
+    }
+
+    root_node_update_signal data;
+    data.flags = priv.pending_flags | (priv.pending_masked ? update_flag::MASKED : 0);
+    priv.has_pending    = false;
+    priv.pending_flags  = 0;
+    priv.pending_masked = true;
+    wf::get_core().scene()->emit(&data);
+}
+
 floating_inner_node_t::~floating_inner_node_t()
 {
     for (auto& node : this->children)
@@ -544,10 +855,62 @@ uint32_t optimize_nested_render_instances(wf::scene::node_ptr node, uint32_t fla
         flags &= ~update_flag::ENABLED;
         flags |= update_flag::GEOMETRY | update_flag::INPUT_STATE;
         node_regen_instances_signal data;
+        if (updated_child && (updated_child->parent() == node.get()))
+        {
+            data.changed_child = updated_child;
+        }
+
         node->emit(&data);
     }
 
     return flags;
 }
+
+void regen_children_instances(node_t *node, node_t *changed_child,
+    std::vector<render_instance_uptr>& instances, children_instances_origin_t& origin,
+    damage_callback push_damage, wf::output_t *shown_on)
+{
+    auto old_instances = std::move(instances);
+    auto old_origin    = std::move(origin);
+    instances.clear();
+    origin.clear();
+
+    // The range of the old instances generated by each child which is still alive
+    std::unordered_map<node_t*, std::pair<size_t, size_t>> old_ranges;
+    size_t start = 0;
+    for (auto& [child, count] : old_origin)
+    {
+        if (auto ch = child.lock())
+        {
+            old_ranges[ch.get()] = {start, count};
+        }
+
+        start += count;
+    }
+
+    for (auto& ch : node->get_children())
+    {
+        if (!ch->is_enabled())
+        {
+            continue;
+        }
+
+        const size_t count_before = instances.size();
+        auto it = old_ranges.find(ch.get());
+        if (changed_child && (ch.get() != changed_child) && (it != old_ranges.end()))
+        {
+            auto [first, count] = it->second;
+            for (size_t i = first; i < first + count; i++)
+            {
+                instances.push_back(std::move(old_instances[i]));
+            }
+        } else
+        {
+            ch->gen_render_instances(instances, push_damage, shown_on);
+        }
+
+        origin.emplace_back(ch, instances.size() - count_before);
+    }
+}
 } // namespace scene
 }
@@ -4,6 +4,9 @@
 #include "hotspot-manager.hpp"
 #include "wayfire/signal-definitions.hpp"
 #include <wayfire/debug.hpp>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 struct wf::bindings_repository_t::impl
 {
@@ -35,8 +38,145 @@ struct wf::bindings_repository_t::impl
 
     hotspot_manager_t hotspot_mgr;
 
+    /** The bindings which match an input event. */
+    struct matches_t
+    {
+        std::vector<binding_t<wf::keybinding_t, key_callback>*> keys;
+        std::vector<binding_t<wf::keybinding_t, axis_callback>*> axes;
+        std::vector<binding_t<wf::buttonbinding_t, button_callback>*> buttons;
+        std::vector<binding_t<wf::activatorbinding_t, activator_callback>*> activators;
+    };
+
+    enum match_kind_t : uint64_t
+    {
+        MATCH_KEY     = 1,
+        MATCH_AXIS    = 2,
+        MATCH_BUTTON  = 3,
+        MATCH_GESTURE = 4,
+    };
+
+    /**
+     * The bindings matching each key, axis, button and gesture event seen so far, indexed by the kind of
+     * the event, its modifiers and its keycode or button (or the gesture), see get_matches().
+     *
+     * Matching activators against an event means parsing their options, and there are usually hundreds of
+     * them, so they are matched only once per combination. The cache is cleared whenever bindings are
+     * added or removed, or their options change.
+     */
+    std::unordered_map<uint64_t, matches_t> match_cache;
+
+    /** @return The bindings matching an event, from the cache if possible. */
+    const matches_t& get_matches(match_kind_t kind, uint32_t modifiers, uint32_t code)
+    {
+        const uint64_t index = (uint64_t(kind) << 56) | (uint64_t(modifiers & 0xffffff) << 32) | code;
+        auto it = match_cache.find(index);
+        if (it != match_cache.end())
+        {
+            return it->second;
+        }
+
+        matches_t matches;
+        switch (kind)
+        {
+          case MATCH_KEY:
+            collect_matches(keys, matches.keys, wf::keybinding_t{modifiers, code});
+            collect_matches(activators, matches.activators, wf::keybinding_t{modifiers, code});
+            break;
+
+          case MATCH_AXIS:
+            collect_matches(axes, matches.axes, wf::keybinding_t{modifiers, 0});
+            break;
+
+          case MATCH_BUTTON:
+            collect_matches(buttons, matches.buttons, wf::buttonbinding_t{modifiers, code});
+            collect_matches(activators, matches.activators, wf::buttonbinding_t{modifiers, code});
+            break;
+        }
+
+        return match_cache[index] = std::move(matches);
+    }
+
+    const matches_t& get_matches(const wf::touchgesture_t& gesture)
+    {
+        const uint64_t index = (uint64_t(MATCH_GESTURE) << 56) | (uint64_t(gesture.get_type()) << 48) |
+            (uint64_t(gesture.get_finger_count() & 0xffff) << 32) | gesture.get_direction();
+        auto it = match_cache.find(index);
+        if (it != match_cache.end())
+        {
+            return it->second;
+        }
+
+        matches_t matches;
+        collect_matches(activators, matches.activators, gesture);
+        return match_cache[index] = std::move(matches);
+    }
+
+    /**
+     * Whether any activator can be triggered by a touchscreen gesture of the given type, so that its
+     * recognizer has to run at all. Cached like the matches.
+     */
+    bool has_gesture_bindings(wf::touch_gesture_type_t type)
+    {
+        auto it = gesture_types_cache.find(type);
+        if (it != gesture_types_cache.end())
+        {
+            return it->second;
+        }
+
+        static const std::vector<uint32_t> swipe_directions = {
+            GESTURE_DIRECTION_LEFT, GESTURE_DIRECTION_RIGHT, GESTURE_DIRECTION_UP, GESTURE_DIRECTION_DOWN,
+            GESTURE_DIRECTION_LEFT | GESTURE_DIRECTION_UP, GESTURE_DIRECTION_LEFT | GESTURE_DIRECTION_DOWN,
+            GESTURE_DIRECTION_RIGHT | GESTURE_DIRECTION_UP, GESTURE_DIRECTION_RIGHT | GESTURE_DIRECTION_DOWN,
+        };
+        static const std::vector<uint32_t> pinch_directions = {
+            GESTURE_DIRECTION_IN, GESTURE_DIRECTION_OUT,
+        };
+
+        const auto& directions = (type == GESTURE_TYPE_PINCH) ? pinch_directions : swipe_directions;
+        bool found = false;
+        for (int fingers = 1; (fingers <= MAX_GESTURE_FINGERS) && !found; fingers++)
+        {
+            for (auto direction : directions)
+            {
+                found |= !get_matches(wf::touchgesture_t{type, direction, fingers}).activators.empty();
+            }
+        }
+
+        return gesture_types_cache[type] = found;
+    }
+
+    /** The maximal number of fingers of gestures which are recognized. */
+    static constexpr int MAX_GESTURE_FINGERS = 10;
+    std::unordered_map<int, bool> gesture_types_cache;
+
+    template<class Option, class Callback, class Event>
+    static void collect_matches(const binding_container_t<Option, Callback>& bindings,
+        std::vector<binding_t<Option, Callback>*>& matches, const Event& event)
+    {
+        for (auto& binding : bindings)
+        {
+            if constexpr (std::is_same_v<Option, wf::activatorbinding_t>)
+            {
+                if (binding->activated_by->get_value().has_match(event))
+                {
+                    matches.push_back(binding.get());
+                }
+            } else if (binding->activated_by->get_value() == event)
+            {
+                matches.push_back(binding.get());
+            }
+        }
+    }
+
+    void invalidate_matches()
+    {
+        match_cache.clear();
+        gesture_types_cache.clear();
+    }
+
     wf::signal::connection_t<wf::reload_config_signal> on_config_reload = [=] (wf::reload_config_signal *ev)
     {
+        invalidate_matches();
         recreate_hotspots();
         reparse_extensions();
     };
@@ -9,13 +9,16 @@ wf::bindings_repository_t::bindings_repository_t()
 }
 
 template<class Option, class Callback>
-static void push_binding(wf::binding_container_t<Option, Callback>& bindings,
-    wf::option_sptr_t<Option> opt, Callback *callback)
+static void push_binding(wf::bindings_repository_t::impl *priv,
+    wf::binding_container_t<Option, Callback>& bindings, wf::option_sptr_t<Option> opt, Callback *callback)
 {
     auto bnd = std::make_unique<wf::binding_t<Option, Callback>>();
     bnd->activated_by = opt;
     bnd->callback     = callback;
+    bnd->on_changed   = [priv] () { priv->invalidate_matches(); };
+    opt->add_updated_handler(&bnd->on_changed);
     bindings.emplace_back(std::move(bnd));
+    priv->invalidate_matches();
 }
 
 wf::bindings_repository_t::~bindings_repository_t()
@@ -23,23 +26,23 @@ wf::bindings_repository_t::~bindings_repository_t()
 
 void wf::bindings_repository_t::add_key(option_sptr_t<keybinding_t> key, wf::key_callback *cb)
 {
-    push_binding(priv->keys, key, cb);
+    push_binding(priv.get(), priv->keys, key, cb);
 }
 
 void wf::bindings_repository_t::add_axis(option_sptr_t<keybinding_t> axis, wf::axis_callback *cb)
 {
-    push_binding(priv->axes, axis, cb);
+    push_binding(priv.get(), priv->axes, axis, cb);
 }
 
 void wf::bindings_repository_t::add_button(option_sptr_t<buttonbinding_t> button, wf::button_callback *cb)
 {
-    push_binding(priv->buttons, button, cb);
+    push_binding(priv.get(), priv->buttons, button, cb);
 }
 
 void wf::bindings_repository_t::add_activator(
     option_sptr_t<activatorbinding_t> activator, wf::activator_callback *cb)
 {
-    push_binding(priv->activators, activator, cb);
+    push_binding(priv.get(), priv->activators, activator, cb);
     if (activator->get_value().get_hotspots().size())
     {
         priv->recreate_hotspots();
@@ -55,43 +58,38 @@ bool wf::bindings_repository_t::handle_key(const wf::keybinding_t& pressed,
     }
 
     std::vector<std::function<bool()>> callbacks;
-    for (auto& binding : this->priv->keys)
+    auto& matches = priv->get_matches(impl::MATCH_KEY, pressed.get_modifiers(), pressed.get_key());
+    for (auto& binding : matches.keys)
     {
-        if (binding->activated_by->get_value() == pressed)
+        /* We must be careful because the callback might be erased,
+         * so force copy the callback into the lambda */
+        auto callback = binding->callback;
+        callbacks.emplace_back([pressed, callback] ()
         {
-            /* We must be careful because the callback might be erased,
-             * so force copy the callback into the lambda */
-            auto callback = binding->callback;
-            callbacks.emplace_back([pressed, callback] ()
-            {
-                return (*callback)(pressed);
-            });
-        }
+            return (*callback)(pressed);
+        });
     }
 
-    for (auto& binding : this->priv->activators)
+    for (auto& binding : matches.activators)
     {
-        if (binding->activated_by->get_value().has_match(pressed))
+        /* We must be careful because the callback might be erased,
+         * so force copy the callback into the lambda */
+        auto callback = binding->callback;
+        callbacks.emplace_back([pressed, callback, mod_binding_key] ()
         {
-            /* We must be careful because the callback might be erased,
-             * so force copy the callback into the lambda */
-            auto callback = binding->callback;
-            callbacks.emplace_back([pressed, callback, mod_binding_key] ()
-            {
-                wf::activator_data_t ev = {
-                    .source = activator_source_t::KEYBINDING,
-                    .activation_data = pressed.get_key()
-                };
+            wf::activator_data_t ev = {
+                .source = activator_source_t::KEYBINDING,
+                .activation_data = pressed.get_key()
+            };
 
-                if (mod_binding_key)
-                {
-                    ev.source = activator_source_t::MODIFIERBINDING;
-                    ev.activation_data = mod_binding_key;
-                }
+            if (mod_binding_key)
+            {
+                ev.source = activator_source_t::MODIFIERBINDING;
+                ev.activation_data = mod_binding_key;
+            }
 
-                return (*callback)(ev);
-            });
-        }
+            return (*callback)(ev);
+        });
     }
 
     bool handled = false;
@@ -112,13 +110,9 @@ bool wf::bindings_repository_t::handle_axis(uint32_t modifiers,
     }
 
     std::vector<wf::axis_callback*> callbacks;
-
-    for (auto& binding : this->priv->axes)
+    for (auto& binding : priv->get_matches(impl::MATCH_AXIS, modifiers, 0).axes)
     {
-        if (binding->activated_by->get_value() == wf::keybinding_t{modifiers, 0})
-        {
-            callbacks.push_back(binding->callback);
-        }
+        callbacks.push_back(binding->callback);
     }
 
     for (auto call : callbacks)
@@ -137,36 +131,31 @@ bool wf::bindings_repository_t::handle_button(const wf::buttonbinding_t& pressed
     }
 
     std::vector<std::function<bool()>> callbacks;
-    for (auto& binding : this->priv->buttons)
+    auto& matches = priv->get_matches(impl::MATCH_BUTTON, pressed.get_modifiers(), pressed.get_button());
+    for (auto& binding : matches.buttons)
     {
-        if (binding->activated_by->get_value() == pressed)
+        /* We must be careful because the callback might be erased,
+         * so force copy the callback into the lambda */
+        auto callback = binding->callback;
+        callbacks.emplace_back([=] ()
         {
-            /* We must be careful because the callback might be erased,
-             * so force copy the callback into the lambda */
-            auto callback = binding->callback;
-            callbacks.emplace_back([=] ()
-            {
-                return (*callback)(pressed);
-            });
-        }
+            return (*callback)(pressed);
+        });
     }
 
-    for (auto& binding : this->priv->activators)
+    for (auto& binding : matches.activators)
     {
-        if (binding->activated_by->get_value().has_match(pressed))
+        /* We must be careful because the callback might be erased,
+         * so force copy the callback into the lambda */
+        auto callback = binding->callback;
+        callbacks.emplace_back([=] ()
         {
-            /* We must be careful because the callback might be erased,
-             * so force copy the callback into the lambda */
-            auto callback = binding->callback;
-            callbacks.emplace_back([=] ()
-            {
-                wf::activator_data_t data = {
-                    .source = activator_source_t::BUTTONBINDING,
-                    .activation_data = pressed.get_button(),
-                };
-                return (*callback)(data);
-            });
-        }
+            wf::activator_data_t data = {
+                .source = activator_source_t::BUTTONBINDING,
+                .activation_data = pressed.get_button(),
+            };
+            return (*callback)(data);
+        });
     }
 
     bool binding_handled = false;
@@ -178,6 +167,11 @@ bool wf::bindings_repository_t::handle_button(const wf::buttonbinding_t& pressed
     return binding_handled;
 }
 
+bool wf::bindings_repository_t::has_gesture_bindings(wf::touch_gesture_type_t type)
+{
+    return priv->enabled && priv->has_gesture_bindings(type);
+}
+
 void wf::bindings_repository_t::handle_gesture(const wf::touchgesture_t& gesture)
 {
     if (!priv->enabled)
@@ -186,22 +180,19 @@ void wf::bindings_repository_t::handle_gesture(const wf::touchgesture_t& gesture
     }
 
     std::vector<std::function<void()>> callbacks;
-    for (auto& binding : this->priv->activators)
+    for (auto& binding : priv->get_matches(gesture).activators)
     {
-        if (binding->activated_by->get_value().has_match(gesture))
+        /* We must be careful because the callback might be erased,
+         * so force copy the callback into the lambda */
+        auto callback = binding->callback;
+        callbacks.emplace_back([=] ()
         {
-            /* We must be careful because the callback might be erased,
-             * so force copy the callback into the lambda */
-            auto callback = binding->callback;
-            callbacks.emplace_back([=] ()
-            {
-                wf::activator_data_t data = {
-                    .source = activator_source_t::GESTURE,
-                    .activation_data = 0
-                };
-                (*callback)(data);
-            });
-        }
+            wf::activator_data_t data = {
+                .source = activator_source_t::GESTURE,
+                .activation_data = 0
+            };
+            (*callback)(data);
+        });
     }
 
     for (auto& cb : callbacks)
@@ -262,6 +253,7 @@ void wf::bindings_repository_t::rem_binding(void *callback)
     erase(priv->buttons);
     erase(priv->axes);
     erase(priv->activators);
+    priv->invalidate_matches();
 
     if (update_hotspots)
     {
@@ -277,6 +269,7 @@ void wf::bindings_repository_t::set_enabled(bool enabled)
 
 void wf::bindings_repository_t::impl::reparse_extensions()
 {
+    invalidate_matches();
     for (auto& binding : this->activators)
     {
         binding->tags.clear();
@@ -20,9 +20,12 @@ wf::cursor_t::cursor_t(wf::seat_t *seat)
     wlr_cursor_warp(cursor, NULL, cursor->x, cursor->y);
     init_xcursor();
 
-    config_reloaded = [=] (auto)
+    config_reloaded = [=] (wf::reload_config_signal *ev)
     {
-        init_xcursor();
+        if (ev->may_have_changed("input"))
+        {
+            init_xcursor();
+        }
     };
 
     wf::get_core().connect(&config_reloaded);
@@ -46,7 +49,7 @@ void wf::cursor_t::setup_listeners()
     on_frame.set_callback([&] (void*)
     {
         seat->priv->lpointer->handle_pointer_frame();
-        wf::get_core().seat->notify_activity();
+        notify_activity();
     });
     on_frame.connect(&cursor->events.frame);
 
@@ -58,7 +61,7 @@ void wf::cursor_t::setup_listeners()
         if (mode != wf::input_event_processing_mode_t::IGNORE) \
         { \
             seat->priv->lpointer->handle_pointer_ ## evname(ev, mode); \
-            wf::get_core().seat->notify_activity(); \
+            notify_activity(); \
         } \
         emit_device_post_event_signal(ev, &ev->pointer->base); \
     }); \
@@ -92,7 +95,7 @@ void wf::cursor_t::setup_listeners()
                 static_cast<wf::tablet_t*>(ev->tablet->data); \
             tablet->handle_ ## evname(ev, handling_mode); \
         } \
-        wf::get_core().seat->notify_activity(); \
+        notify_activity(); \
         emit_device_post_event_signal(ev, &ev->tablet->base); \
     }); \
     on_tablet_ ## evname.connect(&cursor->events.tablet_tool_ ## evname);
@@ -104,6 +107,11 @@ void wf::cursor_t::setup_listeners()
 #undef setup_tablet_callback
 }
 
+void wf::cursor_t::notify_activity()
+{
+    idle_notify_activity.run_once([] () { wf::get_core().seat->notify_activity(); });
+}
+
 void wf::cursor_t::init_xcursor()
 {
     std::string theme = wf::option_wrapper_t<std::string>("input/cursor_theme");
@@ -50,6 +50,13 @@ struct cursor_t
     void init_xcursor();
     void setup_listeners();
 
+    /**
+     * Report user activity once the queued device events have been processed,
+     * instead of once per event, which adds up with high-rate pointers.
+     */
+    wf::wl_idle_call idle_notify_activity;
+    void notify_activity();
+
     // Device event listeners
     wf::wl_listener_wrapper on_button, on_motion, on_motion_absolute, on_axis,
 
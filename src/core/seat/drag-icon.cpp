@@ -135,6 +135,7 @@ wf::drag_icon_t::drag_icon_t(wlr_drag_icon *ic) : icon(ic)
     on_map.set_callback([=] (void*)
     {
         wf::scene::set_node_enabled(root_node, true);
+        update_position();
     });
     on_unmap.set_callback([&] (void*)
     {
@@ -184,11 +185,24 @@ wf::point_t wf::drag_icon_t::get_position()
 
 void wf::drag_icon_t::update_position()
 {
+    // An unmapped icon is not drawn, and it is damaged when it is mapped again.
+    if (!root_node->is_enabled())
+    {
+        return;
+    }
+
+    auto box = wf::construct_box(get_position(),
+        {icon->surface->current.width, icon->surface->current.height});
+    if (box == last_box)
+    {
+        // Motion events are reported more often than the icon moves by a whole pixel.
+        return;
+    }
+
     // damage previous position
     wf::region_t dmg_region;
     dmg_region |= last_box;
-    last_box    =
-        wf::construct_box(get_position(), {icon->surface->current.width, icon->surface->current.height});
+    last_box    = box;
     dmg_region |= last_box;
     scene::damage_node(root_node, dmg_region);
 }
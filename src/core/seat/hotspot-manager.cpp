@@ -3,7 +3,7 @@
 #include <wayfire/output-layout.hpp>
 #include <wayfire/touch/touch.hpp>
 
-void wf::hotspot_instance_t::process_input_motion(wf::pointf_t gc)
+void wf::hotspot_instance_t::process_input_motion(wf::pointf_t gc, wf::output_t *target)
 {
     const auto& reset_hotspot = [&] ()
     {
@@ -11,7 +11,6 @@ void wf::hotspot_instance_t::process_input_motion(wf::pointf_t gc)
         this->armed = true;
     };
 
-    auto target = wf::get_core().output_layout->get_output_coords_at(gc, gc);
     if (target != last_output)
     {
         reset_hotspot();
@@ -102,10 +101,6 @@ void wf::hotspot_instance_t::recalc_geometry() noexcept
 wf::hotspot_instance_t::hotspot_instance_t(uint32_t edges, uint32_t along, uint32_t away, int32_t timeout,
     std::function<void(uint32_t)> callback)
 {
-    wf::get_core().connect(&on_motion_event);
-    wf::get_core().connect(&on_motion_event);
-    wf::get_core().connect(&on_touch_motion);
-
     this->edges = edges;
     this->along = along;
     this->away  = away;
@@ -113,8 +108,10 @@ wf::hotspot_instance_t::hotspot_instance_t(uint32_t edges, uint32_t along, uint3
     this->callback   = callback;
 
     recalc_geometry();
+}
 
-    // callbacks
+wf::hotspot_manager_t::hotspot_manager_t()
+{
     on_tablet_axis = [=] (wf::post_input_event_signal<wlr_tablet_tool_axis_event> *ev)
     {
         process_input_motion(wf::get_core().get_cursor_position());
@@ -135,9 +132,77 @@ wf::hotspot_instance_t::hotspot_instance_t(uint32_t edges, uint32_t along, uint3
     };
 }
 
+void wf::hotspot_manager_t::process_input_motion(wf::pointf_t gc)
+{
+    if (hotspots.empty())
+    {
+        return;
+    }
+
+    auto output = wf::get_core().output_layout->get_output_coords_at(gc, gc);
+
+    // The edges of the output which are close enough to the cursor for a hotspot to contain it.
+    uint32_t near_edges = 0;
+    if (output)
+    {
+        auto og = output->get_layout_geometry();
+        near_edges |= (gc.x < og.x + max_reach) ? OUTPUT_EDGE_LEFT : 0;
+        near_edges |= (gc.x >= og.x + og.width - max_reach) ? OUTPUT_EDGE_RIGHT : 0;
+        near_edges |= (gc.y < og.y + max_reach) ? OUTPUT_EDGE_TOP : 0;
+        near_edges |= (gc.y >= og.y + og.height - max_reach) ? OUTPUT_EDGE_BOTTOM : 0;
+    }
+
+    // Hotspots which were entered before have to notice when the cursor leaves them.
+    auto previous = std::move(non_idle);
+    non_idle.clear();
+    for (auto& hotspot : previous)
+    {
+        hotspot->process_input_motion(gc, output);
+        if (!hotspot->is_idle())
+        {
+            non_idle.push_back(hotspot);
+        }
+    }
+
+    if (!near_edges)
+    {
+        return;
+    }
+
+    for (uint32_t edges = 0; edges < 16; edges++)
+    {
+        // All edges of a hotspot have to be close, the hotspot touches all of them.
+        if (edges & ~near_edges)
+        {
+            continue;
+        }
+
+        for (auto& hotspot : by_edges[edges])
+        {
+            if (std::find(previous.begin(), previous.end(), hotspot) != previous.end())
+            {
+                continue;
+            }
+
+            hotspot->process_input_motion(gc, output);
+            if (!hotspot->is_idle())
+            {
+                non_idle.push_back(hotspot);
+            }
+        }
+    }
+}
+
 void wf::hotspot_manager_t::update_hotspots(const container_t& activators)
 {
     hotspots.clear();
+    non_idle.clear();
+    for (auto& list : by_edges)
+    {
+        list.clear();
+    }
+
+    max_reach = 0;
     for (const auto& opt : activators)
     {
         auto opt_hotspots = opt->activated_by->get_value().get_hotspots();
@@ -155,7 +220,21 @@ void wf::hotspot_manager_t::update_hotspots(const container_t& activators)
 
             auto instance = std::make_unique<hotspot_instance_t>(hs.get_edges(),
                 hs.get_size_along_edge(), hs.get_size_away_from_edge(), hs.get_timeout(), callback);
+            by_edges[instance->get_edges() & 15].push_back(instance.get());
+            max_reach = std::max(max_reach, instance->get_reach());
             hotspots.push_back(std::move(instance));
         }
     }
+
+    if (hotspots.empty())
+    {
+        wf::get_core().disconnect(&on_tablet_axis);
+        wf::get_core().disconnect(&on_motion_event);
+        wf::get_core().disconnect(&on_touch_motion);
+    } else if (!on_motion_event.is_connected())
+    {
+        wf::get_core().connect(&on_tablet_axis);
+        wf::get_core().connect(&on_motion_event);
+        wf::get_core().connect(&on_touch_motion);
+    }
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "wayfire/util.hpp"
+#include <algorithm>
 #include <wayfire/config/types.hpp>
 #include <wayfire/output.hpp>
 #include <wayfire/util/log.hpp>
@@ -18,6 +19,17 @@ struct binding_t
     wf::option_sptr_t<Option> activated_by;
     Callback *callback;
     std::vector<std::any> tags;
+
+    /** Called when the value of the option changes, while the binding exists. */
+    wf::config::option_base_t::updated_callback_t on_changed;
+
+    ~binding_t()
+    {
+        if (on_changed)
+        {
+            activated_by->rem_updated_handler(&on_changed);
+        }
+    }
 };
 
 template<class Option, class Callback> using binding_container_t =
@@ -33,6 +45,27 @@ class hotspot_instance_t
     hotspot_instance_t(uint32_t edges, uint32_t along, uint32_t away, int32_t timeout,
         std::function<void(uint32_t)> callback);
 
+    /** Update state based on input motion to @gc, which is on @output */
+    void process_input_motion(wf::pointf_t gc, wf::output_t *output);
+
+    /** The edges of the hotspot */
+    uint32_t get_edges() const
+    {
+        return edges;
+    }
+
+    /** How far the hotspot can extend from the edges of the output */
+    int32_t get_reach() const
+    {
+        return __builtin_popcount(edges) == 2 ? std::max(along, away) : away;
+    }
+
+    /** Whether the hotspot is waiting for the cursor to enter, so it needs no update while it is away */
+    bool is_idle()
+    {
+        return armed && !timer.is_connected();
+    }
+
   private:
     /** The possible hotspot rectangles */
     wf::geometry_t hotspot_geometry[2];
@@ -59,13 +92,6 @@ class hotspot_instance_t
     /** Callback to execute */
     std::function<void(uint32_t)> callback;
 
-    wf::signal::connection_t<wf::post_input_event_signal<wlr_tablet_tool_axis_event>> on_tablet_axis;
-    wf::signal::connection_t<wf::post_input_event_signal<wlr_pointer_motion_event>> on_motion_event;
-    wf::signal::connection_t<wf::post_input_event_signal<wlr_touch_motion_event>> on_touch_motion;
-
-    /** Update state based on input motion */
-    void process_input_motion(wf::pointf_t gc);
-
     /** Calculate a rectangle with size @dim inside @og at the correct edges. */
     wf::geometry_t pin(wf::dimensions_t dim) noexcept;
 
@@ -76,17 +102,32 @@ class hotspot_instance_t
 /**
  * Manages hotspot bindings on the given output.
  * A part of the bindings_repository_t.
+ *
+ * Hotspots are indexed by their edges, so that a motion event only updates the hotspots at the edges the
+ * cursor is close to, and those which need to notice that the cursor has left them.
  */
 class hotspot_manager_t
 {
   public:
-    hotspot_manager_t()
-    {}
+    hotspot_manager_t();
 
     using container_t = binding_container_t<activatorbinding_t, activator_callback>;
     void update_hotspots(const container_t& activators);
 
   private:
     std::vector<std::unique_ptr<hotspot_instance_t>> hotspots;
+
+    /** The hotspots, indexed by their edges */
+    std::vector<hotspot_instance_t*> by_edges[16];
+    /** The maximal reach of all hotspots */
+    int32_t max_reach = 0;
+    /** Hotspots which were not idle after the last motion */
+    std::vector<hotspot_instance_t*> non_idle;
+
+    void process_input_motion(wf::pointf_t gc);
+
+    wf::signal::connection_t<wf::post_input_event_signal<wlr_tablet_tool_axis_event>> on_tablet_axis;
+    wf::signal::connection_t<wf::post_input_event_signal<wlr_pointer_motion_event>> on_motion_event;
+    wf::signal::connection_t<wf::post_input_event_signal<wlr_touch_motion_event>> on_touch_motion;
 };
 }
@@ -0,0 +1,171 @@
+#include "input-latency.hpp"
+#include <wayfire/debug.hpp>
+#include <wayfire/util/log.hpp>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <unordered_map>
+
+namespace
+{
+/** Number of samples kept for each latency */
+constexpr size_t WINDOW = 256;
+/** Pending input older than this (in microseconds) is dropped, the surface will most likely not respond */
+constexpr int64_t MAX_PENDING_AGE = 1'000'000;
+/** Submitted frames without a present event after this many newer frames are dropped */
+constexpr size_t MAX_FRAMES_IN_FLIGHT = 4;
+
+struct committed_input_t
+{
+    wf::input_latency::pending_input_t input;
+    int64_t committed;
+};
+
+struct sample_window_t
+{
+    std::vector<int64_t> values;
+    size_t next = 0;
+
+    void push(int64_t value)
+    {
+        if (values.size() < WINDOW)
+        {
+            values.push_back(value);
+        } else
+        {
+            values[next] = value;
+        }
+
+        next = (next + 1) % WINDOW;
+    }
+};
+
+struct output_latency_t
+{
+    /** Commits which have not been submitted in a frame yet */
+    std::vector<committed_input_t> commits;
+    /** Commits in each submitted frame which has not been presented yet, oldest frame first */
+    std::deque<std::vector<committed_input_t>> in_flight;
+
+    sample_window_t input_to_commit;
+    sample_window_t commit_to_present;
+    sample_window_t input_to_present;
+};
+
+std::unordered_map<wlr_surface*, wf::input_latency::pending_input_t> pending_inputs;
+std::map<wf::output_t*, output_latency_t> outputs;
+}
+
+void wf::input_latency::note_input(wlr_surface *surface, int64_t received, const std::string& source)
+{
+    if (!surface)
+    {
+        return;
+    }
+
+    // Drop input the surfaces never responded to, for example because the client was idle.
+    for (auto it = pending_inputs.begin(); it != pending_inputs.end();)
+    {
+        if (received - it->second.received > MAX_PENDING_AGE)
+        {
+            it = pending_inputs.erase(it);
+        } else
+        {
+            ++it;
+        }
+    }
+
+    if (!pending_inputs.count(surface))
+    {
+        pending_inputs[surface] = pending_input_t{received, source};
+    }
+}
+
+wf::input_latency::pending_input_t wf::input_latency::take_input(wlr_surface *surface)
+{
+    auto it = pending_inputs.find(surface);
+    if (it == pending_inputs.end())
+    {
+        return {};
+    }
+
+    auto input = std::move(it->second);
+    pending_inputs.erase(it);
+    return input;
+}
+
+void wf::input_latency::forget_surface(wlr_surface *surface)
+{
+    pending_inputs.erase(surface);
+}
+
+void wf::input_latency::note_commit(wf::output_t *output, const pending_input_t& input, int64_t committed)
+{
+    auto& data = outputs[output];
+    data.commits.push_back({input, committed});
+    data.input_to_commit.push(committed - input.received);
+}
+
+void wf::input_latency::note_frame_submitted(wf::output_t *output, int64_t paint_start)
+{
+    // Keep track of all frames, even without commits, so that present events are matched correctly.
+    auto& data = outputs[output];
+    std::vector<committed_input_t> in_frame;
+    auto late = std::stable_partition(data.commits.begin(), data.commits.end(),
+        [&] (const committed_input_t& c) { return c.committed <= paint_start; });
+    in_frame.assign(data.commits.begin(), late);
+    data.commits.erase(data.commits.begin(), late);
+
+    data.in_flight.push_back(std::move(in_frame));
+    if (data.in_flight.size() > MAX_FRAMES_IN_FLIGHT)
+    {
+        data.in_flight.pop_front();
+    }
+}
+
+void wf::input_latency::note_frame_presented(wf::output_t *output, bool presented, int64_t when)
+{
+    auto it = outputs.find(output);
+    if ((it == outputs.end()) || it->second.in_flight.empty())
+    {
+        return;
+    }
+
+    auto& data = it->second;
+    auto frame = std::move(data.in_flight.front());
+    data.in_flight.pop_front();
+    if (!presented)
+    {
+        // The commits will be shown in one of the next frames instead.
+        data.commits.insert(data.commits.begin(), frame.begin(), frame.end());
+        return;
+    }
+
+    for (auto& c : frame)
+    {
+        data.commit_to_present.push(when - c.committed);
+        data.input_to_present.push(when - c.input.received);
+        LOGC(LATENCY, "Input from ", c.input.source, " presented on ", output->to_string(),
+            ": input->commit ", c.committed - c.input.received, "us, commit->present ",
+            when - c.committed, "us, input->present ", when - c.input.received, "us");
+    }
+}
+
+wf::input_latency::samples_t wf::input_latency::get_samples(wf::output_t *output)
+{
+    samples_t samples;
+    auto it = outputs.find(output);
+    if (it != outputs.end())
+    {
+        samples.input_to_commit   = it->second.input_to_commit.values;
+        samples.commit_to_present = it->second.commit_to_present.values;
+        samples.input_to_present  = it->second.input_to_present.values;
+    }
+
+    return samples;
+}
+
+void wf::input_latency::forget_output(wf::output_t *output)
+{
+    outputs.erase(output);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <wayfire/output.hpp>
+#include <wayfire/nonstd/wlroots.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace wf
+{
+/**
+ * Tracing of the latency between input events, the client commits they cause and the presentation of those
+ * commits on an output.
+ *
+ * An input event is attributed to the surface it was sent to, and the next commit of a buffer on that surface
+ * is taken as the client's response. The commit is then followed until the first frame which contains it is
+ * presented on the outputs where the surface is visible.
+ *
+ * Each completed sample is logged in the LATENCY logging category.
+ */
+namespace input_latency
+{
+/** The time of the oldest input event which the client has not answered with a commit yet */
+struct pending_input_t
+{
+    int64_t received = -1;
+    std::string source;
+};
+
+/**
+ * An input event which was received at @received (in microseconds, monotonic clock) was sent to @surface.
+ * Only the oldest event is kept until the surface commits.
+ *
+ * @param source A description of where the event came from, typically the input device name.
+ */
+void note_input(wlr_surface *surface, int64_t received, const std::string& source);
+
+/**
+ * The surface has committed a new buffer.
+ *
+ * @return The oldest input event the commit answers, with received = -1 if there was none.
+ */
+pending_input_t take_input(wlr_surface *surface);
+
+/** Drop all pending input for a surface which is being destroyed. */
+void forget_surface(wlr_surface *surface);
+
+/** A commit which answers @input and happened at @committed is going to be shown on @output. */
+void note_commit(wf::output_t *output, const pending_input_t& input, int64_t committed);
+
+/** A frame which contains all commits before @paint_start was submitted on the output. */
+void note_frame_submitted(wf::output_t *output, int64_t paint_start);
+
+/** The oldest submitted frame on the output was presented, or discarded if @presented is false. */
+void note_frame_presented(wf::output_t *output, bool presented, int64_t when);
+
+/** The last samples of each latency, in microseconds */
+struct samples_t
+{
+    std::vector<int64_t> input_to_commit;
+    std::vector<int64_t> commit_to_present;
+    std::vector<int64_t> input_to_present;
+};
+
+samples_t get_samples(wf::output_t *output);
+
+/** Drop all data for an output which is being destroyed. */
+void forget_output(wf::output_t *output);
+}
+}
@@ -22,6 +22,12 @@ wf::input_method_relay::input_method_relay()
         //
         // Example apps (all GTK4): gnome-font-viewer, easyeffects
         auto& seat = wf::get_core_impl().seat;
+        if (!input_method)
+        {
+            // The text input is entered when an input method appears.
+            return;
+        }
+
         if (auto focus = seat->priv->keyboard_focus)
         {
             if (auto view = wf::node_to_view(focus))
@@ -56,14 +62,10 @@ wf::input_method_relay::input_method_relay()
         on_grab_keyboard.connect(&input_method->events.grab_keyboard);
         on_new_popup_surface.connect(&input_method->events.new_popup_surface);
 
-        auto *text_input = find_focusable_text_input();
-        if (text_input)
-        {
-            wlr_text_input_v3_send_enter(
-                text_input->input,
-                text_input->pending_focused_surface);
-            text_input->set_pending_focused_surface(nullptr);
-        }
+        // Focus is tracked only while there is an input method, catch up with the current one.
+        wf::get_core().connect(&keyboard_focus_changed);
+        auto view = wf::node_to_view(wf::get_core_impl().seat->priv->keyboard_focus);
+        set_focus(view ? view->get_wlr_surface() : nullptr);
     });
 
     on_input_method_commit.set_callback([&] (void *data)
@@ -124,17 +126,18 @@ wf::input_method_relay::input_method_relay()
         on_grab_keyboard.disconnect();
         on_grab_keyboard_destroy.disconnect();
         on_new_popup_surface.disconnect();
+        keyboard_focus_changed.disconnect();
         input_method  = nullptr;
         keyboard_grab = nullptr;
 
-        auto *text_input = find_focused_text_input();
-        if (text_input != nullptr)
+        // The text inputs are entered again when the next input method appears.
+        for (auto& text_input : text_inputs)
         {
-            /* keyboard focus is still there, keep the surface at hand in case the IM
-             * returns */
-            text_input->set_pending_focused_surface(text_input->input->
-                focused_surface);
-            wlr_text_input_v3_send_leave(text_input->input);
+            text_input->sent_state.reset();
+            if (text_input->input->focused_surface)
+            {
+                wlr_text_input_v3_send_leave(text_input->input);
+            }
         }
     });
 
@@ -174,23 +177,47 @@ wf::input_method_relay::input_method_relay()
     {
         on_text_input_new.connect(&wf::get_core().protocols.text_input->events.text_input);
         on_input_method_new.connect(&wf::get_core().protocols.input_method->events.input_method);
-        wf::get_core().connect(&keyboard_focus_changed);
     }
 }
 
-void wf::input_method_relay::send_im_state(wlr_text_input_v3 *input)
+void wf::input_method_relay::send_im_state(text_input *input, bool full)
 {
-    wlr_input_method_v2_send_surrounding_text(
-        input_method,
-        input->current.surrounding.text,
-        input->current.surrounding.cursor,
-        input->current.surrounding.anchor);
-    wlr_input_method_v2_send_text_change_cause(
-        input_method,
-        input->current.text_change_cause);
-    wlr_input_method_v2_send_content_type(input_method,
-        input->current.content_type.hint,
-        input->current.content_type.purpose);
+    const auto& current = input->input->current;
+    text_input::state_t state;
+    state.surrounding_text = current.surrounding.text ?: "";
+    state.cursor  = current.surrounding.cursor;
+    state.anchor  = current.surrounding.anchor;
+    state.cause   = current.text_change_cause;
+    state.hint    = current.content_type.hint;
+    state.purpose = current.content_type.purpose;
+
+    // Only the fields which changed since the last done event are sent, and nothing at all if the client
+    // committed without changing anything the input method knows about.
+    const auto& sent = input->sent_state;
+    full |= !sent.has_value();
+    if (!full && (state == *sent))
+    {
+        return;
+    }
+
+    if (full || (state.surrounding_text != sent->surrounding_text) || (state.cursor != sent->cursor) ||
+        (state.anchor != sent->anchor))
+    {
+        wlr_input_method_v2_send_surrounding_text(input_method,
+            current.surrounding.text, state.cursor, state.anchor);
+    }
+
+    if (full || (state.cause != sent->cause))
+    {
+        wlr_input_method_v2_send_text_change_cause(input_method, state.cause);
+    }
+
+    if (full || (state.hint != sent->hint) || (state.purpose != sent->purpose))
+    {
+        wlr_input_method_v2_send_content_type(input_method, state.hint, state.purpose);
+    }
+
+    input->sent_state = std::move(state);
     send_im_done();
 }
 
@@ -220,7 +247,7 @@ void wf::input_method_relay::disable_text_input(wlr_text_input_v3 *input)
     }
 
     wlr_input_method_v2_send_deactivate(input_method);
-    send_im_state(input);
+    send_im_state(focused_input, true);
 }
 
 void wf::input_method_relay::remove_text_input(wlr_text_input_v3 *input)
@@ -246,12 +273,6 @@ bool wf::input_method_relay::should_grab(wlr_keyboard *kbd)
 
 bool wf::input_method_relay::is_im_sent(wlr_keyboard *kbd)
 {
-    struct wlr_virtual_keyboard_v1 *virtual_keyboard = wlr_input_device_get_virtual_keyboard(&kbd->base);
-    if (!virtual_keyboard)
-    {
-        return false;
-    }
-
     // We have already identified the device as IM-based device
     auto device_impl = (wf::input_device_impl_t*)kbd->base.data;
     if (device_impl->is_im_keyboard)
@@ -259,18 +280,25 @@ bool wf::input_method_relay::is_im_sent(wlr_keyboard *kbd)
         return true;
     }
 
-    if (this->input_method)
+    if (!this->input_method)
     {
-        // This is a workaround because we do not have sufficient information to know which virtual keyboards
-        // are connected to IMs
-        auto im_client   = wl_resource_get_client(input_method->resource);
-        auto vkbd_client = wl_resource_get_client(virtual_keyboard->resource);
+        return false;
+    }
 
-        if (im_client == vkbd_client)
-        {
-            device_impl->is_im_keyboard = true;
-            return true;
-        }
+    struct wlr_virtual_keyboard_v1 *virtual_keyboard = wlr_input_device_get_virtual_keyboard(&kbd->base);
+    if (!virtual_keyboard)
+    {
+        return false;
+    }
+
+    // This is a workaround because we do not have sufficient information to know which virtual keyboards
+    // are connected to IMs
+    auto im_client   = wl_resource_get_client(input_method->resource);
+    auto vkbd_client = wl_resource_get_client(virtual_keyboard->resource);
+    if (im_client == vkbd_client)
+    {
+        device_impl->is_im_keyboard = true;
+        return true;
     }
 
     return false;
@@ -301,21 +329,6 @@ bool wf::input_method_relay::handle_modifier(struct wlr_keyboard *kbd)
     return true;
 }
 
-wf::text_input*wf::input_method_relay::find_focusable_text_input()
-{
-    auto it = std::find_if(text_inputs.begin(), text_inputs.end(),
-        [&] (const auto & text_input)
-    {
-        return text_input->pending_focused_surface != nullptr;
-    });
-    if (it != text_inputs.end())
-    {
-        return it->get();
-    }
-
-    return nullptr;
-}
-
 wf::text_input*wf::input_method_relay::find_focused_text_input()
 {
     auto it = std::find_if(text_inputs.begin(), text_inputs.end(),
@@ -335,16 +348,8 @@ void wf::input_method_relay::set_focus(wlr_surface *surface)
 {
     for (auto & text_input : text_inputs)
     {
-        if (text_input->pending_focused_surface != nullptr)
+        if (text_input->input->focused_surface != nullptr)
         {
-            assert(text_input->input->focused_surface == nullptr);
-            if (surface != text_input->pending_focused_surface)
-            {
-                text_input->set_pending_focused_surface(nullptr);
-            }
-        } else if (text_input->input->focused_surface != nullptr)
-        {
-            assert(text_input->pending_focused_surface == nullptr);
             if (surface != text_input->input->focused_surface)
             {
                 disable_text_input(text_input->input);
@@ -359,13 +364,7 @@ void wf::input_method_relay::set_focus(wlr_surface *surface)
         if (surface && (wl_resource_get_client(text_input->input->resource) ==
                         wl_resource_get_client(surface->resource)))
         {
-            if (input_method)
-            {
-                wlr_text_input_v3_send_enter(text_input->input, surface);
-            } else
-            {
-                text_input->set_pending_focused_surface(surface);
-            }
+            wlr_text_input_v3_send_enter(text_input->input, surface);
         }
     }
 }
@@ -374,7 +373,7 @@ wf::input_method_relay::~input_method_relay()
 {}
 
 wf::text_input::text_input(wf::input_method_relay *rel, wlr_text_input_v3 *in) :
-    relay(rel), input(in), pending_focused_surface(nullptr)
+    relay(rel), input(in)
 {
     on_text_input_enable.set_callback([&] (void *data)
     {
@@ -389,7 +388,7 @@ wf::text_input::text_input(wf::input_method_relay *rel, wlr_text_input_v3 *in) :
         }
 
         wlr_input_method_v2_send_activate(relay->input_method);
-        relay->send_im_state(input);
+        relay->send_im_state(this, true);
     });
 
     on_text_input_commit.set_callback([&] (void *data)
@@ -411,7 +410,7 @@ wf::text_input::text_input(wf::input_method_relay *rel, wlr_text_input_v3 *in) :
             return;
         }
 
-        relay->send_im_state(input);
+        relay->send_im_state(this);
     });
 
     on_text_input_disable.set_callback([&] (void *data)
@@ -432,7 +431,6 @@ wf::text_input::text_input(wf::input_method_relay *rel, wlr_text_input_v3 *in) :
             relay->disable_text_input(wlr_text_input);
         }
 
-        set_pending_focused_surface(nullptr);
         on_text_input_enable.disconnect();
         on_text_input_commit.disconnect();
         on_text_input_disable.disconnect();
@@ -442,33 +440,12 @@ wf::text_input::text_input(wf::input_method_relay *rel, wlr_text_input_v3 *in) :
         relay->remove_text_input(wlr_text_input);
     });
 
-    on_pending_focused_surface_destroy.set_callback([&] (void *data)
-    {
-        auto surface = static_cast<wlr_surface*>(data);
-        assert(pending_focused_surface == surface);
-        pending_focused_surface = nullptr;
-        on_pending_focused_surface_destroy.disconnect();
-    });
-
     on_text_input_enable.connect(&input->events.enable);
     on_text_input_commit.connect(&input->events.commit);
     on_text_input_disable.connect(&input->events.disable);
     on_text_input_destroy.connect(&input->events.destroy);
 }
 
-void wf::text_input::set_pending_focused_surface(wlr_surface *surface)
-{
-    pending_focused_surface = surface;
-
-    if (surface == nullptr)
-    {
-        on_pending_focused_surface_destroy.disconnect();
-    } else
-    {
-        on_pending_focused_surface_destroy.connect(&surface->events.destroy);
-    }
-}
-
 wf::text_input::~text_input()
 {}
 
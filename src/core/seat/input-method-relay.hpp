@@ -7,6 +7,8 @@
 
 #include <vector>
 #include <memory>
+#include <optional>
+#include <string>
 
 namespace wf
 {
@@ -25,9 +27,9 @@ class input_method_relay : public text_input_v3_im_relay_interface_t
     uint32_t next_done_serial = 0;
     void send_im_done();
 
-    text_input *find_focusable_text_input();
     void set_focus(wlr_surface*);
 
+    /* Connected only while there is an input method */
     wf::signal::connection_t<wf::keyboard_focus_changed_signal> keyboard_focus_changed =
         [=] (wf::keyboard_focus_changed_signal *ev)
     {
@@ -49,7 +51,12 @@ class input_method_relay : public text_input_v3_im_relay_interface_t
     std::vector<std::shared_ptr<text_input_v3_popup>> popup_surfaces;
 
     input_method_relay();
-    void send_im_state(wlr_text_input_v3*);
+    /**
+     * Send the state of the text input to the input method, followed by a done event.
+     *
+     * @param full Send all fields, otherwise only those which changed since the last done event.
+     */
+    void send_im_state(text_input*, bool full = false);
     text_input *find_focused_text_input();
     wlr_text_input_v3 *find_focused_text_input_v3() override;
     void disable_text_input(wlr_text_input_v3*);
@@ -65,15 +72,30 @@ struct text_input
 {
     input_method_relay *relay = nullptr;
     wlr_text_input_v3 *input  = nullptr;
-    /* A place to keep the focused surface when no input method exists
-     * (when the IM returns, it would get that surface instantly) */
-    wlr_surface *pending_focused_surface = nullptr;
-    wf::wl_listener_wrapper on_pending_focused_surface_destroy,
-        on_text_input_enable, on_text_input_commit,
+    wf::wl_listener_wrapper on_text_input_enable, on_text_input_commit,
         on_text_input_disable, on_text_input_destroy;
 
+    /* The state of the text input as last sent to the input method */
+    struct state_t
+    {
+        std::string surrounding_text;
+        uint32_t cursor  = 0;
+        uint32_t anchor  = 0;
+        uint32_t cause   = 0;
+        uint32_t hint    = 0;
+        uint32_t purpose = 0;
+
+        bool operator ==(const state_t& other) const
+        {
+            return (surrounding_text == other.surrounding_text) && (cursor == other.cursor) &&
+                   (anchor == other.anchor) && (cause == other.cause) && (hint == other.hint) &&
+                   (purpose == other.purpose);
+        }
+    };
+
+    std::optional<state_t> sent_state;
+
     text_input(input_method_relay*, wlr_text_input_v3*);
-    void set_pending_focused_surface(wlr_surface*);
     ~text_input();
 };
 }
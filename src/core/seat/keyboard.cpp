@@ -11,6 +11,7 @@
 #include "touch.hpp"
 #include "input-manager.hpp"
 #include "input-method-relay.hpp"
+#include "input-latency.hpp"
 #include "wayfire/signal-definitions.hpp"
 
 void wf::keyboard_t::setup_listeners()
@@ -23,10 +24,13 @@ void wf::keyboard_t::setup_listeners()
 
     on_key.set_callback([&] (void *data)
     {
+        const int64_t received = wf::get_current_time_usec();
         auto ev    = static_cast<wlr_keyboard_key_event*>(data);
         auto mode  = emit_device_event_signal(ev, &handle->base);
         auto& seat = wf::get_core_impl().seat;
-        wf::get_core().seat->notify_activity();
+
+        // Reporting activity is not urgent, and when keys are typed quickly, once is enough.
+        idle_notify_activity.run_once([] () { wf::get_core().seat->notify_activity(); });
 
         if (mode == input_event_processing_mode_t::IGNORE)
         {
@@ -82,6 +86,8 @@ void wf::keyboard_t::setup_listeners()
                 LOGC(IM, "key=", ev->keycode, " state=", ev->state, " sent to node.");
                 seat->priv->keyboard_focus->keyboard_interaction()
                     .handle_keyboard_key(wf::get_core().seat.get(), *ev);
+                input_latency::note_input(seat->seat->keyboard_state.focused_surface, received,
+                    nonull(handle->base.name));
             }
         } else
         {
@@ -129,6 +135,7 @@ wf::keyboard_t::keyboard_t(wlr_input_device *dev) :
 
     repeat_rate.load_option("input/kb_repeat_rate");
     repeat_delay.load_option("input/kb_repeat_delay");
+    modifier_binding_timeout.load_option("input/modifier_binding_timeout");
 
     // When the configuration options change, mark them as dirty.
     // They are applied at the config-reloaded signal.
@@ -337,13 +344,13 @@ bool wf::keyboard_t::handle_keyboard_key(uint32_t key, uint32_t state)
             return true;
         }
 
-        bool modifiers_only = !seat->priv->lpointer->has_pressed_buttons() &&
+        /* as long as we have pressed only modifiers, we should check for modifier
+         * bindings on release */
+        const bool modifiers_only = mod && !seat->priv->lpointer->has_pressed_buttons() &&
             (seat->priv->touch->get_state().fingers.empty()) &&
             this->has_only_modifiers();
 
-        /* as long as we have pressed only modifiers, we should check for modifier
-         * bindings on release */
-        if (mod && modifiers_only)
+        if (modifiers_only)
         {
             mod_binding_start = steady_clock::now();
             mod_binding_key   = key;
@@ -358,8 +365,7 @@ bool wf::keyboard_t::handle_keyboard_key(uint32_t key, uint32_t state)
     {
         if (mod_binding_key != 0)
         {
-            int timeout = wf::option_wrapper_t<int>(
-                "input/modifier_binding_timeout");
+            int timeout = modifier_binding_timeout;
             auto time_elapsed = duration_cast<milliseconds>(
                 steady_clock::now() - mod_binding_start);
 
@@ -38,6 +38,7 @@ class keyboard_t
 
   private:
     wf::wl_listener_wrapper on_key, on_modifier;
+    wf::wl_idle_call idle_notify_activity;
     void setup_listeners();
 
     wf::signal::connection_t<wf::reload_config_signal> on_config_reload;
@@ -45,6 +46,7 @@ class keyboard_t
 
     wf::option_wrapper_t<std::string> model, variant, layout, options, rules;
     wf::option_wrapper_t<int> repeat_rate, repeat_delay;
+    wf::option_wrapper_t<int> modifier_binding_timeout;
     /** Options have changed in the config file */
     bool dirty_options = true;
 
@@ -3,8 +3,10 @@
 #include "cursor.hpp"
 #include "pointing-device.hpp"
 #include "input-manager.hpp"
+#include "input-latency.hpp"
 #include "wayfire/scene.hpp"
 #include "wayfire/signal-definitions.hpp"
+#include "wayfire/unstable/wlr-surface-node.hpp"
 
 #include <wayfire/debug.hpp>
 #include <wayfire/util/log.hpp>
@@ -33,6 +35,10 @@ wf::pointer_t::pointer_t(nonstd::observer_ptr<wf::input_manager_t> input,
     };
 
     wf::get_core().scene()->connect(&on_root_node_updated);
+    idle_flush_motion.set_callback([=] ()
+    {
+        flush_coalesced_motion();
+    });
 }
 
 wf::pointer_t::~pointer_t()
@@ -68,7 +74,7 @@ bool wf::pointer_t::focus_enabled() const
     return this->focus_enabled_count > 0;
 }
 
-void wf::pointer_t::update_cursor_position(int64_t time_msec)
+void wf::pointer_t::update_cursor_position(int64_t time_msec, bool coalesce)
 {
     wf::pointf_t gc = seat->priv->cursor->get_cursor_position();
 
@@ -76,17 +82,85 @@ void wf::pointer_t::update_cursor_position(int64_t time_msec)
      * events to the grabbed surface, even if the pointer goes outside of it.
      * This enables Xwayland DnD to work correctly, and also lets the user for
      * ex. grab a scrollbar and move their mouse freely. */
-    if (!grabbed_node && this->focus_enabled())
+    const bool needs_focus = !grabbed_node && this->focus_enabled();
+
+    /* While the pointer stays inside the focused surface, the (full) focus
+     * update and the motion sent to the focus can wait until all queued motion
+     * events have been processed, so that high-rate devices cause only one
+     * update per event loop iteration. The surface may still be covered by
+     * another one at the new position, which is fixed up by the refocus when
+     * the event loop goes idle. */
+    if (coalesce && (!needs_focus || focus_contains_cursor(gc)))
+    {
+        refocus_pending    |= needs_focus;
+        pending_motion_time = time_msec;
+        idle_flush_motion.run_once();
+        return;
+    }
+
+    flush_coalesced_motion();
+    if (needs_focus)
     {
-        const auto& scene = wf::get_core().scene();
-        auto isec = scene->find_node_at(gc);
-        update_cursor_focus(isec ? isec->node->shared_from_this() : nullptr);
+        refocus();
     }
 
     this->send_motion(time_msec);
     seat->priv->update_drag_icon();
 }
 
+void wf::pointer_t::refocus()
+{
+    refocus_pending = false;
+    if (grabbed_node || !this->focus_enabled())
+    {
+        return;
+    }
+
+    const auto& scene = wf::get_core().scene();
+    auto isec = scene->find_node_at(seat->priv->cursor->get_cursor_position());
+    update_cursor_focus(isec ? isec->node->shared_from_this() : nullptr);
+}
+
+void wf::pointer_t::flush_pending_refocus()
+{
+    if (refocus_pending)
+    {
+        refocus();
+    }
+}
+
+void wf::pointer_t::flush_coalesced_motion()
+{
+    idle_flush_motion.disconnect();
+    flush_pending_refocus();
+    if (pending_motion_time)
+    {
+        const int64_t time_msec = *pending_motion_time;
+        pending_motion_time.reset();
+        this->send_motion(time_msec);
+        seat->priv->update_drag_icon();
+    }
+
+    if (pending_frame)
+    {
+        pending_frame = false;
+        wlr_seat_pointer_notify_frame(seat->seat);
+    }
+}
+
+bool wf::pointer_t::focus_contains_cursor(const wf::pointf_t& gc)
+{
+    // Only surfaces have cheap and exact input tests, other nodes (grabs, decorations) are always refocused.
+    auto surface_node = dynamic_cast<wf::scene::wlr_surface_node_t*>(cursor_focus.get());
+    if (!surface_node || !surface_node->get_surface())
+    {
+        return false;
+    }
+
+    auto local = get_node_local_coords(surface_node, gc);
+    return wlr_surface_point_accepts_input(surface_node->get_surface(), local.x, local.y);
+}
+
 void wf::pointer_t::send_leave_to_focus(wf::scene::node_ptr old_focus)
 {
     if (old_focus)
@@ -177,8 +251,9 @@ void wf::pointer_t::update_cursor_focus(wf::scene::node_ptr new_focus)
     }
 }
 
-wf::scene::node_ptr wf::pointer_t::get_focus() const
+wf::scene::node_ptr wf::pointer_t::get_focus()
 {
+    flush_pending_refocus();
     return this->cursor_focus;
 }
 
@@ -206,6 +281,7 @@ void wf::pointer_t::grab_surface(wf::scene::node_ptr node)
 void wf::pointer_t::handle_pointer_button(wlr_pointer_button_event *ev,
     input_event_processing_mode_t mode)
 {
+    flush_coalesced_motion();
     seat->priv->break_mod_bindings();
     bool handled_in_binding = (mode != input_event_processing_mode_t::FULL);
 
@@ -267,6 +343,7 @@ void wf::pointer_t::send_button(wlr_pointer_button_event *ev, bool has_binding)
             LOGC(POINTER, "normal button press ", ev->button);
             this->currently_sent_buttons.insert(ev->button);
             cursor_focus->pointer_interaction().handle_pointer_button(*ev);
+            note_input_sent(nonull(ev->pointer->base.name));
         } else if ((ev->state == WLR_BUTTON_RELEASED) &&
                    (currently_sent_buttons.count(ev->button) || cursor_focus->wants_raw_input()))
         {
@@ -304,6 +381,7 @@ void wf::pointer_t::send_motion(uint32_t time_msec)
             // infinite loops.
             last_focus_coords = local;
             cursor_focus->pointer_interaction().handle_pointer_motion(local, time_msec);
+            note_input_sent("pointer motion");
         }
     }
 }
@@ -313,7 +391,7 @@ void wf::pointer_t::handle_pointer_motion(wlr_pointer_motion_event *ev,
 {
     /* XXX: maybe warp directly? */
     wlr_cursor_move(seat->priv->cursor->cursor, &ev->pointer->base, ev->delta_x, ev->delta_y);
-    update_cursor_position(ev->time_msec);
+    update_cursor_position(ev->time_msec, true);
 }
 
 void wf::pointer_t::handle_pointer_motion_absolute(
@@ -333,12 +411,13 @@ void wf::pointer_t::handle_pointer_motion_absolute(
 
     // TODO: indirection via wf_cursor
     wlr_cursor_warp_closest(seat->priv->cursor->cursor, NULL, cx, cy);
-    update_cursor_position(ev->time_msec);
+    update_cursor_position(ev->time_msec, true);
 }
 
 void wf::pointer_t::handle_pointer_axis(wlr_pointer_axis_event *ev,
     input_event_processing_mode_t mode)
 {
+    flush_coalesced_motion();
     bool handled_in_binding = wf::get_core().bindings->handle_axis(
         seat->priv->get_modifiers(), ev);
     seat->priv->break_mod_bindings();
@@ -361,12 +440,19 @@ void wf::pointer_t::handle_pointer_axis(wlr_pointer_axis_event *ev,
     if (cursor_focus)
     {
         cursor_focus->pointer_interaction().handle_pointer_axis(*ev);
+        note_input_sent(nonull(ev->pointer->base.name));
     }
 }
 
+void wf::pointer_t::note_input_sent(const std::string& source)
+{
+    input_latency::note_input(seat->seat->pointer_state.focused_surface, wf::get_current_time_usec(), source);
+}
+
 void wf::pointer_t::handle_pointer_swipe_begin(wlr_pointer_swipe_begin_event *ev,
     input_event_processing_mode_t mode)
 {
+    flush_coalesced_motion();
     wlr_pointer_gestures_v1_send_swipe_begin(
         wf::get_core().protocols.pointer_gestures, seat->seat,
         ev->time_msec, ev->fingers);
@@ -391,6 +477,7 @@ void wf::pointer_t::handle_pointer_swipe_end(wlr_pointer_swipe_end_event *ev,
 void wf::pointer_t::handle_pointer_pinch_begin(wlr_pointer_pinch_begin_event *ev,
     input_event_processing_mode_t mode)
 {
+    flush_coalesced_motion();
     wlr_pointer_gestures_v1_send_pinch_begin(
         wf::get_core().protocols.pointer_gestures, seat->seat,
         ev->time_msec, ev->fingers);
@@ -415,6 +502,7 @@ void wf::pointer_t::handle_pointer_pinch_end(wlr_pointer_pinch_end_event *ev,
 void wf::pointer_t::handle_pointer_hold_begin(wlr_pointer_hold_begin_event *ev,
     input_event_processing_mode_t mode)
 {
+    flush_coalesced_motion();
     wlr_pointer_gestures_v1_send_hold_begin(
         wf::get_core().protocols.pointer_gestures, seat->seat,
         ev->time_msec, ev->fingers);
@@ -430,5 +518,12 @@ void wf::pointer_t::handle_pointer_hold_end(wlr_pointer_hold_end_event *ev,
 
 void wf::pointer_t::handle_pointer_frame()
 {
+    // The frame belongs to the coalesced motion, so it has to be sent after it.
+    if (pending_motion_time)
+    {
+        pending_frame = true;
+        return;
+    }
+
     wlr_seat_pointer_notify_frame(seat->seat);
 }
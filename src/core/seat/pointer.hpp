@@ -40,7 +40,7 @@ class pointer_t
     void set_enable_focus(bool enabled = true);
 
     /** Get the currenntlly set cursor focus */
-    wf::scene::node_ptr get_focus() const;
+    wf::scene::node_ptr get_focus();
 
     /** Handle events coming from the input devices */
     void handle_pointer_axis(wlr_pointer_axis_event *ev,
@@ -79,8 +79,12 @@ class pointer_t
      * surface currently under the pointer.
      *
      * @param time_msec The time when the event causing this update occurred
+     * @param coalesce Whether the surface under the pointer may be updated
+     *   later, when the event loop goes idle, if the pointer is still inside
+     *   the input region of the focused surface. Used for motion events, many
+     *   of which may arrive in the same event loop iteration.
      */
-    void update_cursor_position(int64_t time_msec);
+    void update_cursor_position(int64_t time_msec, bool coalesce = false);
 
     /**
      * Transfer focus and pressed buttons to the given grab.
@@ -106,6 +110,22 @@ class pointer_t
 
     /** The surface which currently has cursor focus */
     wf::scene::node_ptr cursor_focus = nullptr;
+
+    /**
+     * Recompute the cursor focus and send the last position to it once the
+     * coalesced motion events have been processed.
+     */
+    wf::wl_idle_call idle_flush_motion;
+    bool refocus_pending = false;
+    std::optional<int64_t> pending_motion_time;
+    bool pending_frame = false;
+    void refocus();
+    /** Refocus now if a refocus is pending */
+    void flush_pending_refocus();
+    /** Refocus and send the coalesced motion now, needed before sending non-motion events */
+    void flush_coalesced_motion();
+    /** Whether the cursor is still inside the input region of the focused surface */
+    bool focus_contains_cursor(const wf::pointf_t& gc);
     /** Whether focusing is enabled */
     int focus_enabled_count = 1;
     bool focus_enabled() const;
@@ -140,6 +160,9 @@ class pointer_t
      */
     void send_motion(uint32_t time_msec);
 
+    /** Record that an input event from @source was sent to the focused surface, see input_latency. */
+    void note_input_sent(const std::string& source);
+
     /**
      * Send synthetic button release events to the old cursor focus.
      */
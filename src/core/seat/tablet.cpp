@@ -127,6 +127,16 @@ void wf::tablet_tool_t::update_tool_position(bool real_update)
     {
         focus_node = this->grabbed_node;
         local = get_node_local_coords(focus_node.get(), gc);
+    } else if (real_update && proximity_surface_contains(gc))
+    {
+        /* Tablets report positions at a high rate. While the tool stays over
+         * the same surface, clients get every position right away, but the
+         * full focus update waits until the queued events have been processed.
+         * The surface may be covered by another one at the new position, which
+         * is fixed up then. */
+        focus_node = this->proximity_surface;
+        local = get_node_local_coords(focus_node.get(), gc);
+        idle_refocus.run_once([=] () { update_tool_position(false); });
     } else
     {
         auto input_node = wf::get_core().scene()->find_node_at(gc);
@@ -147,8 +157,26 @@ void wf::tablet_tool_t::update_tool_position(bool real_update)
     }
 }
 
+bool wf::tablet_tool_t::proximity_surface_contains(const wf::pointf_t& gc)
+{
+    wlr_surface *surface = wlr_surface_from_node(this->proximity_surface);
+    if (!surface)
+    {
+        return false;
+    }
+
+    auto local = get_node_local_coords(this->proximity_surface.get(), gc);
+    return wlr_surface_point_accepts_input(surface, local.x, local.y);
+}
+
 bool wf::tablet_tool_t::set_focus(wf::scene::node_ptr surface)
 {
+    // Nothing changes, so do not restack Xwayland surfaces or resend proximity events.
+    if (surface && (surface == this->proximity_surface))
+    {
+        return false;
+    }
+
     bool focus_changed = surface != this->proximity_surface;
 
     /* Unfocus old surface */
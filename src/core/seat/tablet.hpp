@@ -31,6 +31,9 @@ struct tablet_tool_t
     /** Set the proximity surface */
     bool set_focus(scene::node_ptr node);
 
+    /** Whether the given point is in the input region of the proximity surface */
+    bool proximity_surface_contains(const wf::pointf_t& gc);
+
     void reset_grab();
 
     /**
@@ -65,6 +68,9 @@ struct tablet_tool_t
     /** Surface where the tool was grabbed */
     scene::node_ptr grabbed_node = nullptr;
 
+    /** Recompute the focus once the coalesced axis events have been processed */
+    wf::wl_idle_call idle_refocus;
+
     double tilt_x = 0.0;
     double tilt_y = 0.0;
 
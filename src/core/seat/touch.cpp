@@ -178,10 +178,26 @@ void wf::touch_interface_t::transfer_grab(scene::node_ptr grab_node)
 
 void wf::touch_interface_t::update_gestures(const wf::touch::gesture_event_t& ev)
 {
+    const bool sequence_start = (this->finger_state.fingers.size() == 1) &&
+        (ev.type == touch::EVENT_TYPE_TOUCH_DOWN);
+    if (sequence_start)
+    {
+        for (auto& def : default_gestures)
+        {
+            def.active = wf::get_core().bindings->has_gesture_bindings(def.type);
+        }
+    }
+
     for (auto& gesture : this->gestures)
     {
-        if ((this->finger_state.fingers.size() == 1) &&
-            (ev.type == touch::EVENT_TYPE_TOUCH_DOWN))
+        auto def = std::find_if(default_gestures.begin(), default_gestures.end(),
+            [&] (const default_gesture_t& entry) { return entry.gesture == gesture; });
+        if ((def != default_gestures.end()) && !def->active)
+        {
+            continue;
+        }
+
+        if (sequence_start)
         {
             gesture->reset(ev.time);
         }
@@ -550,4 +566,9 @@ void wf::touch_interface_t::add_default_gestures()
     this->add_touch_gesture(this->multiswipe);
     this->add_touch_gesture(this->edgeswipe);
     this->add_touch_gesture(this->multipinch);
+    default_gestures = {
+        {this->multiswipe, GESTURE_TYPE_SWIPE},
+        {this->edgeswipe, GESTURE_TYPE_EDGE_SWIPE},
+        {this->multipinch, GESTURE_TYPE_PINCH},
+    };
 }
@@ -74,6 +74,19 @@ class touch_interface_t
     void update_gestures(const wf::touch::gesture_event_t& event);
     std::vector<nonstd::observer_ptr<touch::gesture_t>> gestures;
 
+    /**
+     * The default gestures are only recognized if there are bindings for them. Whether they run is decided
+     * when the first finger touches down, so that they always see whole sequences of events.
+     */
+    struct default_gesture_t
+    {
+        nonstd::observer_ptr<touch::gesture_t> gesture;
+        wf::touch_gesture_type_t type;
+        bool active = false;
+    };
+
+    std::vector<default_gesture_t> default_gestures;
+
     wf::signal::connection_t<wf::scene::root_node_update_signal>
     on_root_node_updated;
 
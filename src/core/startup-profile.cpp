@@ -0,0 +1,107 @@
+#include "startup-profile.hpp"
+#include <wayfire/util.hpp>
+#include <wayfire/util/log.hpp>
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+struct event_t
+{
+    std::string name;
+    int64_t start;
+    /** The duration of the phase, or -1 for events without a duration and for unfinished phases */
+    int64_t duration;
+    int depth;
+};
+
+std::vector<event_t> timeline;
+int64_t start_time = 0;
+int current_depth  = 0;
+
+int add_event(const std::string& name)
+{
+    timeline.push_back({name, wf::get_current_time_usec() - start_time, -1, current_depth});
+    return timeline.size() - 1;
+}
+
+std::string format_msec(int64_t usec)
+{
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1) << std::setw(8) << usec / 1000.0 << " ms";
+    return out.str();
+}
+}
+
+bool wf::startup_profile::enabled = false;
+
+void wf::startup_profile::enable()
+{
+    enabled    = true;
+    start_time = wf::get_current_time_usec();
+    timeline.clear();
+    add_event("main()");
+}
+
+void wf::startup_profile::mark(const std::string& event)
+{
+    if (enabled)
+    {
+        add_event(event);
+    }
+}
+
+void wf::startup_profile::mark_once(const std::string& event)
+{
+    if (enabled && std::none_of(timeline.begin(), timeline.end(), [&] (auto& e) { return e.name == event; }))
+    {
+        add_event(event);
+    }
+}
+
+void wf::startup_profile::finish(const std::string& event)
+{
+    if (!enabled)
+    {
+        return;
+    }
+
+    add_event(event);
+    enabled = false;
+
+    LOGI("Startup timeline (start, duration, phase):");
+    for (auto& e : timeline)
+    {
+        const std::string duration = (e.duration >= 0) ? format_msec(e.duration) : std::string(11, ' ');
+        LOGI(format_msec(e.start), " ", duration, " ", std::string(2 * e.depth, ' '), e.name);
+    }
+
+    timeline.clear();
+    timeline.shrink_to_fit();
+}
+
+wf::startup_profile::scope_t::scope_t(const std::string& name)
+{
+    if (enabled)
+    {
+        index = add_event(name);
+        current_depth++;
+    }
+}
+
+wf::startup_profile::scope_t::~scope_t()
+{
+    if (index < 0)
+    {
+        return;
+    }
+
+    current_depth--;
+    // The timeline is cleared if the first frame was presented while the phase was running.
+    if (enabled && (index < (int)timeline.size()))
+    {
+        timeline[index].duration = wf::get_current_time_usec() - start_time - timeline[index].start;
+    }
+}
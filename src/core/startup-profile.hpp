@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+
+namespace wf
+{
+/**
+ * A timeline of the startup of the compositor, from main() until the first frame is presented on an output.
+ *
+ * When enabled with --profile-startup, the different startup phases record when they start and how long they
+ * take. As soon as the first frame is presented, the whole timeline is printed to the log and recording
+ * stops, so the markers cost only a branch afterwards.
+ */
+namespace startup_profile
+{
+/** Whether the startup is being profiled at the moment. */
+extern bool enabled;
+
+/** Start profiling. All times are relative to the call of this function. */
+void enable();
+
+/** Record an event without a duration. */
+void mark(const std::string& event);
+
+/** Record an event, unless an event with the same name has already been recorded. */
+void mark_once(const std::string& event);
+
+/** Record the final event, print the timeline and stop profiling. */
+void finish(const std::string& event);
+
+/**
+ * Records a phase which lasts until the end of the object's lifetime. Phases may be nested.
+ */
+class scope_t
+{
+  public:
+    scope_t(const std::string& name);
+    ~scope_t();
+
+    scope_t(const scope_t&) = delete;
+    scope_t& operator =(const scope_t&) = delete;
+
+  private:
+    /** The index of the phase in the timeline, or -1 if the startup is not profiled */
+    int index = -1;
+};
+}
+}
@@ -0,0 +1,222 @@
+#include "wayfire/thread-pool.hpp"
+#include "wayfire/core.hpp"
+#include "wayfire/debug.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <dlfcn.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace
+{
+/** The shared object which contains @owner, so that a plugin can tag its jobs with any of its addresses. */
+const void *get_owner_object(const void *owner)
+{
+    Dl_info info;
+    if (owner && dladdr(owner, &info) && info.dli_fbase)
+    {
+        return info.dli_fbase;
+    }
+
+    return owner;
+}
+}
+
+struct wf::thread_pool_t::impl
+{
+    struct job_t
+    {
+        job_callback_t work;
+        job_callback_t done;
+        const void *owner;
+    };
+
+    mutable std::mutex mutex;
+    std::condition_variable work_available;
+    std::condition_variable job_finished;
+    std::deque<job_t> queued;
+    std::deque<job_t> finished;
+    // The owners of the running jobs
+    std::vector<const void*> running;
+    std::vector<std::thread> threads;
+    bool stopping = false;
+    thread_pool_stats_t stats;
+
+    int event_fd = -1;
+    wl_event_source *event_source = nullptr;
+
+    void start()
+    {
+        event_fd     = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        event_source = wl_event_loop_add_fd(wf::get_core().ev_loop, event_fd, WL_EVENT_READABLE,
+            [] (int fd, uint32_t, void *data)
+        {
+            ((impl*)data)->dispatch_finished();
+            return 0;
+        }, this);
+
+        // One thread stays free for the compositor itself.
+        const int nr_threads = std::clamp<int>((int)std::thread::hardware_concurrency() - 1, 1, 4);
+        for (int i = 0; i < nr_threads; i++)
+        {
+            threads.emplace_back([this] { run_worker(); });
+        }
+
+        LOGD("Started thread pool with ", nr_threads, " threads");
+    }
+
+    void run_worker()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            work_available.wait(lock, [&] { return stopping || !queued.empty(); });
+            if (queued.empty())
+            {
+                // Jobs which are still queued at exit are finished first, for example writing a screenshot.
+                return;
+            }
+
+            auto job = std::move(queued.front());
+            queued.pop_front();
+            running.push_back(job.owner);
+
+            lock.unlock();
+            job.work();
+            // The work may hold state of the owner, which has to be gone once cancel() returns.
+            job.work = nullptr;
+            lock.lock();
+
+            running.erase(std::find(running.begin(), running.end(), job.owner));
+            stats.completed++;
+            if (job.done)
+            {
+                finished.push_back(std::move(job));
+                const uint64_t one = 1;
+                if (write(event_fd, &one, sizeof(one)) < 0)
+                {
+                    // The main loop is woken up already.
+                }
+            }
+
+            job_finished.notify_all();
+        }
+    }
+
+    void dispatch_finished()
+    {
+        uint64_t count;
+        if (read(event_fd, &count, sizeof(count)) < 0)
+        {
+            // Nothing to do, the counter is reset anyway.
+        }
+
+        std::deque<job_t> jobs;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::swap(jobs, finished);
+        }
+
+        for (auto& job : jobs)
+        {
+            job.done();
+        }
+    }
+
+    /** Move the jobs of @owner from @list to @removed. */
+    static void take_jobs(std::deque<job_t>& list, const void *owner, std::vector<job_t>& removed)
+    {
+        auto it = std::stable_partition(list.begin(), list.end(),
+            [&] (const job_t& job) { return job.owner != owner; });
+        std::move(it, list.end(), std::back_inserter(removed));
+        list.erase(it, list.end());
+    }
+
+    ~impl()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        work_available.notify_all();
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        if (event_source)
+        {
+            wl_event_source_remove(event_source);
+            close(event_fd);
+        }
+    }
+};
+
+wf::thread_pool_t::thread_pool_t()
+{
+    this->priv = std::make_unique<impl>();
+}
+
+wf::thread_pool_t::~thread_pool_t() = default;
+
+void wf::thread_pool_t::schedule(job_callback_t work, job_callback_t done, const void *owner)
+{
+    if (priv->threads.empty())
+    {
+        priv->start();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(priv->mutex);
+        priv->queued.push_back({std::move(work), std::move(done), get_owner_object(owner)});
+        priv->stats.max_queued = std::max(priv->stats.max_queued, priv->queued.size());
+    }
+
+    priv->work_available.notify_one();
+}
+
+void wf::thread_pool_t::cancel(const void *owner)
+{
+    if (!owner)
+    {
+        return;
+    }
+
+    owner = get_owner_object(owner);
+
+    // The callbacks are destroyed outside of the lock, they may hold arbitrary state.
+    std::vector<impl::job_t> removed;
+    {
+        std::unique_lock<std::mutex> lock(priv->mutex);
+        impl::take_jobs(priv->queued, owner, removed);
+        priv->job_finished.wait(lock, [&] ()
+        {
+            return std::find(priv->running.begin(), priv->running.end(), owner) == priv->running.end();
+        });
+        impl::take_jobs(priv->finished, owner, removed);
+        priv->stats.cancelled += removed.size();
+    }
+
+    if (!removed.empty())
+    {
+        LOGD("Cancelled ", removed.size(), " jobs in the thread pool");
+    }
+}
+
+wf::thread_pool_stats_t wf::thread_pool_t::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(priv->mutex);
+    auto stats = priv->stats;
+    stats.threads  = priv->threads.size();
+    stats.queued   = priv->queued.size();
+    stats.running  = priv->running.size();
+    stats.finished = priv->finished.size();
+    return stats;
+}
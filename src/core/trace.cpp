@@ -0,0 +1,120 @@
+#include <wayfire/trace.hpp>
+#include <wayfire/util.hpp>
+#include <wayfire/util/log.hpp>
+#include <fstream>
+#include <unordered_set>
+#include <vector>
+#include <unistd.h>
+
+namespace
+{
+struct trace_event_t
+{
+    const char *name;
+    int64_t start;
+    int64_t duration;
+};
+
+std::vector<trace_event_t> events;
+size_t capacity   = 0;
+size_t next_event = 0;
+
+void write_json_string(std::ostream& out, const char *str)
+{
+    out << '"';
+    for (; *str; ++str)
+    {
+        if ((*str == '"') || (*str == '\\'))
+        {
+            out << '\\';
+        }
+
+        out << *str;
+    }
+
+    out << '"';
+}
+}
+
+bool wf::trace::recording = false;
+
+void wf::trace::start(size_t capacity)
+{
+    ::capacity = std::max(capacity, size_t(1));
+    events.clear();
+    events.reserve(::capacity);
+    next_event = 0;
+    recording  = true;
+    LOGI("Recording up to ", ::capacity, " trace events");
+}
+
+void wf::trace::stop()
+{
+    recording = false;
+}
+
+int64_t wf::trace::now()
+{
+    return wf::get_current_time_usec();
+}
+
+void wf::trace::record(const char *name, int64_t start_usec, int64_t end_usec)
+{
+    if (!recording)
+    {
+        // Recording was stopped while the scope was active.
+        return;
+    }
+
+    trace_event_t event{name, start_usec, end_usec - start_usec};
+    if (events.size() < capacity)
+    {
+        events.push_back(event);
+    } else
+    {
+        events[next_event] = event;
+    }
+
+    next_event = (next_event + 1) % capacity;
+}
+
+const char*wf::trace::intern(const std::string& name)
+{
+    static std::unordered_set<std::string> names;
+    return names.insert(name).first->c_str();
+}
+
+int wf::trace::dump(const std::string& path)
+{
+    std::ofstream out{path};
+    if (!out)
+    {
+        LOGE("Failed to open ", path, " for writing trace events");
+        return -1;
+    }
+
+    const auto pid = getpid();
+    out << "{\"traceEvents\":[";
+
+    // The oldest event is the next one to be overwritten once the ring buffer is full.
+    const size_t first = (events.size() < capacity) ? 0 : next_event;
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        auto& event = events[(first + i) % events.size()];
+        out << (i ? ",\n" : "\n") << "{\"name\":";
+        write_json_string(out, event.name);
+        out << ",\"ph\":\"X\",\"ts\":" << event.start << ",\"dur\":" << event.duration <<
+            ",\"pid\":" << pid << ",\"tid\":" << pid << "}";
+    }
+
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    out.close();
+    if (!out)
+    {
+        LOGE("Failed to write trace events to ", path);
+        return -1;
+    }
+
+    LOGI("Wrote ", events.size(), " trace events to ", path);
+    return events.size();
+}
@@ -0,0 +1,77 @@
+#include "client-ack-stats.hpp"
+#include <algorithm>
+#include <map>
+
+namespace
+{
+/** Samples needed before the expected latency of a client is used */
+constexpr uint64_t MIN_SAMPLES = 4;
+
+std::map<std::string, wf::txn::client_ack_stats_t> clients;
+
+void add_sample(wf::txn::client_ack_stats_t& stats, int64_t latency)
+{
+    if (stats.acks + stats.timeouts == 0)
+    {
+        stats.avg_ack_usec       = latency;
+        stats.ack_deviation_usec = latency / 2;
+    } else
+    {
+        // The gains of TCP's retransmission timer, RFC 6298
+        const int64_t error = latency - stats.avg_ack_usec;
+        stats.avg_ack_usec += error / 8;
+        stats.ack_deviation_usec += (std::abs(error) - stats.ack_deviation_usec) / 4;
+    }
+
+    stats.max_ack_usec = std::max(stats.max_ack_usec, latency);
+}
+
+wf::txn::client_ack_stats_t& get_client(const std::string& app_id)
+{
+    auto& stats = clients[app_id];
+    stats.app_id = app_id;
+    return stats;
+}
+}
+
+void wf::txn::client_ack_stats::note_ack(const std::string& app_id, int64_t latency)
+{
+    auto& stats = get_client(app_id);
+    add_sample(stats, latency);
+    stats.acks++;
+}
+
+void wf::txn::client_ack_stats::note_timeout(const std::string& app_id, int64_t elapsed)
+{
+    auto& stats = get_client(app_id);
+    add_sample(stats, elapsed);
+    stats.timeouts++;
+}
+
+void wf::txn::client_ack_stats::note_split(const std::string& app_id)
+{
+    get_client(app_id).splits++;
+}
+
+int64_t wf::txn::client_ack_stats::expected_ack(const std::string& app_id)
+{
+    auto it = clients.find(app_id);
+    if ((it == clients.end()) || (it->second.acks + it->second.timeouts < MIN_SAMPLES))
+    {
+        return -1;
+    }
+
+    return it->second.avg_ack_usec + 4 * it->second.ack_deviation_usec;
+}
+
+std::vector<wf::txn::client_ack_stats_t> wf::txn::client_ack_stats::get_stats()
+{
+    std::vector<client_ack_stats_t> result;
+    for (auto& [app_id, stats] : clients)
+    {
+        result.push_back(stats);
+        result.back().expected_ack_usec = expected_ack(app_id);
+    }
+
+    return result;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <wayfire/txn/transaction-manager.hpp>
+#include <string>
+#include <vector>
+
+namespace wf
+{
+namespace txn
+{
+/**
+ * Statistics of how long the clients take to become ready after their state was committed in a transaction,
+ * grouped by app-id.
+ *
+ * The latency is tracked like the round-trip time in TCP, as a smoothed average together with the smoothed
+ * mean deviation, so that the expected latency of a client reacts quickly to changes without being thrown
+ * off by single outliers.
+ */
+namespace client_ack_stats
+{
+/** An object of a client with the given app-id became ready @latency microseconds after the commit */
+void note_ack(const std::string& app_id, int64_t latency);
+
+/** An object of a client was not ready after @elapsed microseconds, when the transaction timed out */
+void note_timeout(const std::string& app_id, int64_t elapsed);
+
+/** An object of a client held back the rest of a transaction, which was applied without it */
+void note_split(const std::string& app_id);
+
+/**
+ * Get the latency within which a client can be expected to become ready, in microseconds, or -1 if the
+ * client has not been seen often enough.
+ */
+int64_t expected_ack(const std::string& app_id);
+
+std::vector<client_ack_stats_t> get_stats();
+}
+}
+}
@@ -1,30 +1,71 @@
 #include "wayfire/signal-provider.hpp"
 #include "wayfire/txn/transaction.hpp"
 #include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
 #include <wayfire/txn/transaction-manager.hpp>
 #include <wayfire/debug.hpp>
-
-static bool transactions_intersect(const wf::txn::transaction_uptr& a, const wf::txn::transaction_uptr& b)
-{
-    const auto& obj_a = a->get_objects();
-    const auto& obj_b = b->get_objects();
-
-    return std::any_of(obj_a.begin(), obj_a.end(), [&] (const wf::txn::transaction_object_sptr& x)
-    {
-        return std::find(obj_b.begin(), obj_b.end(), x) != obj_b.end();
-    });
-}
+#include <wayfire/trace.hpp>
+#include <cxxabi.h>
+#include <cstdlib>
 
 struct wf::txn::transaction_manager_t::impl
 {
     impl()
     {
         idle_clear_done.set_callback([=] () { done.clear(); });
+        idle_commit.set_callback([=] () { consider_commit(); });
     }
 
-    void schedule_transaction(transaction_uptr tx)
+    /**
+     * Schedule a transaction for execution.
+     *
+     * @param batch Defer committing the transaction until the event loop is idle. Transactions for the same
+     *   objects which are scheduled in the meantime (for example one per pointer motion event during an
+     *   interactive resize) are merged into it, so that clients see only the latest state.
+     */
+    void schedule_transaction(transaction_uptr tx, bool batch = false)
     {
         LOGC(TXN, "Scheduling transaction ", tx.get());
+        stats.scheduled++;
+        if (group_depth > 0)
+        {
+            if (!group)
+            {
+                group = std::move(tx);
+                return;
+            }
+
+            for (auto& obj : tx->get_objects())
+            {
+                group->add_object(obj);
+            }
+
+            stats.merged++;
+            return;
+        }
+
+        enqueue_transaction(std::move(tx), batch);
+    }
+
+    void start_group()
+    {
+        group_depth++;
+    }
+
+    void end_group(bool batch = false)
+    {
+        wf::dassert(group_depth > 0, "end_group() without start_group()");
+        if ((--group_depth == 0) && group)
+        {
+            enqueue_transaction(std::move(group), batch);
+        }
+    }
+
+    void enqueue_transaction(transaction_uptr tx, bool batch)
+    {
+        const int64_t now = wf::get_current_time_usec();
+        timing[tx.get()] = {now, false};
 
         // Step 1: add any objects which are directly or indirectly connected to the objects in tx
         coalesce_transactions(tx);
@@ -33,41 +74,81 @@ struct wf::txn::transaction_manager_t::impl
         remove_conflicts(tx);
 
         // Step 3: schedule tx for execution. At this point, there are no conflicts in all pending txs
+        index_objects(pending_owner, tx.get(), tx.get());
         pending.push_back(std::move(tx));
-        consider_commit();
+        stats.max_pending = std::max(stats.max_pending, pending.size());
+        if (batch)
+        {
+            idle_commit.run_once();
+        } else
+        {
+            consider_commit();
+        }
     }
 
     void coalesce_transactions(const transaction_uptr& tx)
     {
-        while (true)
+        // The pending transactions are disjoint, so each object belongs to at most one of them. The objects
+        // of the merged transactions are appended to tx, and checked in turn for further pending owners.
+        coalesced.clear();
+        for (size_t i = 0; i < tx->get_objects().size(); i++)
         {
-            const size_t start_size = tx->get_objects().size();
-            for (auto& existing : pending)
+            auto it = pending_owner.find(tx->get_objects()[i].get());
+            if ((it != pending_owner.end()) && coalesced.insert(it->second).second)
             {
-                if (transactions_intersect(existing, tx))
+                for (auto& obj : it->second->get_objects())
                 {
-                    for (auto& obj : existing->get_objects())
-                    {
-                        tx->add_object(obj);
-                    }
+                    tx->add_object(obj);
                 }
             }
-
-            if (start_size == tx->get_objects().size())
-            {
-                // No new objects were added in the last iteration => done
-                break;
-            }
         }
     }
 
     void remove_conflicts(const transaction_uptr& tx)
     {
+        if (coalesced.empty())
+        {
+            return;
+        }
+
         auto it = std::remove_if(pending.begin(), pending.end(), [&] (const transaction_uptr& existing)
         {
-            return transactions_intersect(existing, tx);
+            if (!coalesced.count(existing.get()))
+            {
+                return false;
+            }
+
+            // The merged transaction has been waiting since the oldest transaction it replaces.
+            auto& merged = timing[existing.get()];
+            auto& result = timing[tx.get()];
+            result.scheduled = std::min(result.scheduled, merged.scheduled);
+            timing.erase(existing.get());
+            stats.merged++;
+
+            transaction_merged_signal ev;
+            ev.self = existing.get();
+            ev.into = tx.get();
+            existing->emit(&ev);
+            return true;
         });
         pending.erase(it, pending.end());
+        coalesced.clear();
+    }
+
+    /** Set the owner of the objects of @tx in @index to @owner, or remove them if it is null. */
+    static void index_objects(std::unordered_map<const transaction_object_t*, transaction_t*>& index,
+        const transaction_t *tx, transaction_t *owner)
+    {
+        for (auto& obj : tx->get_objects())
+        {
+            if (owner)
+            {
+                index[obj.get()] = owner;
+            } else
+            {
+                index.erase(obj.get());
+            }
+        }
     }
 
     // Try to commit as many transactions as possible
@@ -88,6 +169,13 @@ struct wf::txn::transaction_manager_t::impl
                 // directly inside commit().
             } else
             {
+                auto& info = timing[pending[idx].get()];
+                if (!info.blocked)
+                {
+                    info.blocked = true;
+                    stats.conflicts++;
+                }
+
                 ++idx;
             }
         }
@@ -95,16 +183,23 @@ struct wf::txn::transaction_manager_t::impl
 
     bool can_commit_transaction(const transaction_uptr& tx)
     {
-        return std::none_of(committed.begin(), committed.end(), [&] (const transaction_uptr& comm)
+        return std::none_of(tx->get_objects().begin(), tx->get_objects().end(), [&] (auto& obj)
         {
-            return transactions_intersect(tx, comm);
+            return committed_owner.count(obj.get());
         });
     }
 
     void do_commit(transaction_uptr tx)
     {
+        WF_TRACE_SCOPE("txn::commit");
+        index_objects(pending_owner, tx.get(), nullptr);
+        index_objects(committed_owner, tx.get(), tx.get());
         tx->connect(&on_tx_apply);
+        tx->connect(&on_tx_split);
+        timing[tx.get()].blocked = false;
+        stats.committed++;
         committed.push_back(std::move(tx));
+        stats.max_committed = std::max(stats.max_committed, committed.size());
         // Note: this might immediately trigger tx_apply if all objects are already ready!
         committed.back()->commit();
     }
@@ -112,10 +207,87 @@ struct wf::txn::transaction_manager_t::impl
     std::vector<transaction_uptr> done; // Temporary storage for transactions which are complete
     std::vector<transaction_uptr> committed;
     std::vector<transaction_uptr> pending;
+
+    // The transaction which each object of a pending or committed transaction belongs to. Both the pending
+    // and the committed transactions are disjoint, so that conflicts are found by looking up the objects of
+    // a transaction instead of comparing it with all other transactions.
+    std::unordered_map<const transaction_object_t*, transaction_t*> pending_owner;
+    std::unordered_map<const transaction_object_t*, transaction_t*> committed_owner;
+    // The pending transactions which are merged into the transaction being scheduled
+    std::unordered_set<const transaction_t*> coalesced;
+
+    // Transactions scheduled between start_group() and end_group() are merged into @group.
+    int group_depth = 0;
+    transaction_uptr group;
     wf::wl_idle_call idle_clear_done;
+    wf::wl_idle_call idle_commit;
+
+    struct timing_t
+    {
+        /** When the transaction, or the oldest transaction which was merged into it, was scheduled */
+        int64_t scheduled;
+        /** Whether the transaction is waiting on a committed transaction */
+        bool blocked;
+    };
+
+    std::unordered_map<const transaction_t*, timing_t> timing;
+    transaction_stats_t stats;
+
+    /** Update the statistics for a transaction which is being applied. */
+    void record_applied(transaction_applied_signal *ev)
+    {
+        // Same buckets as the frame time histograms
+        static constexpr int HISTOGRAM_BUCKETS = 21;
+        if (stats.latency_histogram.empty())
+        {
+            stats.latency_histogram.assign(HISTOGRAM_BUCKETS, 0);
+        }
+
+        auto it = timing.find(ev->self);
+        if (it != timing.end())
+        {
+            const int64_t latency = wf::get_current_time_usec() - it->second.scheduled;
+            int bucket = 0;
+            while ((bucket < HISTOGRAM_BUCKETS - 1) && ((int64_t(2) << bucket) <= latency))
+            {
+                ++bucket;
+            }
+
+            stats.latency_histogram[bucket]++;
+            stats.total_latency_usec += latency;
+            stats.max_latency_usec    = std::max(stats.max_latency_usec, latency);
+            timing.erase(it);
+        }
+
+        stats.applied++;
+        if (ev->timed_out)
+        {
+            stats.timed_out++;
+            const auto& ready = ev->self->get_ready_objects();
+            for (auto& obj : ev->self->get_objects())
+            {
+                if (std::find(ready.begin(), ready.end(), obj) == ready.end())
+                {
+                    stats.timeouts_by_type[get_object_type(*obj)]++;
+                }
+            }
+        }
+    }
+
+    static std::string get_object_type(const transaction_object_t& object)
+    {
+        int status;
+        const char *name   = typeid(object).name();
+        char *demangled    = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+        std::string result = (status == 0) ? demangled : name;
+        free(demangled);
+        return result;
+    }
 
     wf::signal::connection_t<transaction_applied_signal> on_tx_apply = [&] (transaction_applied_signal *ev)
     {
+        WF_TRACE_SCOPE("txn::applied");
+        record_applied(ev);
         // Move transactions which are done from committed to done.
         // They will be freed on next idle.
         auto it = std::find_if(committed.begin(), committed.end(), [&] (auto& existing)
@@ -123,8 +295,25 @@ struct wf::txn::transaction_manager_t::impl
             return existing.get() == ev->self;
         });
 
+        index_objects(committed_owner, ev->self, nullptr);
         done.push_back(std::move(*it));
         committed.erase(it);
         consider_commit();
     };
+
+    wf::signal::connection_t<transaction_split_signal> on_tx_split = [&] (transaction_split_signal *ev)
+    {
+        // The objects which were applied early are free for the next transactions. Splits are rare, so the
+        // index is simply searched for them.
+        const auto& remaining = ev->self->get_objects();
+        for (auto it = committed_owner.begin(); it != committed_owner.end();)
+        {
+            const bool applied = (it->second == ev->self) &&
+                std::none_of(remaining.begin(), remaining.end(),
+                    [&] (auto& obj) { return obj.get() == it->first; });
+            it = applied ? committed_owner.erase(it) : std::next(it);
+        }
+
+        consider_commit();
+    };
 };
@@ -3,6 +3,8 @@
 #include "transaction-manager-impl.hpp"
 #include "wayfire/debug.hpp"
 #include "wayfire/txn/transaction.hpp"
+#include <wayfire/option-wrapper.hpp>
+#include "client-ack-stats.hpp"
 
 wf::txn::transaction_manager_t::transaction_manager_t()
 {
@@ -11,12 +13,29 @@ wf::txn::transaction_manager_t::transaction_manager_t()
 
 wf::txn::transaction_manager_t::~transaction_manager_t() = default;
 
+static wf::option_wrapper_t<bool>& get_batch_transactions()
+{
+    static wf::option_wrapper_t<bool> batch_transactions{"core/batch_transactions"};
+    return batch_transactions;
+}
+
 void wf::txn::transaction_manager_t::schedule_transaction(wf::txn::transaction_uptr tx)
 {
     new_transaction_signal ev;
     ev.tx = tx.get();
     this->emit(&ev);
-    priv->schedule_transaction(std::move(tx));
+
+    priv->schedule_transaction(std::move(tx), get_batch_transactions());
+}
+
+void wf::txn::transaction_manager_t::start_group()
+{
+    priv->start_group();
+}
+
+void wf::txn::transaction_manager_t::end_group()
+{
+    priv->end_group(get_batch_transactions());
 }
 
 void wf::txn::transaction_manager_t::schedule_object(transaction_object_sptr object)
@@ -34,16 +53,60 @@ static bool is_contained(const std::vector<T>& objs, const T& object)
 
 bool wf::txn::transaction_manager_t::is_object_pending(transaction_object_sptr object) const
 {
-    return std::any_of(this->priv->pending.begin(), this->priv->pending.end(), [&] (auto& pending)
-    {
-        return is_contained(pending->get_objects(), object);
-    });
+    return this->priv->pending_owner.count(object.get());
 }
 
 bool wf::txn::transaction_manager_t::is_object_committed(transaction_object_sptr object) const
 {
-    return std::any_of(this->priv->committed.begin(), this->priv->committed.end(), [&] (auto& committed)
+    return this->priv->committed_owner.count(object.get());
+}
+
+std::vector<wf::txn::client_ack_stats_t> wf::txn::transaction_manager_t::get_client_ack_stats() const
+{
+    return client_ack_stats::get_stats();
+}
+
+wf::txn::transaction_stats_t wf::txn::transaction_manager_t::get_stats() const
+{
+    auto stats = priv->stats;
+    stats.pending_now   = priv->pending.size();
+    stats.committed_now = priv->committed.size();
+    return stats;
+}
+
+std::vector<wf::txn::transaction_info_t> wf::txn::transaction_manager_t::get_inflight_transactions() const
+{
+    const int64_t now = wf::get_current_time_usec();
+    std::vector<transaction_info_t> result;
+    auto add_transactions = [&] (const std::vector<transaction_uptr>& list, bool committed)
     {
-        return is_contained(committed->get_objects(), object);
-    });
+        for (auto& tx : list)
+        {
+            transaction_info_t info;
+            info.tx        = tx.get();
+            info.committed = committed;
+            info.blocked   = false;
+            info.age_usec  = 0;
+
+            auto it = priv->timing.find(tx.get());
+            if (it != priv->timing.end())
+            {
+                info.blocked  = it->second.blocked;
+                info.age_usec = now - it->second.scheduled;
+            }
+
+            const auto& ready = tx->get_ready_objects();
+            for (auto& obj : tx->get_objects())
+            {
+                info.objects.push_back({obj->stringify(), impl::get_object_type(*obj),
+                    is_contained(ready, obj)});
+            }
+
+            result.push_back(std::move(info));
+        }
+    };
+
+    add_transactions(priv->committed, true);
+    add_transactions(priv->pending, false);
+    return result;
 }
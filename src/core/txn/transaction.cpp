@@ -3,6 +3,8 @@
 #include <wayfire/txn/transaction.hpp>
 #include <sstream>
 #include <wayfire/debug.hpp>
+#include <algorithm>
+#include "client-ack-stats.hpp"
 
 std::string wf::txn::transaction_object_t::stringify() const
 {
@@ -19,6 +21,16 @@ wf::txn::transaction_t::transaction_t(uint64_t timeout, timer_setter_t timer_set
     this->on_object_ready = [=] (object_ready_signal *ev)
     {
         this->count_ready_objects++;
+        auto it = std::find_if(objects.begin(), objects.end(), [&] (auto& obj)
+        {
+            return obj.get() == ev->self;
+        });
+        if (it != objects.end())
+        {
+            this->ready_objects.push_back(*it);
+        }
+
+        client_ack_stats::note_ack(ev->self->get_app_id(), wf::get_current_time_usec() - commit_time);
         LOGC(TXNI, "Transaction ", this, " object ", ev->self->stringify(), " became ready (",
             count_ready_objects, "/", this->objects.size(), ")");
 
@@ -35,6 +47,11 @@ const std::vector<wf::txn::transaction_object_sptr>& wf::txn::transaction_t::get
     return this->objects;
 }
 
+const std::vector<wf::txn::transaction_object_sptr>& wf::txn::transaction_t::get_ready_objects() const
+{
+    return this->ready_objects;
+}
+
 void wf::txn::transaction_t::add_object(transaction_object_sptr object)
 {
     auto it = std::find(objects.begin(), objects.end(), object);
@@ -45,9 +62,15 @@ void wf::txn::transaction_t::add_object(transaction_object_sptr object)
     }
 }
 
+void wf::txn::transaction_t::set_adaptive_timeout(bool adaptive)
+{
+    this->adaptive_timeout = adaptive;
+}
+
 void wf::txn::transaction_t::commit()
 {
     LOGC(TXN, "Committing transaction ", this, " with timeout ", this->timeout);
+    this->commit_time = wf::get_current_time_usec();
     for (auto& obj : this->objects)
     {
         obj->connect(&on_object_ready);
@@ -59,13 +82,109 @@ void wf::txn::transaction_t::commit()
         apply(true);
         return false;
     });
+
+    if (adaptive_timeout && (count_ready_objects < (int)objects.size()))
+    {
+        plan_split();
+    }
+}
+
+void wf::txn::transaction_t::plan_split()
+{
+    // Minimal gap between the fast and the slow objects, so that splitting is worth giving up atomicity
+    static constexpr int64_t MIN_GAP_USEC = 16'000;
+
+    std::vector<int64_t> deadlines;
+    for (auto& obj : objects)
+    {
+        const int64_t expected = client_ack_stats::expected_ack(obj->get_app_id());
+        if (expected < 0)
+        {
+            // Unknown clients may be arbitrarily slow, we cannot tell which group they belong to.
+            return;
+        }
+
+        deadlines.push_back(expected);
+    }
+
+    std::sort(deadlines.begin(), deadlines.end());
+    for (size_t i = 0; i + 1 < deadlines.size(); i++)
+    {
+        if ((deadlines[i + 1] > 2 * deadlines[i]) && (deadlines[i + 1] - deadlines[i] >= MIN_GAP_USEC))
+        {
+            const int64_t split_ms = std::max<int64_t>(1, (deadlines[i] + 999) / 1000);
+            if (split_ms < (int64_t)timeout)
+            {
+                LOGC(TXN, "Transaction ", this, " will split slow objects after ", split_ms, "ms");
+                split_timer.set_timeout(split_ms, [=] ()
+                {
+                    split_stragglers();
+                    return false;
+                });
+            }
+
+            return;
+        }
+    }
+}
+
+void wf::txn::transaction_t::split_stragglers()
+{
+    if (ready_objects.empty())
+    {
+        return;
+    }
+
+    std::vector<transaction_object_sptr> stragglers;
+    for (auto& obj : objects)
+    {
+        if (std::find(ready_objects.begin(), ready_objects.end(), obj) == ready_objects.end())
+        {
+            stragglers.push_back(obj);
+        }
+    }
+
+    LOGC(TXN, "Splitting transaction ", this, ": applying ", ready_objects.size(), " objects, ",
+        stragglers.size(), " objects are still pending");
+
+    auto ready = std::move(ready_objects);
+    ready_objects.clear();
+    this->objects       = std::move(stragglers);
+    this->count_ready_objects = 0;
+    for (auto& obj : ready)
+    {
+        obj->disconnect(&on_object_ready);
+        obj->apply();
+    }
+
+    for (auto& obj : objects)
+    {
+        client_ack_stats::note_split(obj->get_app_id());
+    }
+
+    transaction_split_signal ev;
+    ev.self = this;
+    this->emit(&ev);
 }
 
 void wf::txn::transaction_t::apply(bool did_timeout)
 {
     on_object_ready.disconnect();
+    split_timer.disconnect();
 
     LOGC(TXN, "Applying transaction ", this, " timed_out: ", did_timeout);
+    if (did_timeout)
+    {
+        const int64_t elapsed = wf::get_current_time_usec() - commit_time;
+        for (auto& obj : this->objects)
+        {
+            if (std::find(ready_objects.begin(), ready_objects.end(), obj) == ready_objects.end())
+            {
+                client_ack_stats::note_timeout(obj->get_app_id(), elapsed);
+            }
+        }
+    }
+
     for (auto& obj : this->objects)
     {
         obj->apply();
@@ -105,5 +224,8 @@ std::unique_ptr<wf::txn::transaction_t> wf::txn::transaction_t::create(int64_t t
         timeout = tx_timeout;
     }
 
-    return std::make_unique<wayfire_default_transaction_t>(timeout);
+    static wf::option_wrapper_t<bool> adaptive_timeout{"core/adaptive_transaction_timeout"};
+    auto tx = std::make_unique<wayfire_default_transaction_t>(timeout);
+    tx->set_adaptive_timeout(adaptive_timeout);
+    return tx;
 }
@@ -387,6 +387,8 @@ void wf::dump_scene(scene::node_ptr root)
     _dump_scene(root);
 }
 
+uint64_t wf::detail::option_generation = 0;
+
 void wf::detail::option_wrapper_debug_message(const std::string & option_name, const std::runtime_error & err)
 {
     LOGE("Wayfire encountered error loading option \"", option_name, "\": ", err.what(), ". ",
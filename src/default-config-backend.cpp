@@ -1,4 +1,6 @@
 #include <vector>
+#include <map>
+#include <set>
 #include "wayfire/debug.hpp"
 #include "wayfire/signal-definitions.hpp"
 #include <string>
@@ -6,6 +8,7 @@
 #include <wayfire/config-backend.hpp>
 #include <wayfire/plugin.hpp>
 #include <wayfire/core.hpp>
+#include "config-cache.hpp"
 
 #include <cstring>
 #include <sys/inotify.h>
@@ -19,6 +22,13 @@ wf::config::config_manager_t *cfg_manager;
 
 static int wd_cfg_dir, wd_cfg_file;
 
+/**
+ * Editors often save a file in several steps (for example write a temporary file and rename it over the
+ * original), each of which results in an inotify event. Wait for the events to settle before reloading.
+ */
+static const int RELOAD_DEBOUNCE_MS = 50;
+static wl_event_source *reload_timer;
+
 static void add_watch(int fd)
 {
     wd_cfg_dir  = inotify_add_watch(fd, config_dir.c_str(), IN_CREATE | IN_MOVED_TO);
@@ -30,6 +40,84 @@ static void reload_config(int fd)
     wf::config::load_configuration_options_from_file(*cfg_manager, config_file);
 }
 
+/** Use the values in the system-wide config file as the default values of the options. */
+static void load_default_overrides(wf::config::config_manager_t& config, const std::string& sysconf_file)
+{
+    if (access(sysconf_file.c_str(), R_OK) != 0)
+    {
+        return;
+    }
+
+    wf::config::load_configuration_options_from_file(config, sysconf_file);
+    for (auto& section : config.get_all_sections())
+    {
+        for (auto& opt : section->get_registered_options())
+        {
+            opt->set_default_value_str(opt->get_value_str());
+        }
+    }
+}
+
+using config_snapshot_t = std::map<std::string, std::map<std::string, std::string>>;
+
+static config_snapshot_t take_snapshot()
+{
+    config_snapshot_t snapshot;
+    for (auto& section : cfg_manager->get_all_sections())
+    {
+        auto& values = snapshot[section->get_name()];
+        for (auto& opt : section->get_registered_options())
+        {
+            values[opt->get_name()] = opt->get_value_str();
+        }
+    }
+
+    return snapshot;
+}
+
+/** Find the sections which differ between the two snapshots, including added and removed sections. */
+static std::set<std::string> diff_snapshots(const config_snapshot_t& before, const config_snapshot_t& after)
+{
+    std::set<std::string> changed;
+    for (auto& [name, values] : after)
+    {
+        auto it = before.find(name);
+        if ((it == before.end()) || (it->second != values))
+        {
+            changed.insert(name);
+        }
+    }
+
+    for (auto& [name, values] : before)
+    {
+        if (!after.count(name))
+        {
+            changed.insert(name);
+        }
+    }
+
+    return changed;
+}
+
+static int handle_reload_timer(void *data)
+{
+    const int fd = (intptr_t)data;
+    auto before  = take_snapshot();
+    reload_config(fd);
+
+    wf::reload_config_signal ev;
+    ev.changed_sections = diff_snapshots(before, take_snapshot());
+    if (ev.changed_sections.empty())
+    {
+        LOGD("Configuration file reloaded, but no options have changed");
+        return 0;
+    }
+
+    LOGD("Configuration file reloaded, ", ev.changed_sections.size(), " sections have changed");
+    wf::get_core().emit(&ev);
+    return 0;
+}
+
 static int handle_config_updated(int fd, uint32_t mask, void *data)
 {
     if ((mask & WL_EVENT_READABLE) == 0)
@@ -82,11 +170,8 @@ static int handle_config_updated(int fd, uint32_t mask, void *data)
 
     if (should_reload)
     {
-        LOGD("Reloading configuration file");
-
-        reload_config(fd);
-        wf::reload_config_signal ev;
-        wf::get_core().emit(&ev);
+        LOGD("Configuration file changed, reloading in ", RELOAD_DEBOUNCE_MS, "ms");
+        wl_event_source_timer_update(reload_timer, RELOAD_DEBOUNCE_MS);
     }
 
     return 0;
@@ -110,8 +195,11 @@ class dynamic_ini_config_t : public wf::config_backend_t
         LOGI("Using config file: ", config_file.c_str());
         setenv(CONFIG_FILE_ENV, config_file.c_str(), 1);
 
-        config = wf::config::build_configuration(
-            get_xml_dirs(), SYSCONFDIR "/wayfire/defaults.ini", config_file);
+        // Same as wf::config::build_configuration(), but with the XML metadata cached.
+        wf::config::config_manager_t manager;
+        wf::load_xml_metadata_cached(manager, get_xml_dirs(), wf::get_xml_metadata_cache_file());
+        load_default_overrides(manager, SYSCONFDIR "/wayfire/defaults.ini");
+        config = std::move(manager);
 
         int inotify_fd = inotify_init1(IN_CLOEXEC);
         reload_config(inotify_fd);
@@ -119,6 +207,8 @@ class dynamic_ini_config_t : public wf::config_backend_t
 
         wl_event_loop_add_fd(wl_display_get_event_loop(display),
             inotify_fd, WL_EVENT_READABLE, handle_config_updated, NULL);
+        reload_timer = wl_event_loop_add_timer(wl_display_get_event_loop(display),
+            handle_reload_timer, (void*)(intptr_t)inotify_fd);
     }
 
     std::string choose_cfg_file(const std::string& cmdline_cfg_file)
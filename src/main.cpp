@@ -14,6 +14,8 @@
 #include "wayfire/config-backend.hpp"
 #include "core/plugin-loader.hpp"
 #include "core/core-impl.hpp"
+#include "core/log-buffer.hpp"
+#include "core/startup-profile.hpp"
 
 static void print_version()
 {
@@ -36,6 +38,10 @@ static void print_help()
         " -D,  --damage-debug      enable additional debug for damaged regions" <<
         std::endl;
     std::cout << " -R,  --damage-rerender   rerender damaged regions" << std::endl;
+    std::cout << " -L,  --buffered-log      buffer log output in memory and write it" <<
+        " when idle" << std::endl;
+    std::cout << " -P,  --profile-startup   log a timeline of the startup once the first" <<
+        " frame is presented" << std::endl;
     std::cout << " -v,  --version           print version and exit" << std::endl;
     exit(0);
 }
@@ -139,6 +145,7 @@ static void signal_handler(int signal)
 
     LOGE("Fatal error: ", error);
     wf::print_trace(false);
+    wf::log_buffer::flush();
     std::_Exit(-1);
 }
 
@@ -231,6 +238,10 @@ void parse_extended_debugging(const std::vector<std::string>& categories)
         {
             LOGD("Enabling extended debugging for render events");
             wf::log::enabled_categories.set((size_t)wf::log::logging_category::RENDER, 1);
+        } else if (cat == "latency")
+        {
+            LOGD("Enabling extended debugging for input latency");
+            wf::log::enabled_categories.set((size_t)wf::log::logging_category::LATENCY, 1);
         } else
         {
             LOGE("Unrecognized debugging category \"", cat, "\"");
@@ -270,6 +281,8 @@ int main(int argc, char *argv[])
         {"debug", optional_argument, NULL, 'd'},
         {"damage-debug", no_argument, NULL, 'D'},
         {"damage-rerender", no_argument, NULL, 'R'},
+        {"buffered-log", no_argument, NULL, 'L'},
+        {"profile-startup", no_argument, NULL, 'P'},
         {"help", no_argument, NULL, 'h'},
         {"version", no_argument, NULL, 'v'},
         {0, 0, NULL, 0}
@@ -278,9 +291,10 @@ int main(int argc, char *argv[])
     std::string config_file;
     std::string config_backend = WF_DEFAULT_CONFIG_BACKEND;
     std::vector<std::string> extended_debug_categories;
+    bool buffered_log = false;
 
     int c, i;
-    while ((c = getopt_long(argc, argv, "c:B:d::DhRv", opts, &i)) != -1)
+    while ((c = getopt_long(argc, argv, "c:B:d::DhRLPv", opts, &i)) != -1)
     {
         switch (c)
         {
@@ -300,6 +314,14 @@ int main(int argc, char *argv[])
             runtime_config.no_damage_track = true;
             break;
 
+          case 'L':
+            buffered_log = true;
+            break;
+
+          case 'P':
+            wf::startup_profile::enable();
+            break;
+
           case 'h':
             print_help();
             break;
@@ -337,7 +359,9 @@ int main(int argc, char *argv[])
     /* Don't crash on SIGPIPE, e.g., when doing IPC to a client whose fd has been closed. */
     signal(SIGPIPE, SIG_IGN);
 
-    wf::log::initialize_logging(std::cout, log_level, detect_color_mode());
+    const size_t log_buffer_size = 1 << 20;
+    wf::log::initialize_logging(buffered_log ? wf::log_buffer::enable(log_buffer_size) : std::cout,
+        log_level, detect_color_mode());
 
     parse_extended_debugging(extended_debug_categories);
     wlr_log_init(WLR_DEBUG, wlr_log_handler);
@@ -355,8 +379,10 @@ int main(int argc, char *argv[])
 
     std::set_terminate([] ()
     {
+        wf::log_buffer::flush();
         std::cout << "Unhandled exception" << std::endl;
         wf::print_trace(false);
+        wf::log_buffer::flush();
         std::abort();
     });
 
@@ -372,7 +398,11 @@ int main(int argc, char *argv[])
     /** TODO: move this to core_impl constructor */
     core.display = display;
     core.ev_loop = wl_display_get_event_loop(core.display);
-    core.backend = wlr_backend_autocreate(core.display, &core.session);
+    wf::log_buffer::set_event_loop(core.ev_loop);
+    {
+        wf::startup_profile::scope_t profile{"backend creation"};
+        core.backend = wlr_backend_autocreate(core.display, &core.session);
+    }
 
     int drm_fd = wlr_backend_get_drm_fd(core.backend);
     if (drm_fd < 0)
@@ -393,12 +423,15 @@ int main(int argc, char *argv[])
         }
     }
 
-    core.renderer = wlr_gles2_renderer_create_with_drm_fd(drm_fd);
-    assert(core.renderer);
-    core.allocator = wlr_allocator_autocreate(core.backend, core.renderer);
-    assert(core.allocator);
-    core.egl = wlr_gles2_renderer_get_egl(core.renderer);
-    assert(core.egl);
+    {
+        wf::startup_profile::scope_t profile{"renderer and EGL init"};
+        core.renderer = wlr_gles2_renderer_create_with_drm_fd(drm_fd);
+        assert(core.renderer);
+        core.allocator = wlr_allocator_autocreate(core.backend, core.renderer);
+        assert(core.allocator);
+        core.egl = wlr_gles2_renderer_get_egl(core.renderer);
+        assert(core.egl);
+    }
 
     if (!drop_permissions())
     {
@@ -419,8 +452,15 @@ int main(int argc, char *argv[])
 
     LOGD("Using configuration backend: ", config_backend);
     core.config_backend = std::unique_ptr<wf::config_backend_t>(backend);
-    core.config_backend->init(display, core.config, config_file);
-    core.init();
+    {
+        wf::startup_profile::scope_t profile{"config backend init"};
+        core.config_backend->init(display, core.config, config_file);
+    }
+
+    {
+        wf::startup_profile::scope_t profile{"core init"};
+        core.init();
+    }
 
     auto socket = choose_socket(core.display);
     if (!socket)
@@ -432,17 +472,25 @@ int main(int argc, char *argv[])
 
     core.wayland_display = socket.value();
     LOGI("Using socket name ", core.wayland_display);
-    if (!wlr_backend_start(core.backend))
     {
-        LOGE("Failed to initialize backend, exiting");
-        wlr_backend_destroy(core.backend);
-        wl_display_destroy(core.display);
+        wf::startup_profile::scope_t profile{"backend start"};
+        if (!wlr_backend_start(core.backend))
+        {
+            LOGE("Failed to initialize backend, exiting");
+            wlr_backend_destroy(core.backend);
+            wl_display_destroy(core.display);
 
-        return -1;
+            return -1;
+        }
     }
 
     setenv("WAYLAND_DISPLAY", core.wayland_display.c_str(), 1);
-    core.post_init();
+    {
+        wf::startup_profile::scope_t profile{"core post init"};
+        core.post_init();
+    }
+
+    wf::startup_profile::mark("event loop start");
 
     wl_display_run(core.display);
     wf::compositor_core_impl_t::deallocate_core();
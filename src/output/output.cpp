@@ -96,13 +96,17 @@ void wf::output_impl_t::set_workspace_set(std::shared_ptr<workspace_set_t> wset)
 
     wf::dassert(wset != nullptr, "Workspace set should not be null!");
 
-    if (this->current_wset)
     {
-        this->current_wset->set_visible(false);
-    }
+        // Hiding and showing the views of both sets changes many nodes; notify the root only once.
+        wf::scene::update_batch_t batch;
+        if (this->current_wset)
+        {
+            this->current_wset->set_visible(false);
+        }
 
-    wset->attach_to_output(this);
-    wset->set_visible(true);
+        wset->attach_to_output(this);
+        wset->set_visible(true);
+    }
 
     {
         // Delay freeing old_wset until we can safely report the new value
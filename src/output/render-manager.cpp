@@ -3,6 +3,7 @@
 #include "wayfire/core.hpp"
 #include "wayfire/debug.hpp"
 #include "wayfire/geometry.hpp"
+#include "wayfire/gpu-memory.hpp"
 #include "wayfire/region.hpp"
 #include "wayfire/scene-render.hpp"
 #include "wayfire/scene.hpp"
@@ -10,18 +11,123 @@
 #include "wayfire/view.hpp"
 #include "wayfire/output.hpp"
 #include "wayfire/util.hpp"
+#include "wayfire/config-backend.hpp"
+#include "wayfire/trace.hpp"
+#include "wayfire/plugin-stats.hpp"
 #include "../core/opengl-priv.hpp"
+#include "../core/seat/input-latency.hpp"
+#include "../core/startup-profile.hpp"
 #include "../main.hpp"
 #include "wayfire/workspace-set.hpp"
 #include <algorithm>
+#include <cmath>
+#include <deque>
+#include <map>
+#include <optional>
+#include <set>
+#include <sstream>
+#include <tuple>
+#include <unordered_map>
 #include <wayfire/nonstd/reverse.hpp>
 #include <wayfire/nonstd/safe-list.hpp>
 #include <wayfire/util/log.hpp>
 #include <wayfire/nonstd/wlroots-full.hpp>
 #include <wlr/types/wlr_gamma_control_v1.h>
+#include <GLES2/gl2ext.h>
 
 namespace wf
 {
+/**
+ * Keeps track of who keeps an output repainting, see render_manager::get_repaint_sources().
+ */
+struct repaint_source_tracker_t
+{
+    /** The window over which the request rate is measured, in microseconds */
+    static constexpr int64_t RATE_WINDOW = 1'000'000;
+
+    struct source_t
+    {
+        int redraw_always = 0;
+        int64_t redraw_always_since = 0;
+        uint64_t requests = 0;
+        uint64_t window_requests = 0;
+        int64_t window_start   = 0;
+        double last_window_rate = 0;
+    };
+
+    /** By owner. Not a hash map, so that pointers stay valid. */
+    std::map<std::string, source_t> sources;
+    source_t& scene = sources["scene"];
+
+    void note_request(source_t& source)
+    {
+        const int64_t now = wf::get_current_time_usec();
+        if (now - source.window_start >= RATE_WINDOW)
+        {
+            source.last_window_rate = (now - source.window_start < 2 * RATE_WINDOW) ?
+                source.window_requests * 1e6 / (now - source.window_start) : 0;
+            source.window_start    = now;
+            source.window_requests = 0;
+        }
+
+        ++source.requests;
+        ++source.window_requests;
+    }
+
+    void note_request(const void *caller)
+    {
+        note_request(sources[wf::plugin_stats::get_owner_name(caller)]);
+    }
+
+    void note_redraw_always(const void *caller, bool always)
+    {
+        auto& source = sources[wf::plugin_stats::get_owner_name(caller)];
+        if (always && (source.redraw_always++ == 0))
+        {
+            source.redraw_always_since = wf::get_current_time_usec();
+        } else if (!always)
+        {
+            // The request may be undone by different code than the one which made it.
+            source.redraw_always = std::max(0, source.redraw_always - 1);
+        }
+    }
+
+    std::vector<repaint_source_t> get_sources() const
+    {
+        const int64_t now = wf::get_current_time_usec();
+        std::vector<repaint_source_t> result;
+        for (auto& [owner, source] : sources)
+        {
+            if ((source.requests == 0) && (source.redraw_always == 0))
+            {
+                continue;
+            }
+
+            repaint_source_t entry;
+            entry.owner = owner;
+            entry.redraw_always = source.redraw_always;
+            entry.redraw_always_usec = source.redraw_always ? now - source.redraw_always_since : 0;
+            entry.requests = source.requests;
+            const int64_t elapsed = now - source.window_start;
+            if (elapsed < RATE_WINDOW)
+            {
+                entry.requests_per_second = source.last_window_rate;
+            } else if (elapsed < 2 * RATE_WINDOW)
+            {
+                entry.requests_per_second = source.window_requests * 1e6 / elapsed;
+            }
+
+            result.push_back(entry);
+        }
+
+        std::sort(result.begin(), result.end(), [] (const repaint_source_t& a, const repaint_source_t& b)
+        {
+            return a.requests_per_second > b.requests_per_second;
+        });
+        return result;
+    }
+};
+
 /**
  * swapchain_damage_manager_t is responsible for tracking the damage and managing the swapchain on the
  * given output.
@@ -32,17 +138,35 @@ struct swapchain_damage_manager_t
     std::vector<scene::render_instance_uptr> render_instances;
 
     wf::wl_listener_wrapper on_needs_frame;
+    wf::wl_listener_wrapper on_precommit;
     wf::wl_listener_wrapper on_damage;
     wf::wl_listener_wrapper on_request_state;
     wf::wl_listener_wrapper on_gamma_changed;
 
     wf::region_t frame_damage;
+    repaint_source_tracker_t repaint_sources;
+    /** Incremented on each damage of the output, see render_manager::get_damage_generation() */
+    uint64_t damage_generation = 0;
     wlr_output *output;
     wlr_damage_ring damage_ring;
     output_t *wo;
 
     bool pending_gamma_lut = false;
     wf::wl_idle_call idle_recompute_visibility;
+    /** See render_manager::is_content_shown(). Nothing is visible on an output which does not show it. */
+    bool content_shown = true;
+
+    /** The color transform which is applied with the gamma LUT of the output, in addition to the client's. */
+    std::optional<glm::mat4> gamma_color_transform;
+    /** Called when the output does not accept the gamma LUT with the color transform. */
+    std::function<void()> on_gamma_color_transform_failed;
+
+    void set_gamma_color_transform(std::optional<glm::mat4> transform)
+    {
+        gamma_color_transform = transform;
+        pending_gamma_lut     = true;
+        schedule_repaint();
+    }
 
     void update_scenegraph(uint32_t update_mask)
     {
@@ -64,7 +188,10 @@ struct swapchain_damage_manager_t
                 // Damage is pushed up to the root in root coordinate system,
                 // we need it in layout-local coordinate system.
                 region += -wf::origin(wo->get_layout_geometry());
-                this->damage(region, true);
+                if (this->damage(region, true))
+                {
+                    repaint_sources.note_request(repaint_sources.scene);
+                }
             };
 
             render_instances.clear();
@@ -76,7 +203,12 @@ struct swapchain_damage_manager_t
             idle_recompute_visibility.run_once([=] ()
             {
                 LOGC(RENDER, "Output ", wo->to_string(), ": recomputing visibility.");
-                wf::region_t region = this->wo->get_layout_geometry();
+                wf::region_t region;
+                if (content_shown)
+                {
+                    region = this->wo->get_layout_geometry();
+                }
+
                 for (auto& inst : render_instances)
                 {
                     inst->compute_visibility(wo, region);
@@ -110,10 +242,31 @@ struct swapchain_damage_manager_t
         wlr_damage_ring_init(&damage_ring);
         update_damage_ring_bounds();
 
-        on_needs_frame.set_callback([=] (void*) { schedule_repaint(); });
+        on_needs_frame.set_callback([=] (void*)
+        {
+            const int64_t delay = get_screencopy_throttle_delay();
+            if (delay <= 0)
+            {
+                schedule_repaint();
+            } else if (!screencopy_throttle.is_connected())
+            {
+                screencopy_throttle.set_timeout(delay, [=] { schedule_repaint(); });
+            }
+        });
+
+        on_precommit.set_callback([=] (void *data)
+        {
+            auto ev = static_cast<wlr_output_event_precommit*>(data);
+            if (ev->state->committed & WLR_OUTPUT_STATE_BUFFER)
+            {
+                note_screencopy_frames();
+            }
+        });
+
         on_damage.set_callback([&] (void *data)
         {
             auto ev = static_cast<wlr_output_event_damage*>(data);
+            damage_generation++;
             if (wlr_damage_ring_add(&damage_ring, ev->damage))
             {
                 schedule_repaint();
@@ -140,11 +293,101 @@ struct swapchain_damage_manager_t
         });
 
         on_needs_frame.connect(&output->handle->events.needs_frame);
+        on_precommit.connect(&output->handle->events.precommit);
         on_damage.connect(&output->handle->events.damage);
         on_request_state.connect(&output->handle->events.request_state);
         on_gamma_changed.connect(&wf::get_core().protocols.gamma_v1->events.set_gamma);
     }
 
+    wf::option_wrapper_t<int> screencopy_max_fps{"workarounds/screencopy_max_fps"};
+    wf::wl_timer<false> screencopy_throttle;
+    /** The time in milliseconds when each screencopy client last got a frame of this output */
+    std::unordered_map<wl_client*, int64_t> screencopy_last_frame;
+    /** The hardware cursors of the output as of the last commit, they also need frames to be updated. */
+    std::vector<std::tuple<double, double, bool, wlr_texture*>> committed_cursors;
+
+    std::vector<std::tuple<double, double, bool, wlr_texture*>> get_cursors_state()
+    {
+        std::vector<std::tuple<double, double, bool, wlr_texture*>> state;
+        wlr_output_cursor *cursor;
+        wl_list_for_each(cursor, &output->cursors, link)
+        {
+            state.emplace_back(cursor->x, cursor->y, cursor->visible, cursor->texture);
+        }
+
+        return state;
+    }
+
+    /**
+     * Remember which clients get a frame with the next commit. The screencopy frames are copied after the
+     * commit, so they are still pending here.
+     */
+    void note_screencopy_frames()
+    {
+        if (screencopy_max_fps <= 0)
+        {
+            screencopy_last_frame.clear();
+            committed_cursors.clear();
+            return;
+        }
+
+        committed_cursors = get_cursors_state();
+
+        const int64_t now = wf::get_current_time();
+        const int64_t interval = 1000 / screencopy_max_fps;
+        // Also drops clients which are gone, their wl_client may be reused.
+        for (auto it = screencopy_last_frame.begin(); it != screencopy_last_frame.end();)
+        {
+            it = (now - it->second >= interval) ? screencopy_last_frame.erase(it) : std::next(it);
+        }
+
+        wlr_screencopy_frame_v1 *frame;
+        wl_list_for_each(frame, &wf::get_core().protocols.screencopy->frames, link)
+        {
+            if ((frame->output == output) && frame->buffer)
+            {
+                screencopy_last_frame[wl_resource_get_client(frame->resource)] = now;
+            }
+        }
+    }
+
+    /**
+     * Screencopy clients which do not ask for damage request a frame with wlr_output_update_needs_frame().
+     * @return How long the frame should be delayed so that none of these clients exceeds screencopy_max_fps,
+     *   or 0 if the frame is needed now, for example because another client or the cursor needs it.
+     */
+    int64_t get_screencopy_throttle_delay()
+    {
+        if ((screencopy_max_fps <= 0) || (get_cursors_state() != committed_cursors))
+        {
+            return 0;
+        }
+
+        const int64_t now = wf::get_current_time();
+        const int64_t interval = 1000 / screencopy_max_fps;
+        int64_t delay = 0;
+
+        wlr_screencopy_frame_v1 *frame;
+        wl_list_for_each(frame, &wf::get_core().protocols.screencopy->frames, link)
+        {
+            if ((frame->output != output) || !frame->buffer || frame->with_damage)
+            {
+                continue;
+            }
+
+            auto it = screencopy_last_frame.find(wl_resource_get_client(frame->resource));
+            const int64_t remaining = (it == screencopy_last_frame.end()) ? 0 : (it->second + interval - now);
+            if (remaining <= 0)
+            {
+                return 0;
+            }
+
+            delay = (delay == 0) ? remaining : std::min(delay, remaining);
+        }
+
+        return delay;
+    }
+
     wf::signal::connection_t<wf::output_configuration_changed_signal>
     output_mode_changed = [=] (wf::output_configuration_changed_signal *ev)
     {
@@ -158,23 +401,47 @@ struct swapchain_damage_manager_t
     };
 
     /**
-     * Damage the given region
+     * Damage the given region.
+     *
+     * Damage outside of the output, for example from views on other workspaces, is dropped right away: it
+     * would be cut off by the damage ring anyway, and it should not bump the damage generation, which
+     * invalidates the caches of effects on the visible workspace. Plugins which show other workspaces, like
+     * the workspace wall, receive the damage of their workspaces through their own render instances.
+     *
+     * @return Whether any of the damage is visible on the output.
      */
-    void damage(const wf::region_t& region, bool repaint)
+    bool damage(const wf::region_t& region, bool repaint)
     {
         if (region.empty())
         {
-            return;
+            return false;
         }
 
         /* Wlroots expects damage after scaling */
-        auto scaled_region = region * wo->handle->scale;
+        auto scaled_region = (region * wo->handle->scale) & get_wlr_damage_box();
+        if (scaled_region.empty())
+        {
+            return false;
+        }
+
+        damage_generation++;
         frame_damage |= scaled_region;
-        wlr_damage_ring_add(&damage_ring, scaled_region.to_pixman());
-        if (repaint)
+        if (wlr_damage_ring_add(&damage_ring, scaled_region.to_pixman()) && repaint)
         {
             schedule_repaint();
         }
+
+        return true;
+    }
+
+    /**
+     * Damage the given box, which is already in the wlroots damage coordinate system.
+     */
+    void damage_buffer_box(const wlr_box& box)
+    {
+        damage_generation++;
+        frame_damage |= box;
+        wlr_damage_ring_add_box(&damage_ring, &box);
     }
 
     void damage(const wf::geometry_t& box, bool repaint)
@@ -184,11 +451,16 @@ struct swapchain_damage_manager_t
             return;
         }
 
-        /* Wlroots expects damage after scaling */
-        auto scaled_box = box * wo->handle->scale;
+        /* Wlroots expects damage after scaling, see damage(region) for the damage outside of the output. */
+        auto scaled_box = wf::geometry_intersection(box * wo->handle->scale, get_wlr_damage_box());
+        if ((scaled_box.width <= 0) || (scaled_box.height <= 0))
+        {
+            return;
+        }
+
+        damage_generation++;
         frame_damage |= scaled_box;
-        wlr_damage_ring_add_box(&damage_ring, &scaled_box);
-        if (repaint)
+        if (wlr_damage_ring_add_box(&damage_ring, &scaled_box) && repaint)
         {
             schedule_repaint();
         }
@@ -275,6 +547,20 @@ struct swapchain_damage_manager_t
         auto gamma_control =
             wlr_gamma_control_manager_v1_get_control(wf::get_core().protocols.gamma_v1, output);
 
+        if (gamma_color_transform)
+        {
+            if (set_color_transform_lut(gamma_control, next_frame.state) &&
+                wlr_output_test_state(output, &next_frame.state))
+            {
+                return true;
+            }
+
+            LOGW("Output ", output->name, " does not support color transforms with its gamma LUT, ",
+                "falling back to rendering them.");
+            gamma_color_transform.reset();
+            on_gamma_color_transform_failed();
+        }
+
         if (!wlr_gamma_control_v1_apply(gamma_control, &next_frame.state))
         {
             LOGE("Failed to apply gamma to output state!");
@@ -289,16 +575,58 @@ struct swapchain_damage_manager_t
         return true;
     }
 
+    /**
+     * Set the gamma LUT of the output to the color transform, followed by the gamma ramps of the client
+     * controlling the output's gamma, if any. Only the per-channel part of the matrix is used.
+     */
+    bool set_color_transform_lut(wlr_gamma_control_v1 *client, wlr_output_state& state)
+    {
+        const size_t size = wlr_output_get_gamma_size(output);
+        if (size < 2)
+        {
+            return false;
+        }
+
+        const glm::mat4& matrix = *gamma_color_transform;
+        const bool has_client_ramps = client && client->table && (client->ramp_size > 0);
+        std::vector<uint16_t> lut(3 * size);
+        for (size_t c = 0; c < 3; c++)
+        {
+            for (size_t i = 0; i < size; i++)
+            {
+                double x = std::clamp(matrix[c][c] * i / (size - 1.0) + matrix[3][c], 0.0, 1.0);
+                if (has_client_ramps)
+                {
+                    const uint16_t *ramp = client->table + c * client->ramp_size;
+                    const double pos     = x * (client->ramp_size - 1);
+                    const size_t lo = std::floor(pos);
+                    const size_t hi = std::min(lo + 1, client->ramp_size - 1);
+                    x = (ramp[lo] + (ramp[hi] - ramp[lo]) * (pos - lo)) / 65535.0;
+                }
+
+                lut[c * size + i] = std::lround(x * 65535);
+            }
+        }
+
+        return wlr_output_state_set_gamma_lut(&state, size,
+            lut.data(), lut.data() + size, lut.data() + 2 * size);
+    }
+
     bool force_next_frame = false;
     /**
      * Start rendering a new frame.
      * If the operation could not be started, or if a new frame is not needed, the function returns false.
      * If the operation succeeds, true is returned, and the output (E)GL context is bound.
+     *
+     * @param effects_draw Whether overlay or post effects are active. They may change the image without
+     *   damaging the output, so in that case a frame is rendered whenever one was requested. Otherwise, an
+     *   output without visible damage does no GL work.
      */
-    std::unique_ptr<frame_object_t> start_frame()
+    std::unique_ptr<frame_object_t> start_frame(bool effects_draw)
     {
-        const bool needs_swap = force_next_frame | output->needs_frame |
-            pixman_region32_not_empty(&damage_ring.current) | (constant_redraw_counter > 0);
+        const bool requested  = force_next_frame || (constant_redraw_counter > 0);
+        const bool needs_swap = output->needs_frame || pending_gamma_lut ||
+            pixman_region32_not_empty(&damage_ring.current) || (requested && effects_draw);
         force_next_frame = false;
 
         if (!needs_swap)
@@ -335,33 +663,50 @@ struct swapchain_damage_manager_t
         return next_frame;
     }
 
-    void swap_buffers(std::unique_ptr<frame_object_t> next_frame, const wf::region_t& swap_damage)
+    /**
+     * Submit the rendering commands of the frame, so that it can be committed with commit_frame(). Damage
+     * which arrives afterwards belongs to the next frame, even if this one is committed later.
+     */
+    bool submit_frame(frame_object_t& frame)
     {
         frame_damage.clear();
 
-        if (!wlr_render_pass_submit(next_frame->render_pass))
+        if (!wlr_render_pass_submit(frame.render_pass))
         {
             LOGE("Failed to submit render pass!");
-            wlr_buffer_unlock(next_frame->buffer);
-            return;
+            wlr_buffer_unlock(frame.buffer);
+            return false;
         }
 
-        wlr_output_state_set_buffer(&next_frame->state, next_frame->buffer);
-        wlr_buffer_unlock(next_frame->buffer);
+        wlr_output_state_set_buffer(&frame.state, frame.buffer);
+        wlr_buffer_unlock(frame.buffer);
+        wlr_damage_ring_rotate(&damage_ring);
+        return true;
+    }
 
-        if (!wlr_output_test_state(output, &next_frame->state))
+    /** @return Whether the frame was committed to the output. */
+    bool commit_frame(frame_object_t& frame)
+    {
+        if (!wlr_output_test_state(output, &frame.state))
         {
             LOGE("Output test failed!");
-            return;
-        }
-
-        if (!wlr_output_commit_state(output, &next_frame->state))
+        } else if (!wlr_output_commit_state(output, &frame.state))
         {
             LOGE("Output commit failed!");
-            return;
+        } else
+        {
+            return true;
         }
 
-        wlr_damage_ring_rotate(&damage_ring);
+        // The damage of the frame is already rotated out of the current damage, but the buffer was not shown.
+        damage_buffer_box(get_wlr_damage_box());
+        return false;
+    }
+
+    /** @return Whether the frame was committed to the output. */
+    bool swap_buffers(std::unique_ptr<frame_object_t> next_frame, const wf::region_t& swap_damage)
+    {
+        return submit_frame(*next_frame) && commit_frame(*next_frame);
     }
 
     /**
@@ -376,8 +721,15 @@ struct swapchain_damage_manager_t
         {
             frame_damage |= get_wlr_damage_box();
         }
+
+        // Every damage rectangle costs a scissor and a draw call in each render instance, so
+        // coarsen the damage if it has become too fragmented.
+        frame_damage.simplify(max_damage_rects, damage_merge_overdraw);
     }
 
+    wf::option_wrapper_t<int> max_damage_rects{"workarounds/max_damage_rects"};
+    wf::option_wrapper_t<int> damage_merge_overdraw{"workarounds/damage_merge_overdraw"};
+
     /**
      * Return the damage that has been scheduled for the next frame up to now,
      * or, if in a repaint, the damage for the current frame
@@ -428,9 +780,7 @@ struct swapchain_damage_manager_t
      */
     wf::region_t get_ws_damage(wf::point_t ws)
     {
-        auto scaled = frame_damage * (1.0 / wo->handle->scale);
-
-        return scaled & get_ws_box(ws);
+        return frame_damage * (1.0 / wo->handle->scale) & get_ws_box(ws);
     }
 
     /**
@@ -493,14 +843,51 @@ struct effect_hook_manager_t
 
     void run_effects(output_effect_type_t type)
     {
+        static const char *names[] = {
+            "effects::pre", "effects::damage", "effects::overlay", "effects::post"
+        };
+
+        WF_TRACE_SCOPE(names[type]);
         effects[type].for_each([] (auto effect)
-        { (*effect)(); });
+        {
+            wf::plugin_stats::scope_t cost{effect->target_type(), wf::plugin_stats::COST_EFFECT_HOOK};
+            (*effect)();
+        });
     }
 };
 
 /**
  * A class to manage and run postprocessing effects
  */
+static const char *color_transform_vertex_shader =
+    R"(
+#version 100
+
+attribute mediump vec2 position;
+varying highp vec2 uvpos;
+
+void main()
+{
+    gl_Position = vec4(position.xy, 0.0, 1.0);
+    uvpos = (position.xy + 1.0) / 2.0;
+}
+)";
+
+static const char *color_transform_fragment_shader =
+    R"(
+#version 100
+
+varying highp vec2 uvpos;
+uniform sampler2D smp;
+uniform mediump mat4 color_matrix;
+
+void main()
+{
+    mediump vec4 tex = texture2D(smp, uvpos);
+    gl_FragColor = vec4((color_matrix * vec4(tex.rgb, 1.0)).rgb, tex.a);
+}
+)";
+
 struct postprocessing_manager_t
 {
     using post_container_t = wf::safe_list_t<post_hook_t*>;
@@ -509,11 +896,99 @@ struct postprocessing_manager_t
     /* Buffer to which other operations render to */
     static constexpr uint32_t default_out_buffer = 0;
 
+    // The damage mappings of the hooks added with one
+    std::unordered_map<post_hook_t*, post_hook_damage_t> damage_maps;
+    // The buffers of the hooks have to be repainted completely after the chain changes.
+    bool chain_changed = true;
+
+    // The part of buffer 0 which was repainted in the current frame, in framebuffer coordinates
+    wf::region_t source_damage;
+    // The damage of the currently running hook
+    wf::region_t current_damage;
+    // The damage of the last hook in the previous frames, most recent first. The last hook renders to the
+    // output's buffers, which are older than one frame, so damage which its mapping adds to the source
+    // damage has to be repeated until all buffers are repainted.
+    std::deque<wf::region_t> last_hook_damage;
+    static constexpr size_t MAX_BUFFER_AGE = 4;
+
+    // The color transforms, applied either by a single post hook which always runs last, or by the gamma
+    // LUT of the output when they are the only effect and act on each channel separately.
+    std::vector<color_transform_t*> color_transforms;
+    post_hook_t color_hook;
+    bool color_hook_added = false;
+    OpenGL::program_t color_program;
+    bool color_program_compiled = false;
+    wf::option_wrapper_t<bool> hardware_color_transforms{"workarounds/hardware_color_transforms"};
+    bool hardware_colors_failed = false;
+
+    // The part of the output which is magnified to the whole output, see render_manager::set_render_region()
+    std::optional<wf::geometry_t> render_region;
+
+    // The resolution of buffer 0 relative to the output, see the render_scale option of the outputs. Below 1,
+    // the scene is rendered at the lower resolution and upscaled to the output before the other hooks run.
+    double render_scale = 1.0;
+    post_hook_t upscale_hook;
+    post_hook_damage_t upscale_damage;
+
     output_t *output;
+    swapchain_damage_manager_t *damage_manager;
     uint32_t output_width, output_height;
-    postprocessing_manager_t(output_t *output)
+    postprocessing_manager_t(output_t *output, swapchain_damage_manager_t *damage_manager)
     {
         this->output = output;
+        this->damage_manager = damage_manager;
+        color_hook = [=] (const wf::framebuffer_t& source, const wf::framebuffer_t& destination)
+        {
+            apply_color_transforms(source, destination);
+        };
+
+        upscale_hook = [=] (const wf::framebuffer_t& source, const wf::framebuffer_t& destination)
+        {
+            draw_with_color_matrix(source, destination, glm::mat4{1.0});
+        };
+
+        upscale_damage = [=] (const wf::region_t& damage)
+        {
+            // Linear filtering samples the neighbouring pixels too.
+            auto upscaled = damage * (1.0 / render_scale);
+            upscaled.expand_edges(2);
+            return upscaled;
+        };
+
+        damage_manager->on_gamma_color_transform_failed = [=] ()
+        {
+            hardware_colors_failed = true;
+            update_color_transforms();
+        };
+
+        wf::get_core().connect(&on_trim);
+    }
+
+    // The buffers stay allocated after the last post hook is removed, see wf::gpu_memory::trim().
+    wf::signal::connection_t<wf::gpu_memory::trim_signal> on_trim = [=] (wf::gpu_memory::trim_signal*)
+    {
+        if (uses_default_buffer())
+        {
+            return;
+        }
+
+        OpenGL::render_begin();
+        for (auto& buffer : post_buffers)
+        {
+            buffer.release_to_pool();
+        }
+
+        OpenGL::render_end();
+    };
+
+    ~postprocessing_manager_t()
+    {
+        if (color_program_compiled)
+        {
+            OpenGL::render_begin();
+            color_program.free_resources();
+            OpenGL::render_end();
+        }
     }
 
     void workaround_wlroots_backend_y_invert(wf::render_target_t& fb) const
@@ -537,9 +1012,23 @@ struct postprocessing_manager_t
         this->output_fb = output_fb;
     }
 
+    /** Whether the scene is rendered to buffer 0 instead of the output's buffer. */
+    bool uses_default_buffer() const
+    {
+        return post_effects.size() || (render_scale < 1.0);
+    }
+
+    wf::dimensions_t get_render_size(int width, int height) const
+    {
+        return {
+            std::max(1, (int)std::round(width * render_scale)),
+            std::max(1, (int)std::round(height * render_scale)),
+        };
+    }
+
     void allocate(int width, int height)
     {
-        if (post_effects.size() == 0)
+        if (!uses_default_buffer())
         {
             return;
         }
@@ -547,56 +1036,247 @@ struct postprocessing_manager_t
         output_width  = width;
         output_height = height;
 
+        auto size = get_render_size(width, height);
         OpenGL::render_begin();
-        post_buffers[default_out_buffer].allocate(width, height);
+        post_buffers[default_out_buffer].allocate_from_pool(size.width, size.height);
         OpenGL::render_end();
     }
 
-    void add_post(post_hook_t *hook)
+    void set_render_scale(double scale)
+    {
+        scale = std::clamp(scale, 0.25, 1.0);
+        if (scale != render_scale)
+        {
+            render_scale  = scale;
+            chain_changed = true;
+            output->render->damage_whole_idle();
+        }
+    }
+
+    void add_post(post_hook_t *hook, post_hook_damage_t damage = {})
     {
         post_effects.push_back(hook);
+        if (damage)
+        {
+            damage_maps[hook] = std::move(damage);
+        }
+
+        if (color_hook_added && (hook != &color_hook))
+        {
+            // Keep the color transforms at the end of the chain.
+            post_effects.remove_all(&color_hook);
+            post_effects.push_back(&color_hook);
+        }
+
+        chain_changed = true;
         output->render->damage_whole_idle();
     }
 
     void rem_post(post_hook_t *hook)
     {
         post_effects.remove_all(hook);
+        damage_maps.erase(hook);
+        chain_changed = true;
         output->render->damage_whole_idle();
     }
 
-    /* Run all postprocessing effects, rendering to alternating buffers and
-     * finally to the screen.
-     *
-     * NB: 2 buffers just aren't enough. We render to the zero buffer, and then
-     * we alternately render to the second and the third. The reason: We track
-     * damage. So, we need to keep the whole buffer each frame. */
-    void run_post_effects()
+    void add_color_transform(color_transform_t *transform)
     {
-        wf::framebuffer_t default_framebuffer;
-        default_framebuffer.fb  = output_fb;
-        default_framebuffer.tex = 0;
-
-        int last_buffer_idx = default_out_buffer;
-        int next_buffer_idx = 1;
+        color_transforms.push_back(transform);
+        update_color_transforms();
+        output->render->damage_whole_idle();
+    }
 
-        post_effects.for_each([&] (auto post) -> void
+    void rem_color_transform(color_transform_t *transform)
+    {
+        auto it = std::find(color_transforms.begin(), color_transforms.end(), transform);
+        if (it == color_transforms.end())
         {
-            /* The last postprocessing hook renders directly to the screen, others to
-             * the currently free buffer */
-            wf::framebuffer_t& next_buffer =
-                (post == post_effects.back() ? default_framebuffer :
-                    post_buffers[next_buffer_idx]);
+            return;
+        }
+
+        color_transforms.erase(it);
+        update_color_transforms();
+        output->render->damage_whole_idle();
+    }
+
+    glm::mat4 get_color_matrix() const
+    {
+        glm::mat4 matrix{1.0};
+        for (auto& transform : color_transforms)
+        {
+            matrix = transform->matrix * matrix;
+        }
+
+        return matrix;
+    }
+
+    static bool is_per_channel(const glm::mat4& matrix)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            for (int j = 0; j < 3; j++)
+            {
+                if ((i != j) && (matrix[i][j] != 0.0f))
+                {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * Decide whether the color transforms are applied with the gamma LUT of the output, which keeps direct
+     * scanout possible and saves a full-screen pass, or by rendering. Called before each frame, because the
+     * matrices of the transforms and the other post hooks may change at any time.
+     */
+    void update_color_transforms()
+    {
+        const auto matrix = get_color_matrix();
+        const size_t other_hooks = post_effects.size() - (color_hook_added ? 1 : 0);
+        const bool use_gamma     = !color_transforms.empty() && (other_hooks == 0) &&
+            hardware_color_transforms && !hardware_colors_failed && is_per_channel(matrix);
+        const bool use_hook = !color_transforms.empty() && !use_gamma;
+
+        if (use_hook != color_hook_added)
+        {
+            color_hook_added = use_hook;
+            if (use_hook)
+            {
+                add_post(&color_hook, [] (const wf::region_t& damage) { return damage; });
+            } else
+            {
+                rem_post(&color_hook);
+            }
+        }
+
+        std::optional<glm::mat4> gamma_transform;
+        if (use_gamma)
+        {
+            gamma_transform = matrix;
+        }
+
+        if (gamma_transform != damage_manager->gamma_color_transform)
+        {
+            damage_manager->set_gamma_color_transform(gamma_transform);
+        }
+    }
+
+    void apply_color_transforms(const wf::framebuffer_t& source, const wf::framebuffer_t& destination)
+    {
+        draw_with_color_matrix(source, destination, get_color_matrix());
+    }
+
+    /** Draw @source stretched over @destination, in the current damage, with linear filtering. */
+    void draw_with_color_matrix(const wf::framebuffer_t& source, const wf::framebuffer_t& destination,
+        const glm::mat4& matrix)
+    {
+        static const float vertex_data[] = {
+            -1.0f, -1.0f,
+            1.0f, -1.0f,
+            1.0f, 1.0f,
+            -1.0f, 1.0f
+        };
+
+        OpenGL::render_begin(destination);
+        if (!color_program_compiled)
+        {
+            color_program.compile_simple(color_transform_vertex_shader, color_transform_fragment_shader);
+            color_program_compiled = true;
+        }
+
+        color_program.use(wf::TEXTURE_TYPE_RGBA);
+        GL_CALL(glActiveTexture(GL_TEXTURE0));
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, source.tex));
+        color_program.attrib_pointer("position", 2, 0, vertex_data);
+        color_program.uniformMatrix4f("color_matrix", matrix);
+
+        GL_CALL(glDisable(GL_BLEND));
+        for (auto& box : current_damage)
+        {
+            destination.scissor(wlr_box_from_pixman_box(box));
+            GL_CALL(glDrawArrays(GL_TRIANGLE_FAN, 0, 4));
+        }
+
+        GL_CALL(glEnable(GL_BLEND));
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+        color_program.deactivate();
+        OpenGL::render_end();
+    }
+
+    /* Run all postprocessing effects, rendering to alternating buffers and
+     * finally to the screen.
+     *
+     * NB: 2 buffers just aren't enough. We render to the zero buffer, and then
+     * we alternately render to the second and the third. The reason: We track
+     * damage. So, we need to keep the whole buffer each frame. */
+    void run_post_effects(int buffer_age)
+    {
+        wf::framebuffer_t default_framebuffer;
+        default_framebuffer.fb  = output_fb;
+        default_framebuffer.tex = 0;
+
+        int last_buffer_idx = default_out_buffer;
+        int next_buffer_idx = 1;
+
+        // Each hook always renders to the same buffer, so the buffers keep the previous frame's output of
+        // their hook, and the damage of the screen's buffer age is already part of the source damage.
+        const wf::region_t whole = wf::geometry_t{0, 0, (int)output_width, (int)output_height};
+        const bool track_damage  = !chain_changed && (damage_maps.size() == post_effects.size());
+        chain_changed  = false;
+        current_damage = track_damage ? (source_damage & whole) : whole;
+
+        // The upscaling of a reduced render scale runs like a hook before all others.
+        std::vector<post_hook_t*> chain;
+        if (render_scale < 1.0)
+        {
+            chain.push_back(&upscale_hook);
+        }
+
+        post_effects.for_each([&] (auto post) { chain.push_back(post); });
+        for (auto post : chain)
+        {
+            if (track_damage)
+            {
+                auto& map = (post == &upscale_hook) ? upscale_damage : damage_maps[post];
+                current_damage = map(current_damage) & whole;
+            }
+
+            if (post == chain.back())
+            {
+                last_hook_damage.push_front(current_damage);
+                last_hook_damage.resize(std::min(last_hook_damage.size(), MAX_BUFFER_AGE));
+                if (!track_damage || (buffer_age <= 0) || (buffer_age > (int)last_hook_damage.size()))
+                {
+                    current_damage = whole;
+                } else
+                {
+                    for (int i = 1; i < buffer_age; i++)
+                    {
+                        current_damage |= last_hook_damage[i];
+                    }
+                }
+            }
+
+            /* The last postprocessing hook renders directly to the screen, others to
+             * the currently free buffer */
+            wf::framebuffer_t& next_buffer =
+                (post == chain.back() ? default_framebuffer :
+                    post_buffers[next_buffer_idx]);
 
             OpenGL::render_begin();
             /* Make sure we have the correct resolution */
-            next_buffer.allocate(output_width, output_height);
+            next_buffer.allocate_from_pool(output_width, output_height);
             OpenGL::render_end();
 
+            wf::plugin_stats::scope_t cost{post->target_type(), wf::plugin_stats::COST_POST_HOOK};
             (*post)(post_buffers[last_buffer_idx], next_buffer);
 
             last_buffer_idx  = next_buffer_idx;
             next_buffer_idx ^= 0b11; // alternate 1 and 2
-        });
+        }
     }
 
     wf::render_target_t get_target_framebuffer() const
@@ -607,8 +1287,13 @@ struct postprocessing_manager_t
         fb.transform    = get_output_matrix_from_transform(
             (wl_output_transform)fb.wl_transform);
         fb.scale = output->handle->scale;
+        if (render_region)
+        {
+            fb.scale   *= 1.0 * fb.geometry.width / render_region->width;
+            fb.geometry = *render_region;
+        }
 
-        if (post_effects.size())
+        if (uses_default_buffer())
         {
             fb.fb  = post_buffers[default_out_buffer].fb;
             fb.tex = post_buffers[default_out_buffer].tex;
@@ -619,22 +1304,35 @@ struct postprocessing_manager_t
         }
 
         workaround_wlroots_backend_y_invert(fb);
-        fb.viewport_width  = output->handle->width;
-        fb.viewport_height = output->handle->height;
+        auto size = get_render_size(output->handle->width, output->handle->height);
+        fb.scale *= render_scale;
+        fb.viewport_width  = size.width;
+        fb.viewport_height = size.height;
 
         return fb;
     }
 
     bool can_scanout() const
     {
-        return post_effects.size() == 0;
+        return !uses_default_buffer() && !render_region;
+    }
+
+    /** Convert output-local damage to the output's coordinates before its scale is applied. */
+    wf::region_t get_output_damage(const wf::region_t& damage) const
+    {
+        if (!render_region)
+        {
+            return damage;
+        }
+
+        auto magnified = (damage & *render_region) + -wf::origin(*render_region);
+        return magnified * (1.0 * output->get_relative_geometry().width / render_region->width);
     }
 };
 
 /**
- * Responsible for attaching depth buffers to framebuffers.
- * It keeps at most 3 depth buffers at any given time to conserve
- * resources.
+ * Responsible for attaching depth buffers to the framebuffers of an output while they are required. The depth
+ * buffers themselves are shared with other framebuffers of the same size, see OpenGL::attach_depth_buffer().
  */
 class depth_buffer_manager_t
 {
@@ -648,7 +1346,11 @@ class depth_buffer_manager_t
             return;
         }
 
-        attach_buffer(find_buffer(fb), fb, width, height);
+        OpenGL::attach_depth_buffer(fb, width, height);
+        if (std::find(attached.begin(), attached.end(), fb) == attached.end())
+        {
+            attached.push_back(fb);
+        }
     }
 
     void set_required(bool require)
@@ -656,7 +1358,7 @@ class depth_buffer_manager_t
         required_counter += require ? 1 : -1;
         if (required_counter <= 0)
         {
-            free_all_buffers();
+            detach_all_buffers();
         }
     }
 
@@ -664,7 +1366,7 @@ class depth_buffer_manager_t
 
     ~depth_buffer_manager_t()
     {
-        free_all_buffers();
+        detach_all_buffers();
     }
 
     depth_buffer_manager_t(const depth_buffer_manager_t &) = delete;
@@ -673,97 +1375,160 @@ class depth_buffer_manager_t
     depth_buffer_manager_t& operator =(depth_buffer_manager_t&&) = delete;
 
   private:
-    static constexpr size_t MAX_BUFFERS = 3;
     int required_counter = 0;
+    // The framebuffers of the output's swapchain we have attached depth buffers to
+    std::vector<int> attached;
 
-    struct depth_buffer_t
+    void detach_all_buffers()
     {
-        GLuint tex = -1;
-        int attached_to = -1;
-        int width  = 0;
-        int height = 0;
-
-        int64_t last_used = 0;
-    };
+        if (attached.empty())
+        {
+            return;
+        }
 
-    void free_buffer(depth_buffer_t& buffer)
-    {
-        if (buffer.tex != (GLuint) - 1)
+        OpenGL::render_begin();
+        for (auto fb : attached)
         {
-            GL_CALL(glDeleteTextures(1, &buffer.tex));
+            OpenGL::detach_depth_buffer(fb);
         }
+
+        OpenGL::render_end();
+        attached.clear();
     }
+};
+
+/**
+ * Measures the time the GPU spends on rendering a frame using GL_EXT_disjoint_timer_query.
+ *
+ * Query results become available asynchronously, typically one or two frames later, so a small ring of
+ * query objects is used and the most recent available result is reported.
+ */
+class gpu_render_timer_t
+{
+  public:
+    // The queries are created with the first frame, outputs which never render (for example while they are
+    // being configured) do not need them.
+    gpu_render_timer_t() = default;
 
-    void free_all_buffers()
+    ~gpu_render_timer_t()
     {
-        OpenGL::render_begin();
-        for (auto& b : buffers)
+        if (supported)
         {
-            free_buffer(b);
+            OpenGL::render_begin();
+            GL_CALL(glDeleteQueries(NUM_QUERIES, queries));
+            OpenGL::render_end();
         }
+    }
 
-        OpenGL::render_end();
+    gpu_render_timer_t(const gpu_render_timer_t&) = delete;
+    gpu_render_timer_t(gpu_render_timer_t&&) = delete;
+    gpu_render_timer_t& operator =(const gpu_render_timer_t&) = delete;
+    gpu_render_timer_t& operator =(gpu_render_timer_t&&) = delete;
+
+    /** Needs a current GL context. */
+    bool is_supported()
+    {
+        ensure_queries();
+        return supported;
     }
 
-    void attach_buffer(depth_buffer_t& buffer, int fb, int width, int height)
+    /** Start measuring. Needs a current GL context. */
+    void begin()
     {
-        if ((buffer.attached_to == fb) &&
-            (buffer.width == width) &&
-            (buffer.height == height))
+        if (!is_supported() || pending[next_query])
         {
+            // The oldest query has not finished yet, skip measuring this frame.
+            active = false;
             return;
         }
 
-        free_buffer(buffer);
-        GL_CALL(glGenTextures(1, &buffer.tex));
-        GL_CALL(glBindTexture(GL_TEXTURE_2D, buffer.tex));
-        GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT,
-            width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, NULL));
-        buffer.width  = width;
-        buffer.height = height;
+        GL_CALL(glBeginQuery(GL_TIME_ELAPSED_EXT, queries[next_query]));
+        active = true;
+    }
 
-        GL_CALL(glBindTexture(GL_TEXTURE_2D, buffer.tex));
-        GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, fb));
-        GL_CALL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-            GL_TEXTURE_2D, buffer.tex, 0));
-        GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+    /** Stop measuring. Needs a current GL context. */
+    void end()
+    {
+        if (!active)
+        {
+            return;
+        }
 
-        buffer.attached_to = fb;
-        buffer.last_used   = get_current_time();
+        GL_CALL(glEndQuery(GL_TIME_ELAPSED_EXT));
+        pending[next_query] = true;
+        next_query = (next_query + 1) % NUM_QUERIES;
+        active     = false;
     }
 
-    depth_buffer_t& find_buffer(int fb)
+    /**
+     * Collect the results of finished queries. Needs a current GL context.
+     *
+     * @return The GPU time in microseconds of the most recent finished frame, or -1 if no new results
+     *   are available.
+     */
+    int64_t collect()
     {
-        for (auto& buffer : buffers)
+        if (!is_supported())
         {
-            if (buffer.attached_to == fb)
-            {
-                return buffer;
-            }
+            return -1;
         }
 
-        /** New buffer? */
-        if (buffers.size() < MAX_BUFFERS)
+        GLint disjoint = 0;
+        GL_CALL(glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint));
+
+        int64_t result = -1;
+        for (int i = 0; i < NUM_QUERIES; i++)
         {
-            buffers.push_back(depth_buffer_t{});
+            // Go from the oldest to the newest query
+            int idx = (next_query + i) % NUM_QUERIES;
+            if (!pending[idx])
+            {
+                continue;
+            }
 
-            return buffers.back();
-        }
+            GLuint available = 0;
+            GL_CALL(glGetQueryObjectuiv(queries[idx], GL_QUERY_RESULT_AVAILABLE, &available));
+            if (!available)
+            {
+                break;
+            }
 
-        /** Evict oldest */
-        auto oldest = &buffers.front();
-        for (auto& buffer : buffers)
-        {
-            if (buffer.last_used < oldest->last_used)
+            GLuint elapsed_ns = 0;
+            GL_CALL(glGetQueryObjectuiv(queries[idx], GL_QUERY_RESULT, &elapsed_ns));
+            pending[idx] = false;
+            if (!disjoint)
             {
-                oldest = &buffer;
+                result = elapsed_ns / 1000;
             }
         }
 
-        return *oldest;
+        return result;
     }
 
-    std::vector<depth_buffer_t> buffers;
+  private:
+    static constexpr int NUM_QUERIES = 4;
+    bool initialized = false;
+    bool supported   = false;
+    bool active    = false;
+    int next_query = 0;
+    GLuint queries[NUM_QUERIES];
+    bool pending[NUM_QUERIES] = {false};
+
+    void ensure_queries()
+    {
+        if (initialized)
+        {
+            return;
+        }
+
+        initialized = true;
+        auto ext = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+        supported = ext && strstr(ext, "GL_EXT_disjoint_timer_query");
+        if (supported)
+        {
+            GL_CALL(glGenQueries(NUM_QUERIES, queries));
+        }
+    }
 };
 
 /**
@@ -794,15 +1559,31 @@ class depth_buffer_manager_t
  * delay is increased by one. If the next frame is delayed, then
  * `increase_window` is doubled, otherwise, it is halved
  * (but it must stay between `MIN_INCREASE_WINDOW` and `MAX_INCREASE_WINDOW`).
+ *
+ * Alternatively, if workarounds/measured_repaint_delay is enabled, the render cost (CPU time for the repaint
+ * plus GPU time measured with timer queries) of the last frames is tracked, and the delay is chosen so that
+ * the 95th percentile of the cost plus workarounds/repaint_delay_margin still fits in the refresh period.
  */
 struct repaint_delay_manager_t
 {
     repaint_delay_manager_t(wf::output_t *output)
     {
-        on_present.set_callback([&] (void *data)
+        on_present.set_callback([this, output] (void *data)
         {
             auto ev = static_cast<wlr_output_event_present*>(data);
             this->refresh_nsec = ev->refresh;
+
+            const int64_t when = ev->when ? wf::timespec_to_usec(*ev->when) : wf::get_current_time_usec();
+            if (ev->presented && ev->when)
+            {
+                last_presentation = when;
+            }
+
+            input_latency::note_frame_presented(output, ev->presented, when);
+            if (wf::startup_profile::enabled && ev->presented)
+            {
+                wf::startup_profile::finish("output " + output->to_string() + ": first frame presented");
+            }
         });
         on_present.connect(&output->handle->events.present);
     }
@@ -822,6 +1603,12 @@ struct repaint_delay_manager_t
      */
     void start_frame()
     {
+        if (measured_delay)
+        {
+            update_measured_delay();
+            return;
+        }
+
         if (last_pageflip == -1)
         {
             last_pageflip = get_current_time();
@@ -871,6 +1658,22 @@ struct repaint_delay_manager_t
         last_pageflip = get_current_time();
     }
 
+    /**
+     * Predict when a frame started at @start (in microseconds) will be presented, see
+     * render_manager::get_predicted_presentation_time().
+     */
+    int64_t predict_presentation(int64_t start) const
+    {
+        const int64_t refresh_usec = this->refresh_nsec / 1000;
+        if ((last_presentation < 0) || (refresh_usec <= 0) || (start < last_presentation))
+        {
+            return start;
+        }
+
+        const int64_t cycles = (start - last_presentation) / refresh_usec + 1;
+        return last_presentation + cycles * refresh_usec;
+    }
+
     /**
      * @return The delay in milliseconds for the current frame.
      */
@@ -879,8 +1682,55 @@ struct repaint_delay_manager_t
         return delay;
     }
 
+    /**
+     * Whether the delay should be computed from the render cost reported via report_render_cost().
+     */
+    bool uses_measured_cost() const
+    {
+        return measured_delay;
+    }
+
+    /**
+     * Report the render cost of the last frame in microseconds.
+     */
+    void report_render_cost(int64_t cost_usec)
+    {
+        if (recent_costs.size() < COST_WINDOW)
+        {
+            recent_costs.push_back(cost_usec);
+        } else
+        {
+            recent_costs[next_cost] = cost_usec;
+        }
+
+        next_cost = (next_cost + 1) % COST_WINDOW;
+    }
+
   private:
     int delay = 0;
+    /* The time the last frame was presented, in microseconds, or -1 if unknown */
+    int64_t last_presentation = -1;
+
+    static constexpr size_t COST_WINDOW = 64;
+    std::vector<int64_t> recent_costs;
+    size_t next_cost = 0;
+
+    void update_measured_delay()
+    {
+        if ((max_render_time == -1) || recent_costs.empty())
+        {
+            delay = 0;
+            return;
+        }
+
+        auto sorted = recent_costs;
+        const size_t idx = std::min(sorted.size() - 1, sorted.size() * 95 / 100);
+        std::nth_element(sorted.begin(), sorted.begin() + idx, sorted.end());
+
+        const int64_t budget_usec = sorted[idx] + std::max(0, (int)repaint_delay_margin) * 1000;
+        const int64_t refresh_usec = this->refresh_nsec / 1000;
+        delay = std::max(int64_t(0), (refresh_usec - budget_usec) / 1000);
+    }
 
     void update_delay(int delta)
     {
@@ -920,323 +1770,1388 @@ struct repaint_delay_manager_t
     // Time of last frame
     int64_t last_pageflip = -1; // -1 is invalid
 
-    int64_t refresh_nsec;
+    int64_t refresh_nsec = 0;
     wf::option_wrapper_t<int> max_render_time{"core/max_render_time"};
     wf::option_wrapper_t<bool> dynamic_delay{"workarounds/dynamic_repaint_delay"};
+    wf::option_wrapper_t<bool> measured_delay{"workarounds/measured_repaint_delay"};
+    wf::option_wrapper_t<int> repaint_delay_margin{"workarounds/repaint_delay_margin"};
 
     wf::wl_listener_wrapper on_present;
 };
 
-class wf::render_manager::impl
+/**
+ * Keeps track of the time spent in the different phases of the repaint cycle over the last frames.
+ */
+struct frame_stats_manager_t
 {
-  public:
-    wf::wl_listener_wrapper on_frame;
-    wf::wl_timer<false> repaint_timer;
+    /** Number of frames kept for the rolling statistics */
+    static constexpr size_t WINDOW = 256;
+    /** Number of histogram buckets, the last bucket contains all frames longer than ~1s */
+    static constexpr int HISTOGRAM_BUCKETS = 21;
 
-    output_t *output;
-    wf::region_t swap_damage;
-    std::unique_ptr<swapchain_damage_manager_t> damage_manager;
-    std::unique_ptr<effect_hook_manager_t> effects;
-    std::unique_ptr<postprocessing_manager_t> postprocessing;
-    std::unique_ptr<depth_buffer_manager_t> depth_buffer_manager;
-    std::unique_ptr<repaint_delay_manager_t> delay_manager;
+    uint64_t rendered_frames = 0;
+    uint64_t scanout_frames  = 0;
+    uint64_t idle_frames     = 0;
 
-    wf::option_wrapper_t<wf::color_t> background_color_opt;
+    /** The durations of the current frame, in microseconds */
+    int64_t current[FRAME_PHASE_COUNT];
 
-    impl(output_t *o) : output(o), env_allow_scanout(check_scanout_enabled())
+    void start_frame()
     {
-        damage_manager = std::make_unique<swapchain_damage_manager_t>(o);
-        effects = std::make_unique<effect_hook_manager_t>();
-        postprocessing = std::make_unique<postprocessing_manager_t>(o);
-        depth_buffer_manager = std::make_unique<depth_buffer_manager_t>();
-        delay_manager = std::make_unique<repaint_delay_manager_t>(o);
+        std::fill(std::begin(current), std::end(current), 0);
+        frame_start = wf::get_current_time_usec();
+    }
 
-        on_frame.set_callback([&] (void*)
-        {
-            delay_manager->start_frame();
+    /** Add the time which has passed since @since to the given phase. */
+    void add_time(frame_phase_t phase, int64_t since)
+    {
+        current[phase] += wf::get_current_time_usec() - since;
+    }
 
-            auto repaint_delay = delay_manager->get_delay();
-            // Leave a bit of time for clients to render, see
-            // https://github.com/swaywm/sway/pull/4588
-            if (repaint_delay < 1)
+    /** Store the durations of the current frame in the rolling window. */
+    void finish_frame()
+    {
+        current[FRAME_PHASE_TOTAL] = wf::get_current_time_usec() - frame_start;
+        for (int i = 0; i < FRAME_PHASE_COUNT; i++)
+        {
+            if (samples[i].size() < WINDOW)
             {
-                output->handle->frame_pending = false;
-                paint();
+                samples[i].push_back(current[i]);
             } else
             {
-                output->handle->frame_pending = true;
-                repaint_timer.set_timeout(repaint_delay, [=] ()
-                {
-                    output->handle->frame_pending = false;
-                    paint();
-                });
+                samples[i][next_sample] = current[i];
             }
+        }
 
-            frame_done_signal ev;
-            output->emit(&ev);
-        });
-
-        on_frame.connect(&output->handle->events.frame);
-
-        background_color_opt.load_option("core/background_color");
-        background_color_opt.set_callback([=] ()
-        {
-            damage_manager->damage_whole_idle();
-        });
-
-        damage_manager->schedule_repaint();
+        next_sample = (next_sample + 1) % WINDOW;
+        ++rendered_frames;
     }
 
-    const bool env_allow_scanout;
-    static bool check_scanout_enabled()
+    frame_stats_t get_stats() const
     {
-        const char *env_scanout = getenv("WAYFIRE_DISABLE_DIRECT_SCANOUT");
-        bool env_allow_scanout  = (env_scanout == nullptr) || (!strcmp(env_scanout, "0"));
-        if (!env_allow_scanout)
+        frame_stats_t stats;
+        stats.rendered_frames = rendered_frames;
+        stats.scanout_frames  = scanout_frames;
+        stats.idle_frames     = idle_frames;
+        for (int i = 0; i < FRAME_PHASE_COUNT; i++)
         {
-            LOGC(SCANOUT, "Scanout disabled by environment variable.");
+            stats.phases[i] = compute_phase_stats(samples[i]);
         }
 
-        return env_allow_scanout;
+        return stats;
     }
 
-    int output_inhibit_counter = 0;
-    void add_inhibit(bool add)
+    /** Compute the statistics of a list of durations, also used for the input latency statistics. */
+    static frame_phase_stats_t compute_phase_stats(std::vector<int64_t> values)
+    {
+        frame_phase_stats_t stats;
+        stats.histogram.assign(HISTOGRAM_BUCKETS, 0);
+        if (values.empty())
+        {
+            return stats;
+        }
+
+        std::sort(values.begin(), values.end());
+        int64_t sum = 0;
+        for (auto& value : values)
+        {
+            sum += value;
+
+            int bucket = 0;
+            while ((bucket < HISTOGRAM_BUCKETS - 1) && ((int64_t(2) << bucket) <= value))
+            {
+                ++bucket;
+            }
+
+            stats.histogram[bucket]++;
+        }
+
+        auto percentile = [&] (int p)
+        {
+            return values[std::min(values.size() - 1, values.size() * p / 100)];
+        };
+
+        stats.samples = values.size();
+        stats.min     = values.front();
+        stats.max     = values.back();
+        stats.avg     = sum / (int64_t)values.size();
+        stats.p50     = percentile(50);
+        stats.p90     = percentile(90);
+        stats.p99     = percentile(99);
+        return stats;
+    }
+
+  private:
+    int64_t frame_start = 0;
+    size_t next_sample  = 0;
+    std::vector<int64_t> samples[FRAME_PHASE_COUNT];
+};
+
+/**
+ * Decides how much effects on an output have to be degraded so that frames fit in the refresh period.
+ *
+ * The controller keeps a pressure value, which rises quickly while the render cost of the frames is close to
+ * the refresh period and falls slowly once there is enough headroom again, so that effects are not toggled
+ * back and forth on every frame. The effects in workarounds/effect_degradation_order are degraded one
+ * after another: the first one is degraded while the pressure goes from 0 to 1, the second one from 1 to 2,
+ * and so on.
+ */
+struct effect_budget_manager_t
+{
+    /** Frames costing more than this fraction of the refresh period raise the pressure. */
+    static constexpr double HIGH_LOAD = 0.9;
+    /** Frames costing less than this fraction of the refresh period lower the pressure. */
+    static constexpr double LOW_LOAD = 0.6;
+    static constexpr double RAISE_STEP = 0.1;
+    static constexpr double LOWER_STEP = 0.02;
+
+    effect_budget_manager_t()
+    {
+        order_opt.set_callback([=] { load_order(); });
+        load_order();
+    }
+
+    /** Report the render cost of the last frame, in microseconds. */
+    void report_cost(int64_t cost_usec, int64_t refresh_nsec)
+    {
+        if (order.empty() || (refresh_nsec <= 0))
+        {
+            pressure = 0;
+            return;
+        }
+
+        const double load = cost_usec * 1000.0 / refresh_nsec;
+        if (load > HIGH_LOAD)
+        {
+            pressure += RAISE_STEP;
+        } else if (load < LOW_LOAD)
+        {
+            pressure -= LOWER_STEP;
+        }
+
+        pressure = std::clamp(pressure, 0.0, (double)order.size());
+    }
+
+    double get_quality(const std::string& effect) const
+    {
+        auto it = std::find(order.begin(), order.end(), effect);
+        if (it == order.end())
+        {
+            return 1.0;
+        }
+
+        const double degraded = pressure - (it - order.begin());
+        return 1.0 - std::clamp(degraded, 0.0, 1.0);
+    }
+
+  private:
+    void load_order()
+    {
+        order.clear();
+        std::istringstream stream{(std::string)order_opt};
+        std::string effect;
+        while (stream >> effect)
+        {
+            order.push_back(effect);
+        }
+
+        pressure = std::clamp(pressure, 0.0, (double)order.size());
+    }
+
+    double pressure = 0;
+    std::vector<std::string> order;
+    wf::option_wrapper_t<std::string> order_opt{"workarounds/effect_degradation_order"};
+};
+
+/**
+ * Presents the topmost surfaces of an output on output layers (hardware planes), so that they do not need to
+ * be composited on the GPU. The cursor is not handled here, because wlroots already puts it on a cursor plane.
+ *
+ * Output layers are stacked above the primary buffer, so only surfaces which are not covered by anything else
+ * can be moved to a layer. The instances on accepted layers are excluded from the render pass.
+ */
+class output_layers_manager_t
+{
+  public:
+    output_layers_manager_t(output_t *output)
+    {
+        this->output = output;
+    }
+
+    ~output_layers_manager_t()
+    {
+        for (auto layer : layers)
+        {
+            wlr_output_layer_destroy(layer);
+        }
+    }
+
+    /** The render instances which are presented on output layers in the current frame. */
+    std::vector<scene::render_instance_t*> offloaded;
+
+    bool has_active_layers() const
+    {
+        return !offloaded.empty();
+    }
+
+    /**
+     * Decide which render instances are presented on output layers in the next frame, and add the layers to
+     * the frame's output state. Areas which change between being composited and being on a layer are damaged.
+     */
+    void plan_frame(wlr_output_state& state, swapchain_damage_manager_t& damage_manager, bool allow_layers)
+    {
+        const size_t max_layers = std::max(0, (int)max_output_layers);
+        while (layers.size() < max_layers)
+        {
+            layers.push_back(wlr_output_layer_create(output->handle));
+        }
+
+        offloaded.clear();
+        if (layers.empty())
+        {
+            return;
+        }
+
+        // Surfaces on layers bypass the postprocessing effects.
+        scene::output_layers_plan_t plan;
+        plan.max_layers = max_layers;
+        if (allow_layers)
+        {
+            scene::try_output_layers_from_list(damage_manager.render_instances, output, plan);
+        }
+
+        auto& candidates = plan.candidates;
+        while (!candidates.empty())
+        {
+            set_layers(state, candidates);
+            if (!wlr_output_test_state(output->handle, &state))
+            {
+                candidates.clear();
+                break;
+            }
+
+            // A rejected candidate is composited into the primary buffer, so all candidates below it must be
+            // composited as well, otherwise they would end up above it.
+            size_t accepted = 0;
+            while ((accepted < candidates.size()) && layer_states[candidates.size() - 1 - accepted].accepted)
+            {
+                ++accepted;
+            }
+
+            if (accepted == candidates.size())
+            {
+                break;
+            }
+
+            candidates.resize(accepted);
+        }
+
+        set_layers(state, candidates);
+
+        std::vector<wlr_box> boxes;
+        for (auto& candidate : candidates)
+        {
+            offloaded.push_back(candidate.instance);
+            boxes.push_back(candidate.dst_box);
+            candidate.instance->presentation_feedback(output);
+        }
+
+        // The primary buffer has to be repainted wherever a surface was added to or removed from a layer.
+        for (auto& box : boxes)
+        {
+            if (std::find(offloaded_boxes.begin(), offloaded_boxes.end(), box) == offloaded_boxes.end())
+            {
+                damage_manager.damage_buffer_box(box);
+            }
+        }
+
+        for (auto& box : offloaded_boxes)
+        {
+            if (std::find(boxes.begin(), boxes.end(), box) == boxes.end())
+            {
+                damage_manager.damage_buffer_box(box);
+            }
+        }
+
+        offloaded_boxes = std::move(boxes);
+    }
+
+  private:
+    wf::option_wrapper_t<int> max_output_layers{"workarounds/max_output_layers"};
+    output_t *output;
+
+    std::vector<wlr_output_layer*> layers;
+    std::vector<wlr_output_layer_state> layer_states;
+    std::vector<wlr_box> offloaded_boxes;
+
+    /**
+     * wlroots expects all layers of the output, ordered from bottom to top, while the candidates are ordered
+     * from top to bottom. Layers without a candidate are disabled.
+     */
+    void set_layers(wlr_output_state& state, const std::vector<scene::output_layer_candidate_t>& candidates)
+    {
+        layer_states.assign(layers.size(), wlr_output_layer_state{});
+        for (size_t i = 0; i < layers.size(); i++)
+        {
+            layer_states[i].layer = layers[i];
+            if (i < candidates.size())
+            {
+                auto& candidate = candidates[candidates.size() - 1 - i];
+                layer_states[i].buffer  = candidate.buffer;
+                layer_states[i].src_box = candidate.src_box;
+                layer_states[i].dst_box = candidate.dst_box;
+            }
+        }
+
+        wlr_output_state_set_layers(&state, layer_states.data(), layer_states.size());
+    }
+};
+
+/**
+ * Implements the fullscreen-only adaptive sync policy (output option adaptive_sync): adaptive sync is enabled
+ * while a fullscreen view is promoted above the top layer, and disabled while the desktop is visible, so that
+ * games and videos get a variable refresh rate without the desktop flickering.
+ *
+ * The always-on policy is a part of the output configuration and is handled by the output layout.
+ */
+class adaptive_sync_manager_t
+{
+  public:
+    adaptive_sync_manager_t(output_t *output)
+    {
+        this->output = output;
+        auto section = wf::get_core().config_backend->get_output_section(output->handle);
+        policy.load_option(section->get_name() + "/adaptive_sync");
+        policy.set_callback([=] () { test_failed = false; });
+        output->connect(&on_fullscreen_focused);
+    }
+
+    bool is_active() const
+    {
+        return output->handle->adaptive_sync_status == WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED;
+    }
+
+    /**
+     * Add a change of the adaptive sync state to the frame's output state, if the policy requires one.
+     */
+    void plan_frame(wlr_output_state& state)
+    {
+        if ((std::string(policy) != "fullscreen-only") || test_failed || (is_active() == fullscreen_promoted))
+        {
+            return;
+        }
+
+        wlr_output_state_set_adaptive_sync_enabled(&state, fullscreen_promoted);
+        if (!wlr_output_test_state(output->handle, &state))
+        {
+            // Do not try again every frame, the output most likely does not support adaptive sync.
+            LOGE("Failed to change adaptive sync on output ", output->to_string(), " to ",
+                fullscreen_promoted);
+            state.committed &= ~WLR_OUTPUT_STATE_ADAPTIVE_SYNC_ENABLED;
+            test_failed = true;
+        } else
+        {
+            LOGD("Changed adaptive sync on output ", output->to_string(), " to ", fullscreen_promoted);
+        }
+    }
+
+  private:
+    output_t *output;
+    wf::option_wrapper_t<std::string> policy;
+    bool fullscreen_promoted = false;
+    bool test_failed = false;
+
+    wf::signal::connection_t<fullscreen_layer_focused_signal> on_fullscreen_focused =
+        [=] (fullscreen_layer_focused_signal *ev)
+    {
+        fullscreen_promoted = ev->has_promoted;
+        output->render->schedule_redraw();
+    };
+};
+
+class wf::render_manager::impl
+{
+  public:
+    wf::wl_listener_wrapper on_frame;
+    wf::wl_timer<false> repaint_timer;
+
+    output_t *output;
+    wf::region_t swap_damage;
+    std::unique_ptr<swapchain_damage_manager_t> damage_manager;
+    std::unique_ptr<effect_hook_manager_t> effects;
+    std::unique_ptr<postprocessing_manager_t> postprocessing;
+    std::unique_ptr<depth_buffer_manager_t> depth_buffer_manager;
+    std::unique_ptr<repaint_delay_manager_t> delay_manager;
+    /* The predicted presentation time of the frame being painted, or -1 outside of paint() */
+    int64_t frame_presentation = -1;
+    std::unique_ptr<output_layers_manager_t> output_layers;
+    std::unique_ptr<adaptive_sync_manager_t> adaptive_sync;
+    std::unique_ptr<gpu_render_timer_t> gpu_timer;
+    frame_stats_manager_t frame_stats;
+    effect_budget_manager_t effect_budget;
+
+    // Kept between frames so that the instruction list does not need to be reallocated every frame
+    std::vector<scene::render_instruction_t> instruction_buffer;
+    // Same for the damage regions of the instructions, including those of nested render passes
+    scene::render_pass_arena_t frame_arena;
+
+    wf::option_wrapper_t<wf::color_t> background_color_opt;
+    wf::option_wrapper_t<bool> allow_tearing_opt;
+    bool tearing_allowed = false;
+    wf::option_wrapper_t<double> render_scale_opt;
+
+    impl(output_t *o) : output(o), env_allow_scanout(check_scanout_enabled())
+    {
+        damage_manager = std::make_unique<swapchain_damage_manager_t>(o);
+        effects = std::make_unique<effect_hook_manager_t>();
+        postprocessing = std::make_unique<postprocessing_manager_t>(o, damage_manager.get());
+        depth_buffer_manager = std::make_unique<depth_buffer_manager_t>();
+        delay_manager = std::make_unique<repaint_delay_manager_t>(o);
+        output_layers = std::make_unique<output_layers_manager_t>(o);
+        adaptive_sync = std::make_unique<adaptive_sync_manager_t>(o);
+        gpu_timer     = std::make_unique<gpu_render_timer_t>();
+
+        on_frame.set_callback([&] (void*)
+        {
+            idle_frame_timer.disconnect();
+            commit_pending = false;
+            if (held_frame)
+            {
+                commit_held_frame();
+            }
+
+            delay_manager->start_frame();
+
+            auto repaint_delay = delay_manager->get_delay();
+            if (adaptive_sync->is_active())
+            {
+                // The display waits for our frame, delaying the repaint would only lower the refresh rate.
+                repaint_delay = 0;
+            }
+
+            planned_paint_start = wf::get_current_time_usec() + repaint_delay * 1000;
+            // Leave a bit of time for clients to render, see
+            // https://github.com/swaywm/sway/pull/4588
+            if (repaint_delay < 1)
+            {
+                output->handle->frame_pending = false;
+                paint();
+            } else
+            {
+                output->handle->frame_pending = true;
+                repaint_timer.set_timeout(repaint_delay, [=] ()
+                {
+                    output->handle->frame_pending = false;
+                    paint();
+                });
+            }
+
+            frame_done_signal ev;
+            ev.repaint_delay = std::max(0, repaint_delay);
+            output->emit(&ev);
+        });
+
+        on_frame.connect(&output->handle->events.frame);
+
+        on_commit.set_callback([=] (void *data)
+        {
+            auto ev = static_cast<wlr_output_event_commit*>(data);
+            if (ev->state->committed & WLR_OUTPUT_STATE_ENABLED)
+            {
+                update_content_shown();
+            }
+        });
+        on_commit.connect(&output->handle->events.commit);
+
+        auto section = wf::get_core().config_backend->get_output_section(output->handle);
+        allow_tearing_opt.load_option(section->get_name() + "/allow_tearing");
+        allow_tearing_opt.set_callback([=] () { tearing_allowed = allow_tearing_opt; });
+        tearing_allowed = allow_tearing_opt;
+
+        render_scale_opt.load_option(section->get_name() + "/render_scale");
+        render_scale_opt.set_callback([=] () { postprocessing->set_render_scale(render_scale_opt); });
+        postprocessing->render_scale = std::clamp((double)render_scale_opt, 0.25, 1.0);
+
+        background_color_opt.load_option("core/background_color");
+        background_color_opt.set_callback([=] ()
+        {
+            damage_manager->damage_whole_idle();
+        });
+
+        damage_manager->schedule_repaint();
+    }
+
+    const bool env_allow_scanout;
+    static bool check_scanout_enabled()
+    {
+        const char *env_scanout = getenv("WAYFIRE_DISABLE_DIRECT_SCANOUT");
+        bool env_allow_scanout  = (env_scanout == nullptr) || (!strcmp(env_scanout, "0"));
+        if (!env_allow_scanout)
+        {
+            LOGC(SCANOUT, "Scanout disabled by environment variable.");
+        }
+
+        return env_allow_scanout;
+    }
+
+    bool blanked = false;
+    wf::wl_listener_wrapper on_commit;
+    void update_content_shown()
+    {
+        const bool shown = output->handle->enabled && !blanked;
+        if (shown == damage_manager->content_shown)
+        {
+            return;
+        }
+
+        LOGC(RENDER, "Output ", output->to_string(), shown ? ": contents shown." : ": contents hidden.");
+        damage_manager->content_shown = shown;
+        damage_manager->update_scenegraph(scene::update_flag::GEOMETRY);
+
+        output_content_shown_signal data;
+        data.output = output;
+        data.shown  = shown;
+        output->emit(&data);
+        wf::get_core().emit(&data);
+    }
+
+    int output_inhibit_counter = 0;
+    // The number of inhibits held by each owner, for get_scanout_stats()
+    std::map<std::string, int> inhibitors;
+    void add_inhibit(bool add, const std::string& owner)
     {
         output_inhibit_counter += add ? 1 : -1;
+        inhibitors[owner] += add ? 1 : -1;
+        if (inhibitors[owner] <= 0)
+        {
+            // Inhibits may be removed by different code than the one which added them.
+            inhibitors.erase(owner);
+        }
+
         if (output_inhibit_counter == 0)
         {
             damage_manager->damage_whole_idle();
 
-            wf::output_start_rendering_signal data;
-            data.output = output;
-            output->emit(&data);
-        }
+            wf::output_start_rendering_signal data;
+            data.output = output;
+            output->emit(&data);
+        }
+    }
+
+    /* Actual rendering functions */
+
+    /**
+     * Bind the output's EGL surface, allocate buffers
+     */
+    void bind_output(uint32_t fb)
+    {
+        OpenGL::bind_output(output, fb);
+
+        /* Make sure the default buffer has enough size */
+        postprocessing->allocate(output->handle->width, output->handle->height);
+    }
+
+    /**
+     * Pipelined rendering: while a committed frame waits to be presented, the next frame is rendered and
+     * submitted to the GPU already, and committed as soon as the previous one is presented. The GPU then has
+     * a whole refresh cycle to finish a frame, at the cost of one frame of additional latency.
+     *
+     * Committing does not wait for the GPU: the scanout of the new buffer waits for the rendering to finish.
+     */
+    wf::option_wrapper_t<bool> pipelined_rendering{"workarounds/pipelined_rendering"};
+    // A frame which was rendered while the previous frame was not presented yet
+    std::unique_ptr<swapchain_damage_manager_t::frame_object_t> held_frame;
+    int64_t held_frame_paint_start = 0;
+    // Whether a frame was committed which was not presented yet
+    bool commit_pending = false;
+    wf::wl_idle_call idle_render_ahead;
+
+    bool can_pipeline() const
+    {
+        return pipelined_rendering && !adaptive_sync->is_active() && !tearing_allowed &&
+               !output_inhibit_counter;
+    }
+
+    void commit_held_frame()
+    {
+        auto frame = std::move(held_frame);
+        if (can_try_scanout())
+        {
+            // Prefer scanning out over showing the frame rendered ahead.
+            damage_manager->damage_buffer_box(damage_manager->get_wlr_damage_box());
+            return;
+        }
+
+        if (damage_manager->commit_frame(*frame))
+        {
+            commit_pending = true;
+            input_latency::note_frame_submitted(output, held_frame_paint_start);
+        }
+    }
+
+    /** @return The first reason why direct scanout is not possible, apart from the scenegraph. */
+    scanout_blocker_t get_scanout_blocker()
+    {
+        if (!env_allow_scanout)
+        {
+            return SCANOUT_BLOCKER_DISABLED;
+        } else if (output_inhibit_counter)
+        {
+            return SCANOUT_BLOCKER_INHIBITED;
+        } else if (!effects->can_scanout())
+        {
+            return SCANOUT_BLOCKER_EFFECT_HOOK;
+        } else if (!postprocessing->can_scanout())
+        {
+            return SCANOUT_BLOCKER_POST_PROCESSING;
+        } else if (damage_manager->pending_gamma_lut)
+        {
+            // A new gamma LUT is applied only with a rendered frame.
+            return SCANOUT_BLOCKER_GAMMA;
+        } else if (output_layers->has_active_layers())
+        {
+            // Direct scanout does not update the output layers, so they would stay visible on top.
+            return SCANOUT_BLOCKER_OUTPUT_LAYERS;
+        } else if (!wlr_output_is_direct_scanout_allowed(output->handle))
+        {
+            return SCANOUT_BLOCKER_BACKEND;
+        }
+
+        return SCANOUT_BLOCKER_NONE;
+    }
+
+    bool can_try_scanout()
+    {
+        return get_scanout_blocker() == SCANOUT_BLOCKER_NONE;
+    }
+
+    scanout_stats_t scanout_stats;
+    // The blocker reported by the render instances during the current attempt
+    scanout_blocker_t reported_blocker = SCANOUT_BLOCKER_NONE;
+    // The plugins which added effect and post hooks, hooks which are not listed belong to core
+    std::map<const void*, std::string> hook_owners;
+
+    void report_scanout_blocker(scanout_blocker_t blocker)
+    {
+        if (reported_blocker == SCANOUT_BLOCKER_NONE)
+        {
+            reported_blocker = blocker;
+        }
+    }
+
+    void note_scanout_result(scanout_blocker_t blocker)
+    {
+        if (blocker == SCANOUT_BLOCKER_NONE)
+        {
+            ++scanout_stats.scanout_frames;
+        } else
+        {
+            ++scanout_stats.blocked_frames[blocker];
+        }
+
+        if (blocker != scanout_stats.last_blocker)
+        {
+            LOGC(SCANOUT, "Output ", output->to_string(), ": scanout blocker changed from ",
+                scanout_stats.last_blocker, " to ", blocker);
+            scanout_stats.last_blocker = blocker;
+        }
+    }
+
+    scanout_stats_t get_scanout_stats()
+    {
+        auto stats    = scanout_stats;
+        auto owner_of = [&] (const void *hook) -> std::string
+        {
+            auto it = hook_owners.find(hook);
+            return (it == hook_owners.end()) ? "core" : it->second;
+        };
+
+        std::set<std::string> effect_owners, post_owners;
+        for (auto type : {OUTPUT_EFFECT_OVERLAY, OUTPUT_EFFECT_POST})
+        {
+            effects->effects[type].for_each([&] (effect_hook_t *hook)
+            {
+                effect_owners.insert(owner_of(hook));
+            });
+        }
+
+        postprocessing->post_effects.for_each([&] (post_hook_t *hook)
+        {
+            post_owners.insert(owner_of(hook));
+        });
+        stats.effect_hook_owners.assign(effect_owners.begin(), effect_owners.end());
+        stats.post_hook_owners.assign(post_owners.begin(), post_owners.end());
+        for (auto& [owner, _] : inhibitors)
+        {
+            stats.inhibit_owners.push_back(owner);
+        }
+
+        return stats;
+    }
+
+    /**
+     * Try to directly scanout a view on the output, thereby skipping rendering
+     * entirely.
+     *
+     * @return True if scanout was successful, False otherwise.
+     */
+    bool do_direct_scanout()
+    {
+        // A pending page flip has to complete before the next commit.
+        auto blocker = commit_pending ? SCANOUT_BLOCKER_COMMIT_PENDING : get_scanout_blocker();
+        if (blocker == SCANOUT_BLOCKER_NONE)
+        {
+            reported_blocker = SCANOUT_BLOCKER_NONE;
+            auto result = scene::try_scanout_from_list(
+                damage_manager->render_instances, output);
+            if (result == scene::direct_scanout::SKIP)
+            {
+                blocker = SCANOUT_BLOCKER_NO_SURFACE;
+            } else if (result == scene::direct_scanout::OCCLUSION)
+            {
+                blocker = (reported_blocker != SCANOUT_BLOCKER_NONE) ?
+                    reported_blocker : SCANOUT_BLOCKER_OCCLUDED;
+            }
+        }
+
+        note_scanout_result(blocker);
+        return blocker == SCANOUT_BLOCKER_NONE;
+    }
+
+    /**
+     * Return the swap damage if called from overlay or postprocessing
+     * effect callbacks or empty region otherwise.
+     */
+    wf::region_t get_swap_damage()
+    {
+        return swap_damage;
+    }
+
+    /**
+     * Render an output. Either calls the built-in renderer, or the render hook
+     * of a plugin
+     */
+    void render_output()
+    {
+        if (runtime_config.damage_debug)
+        {
+            /* Clear the screen to yellow, so that the repainted parts are visible */
+            swap_damage |= damage_manager->get_wlr_damage_box();
+
+            OpenGL::render_begin(output->handle->width, output->handle->height,
+                postprocessing->output_fb);
+            OpenGL::clear({1, 1, 0, 1});
+            OpenGL::render_end();
+        }
+
+        scene::render_pass_params_t params;
+        params.instances = &damage_manager->render_instances;
+        params.damage    = damage_manager->get_ws_damage(
+            output->wset()->get_current_workspace());
+        if (postprocessing->render_region)
+        {
+            params.damage &= *postprocessing->render_region;
+        }
+
+        params.damage += wf::origin(output->get_layout_geometry());
+
+        params.target = postprocessing->get_target_framebuffer().translated(
+            wf::origin(output->get_layout_geometry()));
+        params.background_color = background_color_opt;
+        params.reference_output = this->output;
+
+        scene::render_pass_timings_t timings;
+        params.timings = &timings;
+        params.instruction_buffer = &instruction_buffer;
+        params.arena = &frame_arena;
+        params.offloaded_instances = &output_layers->offloaded;
+
+        this->swap_damage = scene::run_render_pass(params,
+            scene::RPASS_CLEAR_BACKGROUND | scene::RPASS_EMIT_SIGNALS);
+        frame_stats.current[FRAME_PHASE_SCHEDULE] += timings.schedule_instructions;
+        frame_stats.current[FRAME_PHASE_CLEAR]    += timings.clear_background;
+        frame_stats.current[FRAME_PHASE_RENDER]   += timings.render_instructions;
+        swap_damage += -wf::origin(output->get_layout_geometry());
+        postprocessing->source_damage =
+            postprocessing->get_target_framebuffer().framebuffer_region_from_geometry_region(swap_damage);
+        swap_damage = postprocessing->get_output_damage(swap_damage) * output->handle->scale;
+        swap_damage &= damage_manager->get_wlr_damage_box();
+        if (runtime_config.damage_debug)
+        {
+            swap_damage |= damage_manager->get_wlr_damage_box();
+        }
+    }
+
+    void update_bound_output()
+    {
+        int current_fb = wlr_gles2_renderer_get_current_fbo(output->handle->renderer);
+        bind_output(current_fb);
+
+        postprocessing->set_output_framebuffer(current_fb);
+        const auto& default_fb = postprocessing->get_target_framebuffer();
+        depth_buffer_manager->ensure_depth_buffer(
+            default_fb.fb, default_fb.viewport_width, default_fb.viewport_height);
+    }
+
+    /* The time at which the current frame's repaint was supposed to start, in microseconds */
+    int64_t planned_paint_start = 0;
+
+    /**
+     * Repaints the whole output, includes all effects and hooks
+     */
+    void paint()
+    {
+        WF_TRACE_SCOPE("paint");
+        // All outputs are painted on the main thread, so the repaint may start late if another output was
+        // being painted when our repaint timer expired.
+        const int64_t paint_start   = wf::get_current_time_usec();
+        const int64_t paint_latency = std::max(int64_t(0), paint_start - planned_paint_start);
+        // With adaptive sync, the frame is shown as soon as it is ready.
+        frame_presentation = adaptive_sync->is_active() ? paint_start :
+            delay_manager->predict_presentation(paint_start);
+        struct reset_presentation_t
+        {
+            int64_t& value;
+            ~reset_presentation_t()
+            {
+                value = -1;
+            }
+        } reset_presentation{frame_presentation};
+        frame_stats.start_frame();
+        if (wf::startup_profile::enabled)
+        {
+            wf::startup_profile::mark_once("output " + output->to_string() + ": first paint");
+        }
+
+        scene::flush_pending_updates();
+        for (size_t i = 0; i < (size_t)wf::scene::layer::ALL_LAYERS; i++)
+        {
+            output->node_for_layer((wf::scene::layer)i)->invalidate_input_index();
+        }
+
+        /* Part 1: frame setup: query damage, etc. */
+        effects->run_effects(OUTPUT_EFFECT_PRE);
+        effects->run_effects(OUTPUT_EFFECT_DAMAGE);
+        postprocessing->update_color_transforms();
+
+        if (do_direct_scanout())
+        {
+            // Yet another optimization: if we can directly scanout, we should
+            // stop the rest of the repaint cycle.
+            ++frame_stats.scanout_frames;
+            input_latency::note_frame_submitted(output, paint_start);
+            return;
+        }
+
+        int64_t phase_start = wf::get_current_time_usec();
+        const bool effects_draw = effects->effects[OUTPUT_EFFECT_OVERLAY].size() ||
+            postprocessing->uses_default_buffer();
+        auto next_frame = damage_manager->start_frame(effects_draw);
+        if (!next_frame)
+        {
+            // Optimization: the output doesn't need a new frame (so isn't damaged), so we can
+            // just skip the whole repaint
+            delay_manager->skip_frame();
+            ++frame_stats.idle_frames;
+            post_paint();
+            pace_idle_frame();
+            return;
+        }
+
+        output_layers->plan_frame(next_frame->state, *damage_manager, postprocessing->can_scanout());
+        adaptive_sync->plan_frame(next_frame->state);
+        frame_stats.add_time(FRAME_PHASE_DAMAGE, phase_start);
+
+        /* Part 2: call the renderer, which sets swap_damage and draws the scenegraph */
+        wlr_renderer_begin_with_buffer(output->handle->renderer, next_frame->buffer);
+        update_bound_output();
+        const bool measure_gpu = delay_manager->uses_measured_cost();
+        if (measure_gpu)
+        {
+            auto gpu_cost = gpu_timer->collect();
+            last_gpu_cost = (gpu_cost >= 0) ? gpu_cost : last_gpu_cost;
+            gpu_timer->begin();
+        }
+
+        render_output();
+        wlr_renderer_end(wf::get_core().renderer);
+
+        /* Part 3: overlay effects */
+        effects->run_effects(OUTPUT_EFFECT_OVERLAY);
+        if (effects->effects[OUTPUT_EFFECT_OVERLAY].size())
+        {
+            // Overlays may draw outside of the damage.
+            postprocessing->source_damage =
+                wf::geometry_t{0, 0, output->handle->width, output->handle->height};
+        }
+
+        /* Part 4: finalize the scene: postprocessing effects */
+        if (postprocessing->uses_default_buffer())
+        {
+            swap_damage |= damage_manager->get_wlr_damage_box();
+        }
+
+        phase_start = wf::get_current_time_usec();
+        postprocessing->run_post_effects(next_frame->buffer_age);
+        frame_stats.add_time(FRAME_PHASE_POSTPROCESS, phase_start);
+        if (measure_gpu)
+        {
+            OpenGL::render_begin();
+            gpu_timer->end();
+            OpenGL::render_end();
+        }
+
+        if (output_inhibit_counter)
+        {
+            OpenGL::render_begin(output->handle->width, output->handle->height,
+                postprocessing->output_fb);
+            OpenGL::clear({0, 0, 0, 1});
+            OpenGL::render_end();
+        }
+
+        /* Part 5: render sw cursors
+         * We render software cursors after everything else
+         * for consistency with hardware cursor planes */
+        OpenGL::render_begin();
+        wlr_renderer_begin_with_buffer(output->handle->renderer, next_frame->buffer);
+        wlr_output_render_software_cursors(output->handle, swap_damage.to_pixman());
+        wlr_renderer_end(wf::get_core().renderer);
+        OpenGL::invalidate_state();
+        OpenGL::render_end();
+
+        /* Part 6: finalize frame: swap buffers, send frame_done, etc */
+        phase_start = wf::get_current_time_usec();
+        const bool pipelined = can_pipeline();
+        if (pipelined && commit_pending)
+        {
+            // Committed when the previous frame is presented.
+            if (damage_manager->submit_frame(*next_frame))
+            {
+                held_frame = std::move(next_frame);
+                held_frame_paint_start = paint_start;
+            }
+        } else if (damage_manager->swap_buffers(std::move(next_frame), swap_damage))
+        {
+            input_latency::note_frame_submitted(output, paint_start);
+            commit_pending = true;
+            if (pipelined)
+            {
+                // Start filling the pipeline. If nothing changes until then, no frame is rendered.
+                idle_render_ahead.run_once([=] ()
+                {
+                    if (commit_pending && !held_frame)
+                    {
+                        // Not started by the repaint timer, so there is no delay to measure.
+                        planned_paint_start = wf::get_current_time_usec();
+                        paint();
+                    }
+                });
+            }
+        }
+
+        frame_stats.add_time(FRAME_PHASE_SWAP, phase_start);
+        frame_arena.reset();
+        OpenGL::unbind_output(output);
+        swap_damage.clear();
+        post_paint();
+        frame_stats.finish_frame();
+        wf::plugin_stats::end_frame();
+        effect_budget.report_cost(frame_stats.current[FRAME_PHASE_TOTAL] + (measure_gpu ? last_gpu_cost : 0),
+            delay_manager->refresh_nsec);
+        if (measure_gpu)
+        {
+            // GPU results lag behind by a frame or two, so combine the current CPU time with the most
+            // recent GPU time. Adding them up overestimates the cost, since the GPU already starts
+            // working while we are still submitting commands, but errs on the side of not missing frames.
+            // The time we waited for other outputs is part of the cost too, so that the repaint of outputs
+            // which share the main thread with an expensive output is started early enough.
+            // A frame rendered ahead is presented one refresh cycle later, so the GPU may take that long.
+            int64_t gpu_cost = last_gpu_cost;
+            if (held_frame)
+            {
+                gpu_cost = std::max(int64_t(0), gpu_cost - delay_manager->refresh_nsec / 1000);
+            }
+
+            delay_manager->report_render_cost(
+                frame_stats.current[FRAME_PHASE_TOTAL] + gpu_cost + paint_latency);
+        }
+    }
+
+    /* The most recent GPU render time, in microseconds */
+    int64_t last_gpu_cost = 0;
+
+    /**
+     * A repaint which did not render anything does not commit either, so no frame event would pace the next
+     * one, and requesting a frame would start it right away. Plugins which keep requesting frames, or hold
+     * redraw_always, would then spin the CPU without showing anything. Instead, the next repaint starts one
+     * refresh period later.
+     */
+    wf::wl_timer<false> idle_frame_timer;
+    void pace_idle_frame()
+    {
+        if (commit_pending)
+        {
+            return;
+        }
+
+        const int64_t refresh_msec = delay_manager->refresh_nsec / 1'000'000;
+        output->handle->frame_pending = true;
+        idle_frame_timer.set_timeout(refresh_msec > 0 ? refresh_msec : 16, [=] ()
+        {
+            output->handle->frame_pending = false;
+            if (damage_manager->force_next_frame)
+            {
+                wlr_output_send_frame(output->handle);
+            }
+        });
+    }
+
+    /**
+     * Execute post-paint actions.
+     */
+    void post_paint()
+    {
+        effects->run_effects(OUTPUT_EFFECT_POST);
+        if (damage_manager->constant_redraw_counter)
+        {
+            damage_manager->schedule_repaint();
+        }
+    }
+};
+
+namespace
+{
+/** The arena of the outermost render pass which is currently running */
+scene::render_pass_arena_t *current_arena = nullptr;
+
+struct node_stats_entry_t
+{
+    // Used to check that the node at the address is still the one the statistics were recorded for
+    scene::node_weak_ptr node;
+    scene::node_render_stats_t stats;
+};
+
+std::unordered_map<const scene::node_t*, node_stats_entry_t> node_stats;
+scene::node_render_stats_t unattributed_stats;
+size_t node_stats_prune_size = 1024;
+
+uint64_t region_area(const wf::region_t& region)
+{
+    uint64_t area = 0;
+    for (const auto& box : region)
+    {
+        area += uint64_t(box.x2 - box.x1) * uint64_t(box.y2 - box.y1);
+    }
+
+    return area;
+}
+
+scene::node_render_stats_t& get_node_stats_entry(scene::node_t *node)
+{
+    if (!node)
+    {
+        return unattributed_stats;
+    }
+
+    if (node_stats.size() >= node_stats_prune_size)
+    {
+        for (auto it = node_stats.begin(); it != node_stats.end();)
+        {
+            it = it->second.node.expired() ? node_stats.erase(it) : std::next(it);
+        }
+
+        node_stats_prune_size = std::max<size_t>(1024, 2 * node_stats.size());
+    }
+
+    auto& entry = node_stats[node];
+    if (entry.node.lock().get() != node)
+    {
+        entry.node  = node->weak_from_this();
+        entry.stats = {};
+    }
+
+    return entry.stats;
+}
+}
+
+const scene::node_render_stats_t*scene::get_node_render_stats(node_t *node)
+{
+    if (!node)
+    {
+        return &unattributed_stats;
+    }
+
+    auto it = node_stats.find(node);
+    if ((it == node_stats.end()) || (it->second.node.lock().get() != node))
+    {
+        return nullptr;
+    }
+
+    return &it->second.stats;
+}
+
+void scene::reset_node_render_stats()
+{
+    node_stats.clear();
+    unattributed_stats = {};
+}
+
+void scene::detail::note_node_damage(node_t *node, const wf::region_t& damage)
+{
+    auto& stats = get_node_stats_entry(node);
+    stats.damage_events++;
+    stats.damage_pixels += region_area(damage);
+}
+
+wf::region_t scene::render_pass_arena_t::take_region()
+{
+    in_use++;
+    peak_in_use = std::max(peak_in_use, in_use);
+    if (regions.empty())
+    {
+        return {};
+    }
+
+    auto region = std::move(regions.back());
+    regions.pop_back();
+    return region;
+}
+
+void scene::render_pass_arena_t::return_region(wf::region_t&& region)
+{
+    in_use = (in_use > 0) ? in_use - 1 : 0;
+    regions.push_back(std::move(region));
+}
+
+void scene::render_pass_arena_t::reset()
+{
+    if (regions.size() > peak_in_use)
+    {
+        regions.erase(regions.begin() + peak_in_use, regions.end());
     }
 
-    /* Actual rendering functions */
+    // Regions which were dropped instead of returned (e.g. empty damage) are not in use anymore either.
+    in_use = 0;
+    peak_in_use = 0;
+}
 
-    /**
-     * Bind the output's EGL surface, allocate buffers
-     */
-    void bind_output(uint32_t fb)
+wf::region_t scene::clip_instruction_damage(const wf::region_t& damage, const wf::geometry_t& box)
+{
+    if (!current_arena)
     {
-        OpenGL::bind_output(output, fb);
-
-        /* Make sure the default buffer has enough size */
-        postprocessing->allocate(output->handle->width, output->handle->height);
+        return damage & box;
     }
 
-    /**
-     * Try to directly scanout a view on the output, thereby skipping rendering
-     * entirely.
-     *
-     * @return True if scanout was successful, False otherwise.
-     */
-    bool do_direct_scanout()
-    {
-        const bool can_scanout = !output_inhibit_counter && effects->can_scanout() &&
-            postprocessing->can_scanout() && wlr_output_is_direct_scanout_allowed(output->handle);
+    // pixman reuses the storage of the destination region if it is big enough
+    auto result = current_arena->take_region();
+    pixman_region32_intersect_rect(result.to_pixman(), const_cast<wf::region_t&>(damage).to_pixman(),
+        box.x, box.y, box.width, box.height);
+    return result;
+}
+
+namespace
+{
+/** The state of a render pass between scheduling its instructions and executing them. */
+struct scheduled_render_pass_t
+{
+    const scene::render_pass_params_t *params;
+    uint32_t flags;
+
+    // The damage which is left for the instances below is only needed during the pass, so its storage can
+    // come from the arena as well.
+    wf::region_t accumulated_damage;
+    wf::region_t swap_damage;
+    std::vector<scene::render_instruction_t> local_instructions;
+    std::vector<scene::render_instruction_t> *instructions;
+    int64_t step_start = 0;
 
-        if (!can_scanout || !env_allow_scanout)
+    scheduled_render_pass_t(const scene::render_pass_params_t& pass_params, uint32_t pass_flags) :
+        params(&pass_params), flags(pass_flags)
+    {
+        if (current_arena)
         {
-            return false;
+            accumulated_damage = current_arena->take_region();
         }
 
-        auto result = scene::try_scanout_from_list(
-            damage_manager->render_instances, output);
-        return result == scene::direct_scanout::SUCCESS;
+        accumulated_damage = pass_params.damage;
+        instructions = pass_params.instruction_buffer ? pass_params.instruction_buffer : &local_instructions;
     }
 
-    /**
-     * Return the swap damage if called from overlay or postprocessing
-     * effect callbacks or empty region otherwise.
-     */
-    wf::region_t get_swap_damage()
+    // Not movable, @instructions may point to the local instructions.
+    scheduled_render_pass_t(const scheduled_render_pass_t&) = delete;
+    scheduled_render_pass_t& operator =(const scheduled_render_pass_t&) = delete;
+
+    /** Add the time since the last step to @step, if the timings were requested. */
+    void finish_step(int64_t scene::render_pass_timings_t::*step)
     {
-        return swap_damage;
+        if (params->timings)
+        {
+            int64_t now = wf::get_current_time_usec();
+            params->timings->*step += now - step_start;
+            step_start = now;
+        }
     }
 
-    /**
-     * Render an output. Either calls the built-in renderer, or the render hook
-     * of a plugin
-     */
-    void render_output()
+    /** Emit render-pass-begin and gather the instructions. */
+    void schedule()
     {
-        if (runtime_config.damage_debug)
+        if ((flags & scene::RPASS_EMIT_SIGNALS) &&
+            wf::get_core().has_connections<scene::render_pass_begin_signal>())
         {
-            /* Clear the screen to yellow, so that the repainted parts are visible */
-            swap_damage |= damage_manager->get_wlr_damage_box();
-
-            OpenGL::render_begin(output->handle->width, output->handle->height,
-                postprocessing->output_fb);
-            OpenGL::clear({1, 1, 0, 1});
-            OpenGL::render_end();
+            scene::render_pass_begin_signal ev{accumulated_damage, params->target};
+            wf::get_core().emit(&ev);
         }
 
-        scene::render_pass_params_t params;
-        params.instances = &damage_manager->render_instances;
-        params.damage    = damage_manager->get_ws_damage(
-            output->wset()->get_current_workspace());
-        params.damage += wf::origin(output->get_layout_geometry());
-
-        params.target = postprocessing->get_target_framebuffer().translated(
-            wf::origin(output->get_layout_geometry()));
-        params.background_color = background_color_opt;
-        params.reference_output = this->output;
+        swap_damage = accumulated_damage;
+        step_start  = params->timings ? wf::get_current_time_usec() : 0;
 
-        this->swap_damage = scene::run_render_pass(params,
-            scene::RPASS_CLEAR_BACKGROUND | scene::RPASS_EMIT_SIGNALS);
-        swap_damage += -wf::origin(output->get_layout_geometry());
-        swap_damage  = swap_damage * output->handle->scale;
-        swap_damage &= damage_manager->get_wlr_damage_box();
-        if (runtime_config.damage_debug)
+        instructions->clear();
+        for (auto& inst : *params->instances)
         {
-            swap_damage |= damage_manager->get_wlr_damage_box();
+            inst->schedule_instructions(*instructions, params->target, accumulated_damage);
         }
-    }
 
-    void update_bound_output()
-    {
-        int current_fb = wlr_gles2_renderer_get_current_fbo(output->handle->renderer);
-        bind_output(current_fb);
-
-        postprocessing->set_output_framebuffer(current_fb);
-        const auto& default_fb = postprocessing->get_target_framebuffer();
-        depth_buffer_manager->ensure_depth_buffer(
-            default_fb.fb, default_fb.viewport_width, default_fb.viewport_height);
+        finish_step(&scene::render_pass_timings_t::schedule_instructions);
     }
 
-    /**
-     * Repaints the whole output, includes all effects and hooks
-     */
-    void paint()
+    /** Clear the background, execute the instructions and emit render-pass-end. */
+    void execute()
     {
-        /* Part 1: frame setup: query damage, etc. */
-        effects->run_effects(OUTPUT_EFFECT_PRE);
-        effects->run_effects(OUTPUT_EFFECT_DAMAGE);
+        step_start = params->timings ? wf::get_current_time_usec() : 0;
 
-        if (do_direct_scanout())
+        // Clear visible background areas
+        if (flags & scene::RPASS_CLEAR_BACKGROUND)
         {
-            // Yet another optimization: if we can directly scanout, we should
-            // stop the rest of the repaint cycle.
-            return;
-        }
+            OpenGL::render_begin(params->target);
+            for (const auto& rect : accumulated_damage)
+            {
+                params->target.logic_scissor(wlr_box_from_pixman_box(rect));
+                OpenGL::clear(params->background_color, GL_COLOR_BUFFER_BIT);
+            }
 
-        auto next_frame = damage_manager->start_frame();
-        if (!next_frame)
-        {
-            // Optimization: the output doesn't need a new frame (so isn't damaged), so we can
-            // just skip the whole repaint
-            delay_manager->skip_frame();
-            return;
+            OpenGL::render_end();
         }
 
-        /* Part 2: call the renderer, which sets swap_damage and draws the scenegraph */
-        wlr_renderer_begin_with_buffer(output->handle->renderer, next_frame->buffer);
-        update_bound_output();
-        render_output();
-        wlr_renderer_end(wf::get_core().renderer);
+        finish_step(&scene::render_pass_timings_t::clear_background);
 
-        /* Part 3: overlay effects */
-        effects->run_effects(OUTPUT_EFFECT_OVERLAY);
+        // Render instances
+        auto is_offloaded = [&] (scene::render_instance_t *instance)
+        {
+            return params->offloaded_instances &&
+                   (std::find(params->offloaded_instances->begin(), params->offloaded_instances->end(),
+                       instance) != params->offloaded_instances->end());
+        };
 
-        /* Part 4: finalize the scene: postprocessing effects */
-        if (postprocessing->post_effects.size())
+        for (auto& instr : wf::reverse(*instructions))
         {
-            swap_damage |= damage_manager->get_wlr_damage_box();
+            if (is_offloaded(instr.instance))
+            {
+                continue;
+            }
+
+            const int64_t render_start = wf::plugin_stats::enabled ? wf::get_current_time_usec() : 0;
+            {
+                wf::plugin_stats::scope_t cost{typeid(*instr.instance), wf::plugin_stats::COST_RENDER};
+                if (instr.transform)
+                {
+                    instr.instance->render_transformed(instr.target, instr.damage, *instr.transform,
+                        instr.alpha);
+                } else if (instr.alpha != 1.0f)
+                {
+                    instr.instance->render_with_alpha(instr.target, instr.damage, instr.alpha);
+                } else
+                {
+                    instr.instance->render(instr.target, instr.damage, instr.data);
+                }
+            }
+
+            if (render_start)
+            {
+                auto& stats = get_node_stats_entry(instr.instance->get_node());
+                stats.instructions++;
+                stats.pixels += region_area(instr.damage);
+                stats.render_usec += wf::get_current_time_usec() - render_start;
+            }
+
+            if (params->reference_output)
+            {
+                instr.instance->presentation_feedback(params->reference_output);
+            }
         }
 
-        postprocessing->run_post_effects();
-        if (output_inhibit_counter)
+        finish_step(&scene::render_pass_timings_t::render_instructions);
+
+        // Drop references to the damage and custom data, but keep the capacity for the next pass.
+        if (current_arena)
         {
-            OpenGL::render_begin(output->handle->width, output->handle->height,
-                postprocessing->output_fb);
-            OpenGL::clear({0, 0, 0, 1});
-            OpenGL::render_end();
-        }
+            for (auto& instr : *instructions)
+            {
+                current_arena->return_region(std::move(instr.damage));
+            }
 
-        /* Part 5: render sw cursors
-         * We render software cursors after everything else
-         * for consistency with hardware cursor planes */
-        OpenGL::render_begin();
-        wlr_renderer_begin_with_buffer(output->handle->renderer, next_frame->buffer);
-        wlr_output_render_software_cursors(output->handle, swap_damage.to_pixman());
-        wlr_renderer_end(wf::get_core().renderer);
-        OpenGL::render_end();
+            current_arena->return_region(std::move(accumulated_damage));
+        }
 
-        /* Part 6: finalize frame: swap buffers, send frame_done, etc */
-        damage_manager->swap_buffers(std::move(next_frame), swap_damage);
-        OpenGL::unbind_output(output);
-        swap_damage.clear();
-        post_paint();
-    }
+        instructions->clear();
 
-    /**
-     * Execute post-paint actions.
-     */
-    void post_paint()
-    {
-        effects->run_effects(OUTPUT_EFFECT_POST);
-        if (damage_manager->constant_redraw_counter)
+        if ((flags & scene::RPASS_EMIT_SIGNALS) &&
+            wf::get_core().has_connections<scene::render_pass_end_signal>())
         {
-            damage_manager->schedule_repaint();
+            scene::render_pass_end_signal end_ev;
+            end_ev.target = params->target;
+            wf::get_core().emit(&end_ev);
         }
     }
 };
+}
 
 wf::region_t scene::run_render_pass(
     const render_pass_params_t& params, uint32_t flags)
 {
-    auto accumulated_damage = params.damage;
-
-    if (flags & RPASS_EMIT_SIGNALS)
+    WF_TRACE_SCOPE("run_render_pass");
+    auto prev_arena = current_arena;
+    if (params.arena && !current_arena)
     {
-        // Emit render_pass_begin
-        scene::render_pass_begin_signal ev{accumulated_damage, params.target};
-        wf::get_core().emit(&ev);
+        current_arena = params.arena;
     }
 
-    wf::region_t swap_damage = accumulated_damage;
+    scheduled_render_pass_t pass{params, flags};
+    pass.schedule();
+    pass.execute();
 
-    // Gather instructions
-    std::vector<wf::scene::render_instruction_t> instructions;
-    for (auto& inst : *params.instances)
-    {
-        inst->schedule_instructions(instructions,
-            params.target, accumulated_damage);
-    }
+    current_arena = prev_arena;
+    return std::move(pass.swap_damage);
+}
 
-    // Clear visible background areas
-    if (flags & RPASS_CLEAR_BACKGROUND)
+std::vector<wf::region_t> scene::run_render_passes(
+    const std::vector<render_pass_params_t>& passes, uint32_t flags)
+{
+    WF_TRACE_SCOPE("run_render_passes");
+    auto prev_arena = current_arena;
+    for (auto& params : passes)
     {
-        OpenGL::render_begin(params.target);
-        for (const auto& rect : accumulated_damage)
+        if (params.arena && !current_arena)
         {
-            params.target.logic_scissor(wlr_box_from_pixman_box(rect));
-            OpenGL::clear(params.background_color, GL_COLOR_BUFFER_BIT);
+            current_arena = params.arena;
         }
-
-        OpenGL::render_end();
     }
 
-    // Render instances
-    for (auto& instr : wf::reverse(instructions))
+    std::deque<scheduled_render_pass_t> scheduled;
+    for (auto& params : passes)
     {
-        instr.instance->render(instr.target, instr.damage, instr.data);
-        if (params.reference_output)
-        {
-            instr.instance->presentation_feedback(params.reference_output);
-        }
+        scheduled.emplace_back(params, flags);
+        scheduled.back().schedule();
     }
 
-    if (flags & RPASS_EMIT_SIGNALS)
+    std::vector<wf::region_t> swap_damage;
+    swap_damage.reserve(passes.size());
+    for (auto& pass : scheduled)
     {
-        render_pass_end_signal end_ev;
-        end_ev.target = params.target;
-        wf::get_core().emit(&end_ev);
+        pass.execute();
+        swap_damage.push_back(std::move(pass.swap_damage));
     }
 
+    current_arena = prev_arena;
     return swap_damage;
 }
 
@@ -1246,6 +3161,15 @@ scene::direct_scanout scene::try_scanout_from_list(
 {
     for (auto& ch : instances)
     {
+        if (auto node = ch->get_node())
+        {
+            auto bbox = node->get_bounding_box();
+            if (!node->is_enabled() || (bbox.width <= 0) || (bbox.height <= 0))
+            {
+                continue;
+            }
+        }
+
         auto res = ch->try_scanout(scanout);
         if (res != direct_scanout::SKIP)
         {
@@ -1256,6 +3180,28 @@ scene::direct_scanout scene::try_scanout_from_list(
     return direct_scanout::SKIP;
 }
 
+scene::direct_scanout scene::try_output_layers_from_list(
+    const std::vector<scene::render_instance_uptr>& instances,
+    wf::output_t *output, scene::output_layers_plan_t& plan)
+{
+    auto result = direct_scanout::SKIP;
+    for (auto& ch : instances)
+    {
+        auto res = ch->try_output_layers(output, plan);
+        if (res == direct_scanout::OCCLUSION)
+        {
+            return res;
+        }
+
+        if (res == direct_scanout::SUCCESS)
+        {
+            result = res;
+        }
+    }
+
+    return result;
+}
+
 void scene::compute_visibility_from_list(const std::vector<render_instance_uptr>& instances,
     wf::output_t *output, wf::region_t& region, const wf::point_t& offset)
 {
@@ -1271,10 +3217,14 @@ void scene::compute_visibility_from_list(const std::vector<render_instance_uptr>
 render_manager::render_manager(output_t *o) :
     pimpl(new impl(o))
 {}
-render_manager::~render_manager() = default;
+render_manager::~render_manager()
+{
+    input_latency::forget_output(pimpl->output);
+}
 
 void render_manager::set_redraw_always(bool always)
 {
+    pimpl->damage_manager->repaint_sources.note_redraw_always(__builtin_return_address(0), always);
     pimpl->damage_manager->set_redraw_always(always);
 }
 
@@ -1285,34 +3235,85 @@ wf::region_t render_manager::get_swap_damage()
 
 void render_manager::schedule_redraw()
 {
+    pimpl->damage_manager->repaint_sources.note_request(__builtin_return_address(0));
     pimpl->damage_manager->schedule_repaint();
 }
 
 void render_manager::add_inhibit(bool add)
 {
-    pimpl->add_inhibit(add);
+    pimpl->add_inhibit(add, wf::plugin_stats::get_owner_name(__builtin_return_address(0)));
+}
+
+void render_manager::set_blanked(bool blanked)
+{
+    pimpl->blanked = blanked;
+    pimpl->update_content_shown();
+}
+
+bool render_manager::is_content_shown() const
+{
+    return pimpl->damage_manager->content_shown;
 }
 
 void render_manager::add_effect(effect_hook_t *hook, output_effect_type_t type)
 {
+    pimpl->hook_owners[hook] = wf::plugin_stats::get_owner_name(__builtin_return_address(0));
     pimpl->effects->add_effect(hook, type);
 }
 
 void render_manager::rem_effect(effect_hook_t *hook)
 {
+    pimpl->hook_owners.erase(hook);
     pimpl->effects->rem_effect(hook);
 }
 
 void render_manager::add_post(post_hook_t *hook)
 {
+    pimpl->hook_owners[hook] = wf::plugin_stats::get_owner_name(__builtin_return_address(0));
     pimpl->postprocessing->add_post(hook);
 }
 
+void render_manager::add_post(post_hook_t *hook, post_hook_damage_t damage)
+{
+    pimpl->hook_owners[hook] = wf::plugin_stats::get_owner_name(__builtin_return_address(0));
+    pimpl->postprocessing->add_post(hook, std::move(damage));
+}
+
 void render_manager::rem_post(post_hook_t *hook)
 {
+    pimpl->hook_owners.erase(hook);
     pimpl->postprocessing->rem_post(hook);
 }
 
+void render_manager::add_color_transform(color_transform_t *transform)
+{
+    pimpl->postprocessing->add_color_transform(transform);
+}
+
+void render_manager::rem_color_transform(color_transform_t *transform)
+{
+    pimpl->postprocessing->rem_color_transform(transform);
+}
+
+void render_manager::set_render_region(std::optional<wf::geometry_t> region)
+{
+    if (region && ((region->width <= 0) || (region->height <= 0)))
+    {
+        region.reset();
+    }
+
+    if (region != pimpl->postprocessing->render_region)
+    {
+        pimpl->postprocessing->render_region = region;
+        damage_whole();
+    }
+}
+
+wf::region_t render_manager::get_post_hook_damage()
+{
+    return pimpl->postprocessing->current_damage;
+}
+
 wf::region_t render_manager::get_scheduled_damage()
 {
     return pimpl->damage_manager->get_scheduled_damage();
@@ -1320,24 +3321,54 @@ wf::region_t render_manager::get_scheduled_damage()
 
 void render_manager::damage_whole()
 {
+    pimpl->damage_manager->repaint_sources.note_request(__builtin_return_address(0));
     pimpl->damage_manager->damage_whole();
 }
 
 void render_manager::damage_whole_idle()
 {
+    pimpl->damage_manager->repaint_sources.note_request(__builtin_return_address(0));
     pimpl->damage_manager->damage_whole_idle();
 }
 
 void render_manager::damage(const wlr_box& box, bool repaint)
 {
+    pimpl->damage_manager->repaint_sources.note_request(__builtin_return_address(0));
     pimpl->damage_manager->damage(box, repaint);
 }
 
 void render_manager::damage(const wf::region_t& region, bool repaint)
 {
+    pimpl->damage_manager->repaint_sources.note_request(__builtin_return_address(0));
     pimpl->damage_manager->damage(region, repaint);
 }
 
+int64_t render_manager::get_predicted_presentation_time() const
+{
+    if (pimpl->frame_presentation >= 0)
+    {
+        return pimpl->frame_presentation;
+    }
+
+    const int64_t now = wf::get_current_time_usec();
+    if (pimpl->adaptive_sync->is_active())
+    {
+        return now;
+    }
+
+    return pimpl->delay_manager->predict_presentation(now);
+}
+
+double render_manager::get_effect_quality(const std::string& effect) const
+{
+    return pimpl->effect_budget.get_quality(effect);
+}
+
+uint64_t render_manager::get_damage_generation() const
+{
+    return pimpl->damage_manager->damage_generation;
+}
+
 wlr_box render_manager::get_ws_box(wf::point_t ws) const
 {
     return pimpl->damage_manager->get_ws_box(ws);
@@ -1352,6 +3383,52 @@ void render_manager::set_require_depth_buffer(bool require)
 {
     return pimpl->depth_buffer_manager->set_required(require);
 }
+
+frame_stats_t render_manager::get_frame_stats()
+{
+    return pimpl->frame_stats.get_stats();
+}
+
+std::vector<repaint_source_t> render_manager::get_repaint_sources()
+{
+    return pimpl->damage_manager->repaint_sources.get_sources();
+}
+
+void render_manager::set_tearing_allowed(bool allowed)
+{
+    pimpl->tearing_allowed = allowed;
+}
+
+bool render_manager::is_tearing_allowed()
+{
+    return pimpl->tearing_allowed;
+}
+
+void render_manager::plan_scanout_state(wlr_output_state& state)
+{
+    pimpl->adaptive_sync->plan_frame(state);
+}
+
+scanout_stats_t render_manager::get_scanout_stats()
+{
+    return pimpl->get_scanout_stats();
+}
+
+void render_manager::report_scanout_blocker(scanout_blocker_t blocker)
+{
+    pimpl->report_scanout_blocker(blocker);
+}
+
+input_latency_stats_t render_manager::get_input_latency_stats()
+{
+    auto samples = input_latency::get_samples(pimpl->output);
+    auto compute  = &frame_stats_manager_t::compute_phase_stats;
+    input_latency_stats_t stats;
+    stats.input_to_commit   = compute(std::move(samples.input_to_commit));
+    stats.commit_to_present = compute(std::move(samples.commit_to_present));
+    stats.input_to_present  = compute(std::move(samples.input_to_present));
+    return stats;
+}
 } // namespace wf
 
 /* End render_manager */
@@ -7,7 +7,10 @@
 #include <wayfire/render-manager.hpp>
 #include <wayfire/signal-definitions.hpp>
 #include <wayfire/opengl.hpp>
+#include <list>
+#include <optional>
 #include <set>
+#include <unordered_map>
 #include <algorithm>
 #include <wayfire/nonstd/reverse.hpp>
 #include <wayfire/util/log.hpp>
@@ -15,6 +18,8 @@
 #include <wayfire/seat.hpp>
 
 #include <wayfire/scene-operations.hpp>
+#include <wayfire/txn/transaction-manager.hpp>
+#include <wayfire/unstable/translation-node.hpp>
 
 #include "../view/view-impl.hpp"
 #include "wayfire/debug.hpp"
@@ -110,30 +115,6 @@ struct grid_size_manager_t
     }
 };
 
-static wf::scene::node_t *find_lca(wf::scene::node_t *a, wf::scene::node_t *b)
-{
-    wf::scene::node_t *iter = a;
-    std::set<wf::scene::node_t*> a_ancestors;
-    while (iter)
-    {
-        a_ancestors.insert(iter);
-        iter = iter->parent();
-    }
-
-    iter = b;
-    while (iter)
-    {
-        if (a_ancestors.count(iter))
-        {
-            return iter;
-        }
-
-        iter = iter->parent();
-    }
-
-    return nullptr;
-}
-
 static bool is_attached_to(wf::scene::node_t *a, wf::scene::node_t *root)
 {
     while (a)
@@ -149,29 +130,50 @@ static bool is_attached_to(wf::scene::node_t *a, wf::scene::node_t *root)
     return false;
 }
 
-static bool is_attached_to_scenegraph(wf::scene::node_t *a)
-{
-    return is_attached_to(a, wf::get_core().scene().get());
-}
-
-static size_t find_index_in_parent(wf::scene::node_t *x, wf::scene::node_t *parent)
+/**
+ * Get the position of a node in the scenegraph as the indices of its ancestors in their parents, starting
+ * from the root. Comparing the paths of two nodes lexicographically gives their stacking order.
+ *
+ * @return The path, or nothing if the node is not attached to the scenegraph.
+ */
+static std::optional<std::vector<size_t>> find_path_from_root(wf::scene::node_t *x)
 {
-    while (x->parent() != parent)
+    std::vector<size_t> path;
+    while (x->parent())
     {
+        auto& children = x->parent()->get_children();
+        auto it = std::find_if(children.begin(), children.end(),
+            [&] (auto child) { return child.get() == x; });
+        path.push_back(it - children.begin());
         x = x->parent();
     }
 
-    auto& children = parent->get_children();
-    auto it = std::find_if(children.begin(), children.end(), [&] (auto child) { return child.get() == x; });
-    return it - children.begin();
+    if (x != wf::get_core().scene().get())
+    {
+        return {};
+    }
+
+    std::reverse(path.begin(), path.end());
+    return path;
 }
 
-class workspace_set_root_node_t : public wf::scene::floating_inner_node_t
+/**
+ * The workspace set root never has an offset, but it is a translation node so that its render instance keeps
+ * the views' instances in a nested list. This way, mapping or unmapping a view regenerates only that view's
+ * render instances.
+ *
+ * With workarounds/keep_hidden_wset_instances, the render instance of a hidden workspace set is not
+ * destroyed but parked in its root node, for the most recently hidden workspace sets. Showing the workspace
+ * set again on the same output reuses the parked instance instead of generating new instances for all of
+ * its views. Parked instances stay connected to the nodes below them, so they are kept up to date, but
+ * their damage is dropped.
+ */
+class workspace_set_root_node_t : public wf::scene::translation_node_t
 {
     uint64_t index;
 
   public:
-    workspace_set_root_node_t(uint64_t index) : floating_inner_node_t(true)
+    workspace_set_root_node_t(uint64_t index) : translation_node_t(true)
     {
         this->index = index;
     }
@@ -180,8 +182,143 @@ class workspace_set_root_node_t : public wf::scene::floating_inner_node_t
     {
         return "workspace-set id=" + std::to_string(index) + " " + stringify_flags();
     }
+
+    void gen_render_instances(std::vector<wf::scene::render_instance_uptr>& instances,
+        wf::scene::damage_callback damage, wf::output_t *output) override;
+
+    /**
+     * Destroy the parked render instance, if there is one. The instance keeps the node alive, so this has to
+     * be called when the workspace set is detached from its output.
+     */
+    void drop_parked_instance()
+    {
+        if (parked)
+        {
+            parked.reset();
+            parked_lru.remove(this);
+        }
+    }
+
+    struct parked_instance_t
+    {
+        std::unique_ptr<wf::scene::translation_node_instance_t> instance;
+        // The damage callback of the instance, reset while it is parked
+        std::shared_ptr<wf::scene::damage_callback> sink;
+        wf::output_t *shown_on = nullptr;
+    };
+
+    void park(parked_instance_t instance)
+    {
+        static wf::option_wrapper_t<int> keep_hidden{"workarounds/keep_hidden_wset_instances"};
+        drop_parked_instance();
+        if (keep_hidden <= 0)
+        {
+            return;
+        }
+
+        LOGC(WSET, "Parking the render instance of workspace set id=", index);
+        parked = std::move(instance);
+        parked_lru.push_front(this);
+        while ((int)parked_lru.size() > keep_hidden)
+        {
+            parked_lru.back()->drop_parked_instance();
+        }
+    }
+
+  private:
+    std::optional<parked_instance_t> parked;
+    // All nodes with a parked instance, the most recently parked first
+    static inline std::list<workspace_set_root_node_t*> parked_lru;
+};
+
+/**
+ * The render instance of a workspace set root node when instances of hidden workspace sets are kept: a thin
+ * wrapper around the actual instance, which parks it when the workspace set is hidden.
+ */
+class workspace_set_root_instance_t : public wf::scene::render_instance_t
+{
+    std::shared_ptr<workspace_set_root_node_t> self;
+    workspace_set_root_node_t::parked_instance_t inner;
+
+  public:
+    workspace_set_root_instance_t(workspace_set_root_node_t *self,
+        workspace_set_root_node_t::parked_instance_t inner, wf::scene::damage_callback push_damage)
+    {
+        this->self  = std::dynamic_pointer_cast<workspace_set_root_node_t>(self->shared_from_this());
+        this->inner = std::move(inner);
+        *this->inner.sink = push_damage;
+    }
+
+    ~workspace_set_root_instance_t()
+    {
+        *inner.sink = nullptr;
+        if (!self->is_enabled())
+        {
+            self->park(std::move(inner));
+        }
+    }
+
+    void schedule_instructions(std::vector<wf::scene::render_instruction_t>& instructions,
+        const wf::render_target_t& target, wf::region_t& damage) override
+    {
+        inner.instance->schedule_instructions(instructions, target, damage);
+    }
+
+    void presentation_feedback(wf::output_t *output) override
+    {
+        inner.instance->presentation_feedback(output);
+    }
+
+    wf::scene::direct_scanout try_scanout(wf::output_t *output) override
+    {
+        return inner.instance->try_scanout(output);
+    }
+
+    wf::scene::direct_scanout try_output_layers(wf::output_t *output,
+        wf::scene::output_layers_plan_t& plan) override
+    {
+        return inner.instance->try_output_layers(output, plan);
+    }
+
+    void compute_visibility(wf::output_t *output, wf::region_t& visible) override
+    {
+        inner.instance->compute_visibility(output, visible);
+    }
 };
 
+void workspace_set_root_node_t::gen_render_instances(std::vector<wf::scene::render_instance_uptr>& instances,
+    wf::scene::damage_callback damage, wf::output_t *output)
+{
+    static wf::option_wrapper_t<int> keep_hidden{"workarounds/keep_hidden_wset_instances"};
+    if (keep_hidden <= 0)
+    {
+        translation_node_t::gen_render_instances(instances, damage, output);
+        return;
+    }
+
+    if (parked && (parked->shown_on == output))
+    {
+        auto instance = std::move(*parked);
+        drop_parked_instance();
+        instances.push_back(std::make_unique<workspace_set_root_instance_t>(this,
+            std::move(instance), damage));
+        return;
+    }
+
+    parked_instance_t instance;
+    instance.sink     = std::make_shared<wf::scene::damage_callback>();
+    instance.shown_on = output;
+    instance.instance = std::make_unique<wf::scene::translation_node_instance_t>(this,
+        [sink = instance.sink] (const wf::region_t& region)
+    {
+        if (*sink)
+        {
+            (*sink)(region);
+        }
+    }, output);
+    instances.push_back(std::make_unique<workspace_set_root_instance_t>(this, std::move(instance), damage));
+}
+
 std::vector<nonstd::observer_ptr<workspace_set_t>> workspace_set_t::get_all()
 {
     return tracking_allocator_t<workspace_set_t>::get().get_all();
@@ -212,6 +349,7 @@ struct workspace_set_t::impl
 
     void change_output_geometry(wf::geometry_t new_geometry)
     {
+        invalidate_buckets();
         if (!workspace_geometry)
         {
             workspace_geometry = new_geometry;
@@ -225,6 +363,8 @@ struct workspace_set_t::impl
             return;
         }
 
+        // Resize all views in a single transaction
+        wf::txn::transaction_group_t group{*wf::get_core().tx_manager};
         for (auto& view : get_views(WSET_MAPPED_ONLY))
         {
             auto wm  = view->get_geometry();
@@ -253,6 +393,7 @@ struct workspace_set_t::impl
     wf::signal::connection_t<workspace_grid_changed_signal> on_grid_changed =
         [=] (workspace_grid_changed_signal *ev)
     {
+        invalidate_buckets();
         if (!workspace_geometry)
         {
             return;
@@ -283,6 +424,17 @@ struct workspace_set_t::impl
         remove_view(toplevel_cast(ev->object));
     };
 
+    wf::signal::connection_t<view_geometry_changed_signal> on_view_geometry_changed =
+        [=] (view_geometry_changed_signal *ev)
+    {
+        invalidate_buckets(ev->view);
+    };
+
+    wf::signal::connection_t<view_set_sticky_signal> on_view_set_sticky = [=] (view_set_sticky_signal *ev)
+    {
+        invalidate_buckets(ev->view);
+    };
+
     bool visible = false;
 
   public:
@@ -335,6 +487,8 @@ struct workspace_set_t::impl
         {
             output->disconnect(&output_geometry_changed);
             wf::scene::remove_child(wnode);
+            // A parked render instance is only valid for the output it was generated for.
+            std::dynamic_pointer_cast<workspace_set_root_node_t>(wnode)->drop_parked_instance();
         }
 
         workspace_set_attached_signal data;
@@ -391,7 +545,12 @@ struct workspace_set_t::impl
 
         LOGC(WSET, "Adding view ", view, " to wset ", index);
         wset_views.push_back(view);
+        stacking_order_generation.reset();
+        bucket_entries[view.get()].sequence = next_sequence++;
+        invalidate_buckets(view);
         view->connect(&on_view_destruct);
+        view->connect(&on_view_geometry_changed);
+        view->connect(&on_view_set_sticky);
         view->priv->current_wset = self->weak_from_this();
         view->set_output(this->output);
     }
@@ -407,7 +566,12 @@ struct workspace_set_t::impl
 
         LOGC(WSET, "Removing view ", view, " from id=", index);
         wset_views.erase(it);
+        stacking_order_generation.reset();
+        remove_from_buckets(view);
+        bucket_entries.erase(view.get());
         view->disconnect(&on_view_destruct);
+        view->disconnect(&on_view_geometry_changed);
+        view->disconnect(&on_view_set_sticky);
         view->priv->current_wset.reset();
     }
 
@@ -419,61 +583,248 @@ struct workspace_set_t::impl
             return wset_views;
         }
 
+        std::vector<wayfire_toplevel_view> views;
+        views.reserve(wset_views.size());
+        for_each_view(flags, [&] (wayfire_toplevel_view view) { views.push_back(view); }, workspace);
+        return views;
+    }
+
+    void for_each_view(uint32_t flags, const std::function<void(wayfire_toplevel_view)>& callback,
+        std::optional<wf::point_t> workspace = {})
+    {
         if (flags & WSET_CURRENT_WORKSPACE)
         {
             workspace = get_current_workspace();
         }
 
-        auto views = wset_views;
-        auto it    = std::remove_if(views.begin(), views.end(), [&] (wayfire_toplevel_view view)
+        auto matches = [&] (wayfire_toplevel_view view)
         {
             if ((flags & WSET_MAPPED_ONLY) && !view->is_mapped())
             {
-                return true;
+                return false;
             }
 
             if ((flags & WSET_EXCLUDE_MINIMIZED) && view->minimized)
             {
-                return true;
+                return false;
             }
 
-            if ((flags & WSET_SORT_STACKING) && !is_attached_to_scenegraph(view->get_root_node().get()))
+            if (workspace && !view_visible_on(view, *workspace))
             {
-                return true;
+                return false;
             }
 
-            if (workspace && !view_visible_on(view, *workspace))
+            return true;
+        };
+
+        // The list is looked up again for each view, in case the callback changes it.
+        const bool use_bucket = workspace && !(flags & WSET_SORT_STACKING) && has_buckets(*workspace);
+        for (size_t i = 0;; i++)
+        {
+            wayfire_toplevel_view view;
+            if (use_bucket)
             {
-                return true;
+                auto& bucket = get_bucket(*workspace);
+                if (i >= bucket.size())
+                {
+                    break;
+                }
+
+                view = bucket[i].second;
+            } else
+            {
+                auto& views = (flags & WSET_SORT_STACKING) ? get_views_in_stacking_order() : wset_views;
+                if (i >= views.size())
+                {
+                    break;
+                }
+
+                view = views[i];
             }
 
-            return false;
+            if (matches(view))
+            {
+                callback(view);
+            }
+        }
+    }
+
+  private:
+    std::vector<wayfire_toplevel_view> wset_views;
+
+    /*
+     * The views of the set which are attached to the scenegraph, in stacking order. The order changes only
+     * when the scenegraph's structure or the views of the set do, so it is computed again only then.
+     */
+    std::vector<wayfire_toplevel_view> stacking_order;
+    std::optional<uint64_t> stacking_order_generation;
+
+    const std::vector<wayfire_toplevel_view>& get_views_in_stacking_order()
+    {
+        const uint64_t generation = wf::scene::get_children_list_generation();
+        if (stacking_order_generation == generation)
+        {
+            return stacking_order;
+        }
+
+        std::vector<std::pair<std::vector<size_t>, wayfire_toplevel_view>> paths;
+        for (auto& view : wset_views)
+        {
+            if (auto path = find_path_from_root(view->get_root_node().get()))
+            {
+                paths.emplace_back(std::move(*path), view);
+            }
+        }
+
+        std::sort(paths.begin(), paths.end(), [] (const auto& a, const auto& b)
+        {
+            const size_t common = std::min(a.first.size(), b.first.size());
+            wf::dassert((a.second == b.second) ||
+                !std::equal(a.first.begin(), a.first.begin() + common, b.first.begin()),
+                "A view should not be a descendant of another view, this means nested views/dialogs have "
+                "been added to the wset!");
+            return a.first < b.first;
         });
-        views.erase(it, views.end());
 
-        if (flags & WSET_SORT_STACKING)
+        stacking_order.clear();
+        for (auto& [_, view] : paths)
+        {
+            stacking_order.push_back(view);
+        }
+
+        stacking_order_generation = generation;
+        return stacking_order;
+    }
+
+    /*
+     * The views visible on each workspace, indexed by y * grid width + x, in the same order as wset_views.
+     * A view is found again only when its geometry or sticky state changes, and all views are when the
+     * workspace, the grid or the output geometry change. The buckets are updated lazily on the next query.
+     */
+    struct bucket_entry_t
+    {
+        // Position of the view in wset_views relative to the other views
+        uint64_t sequence = 0;
+        std::vector<size_t> buckets;
+        bool dirty = false;
+    };
+
+    using bucket_t = std::vector<std::pair<uint64_t, wayfire_toplevel_view>>;
+    std::vector<bucket_t> buckets;
+    std::unordered_map<toplevel_view_interface_t*, bucket_entry_t> bucket_entries;
+    std::vector<toplevel_view_interface_t*> dirty_views;
+    bool all_buckets_dirty = true;
+    uint64_t next_sequence = 0;
+
+    /** Mark the buckets of one view as outdated, or all of them if no view is given. */
+    void invalidate_buckets(wayfire_toplevel_view view = nullptr)
+    {
+        if (!view)
+        {
+            all_buckets_dirty = true;
+            dirty_views.clear();
+            return;
+        }
+
+        auto it = bucket_entries.find(view.get());
+        if (all_buckets_dirty || (it == bucket_entries.end()) || it->second.dirty)
+        {
+            return;
+        }
+
+        it->second.dirty = true;
+        dirty_views.push_back(view.get());
+    }
+
+    void remove_from_buckets(wayfire_toplevel_view view)
+    {
+        auto it = bucket_entries.find(view.get());
+        if (all_buckets_dirty || (it == bucket_entries.end()))
+        {
+            return;
+        }
+
+        for (size_t idx : it->second.buckets)
+        {
+            auto& bucket = buckets[idx];
+            bucket.erase(std::find(bucket.begin(), bucket.end(), std::make_pair(it->second.sequence, view)));
+        }
+
+        it->second.buckets.clear();
+    }
+
+    void insert_into_buckets(wayfire_toplevel_view view)
+    {
+        auto& entry = bucket_entries[view.get()];
+        entry.dirty = false;
+        for (int y = 0; y < grid.grid.height; y++)
+        {
+            for (int x = 0; x < grid.grid.width; x++)
+            {
+                if (compute_visible_on(view, {x, y}))
+                {
+                    const size_t idx = y * grid.grid.width + x;
+                    auto& bucket     = buckets[idx];
+                    auto pos = std::lower_bound(bucket.begin(), bucket.end(),
+                        entry.sequence, [] (const auto& a, uint64_t seq) { return a.first < seq; });
+                    bucket.insert(pos, {entry.sequence, view});
+                    entry.buckets.push_back(idx);
+                }
+            }
+        }
+    }
+
+    void update_buckets()
+    {
+        if (all_buckets_dirty)
         {
-            std::sort(views.begin(), views.end(), [] (wayfire_toplevel_view a, wayfire_view b)
+            buckets.assign(grid.grid.width * grid.grid.height, {});
+            for (auto& view : wset_views)
             {
-                wf::scene::node_t *x   = a->get_root_node().get();
-                wf::scene::node_t *y   = b->get_root_node().get();
-                wf::scene::node_t *lca = find_lca(x, y);
-                wf::dassert(lca != nullptr,
-                    "LCA should always exist when the two nodes are in the scenegraph!");
-                wf::dassert((lca != x) && (lca != y), "LCA should not be equal to one of the nodes, this"
-                                                      "means nested views/dialogs have been added to the wset!");
+                bucket_entries[view.get()].buckets.clear();
+                insert_into_buckets(view);
+            }
 
-                const size_t idx_x = find_index_in_parent(x, lca);
-                const size_t idx_y = find_index_in_parent(y, lca);
-                return idx_x < idx_y;
-            });
+            all_buckets_dirty = false;
+            return;
         }
 
-        return views;
+        auto views = std::move(dirty_views);
+        dirty_views.clear();
+        for (auto view : views)
+        {
+            auto it = bucket_entries.find(view);
+            if ((it != bucket_entries.end()) && it->second.dirty)
+            {
+                auto toplevel = wayfire_toplevel_view{view};
+                remove_from_buckets(toplevel);
+                insert_into_buckets(toplevel);
+            }
+        }
     }
 
-  private:
-    std::vector<wayfire_toplevel_view> wset_views;
+    bool has_buckets(wf::point_t ws)
+    {
+        return workspace_geometry && grid.is_workspace_valid(ws);
+    }
+
+    const bucket_t& get_bucket(wf::point_t ws)
+    {
+        update_buckets();
+        return buckets[ws.y * grid.grid.width + ws.x];
+    }
+
+    bool compute_visible_on(wayfire_toplevel_view view, wf::point_t vp)
+    {
+        auto g = *workspace_geometry;
+        if (!view->sticky)
+        {
+            g.x += (vp.x - current_vx) * g.width;
+            g.y += (vp.y - current_vy) * g.height;
+        }
+
+        return g & view->get_geometry();
+    }
 
     int current_vx = 0;
     int current_vy = 0;
@@ -510,14 +861,16 @@ struct workspace_set_t::impl
             return false;
         }
 
-        auto g = *workspace_geometry;
-        if (!view->sticky)
+        auto it = bucket_entries.find(view.get());
+        if (!has_buckets(vp) || (it == bucket_entries.end()))
         {
-            g.x += (vp.x - current_vx) * g.width;
-            g.y += (vp.y - current_vy) * g.height;
+            return compute_visible_on(view, vp);
         }
 
-        return g & view->get_geometry();
+        update_buckets();
+        const size_t idx = vp.y * grid.grid.width + vp.x;
+        return std::find(it->second.buckets.begin(), it->second.buckets.end(), idx) !=
+               it->second.buckets.end();
     }
 
     /**
@@ -596,6 +949,7 @@ struct workspace_set_t::impl
          * views. */
         current_vx = nws.x;
         current_vy = nws.y;
+        invalidate_buckets();
 
         auto screen = wf::dimensions(*workspace_geometry);
         auto dx     = (data.old_viewport.x - nws.x) * screen.width;
@@ -697,6 +1051,12 @@ std::vector<wayfire_toplevel_view> workspace_set_t::get_views(uint32_t flags, st
     return pimpl->get_views(flags, ws);
 }
 
+void workspace_set_t::for_each_view(uint32_t flags, std::function<void(wayfire_toplevel_view)> callback,
+    std::optional<wf::point_t> ws)
+{
+    pimpl->for_each_view(flags, callback, ws);
+}
+
 void workspace_set_t::remove_view(wayfire_toplevel_view view)
 {
     pimpl->remove_view(view);
@@ -1,5 +1,8 @@
 #include <wayfire/region.hpp>
 #include <wayfire/nonstd/wlroots-full.hpp>
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 /* Pixman helpers */
 wlr_box wlr_box_from_pixman_box(const pixman_box32_t& box)
@@ -123,6 +126,128 @@ void wf::region_t::expand_edges(int amount)
     free(dst_rects);
 }
 
+static int64_t box_area(const pixman_box32_t& box)
+{
+    return int64_t(box.x2 - box.x1) * (box.y2 - box.y1);
+}
+
+static pixman_box32_t box_union(const pixman_box32_t& a, const pixman_box32_t& b)
+{
+    return pixman_box32_t{
+        .x1 = std::min(a.x1, b.x1),
+        .y1 = std::min(a.y1, b.y1),
+        .x2 = std::max(a.x2, b.x2),
+        .y2 = std::max(a.y2, b.y2),
+    };
+}
+
+void wf::region_t::simplify(int max_rects, int64_t max_overdraw)
+{
+    /* pixman keeps the boxes sorted by y and then by x, so boxes which are next
+     * to each other in the list are usually close on screen as well. Looking only
+     * at the next few boxes keeps each merge step linear in the number of boxes. */
+    constexpr size_t merge_window = 8;
+    /* The union of the merged boxes is split into bands again, so it may have
+     * more rectangles than the boxes themselves. */
+    constexpr int max_attempts = 4;
+
+    for (int attempt = 0; attempt < max_attempts; attempt++)
+    {
+        int nrects;
+        const pixman_box32_t *rects = pixman_region32_rectangles(to_pixman(), &nrects);
+        const bool over_budget = (max_rects > 0) && (nrects > max_rects);
+        if (!over_budget && ((max_overdraw <= 0) || (attempt > 0)))
+        {
+            return;
+        }
+
+        std::vector<pixman_box32_t> boxes(rects, rects + nrects);
+        bool merged = false;
+        while (boxes.size() > 1)
+        {
+            size_t best_i = 0, best_j = 1;
+            int64_t best_cost = INT64_MAX;
+            for (size_t i = 0; i < boxes.size(); i++)
+            {
+                const size_t last = std::min(boxes.size(), i + 1 + merge_window);
+                for (size_t j = i + 1; j < last; j++)
+                {
+                    const int64_t cost = box_area(box_union(boxes[i], boxes[j])) -
+                        box_area(boxes[i]) - box_area(boxes[j]);
+                    if (cost < best_cost)
+                    {
+                        best_cost = cost;
+                        best_i    = i;
+                        best_j    = j;
+                    }
+                }
+            }
+
+            const bool within_budget = (max_rects <= 0) || ((int)boxes.size() <= max_rects);
+            if (within_budget && (best_cost >= max_overdraw))
+            {
+                break;
+            }
+
+            boxes[best_i] = box_union(boxes[best_i], boxes[best_j]);
+            boxes.erase(boxes.begin() + best_j);
+            merged = true;
+        }
+
+        if (!merged)
+        {
+            return;
+        }
+
+        pixman_region32_fini(to_pixman());
+        pixman_region32_init_rects(to_pixman(), boxes.data(), boxes.size());
+    }
+
+    int nrects;
+    pixman_region32_rectangles(to_pixman(), &nrects);
+    if ((max_rects > 0) && (nrects > max_rects))
+    {
+        auto extents = get_extents();
+        pixman_region32_fini(to_pixman());
+        pixman_region32_init_rect(to_pixman(), extents.x1, extents.y1,
+            extents.x2 - extents.x1, extents.y2 - extents.y1);
+    }
+}
+
+void wf::region_builder_t::reserve(size_t count)
+{
+    boxes.reserve(count);
+}
+
+void wf::region_builder_t::add(const wlr_box& box)
+{
+    if ((box.width > 0) && (box.height > 0))
+    {
+        boxes.push_back(pixman_box_from_wlr_box(box));
+    }
+}
+
+void wf::region_builder_t::add(const pixman_box32_t& box)
+{
+    if ((box.x1 < box.x2) && (box.y1 < box.y2))
+    {
+        boxes.push_back(box);
+    }
+}
+
+wf::region_t wf::region_builder_t::build()
+{
+    wf::region_t result;
+    if (!boxes.empty())
+    {
+        pixman_region32_fini(result.to_pixman());
+        pixman_region32_init_rects(result.to_pixman(), boxes.data(), boxes.size());
+        boxes.clear();
+    }
+
+    return result;
+}
+
 pixman_box32_t wf::region_t::get_extents() const
 {
     return *pixman_region32_extents(this->unconst());
@@ -151,33 +276,45 @@ bool wf::region_t::contains_pointf(const wf::pointf_t& point) const
 }
 
 /* Translate the region */
-wf::region_t wf::region_t::operator +(const wf::point_t& vector) const
+wf::region_t wf::region_t::operator +(const wf::point_t& vector) const &
 {
     wf::region_t result{*this};
     pixman_region32_translate(&result._region, vector.x, vector.y);
     return result;
 }
 
+wf::region_t wf::region_t::operator +(const wf::point_t& vector) &&
+{
+    *this += vector;
+    return std::move(*this);
+}
+
 wf::region_t& wf::region_t::operator +=(const wf::point_t& vector)
 {
     pixman_region32_translate(&_region, vector.x, vector.y);
     return *this;
 }
 
-wf::region_t wf::region_t::operator -(const wf::point_t& vector) const
+wf::region_t wf::region_t::operator -(const wf::point_t& vector) const &
 {
     wf::region_t result{*this};
     pixman_region32_translate(&result._region, -vector.x, -vector.y);
     return result;
 }
 
+wf::region_t wf::region_t::operator -(const wf::point_t& vector) &&
+{
+    *this -= vector;
+    return std::move(*this);
+}
+
 wf::region_t& wf::region_t::operator -=(const wf::point_t& vector)
 {
     pixman_region32_translate(&_region, -vector.x, -vector.y);
     return *this;
 }
 
-wf::region_t wf::region_t::operator *(float scale) const
+wf::region_t wf::region_t::operator *(float scale) const &
 {
     wf::region_t result;
     wlr_region_scale(result.to_pixman(), this->unconst(), scale);
@@ -185,6 +322,12 @@ wf::region_t wf::region_t::operator *(float scale) const
     return result;
 }
 
+wf::region_t wf::region_t::operator *(float scale) &&
+{
+    *this *= scale;
+    return std::move(*this);
+}
+
 wf::region_t& wf::region_t::operator *=(float scale)
 {
     wlr_region_scale(this->to_pixman(), this->to_pixman(), scale);
@@ -193,7 +336,7 @@ wf::region_t& wf::region_t::operator *=(float scale)
 }
 
 /* Region intersection */
-wf::region_t wf::region_t::operator &(const wlr_box& box) const
+wf::region_t wf::region_t::operator &(const wlr_box& box) const &
 {
     wf::region_t result;
     pixman_region32_intersect_rect(result.to_pixman(), this->unconst(),
@@ -202,7 +345,7 @@ wf::region_t wf::region_t::operator &(const wlr_box& box) const
     return result;
 }
 
-wf::region_t wf::region_t::operator &(const wf::region_t& other) const
+wf::region_t wf::region_t::operator &(const wf::region_t& other) const &
 {
     wf::region_t result;
     pixman_region32_intersect(result.to_pixman(),
@@ -211,6 +354,12 @@ wf::region_t wf::region_t::operator &(const wf::region_t& other) const
     return result;
 }
 
+wf::region_t wf::region_t::operator &(const wlr_box& box) &&
+{
+    *this &= box;
+    return std::move(*this);
+}
+
 wf::region_t& wf::region_t::operator &=(const wlr_box& box)
 {
     pixman_region32_intersect_rect(this->to_pixman(), this->to_pixman(),
@@ -219,6 +368,12 @@ wf::region_t& wf::region_t::operator &=(const wlr_box& box)
     return *this;
 }
 
+wf::region_t wf::region_t::operator &(const wf::region_t& other) &&
+{
+    *this &= other;
+    return std::move(*this);
+}
+
 wf::region_t& wf::region_t::operator &=(const wf::region_t& other)
 {
     pixman_region32_intersect(this->to_pixman(),
@@ -228,7 +383,7 @@ wf::region_t& wf::region_t::operator &=(const wf::region_t& other)
 }
 
 /* Region union */
-wf::region_t wf::region_t::operator |(const wlr_box& other) const
+wf::region_t wf::region_t::operator |(const wlr_box& other) const &
 {
     wf::region_t result;
     pixman_region32_union_rect(result.to_pixman(), this->unconst(),
@@ -237,7 +392,7 @@ wf::region_t wf::region_t::operator |(const wlr_box& other) const
     return result;
 }
 
-wf::region_t wf::region_t::operator |(const wf::region_t& other) const
+wf::region_t wf::region_t::operator |(const wf::region_t& other) const &
 {
     wf::region_t result;
     pixman_region32_union(result.to_pixman(), this->unconst(), other.unconst());
@@ -245,6 +400,12 @@ wf::region_t wf::region_t::operator |(const wf::region_t& other) const
     return result;
 }
 
+wf::region_t wf::region_t::operator |(const wlr_box& other) &&
+{
+    *this |= other;
+    return std::move(*this);
+}
+
 wf::region_t& wf::region_t::operator |=(const wlr_box& other)
 {
     pixman_region32_union_rect(this->to_pixman(), this->to_pixman(),
@@ -253,6 +414,12 @@ wf::region_t& wf::region_t::operator |=(const wlr_box& other)
     return *this;
 }
 
+wf::region_t wf::region_t::operator |(const wf::region_t& other) &&
+{
+    *this |= other;
+    return std::move(*this);
+}
+
 wf::region_t& wf::region_t::operator |=(const wf::region_t& other)
 {
     pixman_region32_union(this->to_pixman(), this->to_pixman(), other.unconst());
@@ -261,7 +428,7 @@ wf::region_t& wf::region_t::operator |=(const wf::region_t& other)
 }
 
 /* Subtract the box/region from the current region */
-wf::region_t wf::region_t::operator ^(const wlr_box& box) const
+wf::region_t wf::region_t::operator ^(const wlr_box& box) const &
 {
     wf::region_t result;
     wf::region_t sub{box};
@@ -270,7 +437,7 @@ wf::region_t wf::region_t::operator ^(const wlr_box& box) const
     return result;
 }
 
-wf::region_t wf::region_t::operator ^(const wf::region_t& other) const
+wf::region_t wf::region_t::operator ^(const wf::region_t& other) const &
 {
     wf::region_t result;
     pixman_region32_subtract(result.to_pixman(),
@@ -279,6 +446,12 @@ wf::region_t wf::region_t::operator ^(const wf::region_t& other) const
     return result;
 }
 
+wf::region_t wf::region_t::operator ^(const wlr_box& box) &&
+{
+    *this ^= box;
+    return std::move(*this);
+}
+
 wf::region_t& wf::region_t::operator ^=(const wlr_box& box)
 {
     wf::region_t sub{box};
@@ -288,6 +461,12 @@ wf::region_t& wf::region_t::operator ^=(const wlr_box& box)
     return *this;
 }
 
+wf::region_t wf::region_t::operator ^(const wf::region_t& other) &&
+{
+    *this ^= other;
+    return std::move(*this);
+}
+
 wf::region_t& wf::region_t::operator ^=(const wf::region_t& other)
 {
     pixman_region32_subtract(this->to_pixman(),
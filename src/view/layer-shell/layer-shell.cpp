@@ -1,6 +1,7 @@
 #include <algorithm>
 #include <cstring>
 #include <cstdlib>
+#include <optional>
 
 #include <wayfire/seat.hpp>
 #include <wayfire/workarea.hpp>
@@ -27,6 +28,20 @@ static const uint32_t both_vert =
 static const uint32_t both_horiz =
     ZWLR_LAYER_SURFACE_V1_ANCHOR_LEFT | ZWLR_LAYER_SURFACE_V1_ANCHOR_RIGHT;
 
+/**
+ * Check whether two states of a layer surface would be arranged in the same way, i.e. whether the surface's
+ * position, size and reserved area (and thus the position of all other layer surfaces on the output) stay
+ * the same.
+ */
+static bool same_arrangement(const wlr_layer_surface_v1_state& a, const wlr_layer_surface_v1_state& b)
+{
+    return (a.anchor == b.anchor) && (a.exclusive_zone == b.exclusive_zone) &&
+           (a.margin.top == b.margin.top) && (a.margin.bottom == b.margin.bottom) &&
+           (a.margin.left == b.margin.left) && (a.margin.right == b.margin.right) &&
+           (a.desired_width == b.desired_width) && (a.desired_height == b.desired_height) &&
+           (a.layer == b.layer);
+}
+
 class wayfire_layer_shell_view : public wf::view_interface_t
 {
     wf::wl_listener_wrapper on_map;
@@ -50,6 +65,12 @@ class wayfire_layer_shell_view : public wf::view_interface_t
     /** The output geometry of the view */
     wf::geometry_t geometry{100, 100, 0, 0};
 
+    /**
+     * The box which was last sent to the client with configure(). Rearranging the layers usually results in
+     * the same box for most surfaces, in which case there is no need to move them or send a new configure.
+     */
+    std::optional<wf::geometry_t> last_configured;
+
     std::string app_id;
     friend class wf::tracking_allocator_t<view_interface_t>;
     wayfire_layer_shell_view(wlr_layer_surface_v1 *lsurf);
@@ -527,6 +548,8 @@ void wayfire_layer_shell_view::unmap()
     on_surface_commit.disconnect();
     emit_view_unmap();
     priv->set_mapped(false);
+    /* The client needs a new configure before it can map again */
+    last_configured.reset();
 
     wf_layer_shell_manager::get_instance().handle_unmap(this);
 }
@@ -556,9 +579,11 @@ void wayfire_layer_shell_view::commit()
             wf::scene::readd_front(get_output()->node_for_layer(get_layer()), get_root_node());
             /* Will also trigger reflowing */
             wf_layer_shell_manager::get_instance().handle_move_layer(this);
-        } else
+        } else if (!same_arrangement(prev_state, *state))
         {
-            /* Reflow reserved areas and positions */
+            /* Reflow reserved areas and positions. Commits which do not change
+             * the arrangement (e.g. panels which only update their contents)
+             * do not need to touch the other layer surfaces or the workarea. */
             wf_layer_shell_manager::get_instance().arrange_layers(get_output());
         }
 
@@ -585,6 +610,7 @@ void wayfire_layer_shell_view::set_output(wf::output_t *output)
         // View's output is being destroyed, no point in reflowing
         // View is about to be mapped, no anchored area at all.
         this->remove_anchored(false);
+        this->last_configured.reset();
     }
 
     wf::view_interface_t::set_output(output);
@@ -629,8 +655,16 @@ void wayfire_layer_shell_view::configure(wf::geometry_t box)
     {
         LOGE("layer-surface has calculated width and height < 0");
         close();
+        return;
+    }
+
+    if (last_configured == box)
+    {
+        return;
     }
 
+    last_configured = box;
+
     // TODO: transactions here could make sense, since we want to change x,y,w,h together, but have to wait
     // for the client to resize.
     move(box.x, box.y);
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <string>
 #include <wayfire/scene.hpp>
 #include <wayfire/unstable/translation-node.hpp>
@@ -65,38 +66,34 @@ wf::scene::translation_node_instance_t::translation_node_instance_t(
     };
     self->connect(&on_node_damage);
 
-    on_regen_instances = [=] (auto)
+    on_regen_instances = [=] (wf::scene::node_regen_instances_signal *ev)
     {
-        regen_instances();
+        ev->handled = true;
+        regen_instances(ev->changed_child);
     };
     self->connect(&on_regen_instances);
     regen_instances();
 }
 
-void wf::scene::translation_node_instance_t::regen_instances()
+void wf::scene::translation_node_instance_t::regen_instances(node_t *changed_child)
 {
-    children.clear();
     auto push_damage_child = [=] (wf::region_t child_damage)
     {
         child_damage += self->get_offset();
         push_damage(child_damage);
     };
 
-    for (auto& ch : self->get_children())
-    {
-        if (ch->is_enabled())
-        {
-            ch->gen_render_instances(children, push_damage_child, shown_on);
-        }
-    }
+    regen_children_instances(self.get(), changed_child, children, children_origin,
+        push_damage_child, shown_on);
 }
 
 void wf::scene::translation_node_instance_t::schedule_instructions(
     std::vector<wf::scene::render_instruction_t>& instructions,
     const wf::render_target_t& target, wf::region_t& damage)
 {
-    wf::region_t our_damage = damage & self->get_bounding_box();
-    if (!our_damage.empty())
+    // Only check whether the damage intersects the node, without computing the intersection
+    auto bbox = pixman_box_from_wlr_box(self->get_bounding_box());
+    if (pixman_region32_contains_rectangle(damage.to_pixman(), &bbox) != PIXMAN_REGION_OUT)
     {
         wf::point_t offset = self->get_offset();
         damage += -offset;
@@ -117,6 +114,14 @@ void wf::scene::translation_node_instance_t::render(
     wf::dassert(false, "Rendering a translation node?");
 }
 
+bool wf::scene::translation_node_instance_t::supports_direct_render()
+{
+    return std::all_of(children.begin(), children.end(), [] (const render_instance_uptr& ch)
+    {
+        return ch->supports_direct_render();
+    });
+}
+
 void wf::scene::translation_node_instance_t::presentation_feedback(wf::output_t *output)
 {
     for (auto& ch : this->children)
@@ -135,7 +140,21 @@ wf::scene::direct_scanout wf::scene::translation_node_instance_t::try_scanout(wf
     return try_scanout_from_list(this->children, output);
 }
 
+wf::scene::direct_scanout wf::scene::translation_node_instance_t::try_output_layers(wf::output_t *output,
+    wf::scene::output_layers_plan_t& plan)
+{
+    plan.offset = plan.offset + self->get_offset();
+    auto result = try_output_layers_from_list(this->children, output, plan);
+    plan.offset = plan.offset - self->get_offset();
+    return result;
+}
+
 void wf::scene::translation_node_instance_t::compute_visibility(wf::output_t *output, wf::region_t& visible)
 {
     compute_visibility_from_list(children, output, visible, self->get_offset());
 }
+
+wf::scene::node_t*wf::scene::translation_node_instance_t::get_node() const
+{
+    return self.get();
+}
@@ -10,6 +10,7 @@
 #include "wayfire/core.hpp"
 #include "wayfire/output.hpp"
 #include <glm/ext/matrix_transform.hpp>
+#include <optional>
 #include <string>
 #include <tuple>
 #include <wayfire/view.hpp>
@@ -160,6 +161,12 @@ std::string view_2d_transformer_t::stringify() const
     return "view-2d for " + view->to_string();
 }
 
+bool view_2d_transformer_t::is_identity() const
+{
+    return (scale_x == 1.0f) && (scale_y == 1.0f) && (translation_x == 0.0f) && (translation_y == 0.0f) &&
+           (angle == 0.0f) && (alpha == 1.0f);
+}
+
 wf::geometry_t view_2d_transformer_t::get_bounding_box()
 {
     return get_bbox_for_node(this, get_children_bounding_box());
@@ -167,13 +174,198 @@ wf::geometry_t view_2d_transformer_t::get_bounding_box()
 
 static void transform_linear_damage(node_t *self, wf::region_t& damage)
 {
-    auto copy = damage;
-    damage.clear();
-    for (auto& box : copy)
+    int nrects;
+    pixman_region32_rectangles(damage.to_pixman(), &nrects);
+    if (nrects == 1)
+    {
+        damage = get_bbox_for_node(self, wlr_box_from_pixman_box(*damage.begin()));
+        return;
+    }
+
+    wf::region_builder_t builder;
+    builder.reserve(nrects);
+    for (auto& box : damage)
+    {
+        builder.add(get_bbox_for_node(self, wlr_box_from_pixman_box(box)));
+    }
+
+    damage = builder.build();
+}
+
+/**
+ * Estimate how big a transformer node shows its children, relative to their size, from the area of their
+ * transformed bounding box.
+ */
+static float get_displayed_scale(scene::node_t *node)
+{
+    const auto box = node->get_children_bounding_box();
+    if ((box.width <= 0) || (box.height <= 0))
+    {
+        return 1.0;
+    }
+
+    const wf::pointf_t corners[4] = {
+        node->to_global(wf::pointf_t(box.x, box.y)),
+        node->to_global(wf::pointf_t(box.x + box.width, box.y)),
+        node->to_global(wf::pointf_t(box.x + box.width, box.y + box.height)),
+        node->to_global(wf::pointf_t(box.x, box.y + box.height)),
+    };
+
+    double area = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        const auto& a = corners[i];
+        const auto& b = corners[(i + 1) % 4];
+        area += a.x * b.y - b.x * a.y;
+    }
+
+    return std::sqrt(std::abs(area) / 2.0 / (1.0 * box.width * box.height));
+}
+
+/** Whether the transformer shows its children from a level-of-detail thumbnail at the moment. */
+static bool uses_lod(transformer_base_node_t *self)
+{
+    return (self->lod_threshold > 0.0f) && (get_displayed_scale(self) < self->lod_threshold);
+}
+
+/**
+ * Get the region in the coordinate system of the node's children which covers the given region in the
+ * coordinate system of the node's parent.
+ *
+ * @return Whether all points could be mapped.
+ */
+static bool region_to_local(scene::node_t *self, const wf::region_t& region, wf::region_t& local)
+{
+    wf::region_builder_t builder;
+    for (auto& box : region)
     {
-        damage |=
-            get_bbox_for_node(self, wlr_box_from_pixman_box(box));
+        const wf::pointf_t corners[4] = {
+            self->to_local(wf::pointf_t(box.x1, box.y1)),
+            self->to_local(wf::pointf_t(box.x2, box.y1)),
+            self->to_local(wf::pointf_t(box.x1, box.y2)),
+            self->to_local(wf::pointf_t(box.x2, box.y2)),
+        };
+
+        double x1 = corners[0].x, x2 = corners[0].x, y1 = corners[0].y, y2 = corners[0].y;
+        for (auto& p : corners)
+        {
+            if ((p.x == wf::compositor_core_t::invalid_coordinate) || std::isnan(p.x) || std::isnan(p.y))
+            {
+                return false;
+            }
+
+            x1 = std::min(x1, p.x);
+            x2 = std::max(x2, p.x);
+            y1 = std::min(y1, p.y);
+            y2 = std::max(y2, p.y);
+        }
+
+        builder.add(wlr_box{(int)std::floor(x1), (int)std::floor(y1),
+            (int)std::ceil(x2) - (int)std::floor(x1), (int)std::ceil(y2) - (int)std::floor(y1)});
+    }
+
+    local = builder.build();
+    return true;
+}
+
+/**
+ * Schedule the children of a transformer directly on the target, with @transform and @alpha applied to each
+ * of their draws, instead of rendering them to an auxiliary buffer and drawing that with the effect.
+ *
+ * This needs support from all children, see render_instance_t::supports_direct_render(). With alpha, the
+ * result is also the same only if the children do not paint over each other, which is usually the case for
+ * a view's surfaces. Otherwise, nothing is scheduled.
+ *
+ * @param transform The transform from the coordinates of the children to those of the transformer's parent,
+ *   or none if the children are not transformed.
+ * @return Whether the children have been scheduled.
+ */
+static bool schedule_children_directly(transformer_base_node_t *self,
+    std::vector<render_instance_uptr>& children, std::vector<render_instruction_t>& instructions,
+    const wf::render_target_t& target, const wf::region_t& damage,
+    const std::optional<glm::mat4>& transform, float alpha)
+{
+    auto supports_direct_render = [] (const render_instance_uptr& ch)
+    {
+        return ch->supports_direct_render();
+    };
+
+    if (!std::all_of(children.begin(), children.end(), supports_direct_render))
+    {
+        return false;
+    }
+
+    // The transformed children are not necessarily opaque, so they do not hide anything below them, and
+    // @damage stays as it is.
+    wf::region_t children_damage;
+    if (!transform)
+    {
+        children_damage = damage;
+    } else if (!region_to_local(self, damage, children_damage))
+    {
+        return false;
+    }
+
+    const size_t first = instructions.size();
+    for (auto& ch : children)
+    {
+        ch->schedule_instructions(instructions, target, children_damage);
+    }
+
+    wf::region_t painted;
+    size_t kept = first;
+    for (size_t i = first; i < instructions.size(); i++)
+    {
+        auto& instr = instructions[i];
+        if (instr.target.fb != target.fb)
+        {
+            instructions.resize(first);
+            return false;
+        }
+
+        // Children in translation nodes are scheduled with translated targets.
+        const wf::point_t offset = {
+            target.geometry.x - instr.target.geometry.x,
+            target.geometry.y - instr.target.geometry.y,
+        };
+
+        wf::region_t drawn;
+        if (transform)
+        {
+            auto extents = wlr_box_from_pixman_box(instr.damage.get_extents()) + offset;
+            instr.damage    = damage & get_bbox_for_node(self, extents);
+            instr.transform = *transform * glm::translate(glm::mat4(1.0f), glm::vec3{offset.x, offset.y, 0});
+            instr.target    = target;
+            drawn = instr.damage;
+        } else
+        {
+            drawn = instr.damage + offset;
+        }
+
+        if ((alpha < 1.0f) && !(painted & drawn).empty())
+        {
+            instructions.resize(first);
+            return false;
+        }
+
+        painted |= drawn;
+        instr.alpha *= alpha;
+        if (!instr.damage.empty())
+        {
+            if (kept != i)
+            {
+                instructions[kept] = std::move(instr);
+            }
+
+            kept++;
+        }
     }
+
+    instructions.resize(kept);
+
+    // The auxiliary buffer is not needed while the children are rendered directly.
+    self->release_buffers();
+    return true;
 }
 
 class view_2d_render_instance_t :
@@ -187,13 +379,30 @@ class view_2d_render_instance_t :
         transform_linear_damage(self.get(), damage);
     }
 
-    void render(const wf::render_target_t& target,
-        const wf::region_t& region) override
+    void schedule_instructions(std::vector<render_instruction_t>& instructions,
+        const wf::render_target_t& target, wf::region_t& damage) override
     {
-        // Untransformed bounding box
-        auto bbox = self->get_children_bounding_box();
-        auto tex  = this->get_texture(target.scale);
+        std::optional<glm::mat4> transform;
+        const bool identity = (self->scale_x == 1.0f) && (self->scale_y == 1.0f) &&
+            (self->translation_x == 0.0f) && (self->translation_y == 0.0f) && (self->angle == 0.0f);
+        if (!identity)
+        {
+            transform = get_transform();
+        }
 
+        const bool direct = (self->scale_x != 0.0f) && (self->scale_y != 0.0f) &&
+            !uses_lod(self.get()) &&
+            schedule_children_directly(self.get(), children, instructions, target, damage, transform,
+                self->alpha);
+        if (!direct)
+        {
+            transformer_render_instance_t::schedule_instructions(instructions, target, damage);
+        }
+    }
+
+    /** The transform from the coordinates of the children to those of the transformer's parent. */
+    glm::mat4 get_transform()
+    {
         auto midpoint  = get_center(self->view);
         auto center_at = glm::translate(glm::mat4(1.0),
             {-midpoint.x, -midpoint.y, 0.0});
@@ -204,8 +413,16 @@ class view_2d_render_instance_t :
         auto translate = glm::translate(glm::mat4(1.0),
             glm::vec3{self->translation_x + midpoint.x,
                 self->translation_y + midpoint.y, 0.0});
-        auto ortho = target.get_orthographic_projection();
-        auto full_matrix = ortho * translate * rotate * scale * center_at;
+        return translate * rotate * scale * center_at;
+    }
+
+    void render(const wf::render_target_t& target,
+        const wf::region_t& region) override
+    {
+        // Untransformed bounding box
+        auto bbox = self->get_children_bounding_box();
+        auto tex  = this->get_texture(target.scale, get_displayed_scale(self.get()));
+        auto full_matrix = target.get_orthographic_projection() * get_transform();
 
         OpenGL::render_begin(target);
         for (auto& box : region)
@@ -272,21 +489,38 @@ static wf::pointf_t get_absolute_coords_from_relative(wf::geometry_t view,
     };
 }
 
-/* TODO: cache total_transform, because it is often unnecessarily recomputed */
 glm::mat4 view_3d_transformer_t::calculate_total_transform()
 {
-    auto bbox   = get_children_bounding_box();
+    return calculate_total_transform(get_children_bounding_box());
+}
+
+glm::mat4 view_3d_transformer_t::calculate_total_transform(wf::geometry_t bbox)
+{
+    if (cached.valid && (cached.bbox == bbox) && (cached.view_proj == view_proj) &&
+        (cached.translation == translation) && (cached.rotation == rotation) && (cached.scaling == scaling))
+    {
+        return cached.total;
+    }
+
     float scale = std::max(bbox.width, bbox.height);
     scale = std::max(scale, 1.0f);
     glm::mat4 depth_scale = glm::scale(glm::mat4(1.0), {1, 1, 2.0 / scale});
-    return translation * view_proj * depth_scale * rotation * scaling;
+
+    cached.valid = true;
+    cached.bbox  = bbox;
+    cached.view_proj   = view_proj;
+    cached.translation = translation;
+    cached.rotation    = rotation;
+    cached.scaling     = scaling;
+    cached.total = translation * view_proj * depth_scale * rotation * scaling;
+    return cached.total;
 }
 
 wf::pointf_t view_3d_transformer_t::to_local(const wf::pointf_t& point)
 {
     auto wm_geom = get_children_bounding_box();
     auto p  = get_center_relative_coords(wm_geom, point);
-    auto tr = calculate_total_transform();
+    auto tr = calculate_total_transform(wm_geom);
 
     /* Since we know that our original z coordinates were zero, we can write a
      * system of linear equations for the original (x,y) coordinates by writing
@@ -322,7 +556,7 @@ wf::pointf_t view_3d_transformer_t::to_global(const wf::pointf_t& point)
     auto wm_geom = get_children_bounding_box();
     auto p = get_center_relative_coords(wm_geom, point);
     glm::vec4 v(1.0f * p.x, 1.0f * p.y, 0, 1);
-    v = calculate_total_transform() * v;
+    v = calculate_total_transform(wm_geom) * v;
 
     if (std::abs(v.w) < 1e-6)
     {
@@ -345,6 +579,14 @@ std::string view_3d_transformer_t::stringify() const
     return "view-2d for " + view->to_string();
 }
 
+bool view_3d_transformer_t::is_identity() const
+{
+    static const glm::mat4 identity{1.0};
+    static const glm::mat4 default_view_proj = default_proj_matrix() * default_view_matrix();
+    return (translation == identity) && (rotation == identity) && (scaling == identity) &&
+           (view_proj == default_view_proj) && (color == glm::vec4{1, 1, 1, 1});
+}
+
 wf::geometry_t view_3d_transformer_t::get_bounding_box()
 {
     return get_bbox_for_node(this, get_children_bounding_box());
@@ -386,14 +628,27 @@ class view_3d_render_instance_t :
   public:
     using transformer_render_instance_t::transformer_render_instance_t;
 
-
     void transform_damage_region(wf::region_t& damage) override
     {
         transform_linear_damage(self.get(), damage);
     }
 
-    void render(const wf::render_target_t& target,
-        const wf::region_t& damage) override
+    void schedule_instructions(std::vector<render_instruction_t>& instructions,
+        const wf::render_target_t& target, wf::region_t& damage) override
+    {
+        // Only the opacity can be applied to each draw, not a color.
+        const bool only_alpha = (self->color.r == 1.0f) && (self->color.g == 1.0f) && (self->color.b == 1.0f);
+        const bool direct     = only_alpha && !uses_lod(self.get()) &&
+            schedule_children_directly(self.get(), children, instructions, target, damage,
+                get_transform(target), self->color.a);
+        if (!direct)
+        {
+            transformer_render_instance_t::schedule_instructions(instructions, target, damage);
+        }
+    }
+
+    /** The transform from the quad of the children's texture, see center_geometry(), to the framebuffer. */
+    glm::mat4 get_framebuffer_transform(const wf::render_target_t& target)
     {
         auto bbox = self->get_children_bounding_box();
         auto quad = center_geometry(target.geometry, bbox, scene::get_center(bbox));
@@ -406,8 +661,27 @@ class view_3d_render_instance_t :
                     1.0
                 });
 
-        transform = target.gl_to_framebuffer() * scale * translate * transform;
-        auto tex = get_texture(target.scale);
+        return target.gl_to_framebuffer() * scale * translate * transform;
+    }
+
+    /** The transform from the coordinates of the children to the logical coordinates of the target. */
+    glm::mat4 get_transform(const wf::render_target_t& target)
+    {
+        // The quad is centered at the children's center, with the y axis pointing up.
+        auto center  = scene::get_center(self->get_children_bounding_box());
+        auto to_quad = glm::translate(glm::mat4(1.0), {-center.x, center.y, 0}) *
+            glm::scale(glm::mat4(1.0), {1, -1, 1});
+        auto ortho   = target.get_orthographic_projection();
+        return glm::inverse(ortho) * get_framebuffer_transform(target) * to_quad;
+    }
+
+    void render(const wf::render_target_t& target,
+        const wf::region_t& damage) override
+    {
+        auto bbox = self->get_children_bounding_box();
+        auto quad = center_geometry(target.geometry, bbox, scene::get_center(bbox));
+        auto transform = get_framebuffer_transform(target);
+        auto tex = get_texture(target.scale, get_displayed_scale(self.get()));
 
         OpenGL::render_begin(target);
         for (auto& box : damage)
@@ -65,11 +65,16 @@ void init_xdg_shell();
 void init_xwayland();
 void init_layer_shell();
 
+/**
+ * The X11 display name, or an empty string if Xwayland is disabled. In lazy mode, the display exists before
+ * the server has been started.
+ */
 std::string xwayland_get_display();
 void xwayland_update_default_cursor();
 
 /* Ensure that the given surface is on top of the Xwayland stack order. */
 void xwayland_bring_to_front(wlr_surface *surface);
+/** The pid of the Xwayland server, or -1 if it is disabled or has not been started yet. */
 int xwayland_get_pid();
 
 void init_desktop_apis();
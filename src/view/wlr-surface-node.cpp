@@ -4,15 +4,67 @@
 #include "wayfire/render-manager.hpp"
 #include "wayfire/scene-render.hpp"
 #include "wayfire/scene.hpp"
+#include "wayfire/gpu-memory.hpp"
 #include "wlr-surface-pointer-interaction.hpp"
 #include "wlr-surface-touch-interaction.cpp"
 #include "wayfire/output-layout.hpp"
+#include "../core/seat/input-latency.hpp"
 #include <glm/gtc/matrix_transform.hpp>
 #include <memory>
 #include <sstream>
 #include <string>
 #include <wayfire/signal-provider.hpp>
 #include <wlr/util/box.h>
+#include <linux/dma-buf.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace
+{
+/** Commits which come later than this after a frame callback (in microseconds) are not latency samples */
+constexpr int64_t MAX_COMMIT_LATENCY = 100'000;
+/** Time left between the expected commit of a client and the start of the repaint, in microseconds */
+constexpr int64_t FRAME_DONE_MARGIN = 1'000;
+
+/**
+ * Get a sync file which signals when the GPU has finished writing to the buffer, using the fences attached
+ * implicitly to its dmabuf.
+ *
+ * @return The sync file, or -1 if the buffer is not a dmabuf or the kernel cannot export fences.
+ */
+int export_buffer_write_fence(wlr_buffer *buffer)
+{
+#ifdef DMA_BUF_IOCTL_EXPORT_SYNC_FILE
+    // The texture of a client buffer is imported already, but the client's buffer is still around.
+    auto client_buffer = wlr_client_buffer_get(buffer);
+    wlr_buffer *source = client_buffer ? client_buffer->source : buffer;
+
+    wlr_dmabuf_attributes attribs;
+    if (!source || !wlr_buffer_get_dmabuf(source, &attribs) || (attribs.n_planes < 1))
+    {
+        return -1;
+    }
+
+    // The planes of a buffer practically always share their fences, so the first one is enough.
+    dma_buf_export_sync_file data = {.flags = DMA_BUF_SYNC_READ, .fd = -1};
+    if (ioctl(attribs.fd[0], DMA_BUF_IOCTL_EXPORT_SYNC_FILE, &data) != 0)
+    {
+        return -1;
+    }
+
+    return data.fd;
+#else
+    return -1;
+#endif
+}
+
+bool is_fence_signaled(int fence)
+{
+    pollfd pfd = {.fd = fence, .events = POLLIN, .revents = 0};
+    return poll(&pfd, 1, 0) > 0;
+}
+}
 
 wf::scene::surface_state_t::surface_state_t(surface_state_t&& other)
 {
@@ -101,6 +153,8 @@ wf::scene::wlr_surface_node_t::wlr_surface_node_t(wlr_surface *surface, bool aut
 
     this->on_surface_destroyed.set_callback([=] (void*)
     {
+        input_latency::forget_surface(this->surface);
+        cancel_buffer_wait();
         this->surface = NULL;
         this->ptr_interaction = std::make_unique<pointer_interaction_t>();
         this->tch_interaction = std::make_unique<touch_interaction_t>();
@@ -111,6 +165,33 @@ wf::scene::wlr_surface_node_t::wlr_surface_node_t(wlr_surface *surface, bool aut
 
     this->on_surface_commit.set_callback([=] (void*)
     {
+        if ((frame_done_sent_at >= 0) && wlr_surface_has_buffer(this->surface))
+        {
+            const int64_t sample = wf::get_current_time_usec() - frame_done_sent_at;
+            frame_done_sent_at = -1;
+
+            // Clients which do not draw continuously commit whenever they have something new to show, which
+            // says nothing about how fast they are.
+            if (sample <= MAX_COMMIT_LATENCY)
+            {
+                // Adapt quickly to slower frames, so that the client does not miss the next repaint.
+                commit_latency = (sample > commit_latency) ? sample : (3 * commit_latency + sample) / 4;
+            }
+        }
+
+        if (wlr_surface_has_buffer(this->surface))
+        {
+            auto input = input_latency::take_input(this->surface);
+            if (input.received >= 0)
+            {
+                const int64_t now = wf::get_current_time_usec();
+                for (auto& [wo, _] : visibility)
+                {
+                    input_latency::note_commit(wo, input, now);
+                }
+            }
+        }
+
         if (!wlr_surface_has_buffer(this->surface) && this->visibility.empty())
         {
             send_frame_done(false);
@@ -121,9 +202,14 @@ wf::scene::wlr_surface_node_t::wlr_surface_node_t(wlr_surface *surface, bool aut
             apply_current_surface_state();
         }
 
-        for (auto& [wo, _] : visibility)
+        // A surface which is hidden everywhere, for example on another workspace or below a fullscreen
+        // view, does not need a repaint, even if its client commits without waiting for frame callbacks.
+        if (visible_instances > 0)
         {
-            wo->render->schedule_redraw();
+            for (auto& [wo, _] : visibility)
+            {
+                wo->render->schedule_redraw();
+            }
         }
     });
 
@@ -139,19 +225,110 @@ wf::scene::wlr_surface_node_t::wlr_surface_node_t(wlr_surface *surface, bool aut
         pending_visibility_delta.erase(ev->output);
     });
     wf::get_core().output_layout->connect(&on_output_remove);
+
+    on_output_content_shown.set_callback([&] (wf::output_content_shown_signal *ev)
+    {
+        if (!surface || !visibility.count(ev->output))
+        {
+            return;
+        }
+
+        if (ev->shown)
+        {
+            wlr_surface_send_enter(surface, ev->output->handle);
+            wlr_fractional_scale_v1_notify_scale(surface, ev->output->handle->scale);
+        } else
+        {
+            wlr_surface_send_leave(surface, ev->output->handle);
+        }
+    });
+    wf::get_core().connect(&on_output_content_shown);
 }
 
 void wf::scene::wlr_surface_node_t::apply_state(surface_state_t&& state)
 {
     const bool size_changed = current_state.size != state.size;
+    if (buffer_ready_source)
+    {
+        // A newer state replaces the one which is waiting, but its damage still has to be shown.
+        state.accumulated_damage |= waiting_state.accumulated_damage;
+        cancel_buffer_wait();
+    }
+
+    // When only the contents change, keep showing the old buffer until the client has finished rendering
+    // the new one, so that the GPU never has to wait for the client while repainting the output. Size
+    // changes are applied right away, because the geometry of the view may depend on them. Hidden surfaces
+    // are not repainted, so they do not need to wait either.
+    if ((visible_instances > 0) && !size_changed && current_state.current_buffer && state.current_buffer &&
+        (state.current_buffer != current_state.current_buffer))
+    {
+        const int fence = export_buffer_write_fence(state.current_buffer);
+        if ((fence >= 0) && !is_fence_signaled(fence))
+        {
+            waiting_state = std::move(state);
+            buffer_fence  = fence;
+            buffer_ready_source = wl_event_loop_add_fd(wf::get_core().ev_loop, fence, WL_EVENT_READABLE,
+                [] (int, uint32_t, void *data)
+            {
+                auto self  = static_cast<wlr_surface_node_t*>(data);
+                auto ready = std::move(self->waiting_state);
+                self->cancel_buffer_wait();
+                self->apply_state(std::move(ready));
+                return 0;
+            }, this);
+            return;
+        }
+
+        if (fence >= 0)
+        {
+            close(fence);
+        }
+    }
+
     this->current_state = std::move(state);
-    wf::scene::damage_node(this, current_state.accumulated_damage);
-    if (size_changed)
+    // Surfaces which show the same buffer, for example mirrors of a view, count it twice.
+    const int64_t texture_bytes = current_state.texture ?
+        int64_t(current_state.texture->width) * current_state.texture->height * 4 : 0;
+    wf::gpu_memory::set((uintptr_t)this, wf::gpu_memory::TYPE_CLIENT, texture_bytes, nullptr, this);
+    if (visible_instances > 0)
+    {
+        // Hidden surfaces are repainted when they become visible again, through the damage of whatever
+        // uncovered them.
+        wf::scene::damage_node(this, current_state.accumulated_damage);
+    }
+
+    bool opaque_changed = false;
+    if (surface && !pixman_region32_equal(last_opaque_region.to_pixman(), &surface->opaque_region))
+    {
+        last_opaque_region = wf::region_t{&surface->opaque_region};
+        opaque_changed     = true;
+    }
+
+    if (size_changed || opaque_changed)
     {
         scene::update(this->shared_from_this(), scene::update_flag::GEOMETRY);
     }
 }
 
+void wf::scene::wlr_surface_node_t::cancel_buffer_wait()
+{
+    if (buffer_ready_source)
+    {
+        wl_event_source_remove(buffer_ready_source);
+        close(buffer_fence);
+        buffer_ready_source = nullptr;
+        buffer_fence = -1;
+    }
+
+    waiting_state = surface_state_t{};
+}
+
+wf::scene::wlr_surface_node_t::~wlr_surface_node_t()
+{
+    cancel_buffer_wait();
+    wf::gpu_memory::set((uintptr_t)this, wf::gpu_memory::TYPE_CLIENT, 0, nullptr);
+}
+
 void wf::scene::wlr_surface_node_t::apply_current_surface_state()
 {
     surface_state_t state;
@@ -212,6 +389,11 @@ void wf::scene::wlr_surface_node_t::send_frame_done(bool delay_until_vblank)
 
     if (!delay_until_vblank || visibility.empty())
     {
+        if (!wl_list_empty(&surface->current.frame_callback_list))
+        {
+            frame_done_sent_at = wf::get_current_time_usec();
+        }
+
         timespec now;
         clock_gettime(CLOCK_MONOTONIC, &now);
         wlr_surface_send_frame_done(surface, &now);
@@ -227,14 +409,49 @@ void wf::scene::wlr_surface_node_t::send_frame_done(bool delay_until_vblank)
 class wf::scene::wlr_surface_node_t::wlr_surface_render_instance_t : public render_instance_t
 {
     std::shared_ptr<wlr_surface_node_t> self;
+    wf::wl_timer<false> frame_done_timer;
     wf::signal::connection_t<wf::frame_done_signal> on_frame_done = [=] (wf::frame_done_signal *ev)
     {
-        self->send_frame_done(false);
+        static wf::option_wrapper_t<bool> stagger_frame_callbacks{"workarounds/stagger_frame_callbacks"};
+
+        // Release the frame callbacks as late as possible while still leaving the client enough time to
+        // commit before the repaint starts, so that fast clients show fresher content and do not compete
+        // with the slow ones for the CPU right after vblank.
+        const int64_t slack_usec = ev->repaint_delay * 1000 - self->commit_latency - FRAME_DONE_MARGIN;
+        if (!stagger_frame_callbacks || (slack_usec < 1000))
+        {
+            frame_done_timer.disconnect();
+            self->send_frame_done(false);
+            return;
+        }
+
+        if (!frame_done_timer.is_connected())
+        {
+            frame_done_timer.set_timeout(slack_usec / 1000, [=] ()
+            {
+                self->send_frame_done(false);
+            });
+        }
     };
 
     wf::output_t *visible_on;
     damage_callback push_damage;
+    OpenGL::texture_batch_t batch;
     wf::region_t last_visibility;
+    // Whether last_visibility has been computed at least once for this instance.
+    bool visibility_known = false;
+    // Whether the instance is counted in visible_instances of the node. Until visibility is known, for
+    // example for instances used to render views to auxiliary buffers, the surface may be visible.
+    bool counted_visible = true;
+
+    void set_counted_visible(bool visible)
+    {
+        if (visible != counted_visible)
+        {
+            counted_visible = visible;
+            self->visible_instances += visible ? 1 : -1;
+        }
+    }
 
     wf::signal::connection_t<node_damage_signal> on_surface_damage =
         [=] (node_damage_signal *data)
@@ -276,10 +493,12 @@ class wf::scene::wlr_surface_node_t::wlr_surface_render_instance_t : public rend
         this->push_damage = push_damage;
         this->visible_on  = visible_on;
         self->connect(&on_surface_damage);
+        self->visible_instances++;
     }
 
     ~wlr_surface_render_instance_t()
     {
+        set_counted_visible(false);
         if (visible_on)
         {
             self->handle_leave(visible_on);
@@ -289,7 +508,24 @@ class wf::scene::wlr_surface_node_t::wlr_surface_render_instance_t : public rend
     void schedule_instructions(std::vector<render_instruction_t>& instructions,
         const wf::render_target_t& target, wf::region_t& damage) override
     {
-        wf::region_t our_damage = damage & self->get_bounding_box();
+        static wf::option_wrapper_t<bool> use_opaque_optimizations{
+            "workarounds/enable_opaque_region_damage_optimizations"
+        };
+
+        if (!self->current_state.current_buffer)
+        {
+            // Nothing to draw, for example a subsurface used only to position its own subsurfaces.
+            return;
+        }
+
+        if (use_opaque_optimizations && visibility_known && last_visibility.empty())
+        {
+            // The surface is fully covered by opaque surfaces above it or is outside of the output, which
+            // does not change until visibility is recomputed on the next geometry update.
+            return;
+        }
+
+        wf::region_t our_damage = clip_instruction_damage(damage, self->get_bounding_box());
         if (!our_damage.empty())
         {
             instructions.push_back(render_instruction_t{
@@ -306,7 +542,65 @@ class wf::scene::wlr_surface_node_t::wlr_surface_render_instance_t : public rend
         }
     }
 
+    /** The transform which applies the buffer transform of the surface to its geometry. */
+    glm::mat4 get_buffer_transform(wf::geometry_t geometry)
+    {
+        if (!self->current_state.transform)
+        {
+            return glm::mat4(1.0f);
+        }
+
+        const double cx     = geometry.x + geometry.width / 2.0;
+        const double cy     = geometry.y + geometry.height / 2.0;
+        const double aspect = geometry.width * 1.0 / geometry.height;
+
+        // Center the surface in the coordinate system, rotate (preserving aspect ration)
+        // according to transform, go back
+        return glm::translate(glm::mat4(1.0f), glm::vec3(cx, cy, 0.0f)) *
+               glm::scale(glm::mat4(1.0f), glm::vec3(aspect, 1.0f, 1.0f)) *
+               get_output_matrix_from_transform(self->current_state.transform) *
+               glm::scale(glm::mat4(1.0f), glm::vec3(1.0 / aspect, 1.0f, 1.0f)) *
+               glm::translate(glm::mat4(1.0f), glm::vec3(-cx, -cy, 0.0f));
+    }
+
     void render(const wf::render_target_t& target, const wf::region_t& region) override
+    {
+        render_with_alpha(target, region, 1.0f);
+    }
+
+    bool supports_direct_render() override
+    {
+        return true;
+    }
+
+    /** Whether the buffer has exactly the size of the surface on the target framebuffer. */
+    bool is_pixel_exact(const wf::render_target_t& target, wf::geometry_t geometry) const
+    {
+        auto& state = self->current_state;
+        if (state.transform != WL_OUTPUT_TRANSFORM_NORMAL)
+        {
+            return false;
+        }
+
+        double width  = state.texture->width;
+        double height = state.texture->height;
+        if (state.src_viewport)
+        {
+            width  = state.src_viewport->width;
+            height = state.src_viewport->height;
+        }
+
+        auto box = target.framebuffer_box_from_geometry_box(geometry);
+        if (target.wl_transform & WL_OUTPUT_TRANSFORM_90)
+        {
+            std::swap(box.width, box.height);
+        }
+
+        return (std::abs(width - box.width) < 0.001) && (std::abs(height - box.height) < 0.001);
+    }
+
+    void render_with_alpha(const wf::render_target_t& target, const wf::region_t& region,
+        float alpha) override
     {
         if (!self->current_state.current_buffer)
         {
@@ -317,32 +611,38 @@ class wf::scene::wlr_surface_node_t::wlr_surface_render_instance_t : public rend
         wf::texture_t texture{self->current_state.texture, self->current_state.src_viewport};
 
         glm::mat4 transform = target.get_orthographic_projection();
-
         if (self->current_state.transform)
         {
-            const double cx     = geometry.x + geometry.width / 2.0;
-            const double cy     = geometry.y + geometry.height / 2.0;
-            const double aspect = geometry.width * 1.0 / geometry.height;
-
-            // Center the surface in the coordinate system, rotate (preserving aspect ration)
-            // according to transform, go back
-            glm::mat4 surface_transform =
-                glm::translate(glm::mat4(1.0f), glm::vec3(cx, cy, 0.0f)) *
-                glm::scale(glm::mat4(1.0f), glm::vec3(aspect, 1.0f, 1.0f)) *
-                get_output_matrix_from_transform(self->current_state.transform) *
-                glm::scale(glm::mat4(1.0f), glm::vec3(1.0 / aspect, 1.0f, 1.0f)) *
-                glm::translate(glm::mat4(1.0f), glm::vec3(-cx, -cy, 0.0f));
-            transform = transform * surface_transform;
+            transform = transform * get_buffer_transform(geometry);
         }
 
-        OpenGL::render_begin(target);
-        OpenGL::render_transformed_texture(texture, geometry, transform,
-            glm::vec4(1.f), OpenGL::RENDER_FLAG_CACHED);
-
         // use GL_NEAREST for integer scale.
         // GL_NEAREST makes scaled text blocky instead of blurry, which looks better
-        // but only for integer scale.
-        if (target.scale - floor(target.scale) < 0.001)
+        // but only for integer scale. Clients which render at the fractional scale of the output
+        // are also drawn pixel for pixel, without resampling.
+        const bool use_nearest = (target.scale - floor(target.scale) < 0.001) ||
+            is_pixel_exact(target, geometry);
+
+        OpenGL::render_begin(target);
+        if (!self->current_state.transform)
+        {
+            // Without a buffer transform, the damage and the surface geometry are in the same
+            // coordinate system, so all damaged rectangles can be drawn in a single batch.
+            batch.add(texture, geometry, region, transform, glm::vec4{1.0f, 1.0f, 1.0f, alpha});
+            if (use_nearest)
+            {
+                GL_CALL(glBindTexture(texture.target, texture.tex_id));
+                GL_CALL(glTexParameteri(texture.target, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
+            }
+
+            batch.flush();
+            OpenGL::render_end();
+            return;
+        }
+
+        OpenGL::render_transformed_texture(texture, geometry, transform,
+            glm::vec4{1.0f, 1.0f, 1.0f, alpha}, OpenGL::RENDER_FLAG_CACHED);
+        if (use_nearest)
         {
             GL_CALL(glTexParameteri(texture.target, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
         }
@@ -357,6 +657,33 @@ class wf::scene::wlr_surface_node_t::wlr_surface_render_instance_t : public rend
         OpenGL::render_end();
     }
 
+    void render_transformed(const wf::render_target_t& target, const wf::region_t& region,
+        const glm::mat4& transform, float alpha) override
+    {
+        if (!self->current_state.current_buffer)
+        {
+            return;
+        }
+
+        wf::geometry_t geometry = self->get_bounding_box();
+        wf::texture_t texture{self->current_state.texture, self->current_state.src_viewport};
+        glm::mat4 matrix = target.get_orthographic_projection() * transform * get_buffer_transform(geometry);
+
+        OpenGL::render_begin(target);
+        OpenGL::render_transformed_texture(texture, geometry, matrix,
+            glm::vec4{1.0f, 1.0f, 1.0f, alpha}, OpenGL::RENDER_FLAG_CACHED);
+        // The surface is usually scaled, see the GL_NEAREST case in render_with_alpha().
+        GL_CALL(glTexParameteri(texture.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+        for (const auto& rect : region)
+        {
+            target.logic_scissor(wlr_box_from_pixman_box(rect));
+            OpenGL::draw_cached();
+        }
+
+        OpenGL::clear_cached();
+        OpenGL::render_end();
+    }
+
     void presentation_feedback(wf::output_t *output) override
     {
         if (self->surface)
@@ -375,6 +702,7 @@ class wf::scene::wlr_surface_node_t::wlr_surface_render_instance_t : public rend
 
         if (self->get_bounding_box() != output->get_relative_geometry())
         {
+            output->render->report_scanout_blocker(SCANOUT_BLOCKER_SURFACE_GEOMETRY);
             return direct_scanout::OCCLUSION;
         }
 
@@ -383,6 +711,7 @@ class wf::scene::wlr_surface_node_t::wlr_surface_render_instance_t : public rend
         if ((wlr_surf->current.scale != output->handle->scale) ||
             (wlr_surf->current.transform != output->handle->transform))
         {
+            output->render->report_scanout_blocker(SCANOUT_BLOCKER_SURFACE_TRANSFORM);
             return direct_scanout::OCCLUSION;
         }
 
@@ -391,27 +720,88 @@ class wf::scene::wlr_surface_node_t::wlr_surface_render_instance_t : public rend
         non_opaque ^= wf::region_t{&wlr_surf->opaque_region};
         if (!non_opaque.empty())
         {
+            output->render->report_scanout_blocker(SCANOUT_BLOCKER_SURFACE_OPACITY);
             return direct_scanout::OCCLUSION;
         }
 
         wlr_presentation_surface_scanned_out_on_output(
             wf::get_core().protocols.presentation, wlr_surf, output->handle);
-        wlr_output_attach_buffer(output->handle, &wlr_surf->buffer->base);
 
-        if (wlr_output_commit(output->handle))
+        wlr_output_state state;
+        wlr_output_state_init(&state);
+        wlr_output_state_set_buffer(&state, &wlr_surf->buffer->base);
+        output->render->plan_scanout_state(state);
+        if (output->render->is_tearing_allowed() &&
+            (wlr_tearing_control_manager_v1_surface_hint_from_surface(
+                wf::get_core().protocols.tearing_control, wlr_surf) ==
+             WP_TEARING_CONTROL_V1_PRESENTATION_HINT_ASYNC))
         {
-            return direct_scanout::SUCCESS;
-        } else
+            state.tearing_page_flip = true;
+            if (!wlr_output_test_state(output->handle, &state))
+            {
+                // Not all drivers support async page flips, fall back to a regular page flip.
+                state.tearing_page_flip = false;
+            }
+        }
+
+        const bool committed = wlr_output_commit_state(output->handle, &state);
+        wlr_output_state_finish(&state);
+        if (!committed)
+        {
+            output->render->report_scanout_blocker(SCANOUT_BLOCKER_BUFFER_REJECTED);
+            return direct_scanout::OCCLUSION;
+        }
+
+        return direct_scanout::SUCCESS;
+    }
+
+    direct_scanout try_output_layers(wf::output_t *output, output_layers_plan_t& plan) override
+    {
+        auto buffer = self->current_state.current_buffer;
+        if (!buffer)
+        {
+            return direct_scanout::SKIP;
+        }
+
+        auto box = self->get_bounding_box() + plan.offset;
+        auto output_box = output->get_relative_geometry();
+        if (!(box & output_box))
+        {
+            return direct_scanout::SKIP;
+        }
+
+        // Keep things simple: the buffer must be fully visible on the output, and neither the buffer nor
+        // the output may be rotated.
+        if ((plan.candidates.size() >= plan.max_layers) ||
+            (wf::geometry_intersection(box, output_box) != box) ||
+            (self->current_state.transform != WL_OUTPUT_TRANSFORM_NORMAL) ||
+            (output->handle->transform != WL_OUTPUT_TRANSFORM_NORMAL))
         {
             return direct_scanout::OCCLUSION;
         }
+
+        output_layer_candidate_t candidate;
+        candidate.instance = this;
+        candidate.buffer   = buffer;
+        candidate.src_box  = self->current_state.src_viewport.value_or(
+            wlr_fbox{0, 0, (double)buffer->width, (double)buffer->height});
+        candidate.dst_box = box * output->handle->scale;
+        plan.candidates.push_back(candidate);
+        return direct_scanout::SUCCESS;
+    }
+
+    node_t *get_node() const override
+    {
+        return self.get();
     }
 
     void compute_visibility(wf::output_t *output, wf::region_t& visible) override
     {
         auto our_box = self->get_bounding_box();
         on_frame_done.disconnect();
-        last_visibility = visible & our_box;
+        last_visibility  = visible & our_box;
+        visibility_known = true;
+        set_counted_visible(!last_visibility.empty());
 
         static wf::option_wrapper_t<bool> use_opaque_optimizations{
             "workarounds/enable_opaque_region_damage_optimizations"
@@ -479,14 +869,16 @@ void wf::scene::wlr_surface_node_t::update_pending_outputs()
 {
     for (auto& [wo, delta] : pending_visibility_delta)
     {
-        if ((visibility[wo] == 0) && (delta > 0) && surface)
+        // Outputs which do not show their contents have been left already, see on_output_content_shown.
+        const bool shown = wo->render->is_content_shown();
+        if ((visibility[wo] == 0) && (delta > 0) && surface && shown)
         {
             wlr_surface_send_enter(surface, wo->handle);
             wlr_fractional_scale_v1_notify_scale(surface, wo->handle->scale);
         }
 
         visibility[wo] += delta;
-        if ((visibility[wo] == 0) && (delta < 0) && surface)
+        if ((visibility[wo] == 0) && (delta < 0) && surface && shown)
         {
             wlr_surface_send_leave(surface, wo->handle);
         }
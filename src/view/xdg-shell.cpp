@@ -90,27 +90,9 @@ wayfire_xdg_popup::wayfire_xdg_popup(wlr_xdg_popup *popup) : wf::view_interface_
         };
     }
 
-    on_surface_commit.set_callback([&] (void*) { commit(); });
-
     LOGI("New xdg popup");
     this->main_surface = std::make_shared<wf::scene::wlr_surface_node_t>(popup->base->surface, true);
 
-    on_map.set_callback([&] (void*) { map(); });
-    on_unmap.set_callback([&] (void*) { unmap(); });
-    on_destroy.set_callback([&] (void*) { destroy(); });
-    on_new_popup.set_callback([&] (void *data)
-    {
-        create_xdg_popup((wlr_xdg_popup*)data);
-    });
-    on_ping_timeout.set_callback([&] (void*)
-    {
-        wf::view_implementation::emit_ping_timeout_signal(self());
-    });
-    on_reposition.set_callback([&] (void*)
-    {
-        unconstrain();
-    });
-
     on_map.connect(&popup->base->surface->events.map);
     on_unmap.connect(&popup->base->surface->events.unmap);
     on_destroy.connect(&popup->base->events.destroy);
@@ -197,6 +179,16 @@ void wayfire_xdg_popup::commit()
     update_position();
 }
 
+void wayfire_xdg_popup::handle_new_popup(wlr_xdg_popup *popup)
+{
+    create_xdg_popup(popup);
+}
+
+void wayfire_xdg_popup::handle_ping_timeout()
+{
+    wf::view_implementation::emit_ping_timeout_signal(self());
+}
+
 void wayfire_xdg_popup::update_position()
 {
     if (!popup_parent->is_mapped() || !popup)
@@ -15,9 +15,6 @@ class wayfire_xdg_popup_node;
 class wayfire_xdg_popup : public wf::view_interface_t
 {
   protected:
-    wf::wl_listener_wrapper on_destroy, on_new_popup,
-        on_map, on_unmap, on_ping_timeout, on_reposition;
-
     wf::signal::connection_t<wf::view_geometry_changed_signal> parent_geometry_changed;
     wf::signal::connection_t<wf::view_title_changed_signal> parent_title_changed;
     wf::signal::connection_t<wf::view_app_id_changed_signal> parent_app_id_changed;
@@ -66,7 +63,18 @@ class wayfire_xdg_popup : public wf::view_interface_t
     /** The output geometry of the view */
     wf::geometry_t geometry{100, 100, 0, 0};
 
-    wf::wl_listener_wrapper on_surface_commit;
+    void handle_new_popup(wlr_xdg_popup *popup);
+    void handle_ping_timeout();
+
+    // Popups come and go often, so their listeners are the allocation-free kind.
+    wf::wl_member_listener_t<&wayfire_xdg_popup::destroy> on_destroy{this};
+    wf::wl_member_listener_t<&wayfire_xdg_popup::handle_new_popup> on_new_popup{this};
+    wf::wl_member_listener_t<&wayfire_xdg_popup::map> on_map{this};
+    wf::wl_member_listener_t<&wayfire_xdg_popup::unmap> on_unmap{this};
+    wf::wl_member_listener_t<&wayfire_xdg_popup::handle_ping_timeout> on_ping_timeout{this};
+    wf::wl_member_listener_t<&wayfire_xdg_popup::unconstrain> on_reposition{this};
+    wf::wl_member_listener_t<&wayfire_xdg_popup::commit> on_surface_commit{this};
+
     std::shared_ptr<wf::scene::wlr_surface_node_t> main_surface;
     std::shared_ptr<wayfire_xdg_popup_node> surface_root_node;
 
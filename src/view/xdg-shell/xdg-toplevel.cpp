@@ -36,6 +36,11 @@ void wf::xdg_toplevel_t::request_native_size()
     wlr_xdg_toplevel_set_size(toplevel, 0, 0);
 }
 
+std::string wf::xdg_toplevel_t::get_app_id() const
+{
+    return toplevel ? nonull(toplevel->app_id) : "nil";
+}
+
 void wf::xdg_toplevel_t::commit()
 {
     this->pending_ready = true;
@@ -3,6 +3,8 @@
 #include "wayfire/core.hpp"
 #include "../core/core-impl.hpp"
 #include "../core/seat/cursor.hpp"
+#include "../core/startup-profile.hpp"
+#include <wayfire/option-wrapper.hpp>
 #include <wayfire/view.hpp>
 #include <wayfire/nonstd/tracking-allocator.hpp>
 
@@ -239,6 +241,7 @@ void wf::init_xwayland()
 
     on_ready.set_callback([&] (void *data)
     {
+        wf::startup_profile::mark("Xwayland ready");
         if (!wf::xw::load_basic_atoms(xwayland_handle->display_name))
         {
             LOGE("Failed to load Xwayland atoms.");
@@ -251,8 +254,14 @@ void wf::init_xwayland()
         xwayland_update_default_cursor();
     });
 
-    xwayland_handle = wlr_xwayland_create(wf::get_core().display,
-        wf::get_core_impl().compositor, false);
+    // In lazy mode, wlroots only creates the X11 display sockets, and starts the server when the first client
+    // connects to them.
+    wf::option_wrapper_t<bool> xwayland_lazy{"core/xwayland_lazy"};
+    {
+        wf::startup_profile::scope_t profile{"Xwayland spawn"};
+        xwayland_handle = wlr_xwayland_create(wf::get_core().display,
+            wf::get_core_impl().compositor, xwayland_lazy);
+    }
 
     if (xwayland_handle)
     {
@@ -312,7 +321,8 @@ int wf::xwayland_get_pid()
 {
 #if WF_HAS_XWAYLAND
 
-    return xwayland_handle ? xwayland_handle->server->pid : -1;
+    // The pid is 0 until the server has been started.
+    return (xwayland_handle && (xwayland_handle->server->pid > 0)) ? xwayland_handle->server->pid : -1;
 #else
 
     return -1;
@@ -60,10 +60,41 @@ class wayfire_xwayland_view : public wf::toplevel_view_interface_t, public wayfi
             return;
         }
 
+        // Some clients send many configure requests in a row, for example while they resize themselves.
+        // Only the last one matters, so requests are processed once per iteration of the event loop.
+        toplevel->count_configure_request(pending_configure_request.has_value());
+        pending_configure_request = wf::dimensions_t{ev->width, ev->height};
+        idle_configure_request.run_once([=] ()
+        {
+            handle_pending_configure_request();
+        });
+    }
+
+    /** The size of the last configure request of the client which has not been processed yet. */
+    std::optional<wf::dimensions_t> pending_configure_request;
+    wf::wl_idle_call idle_configure_request;
+
+    void handle_pending_configure_request()
+    {
+        auto size = pending_configure_request.value();
+        pending_configure_request.reset();
+        if (!xw || !is_mapped())
+        {
+            return;
+        }
+
+        wf::point_t output_origin = {0, 0};
+        if (get_output())
+        {
+            output_origin = wf::origin(get_output()->get_layout_geometry());
+        }
+
         /* Use old x/y values */
-        ev->x = get_pending_geometry().x + output_origin.x;
-        ev->y = get_pending_geometry().y + output_origin.y;
-        configure_request(wlr_box{ev->x, ev->y, ev->width, ev->height});
+        configure_request(wlr_box{
+            get_pending_geometry().x + output_origin.x,
+            get_pending_geometry().y + output_origin.y,
+            size.width, size.height,
+        });
     }
 
     void update_decorated()
@@ -157,6 +188,13 @@ class wayfire_xwayland_view : public wf::toplevel_view_interface_t, public wayfi
         }
 
         configure_geometry = wf::expand_geometry_by_margins(configure_geometry, toplevel->pending().margins);
+        if (configure_geometry == get_pending_geometry())
+        {
+            // Nothing changes, but the client still expects a configure in reply to its request.
+            toplevel->reconfigure_xwayland_surface(true);
+            return;
+        }
+
         set_geometry(configure_geometry);
     }
 
@@ -293,6 +331,8 @@ class wayfire_xwayland_view : public wf::toplevel_view_interface_t, public wayfi
         on_request_maximize.disconnect();
         on_request_minimize.disconnect();
         on_request_fullscreen.disconnect();
+        idle_configure_request.disconnect();
+        pending_configure_request.reset();
 
         wayfire_xwayland_view_internal_base::destroy();
     }
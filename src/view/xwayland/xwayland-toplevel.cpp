@@ -80,6 +80,11 @@ void wf::xw::xwayland_toplevel_t::request_native_size()
     }
 }
 
+std::string wf::xw::xwayland_toplevel_t::get_app_id() const
+{
+    return xw ? nonull(xw->class_t) : "nil";
+}
+
 void wf::xw::xwayland_toplevel_t::commit()
 {
     this->pending_ready = true;
@@ -137,7 +142,7 @@ void wf::xw::xwayland_toplevel_t::commit()
     }
 }
 
-void wf::xw::xwayland_toplevel_t::reconfigure_xwayland_surface()
+void wf::xw::xwayland_toplevel_t::reconfigure_xwayland_surface(bool force)
 {
     if (!xw)
     {
@@ -155,8 +160,46 @@ void wf::xw::xwayland_toplevel_t::reconfigure_xwayland_surface()
         return;
     }
 
+    update_configure_stats();
+    const wf::geometry_t current_xw = {xw->x, xw->y, xw->width, xw->height};
+    if (!force && (last_configure == configure) && (current_xw == configure))
+    {
+        // Every configure generates X11 traffic and wakes up the client, which may redraw in response.
+        configure_stats.skipped++;
+        return;
+    }
+
     LOGC(XWL, "Configuring xwayland surface ", nonull(xw->title), " ", nonull(xw->class_t), " ", configure);
     wlr_xwayland_surface_configure(xw, configure.x, configure.y, configure.width, configure.height);
+    last_configure = configure;
+    configure_stats.sent++;
+}
+
+void wf::xw::xwayland_toplevel_t::count_configure_request(bool coalesced)
+{
+    update_configure_stats();
+    configure_stats.requests++;
+    configure_stats.coalesced += coalesced;
+}
+
+void wf::xw::xwayland_toplevel_t::update_configure_stats()
+{
+    const int64_t now = wf::get_current_time();
+    if (now - configure_stats.window_start < 1000)
+    {
+        return;
+    }
+
+    auto& stats = configure_stats;
+    if (stats.requests || stats.sent || stats.skipped)
+    {
+        LOGC(XWL, "Configure rate of xwayland surface ", xw ? nonull(xw->title) : "nil", " ", get_app_id(),
+            ": ", stats.requests, " requests (", stats.coalesced, " coalesced), ",
+            stats.sent, " configures sent (", stats.skipped, " skipped) in ", now - stats.window_start, "ms");
+    }
+
+    stats = configure_stats_t{};
+    stats.window_start = now;
 }
 
 void wf::xw::xwayland_toplevel_t::apply()
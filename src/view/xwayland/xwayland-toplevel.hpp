@@ -4,6 +4,7 @@
 #include "wayfire/geometry.hpp"
 #include "wayfire/util.hpp"
 #include <memory>
+#include <optional>
 #include <wayfire/toplevel.hpp>
 #include <wayfire/nonstd/wlroots-full.hpp>
 #include <wayfire/unstable/wlr-surface-node.hpp>
@@ -28,6 +29,7 @@ class xwayland_toplevel_t : public wf::toplevel_t, public std::enable_shared_fro
     xwayland_toplevel_t(wlr_xwayland_surface *xw);
     void commit() override;
     void apply() override;
+    std::string get_app_id() const override;
 
     wf::dimensions_t get_min_size() override;
     wf::dimensions_t get_max_size() override;
@@ -39,6 +41,22 @@ class xwayland_toplevel_t : public wf::toplevel_t, public std::enable_shared_fro
 
     void request_native_size();
 
+    /**
+     * Send the pending geometry to the X11 client.
+     *
+     * A configure which is the same as the last one sent is skipped, unless @force is set, for example
+     * because the client asked for a configure and is waiting for the reply.
+     */
+    void reconfigure_xwayland_surface(bool force = false);
+
+    /**
+     * Account a configure request of the client, for the configure statistics which are logged in the XWL
+     * debug category.
+     *
+     * @param coalesced Whether the request was merged with an earlier request which was not processed yet.
+     */
+    void count_configure_request(bool coalesced);
+
   private:
     std::shared_ptr<wf::scene::wlr_surface_node_t> main_surface;
     scene::surface_state_t pending_state;
@@ -54,7 +72,22 @@ class xwayland_toplevel_t : public wf::toplevel_t, public std::enable_shared_fro
     wf::point_t output_offset = {0, 0};
     void handle_surface_commit();
 
-    void reconfigure_xwayland_surface();
+    /** The last configure sent to the client, in global coordinates. */
+    std::optional<wf::geometry_t> last_configure;
+
+    /** Configure traffic in the current one-second window, see count_configure_request(). */
+    struct configure_stats_t
+    {
+        int64_t window_start = 0;
+        uint32_t requests    = 0;
+        uint32_t coalesced   = 0;
+        uint32_t sent        = 0;
+        uint32_t skipped     = 0;
+    };
+
+    configure_stats_t configure_stats;
+    void update_configure_stats();
+
     void emit_ready();
     bool pending_ready = false;
 };
@@ -111,6 +111,13 @@ class wayfire_unmanaged_xwayland_view : public wayfire_xwayland_view_internal_ba
             new_position = new_position - wf::origin(wo->get_layout_geometry());
         }
 
+        if ((new_position == surface_root_node->get_offset()) && (wo == get_output()) &&
+            (last_bounding_box == get_bounding_box()))
+        {
+            // Happens often, for example for every configure of a menu which is only shown.
+            return;
+        }
+
         surface_root_node->set_offset(new_position);
         if (wo != get_output())
         {
@@ -131,16 +138,23 @@ class wayfire_unmanaged_xwayland_view : public wayfire_xwayland_view_internal_ba
 
     std::shared_ptr<wf::xwayland_unmanaged_view_node_t> surface_root_node;
 
+    /**
+     * The surface node of the view from its last mapping.
+     *
+     * Toolkits like Java's reuse their menu and tooltip windows, mapping and unmapping them many times, so
+     * the node is kept and reused as long as the view is mapped with the same wlr_surface again.
+     */
+    std::shared_ptr<wf::scene::wlr_surface_node_t> unmapped_surface_node;
+
   public:
     wayfire_unmanaged_xwayland_view(wlr_xwayland_surface *xww) : wayfire_xwayland_view_internal_base(xww)
     {
-        LOGE("new unmanaged xwayland surface ", xw->title, " class: ", xw->class_t,
-            " instance: ", xw->instance);
+        LOGC(XWL, "new unmanaged xwayland surface ", nonull(xw->title), " class: ", nonull(xw->class_t),
+            " instance: ", nonull(xw->instance));
 
         role = wf::VIEW_ROLE_UNMANAGED;
         on_set_geometry.set_callback([&] (void*) { update_geometry_from_xsurface(); });
         on_set_geometry.connect(&xw->events.set_geometry);
-        _initialize();
     }
 
     template<class ConcreteUnmanagedView>
@@ -156,6 +170,13 @@ class wayfire_unmanaged_xwayland_view : public wayfire_xwayland_view_internal_ba
     void handle_map_request(wlr_surface *surface) override
     {
         LOGC(XWL, "Mapping unmanaged xwayland surface ", self());
+        if (unmapped_surface_node && (unmapped_surface_node->get_surface() == xw->surface))
+        {
+            // The node has followed the commits of the surface while it was unmapped, so it is up to date.
+            main_surface = std::move(unmapped_surface_node);
+        }
+
+        unmapped_surface_node.reset();
         do_map(surface, true, false);
 
         update_geometry_from_xsurface();
@@ -183,11 +204,13 @@ class wayfire_unmanaged_xwayland_view : public wayfire_xwayland_view_internal_ba
         LOGC(XWL, "Unmapping unmanaged xwayland surface ", self());
         emit_view_pre_unmap();
         on_surface_commit.disconnect();
+        unmapped_surface_node = main_surface;
         do_unmap();
     }
 
     void destroy() override
     {
+        unmapped_surface_node.reset();
         on_set_geometry.disconnect();
         wayfire_xwayland_view_internal_base::destroy();
     }
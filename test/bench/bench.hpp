@@ -0,0 +1,61 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+/**
+ * A minimal harness for microbenchmarks.
+ *
+ * Each benchmark is run repeatedly until it has taken at least MIN_DURATION, and the result is printed as a
+ * single JSON object per line, so that the output can be collected and compared across versions:
+ *
+ * {"benchmark": "region/union", "size": 16, "iterations": 65536, "ns_per_op": 123.4}
+ */
+namespace wf
+{
+namespace bench
+{
+/** Prevent the compiler from optimizing away the computation of @value. */
+template<class T>
+inline void keep(T&& value)
+{
+    asm volatile ("" : : "g"(&value) : "memory");
+}
+
+/**
+ * Run @func repeatedly and print the average time of a single call.
+ *
+ * @param name The name of the benchmark, as "group/case".
+ * @param size The size of the data set the benchmark operates on.
+ */
+template<class Func>
+void run(const std::string& name, int64_t size, Func func)
+{
+    using clock = std::chrono::steady_clock;
+    constexpr auto MIN_DURATION = std::chrono::milliseconds(100);
+
+    int64_t iterations = 1;
+    while (true)
+    {
+        auto start = clock::now();
+        for (int64_t i = 0; i < iterations; i++)
+        {
+            func();
+        }
+
+        auto elapsed = clock::now() - start;
+        if ((elapsed >= MIN_DURATION) || (iterations >= (int64_t(1) << 30)))
+        {
+            double ns = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+            std::cout << "{\"benchmark\": \"" << name << "\", \"size\": " << size <<
+                ", \"iterations\": " << iterations << ", \"ns_per_op\": " << ns << "}" << std::endl;
+            return;
+        }
+
+        iterations *= 2;
+    }
+}
+}
+}
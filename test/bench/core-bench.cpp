@@ -0,0 +1,314 @@
+#include "bench.hpp"
+#include "../txn/transaction-test-object.hpp"
+#include "../../src/core/txn/transaction-manager-impl.hpp"
+
+#include <wayfire/region.hpp>
+#include <wayfire/opengl.hpp>
+#include <wayfire/object.hpp>
+#include <wayfire/signal-provider.hpp>
+#include <wayfire/txn/transaction.hpp>
+#include <wayfire/lexer/lexer.hpp>
+#include <wayfire/condition/condition.hpp>
+#include <wayfire/condition/access_interface.hpp>
+#include <wayfire/parser/condition_parser.hpp>
+#include <wayland-server-core.h>
+#include <vector>
+
+/**
+ * Microbenchmarks for the core data structures on the hot paths of the compositor.
+ * Run with `meson test --benchmark` after configuring with -Dbenchmarks=true.
+ */
+static const std::vector<int64_t> SIZES = {1, 4, 16, 64, 256};
+
+static wf::region_t make_region(int64_t rects)
+{
+    // A grid of non-overlapping rectangles, similar to the damage of many small surfaces.
+    wf::region_t region;
+    for (int64_t i = 0; i < rects; i++)
+    {
+        region |= wlr_box{int(i % 16) * 120, int(i / 16) * 120, 100, 100};
+    }
+
+    return region;
+}
+
+static void bench_region()
+{
+    for (auto size : SIZES)
+    {
+        auto region = make_region(size);
+        auto other  = make_region(size) + wf::point_t{50, 50};
+
+        wf::bench::run("region/union", size, [&] { wf::bench::keep(region | other); });
+        wf::bench::run("region/subtract", size, [&] { wf::bench::keep(region ^ other); });
+        wf::bench::run("region/intersect-box", size, [&] ()
+        {
+            wf::bench::keep(region & wlr_box{0, 0, 960, 540});
+        });
+        wf::bench::run("region/iterate", size, [&] ()
+        {
+            int area = 0;
+            for (auto& box : region)
+            {
+                area += (box.x2 - box.x1) * (box.y2 - box.y1);
+            }
+
+            wf::bench::keep(area);
+        });
+    }
+}
+
+static void bench_render_target()
+{
+    wf::render_target_t target;
+    target.viewport_width  = 3840;
+    target.viewport_height = 2160;
+    target.geometry     = {0, 0, 1920, 1080};
+    target.scale        = 2;
+    target.wl_transform = WL_OUTPUT_TRANSFORM_90;
+    target.subbuffer    = wf::geometry_t{0, 0, 1920, 1080};
+
+    wf::bench::run("render-target/projection", 1, [&] ()
+    {
+        wf::bench::keep(target.get_orthographic_projection());
+    });
+    for (auto size : SIZES)
+    {
+        auto region = make_region(size);
+        wf::bench::run("render-target/project-region", size, [&] ()
+        {
+            wf::bench::keep(target.framebuffer_region_from_geometry_region(region));
+        });
+    }
+}
+
+struct bench_signal
+{
+    int value = 0;
+};
+
+struct unused_signal
+{};
+
+class bench_object_t : public wf::object_base_t
+{};
+
+static void bench_signals()
+{
+    for (auto size : SIZES)
+    {
+        wf::signal::provider_t provider;
+        std::vector<std::unique_ptr<wf::signal::connection_t<bench_signal>>> connections;
+        for (int64_t i = 0; i < size; i++)
+        {
+            connections.push_back(std::make_unique<wf::signal::connection_t<bench_signal>>(
+                [] (bench_signal *ev) { ev->value++; }));
+            provider.connect(connections.back().get());
+        }
+
+        wf::bench::run("signal/emit", size, [&] ()
+        {
+            bench_signal ev;
+            provider.emit(&ev);
+            wf::bench::keep(ev.value);
+        });
+        wf::bench::run("signal/emit-no-listeners", size, [&] ()
+        {
+            unused_signal ev;
+            provider.emit(&ev);
+        });
+    }
+}
+
+template<int N>
+struct bench_data_t : public wf::custom_data_t
+{};
+
+template<int... N>
+static void store_bench_data(bench_object_t& object, std::integer_sequence<int, N...>)
+{
+    (object.store_data(std::make_unique<bench_data_t<N>>()), ...);
+}
+
+static void bench_object_data()
+{
+    bench_object_t object;
+    store_bench_data(object, std::make_integer_sequence<int, 16>{});
+    wf::bench::run("object/get_data", 16, [&] { wf::bench::keep(object.get_data<bench_data_t<7>>()); });
+    wf::bench::run("object/get_data-missing", 16, [&] ()
+    {
+        wf::bench::keep(object.get_data<bench_data_t<100>>());
+    });
+    wf::bench::run("object/get_data-by-name", 16, [&] ()
+    {
+        wf::bench::keep(object.get_data<bench_data_t<7>>(typeid(bench_data_t<7>).name()));
+    });
+}
+
+static void bench_transactions()
+{
+    for (auto size : SIZES)
+    {
+        std::vector<std::shared_ptr<txn_test_object_t>> objects;
+        for (int64_t i = 0; i < size; i++)
+        {
+            objects.push_back(std::make_shared<txn_test_object_t>(true));
+        }
+
+        wf::txn::transaction_manager_t::impl manager;
+        wf::bench::run("txn/schedule", size, [&] ()
+        {
+            auto tx = std::make_unique<wf::txn::transaction_t>(0, [] (auto, auto) {});
+            for (auto& object : objects)
+            {
+                tx->add_object(object);
+            }
+
+            manager.schedule_transaction(std::move(tx));
+            wl_event_loop_dispatch_idle(wf::wl_idle_call::loop);
+        });
+    }
+}
+
+/** The listeners of an xdg popup, with a std::function callback each. */
+struct wrapper_popup_t
+{
+    int events = 0;
+    wf::wl_listener_wrapper on_destroy, on_new_popup, on_map, on_unmap, on_ping_timeout, on_reposition,
+        on_commit;
+
+    wrapper_popup_t(wl_signal *signals)
+    {
+        wf::wl_listener_wrapper *listeners[] = {
+            &on_destroy, &on_new_popup, &on_map, &on_unmap, &on_ping_timeout, &on_reposition, &on_commit
+        };
+        for (int i = 0; i < 7; i++)
+        {
+            listeners[i]->set_callback([this] (void*) { events++; });
+            listeners[i]->connect(&signals[i]);
+        }
+    }
+};
+
+/** The same listeners as wrapper_popup_t, using wl_member_listener_t. */
+struct member_popup_t
+{
+    int events = 0;
+    void handle()
+    {
+        events++;
+    }
+
+    wf::wl_member_listener_t<&member_popup_t::handle> on_destroy{this}, on_new_popup{this}, on_map{this},
+        on_unmap{this}, on_ping_timeout{this}, on_reposition{this}, on_commit{this};
+
+    member_popup_t(wl_signal *signals)
+    {
+        wf::wl_member_listener_t<&member_popup_t::handle> *listeners[] = {
+            &on_destroy, &on_new_popup, &on_map, &on_unmap, &on_ping_timeout, &on_reposition, &on_commit
+        };
+        for (int i = 0; i < 7; i++)
+        {
+            listeners[i]->connect(&signals[i]);
+        }
+    }
+};
+
+template<class Popup>
+static void bench_popup_listeners(const std::string& name)
+{
+    wl_signal signals[7];
+    for (auto& signal : signals)
+    {
+        wl_signal_init(&signal);
+    }
+
+    for (auto size : SIZES)
+    {
+        // A burst of popups, like a menu with submenus being opened and closed.
+        wf::bench::run("listener/create-" + name, size, [&] ()
+        {
+            std::vector<std::unique_ptr<Popup>> popups;
+            for (int64_t i = 0; i < size; i++)
+            {
+                popups.push_back(std::make_unique<Popup>(signals));
+            }
+
+            wf::bench::keep(popups.size());
+        });
+
+        std::vector<std::unique_ptr<Popup>> popups;
+        for (int64_t i = 0; i < size; i++)
+        {
+            popups.push_back(std::make_unique<Popup>(signals));
+        }
+
+        wf::bench::run("listener/emit-" + name, size, [&] { wl_signal_emit(&signals[4], nullptr); });
+    }
+}
+
+/** Mimics view_access_interface_t, which needs a live view. */
+class bench_access_interface_t : public wf::access_interface_t
+{
+  public:
+    wf::variant_t get(const std::string& identifier, bool& error) override
+    {
+        error = false;
+        if (identifier == "app_id")
+        {
+            return std::string("org.example.Terminal");
+        } else if (identifier == "title")
+        {
+            return std::string("~/src/wayfire - vim");
+        } else if (identifier == "type")
+        {
+            return std::string("toplevel");
+        } else if (identifier == "fullscreen")
+        {
+            return false;
+        }
+
+        error = true;
+        return std::string("");
+    }
+};
+
+static void bench_matcher()
+{
+    // The same steps as view_matcher_t::matches(), which only adds the construction of the access interface.
+    const std::vector<std::string> conditions = {
+        "app_id is \"org.example.Terminal\"",
+        "(app_id is \"firefox\" | title contains \"vim\") & type is \"toplevel\" & fullscreen is false",
+    };
+
+    bench_access_interface_t access;
+    for (auto& text : conditions)
+    {
+        wf::lexer_t lexer;
+        wf::condition_parser_t parser;
+        lexer.reset(text);
+        auto condition = parser.parse(lexer);
+
+        wf::bench::run("matcher/matches", text.size(), [&] ()
+        {
+            bool error = false;
+            wf::bench::keep(condition->evaluate(access, error));
+        });
+    }
+}
+
+int main()
+{
+    wf::log::initialize_logging(std::cerr, wf::log::LOG_LEVEL_ERROR, wf::log::LOG_COLOR_MODE_OFF);
+    wf::wl_idle_call::loop = wl_event_loop_create();
+
+    bench_region();
+    bench_render_target();
+    bench_signals();
+    bench_object_data();
+    bench_transactions();
+    bench_popup_listeners<wrapper_popup_t>("wrapper");
+    bench_popup_listeners<member_popup_t>("member");
+    bench_matcher();
+    return 0;
+}
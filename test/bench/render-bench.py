@@ -0,0 +1,193 @@
+#!/usr/bin/python3
+#
+# A render benchmark for Wayfire.
+#
+# The script starts Wayfire on a headless output, opens a number of clients and lays them out in a grid,
+# optionally with blur, decorations and scale, and then uses stipc/bench_frames to render a fixed number of
+# frames. The frame time percentiles, GL draw calls and heap growth are printed as JSON.
+#
+# Example: ./render-bench.py --wayfire build/src/wayfire --views 8 --blur --decorations
+
+import argparse
+import json
+import math
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'ipc-scripts'))
+from wayfire_socket import *
+
+def parse_args():
+    parser = argparse.ArgumentParser(description='Benchmark the Wayfire render path on a headless output.')
+    parser.add_argument('--wayfire', default='wayfire', help='The Wayfire executable to benchmark')
+    parser.add_argument('--plugin-path', action='append', default=[],
+        help='Directory containing the plugins, may be given multiple times')
+    parser.add_argument('--views', type=int, default=4, help='Number of client windows to open')
+    parser.add_argument('--frames', type=int, default=600, help='Number of frames to render')
+    parser.add_argument('--client', default='weston-simple-shm', help='The client to open for each view')
+    parser.add_argument('--resolution', default='1920x1080', help='The size of the headless output')
+    parser.add_argument('--refresh', type=int, default=60000, help='The refresh rate of the outputs in mHz')
+    parser.add_argument('--outputs', type=int, default=1,
+        help='Number of headless outputs, the others are rendered alongside the benchmarked one')
+    parser.add_argument('--blur', action='store_true', help='Blur all views')
+    parser.add_argument('--decorations', action='store_true', help='Enable server-side decorations')
+    parser.add_argument('--scale', action='store_true', help='Activate scale during the benchmark')
+    parser.add_argument('--no-full-damage', action='store_true',
+        help='Do not damage the whole output in each frame')
+    parser.add_argument('--timeout', type=float, default=60, help='Timeout in seconds for each step')
+    return parser.parse_args()
+
+def write_config(args, path):
+    plugins = ['ipc', 'stipc', 'ipc-rules']
+    if args.blur:
+        plugins.append('blur')
+    if args.decorations:
+        plugins.append('decoration')
+    if args.scale:
+        plugins.append('scale')
+
+    with open(path, 'w') as config:
+        config.write('[core]\n')
+        config.write('plugins = {}\n'.format(' '.join(plugins)))
+        config.write('\n[blur]\n')
+        config.write('blur_by_default = {}\n'.format('type is "toplevel"' if args.blur else 'none'))
+        config.write('\n[decoration]\n')
+        config.write('ignore_views = {}\n'.format('none' if args.decorations else 'all'))
+        config.write('\n[output:HEADLESS-1]\n')
+        config.write('mode = {}@{}\n'.format(args.resolution, args.refresh))
+
+def wait_for(what, condition, timeout):
+    start = time.time()
+    while time.time() - start < timeout:
+        result = condition()
+        if result:
+            return result
+        time.sleep(0.1)
+
+    raise Exception('Timed out waiting for ' + what)
+
+def connect(socket_path, timeout):
+    def try_connect():
+        try:
+            sock = WayfireSocket(socket_path)
+            sock.send_json(get_msg_template('stipc/ping'))
+            return sock
+        except Exception:
+            return None
+
+    return wait_for('Wayfire to start', try_connect, timeout)
+
+def layout_grid(sock, views, output):
+    width, height = output['geometry']['width'], output['geometry']['height']
+    columns = max(1, math.ceil(math.sqrt(len(views))))
+    rows = max(1, math.ceil(len(views) / columns))
+
+    layout = []
+    for i, view in enumerate(views):
+        layout.append({
+            'id': view['id'],
+            'x': output['geometry']['x'] + (i % columns) * width // columns,
+            'y': output['geometry']['y'] + (i // columns) * height // rows,
+            'width': width // columns,
+            'height': height // rows,
+        })
+
+    message = get_msg_template('stipc/layout_views')
+    message['data']['views'] = layout
+    sock.send_json(message)
+
+def create_outputs(args, sock):
+    width, height = [int(x) for x in args.resolution.split('x')]
+    message = get_msg_template('stipc/create_headless_output')
+    message['data']['width'] = width
+    message['data']['height'] = height
+    message['data']['refresh'] = args.refresh
+    message['data']['count'] = args.outputs - 1
+    sock.send_json(message)
+
+    def all_outputs():
+        outputs = sock.send_json(get_msg_template('window-rules/list-outputs'))
+        return outputs if len(outputs) >= args.outputs else None
+
+    wait_for('outputs to be added', all_outputs, args.timeout)
+
+def run_benchmark(args, sock):
+    if args.outputs > 1:
+        create_outputs(args, sock)
+
+    outputs = sock.send_json(get_msg_template('window-rules/list-outputs'))
+    if not outputs:
+        raise Exception('Wayfire has no outputs')
+    output = outputs[0]
+
+    for _ in range(args.views):
+        message = get_msg_template('stipc/run')
+        message['data']['cmd'] = args.client
+        sock.send_json(message)
+
+    def toplevels():
+        views = [v for v in sock.list_views() if v['type'] == 'toplevel' and v['mapped']]
+        return views if len(views) >= args.views else None
+
+    views = wait_for('clients to open', toplevels, args.timeout) if args.views > 0 else []
+    layout_grid(sock, views, output)
+
+    if args.scale:
+        message = get_msg_template('scale/toggle')
+        message['data']['output_id'] = output['id']
+        sock.send_json(message)
+
+    message = get_msg_template('stipc/bench_frames')
+    message['data']['output'] = output['name']
+    message['data']['frames'] = args.frames
+    message['data']['full_damage'] = not args.no_full_damage
+    sock.send_json(message)
+
+    def results():
+        response = sock.send_json(get_msg_template('stipc/bench_results'))
+        return None if response['running'] else response
+
+    result = wait_for('the benchmark to finish', results, args.timeout)
+    result['scene'] = {
+        'views': args.views,
+        'blur': args.blur,
+        'decorations': args.decorations,
+        'scale': args.scale,
+        'resolution': args.resolution,
+        'refresh': args.refresh,
+        'outputs': args.outputs,
+    }
+    return result
+
+def main():
+    args = parse_args()
+    tmpdir = tempfile.mkdtemp(prefix='wayfire-bench-')
+    config_path = os.path.join(tmpdir, 'wayfire.ini')
+    socket_path = os.path.join(tmpdir, 'wayfire.socket')
+    write_config(args, config_path)
+
+    env = os.environ.copy()
+    env['WLR_BACKENDS'] = 'headless'
+    env['WLR_HEADLESS_OUTPUTS'] = '1'
+    env['WLR_RENDERER'] = 'gles2'
+    env['_WAYFIRE_SOCKET'] = socket_path
+    env.pop('WAYLAND_DISPLAY', None)
+    if args.plugin_path:
+        env['WAYFIRE_PLUGIN_PATH'] = ':'.join(args.plugin_path)
+
+    log = open(os.path.join(tmpdir, 'wayfire.log'), 'w')
+    wayfire = subprocess.Popen([args.wayfire, '-c', config_path], env=env, stdout=log, stderr=log)
+    try:
+        sock = connect(socket_path, args.timeout)
+        result = run_benchmark(args, sock)
+        print(json.dumps(result, indent=4))
+    finally:
+        wayfire.terminate()
+        wayfire.wait()
+        log.close()
+
+if __name__ == '__main__':
+    main()
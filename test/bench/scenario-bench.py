@@ -0,0 +1,273 @@
+#!/usr/bin/python3
+#
+# A scenario benchmark for Wayfire.
+#
+# A scenario is a JSON file which describes the plugins and configuration to use, a list of setup steps which
+# are not measured (for example opening clients), and a list of steps which are measured. The script runs each
+# scenario against a headless Wayfire instance and prints the frame statistics, transaction statistics and
+# per-plugin costs of the measured steps as JSON.
+#
+# Scenario format:
+#
+# {
+#     "description": "Human-readable description",
+#     "plugins": ["scale"],                       # Loaded in addition to ipc, stipc and ipc-rules
+#     "config": {"core": {"vwidth": "3"}},        # Additional config sections and options
+#     "resolution": "1920x1080", "refresh": 60000, "outputs": 1,
+#     "setup": [ <step>, ... ],
+#     "steps": [ <step>, ... ]
+# }
+#
+# Each step is an object with an "action" and an optional "delay" in milliseconds to wait afterwards:
+#
+#   {"action": "spawn", "count": 8, "client": "weston-simple-shm"}   open clients and wait until they map
+#   {"action": "layout"}                                             lay out all views in a grid
+#   {"action": "move", "view": 0, "x": 100, "y": 100}                move the n-th view
+#   {"action": "resize", "view": 0, "width": 400, "height": 300}     resize the n-th view
+#   {"action": "key", "combo": "KEY_LEFTMETA+KEY_E"}                 press the keys in order, release in reverse
+#   {"action": "drag", "view": 0, "to": [800, 600], "steps": 30, "button": "S-BTN_LEFT", "interval": 16}
+#   {"action": "call", "method": "scale/toggle", "data": {}}         any IPC method
+#   {"action": "sleep", "ms": 500}
+#   {"action": "repeat", "count": 10, "steps": [ <step>, ... ]}
+#
+# Example: ./scenario-bench.py --wayfire build/src/wayfire scenarios/scale-100.json
+
+import argparse
+import json
+import math
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+sys.path.append(os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'ipc-scripts'))
+from wayfire_socket import *
+
+# Exit code which meson interprets as a skipped test or benchmark
+SKIP = 77
+
+def parse_args():
+    parser = argparse.ArgumentParser(description='Replay benchmark scenarios against a headless Wayfire.')
+    parser.add_argument('scenarios', nargs='+', help='The scenario files to run')
+    parser.add_argument('--wayfire', default='wayfire', help='The Wayfire executable to benchmark')
+    parser.add_argument('--plugin-path', action='append', default=[],
+        help='Directory containing the plugins, may be given multiple times')
+    parser.add_argument('--client', default='weston-simple-shm', help='The default client for spawn steps')
+    parser.add_argument('--timeout', type=float, default=120, help='Timeout in seconds for each step')
+    return parser.parse_args()
+
+def write_config(scenario, path):
+    sections = {'core': {'plugins': ' '.join(['ipc', 'stipc', 'ipc-rules'] + scenario.get('plugins', []))}}
+    sections['output:HEADLESS-1'] = {
+        'mode': '{}@{}'.format(scenario.get('resolution', '1920x1080'), scenario.get('refresh', 60000))
+    }
+
+    for name, options in scenario.get('config', {}).items():
+        sections.setdefault(name, {}).update(options)
+
+    with open(path, 'w') as config:
+        for name, options in sections.items():
+            config.write('[{}]\n'.format(name))
+            for option, value in options.items():
+                config.write('{} = {}\n'.format(option, value))
+            config.write('\n')
+
+def wait_for(what, condition, timeout):
+    start = time.time()
+    while time.time() - start < timeout:
+        result = condition()
+        if result:
+            return result
+        time.sleep(0.05)
+
+    raise Exception('Timed out waiting for ' + what)
+
+def connect(socket_path, timeout):
+    def try_connect():
+        try:
+            sock = WayfireSocket(socket_path)
+            sock.send_json(get_msg_template('stipc/ping'))
+            return sock
+        except Exception:
+            return None
+
+    return wait_for('Wayfire to start', try_connect, timeout)
+
+def call(sock, method, data = None):
+    message = get_msg_template(method)
+    message['data'] = data or {}
+    response = sock.send_json(message)
+    if isinstance(response, dict) and 'error' in response:
+        raise Exception('{} failed: {}'.format(method, response['error']))
+    return response
+
+class Runner:
+    def __init__(self, args, sock):
+        self.args = args
+        self.sock = sock
+
+    def toplevels(self):
+        return [v for v in self.sock.list_views() if v['type'] == 'toplevel' and v['mapped']]
+
+    def view(self, index):
+        views = sorted(self.toplevels(), key=lambda v: v['id'])
+        return views[index % len(views)]
+
+    def output(self):
+        return self.sock.send_json(get_msg_template('window-rules/list-outputs'))[0]
+
+    def spawn(self, step):
+        expected = len(self.toplevels()) + step.get('count', 1)
+        for _ in range(step.get('count', 1)):
+            call(self.sock, 'stipc/run', {'cmd': step.get('client', self.args.client)})
+
+        wait_for('clients to open', lambda: len(self.toplevels()) >= expected, self.args.timeout)
+
+    def layout(self, step):
+        views = sorted(self.toplevels(), key=lambda v: v['id'])
+        geometry = self.output()['geometry']
+        columns = max(1, math.ceil(math.sqrt(len(views))))
+        rows = max(1, math.ceil(len(views) / columns))
+        width, height = geometry['width'] // columns, geometry['height'] // rows
+        for i, view in enumerate(views):
+            self.sock.configure_view(view['id'], geometry['x'] + (i % columns) * width,
+                geometry['y'] + (i // columns) * height, width, height)
+
+    def move(self, step):
+        view = self.view(step['view'])
+        g = view['geometry']
+        self.sock.configure_view(view['id'], step['x'], step['y'], g['width'], g['height'])
+
+    def resize(self, step):
+        view = self.view(step['view'])
+        g = view['geometry']
+        self.sock.configure_view(view['id'], g['x'], g['y'], step['width'], step['height'])
+
+    def key(self, step):
+        keys = step['combo'].split('+')
+        for key in keys:
+            call(self.sock, 'stipc/feed_key', {'key': key, 'state': True})
+        for key in reversed(keys):
+            call(self.sock, 'stipc/feed_key', {'key': key, 'state': False})
+
+    def drag(self, step):
+        g = self.view(step['view'])['geometry']
+        x, y = g['x'] + g['width'] / 2, g['y'] + g['height'] / 2
+        to_x, to_y = step['to']
+        steps = step.get('steps', 30)
+        button = step.get('button', 'S-BTN_LEFT')
+
+        call(self.sock, 'stipc/move_cursor', {'x': x, 'y': y})
+        call(self.sock, 'stipc/feed_button', {'combo': button, 'mode': 'press'})
+        for i in range(1, steps + 1):
+            call(self.sock, 'stipc/move_cursor', {'x': x + (to_x - x) * i / steps, 'y': y + (to_y - y) * i / steps})
+            time.sleep(step.get('interval', 16) / 1000)
+        call(self.sock, 'stipc/feed_button', {'combo': button, 'mode': 'release'})
+
+    def run_steps(self, steps):
+        for step in steps:
+            action = step['action']
+            if action == 'call':
+                call(self.sock, step['method'], step.get('data'))
+            elif action == 'sleep':
+                time.sleep(step['ms'] / 1000)
+            elif action == 'repeat':
+                for _ in range(step['count']):
+                    self.run_steps(step['steps'])
+            elif action in ('spawn', 'layout', 'move', 'resize', 'key', 'drag'):
+                getattr(self, action)(step)
+            else:
+                raise Exception('Unknown action ' + action)
+
+            time.sleep(step.get('delay', 0) / 1000)
+
+    def snapshot(self):
+        return {
+            'frames': call(self.sock, 'render/frame-stats')['outputs'],
+            'transactions': call(self.sock, 'wayfire/transaction-stats'),
+        }
+
+def counter_delta(before, after, keys):
+    return {key: after[key] - before[key] for key in keys if key in before and key in after}
+
+def run_scenario(args, sock, scenario):
+    runner = Runner(args, sock)
+    if scenario.get('outputs', 1) > 1:
+        width, height = [int(x) for x in scenario.get('resolution', '1920x1080').split('x')]
+        call(sock, 'stipc/create_headless_output', {'width': width, 'height': height,
+            'refresh': scenario.get('refresh', 60000), 'count': scenario['outputs'] - 1})
+
+    runner.run_steps(scenario.get('setup', []))
+
+    call(sock, 'wayfire/plugin-stats', {'enable': True})
+    before = runner.snapshot()
+    start = time.time()
+    runner.run_steps(scenario.get('steps', []))
+    wall_time = time.time() - start
+    after = runner.snapshot()
+    plugins = call(sock, 'wayfire/plugin-stats', {'enable': False})
+
+    frames = []
+    for output in after['frames']:
+        previous = next((o for o in before['frames'] if o['id'] == output['id']), None)
+        entry = {'name': output['name'], 'phases': output['phases']}
+        if previous:
+            entry.update(counter_delta(previous, output, ['rendered-frames', 'scanout-frames', 'idle-frames']))
+        frames.append(entry)
+
+    transactions = counter_delta(before['transactions'], after['transactions'],
+        ['scheduled', 'merged', 'committed', 'applied', 'timed-out', 'conflicts'])
+    transactions['max-latency-us'] = after['transactions']['max-latency-us']
+    transactions['avg-latency-us'] = after['transactions']['avg-latency-us']
+
+    return {
+        'scenario': scenario.get('description', ''),
+        'wall-time': wall_time,
+        'outputs': frames,
+        'transactions': transactions,
+        'plugins': plugins['plugins'],
+    }
+
+def run_file(args, path):
+    with open(path) as f:
+        scenario = json.load(f)
+
+    tmpdir = tempfile.mkdtemp(prefix='wayfire-scenario-')
+    config_path = os.path.join(tmpdir, 'wayfire.ini')
+    socket_path = os.path.join(tmpdir, 'wayfire.socket')
+    write_config(scenario, config_path)
+
+    env = os.environ.copy()
+    env['WLR_BACKENDS'] = 'headless'
+    env['WLR_HEADLESS_OUTPUTS'] = '1'
+    env['WLR_RENDERER'] = 'gles2'
+    env['_WAYFIRE_SOCKET'] = socket_path
+    env.pop('WAYLAND_DISPLAY', None)
+    if args.plugin_path:
+        env['WAYFIRE_PLUGIN_PATH'] = ':'.join(args.plugin_path)
+
+    log = open(os.path.join(tmpdir, 'wayfire.log'), 'w')
+    wayfire = subprocess.Popen([args.wayfire, '-c', config_path], env=env, stdout=log, stderr=log)
+    try:
+        sock = connect(socket_path, args.timeout)
+        result = run_scenario(args, sock, scenario)
+        result['file'] = os.path.basename(path)
+        return result
+    finally:
+        wayfire.terminate()
+        wayfire.wait()
+        log.close()
+
+def main():
+    args = parse_args()
+    if not shutil.which(args.client) or not shutil.which(args.wayfire):
+        print('{} or {} not found, skipping'.format(args.client, args.wayfire))
+        sys.exit(SKIP)
+
+    for path in args.scenarios:
+        print(json.dumps(run_file(args, path)))
+
+if __name__ == '__main__':
+    main()
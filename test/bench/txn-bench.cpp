@@ -0,0 +1,257 @@
+#include "bench.hpp"
+#include "../txn/transaction-test-object.hpp"
+#include "../../src/core/txn/transaction-manager-impl.hpp"
+
+#include <wayfire/txn/transaction.hpp>
+#include <wayland-server-core.h>
+#include <vector>
+
+/**
+ * Stress benchmarks for the transaction manager: many concurrent transactions with overlapping object sets,
+ * chains of transactions waiting on each other, and workloads where most transactions time out. Each run
+ * schedules @size transactions and drives them until all are applied, so the reported time is per workload.
+ * The statistics of the last run (merges, conflicts, apply latency) are printed as a separate JSON line.
+ */
+static const std::vector<int64_t> SIZES = {64, 256, 1024, 4096};
+
+struct workload_t
+{
+    wf::txn::transaction_manager_t::impl manager;
+    std::vector<std::shared_ptr<txn_test_object_t>> objects;
+    // The number of commits of each object which were already acknowledged
+    std::vector<int> acked;
+    // The timeouts of the committed transactions, fired manually instead of by a wl_timer
+    std::vector<std::pair<const wf::txn::transaction_t*, wf::wl_timer<false>::callback_t>> timers;
+
+    workload_t(int64_t nr_objects)
+    {
+        for (int64_t i = 0; i < nr_objects; i++)
+        {
+            objects.push_back(std::make_shared<txn_test_object_t>(false));
+        }
+
+        acked.resize(nr_objects, 0);
+    }
+
+    /** Make the object @i ready, if it has been committed since it was last made ready. */
+    void ack(int64_t i)
+    {
+        i %= objects.size();
+        if (objects[i]->number_committed > acked[i])
+        {
+            acked[i] = objects[i]->number_committed;
+            objects[i]->emit_ready();
+        }
+    }
+
+    void schedule(const std::vector<int64_t>& indices)
+    {
+        auto self = std::make_shared<const wf::txn::transaction_t*>();
+        auto tx   = std::make_unique<wf::txn::transaction_t>(100, [=] (auto, auto callback)
+        {
+            timers.emplace_back(*self, callback);
+        });
+
+        *self = tx.get();
+        for (auto i : indices)
+        {
+            tx->add_object(objects[i % objects.size()]);
+        }
+
+        manager.schedule_transaction(std::move(tx));
+    }
+
+    bool is_committed(const wf::txn::transaction_t *tx) const
+    {
+        return std::any_of(manager.committed.begin(), manager.committed.end(),
+            [&] (auto& committed) { return committed.get() == tx; });
+    }
+
+    /** Make all objects ready until no transactions are left. */
+    void ack_all()
+    {
+        while (!manager.committed.empty() || !manager.pending.empty())
+        {
+            for (size_t i = 0; i < objects.size(); i++)
+            {
+                ack(i);
+            }
+        }
+
+        finish();
+    }
+
+    /** Fire the timeouts of all committed transactions until none are left. */
+    void time_out_all()
+    {
+        while (!manager.committed.empty())
+        {
+            auto fired = std::move(timers);
+            timers.clear();
+            for (auto& [tx, callback] : fired)
+            {
+                if (is_committed(tx))
+                {
+                    callback();
+                }
+            }
+        }
+
+        finish();
+    }
+
+    void finish()
+    {
+        timers.clear();
+        wl_event_loop_dispatch_idle(wf::wl_idle_call::loop);
+    }
+};
+
+static void print_stats(const std::string& name, int64_t size, const wf::txn::transaction_stats_t& stats)
+{
+    const int64_t avg_latency = stats.applied ? stats.total_latency_usec / (int64_t)stats.applied : 0;
+    std::cout << "{\"benchmark\": \"" << name << "\", \"size\": " << size <<
+        ", \"scheduled\": " << stats.scheduled << ", \"merged\": " << stats.merged <<
+        ", \"conflicts\": " << stats.conflicts << ", \"timed_out\": " << stats.timed_out <<
+        ", \"max_pending\": " << stats.max_pending << ", \"avg_apply_latency_us\": " << avg_latency <<
+        ", \"max_apply_latency_us\": " << stats.max_latency_usec << "}" << std::endl;
+}
+
+/**
+ * Run @workload on fresh objects repeatedly, then print the statistics of one more run.
+ */
+template<class Func>
+static void run_workload(const std::string& name, int64_t size, int64_t nr_objects, Func workload)
+{
+    wf::bench::run(name, size, [&] ()
+    {
+        workload_t state{nr_objects};
+        workload(state);
+    });
+
+    workload_t state{nr_objects};
+    workload(state);
+    print_stats(name + "/stats", size, state.manager.stats);
+}
+
+static void bench_overlapping()
+{
+    // Transactions touch a few objects of a shared pool, so that many of them conflict with the committed
+    // ones and are coalesced with the pending ones.
+    for (auto size : SIZES)
+    {
+        run_workload("txn-stress/overlapping", size, size / 4 + 1, [&] (workload_t& state)
+        {
+            for (int64_t i = 0; i < size; i++)
+            {
+                state.schedule({i, i + 1, i * 7 + 3});
+                if (i % 16 == 15)
+                {
+                    // Some objects become ready while new transactions keep coming in.
+                    state.ack(i);
+                }
+            }
+
+            state.ack_all();
+        });
+    }
+}
+
+static void bench_disjoint()
+{
+    // The best case: no transaction intersects another, which shows the cost of the conflict checks alone.
+    for (auto size : SIZES)
+    {
+        run_workload("txn-stress/disjoint", size, size, [&] (workload_t& state)
+        {
+            for (int64_t i = 0; i < size; i++)
+            {
+                state.schedule({i});
+            }
+
+            state.ack_all();
+        });
+    }
+}
+
+static void bench_retile()
+{
+    // Like a tiling layout which is retiled on each motion event of an interactive resize: every transaction
+    // contains the same 30 objects, and only a few of them acknowledge in time, so the new transactions
+    // conflict with the committed one and are merged with the pending one.
+    static constexpr int64_t VIEWS = 30;
+    for (auto size : SIZES)
+    {
+        run_workload("txn-stress/retile", size, VIEWS * 4, [&] (workload_t& state)
+        {
+            std::vector<int64_t> indices;
+            for (int64_t i = 0; i < size; i++)
+            {
+                const int64_t workspace = (i % 4) * VIEWS;
+                indices.clear();
+                for (int64_t v = 0; v < VIEWS; v++)
+                {
+                    indices.push_back(workspace + v);
+                }
+
+                state.schedule(indices);
+                state.ack(workspace + i % VIEWS);
+            }
+
+            state.ack_all();
+        });
+    }
+}
+
+static void bench_chain()
+{
+    // Each transaction shares an object with the previous one, and the objects become ready one after the
+    // other, so each transaction waits on the one before it.
+    for (auto size : SIZES)
+    {
+        run_workload("txn-stress/chain", size, size + 1, [&] (workload_t& state)
+        {
+            for (int64_t i = 0; i < size; i++)
+            {
+                state.schedule({i, i + 1});
+                state.ack(i);
+            }
+
+            state.ack_all();
+        });
+    }
+}
+
+static void bench_timeouts()
+{
+    // Half of the objects never become ready, so most transactions are applied by their timeout.
+    for (auto size : SIZES)
+    {
+        run_workload("txn-stress/timeouts", size, size / 2 + 1, [&] (workload_t& state)
+        {
+            for (int64_t i = 0; i < size; i++)
+            {
+                state.schedule({i, i + size / 4});
+                if (i % 2 == 0)
+                {
+                    state.ack(i);
+                }
+            }
+
+            state.time_out_all();
+        });
+    }
+}
+
+int main()
+{
+    wf::log::initialize_logging(std::cerr, wf::log::LOG_LEVEL_ERROR, wf::log::LOG_COLOR_MODE_OFF);
+    wf::wl_idle_call::loop = wl_event_loop_create();
+
+    bench_disjoint();
+    bench_overlapping();
+    bench_retile();
+    bench_chain();
+    bench_timeouts();
+    return 0;
+}
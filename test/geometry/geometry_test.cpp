@@ -2,6 +2,9 @@
 #include <doctest/doctest.h>
 
 #include <wayfire/geometry.hpp>
+#include <wayfire/region.hpp>
+#include <wayfire/opengl.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 TEST_CASE("Point addition")
 {
@@ -11,3 +14,101 @@ TEST_CASE("Point addition")
     using namespace wf;
     REQUIRE_EQ(a + b, wf::point_t{4, 6});
 }
+
+TEST_CASE("Region simplification")
+{
+    wf::region_t region;
+    for (int i = 0; i < 20; i++)
+    {
+        region |= wlr_box{i * 10, (i % 2) * 10, 5, 5};
+    }
+
+    wf::region_t original = region;
+    region.simplify(4);
+
+    int nrects = 0;
+    for (auto& box : region)
+    {
+        (void)box;
+        ++nrects;
+    }
+
+    REQUIRE_LE(nrects, 4);
+    REQUIRE((original ^ region).empty());
+
+    // Merges within the overdraw threshold happen even below the budget
+    wf::region_t pair = wf::region_t{wlr_box{0, 0, 10, 10}} | wlr_box{10, 1, 10, 10};
+    REQUIRE_EQ(pair.end() - pair.begin(), 3);
+    pair.simplify(0, 10);
+    REQUIRE_EQ(pair.end() - pair.begin(), 3);
+    pair.simplify(0, 11);
+    REQUIRE_EQ(pair.end() - pair.begin(), 1);
+}
+
+TEST_CASE("Region builder")
+{
+    wf::region_t expected;
+    wf::region_builder_t builder;
+    for (int i = 0; i < 20; i++)
+    {
+        wlr_box box{i * 7, (i % 3) * 4, 10, 6};
+        expected |= box;
+        builder.add(box);
+    }
+
+    builder.add(wlr_box{5, 5, 0, 10});
+    auto built = builder.build();
+    REQUIRE((expected ^ built).empty());
+    REQUIRE((built ^ expected).empty());
+    REQUIRE(builder.build().empty());
+}
+
+TEST_CASE("Region operators on temporaries")
+{
+    wf::region_t region = wf::region_t{wlr_box{0, 0, 10, 10}} | wlr_box{20, 0, 10, 10};
+    const wf::region_t copy = region;
+
+    auto in_place = std::move(region) * 2 & wlr_box{0, 0, 50, 10};
+    auto expected = copy * 2 & wlr_box{0, 0, 50, 10};
+    REQUIRE((in_place ^ expected).empty());
+    REQUIRE((expected ^ in_place).empty());
+    REQUIRE(!in_place.empty());
+}
+
+TEST_CASE("Render target projection")
+{
+    wf::render_target_t target;
+    target.viewport_width  = 1000;
+    target.viewport_height = 600;
+    target.geometry     = {100, 50, 300, 500};
+    target.scale        = 2;
+    target.wl_transform = WL_OUTPUT_TRANSFORM_90;
+    target.transform    = glm::rotate(glm::mat4(1.0), 1.0f, glm::vec3(0, 0, 1));
+    target.subbuffer    = wf::geometry_t{10, 20, 500, 300};
+
+    auto expected = target.gl_to_framebuffer() * glm::ortho(100.0f, 400.0f, 550.0f, 50.0f);
+    auto actual   = target.get_orthographic_projection();
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            REQUIRE(actual[i][j] == doctest::Approx(expected[i][j]));
+        }
+    }
+
+    wf::region_t region;
+    for (int i = 0; i < 10; i++)
+    {
+        region |= wlr_box{100 + i * 25, 50 + (i % 4) * 30, 20, 25};
+    }
+
+    wf::region_t projected;
+    for (const auto& rect : region)
+    {
+        projected |= target.framebuffer_box_from_geometry_box(wlr_box_from_pixman_box(rect));
+    }
+
+    auto batched = target.framebuffer_region_from_geometry_region(region);
+    REQUIRE((batched ^ projected).empty());
+    REQUIRE((projected ^ batched).empty());
+}
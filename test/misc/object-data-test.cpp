@@ -0,0 +1,56 @@
+#include "wayfire/object.hpp"
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+class test_object_t : public wf::object_base_t
+{};
+
+struct data_a : public wf::custom_data_t
+{
+    int value = 0;
+};
+
+struct data_b : public wf::custom_data_t
+{};
+
+TEST_CASE("Typed and named custom data are the same")
+{
+    test_object_t object;
+    REQUIRE(!object.has_data<data_a>());
+    REQUIRE(object.get_data<data_a>() == nullptr);
+
+    // Stored by name, found by type
+    object.store_data(std::make_unique<data_a>(), typeid(data_a).name());
+    REQUIRE(object.has_data<data_a>());
+    REQUIRE(object.get_data<data_a>() != nullptr);
+    REQUIRE(object.get_data<data_a>() == object.get_data<data_a>(typeid(data_a).name()));
+    REQUIRE(object.get_data<data_b>() == nullptr);
+
+    // Replaced and erased by name, seen by type
+    auto replacement = std::make_unique<data_a>();
+    replacement->value = 5;
+    object.store_data(std::move(replacement), typeid(data_a).name());
+    REQUIRE(object.get_data<data_a>()->value == 5);
+
+    object.erase_data(typeid(data_a).name());
+    REQUIRE(!object.has_data<data_a>());
+    REQUIRE(object.get_data<data_a>() == nullptr);
+}
+
+TEST_CASE("Typed custom data access")
+{
+    test_object_t object;
+    auto data = object.get_data_safe<data_a>();
+    REQUIRE(data != nullptr);
+    REQUIRE(object.get_data_safe<data_a>() == data);
+    REQUIRE(object.has_data(typeid(data_a).name()));
+
+    auto released = object.release_data<data_a>();
+    REQUIRE(released.get() == data.get());
+    REQUIRE(object.get_data<data_a>() == nullptr);
+
+    object.store_data(std::make_unique<data_b>());
+    REQUIRE(object.get_data<data_b>() != nullptr);
+    object.erase_data<data_b>();
+    REQUIRE(object.get_data<data_b>() == nullptr);
+}
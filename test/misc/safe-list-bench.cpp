@@ -0,0 +1,55 @@
+#include "../bench/bench.hpp"
+#include <wayfire/nonstd/safe-list.hpp>
+
+/**
+ * Microbenchmarks for the most common operations on safe lists, i.e. emitting signals or running hooks
+ * (iteration) and connecting/disconnecting them (push/remove), for various list sizes.
+ */
+int main()
+{
+    int values[256];
+    for (size_t size : {1, 4, 16, 256})
+    {
+        wf::safe_list_t<int*> list;
+        for (size_t i = 0; i < size; i++)
+        {
+            list.push_back(&values[i]);
+        }
+
+        wf::bench::run("safe_list/iterate", size, [&] ()
+        {
+            int count = 0;
+            list.for_each([&] (int *value) { count += (value != nullptr); });
+            wf::bench::keep(count);
+        });
+
+        wf::bench::run("safe_list/push-remove", size, [&] ()
+        {
+            list.push_back(&values[0]);
+            list.remove_all(&values[0]);
+            list.push_back(&values[0]);
+        });
+
+        wf::bench::run("safe_list/remove-during-iteration", size, [&] ()
+        {
+            list.for_each([&] (int *value) { list.remove_all(value); });
+            for (size_t i = 0; i < size; i++)
+            {
+                list.push_back(&values[i]);
+            }
+        });
+
+        wf::bench::run("safe_list/fill-clear", size, [&] ()
+        {
+            wf::safe_list_t<int*> fresh;
+            for (size_t i = 0; i < size; i++)
+            {
+                fresh.push_back(&values[i]);
+            }
+
+            fresh.clear();
+        });
+    }
+
+    return 0;
+}
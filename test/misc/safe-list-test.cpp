@@ -94,3 +94,62 @@ TEST_CASE("safe-list push next")
 
     REQUIRE(list.size() == 2);
 }
+
+TEST_CASE("safe-list beyond inline storage")
+{
+    wf::safe_list_t<int> list;
+    for (int i = 0; i < 10; i++)
+    {
+        list.push_back(i);
+    }
+
+    REQUIRE(list.size() == 10);
+    REQUIRE(list.back() == 9);
+
+    list.remove_if([] (int i) { return i % 2 == 1; });
+    REQUIRE(list.size() == 5);
+    REQUIRE(list.back() == 8);
+
+    std::vector<int> values;
+    list.for_each([&] (int i) { values.push_back(i); });
+    const std::vector<int> even = {0, 2, 4, 6, 8};
+    REQUIRE(values == even);
+
+    list.push_back(10);
+    values.clear();
+    list.for_each_reverse([&] (int i) { values.push_back(i); });
+    const std::vector<int> reversed = {10, 8, 6, 4, 2, 0};
+    REQUIRE(values == reversed);
+}
+
+TEST_CASE("safe-list churn")
+{
+    wf::safe_list_t<int> list;
+    for (int i = 0; i < 100; i++)
+    {
+        list.push_back(i);
+        list.push_back(-1);
+        list.remove_all(-1);
+    }
+
+    REQUIRE(list.size() == 100);
+
+    // Removing elements one by one during an iteration keeps the remaining order.
+    int expected = 0;
+    list.for_each([&] (int i)
+    {
+        REQUIRE(i == expected);
+        expected++;
+        if (i < 90)
+        {
+            list.remove_all(i);
+        }
+    });
+
+    REQUIRE(expected == 100);
+    REQUIRE(list.size() == 10);
+    REQUIRE(list.back() == 99);
+
+    list.clear();
+    REQUIRE(list.size() == 0);
+}
@@ -0,0 +1,85 @@
+#include "core/core-impl.hpp"
+#include <wayfire/scene.hpp>
+#include <wayfire/scene-render.hpp>
+#include <wayfire/scene-operations.hpp>
+#include <wayfire/unstable/translation-node.hpp>
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+
+using namespace wf::scene;
+
+/**
+ * A leaf node, similar to the root node of a view, whose render instance remembers itself in the node.
+ */
+class test_leaf_node_t : public node_t
+{
+  public:
+    test_leaf_node_t() : node_t(false)
+    {}
+
+    render_instance_t *instance = nullptr;
+
+    class instance_t : public render_instance_t
+    {
+        test_leaf_node_t *self;
+
+      public:
+        instance_t(test_leaf_node_t *self) : self(self)
+        {
+            self->instance = this;
+        }
+
+        ~instance_t()
+        {
+            if (self->instance == this)
+            {
+                self->instance = nullptr;
+            }
+        }
+
+        void schedule_instructions(std::vector<render_instruction_t>& instructions,
+            const wf::render_target_t& target, wf::region_t& damage) override
+        {}
+    };
+
+    void gen_render_instances(std::vector<render_instance_uptr>& instances,
+        damage_callback push_damage, wf::output_t *shown_on) override
+    {
+        instances.push_back(std::make_unique<instance_t>(this));
+    }
+};
+
+TEST_CASE("Mapping a view keeps the render instances of its siblings")
+{
+    wf::compositor_core_impl_t::allocate_core();
+
+    // Similar to a layer of an output, holding a workspace set whose children are views.
+    auto layer  = std::make_shared<translation_node_t>(true);
+    auto wset   = std::make_shared<translation_node_t>(true);
+    auto view_a = std::make_shared<test_leaf_node_t>();
+    auto view_b = std::make_shared<test_leaf_node_t>();
+    add_front(layer, wset);
+    add_front(wset, view_a);
+
+    std::vector<render_instance_uptr> instances;
+    layer->gen_render_instances(instances, [] (const wf::region_t&) {}, nullptr);
+    REQUIRE(instances.size() == 1);
+    auto *view_a_instance = view_a->instance;
+    REQUIRE(view_a_instance != nullptr);
+
+    // Map: only the instance of the new view is generated.
+    add_front(wset, view_b);
+    REQUIRE(view_b->instance != nullptr);
+    REQUIRE(view_a->instance == view_a_instance);
+
+    // Raise and unmap: the remaining view keeps its instance as well.
+    raise_to_front(view_a);
+    REQUIRE(view_a->instance == view_a_instance);
+    remove_child(view_b);
+    REQUIRE(view_b->instance == nullptr);
+    REQUIRE(view_a->instance == view_a_instance);
+
+    // Disabling the workspace set still drops the instances of the whole subtree.
+    set_node_enabled(wset, false);
+    REQUIRE(view_a->instance == nullptr);
+}
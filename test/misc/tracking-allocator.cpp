@@ -54,3 +54,63 @@ TEST_CASE("Misc factory works")
     REQUIRE(destruct_events == 1);
     REQUIRE(allocator.get_all().size() == 1);
 }
+
+TEST_CASE("Pooled objects are tracked and reuse memory")
+{
+    auto& allocator = wf::tracking_allocator_t<base_t>::get();
+    const size_t initial = allocator.get_all().size();
+    const int destroyed  = base_t::destroyed;
+
+    auto obj_a = allocator.allocate_pooled<derived_t>(1);
+    auto obj_b = allocator.allocate_pooled<derived_t>(2);
+    REQUIRE(allocator.get_all().size() == initial + 2);
+    REQUIRE(allocator.get_all().back() == nonstd::observer_ptr<base_t>(obj_b.get()));
+
+    int destruct_events = 0;
+    wf::signal::connection_t<wf::destruct_signal<base_t>> on_destroy;
+    on_destroy = [&] (wf::destruct_signal<base_t> *ev)
+    {
+        ++destruct_events;
+    };
+
+    obj_a->connect(&on_destroy);
+    void *memory_a = obj_a.get();
+    obj_a.reset();
+    REQUIRE(destruct_events == 1);
+    REQUIRE(base_t::destroyed == destroyed + 1);
+    REQUIRE(allocator.get_all().size() == initial + 1);
+
+    auto obj_c = allocator.allocate_pooled<derived_t>(3);
+    REQUIRE((void*)obj_c.get() == memory_a);
+    REQUIRE(allocator.get_all().size() == initial + 2);
+}
+
+class id_object_t : public base_t
+{
+  public:
+    id_object_t(uint32_t id) : id(id)
+    {}
+
+    uint32_t get_id() const
+    {
+        return id;
+    }
+
+  private:
+    uint32_t id;
+};
+
+TEST_CASE("Objects with an id can be found by it")
+{
+    auto& allocator = wf::tracking_allocator_t<id_object_t>::get();
+    auto obj_a = allocator.allocate<id_object_t>(5);
+    auto obj_b = allocator.allocate_pooled<id_object_t>(7);
+
+    REQUIRE(allocator.find_by_id(5) == obj_a.get());
+    REQUIRE(allocator.find_by_id(7) == obj_b.get());
+    REQUIRE(allocator.find_by_id(6) == nullptr);
+
+    obj_b.reset();
+    REQUIRE(allocator.find_by_id(7) == nullptr);
+    REQUIRE(allocator.find_by_id(5) == obj_a.get());
+}
@@ -290,3 +290,161 @@ TEST_CASE("Concurrent committed")
     REQUIRE(mgr.pending.size() == 0);
     REQUIRE(mgr.done.size() == 2);
 }
+
+TEST_CASE("Batched transactions are merged until idle")
+{
+    setup_wayfire_debugging_state();
+    wf::txn::transaction_manager_t::impl mgr;
+
+    auto obj_a = std::make_shared<txn_test_object_t>(false);
+    auto obj_b = std::make_shared<txn_test_object_t>(false);
+
+    auto tx1 = new_tx();
+    tx1->add_object(obj_a);
+    auto tx2 = new_tx();
+    tx2->add_object(obj_a);
+    tx2->add_object(obj_b);
+
+    mgr.schedule_transaction(std::move(tx1), true);
+    mgr.schedule_transaction(std::move(tx2), true);
+    REQUIRE(mgr.committed.size() == 0);
+    REQUIRE(mgr.pending.size() == 1);
+    REQUIRE(obj_a->number_committed == 0);
+
+    wl_event_loop_dispatch_idle(wf::wl_idle_call::loop);
+    REQUIRE(mgr.committed.size() == 1);
+    REQUIRE(mgr.pending.size() == 0);
+    REQUIRE(obj_a->number_committed == 1);
+    REQUIRE(obj_b->number_committed == 1);
+
+    obj_a->emit_ready();
+    obj_b->emit_ready();
+    REQUIRE(obj_a->number_applied == 1);
+    REQUIRE(obj_b->number_applied == 1);
+    REQUIRE(mgr.committed.size() == 0);
+}
+
+TEST_CASE("Grouped transactions are merged into one")
+{
+    setup_wayfire_debugging_state();
+    wf::txn::transaction_manager_t::impl mgr;
+
+    auto obj_a = std::make_shared<txn_test_object_t>(false);
+    auto obj_b = std::make_shared<txn_test_object_t>(false);
+
+    mgr.start_group();
+    mgr.start_group();
+    auto tx1 = new_tx();
+    tx1->add_object(obj_a);
+    mgr.schedule_transaction(std::move(tx1));
+    mgr.end_group();
+
+    auto tx2 = new_tx();
+    tx2->add_object(obj_b);
+    mgr.schedule_transaction(std::move(tx2));
+    REQUIRE(mgr.committed.size() == 0);
+    REQUIRE(mgr.pending.size() == 0);
+    REQUIRE(obj_a->number_committed == 0);
+
+    mgr.end_group();
+    REQUIRE(mgr.committed.size() == 1);
+    REQUIRE(mgr.committed[0]->get_objects().size() == 2);
+    REQUIRE(obj_a->number_committed == 1);
+    REQUIRE(obj_b->number_committed == 1);
+
+    // Both objects are applied together.
+    obj_a->emit_ready();
+    REQUIRE(obj_a->number_applied == 0);
+    obj_b->emit_ready();
+    REQUIRE(obj_a->number_applied == 1);
+    REQUIRE(obj_b->number_applied == 1);
+    REQUIRE(mgr.committed.size() == 0);
+}
+
+TEST_CASE("Transaction pipeline statistics")
+{
+    setup_wayfire_debugging_state();
+    wf::txn::transaction_manager_t::impl mgr;
+
+    auto obj_a = std::make_shared<txn_test_object_t>(false);
+    auto obj_b = std::make_shared<txn_test_object_t>(false);
+
+    auto tx1 = new_tx();
+    tx1->add_object(obj_a);
+    mgr.schedule_transaction(std::move(tx1));
+
+    // Both wait on tx1 and are merged together
+    auto tx2 = new_tx();
+    tx2->add_object(obj_a);
+    mgr.schedule_transaction(std::move(tx2));
+    auto tx3 = new_tx();
+    tx3->add_object(obj_a);
+    tx3->add_object(obj_b);
+    mgr.schedule_transaction(std::move(tx3));
+
+    REQUIRE(mgr.stats.scheduled == 3);
+    REQUIRE(mgr.stats.merged == 1);
+    REQUIRE(mgr.stats.committed == 1);
+    REQUIRE(mgr.stats.conflicts == 2);
+    REQUIRE(mgr.timing.size() == 2);
+
+    obj_a->emit_ready();
+    REQUIRE(mgr.stats.applied == 1);
+    REQUIRE(mgr.stats.committed == 2);
+    REQUIRE(mgr.stats.max_committed == 1);
+
+    obj_a->emit_ready();
+    obj_b->emit_ready();
+    REQUIRE(mgr.stats.applied == 2);
+    REQUIRE(mgr.stats.timed_out == 0);
+    REQUIRE(mgr.timing.empty());
+
+    uint64_t histogram_total = 0;
+    for (auto& count : mgr.stats.latency_histogram)
+    {
+        histogram_total += count;
+    }
+
+    REQUIRE(histogram_total == 2);
+}
+
+TEST_CASE("Object index follows merges, commits and applies")
+{
+    setup_wayfire_debugging_state();
+    wf::txn::transaction_manager_t::impl mgr;
+
+    auto obj_a = std::make_shared<txn_test_object_t>(false);
+    auto obj_b = std::make_shared<txn_test_object_t>(false);
+    auto obj_c = std::make_shared<txn_test_object_t>(false);
+
+    auto tx1 = new_tx();
+    tx1->add_object(obj_a);
+    mgr.schedule_transaction(std::move(tx1));
+    REQUIRE(mgr.committed_owner.count(obj_a.get()));
+    REQUIRE(mgr.pending_owner.empty());
+
+    // tx2 waits on tx1, tx3 is merged into tx2 through obj_b.
+    auto tx2 = new_tx();
+    tx2->add_object(obj_a);
+    tx2->add_object(obj_b);
+    mgr.schedule_transaction(std::move(tx2));
+    auto tx3 = new_tx();
+    tx3->add_object(obj_b);
+    tx3->add_object(obj_c);
+    mgr.schedule_transaction(std::move(tx3));
+
+    REQUIRE(mgr.pending.size() == 1);
+    REQUIRE(mgr.pending_owner.size() == 3);
+    REQUIRE(mgr.pending_owner[obj_a.get()] == mgr.pending[0].get());
+    REQUIRE(mgr.pending_owner[obj_c.get()] == mgr.pending[0].get());
+
+    obj_a->emit_ready();
+    REQUIRE(mgr.pending_owner.empty());
+    REQUIRE(mgr.committed_owner.size() == 3);
+
+    obj_a->emit_ready();
+    obj_b->emit_ready();
+    obj_c->emit_ready();
+    REQUIRE(mgr.committed.empty());
+    REQUIRE(mgr.committed_owner.empty());
+}
@@ -11,6 +11,7 @@ class txn_test_object_t : public wf::txn::transaction_object_t
     std::function<void()> apply_callback;
 
     bool autoready;
+    std::string app_id;
 
     txn_test_object_t(bool autocommit)
     {
@@ -35,6 +36,11 @@ class txn_test_object_t : public wf::txn::transaction_object_t
         }
     }
 
+    std::string get_app_id() const override
+    {
+        return app_id;
+    }
+
     void emit_ready()
     {
         wf::txn::object_ready_signal ev;
@@ -8,6 +8,7 @@
 
 #include "transaction-test-object.hpp"
 #include <wayfire/txn/transaction.hpp>
+#include "../../src/core/txn/client-ack-stats.hpp"
 
 static void run_transaction_test(bool timeout, bool autoready)
 {
@@ -99,3 +100,43 @@ TEST_CASE("Transaction is applied immediately if all objects are ready")
 {
     run_transaction_test(false, true);
 }
+
+TEST_CASE("Client ack latency is recorded per app-id")
+{
+    setup_wayfire_debugging_state();
+    wf::wl_timer<false>::callback_t tx_timeout_callback;
+    auto timer_setter = [&] (uint64_t, wf::wl_timer<false>::callback_t cb)
+    {
+        tx_timeout_callback = cb;
+    };
+
+    auto fast = std::make_shared<txn_test_object_t>(true);
+    auto slow = std::make_shared<txn_test_object_t>(false);
+    fast->app_id = "test-fast";
+    slow->app_id = "test-slow";
+
+    for (int i = 0; i < 4; i++)
+    {
+        REQUIRE(wf::txn::client_ack_stats::expected_ack("test-fast") == -1);
+        wf::txn::transaction_t tx(100, timer_setter);
+        tx.add_object(fast);
+        tx.add_object(slow);
+        tx.commit();
+        tx_timeout_callback();
+    }
+
+    REQUIRE(wf::txn::client_ack_stats::expected_ack("test-fast") >= 0);
+    REQUIRE(wf::txn::client_ack_stats::expected_ack("test-slow") >= 0);
+    for (auto& stats : wf::txn::client_ack_stats::get_stats())
+    {
+        if (stats.app_id == "test-fast")
+        {
+            REQUIRE(stats.acks == 4);
+            REQUIRE(stats.timeouts == 0);
+        } else if (stats.app_id == "test-slow")
+        {
+            REQUIRE(stats.acks == 0);
+            REQUIRE(stats.timeouts == 4);
+        }
+    }
+}